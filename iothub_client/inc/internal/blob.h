@@ -19,13 +19,17 @@
 #include "azure_c_shared_utility/httpapiex.h"
 #include "iothub_client_core_ll.h"
 #include "azure_c_shared_utility/shared_util_options.h"
+#include "internal/blob_upload_journal.h"
 
 #ifdef __cplusplus
 #include <cstddef>
+#include <cstdio>
 extern "C"
 {
 #else
 #include <stddef.h>
+#include <stdio.h>
+#include <stdbool.h>
 #endif
 
 #include "umock_c/umock_c_prod.h"
@@ -36,6 +40,9 @@ extern "C"
 #define MAX_BLOCK_COUNT 50000
 #endif
 
+/* Upper bound of the blocks uploaded at the same time by Blob_UploadMultipleBlocksFromSasUri, each over its own connection */
+#define BLOB_MAX_UPLOAD_CONCURRENCY 16
+
 #define BLOB_RESULT_VALUES \
     BLOB_OK,               \
     BLOB_ERROR,            \
@@ -57,10 +64,35 @@ MU_DEFINE_ENUM_WITHOUT_INVALID(BLOB_RESULT, BLOB_RESULT_VALUES)
 * @param  certificates      A null terminated string containing CA certificates to be used
 * @param    proxyOptions    A structure that contains optional web proxy information
 * @param  networkInterface    An optional null terminated string containing the network interface
+* @param  concurrency       The number of blocks uploaded at the same time (up to BLOB_MAX_UPLOAD_CONCURRENCY). 0 or 1 uploads the blocks one after the other
+* @param  journal           An optional journal of the blocks already uploaded to this blob. Blocks it records with the same content are not sent again, and blocks sent are added to it
+*
+* @return    A @c BLOB_RESULT. BLOB_OK means the blob has been uploaded successfully. Any other value indicates an error
+*/
+MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadMultipleBlocksFromSasUri, const char*, SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX, getDataCallbackEx, void*, context, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates, HTTP_PROXY_OPTIONS*, proxyOptions, const char*, networkInterface, size_t, concurrency, BLOB_UPLOAD_JOURNAL_HANDLE, journal)
+
+/**
+* @brief  Synchronously uploads the content of a file to blob storage
+*
+* @details Each block is read from the file directly into the buffer of its Put Block request, so the file is never held
+*          in memory as a whole: at most one block per block in flight, plus the one being read, is resident.
+*          When the size of the file can be determined, the size of the blocks follows the throughput measured while
+*          they are sent (see blob_block_sizer.h), within BLOCK_SIZE and the MAX_BLOCK_COUNT blocks of a blob.
+*
+* @param  SASURI            The URI to use to upload data
+* @param  file              A file opened for reading in binary mode, read from its current position to its end. The caller keeps ownership of it
+* @param  compress          Gzip the file while it is read and set the Content-Encoding of the blob to gzip. Needs a build with use_blob_compression, BLOB_NOT_IMPLEMENTED is returned otherwise
+* @param  httpStatus        A pointer to an out argument receiving the HTTP status (available only when the return value is BLOB_OK)
+* @param  httpResponse      A BUFFER_HANDLE that receives the HTTP response from the server (available only when the return value is BLOB_OK)
+* @param  certificates      A null terminated string containing CA certificates to be used
+* @param    proxyOptions    A structure that contains optional web proxy information
+* @param  networkInterface    An optional null terminated string containing the network interface
+* @param  concurrency       The number of blocks uploaded at the same time (up to BLOB_MAX_UPLOAD_CONCURRENCY). 0 or 1 uploads the blocks one after the other
+* @param  journal           An optional journal of the blocks already uploaded to this blob, as for Blob_UploadMultipleBlocksFromSasUri
 *
 * @return    A @c BLOB_RESULT. BLOB_OK means the blob has been uploaded successfully. Any other value indicates an error
 */
-MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadMultipleBlocksFromSasUri, const char*, SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX, getDataCallbackEx, void*, context, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates, HTTP_PROXY_OPTIONS*, proxyOptions, const char*, networkInterface)
+MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadMultipleBlocksFromFile, const char*, SASURI, FILE*, file, bool, compress, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates, HTTP_PROXY_OPTIONS*, proxyOptions, const char*, networkInterface, size_t, concurrency, BLOB_UPLOAD_JOURNAL_HANDLE, journal)
 
 /**
 * @brief  Synchronously uploads a byte array as a new block to blob storage
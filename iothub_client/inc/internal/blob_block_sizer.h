@@ -0,0 +1,63 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file blob_block_sizer.h
+*    @brief Chooses the size of the blocks of a blob upload from the time storage takes to accept them.
+*
+*    @details Every Put Block pays one round trip on top of the time its content takes on the wire, so small blocks waste
+*             a fast link while large ones make a slow link resend a lot whenever a block fails. The sizer starts with
+*             small blocks and doubles them for as long as doing so raises the measured throughput noticeably, that is
+*             while the round trip is still a large part of the time of a block. A block that had to be retried halves
+*             the size and starts the probing over.
+*/
+
+#ifndef BLOB_BLOCK_SIZER_H
+#define BLOB_BLOCK_SIZER_H
+
+#include "azure_c_shared_utility/tickcounter.h"
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+/* Size of the first blocks, unless it is outside the bounds given to blob_block_sizer_create */
+#define BLOB_BLOCK_SIZER_INITIAL_SIZE       (256 * 1024)
+/* Doubling the blocks has to raise the throughput by this much for the sizer to try doubling them again */
+#define BLOB_BLOCK_SIZER_MIN_GAIN_PERCENT   10
+/* Blocks accepted quicker than this are too fast to measure, the sizer keeps growing them */
+#define BLOB_BLOCK_SIZER_MIN_SAMPLE_MS      20
+
+typedef struct BLOB_BLOCK_SIZER_TAG* BLOB_BLOCK_SIZER_HANDLE;
+
+/**
+* @brief  Creates a sizer choosing block sizes between min_size and max_size. It is not thread safe.
+*/
+MOCKABLE_FUNCTION(, BLOB_BLOCK_SIZER_HANDLE, blob_block_sizer_create, size_t, min_size, size_t, max_size);
+
+/**
+* @brief  Frees the sizer.
+*/
+MOCKABLE_FUNCTION(, void, blob_block_sizer_destroy, BLOB_BLOCK_SIZER_HANDLE, sizer);
+
+/**
+* @brief  Returns the size the next block should have.
+*/
+MOCKABLE_FUNCTION(, size_t, blob_block_sizer_get_size, BLOB_BLOCK_SIZER_HANDLE, sizer);
+
+/**
+* @brief  Tells the sizer that storage accepted a block of size bytes elapsed_ms after it started sending it. Set retried
+*         when the block had to be sent more than once.
+*/
+MOCKABLE_FUNCTION(, void, blob_block_sizer_on_block_sent, BLOB_BLOCK_SIZER_HANDLE, sizer, size_t, size, tickcounter_ms_t, elapsed_ms, bool, retried);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOB_BLOCK_SIZER_H */
@@ -0,0 +1,69 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file blob_upload_journal.h
+*    @brief Records the blocks of a blob upload that storage has accepted, so that a later attempt to upload the
+*           same blob can skip them.
+*
+*    @details The journal is a text file. Its first line is the blob URL (the SAS URI without its query, as the SAS
+*             token expires), followed by one line per accepted block with the block id, its size and the SHA-256 of
+*             its content. Storage keeps uncommitted blocks for a week, so a block whose id and content hash are in the
+*             journal does not have to be sent again before the block list is committed.
+*/
+
+#ifndef BLOB_UPLOAD_JOURNAL_H
+#define BLOB_UPLOAD_JOURNAL_H
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+#define BLOB_UPLOAD_JOURNAL_HASH_SIZE 32
+
+typedef struct BLOB_UPLOAD_JOURNAL_TAG* BLOB_UPLOAD_JOURNAL_HANDLE;
+
+/**
+* @brief  Opens the journal of the blob of sas_uri. Its file is journal_path followed by '.' and 16 hex digits of the
+*         hash of the blob URL, so uploads to different blobs each have their own. The blocks it records are kept only
+*         if they were uploaded to the same blob; otherwise (or if there is no journal yet) the journal is started over.
+*/
+MOCKABLE_FUNCTION(, BLOB_UPLOAD_JOURNAL_HANDLE, blob_upload_journal_open, const char*, journal_path, const char*, sas_uri);
+
+/**
+* @brief  Computes the hash the journal keeps for a block of size bytes.
+*/
+MOCKABLE_FUNCTION(, int, blob_upload_journal_hash_block, const unsigned char*, content, size_t, size, unsigned char*, hash);
+
+/**
+* @brief  Tells whether block_id has been uploaded with the content hashed to hash.
+*/
+MOCKABLE_FUNCTION(, bool, blob_upload_journal_has_block, BLOB_UPLOAD_JOURNAL_HANDLE, journal, unsigned int, block_id, const unsigned char*, hash);
+
+/**
+* @brief  Gets the size block_id had when it was uploaded, so that an upload choosing its block sizes on the fly can cut
+*         the blocks the journal has at the same places again. Returns false when the journal does not have block_id.
+*/
+MOCKABLE_FUNCTION(, bool, blob_upload_journal_get_block_size, BLOB_UPLOAD_JOURNAL_HANDLE, journal, unsigned int, block_id, size_t*, size);
+
+/**
+* @brief  Records that storage accepted block_id, of size bytes, with the content hashed to hash. Safe to call from several threads.
+*/
+MOCKABLE_FUNCTION(, int, blob_upload_journal_add_block, BLOB_UPLOAD_JOURNAL_HANDLE, journal, unsigned int, block_id, size_t, size, const unsigned char*, hash);
+
+/**
+* @brief  Closes the journal. With discard set the journal file is deleted, as it is once the upload is complete or can no longer be resumed.
+*/
+MOCKABLE_FUNCTION(, void, blob_upload_journal_close, BLOB_UPLOAD_JOURNAL_HANDLE, journal, bool, discard);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOB_UPLOAD_JOURNAL_H */
@@ -0,0 +1,30 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_CALLBACK_RING_H
+#define IOTHUB_CLIENT_CALLBACK_RING_H
+
+#include <stddef.h>
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*bounded FIFO of fixed size records, all preallocated by callback_ring_create. Push and pop copy one record
+in or out under a private lock that is never held while user code runs, so no allocation happens after creation.*/
+typedef struct CALLBACK_RING_TAG* CALLBACK_RING_HANDLE;
+
+MOCKABLE_FUNCTION(, CALLBACK_RING_HANDLE, callback_ring_create, size_t, record_size, size_t, capacity);
+MOCKABLE_FUNCTION(, void, callback_ring_destroy, CALLBACK_RING_HANDLE, ring);
+MOCKABLE_FUNCTION(, int, callback_ring_push, CALLBACK_RING_HANDLE, ring, const void*, record);
+MOCKABLE_FUNCTION(, int, callback_ring_pop, CALLBACK_RING_HANDLE, ring, void*, record);
+MOCKABLE_FUNCTION(, size_t, callback_ring_get_count, CALLBACK_RING_HANDLE, ring);
+MOCKABLE_FUNCTION(, size_t, callback_ring_get_high_water, CALLBACK_RING_HANDLE, ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_CALLBACK_RING_H
@@ -0,0 +1,42 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_CLIENT_DISPATCH_POOL_H
+#define IOTHUB_CLIENT_DISPATCH_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*runs submitted records on a fixed set of threads. Records of the same category run one at a time, in submission
+order; records of different categories run in parallel. At most queue_capacity records are queued or running, in
+items allocated by dispatch_pool_create; dispatch_pool_submit waits for a worker to free one when they are all taken.
+dispatch_pool_destroy runs the records still queued before joining the threads.*/
+typedef struct DISPATCH_POOL_TAG* DISPATCH_POOL_HANDLE;
+
+typedef void(*DISPATCH_POOL_FUNCTION)(void* context, void* record);
+
+typedef struct DISPATCH_POOL_CATEGORY_STATISTICS_TAG
+{
+    uint64_t queue_depth;
+    uint64_t max_queue_depth;
+    uint64_t dispatched;
+    uint64_t total_latency_ms;
+    uint64_t max_latency_ms;
+} DISPATCH_POOL_CATEGORY_STATISTICS;
+
+MOCKABLE_FUNCTION(, DISPATCH_POOL_HANDLE, dispatch_pool_create, size_t, thread_count, size_t, category_count, size_t, record_size, size_t, queue_capacity, DISPATCH_POOL_FUNCTION, function, void*, context);
+MOCKABLE_FUNCTION(, void, dispatch_pool_destroy, DISPATCH_POOL_HANDLE, pool);
+MOCKABLE_FUNCTION(, int, dispatch_pool_submit, DISPATCH_POOL_HANDLE, pool, size_t, category, const void*, record);
+MOCKABLE_FUNCTION(, int, dispatch_pool_get_statistics, DISPATCH_POOL_HANDLE, pool, size_t, category, DISPATCH_POOL_CATEGORY_STATISTICS*, statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_DISPATCH_POOL_H
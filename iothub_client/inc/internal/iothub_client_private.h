@@ -15,6 +15,7 @@
 #include "internal/iothub_transport_ll_private.h"
 #include "iothub_client_core_common.h"
 #include "iothub_client_core_ll.h"
+#include "internal/timeout_heap.h"
 
 #ifdef USE_EDGE_MODULES
 #include "internal/iothub_client_edge.h"
@@ -49,6 +50,8 @@ typedef struct IOTHUB_MESSAGE_LIST_TAG
     DLIST_ENTRY entry;
     tickcounter_ms_t ms_timesOutAfter; /* a value of "0" means "no timeout", if the IOTHUBCLIENT_LL's handle tickcounter > msTimesOutAfer then the message shall timeout*/
     tickcounter_ms_t message_timeout_value;
+    uint64_t sequence; /*order in which the message was queued in waitingToSend*/
+    TIMEOUT_HEAP_NODE timeout_node;
 }IOTHUB_MESSAGE_LIST;
 
 typedef struct IOTHUB_DEVICE_TWIN_TAG
@@ -0,0 +1,69 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_reported_state_coalescer.h
+*    @brief Merges reported-property patches into one PATCH.
+*
+*    @details The patches added are merged as JSON merge patches, the last one written winning for every property path,
+*             and the callbacks of their callers are kept. Taking the pending patch hands out a batch holding the merged
+*             JSON, whose completion calls every one of those callbacks with the status code of the merged PATCH.
+*/
+
+#ifndef IOTHUB_CLIENT_REPORTED_STATE_COALESCER_H
+#define IOTHUB_CLIENT_REPORTED_STATE_COALESCER_H
+
+#include "umock_c/umock_c_prod.h"
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+typedef struct REPORTED_STATE_COALESCER_TAG* REPORTED_STATE_COALESCER_HANDLE;
+typedef struct REPORTED_STATE_BATCH_TAG* REPORTED_STATE_BATCH_HANDLE;
+
+MOCKABLE_FUNCTION(, REPORTED_STATE_COALESCER_HANDLE, reported_state_coalescer_create);
+
+/**
+* @brief  Frees the coalescer and the patch pending in it, without calling the callbacks of that patch.
+*/
+MOCKABLE_FUNCTION(, void, reported_state_coalescer_destroy, REPORTED_STATE_COALESCER_HANDLE, coalescer);
+
+/**
+* @brief  Merges reported_state into the pending patch. Fails, leaving the pending patch as it was, if reported_state is not
+*         a JSON object or if it cannot be merged without changing what the hub ends up with: a property set to null, a number,
+*         a string, a bool or an array, then to an object, is replaced before the object is merged in, which one merged patch
+*         cannot say. Such a patch is sent on its own.
+*/
+MOCKABLE_FUNCTION(, int, reported_state_coalescer_add, REPORTED_STATE_COALESCER_HANDLE, coalescer, const unsigned char*, reported_state, size_t, size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK, reported_state_callback, void*, user_context);
+
+MOCKABLE_FUNCTION(, bool, reported_state_coalescer_has_pending, REPORTED_STATE_COALESCER_HANDLE, coalescer);
+
+/**
+* @brief  Takes out the pending patch. Returns NULL if nothing is pending or on failure, when the patch stays pending.
+*/
+MOCKABLE_FUNCTION(, REPORTED_STATE_BATCH_HANDLE, reported_state_coalescer_take, REPORTED_STATE_COALESCER_HANDLE, coalescer);
+
+/**
+* @brief  The merged JSON of the batch, valid until the batch is destroyed.
+*/
+MOCKABLE_FUNCTION(, const char*, reported_state_batch_get_patch, REPORTED_STATE_BATCH_HANDLE, batch);
+
+/**
+* @brief  An IOTHUB_CLIENT_REPORTED_STATE_CALLBACK, with the batch as its context, calling the callbacks of all the patches
+*         merged into the batch with status_code. It does not free the batch.
+*/
+MOCKABLE_FUNCTION(, void, reported_state_batch_complete, int, status_code, void*, batch);
+
+MOCKABLE_FUNCTION(, void, reported_state_batch_destroy, REPORTED_STATE_BATCH_HANDLE, batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_REPORTED_STATE_COALESCER_H */
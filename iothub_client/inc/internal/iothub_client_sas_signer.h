@@ -0,0 +1,45 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_sas_signer.h
+*    @brief Signs the SAS tokens of one device key.
+*
+*    @details The key is base64-decoded once and the HMAC-SHA256 inner and outer pads are hashed into two SHA-256
+*             contexts up front, so signing a token only hashes the string to sign and the inner digest. The latest
+*             tokens are kept, keyed on scope, key name and expiry, so asking again for the same token does not sign it
+*             again. The tokens are the same as the ones SASToken_CreateString builds from the key.
+*/
+
+#ifndef IOTHUB_CLIENT_SAS_SIGNER_H
+#define IOTHUB_CLIENT_SAS_SIGNER_H
+
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C"
+{
+#else
+#include <stdint.h>
+#endif
+
+typedef struct SAS_SIGNER_TAG* SAS_SIGNER_HANDLE;
+
+/**
+* @brief  Creates a signer for the base64-encoded device_key. Returns NULL if device_key is not base64.
+*/
+MOCKABLE_FUNCTION(, SAS_SIGNER_HANDLE, sas_signer_create, const char*, device_key);
+
+/**
+* @brief  Returns a copy of the SAS token for scope (with skn=key_name when key_name is neither NULL nor empty) expiring
+*         at expiry seconds since the epoch, to be freed by the caller. Safe to call from several threads.
+*/
+MOCKABLE_FUNCTION(, char*, sas_signer_get_token, SAS_SIGNER_HANDLE, signer, const char*, scope, const char*, key_name, uint64_t, expiry);
+
+MOCKABLE_FUNCTION(, void, sas_signer_destroy, SAS_SIGNER_HANDLE, signer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_SAS_SIGNER_H */
@@ -0,0 +1,63 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_twin_cache.h
+*    @brief Keeps a local copy of the device twin document.
+*
+*    @details The document is replaced by every full twin received and the desired-property patches are merged into it in
+*             place, as JSON merge patches. The desired $version of each patch must follow the one of the document, so a
+*             patch missed in between is detected and the document can be fetched again.
+*/
+
+#ifndef IOTHUB_CLIENT_TWIN_CACHE_H
+#define IOTHUB_CLIENT_TWIN_CACHE_H
+
+#include "azure_macro_utils/macro_utils.h"
+#include "umock_c/umock_c_prod.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+typedef struct TWIN_CACHE_TAG* TWIN_CACHE_HANDLE;
+
+#define TWIN_CACHE_RESULT_VALUES    \
+    TWIN_CACHE_OK,                  \
+    TWIN_CACHE_STALE,               \
+    TWIN_CACHE_GAP,                 \
+    TWIN_CACHE_ERROR
+
+MU_DEFINE_ENUM_WITHOUT_INVALID(TWIN_CACHE_RESULT, TWIN_CACHE_RESULT_VALUES);
+
+MOCKABLE_FUNCTION(, TWIN_CACHE_HANDLE, twin_cache_create);
+MOCKABLE_FUNCTION(, void, twin_cache_destroy, TWIN_CACHE_HANDLE, twin_cache);
+
+/**
+* @brief  Replaces the document with a full twin, a JSON object with the "desired" and "reported" properties.
+*/
+MOCKABLE_FUNCTION(, int, twin_cache_set_document, TWIN_CACHE_HANDLE, twin_cache, const unsigned char*, twin, size_t, size);
+
+/**
+* @brief  Merges a desired-property patch into the document.
+*
+* @return TWIN_CACHE_OK once merged, TWIN_CACHE_STALE if the document already has the $version of the patch,
+*         TWIN_CACHE_GAP if there is no document or patches are missing between it and this one, TWIN_CACHE_ERROR if the
+*         patch is not a JSON object or could not be merged. The document is dropped on TWIN_CACHE_ERROR, so the
+*         patches that follow report TWIN_CACHE_GAP until a full twin is set.
+*/
+MOCKABLE_FUNCTION(, TWIN_CACHE_RESULT, twin_cache_apply_patch, TWIN_CACHE_HANDLE, twin_cache, const unsigned char*, patch, size_t, size);
+
+/**
+* @brief  Serializes the document into a buffer allocated with malloc, which the caller frees. Fails if there is no document.
+*/
+MOCKABLE_FUNCTION(, int, twin_cache_get_document, TWIN_CACHE_HANDLE, twin_cache, unsigned char**, twin, size_t*, size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_TWIN_CACHE_H */
@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include "internal/iothub_transport_ll_private.h"
 #include "azure_uamqp_c/cbs.h"
+#include "internal/iothubtransport_amqp_cbs_scheduler.h"
 #include "umock_c/umock_c_prod.h"
 #include "azure_c_shared_utility/optionhandler.h"
 
@@ -51,6 +52,8 @@ extern "C"
 
         IOTHUB_AUTHORIZATION_HANDLE authorization_module;                   // with either SAS Token, x509 Certs, and Device SAS Token
 
+        CBS_SCHEDULER_HANDLE cbs_scheduler;                                 // Optional; paces the put-tokens of all devices on the CBS link.
+
     } AUTHENTICATION_CONFIG;
 
     typedef struct AUTHENTICATION_INSTANCE* AUTHENTICATION_HANDLE;
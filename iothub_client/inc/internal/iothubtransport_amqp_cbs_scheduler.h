@@ -0,0 +1,47 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUBTRANSPORT_AMQP_CBS_SCHEDULER_H
+#define IOTHUBTRANSPORT_AMQP_CBS_SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/tickcounter.h"
+#include "umock_c/umock_c_prod.h"
+#include "iothub_client_options.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*Paces the CBS put-token operations of the devices sharing one AMQP connection. The SAS token refreshes are handed
+out slots spread over the second half of the token validity window instead of all falling due at the same second,
+the put-tokens in flight can be capped, and the CBS round trips are counted into IOTHUB_AMQP_CBS_STATISTICS.*/
+typedef struct CBS_SCHEDULER_INSTANCE* CBS_SCHEDULER_HANDLE;
+
+MOCKABLE_FUNCTION(, CBS_SCHEDULER_HANDLE, cbs_scheduler_create);
+MOCKABLE_FUNCTION(, void, cbs_scheduler_destroy, CBS_SCHEDULER_HANDLE, scheduler);
+
+/*0 means no limit*/
+MOCKABLE_FUNCTION(, int, cbs_scheduler_set_max_put_tokens_in_flight, CBS_SCHEDULER_HANDLE, scheduler, size_t, max_put_tokens_in_flight);
+
+/*the refresh slots are spaced by the number of devices added*/
+MOCKABLE_FUNCTION(, void, cbs_scheduler_add_device, CBS_SCHEDULER_HANDLE, scheduler);
+MOCKABLE_FUNCTION(, void, cbs_scheduler_remove_device, CBS_SCHEDULER_HANDLE, scheduler);
+
+/*seconds after the put of a token valid for token_lifetime_secs (put secs_since_put seconds ago) at which it shall be refreshed*/
+MOCKABLE_FUNCTION(, uint64_t, cbs_scheduler_get_refresh_delay, CBS_SCHEDULER_HANDLE, scheduler, uint64_t, secs_since_put, uint64_t, token_lifetime_secs);
+
+/*false if the put-token has to wait for the ones in flight; otherwise it is counted in flight until cbs_scheduler_end_put_token*/
+MOCKABLE_FUNCTION(, bool, cbs_scheduler_begin_put_token, CBS_SCHEDULER_HANDLE, scheduler, tickcounter_ms_t*, start_time);
+MOCKABLE_FUNCTION(, void, cbs_scheduler_end_put_token, CBS_SCHEDULER_HANDLE, scheduler, tickcounter_ms_t, start_time, bool, succeeded);
+
+MOCKABLE_FUNCTION(, int, cbs_scheduler_get_statistics, CBS_SCHEDULER_HANDLE, scheduler, IOTHUB_AMQP_CBS_STATISTICS*, statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*IOTHUBTRANSPORT_AMQP_CBS_SCHEDULER_H*/
@@ -9,6 +9,7 @@
 #include "azure_uamqp_c/session.h"
 #include "azure_uamqp_c/cbs.h"
 #include "iothub_message.h"
+#include "internal/iothubtransport_amqp_cbs_scheduler.h"
 #include "iothub_client_private.h"
 #include "iothubtransport_amqp_device.h"
 
@@ -20,6 +21,8 @@ extern "C"
 // @brief    name of option to apply the instance obtained using amqp_device_retrieve_options
 static const char* DEVICE_OPTION_SAVED_OPTIONS = "saved_device_options";
 static const char* DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS = "event_send_timeout_secs";
+static const char* DEVICE_OPTION_TELEMETRY_LINGER_MS = "telemetry_linger_ms";
+static const char* DEVICE_OPTION_TELEMETRY_BATCH_BYTES = "telemetry_batch_bytes";
 static const char* DEVICE_OPTION_CBS_REQUEST_TIMEOUT_SECS = "cbs_request_timeout_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS = "sas_token_refresh_time_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_LIFETIME_SECS = "sas_token_lifetime_secs";
@@ -103,6 +106,9 @@ typedef struct DEVICE_CONFIG_TAG
     // Auth module used to generating handle authorization
     // with either SAS Token, x509 Certs, and Device SAS Token
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;
+
+    // Paces the CBS put-tokens of all the devices of the transport (DEVICE_AUTH_MODE_CBS only; optional).
+    CBS_SCHEDULER_HANDLE cbs_scheduler;
 } AMQP_DEVICE_CONFIG;
 
 typedef struct AMQP_DEVICE_INSTANCE* AMQP_DEVICE_HANDLE;
@@ -20,6 +20,8 @@ extern "C"
 
 
 static const char* TELEMETRY_MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS = "telemetry_event_send_timeout_secs";
+static const char* TELEMETRY_MESSENGER_OPTION_LINGER_MS = "telemetry_linger_ms";
+static const char* TELEMETRY_MESSENGER_OPTION_LINGER_BATCH_BYTES = "telemetry_linger_batch_bytes";
 static const char* TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS = "saved_telemetry_messenger_options";
 
 typedef struct TELEMETRY_MESSENGER_INSTANCE* TELEMETRY_MESSENGER_HANDLE;
@@ -0,0 +1,58 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef TIMEOUT_HEAP_H
+#define TIMEOUT_HEAP_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+/*min-heap of deadlines (a pairing heap). Like a DLIST_ENTRY, a TIMEOUT_HEAP_NODE is embedded in the item that can
+time out and the item is found back with containingRecord, so nothing is ever allocated: adding is O(1) and taking
+out the earliest deadline or any node is O(log n) amortized. Nodes with equal deadlines come out in the order they
+were added. These are plain functions, not mocks: the heap is part of the state of the modules that embed it.*/
+typedef struct TIMEOUT_HEAP_NODE_TAG
+{
+    uint64_t deadline;
+    uint64_t sequence;
+    struct TIMEOUT_HEAP_NODE_TAG* child;
+    struct TIMEOUT_HEAP_NODE_TAG* next;
+    struct TIMEOUT_HEAP_NODE_TAG* prev; /*the previous sibling, or the parent of a first child; NULL for the root and for nodes not in a heap*/
+} TIMEOUT_HEAP_NODE;
+
+typedef struct TIMEOUT_HEAP_TAG
+{
+    TIMEOUT_HEAP_NODE* root;
+    uint64_t next_sequence;
+} TIMEOUT_HEAP;
+
+void timeout_heap_init(TIMEOUT_HEAP* heap);
+
+/*a node has to be initialized once before it is added or removed; a node taken out of the heap can be added again*/
+void timeout_heap_node_init(TIMEOUT_HEAP_NODE* node);
+bool timeout_heap_node_is_queued(const TIMEOUT_HEAP* heap, const TIMEOUT_HEAP_NODE* node);
+
+void timeout_heap_add(TIMEOUT_HEAP* heap, TIMEOUT_HEAP_NODE* node, uint64_t deadline);
+
+/*does nothing for a node that is not in the heap*/
+void timeout_heap_remove(TIMEOUT_HEAP* heap, TIMEOUT_HEAP_NODE* node);
+
+/*the node with the earliest deadline, or NULL if the heap is empty*/
+TIMEOUT_HEAP_NODE* timeout_heap_peek(const TIMEOUT_HEAP* heap);
+
+/*takes out and returns the node with the earliest deadline if that deadline is not after now, otherwise returns NULL*/
+TIMEOUT_HEAP_NODE* timeout_heap_pop_expired(TIMEOUT_HEAP* heap, uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIMEOUT_HEAP_H
@@ -16,6 +16,11 @@ extern "C"
     MOCKABLE_FUNCTION(, int, message_create_IoTHubMessage_from_uamqp_message, MESSAGE_HANDLE, uamqp_message, IOTHUB_MESSAGE_HANDLE*, iothubclient_message);
     MOCKABLE_FUNCTION(, int, message_create_uamqp_encoding_from_iothub_message, MESSAGE_HANDLE, message_batch_container, IOTHUB_MESSAGE_HANDLE, message_handle, BINARY_DATA*, body_binary_data);
 
+    /* Same encoding as message_create_uamqp_encoding_from_iothub_message, written into *scratch_buffer instead of a new allocation.
+       The scratch buffer is grown with realloc when the encoding does not fit, and is freed by the caller. body_binary_data points
+       into it, so it is only valid until the next call. */
+    MOCKABLE_FUNCTION(, int, message_encode_uamqp_encoding_from_iothub_message, MESSAGE_HANDLE, message_batch_container, IOTHUB_MESSAGE_HANDLE, message_handle, unsigned char**, scratch_buffer, size_t*, scratch_buffer_size, BINARY_DATA*, body_binary_data);
+
 #ifdef __cplusplus
 }
 #endif
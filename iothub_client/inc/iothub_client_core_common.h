@@ -6,6 +6,7 @@
 #ifndef IOTHUB_CLIENT_CORE_COMMON_H
 #define IOTHUB_CLIENT_CORE_COMMON_H
 
+#include <stdint.h>
 #include "azure_macro_utils/macro_utils.h"
 #include "umock_c/umock_c_prod.h"
 
@@ -181,6 +182,68 @@ extern "C"
     typedef void(*IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK)(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, unsigned char const ** data, size_t* size, void* context);
     typedef IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT(*IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX)(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, unsigned char const ** data, size_t* size, void* context);
 
+    /** @brief    This struct captures the activity of the worker thread of the convenience layer. */
+    typedef struct IOTHUB_CLIENT_WORKER_STATISTICS_TAG
+    {
+        /** @brief    Number of times the worker thread called DoWork. */
+        uint64_t do_work_calls;
+
+        /** @brief    Number of times the worker thread resumed after sleeping or waiting for work. */
+        uint64_t wakeups;
+
+        /** @brief    Wakeups caused by an API call queueing work (wake-on-work mode only). */
+        uint64_t signaled_wakeups;
+
+        /** @brief    Wakeups caused by the sleep or the idle period expiring. */
+        uint64_t timeout_wakeups;
+
+        /** @brief    Total time, in milliseconds, the worker thread spent sleeping or waiting for work. */
+        uint64_t idle_time_ms;
+
+        /** @brief    Number of user callbacks that could not be queued for dispatch and were dropped. */
+        uint64_t dropped_callbacks;
+
+        /** @brief    Number of user callbacks queued in a list because the OPTION_USER_CALLBACK_RING_CAPACITY ring was full. */
+        uint64_t overflowed_callbacks;
+
+        /** @brief    Highest number of user callbacks waiting for dispatch at once (only tracked with OPTION_USER_CALLBACK_RING_CAPACITY). */
+        uint64_t callback_queue_high_water;
+    } IOTHUB_CLIENT_WORKER_STATISTICS;
+
+#define IOTHUB_CLIENT_CALLBACK_CATEGORY_VALUES            \
+    IOTHUB_CLIENT_CALLBACK_CATEGORY_EVENT_CONFIRMATION,   \
+    IOTHUB_CLIENT_CALLBACK_CATEGORY_REPORTED_STATE,       \
+    IOTHUB_CLIENT_CALLBACK_CATEGORY_CONNECTION_STATUS,    \
+    IOTHUB_CLIENT_CALLBACK_CATEGORY_DEVICE_TWIN,          \
+    IOTHUB_CLIENT_CALLBACK_CATEGORY_DEVICE_METHOD,        \
+    IOTHUB_CLIENT_CALLBACK_CATEGORY_MESSAGE,              \
+    IOTHUB_CLIENT_CALLBACK_CATEGORY_INPUT_MESSAGE
+
+    /** @brief    Enumeration of the kinds of user callbacks the callback dispatch pool (OPTION_CALLBACK_DISPATCH_THREADS)
+    *             keeps in order. Callbacks of one category run one at a time; different categories run in parallel.
+    *             Input messages are ordered per input queue.
+    */
+    MU_DEFINE_ENUM_WITHOUT_INVALID(IOTHUB_CLIENT_CALLBACK_CATEGORY, IOTHUB_CLIENT_CALLBACK_CATEGORY_VALUES);
+
+    /** @brief    This struct captures the activity of one callback category of the callback dispatch pool. */
+    typedef struct IOTHUB_CLIENT_CALLBACK_DISPATCH_STATISTICS_TAG
+    {
+        /** @brief    Number of callbacks waiting for or running on the pool. */
+        uint64_t queue_depth;
+
+        /** @brief    Highest queue_depth seen. */
+        uint64_t max_queue_depth;
+
+        /** @brief    Number of callbacks that returned. */
+        uint64_t dispatched_callbacks;
+
+        /** @brief    Sum, in milliseconds, of the time from queueing each dispatched callback to its return. */
+        uint64_t total_latency_ms;
+
+        /** @brief    Longest time, in milliseconds, from queueing a callback to its return. */
+        uint64_t max_latency_ms;
+    } IOTHUB_CLIENT_CALLBACK_DISPATCH_STATISTICS;
+
     /** @brief    This struct captures IoTHub client configuration. */
     typedef struct IOTHUB_CLIENT_CONFIG_TAG
     {
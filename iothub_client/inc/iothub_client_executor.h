@@ -0,0 +1,75 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_executor.h
+*    @brief   A pool of worker threads shared by many convenience layer clients.
+*
+*    @details By default every client created without a shared transport starts its own worker thread.
+*             Applications hosting many device identities can instead create one executor and hand it
+*             to each client through the OPTION_CLIENT_EXECUTOR option before the client starts working.
+*             The executor runs the DoWork of all attached clients, and dispatches their callbacks, from a
+*             fixed number of threads ordered by a single timer heap, so the number of threads no longer
+*             grows with the number of clients.
+*/
+
+#ifndef IOTHUB_CLIENT_EXECUTOR_H
+#define IOTHUB_CLIENT_EXECUTOR_H
+
+#include <stddef.h>
+#include "umock_c/umock_c_prod.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct IOTHUB_CLIENT_EXECUTOR_TAG* IOTHUB_CLIENT_EXECUTOR_HANDLE;
+    typedef struct IOTHUB_CLIENT_EXECUTOR_ENTRY_TAG* IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE;
+
+    /** @brief  Function run by the executor on behalf of a registered client. It returns the number of
+    *           milliseconds after which it wants to run again.
+    */
+    typedef tickcounter_ms_t(*IOTHUB_CLIENT_EXECUTOR_WORK_FUNCTION)(void* context);
+
+    /**
+    * @brief    Creates an executor running @p workerCount threads.
+    *
+    * @param    workerCount     Number of worker threads. Must be greater than 0.
+    *
+    * @return   A non-NULL handle upon success or NULL upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_EXECUTOR_HANDLE, IoTHubClientExecutor_Create, size_t, workerCount);
+
+    /**
+    * @brief    Stops the worker threads and frees the executor. All the clients using the executor
+    *           shall be destroyed before calling this function.
+    *
+    * @param    executorHandle  The handle created by a call to IoTHubClientExecutor_Create.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientExecutor_Destroy, IOTHUB_CLIENT_EXECUTOR_HANDLE, executorHandle);
+
+    /**
+    * @brief    Schedules @p workFunction to run as soon as a worker thread is available, and then
+    *           again after the delay it returns each time. A given entry never runs on two threads at once.
+    *
+    * @return   A non-NULL entry handle upon success or NULL upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE, IoTHubClientExecutor_Register, IOTHUB_CLIENT_EXECUTOR_HANDLE, executorHandle, IOTHUB_CLIENT_EXECUTOR_WORK_FUNCTION, workFunction, void*, context);
+
+    /**
+    * @brief    Makes the entry due immediately. If the entry is running it runs again as soon as it returns.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientExecutor_Wake, IOTHUB_CLIENT_EXECUTOR_HANDLE, executorHandle, IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE, entryHandle);
+
+    /**
+    * @brief    Removes the entry, waiting for its work function to return if it is running. Shall not be
+    *           called from the work function itself.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientExecutor_Unregister, IOTHUB_CLIENT_EXECUTOR_HANDLE, executorHandle, IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE, entryHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_EXECUTOR_H */
@@ -4,6 +4,8 @@
 #ifndef IOTHUB_CLIENT_OPTIONS_H
 #define IOTHUB_CLIENT_OPTIONS_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/const_defines.h"
 
 #ifdef __cplusplus
@@ -18,6 +20,73 @@ extern "C"
         const char* password;
     } IOTHUB_PROXY_OPTIONS;
 
+#define IOTHUB_MQTT_PUBACK_LATENCY_BUCKET_COUNT     14
+#define IOTHUB_MQTT_PUBACK_LATENCY_FIRST_BUCKET_MS  8
+
+    /** @brief    QoS 1 telemetry counters of the MQTT transport, read with the GetOption call of the client and OPTION_MQTT_PUBLISH_STATISTICS. */
+    typedef struct IOTHUB_MQTT_PUBLISH_STATISTICS_TAG
+    {
+        /** @brief    Telemetry PUBLISHes waiting for their PUBACK. */
+        size_t in_flight;
+
+        /** @brief    Highest in_flight seen. */
+        size_t max_in_flight;
+
+        /** @brief    PUBACKs received for telemetry. */
+        size_t pubacks;
+
+        /** @brief    PUBLISHes sent again because their PUBACK did not arrive within OPTION_MQTT_PUBLISH_TIMEOUT_SECS. */
+        size_t resends;
+
+        /** @brief    Messages completed with IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT after running out of resends. */
+        size_t timeouts;
+
+        /** @brief    Histogram of the time from the last PUBLISH of a message to its PUBACK. Bucket i counts the round trips shorter
+        *             than IOTHUB_MQTT_PUBACK_LATENCY_FIRST_BUCKET_MS << i milliseconds not counted by a previous bucket; the last bucket counts all the slower ones. */
+        size_t puback_latency_ms[IOTHUB_MQTT_PUBACK_LATENCY_BUCKET_COUNT];
+    } IOTHUB_MQTT_PUBLISH_STATISTICS;
+
+    /** @brief    C2D polling counters of the HTTP transport, read with the GetOption call of the client and OPTION_HTTP_POLLING_STATISTICS. */
+    typedef struct IOTHUB_HTTP_POLLING_STATISTICS_TAG
+    {
+        /** @brief    GETs answered with a C2D message. */
+        size_t message_polls;
+
+        /** @brief    GETs that found no C2D message waiting. */
+        size_t empty_polls;
+
+        /** @brief    GETs that failed or were answered with a status code other than 200 and 204. */
+        size_t failed_polls;
+    } IOTHUB_HTTP_POLLING_STATISTICS;
+
+#define IOTHUB_AMQP_CBS_LATENCY_BUCKET_COUNT     14
+#define IOTHUB_AMQP_CBS_LATENCY_FIRST_BUCKET_MS  8
+
+    /** @brief    CBS put-token counters of the AMQP transport, shared by all its devices, read with the GetOption call of the client and OPTION_AMQP_CBS_STATISTICS. */
+    typedef struct IOTHUB_AMQP_CBS_STATISTICS_TAG
+    {
+        /** @brief    SAS tokens put to CBS and waiting for the answer. */
+        size_t put_tokens_in_flight;
+
+        /** @brief    Highest put_tokens_in_flight seen. */
+        size_t max_put_tokens_in_flight;
+
+        /** @brief    SAS tokens accepted by CBS. */
+        size_t put_tokens;
+
+        /** @brief    SAS tokens rejected by CBS, or not answered within OPTION_CBS_REQUEST_TIMEOUT. */
+        size_t failed_put_tokens;
+
+        /** @brief    Histogram of the time from putting a SAS token to CBS accepting it. Bucket i counts the round trips shorter
+        *             than IOTHUB_AMQP_CBS_LATENCY_FIRST_BUCKET_MS << i milliseconds not counted by a previous bucket; the last bucket counts all the slower ones. */
+        size_t put_token_latency_ms[IOTHUB_AMQP_CBS_LATENCY_BUCKET_COUNT];
+
+        /** @brief    Percentiles of put_token_latency_ms, as the upper bound of the bucket they fall in (the lower bound for the last bucket). 0 until a token is accepted. */
+        uint64_t put_token_latency_p50_ms;
+        uint64_t put_token_latency_p90_ms;
+        uint64_t put_token_latency_p99_ms;
+    } IOTHUB_AMQP_CBS_STATISTICS;
+
     static STATIC_VAR_UNUSED const char* OPTION_RETRY_INTERVAL_SEC = "retry_interval_sec";
     static STATIC_VAR_UNUSED const char* OPTION_RETRY_MAX_DELAY_SECS = "retry_max_delay_secs";
 
@@ -38,12 +107,49 @@ extern "C"
     static STATIC_VAR_UNUSED const char* OPTION_CBS_REQUEST_TIMEOUT = "cbs_request_timeout";
 
     static STATIC_VAR_UNUSED const char* OPTION_MIN_POLLING_TIME = "MinimumPollingTime";
+
+    /*
+    * @brief    Turns on adaptive polling when above OPTION_MIN_POLLING_TIME (0, the default, leaves it off). The time in seconds between the C2D GETs of a device then doubles every time no message is waiting, up to this value, and goes back to OPTION_MIN_POLLING_TIME when a message arrives.
+    * NOTE: Each wait is stretched by up to 10% at random so that the devices of a multiplexed transport do not poll together.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_MAX_POLLING_TIME = "MaximumPollingTime";
+
+    /*
+    * @brief    Read only: GetOption copies the C2D polling counters of the transport into the IOTHUB_HTTP_POLLING_STATISTICS pointed to by value.
+    *           Only valid for use with HTTP Transport
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_HTTP_POLLING_STATISTICS = "http_polling_statistics";
+
     static STATIC_VAR_UNUSED const char* OPTION_BATCHING = "Batching";
 
+    /*
+    * @brief    Set how many connections the HTTP transport keeps open to the IoT Hub (1 to 8, default 1). With more than one, the event POST and the C2D GET of every device are sent at the same time, each over a free connection.
+    * NOTE: Values above 1 start a thread per connection in use during DoWork. Callbacks are still called from DoWork, one after the other.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_HTTP_CONNECTIONS = "http_connections";
+
     /* DEPRECATED:: OPTION_MESSAGE_TIMEOUT is DEPRECATED! Use OPTION_SERVICE_SIDE_KEEP_ALIVE_FREQ_SECS for AMQP; MQTT has no option available. OPTION_MESSAGE_TIMEOUT legacy variable will be kept for back-compat.  */
     static STATIC_VAR_UNUSED const char* OPTION_MESSAGE_TIMEOUT = "messageTimeout";
     static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_TIMEOUT_SECS = "blob_upload_timeout_secs";
 
+    /*
+    * @brief    Set how many blocks of a file upload are sent at the same time, each over its own connection to Azure Storage (1 to 16, default 1).
+    * NOTE: Values above 1 start one thread per block in flight and keep a copy of each block until storage has acknowledged it.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_CONCURRENCY = "blob_upload_concurrency";
+
+    /*
+    * @brief    Set the path prefix of the files journaling the blocks of an upload that storage has accepted, so that uploading the same blob again after a failure skips them.
+    * NOTE: Each destination blob has its own journal file, the prefix followed by '.' and 16 hex digits. The journal is deleted once the upload completes. Each block is hashed to check it has not changed since it was journaled.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_JOURNAL = "blob_upload_journal";
+
+    /*
+    * @brief    Set to true to gzip files uploaded with IoTHubDeviceClient_LL_UploadFileToBlob as they are sent. The blob is stored with a Content-Encoding of gzip.
+    * NOTE: Needs the SDK built with use_blob_compression (zlib). Uploads from a callback or from memory are never compressed.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_GZIP = "blob_upload_gzip";
+
     /*
     * @brief    Set the interface name to use as outgoing network interface for upload to blob.
     * NOTE: Not all HTTP clients support this option. It is currently only supported when using cURL.
@@ -61,6 +167,31 @@ extern "C"
     */
     static STATIC_VAR_UNUSED const char* OPTION_AUTO_URL_ENCODE_DECODE = "auto_url_encode_decode";
 
+    /*
+    * @brief    Keeps the properties part of the telemetry topics of the last size_t* value property sets (up to 64), so messages
+    *           repeating the properties of a recent one are not encoded again. Message and correlation ids are written for each message
+    *           and do not count as properties here. 0 (the default) turns the cache off. Only valid for use with MQTT Transport
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_MQTT_TOPIC_CACHE_SIZE = "mqtt_topic_cache_size";
+
+    /*
+    * @brief    Maximum number of telemetry messages (size_t* value, 1 to 256, 256 by default) PUBLISHed and waiting for their PUBACK.
+    *           Further messages stay queued, and the send status BUSY, until PUBACKs arrive. Only valid for use with MQTT Transport
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_MQTT_MAX_INFLIGHT_MESSAGES = "mqtt_max_inflight_messages";
+
+    /*
+    * @brief    Seconds (size_t* value, 60 by default) to wait for the PUBACK of a telemetry message before PUBLISHing it again.
+    *           Only valid for use with MQTT Transport
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_MQTT_PUBLISH_TIMEOUT_SECS = "mqtt_publish_timeout_secs";
+
+    /*
+    * @brief    Read only: GetOption copies the telemetry counters of the transport into the IOTHUB_MQTT_PUBLISH_STATISTICS pointed to by value.
+    *           Only valid for use with MQTT Transport
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_MQTT_PUBLISH_STATISTICS = "mqtt_publish_statistics";
+
     /*
     * @brief Informs the service of what is the maximum period the client will wait for a keep-alive message from the service.
     *        The service must send keep-alives before this timeout is reached, otherwise the client will trigger its re-connection logic.
@@ -89,11 +220,83 @@ extern "C"
     */
     static STATIC_VAR_UNUSED const char* OPTION_EVENT_SEND_TIMEOUT_SECS = "event_send_timeout_secs";
 
+    /*
+    * @brief    Milliseconds (size_t* value, 0 by default) telemetry messages wait for more messages to be sent along with
+    *           them, as a producer's linger.ms does. The wait ends early once OPTION_TELEMETRY_BATCH_BYTES of payload are queued.
+    *           Over AMQP the messages waiting are sent in one batch; over MQTT their PUBLISHes go out together.
+    *           Only valid for use with AMQP and MQTT Transports
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TELEMETRY_LINGER_MS = "telemetry_linger_ms";
+
+    /*
+    * @brief    Bytes of queued telemetry payload (size_t* value, 16384 by default) that end the wait of OPTION_TELEMETRY_LINGER_MS.
+    *           Only valid for use with AMQP and MQTT Transports
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TELEMETRY_BATCH_BYTES = "telemetry_batch_bytes";
+
+    /*
+    * @brief    Milliseconds (size_t* value, 0 by default for off) reported-property patches sent with SendReportedState wait
+    *           for more patches. The patches sent in that time are merged into one PATCH, the last one written winning for
+    *           every property, and the callback of each of them gets the status code of that PATCH.
+    *           A patch that is not a JSON object is sent on its own, after the patches sent before it.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TWIN_REPORTED_COALESCE_MS = "twin_reported_coalesce_ms";
+
+    /*
+    * @brief    Keeps a local copy of the device or module twin (bool* value, false by default), read with GetCachedTwin.
+    *           The desired-property patches received through the twin callback are merged into it as they come,
+    *           and the full twin is fetched again only when their $version shows a patch was missed. The reported
+    *           properties are the ones of the last full twin received.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_TWIN_CACHE = "twin_cache";
+
+    /*
+    * @brief    Maximum number of SAS tokens (size_t* value, 0 by default for no limit) the devices of the transport put to CBS
+    *           at the same time. Devices whose token is due wait their turn in DoWork.
+    *           Only valid for use with AMQP Transport
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_AMQP_CBS_MAX_PUT_TOKENS_IN_FLIGHT = "amqp_cbs_max_put_tokens_in_flight";
+
+    /*
+    * @brief    Read only: GetOption copies the CBS put-token counters of the transport into the IOTHUB_AMQP_CBS_STATISTICS pointed to by value.
+    *           Only valid for use with AMQP Transport
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_AMQP_CBS_STATISTICS = "amqp_cbs_statistics";
+
     //diagnostic sampling percentage value, [0-100]
     static STATIC_VAR_UNUSED const char* OPTION_DIAGNOSTIC_SAMPLING_PERCENTAGE = "diag_sampling_percentage";
 
     static STATIC_VAR_UNUSED const char* OPTION_DO_WORK_FREQUENCY_IN_MS = "do_work_freq_ms";
 
+    /*
+    * @brief Switches the convenience layer worker thread to wake-on-work mode: instead of sleeping do_work_freq_ms between
+    *        every DoWork it blocks until an API call queues work, waking at most every value (tickcounter_ms_t*) milliseconds
+    *        while nothing is in flight. 0 (the default) keeps the polling behavior.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_WAKE_ON_WORK_MAX_IDLE_MS = "wake_on_work_max_idle_ms";
+
+    /*
+    * @brief Runs the DoWork of the client on the threads of an IOTHUB_CLIENT_EXECUTOR_HANDLE (passed directly as value)
+    *        instead of a thread owned by the client. Must be set before the first call that starts the worker thread.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_CLIENT_EXECUTOR = "client_executor";
+
+    /*
+    * @brief Queues the callbacks of the client in a ring of size_t* value records allocated once, instead of a list
+    *        reallocated on every DoWork. Callbacks arriving while the ring is full wait in that
+    *        list instead, so none is lost.
+    *        Must be set before the first call that starts the worker thread.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_USER_CALLBACK_RING_CAPACITY = "user_callback_ring_capacity";
+
+    /*
+    * @brief Runs the user callbacks of the client on a pool of size_t* value threads instead of the worker thread.
+    *        Callbacks of the same IOTHUB_CLIENT_CALLBACK_CATEGORY (and input messages of the same input) keep their
+    *        order, while different categories run in parallel. When the pool falls behind, the worker thread waits for it
+    *        rather than dropping callbacks. Must be set before the first call that starts the worker thread.
+    */
+    static STATIC_VAR_UNUSED const char* OPTION_CALLBACK_DISPATCH_THREADS = "callback_dispatch_threads";
+
 // Minimum percentage (in the 0 to 1 range) of multiplexed registered devices that must be failing for a transport-wide reconnection to be triggered.
 // A value of zero results in a single registered device to be able to cause a general transport reconnection 
 // (thus causing all other multiplexed registered devices to be also reconnected, meaning an agressive reconnection strategy).
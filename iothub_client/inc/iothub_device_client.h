@@ -128,6 +128,28 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_SendEventAsync, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Asynchronous call to send the message specified by @p eventMessageHandle, taking
+    *           ownership of it instead of copying it.
+    *
+    * @param    iotHubClientHandle              The handle created by a call to the create function.
+    * @param    eventMessageHandle              The handle to an IoT Hub message, for instance one created by
+    *                                           IoTHubMessage_CreateFromBuffer so its payload is not copied either.
+    * @param    eventConfirmationCallback       The callback specified by the device for receiving
+    *                                           confirmation of the delivery of the IoT Hub message.
+    *                                           The user can specify a @c NULL value here to
+    *                                           indicate that no callback is required.
+    * @param    userContextCallback             User specified context that will be provided to the
+    *                                           callback. This can be @c NULL.
+    *
+    * @remarks
+    *           On success the client owns @p eventMessageHandle: the application must neither use nor destroy it
+    *           afterwards. The client destroys it when the message is effectively sent, if a failure sending it occurs,
+    *           or if the client is destroyed. On failure the application keeps the ownership of @p eventMessageHandle.
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_SendEventAsyncMove, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
     /**
     * @brief    This function returns the current sending status for IoTHubClient.
     *
@@ -228,6 +250,32 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_GetLastMessageReceiveTime, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, time_t*, lastMessageReceiveTime);
 
+    /**
+    * @brief    This function returns in the out parameter @p workerStatistics the counters
+    *           describing the activity of the worker thread of the client (DoWork calls,
+    *           wakeups and time spent idle).
+    *
+    * @param    iotHubClientHandle      The handle created by a call to the create function.
+    * @param    workerStatistics        Out parameter receiving a copy of the counters.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_GetWorkerStatistics, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_WORKER_STATISTICS*, workerStatistics);
+
+    /**
+    * @brief    This function returns in the out parameter @p dispatchStatistics the queue depth
+    *           and latency counters of one category of callbacks run by the callback dispatch
+    *           pool (see OPTION_CALLBACK_DISPATCH_THREADS).
+    *
+    * @param    iotHubClientHandle      The handle created by a call to the create function.
+    * @param    category                The category of callbacks.
+    * @param    dispatchStatistics      Out parameter receiving a copy of the counters.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure, including when the
+    *           client does not use a callback dispatch pool.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_GetCallbackDispatchStatistics, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_CALLBACK_CATEGORY, category, IOTHUB_CLIENT_CALLBACK_DISPATCH_STATISTICS*, dispatchStatistics);
+
     /**
     * @brief    This API sets a runtime option identified by parameter @p optionName
     *           to a value pointed to by @p value. @p optionName and the data type
@@ -243,6 +291,22 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_SetOption, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, const char*, optionName, const void*, value);
 
+    /**
+    * @brief    This API copies the value of a read-only option identified by parameter
+    *           @p optionName into the memory pointed to by @p value, such as the
+    *           statistics of the transport. The data type @p value is pointing to is
+    *           specific for every option.
+    *
+    * @param    iotHubClientHandle      The handle created by a call to the create function.
+    * @param    optionName              Name of the option.
+    * @param    value                   Receives the value.
+    *
+    * @remarks  Documentation for configuration options is available at https://github.com/Azure/azure-iot-sdk-c/blob/master/doc/Iothub_sdk_options.md.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_GetOption, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, const char*, optionName, void*, value);
+
     /**
     * @brief    This API specifies a callback to be used when the device receives a state update.
     *
@@ -296,6 +360,21 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_GetTwinAsync, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, deviceTwinCallback, void*, userContextCallback);
 
+    /**
+    * @brief    This API returns the device twin kept by the client, without a round trip to the IoT Hub.
+    *
+    * @param    iotHubClientHandle       The handle created by a call to the create function.
+    * @param    twin                     Receives the twin document (JSON, not NUL terminated), allocated by the client.
+    *                                    The caller must free it with @c free.
+    * @param    size                     Receives the size of the twin document.
+    *
+    *            @b NOTE: The twin is only kept once the "twin_cache" option is set, and holds the desired properties
+    *            received through the device twin callback set with IoTHubDeviceClient_SetDeviceTwinCallback.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure, also when no twin was received yet.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_GetCachedTwin, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, unsigned char**, twin, size_t*, size);
+
     /**
     * @brief    This API sets the callback for async cloud to device method calls.
     *
@@ -132,6 +132,28 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_DEVICE_CLIENT_LL_HA
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_SendEventAsync, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Asynchronous call to send the message specified by @p eventMessageHandle, taking
+    *           ownership of it instead of copying it.
+    *
+    * @param    iotHubClientHandle              The handle created by a call to the create function.
+    * @param    eventMessageHandle              The handle to an IoT Hub message, for instance one created by
+    *                                           IoTHubMessage_CreateFromBuffer so its payload is not copied either.
+    * @param    eventConfirmationCallback       The callback specified by the device for receiving
+    *                                           confirmation of the delivery of the IoT Hub message.
+    *                                           The user can specify a @c NULL value here to
+    *                                           indicate that no callback is required.
+    * @param    userContextCallback             User specified context that will be provided to the
+    *                                           callback. This can be @c NULL.
+    *
+    * @remarks
+    *           On success the client owns @p eventMessageHandle: the application must neither use nor destroy it
+    *           afterwards. The client destroys it when the message is effectively sent, if a failure sending it occurs,
+    *           or if the client is destroyed. On failure the application keeps the ownership of @p eventMessageHandle.
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_SendEventAsyncMove, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
     /**
     * @brief    This function returns the current sending status for IoTHubClient.
     *
@@ -262,6 +284,22 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_DEVICE_CLIENT_LL_HA
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_SetOption, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, optionName, const void*, value);
 
+    /**
+    * @brief    This API copies the value of a read-only option identified by parameter
+    *           @p optionName into the memory pointed to by @p value, such as the
+    *           statistics of the transport. The data type @p value is pointing to is
+    *           specific for every option.
+    *
+    * @param    iotHubClientHandle      The handle created by a call to the create function.
+    * @param    optionName              Name of the option.
+    * @param    value                   Receives the value.
+    *
+    * @remarks  Documentation for configuration options is available at https://github.com/Azure/azure-iot-sdk-c/blob/master/doc/Iothub_sdk_options.md.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_GetOption, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, optionName, void*, value);
+
     /**
     * @brief   This API specifies a callback to be used when the device receives a desired state update.
     *
@@ -314,6 +352,22 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_DEVICE_CLIENT_LL_HA
      */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_GetTwinAsync, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, deviceTwinCallback, void*, userContextCallback);
 
+     /**
+     * @brief	This API returns the device twin kept by the client, without a round trip to the IoT Hub.
+     *
+     * @param	iotHubClientHandle		The handle created by a call to the create function.
+     * @param	twin					Receives the twin document (JSON, not NUL terminated), allocated by the
+     *									client. The caller must free it with @c free.
+     * @param	size					Receives the size of the twin document.
+     *
+     *			@b NOTE: The twin is only kept once the "twin_cache" option is set, and holds the desired
+     *			properties received through the device twin callback set with
+     *			IoTHubDeviceClient_LL_SetDeviceTwinCallback.
+     *
+     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure, also when no twin was received yet.
+     */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_GetCachedTwin, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, unsigned char**, twin, size_t*, size);
+
      /**
      * @brief    This API sets the callback for async cloud to device method calls.
      *
@@ -372,6 +426,25 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_DEVICE_CLIENT_LL_HA
      */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_UploadMultipleBlocksToBlob, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX, getDataCallbackEx, void*, context);
 
+     /**
+     * @brief    This API uploads to Azure Storage the content of the local file @p sourceFileName
+     *           under the blob name devicename/@pdestinationFileName
+     *
+     * @param    iotHubClientHandle      The handle created by a call to the create function.
+     * @param    destinationFileName     name of the file.
+     * @param    sourceFileName          path of the local file to upload.
+     *
+     * @remark   Each block is read from the file straight into the request that uploads it, so the application does not
+     *           copy the file into memory and the memory used stays bounded by the upload concurrency times the block size
+     *           (4MB), whatever the size of the file.
+     *
+     * @warning  Other _LL_ functions such as IoTHubDeviceClient_LL_SendEventAsync queue work to be performed later and do not block.  IoTHubDeviceClient_LL_UploadFileToBlob
+     *           will block however until the upload is completed or fails, which may take a while.
+     *
+     * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+     */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_LL_UploadFileToBlob, IOTHUB_DEVICE_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, destinationFileName, const char*, sourceFileName);
+
 #endif /*DONT_USE_UPLOADTOBLOB*/
 
 #ifdef __cplusplus
@@ -53,6 +53,29 @@ typedef struct IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_TAG
 
 static const char DIAG_CREATION_TIME_UTC_PROPERTY_NAME[] = "diag_creation_time_utc";
 
+/** @brief  Handle to a pool of reusable messages, see ::IoTHubMessagePool_Create.
+*/
+typedef struct IOTHUB_MESSAGE_POOL_TAG* IOTHUB_MESSAGE_POOL_HANDLE;
+
+/** @brief  Counters of a message pool, see ::IoTHubMessagePool_GetStatistics.
+*/
+typedef struct IOTHUB_MESSAGE_POOL_STATISTICS_TAG
+{
+    /** @brief  Acquires served by a free pooled message. */
+    size_t hits;
+    /** @brief  Acquires that had to allocate a message. */
+    size_t misses;
+    /** @brief  Pooled messages freed on release instead of being reused. */
+    size_t discarded;
+    /** @brief  Pooled messages currently acquired. */
+    size_t inUse;
+} IOTHUB_MESSAGE_POOL_STATISTICS;
+
+/** @brief  Signature of the callback that gives back the application buffer of a message
+*           created by ::IoTHubMessage_CreateFromBuffer once the message is destroyed.
+*/
+typedef void(*IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK)(const unsigned char* buffer, void* userContext);
+
 /**
 * @brief   Creates a new IoT hub message from a byte array. The type of the
 *          message will be set to @c IOTHUBMESSAGE_BYTEARRAY.
@@ -65,6 +88,26 @@ static const char DIAG_CREATION_TIME_UTC_PROPERTY_NAME[] = "diag_creation_time_u
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromByteArray, const unsigned char*, byteArray, size_t, size);
 
+/**
+* @brief   Creates a new IoT hub message that uses @p buffer as its payload without
+*          copying it. The type of the message will be set to @c IOTHUBMESSAGE_BYTEARRAY.
+*
+* @param   buffer              The payload of the message. It must stay valid and unchanged
+*                              until @p bufferFreeCallback is called.
+* @param   size                The size of the payload.
+* @param   bufferFreeCallback  Called with @p buffer and @p userContext when the message is
+*                              destroyed. Can be @c NULL if the application manages the
+*                              lifetime of @p buffer on its own.
+* @param   userContext         User specified context passed to @p bufferFreeCallback.
+*
+* @remarks Clones of the message copy the payload and do not call @p bufferFreeCallback.
+*          If this function fails the application keeps the ownership of @p buffer.
+*
+* @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
+*          created or @c NULL in case an error occurs.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromBuffer, const unsigned char*, buffer, size_t, size, IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK, bufferFreeCallback, void*, userContext);
+
 /**
 * @brief   Creates a new IoT hub message from a null terminated string.  The
 *          type of the message will be set to @c IOTHUBMESSAGE_STRING.
@@ -440,6 +483,70 @@ MOCKABLE_FUNCTION(, bool, IoTHubMessage_IsSecurityMessage, IOTHUB_MESSAGE_HANDLE
 */
 MOCKABLE_FUNCTION(, void, IoTHubMessage_Destroy, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
 
+/**
+* @brief   Creates a pool of @p capacity messages that are reused instead of being
+*          allocated and freed for every message sent.
+*
+*          The message block, its payload storage and the storage of its system properties
+*          are reused. Application properties are not: they are freed when the message is
+*          released, and the message gets an empty property map.
+*
+* @param   capacity        Number of messages kept by the pool. They are allocated up front.
+* @param   maxPayloadSize  Largest payload a pooled message can hold. Its storage is part of
+*                          the message, so larger payloads get a regular message.
+* @param   maxProperties   Largest number of application properties a pooled message is
+*                          reused with. Messages released with more are freed.
+*
+* @return  A handle to the pool or NULL in case an error occurred.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_POOL_HANDLE, IoTHubMessagePool_Create, size_t, capacity, size_t, maxPayloadSize, size_t, maxProperties);
+
+/**
+* @brief   Returns a message of type ::IOTHUBMESSAGE_BYTEARRAY holding a copy of @p byteArray,
+*          taken from the pool when one is free and @p size fits, allocated otherwise.
+*
+*          The message behaves like one created by ::IoTHubMessage_CreateFromByteArray and can be
+*          given to any SendEventAsync flavor, of the LL or the convenience layer. Destroying it,
+*          by ::IoTHubMessagePool_Release, ::IoTHubMessage_Destroy or by the SDK once a moved
+*          message is sent, resets it and returns it to the pool.
+*
+* @param   poolHandle  Handle to the pool.
+* @param   byteArray   Pointer to the payload, can be NULL if @p size is 0.
+* @param   size        Size of the payload.
+*
+* @return  A handle to the message or NULL in case an error occurred.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessagePool_Acquire, IOTHUB_MESSAGE_POOL_HANDLE, poolHandle, const unsigned char*, byteArray, size_t, size);
+
+/**
+* @brief   Gives a message obtained from ::IoTHubMessagePool_Acquire back to the pool.
+*
+* @param   poolHandle          Handle to the pool.
+* @param   iotHubMessageHandle Handle to the message.
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the message was released, or IOTHUB_MESSAGE_INVALID_ARG
+*          if it belongs to another pool.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessagePool_Release, IOTHUB_MESSAGE_POOL_HANDLE, poolHandle, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+
+/**
+* @brief   Gets the hit and miss counters of the pool.
+*
+* @param   poolHandle  Handle to the pool.
+* @param   statistics  Receives the counters.
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the counters were copied, an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessagePool_GetStatistics, IOTHUB_MESSAGE_POOL_HANDLE, poolHandle, IOTHUB_MESSAGE_POOL_STATISTICS*, statistics);
+
+/**
+* @brief   Destroys the pool. Messages still acquired stay valid, the pool is freed when the
+*          last of them is released.
+*
+* @param   poolHandle  Handle to the pool.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubMessagePool_Destroy, IOTHUB_MESSAGE_POOL_HANDLE, poolHandle);
+
 #ifdef __cplusplus
 }
 #endif
@@ -86,6 +86,28 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_SendEventAsync, IOTHUB_MODULE_CLIENT_HANDLE, iotHubModuleClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Asynchronous call to send the message specified by @p eventMessageHandle, taking
+    *           ownership of it instead of copying it.
+    *
+    * @param    iotHubModuleClientHandle        The handle created by a call to the create function.
+    * @param    eventMessageHandle              The handle to an IoT Hub message, for instance one created by
+    *                                           IoTHubMessage_CreateFromBuffer so its payload is not copied either.
+    * @param    eventConfirmationCallback       The callback specified by the device for receiving
+    *                                           confirmation of the delivery of the IoT Hub message.
+    *                                           The user can specify a @c NULL value here to
+    *                                           indicate that no callback is required.
+    * @param    userContextCallback             User specified context that will be provided to the
+    *                                           callback. This can be @c NULL.
+    *
+    * @remarks
+    *           On success the client owns @p eventMessageHandle: the application must neither use nor destroy it
+    *           afterwards. The client destroys it when the message is effectively sent, if a failure sending it occurs,
+    *           or if the client is destroyed. On failure the application keeps the ownership of @p eventMessageHandle.
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_SendEventAsyncMove, IOTHUB_MODULE_CLIENT_HANDLE, iotHubModuleClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
     /**
     * @brief    This function returns the current sending status for IoTHubModuleClient.
     *
@@ -180,6 +202,32 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_GetLastMessageReceiveTime, IOTHUB_MODULE_CLIENT_HANDLE, iotHubModuleClientHandle, time_t*, lastMessageReceiveTime);
 
+    /**
+    * @brief    This function returns in the out parameter @p workerStatistics the counters
+    *           describing the activity of the worker thread of the client (DoWork calls,
+    *           wakeups and time spent idle).
+    *
+    * @param    iotHubModuleClientHandle    The handle created by a call to the create function.
+    * @param    workerStatistics            Out parameter receiving a copy of the counters.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_GetWorkerStatistics, IOTHUB_MODULE_CLIENT_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_WORKER_STATISTICS*, workerStatistics);
+
+    /**
+    * @brief    This function returns in the out parameter @p dispatchStatistics the queue depth
+    *           and latency counters of one category of callbacks run by the callback dispatch
+    *           pool (see OPTION_CALLBACK_DISPATCH_THREADS).
+    *
+    * @param    iotHubModuleClientHandle    The handle created by a call to the create function.
+    * @param    category                    The category of callbacks.
+    * @param    dispatchStatistics          Out parameter receiving a copy of the counters.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure, including when the
+    *           client does not use a callback dispatch pool.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_GetCallbackDispatchStatistics, IOTHUB_MODULE_CLIENT_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_CALLBACK_CATEGORY, category, IOTHUB_CLIENT_CALLBACK_DISPATCH_STATISTICS*, dispatchStatistics);
+
     /**
     * @brief    This API sets a runtime option identified by parameter @p optionName
     *             to a value pointed to by @p value. @p optionName and the data type
@@ -196,6 +244,22 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_SetOption, IOTHUB_MODULE_CLIENT_HANDLE, iotHubModuleClientHandle, const char*, optionName, const void*, value);
 
+    /**
+    * @brief    This API copies the value of a read-only option identified by parameter
+    *           @p optionName into the memory pointed to by @p value, such as the
+    *           statistics of the transport. The data type @p value is pointing to is
+    *           specific for every option.
+    *
+    * @param    iotHubModuleClientHandle      The handle created by a call to the create function.
+    * @param    optionName                    Name of the option.
+    * @param    value                         Receives the value.
+    *
+    * @remarks  Documentation for configuration options is available at https://github.com/Azure/azure-iot-sdk-c/blob/master/doc/Iothub_sdk_options.md.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_GetOption, IOTHUB_MODULE_CLIENT_HANDLE, iotHubModuleClientHandle, const char*, optionName, void*, value);
+
     /**
     * @brief    This API specifies a call back to be used when the module receives a state update.
     *
@@ -249,6 +313,21 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_GetTwinAsync, IOTHUB_MODULE_CLIENT_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, moduleTwinCallback, void*, userContextCallback);
 
+    /**
+    * @brief    This API returns the module twin kept by the client, without a round trip to the IoT Hub.
+    *
+    * @param    iotHubModuleClientHandle    The handle created by a call to the create function.
+    * @param    twin                        Receives the twin document (JSON, not NUL terminated), allocated by the client.
+    *                                       The caller must free it with @c free.
+    * @param    size                        Receives the size of the twin document.
+    *
+    *            @b NOTE: The twin is only kept once the "twin_cache" option is set, and holds the desired properties
+    *            received through the module twin callback set with IoTHubModuleClient_SetModuleTwinCallback.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure, also when no twin was received yet.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_GetCachedTwin, IOTHUB_MODULE_CLIENT_HANDLE, iotHubModuleClientHandle, unsigned char**, twin, size_t*, size);
+
     /**
     * @brief    This API sets callback for async cloud to module method call.
     *
@@ -99,6 +99,28 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SendEventAsync, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Asynchronous call to send the message specified by @p eventMessageHandle, taking
+    *           ownership of it instead of copying it.
+    *
+    * @param    iotHubModuleClientHandle        The handle created by a call to the create function.
+    * @param    eventMessageHandle              The handle to an IoT Hub message, for instance one created by
+    *                                           IoTHubMessage_CreateFromBuffer so its payload is not copied either.
+    * @param    eventConfirmationCallback       The callback specified by the device for receiving
+    *                                           confirmation of the delivery of the IoT Hub message.
+    *                                           The user can specify a @c NULL value here to
+    *                                           indicate that no callback is required.
+    * @param    userContextCallback             User specified context that will be provided to the
+    *                                           callback. This can be @c NULL.
+    *
+    * @remarks
+    *           On success the client owns @p eventMessageHandle: the application must neither use nor destroy it
+    *           afterwards. The client destroys it when the message is effectively sent, if a failure sending it occurs,
+    *           or if the client is destroyed. On failure the application keeps the ownership of @p eventMessageHandle.
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SendEventAsyncMove, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
     /**
     * @brief    This function returns the current sending status for IoTHubModuleClient.
     *
@@ -221,6 +243,22 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SetOption, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, const char*, optionName, const void*, value);
 
+    /**
+    * @brief    This API copies the value of a read-only option identified by parameter
+    *           @p optionName into the memory pointed to by @p value, such as the
+    *           statistics of the transport. The data type @p value is pointing to is
+    *           specific for every option.
+    *
+    * @param    iotHubModuleClientHandle      The handle created by a call to the create function.
+    * @param    optionName                    Name of the option.
+    * @param    value                         Receives the value.
+    *
+    * @remarks  Documentation for configuration options is available at https://github.com/Azure/azure-iot-sdk-c/blob/master/doc/Iothub_sdk_options.md.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetOption, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, const char*, optionName, void*, value);
+
     /**
     * @brief    This API specifies a call back to be used when the module receives a desired state update.
     *
@@ -273,6 +311,22 @@ extern "C"
      */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetTwinAsync, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, deviceTwinCallback, void*, userContextCallback);
 
+     /**
+     * @brief	This API returns the module twin kept by the client, without a round trip to the IoT Hub.
+     *
+     * @param	iotHubModuleClientHandle	The handle created by a call to the create function.
+     * @param	twin	                    Receives the twin document (JSON, not NUL terminated), allocated by the
+     *	                                    client. The caller must free it with @c free.
+     * @param	size	                    Receives the size of the twin document.
+     *
+     *			@b NOTE: The twin is only kept once the "twin_cache" option is set, and holds the desired
+     *			properties received through the module twin callback set with
+     *			IoTHubModuleClient_LL_SetModuleTwinCallback.
+     *
+     * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure, also when no twin was received yet.
+     */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetCachedTwin, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, unsigned char**, twin, size_t*, size);
+
      /**
      * @brief    This API sets callback for async cloud to module method call.
      *
@@ -33,6 +33,23 @@ MOCKABLE_FUNCTION(, TRANSPORT_HANDLE, IoTHubTransport_Create, IOTHUB_CLIENT_TRAN
 MOCKABLE_FUNCTION(, void, IoTHubTransport_Destroy, TRANSPORT_HANDLE, transportHandle);
 MOCKABLE_FUNCTION(, TRANSPORT_LL_HANDLE, IoTHubTransport_GetLLTransport, TRANSPORT_HANDLE, transportHandle);
 
+/**
+* @brief    Runs the per client work (callback dispatch) of the clients sharing @p transportHandle on
+*           @p workerCount dedicated threads. Each thread dispatches the callbacks of its share of the clients,
+*           while the network I/O of the shared connection always stays on the transport worker thread.
+*           The clients still take the transport lock for their work, so the worker threads can wait on each
+*           other and on the transport worker thread.
+*
+* @param    transportHandle     The shared transport.
+* @param    workerCount         Number of client worker threads, or 0 (the default) to run the clients on
+*                               the transport worker thread.
+*
+* @remarks  Must be called before the first client using @p transportHandle is started.
+*
+* @return   0 on success, a non-zero value otherwise.
+*/
+MOCKABLE_FUNCTION(, int, IoTHubTransport_SetClientWorkerCount, TRANSPORT_HANDLE, transportHandle, size_t, workerCount);
+
 #ifdef __cplusplus
 }
 #endif
@@ -2,21 +2,204 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "internal/blob.h"
+#include "internal/blob_upload_journal.h"
+#include "internal/blob_block_sizer.h"
 #include "internal/iothub_client_ll_uploadtoblob.h"
 
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/azure_base64.h"
 #include "azure_c_shared_utility/shared_util_options.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#ifdef USE_BLOB_COMPRESSION
+#include <zlib.h>
+#endif
 
 static const char blockListXmlBegin[]  = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>";
 static const char blockListXmlEnd[] = "</BlockList>";
 static const char blockListUriMarker[] = "&comp=blocklist";
 
+/*a block is sent this many times at most while storage answers with a transient failure*/
+#define BLOB_BLOCK_MAX_ATTEMPTS     3
+#define BLOB_BLOCK_RETRY_DELAY_MS   500
+/*idle upload workers, and a block waiting for a free worker, re-check the upload state this often*/
+#define BLOB_UPLOAD_MAX_WAIT_MS     1000
+/*smallest block the block sizer may choose for a file*/
+#define BLOB_MIN_ADAPTIVE_BLOCK_SIZE    (64 * 1024)
+
+#ifdef USE_BLOB_COMPRESSION
+static const char gzipContentEncoding[] = "gzip";
+/*deflate with a gzip header and trailer, as a Content-Encoding of gzip expects*/
+#define GZIP_WINDOW_BITS            (15 + 16)
+#define GZIP_MEMORY_LEVEL           8
+/*the file is read this much at a time while it is compressed*/
+#define GZIP_INPUT_SIZE             (64 * 1024)
+#endif
+
+typedef struct BLOB_UPLOAD_BLOCK_TAG
+{
+    struct BLOB_UPLOAD_BLOCK_TAG* next;
+    unsigned int blockID;
+    BUFFER_HANDLE content;
+    STRING_HANDLE blockIdString;
+    /*set when hash holds the journal hash of content*/
+    bool hashed;
+    unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+} BLOB_UPLOAD_BLOCK;
+
+typedef struct BLOB_UPLOAD_WORKER_TAG
+{
+    struct BLOB_PARALLEL_UPLOAD_TAG* upload;
+    THREAD_HANDLE thread;
+    HTTPAPIEX_HANDLE httpApiExHandle;
+    /*status and response of the last block this worker sent*/
+    unsigned int httpStatus;
+    BUFFER_HANDLE httpResponse;
+    BLOB_RESULT result;
+    /*set, without the lock, by a worker that could not re-acquire it and exited*/
+    sig_atomic_t lost_lock;
+} BLOB_UPLOAD_WORKER;
+
+typedef struct BLOB_PARALLEL_UPLOAD_TAG
+{
+    LOCK_HANDLE lock;
+    COND_HANDLE block_queued;
+    COND_HANDLE block_done;
+    BLOB_UPLOAD_BLOCK* head;
+    BLOB_UPLOAD_BLOCK* tail;
+    /*blocks queued or being sent, never more than worker_count*/
+    size_t blocks_in_flight;
+    BLOB_UPLOAD_WORKER* workers;
+    size_t worker_count;
+    /*first worker whose block failed, its httpStatus and httpResponse are the ones reported*/
+    BLOB_UPLOAD_WORKER* failed_worker;
+    unsigned int last_http_status;
+    const char* relativePath;
+    BLOB_UPLOAD_JOURNAL_HANDLE journal;
+    /*NULL when the blocks have a fixed size. Used with the lock held*/
+    BLOB_BLOCK_SIZER_HANDLE sizer;
+    TICK_COUNTER_HANDLE tickCounter;
+    bool cancelled;
+    bool stop;
+} BLOB_PARALLEL_UPLOAD;
+
+// createBlockIdString produces the base64 encoded block id ("000000"... "049999") of the blockID-th block.
+static STRING_HANDLE createBlockIdString(unsigned int blockID)
+{
+    STRING_HANDLE result;
+    char temp[7]; /*this will contain 000000... 049999*/
+
+    if (sprintf(temp, "%6u", (unsigned int)blockID) != 6) /*produces 000000... 049999*/
+    {
+        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+        LogError("failed to sprintf");
+        result = NULL;
+    }
+    else if ((result = Azure_Base64_Encode_Bytes((const unsigned char*)temp, 6)) == NULL)
+    {
+        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+        LogError("unable to Azure_Base64_Encode_Bytes");
+    }
+
+    return result;
+}
+
+// appendBlockIdToList adds the base64 encoded block id to the XML committed by SendBlockIdList.
+static int appendBlockIdToList(STRING_HANDLE blockIDList, STRING_HANDLE blockIdString)
+{
+    int result;
+
+    if (!(
+        (STRING_concat(blockIDList, "<Latest>") == 0) &&
+        (STRING_concat_with_STRING(blockIDList, blockIdString) == 0) &&
+        (STRING_concat(blockIDList, "</Latest>") == 0)
+        ))
+    {
+        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+        LogError("unable to STRING_concat");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+// putBlock executes the Put Block request of one block. It does not touch the block list, so it can run on any connection.
+static BLOB_RESULT putBlock(HTTPAPIEX_HANDLE httpApiExHandle, const char* relativePath, BUFFER_HANDLE requestContent, STRING_HANDLE blockIdString, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
+{
+    BLOB_RESULT result;
+
+    /*Codes_SRS_BLOB_02_022: [ Blob_UploadMultipleBlocksFromSasUri shall construct a new relativePath from following string: base relativePath + "&comp=block&blockid=BASE64 encoded string of blockId" ]*/
+    STRING_HANDLE newRelativePath = STRING_construct(relativePath);
+    if (newRelativePath == NULL)
+    {
+        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+        LogError("unable to STRING_construct");
+        result = BLOB_ERROR;
+    }
+    else
+    {
+        if (!(
+            (STRING_concat(newRelativePath, "&comp=block&blockid=") == 0) &&
+            (STRING_concat_with_STRING(newRelativePath, blockIdString) == 0)
+            ))
+        {
+            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+            LogError("unable to STRING concatenate");
+            result = BLOB_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BLOB_02_024: [ Blob_UploadMultipleBlocksFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing httpStatus and httpResponse. ]*/
+            if (HTTPAPIEX_ExecuteRequest(
+                httpApiExHandle,
+                HTTPAPI_REQUEST_PUT,
+                STRING_c_str(newRelativePath),
+                NULL,
+                requestContent,
+                httpStatus,
+                NULL,
+                httpResponse) != HTTPAPIEX_OK
+                )
+            {
+                /*Codes_SRS_BLOB_02_025: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
+                LogError("unable to HTTPAPIEX_ExecuteRequest");
+                result = BLOB_HTTP_ERROR;
+            }
+            else if (*httpStatus >= 300)
+            {
+                /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadMultipleBlocksFromSasUri shall succeed and return BLOB_OK. ]*/
+                LogError("HTTP status from storage does not indicate success (%d)", (int)*httpStatus);
+                result = BLOB_OK;
+            }
+            else
+            {
+                /*Codes_SRS_BLOB_02_027: [ Otherwise Blob_UploadMultipleBlocksFromSasUri shall continue execution. ]*/
+                result = BLOB_OK;
+            }
+        }
+        STRING_delete(newRelativePath);
+    }
+
+    return result;
+}
+
 BLOB_RESULT Blob_UploadBlock(
         HTTPAPIEX_HANDLE httpApiExHandle,
         const char* relativePath,
@@ -35,203 +218,970 @@ BLOB_RESULT Blob_UploadBlock(
         httpStatus == NULL ||
         httpResponse == NULL)
     {
-        LogError("invalid argument detected requestContent=%p blockIDList=%p relativePath=%p httpApiExHandle=%p httpStatus=%p httpResponse=%p", requestContent, blockIDList, relativePath, httpApiExHandle, httpStatus, httpResponse);
-        result = BLOB_ERROR;
+        LogError("invalid argument detected requestContent=%p blockIDList=%p relativePath=%p httpApiExHandle=%p httpStatus=%p httpResponse=%p", requestContent, blockIDList, relativePath, httpApiExHandle, httpStatus, httpResponse);
+        result = BLOB_ERROR;
+    }
+    else if (blockID > 49999) /*outside the expected range of 000000... 049999*/
+    {
+        LogError("block ID too large");
+        result = BLOB_ERROR;
+    }
+    else
+    {
+        STRING_HANDLE blockIdString = createBlockIdString(blockID);
+        if (blockIdString == NULL)
+        {
+            result = BLOB_ERROR;
+        }
+        else
+        {
+            /*add the blockId base64 encoded to the XML*/
+            if (appendBlockIdToList(blockIDList, blockIdString) != 0)
+            {
+                result = BLOB_ERROR;
+            }
+            else
+            {
+                result = putBlock(httpApiExHandle, relativePath, requestContent, blockIdString, httpStatus, httpResponse);
+            }
+            STRING_delete(blockIdString);
+        }
+    }
+    return result;
+}
+
+// A BLOB_BLOCK_SOURCE produces the content of the blockID-th block of the blob. Sources that can cut their blocks anywhere
+// make it blockSize bytes long. Once there are no more blocks it returns BLOB_OK with *content set to NULL. The content is
+// owned by the caller, who hands it to the HTTP layer as is.
+typedef BLOB_RESULT(*BLOB_BLOCK_SOURCE)(void* sourceContext, unsigned int blockID, size_t blockSize, BUFFER_HANDLE* content);
+
+typedef struct CALLBACK_BLOCK_SOURCE_TAG
+{
+    IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx;
+    void* context;
+} CALLBACK_BLOCK_SOURCE;
+
+// getCallbackBlock invokes the application's getDataCallbackEx and copies the block it returns, since the application
+// owns that memory and may reuse it as soon as the callback returns. The application chooses the size of its blocks.
+static BLOB_RESULT getCallbackBlock(void* sourceContext, unsigned int blockID, size_t blockSize, BUFFER_HANDLE* content)
+{
+    BLOB_RESULT result;
+    CALLBACK_BLOCK_SOURCE* callbackSource = (CALLBACK_BLOCK_SOURCE*)sourceContext;
+    unsigned char const * source = NULL; /* data set by getDataCallbackEx */
+    size_t size = 0; /* source size set by getDataCallbackEx */
+
+    (void)blockSize;
+    *content = NULL;
+
+    if (callbackSource->getDataCallbackEx(FILE_UPLOAD_OK, &source, &size, callbackSource->context) == IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT)
+    {
+        /*Codes_SRS_BLOB_99_004: [ If `getDataCallbackEx` returns `IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT_ABORT`, then `Blob_UploadMultipleBlocksFromSasUri` shall exit the loop and return `BLOB_ABORTED`. ]*/
+        LogInfo("Upload to blob has been aborted by the user");
+        result = BLOB_ABORTED;
+    }
+    else if (source == NULL || size == 0)
+    {
+        /*Codes_SRS_BLOB_99_002: [ If the size of the block returned by `getDataCallbackEx` is 0 or if the data is NULL, then `Blob_UploadMultipleBlocksFromSasUri` shall exit the loop. ]*/
+        result = BLOB_OK;
+    }
+    else if (size > BLOCK_SIZE)
+    {
+        /*Codes_SRS_BLOB_99_001: [ If the size of the block returned by `getDataCallbackEx` is bigger than 4MB, then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+        LogError("tried to upload block of size %lu, max allowed size is %d", (unsigned long)size, BLOCK_SIZE);
+        result = BLOB_INVALID_ARG;
+    }
+    else if (blockID >= MAX_BLOCK_COUNT)
+    {
+        /*Codes_SRS_BLOB_99_003: [ If `getDataCallbackEx` returns more than 50000 blocks, then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+        LogError("unable to upload more than %lu blocks in one blob", (unsigned long)MAX_BLOCK_COUNT);
+        result = BLOB_INVALID_ARG;
+    }
+    /*Codes_SRS_BLOB_02_023: [ Blob_UploadMultipleBlocksFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
+    else if ((*content = BUFFER_create(source, size)) == NULL)
+    {
+        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+        LogError("unable to BUFFER_create");
+        result = BLOB_ERROR;
+    }
+    else
+    {
+        result = BLOB_OK;
+    }
+
+    return result;
+}
+
+typedef struct FILE_BLOCK_SOURCE_TAG
+{
+    FILE* file;
+    /*set when remaining holds the number of bytes of the file not read yet*/
+    bool sizeKnown;
+    uint64_t remaining;
+#ifdef USE_BLOB_COMPRESSION
+    /*NULL when the file is uploaded as is*/
+    z_stream* deflater;
+    unsigned char* input;
+    bool inputEnded;
+    bool deflaterEnded;
+#endif
+} FILE_BLOCK_SOURCE;
+
+// readFileContent reads the next bytes of the file, as is or gzipped, into the size bytes at buffer. Fewer bytes are only
+// produced at the end of the file.
+static int readFileContent(FILE_BLOCK_SOURCE* fileSource, unsigned char* buffer, size_t size, size_t* produced)
+{
+    int result;
+
+#ifdef USE_BLOB_COMPRESSION
+    if (fileSource->deflater != NULL)
+    {
+        z_stream* deflater = fileSource->deflater;
+
+        deflater->next_out = buffer;
+        deflater->avail_out = (uInt)size;
+        result = 0;
+
+        while ((deflater->avail_out > 0) && !fileSource->deflaterEnded && (result == 0))
+        {
+            int deflateResult;
+
+            if ((deflater->avail_in == 0) && !fileSource->inputEnded)
+            {
+                size_t read = fread(fileSource->input, 1, GZIP_INPUT_SIZE, fileSource->file);
+                if (ferror(fileSource->file))
+                {
+                    LogError("failed reading the file");
+                    result = MU_FAILURE;
+                    break;
+                }
+                deflater->next_in = fileSource->input;
+                deflater->avail_in = (uInt)read;
+                fileSource->inputEnded = (read < GZIP_INPUT_SIZE);
+                fileSource->remaining = (fileSource->remaining > read) ? (fileSource->remaining - read) : 0;
+            }
+
+            deflateResult = deflate(deflater, fileSource->inputEnded ? Z_FINISH : Z_NO_FLUSH);
+            if (deflateResult == Z_STREAM_END)
+            {
+                fileSource->deflaterEnded = true;
+            }
+            else if ((deflateResult != Z_OK) && (deflateResult != Z_BUF_ERROR))
+            {
+                LogError("deflate failed (%d)", deflateResult);
+                result = MU_FAILURE;
+            }
+        }
+
+        *produced = size - deflater->avail_out;
+    }
+    else
+#endif
+    {
+        *produced = fread(buffer, 1, size, fileSource->file);
+        if (ferror(fileSource->file))
+        {
+            LogError("failed reading the file");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            fileSource->remaining = (fileSource->remaining > *produced) ? (fileSource->remaining - *produced) : 0;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+// fileBlockSize grows the block size asked for when blocks of that size could not carry the rest of the file within
+// MAX_BLOCK_COUNT blocks. Files of unknown size are cut in blocks of BLOCK_SIZE, as they were before blocks were sized.
+static size_t fileBlockSize(const FILE_BLOCK_SOURCE* fileSource, unsigned int blockID, size_t blockSize)
+{
+    size_t result = blockSize;
+
+    if (!fileSource->sizeKnown)
+    {
+        result = BLOCK_SIZE;
+    }
+    else if (blockID < MAX_BLOCK_COUNT)
+    {
+        uint64_t blocksLeft = MAX_BLOCK_COUNT - blockID;
+        uint64_t minimum = (fileSource->remaining + blocksLeft - 1) / blocksLeft;
+        if (minimum > result)
+        {
+            result = (minimum > BLOCK_SIZE) ? BLOCK_SIZE : (size_t)minimum;
+        }
+    }
+
+    return result;
+}
+
+// getFileBlock reads the next block of the file straight into the buffer that is sent, so the file content is copied
+// once (from the file into that buffer) and no more than one block of it is held per block in flight.
+static BLOB_RESULT getFileBlock(void* sourceContext, unsigned int blockID, size_t blockSize, BUFFER_HANDLE* content)
+{
+    BLOB_RESULT result;
+    FILE_BLOCK_SOURCE* fileSource = (FILE_BLOCK_SOURCE*)sourceContext;
+    size_t capacity = fileBlockSize(fileSource, blockID, blockSize);
+    BUFFER_HANDLE block;
+
+    *content = NULL;
+
+    if ((block = BUFFER_new()) == NULL)
+    {
+        LogError("unable to BUFFER_new");
+        result = BLOB_ERROR;
+    }
+    else if (BUFFER_pre_build(block, capacity) != 0)
+    {
+        LogError("unable to BUFFER_pre_build a block of %lu bytes", (unsigned long)capacity);
+        BUFFER_delete(block);
+        result = BLOB_ERROR;
+    }
+    else
+    {
+        size_t size;
+
+        if (readFileContent(fileSource, BUFFER_u_char(block), capacity, &size) != 0)
+        {
+            LogError("failed reading block %u of the file", blockID);
+            BUFFER_delete(block);
+            result = BLOB_ERROR;
+        }
+        else if (size == 0)
+        {
+            BUFFER_delete(block);
+            result = BLOB_OK;
+        }
+        else if (blockID >= MAX_BLOCK_COUNT)
+        {
+            LogError("unable to upload more than %lu blocks in one blob", (unsigned long)MAX_BLOCK_COUNT);
+            BUFFER_delete(block);
+            result = BLOB_INVALID_ARG;
+        }
+        /*only the last block of the file can be short*/
+        else if ((size < capacity) && (BUFFER_shrink(block, capacity - size, true) != 0))
+        {
+            LogError("unable to BUFFER_shrink the last block to %lu bytes", (unsigned long)size);
+            BUFFER_delete(block);
+            result = BLOB_ERROR;
+        }
+        else
+        {
+            *content = block;
+            result = BLOB_OK;
+        }
+    }
+
+    return result;
+}
+
+// nextBlockSize is the size the blockID-th block should have when the upload chooses its block sizes: the size the journal
+// recorded for it, so that a resumed upload cuts its blocks where the failed one did, and the sizer's choice otherwise.
+static size_t nextBlockSize(BLOB_BLOCK_SIZER_HANDLE sizer, BLOB_UPLOAD_JOURNAL_HANDLE journal, unsigned int blockID)
+{
+    size_t result;
+
+    if (sizer == NULL)
+    {
+        result = BLOCK_SIZE;
+    }
+    else if ((journal == NULL) || !blob_upload_journal_get_block_size(journal, blockID, &result))
+    {
+        result = blob_block_sizer_get_size(sizer);
+    }
+
+    return result;
+}
+
+// elapsedSince returns the milliseconds since start_ms, 0 when the tick counter cannot be read.
+static tickcounter_ms_t elapsedSince(TICK_COUNTER_HANDLE tickCounter, tickcounter_ms_t start_ms)
+{
+    tickcounter_ms_t now_ms;
+    return ((tickcounter_get_current_ms(tickCounter, &now_ms) == 0) && (now_ms > start_ms)) ? (now_ms - start_ms) : 0;
+}
+
+// hashBlock computes the journal hash of a block when the upload is journaled. A block that cannot be hashed is simply
+// uploaded and left out of the journal.
+static bool hashBlock(BLOB_UPLOAD_JOURNAL_HANDLE journal, BUFFER_HANDLE content, unsigned char* hash)
+{
+    return (journal != NULL) && (blob_upload_journal_hash_block(BUFFER_u_char(content), BUFFER_length(content), hash) == 0);
+}
+
+// appendJournaledBlock adds the id of a block that the journal shows as already in storage to the block list, in place
+// of uploading the block again.
+static int appendJournaledBlock(STRING_HANDLE blockIDList, unsigned int blockID)
+{
+    int result;
+    STRING_HANDLE blockIdString = createBlockIdString(blockID);
+
+    if (blockIdString == NULL)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = appendBlockIdToList(blockIDList, blockIdString);
+        STRING_delete(blockIdString);
+    }
+
+    return result;
+}
+
+// UploadBlocks takes the blocks from getBlock one after the other and sends each of them to the server over httpApiExHandle,
+// except for the blocks the journal (if any) shows as already uploaded. With a sizer, the time each block takes is measured
+// with tickCounter and sets the size of the next ones.
+static BLOB_RESULT UploadBlocks(HTTPAPIEX_HANDLE httpApiExHandle, const char* relativePath, STRING_HANDLE blockIDList, BLOB_BLOCK_SOURCE getBlock, void* sourceContext, BLOB_BLOCK_SIZER_HANDLE sizer, TICK_COUNTER_HANDLE tickCounter, BLOB_UPLOAD_JOURNAL_HANDLE journal, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
+{
+    BLOB_RESULT result;
+
+    /*Codes_SRS_BLOB_02_021: [ For every block returned by `getDataCallbackEx` the following operations shall happen: ]*/
+    unsigned int blockID = 0; /* incremented for each new block */
+    unsigned int isError = 0; /* set to 1 if a block upload fails or if getBlock returns incorrect blocks to upload */
+    unsigned int uploadOneMoreBlock = 1; /* set to 1 while getBlock returns correct blocks to upload */
+
+    do
+    {
+        BUFFER_HANDLE requestContent;
+
+        if ((result = getBlock(sourceContext, blockID, nextBlockSize(sizer, journal, blockID), &requestContent)) != BLOB_OK)
+        {
+            isError = 1;
+        }
+        else if (requestContent == NULL)
+        {
+            uploadOneMoreBlock = 0;
+        }
+        else
+        {
+            unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+            bool hashed = hashBlock(journal, requestContent, hash);
+
+            if (hashed && blob_upload_journal_has_block(journal, blockID, hash))
+            {
+                if (appendJournaledBlock(blockIDList, blockID) != 0)
+                {
+                    result = BLOB_ERROR;
+                    isError = 1;
+                }
+            }
+            else
+            {
+                tickcounter_ms_t start_ms = 0;
+
+                if ((sizer != NULL) && (tickcounter_get_current_ms(tickCounter, &start_ms) != 0))
+                {
+                    LogError("unable to read the tick counter, the block will not be measured");
+                }
+
+                result = Blob_UploadBlock(
+                        httpApiExHandle,
+                        relativePath,
+                        requestContent,
+                        blockID,
+                        blockIDList,
+                        httpStatus,
+                        httpResponse);
+
+                /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadMultipleBlocksFromSasUri shall succeed and return BLOB_OK. ]*/
+                if (result != BLOB_OK)
+                {
+                    LogError("unable to Blob_UploadBlock. Returned value=%d", result);
+                    isError = 1;
+                }
+                else if (*httpStatus >= 300)
+                {
+                    LogError("unable to Blob_UploadBlock. Returned httpStatus=%u", (unsigned int)*httpStatus);
+                    isError = 1;
+                }
+                else
+                {
+                    if (sizer != NULL)
+                    {
+                        blob_block_sizer_on_block_sent(sizer, BUFFER_length(requestContent), elapsedSince(tickCounter, start_ms), false);
+                    }
+                    if (hashed)
+                    {
+                        (void)blob_upload_journal_add_block(journal, blockID, BUFFER_length(requestContent), hash);
+                    }
+                }
+            }
+
+            BUFFER_delete(requestContent);
+            blockID++;
+        }
+    }
+    while(uploadOneMoreBlock && !isError);
+
+    return result;
+}
+
+// setHttpApiExOptions applies the certificates, proxy and network interface of the upload to one connection.
+static int setHttpApiExOptions(HTTPAPIEX_HANDLE httpApiExHandle, const char* certificates, HTTP_PROXY_OPTIONS* proxyOptions, const char* networkInterface)
+{
+    int result;
+
+    if ((certificates != NULL) && (HTTPAPIEX_SetOption(httpApiExHandle, "TrustedCerts", certificates) == HTTPAPIEX_ERROR))
+    {
+        LogError("failure in setting trusted certificates");
+        result = MU_FAILURE;
+    }
+    else if ((proxyOptions != NULL && proxyOptions->host_address != NULL) && HTTPAPIEX_SetOption(httpApiExHandle, OPTION_HTTP_PROXY, proxyOptions) == HTTPAPIEX_ERROR)
+    {
+        LogError("failure in setting proxy options");
+        result = MU_FAILURE;
+    }
+    else if ((networkInterface != NULL) && HTTPAPIEX_SetOption(httpApiExHandle, OPTION_CURL_INTERFACE, networkInterface) == HTTPAPIEX_ERROR)
+    {
+        LogError("failure in setting network interface");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+// isRetryableBlockStatus tells whether storage may accept the same Put Block if it is sent again.
+static bool isRetryableBlockStatus(unsigned int httpStatus)
+{
+    return (httpStatus == 408) || (httpStatus == 429) || (httpStatus >= 500);
+}
+
+// putBlockWithRetries sends a block up to BLOB_BLOCK_MAX_ATTEMPTS times while the failure is transient, and sets *retried
+// when it took more than one attempt. Put Block is idempotent for a given block id, so resending it cannot corrupt the blob.
+static BLOB_RESULT putBlockWithRetries(HTTPAPIEX_HANDLE httpApiExHandle, const char* relativePath, const BLOB_UPLOAD_BLOCK* block, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, bool* retried)
+{
+    BLOB_RESULT result;
+    unsigned int attempt = 1;
+
+    while (true)
+    {
+        result = putBlock(httpApiExHandle, relativePath, block->content, block->blockIdString, httpStatus, httpResponse);
+
+        if ((attempt >= BLOB_BLOCK_MAX_ATTEMPTS) ||
+            !((result == BLOB_HTTP_ERROR) || ((result == BLOB_OK) && isRetryableBlockStatus(*httpStatus))))
+        {
+            break;
+        }
+
+        LogInfo("retrying block %u (attempt %u of %u)", block->blockID, attempt + 1, (unsigned int)BLOB_BLOCK_MAX_ATTEMPTS);
+        ThreadAPI_Sleep(BLOB_BLOCK_RETRY_DELAY_MS * attempt);
+        attempt++;
+    }
+
+    *retried = (attempt > 1);
+    return result;
+}
+
+static void freeUploadBlock(BLOB_UPLOAD_BLOCK* block)
+{
+    BUFFER_delete(block->content);
+    STRING_delete(block->blockIdString);
+    free(block);
+}
+
+// createUploadBlock wraps a block produced by the block source, taking ownership of its content.
+static BLOB_UPLOAD_BLOCK* createUploadBlock(BUFFER_HANDLE content, unsigned int blockID)
+{
+    BLOB_UPLOAD_BLOCK* result;
+
+    if ((result = (BLOB_UPLOAD_BLOCK*)malloc(sizeof(BLOB_UPLOAD_BLOCK))) == NULL)
+    {
+        LogError("failed allocating the upload block");
+        BUFFER_delete(content);
+    }
+    else
+    {
+        result->next = NULL;
+        result->blockID = blockID;
+        result->content = content;
+        result->hashed = false;
+
+        if ((result->blockIdString = createBlockIdString(blockID)) == NULL)
+        {
+            BUFFER_delete(result->content);
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+// BlobUploadWorker_Thread uploads the queued blocks over the worker's own connection, in whatever order they complete.
+// Once any block has failed (or the upload was cancelled) the remaining queued blocks are dropped without being sent.
+// A worker that cannot re-acquire the lock after sending a block exits without touching the upload, which then fails.
+static int BlobUploadWorker_Thread(void* threadArgument)
+{
+    BLOB_UPLOAD_WORKER* worker = (BLOB_UPLOAD_WORKER*)threadArgument;
+    BLOB_PARALLEL_UPLOAD* upload = worker->upload;
+
+    if (Lock(upload->lock) != LOCK_OK)
+    {
+        LogError("failed locking the parallel upload");
+        worker->result = BLOB_ERROR;
+        worker->lost_lock = 1;
+    }
+    else
+    {
+        bool locked = true;
+
+        while (true)
+        {
+            BLOB_UPLOAD_BLOCK* block = upload->head;
+
+            if (block != NULL)
+            {
+                upload->head = block->next;
+                if (upload->head == NULL)
+                {
+                    upload->tail = NULL;
+                }
+
+                if (upload->failed_worker == NULL && !upload->cancelled)
+                {
+                    BLOB_RESULT result;
+                    bool retried;
+                    tickcounter_ms_t start_ms = 0;
+
+                    (void)Unlock(upload->lock);
+                    if ((upload->sizer != NULL) && (tickcounter_get_current_ms(upload->tickCounter, &start_ms) != 0))
+                    {
+                        LogError("unable to read the tick counter, the block will not be measured");
+                    }
+                    result = putBlockWithRetries(worker->httpApiExHandle, upload->relativePath, block, &worker->httpStatus, worker->httpResponse, &retried);
+                    if (block->hashed && (result == BLOB_OK) && (worker->httpStatus < 300))
+                    {
+                        (void)blob_upload_journal_add_block(upload->journal, block->blockID, BUFFER_length(block->content), block->hash);
+                    }
+                    if (Lock(upload->lock) != LOCK_OK)
+                    {
+                        LogError("failed re-acquiring the parallel upload lock, block %u is not accounted for", block->blockID);
+                        freeUploadBlock(block);
+                        worker->result = BLOB_ERROR;
+                        worker->lost_lock = 1;
+                        locked = false;
+                        break;
+                    }
+
+                    if ((upload->sizer != NULL) && (result == BLOB_OK) && (worker->httpStatus < 300))
+                    {
+                        blob_block_sizer_on_block_sent(upload->sizer, BUFFER_length(block->content), elapsedSince(upload->tickCounter, start_ms), retried);
+                    }
+
+                    if (((result != BLOB_OK) || (worker->httpStatus >= 300)) && (upload->failed_worker == NULL))
+                    {
+                        LogError("unable to upload block %u. Returned value=%d, httpStatus=%u", block->blockID, result, worker->httpStatus);
+                        worker->result = result;
+                        upload->failed_worker = worker;
+                    }
+                    else if (result == BLOB_OK)
+                    {
+                        upload->last_http_status = worker->httpStatus;
+                    }
+                }
+
+                freeUploadBlock(block);
+                upload->blocks_in_flight--;
+                (void)Condition_Post(upload->block_done);
+            }
+            else if (upload->stop)
+            {
+                break;
+            }
+            else
+            {
+                (void)Condition_Wait(upload->block_queued, upload->lock, BLOB_UPLOAD_MAX_WAIT_MS);
+            }
+        }
+
+        if (locked)
+        {
+            (void)Unlock(upload->lock);
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+// stopUploadWorkers lets the started workers drain the queue and joins them.
+static void stopUploadWorkers(BLOB_PARALLEL_UPLOAD* upload, size_t started_workers)
+{
+    size_t i;
+
+    if (Lock(upload->lock) != LOCK_OK)
+    {
+        LogError("failed locking the parallel upload");
+    }
+    else
+    {
+        upload->stop = true;
+        for (i = 0; i < started_workers; i++)
+        {
+            (void)Condition_Post(upload->block_queued);
+        }
+        (void)Unlock(upload->lock);
+    }
+
+    for (i = 0; i < started_workers; i++)
+    {
+        int thread_result;
+        if (ThreadAPI_Join(upload->workers[i].thread, &thread_result) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for block upload worker %lu", (unsigned long)i);
+        }
+    }
+}
+
+static void freeParallelUpload(BLOB_PARALLEL_UPLOAD* upload)
+{
+    size_t i;
+
+    while (upload->head != NULL)
+    {
+        BLOB_UPLOAD_BLOCK* block = upload->head;
+        upload->head = block->next;
+        freeUploadBlock(block);
+    }
+    for (i = 0; i < upload->worker_count; i++)
+    {
+        if (upload->workers[i].httpApiExHandle != NULL)
+        {
+            HTTPAPIEX_Destroy(upload->workers[i].httpApiExHandle);
+        }
+        if (upload->workers[i].httpResponse != NULL)
+        {
+            BUFFER_delete(upload->workers[i].httpResponse);
+        }
+    }
+    if (upload->block_done != NULL)
+    {
+        Condition_Deinit(upload->block_done);
     }
-    else if (blockID > 49999) /*outside the expected range of 000000... 049999*/
+    if (upload->block_queued != NULL)
     {
-        LogError("block ID too large");
-        result = BLOB_ERROR;
+        Condition_Deinit(upload->block_queued);
+    }
+    if (upload->lock != NULL)
+    {
+        Lock_Deinit(upload->lock);
+    }
+    free(upload->workers);
+    free(upload);
+}
+
+// createParallelUpload opens one connection per worker and starts the workers. The connections are configured exactly
+// like the one used to commit the block list.
+static BLOB_PARALLEL_UPLOAD* createParallelUpload(const char* hostname, const char* relativePath, size_t concurrency, const char* certificates, HTTP_PROXY_OPTIONS* proxyOptions, const char* networkInterface)
+{
+    BLOB_PARALLEL_UPLOAD* result;
+
+    if ((result = (BLOB_PARALLEL_UPLOAD*)malloc(sizeof(BLOB_PARALLEL_UPLOAD))) == NULL)
+    {
+        LogError("failed allocating the parallel upload");
     }
     else
     {
-        char temp[7]; /*this will contain 000000... 049999*/
-        if (sprintf(temp, "%6u", (unsigned int)blockID) != 6) /*produces 000000... 049999*/
+        memset(result, 0, sizeof(BLOB_PARALLEL_UPLOAD));
+        result->relativePath = relativePath;
+
+        if ((result->workers = (BLOB_UPLOAD_WORKER*)malloc(concurrency * sizeof(BLOB_UPLOAD_WORKER))) == NULL)
         {
-            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-            LogError("failed to sprintf");
-            result = BLOB_ERROR;
+            LogError("failed allocating %lu block upload workers", (unsigned long)concurrency);
+            freeParallelUpload(result);
+            result = NULL;
         }
         else
         {
-            STRING_HANDLE blockIdString = Azure_Base64_Encode_Bytes((const unsigned char*)temp, 6);
-            if (blockIdString == NULL)
+            size_t i;
+
+            memset(result->workers, 0, concurrency * sizeof(BLOB_UPLOAD_WORKER));
+            result->worker_count = concurrency;
+
+            for (i = 0; i < concurrency; i++)
             {
-                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                LogError("unable to Azure_Base64_Encode_Bytes");
-                result = BLOB_ERROR;
+                result->workers[i].upload = result;
+                if ((result->workers[i].httpApiExHandle = HTTPAPIEX_Create(hostname)) == NULL)
+                {
+                    LogError("unable to create a HTTPAPIEX_HANDLE for block upload worker %lu", (unsigned long)i);
+                    break;
+                }
+                else if (setHttpApiExOptions(result->workers[i].httpApiExHandle, certificates, proxyOptions, networkInterface) != 0)
+                {
+                    break;
+                }
+                else if ((result->workers[i].httpResponse = BUFFER_new()) == NULL)
+                {
+                    LogError("unable to BUFFER_new for block upload worker %lu", (unsigned long)i);
+                    break;
+                }
+            }
+
+            if (i < concurrency)
+            {
+                freeParallelUpload(result);
+                result = NULL;
+            }
+            else if ((result->lock = Lock_Init()) == NULL)
+            {
+                LogError("Lock_Init failed");
+                freeParallelUpload(result);
+                result = NULL;
+            }
+            else if ((result->block_queued = Condition_Init()) == NULL ||
+                (result->block_done = Condition_Init()) == NULL)
+            {
+                LogError("Condition_Init failed");
+                freeParallelUpload(result);
+                result = NULL;
             }
             else
             {
-                /*add the blockId base64 encoded to the XML*/
-                if (!(
-                    (STRING_concat(blockIDList, "<Latest>") == 0) &&
-                    (STRING_concat_with_STRING(blockIDList, blockIdString) == 0) &&
-                    (STRING_concat(blockIDList, "</Latest>") == 0)
-                    ))
-                {
-                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                    LogError("unable to STRING_concat");
-                    result = BLOB_ERROR;
-                }
-                else
+                for (i = 0; i < concurrency; i++)
                 {
-                    /*Codes_SRS_BLOB_02_022: [ Blob_UploadMultipleBlocksFromSasUri shall construct a new relativePath from following string: base relativePath + "&comp=block&blockid=BASE64 encoded string of blockId" ]*/
-                    STRING_HANDLE newRelativePath = STRING_construct(relativePath);
-                    if (newRelativePath == NULL)
+                    if (ThreadAPI_Create(&result->workers[i].thread, BlobUploadWorker_Thread, &result->workers[i]) != THREADAPI_OK)
                     {
-                        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                        LogError("unable to STRING_construct");
-                        result = BLOB_ERROR;
-                    }
-                    else
-                    {
-                        if (!(
-                            (STRING_concat(newRelativePath, "&comp=block&blockid=") == 0) &&
-                            (STRING_concat_with_STRING(newRelativePath, blockIdString) == 0)
-                            ))
-                        {
-                            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                            LogError("unable to STRING concatenate");
-                            result = BLOB_ERROR;
-                        }
-                        else
-                        {
-                            /*Codes_SRS_BLOB_02_024: [ Blob_UploadMultipleBlocksFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing httpStatus and httpResponse. ]*/
-                            if (HTTPAPIEX_ExecuteRequest(
-                                httpApiExHandle,
-                                HTTPAPI_REQUEST_PUT,
-                                STRING_c_str(newRelativePath),
-                                NULL,
-                                requestContent,
-                                httpStatus,
-                                NULL,
-                                httpResponse) != HTTPAPIEX_OK
-                                )
-                            {
-                                /*Codes_SRS_BLOB_02_025: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
-                                LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                result = BLOB_HTTP_ERROR;
-                            }
-                            else if (*httpStatus >= 300)
-                            {
-                                /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadMultipleBlocksFromSasUri shall succeed and return BLOB_OK. ]*/
-                                LogError("HTTP status from storage does not indicate success (%d)", (int)*httpStatus);
-                                result = BLOB_OK;
-                            }
-                            else
-                            {
-                                /*Codes_SRS_BLOB_02_027: [ Otherwise Blob_UploadMultipleBlocksFromSasUri shall continue execution. ]*/
-                                result = BLOB_OK;
-                            }
-                        }
-                        STRING_delete(newRelativePath);
+                        LogError("ThreadAPI_Create failed for block upload worker %lu", (unsigned long)i);
+                        break;
                     }
                 }
-                STRING_delete(blockIdString);
+
+                if (i < concurrency)
+                {
+                    stopUploadWorkers(result, i);
+                    freeParallelUpload(result);
+                    result = NULL;
+                }
             }
         }
     }
+
     return result;
 }
 
+// findWorkerThatLostLock returns the first worker that exited without the lock, or NULL. Its block was never accounted
+// for, so blocks_in_flight may never drop back and the upload cannot be committed.
+static BLOB_UPLOAD_WORKER* findWorkerThatLostLock(BLOB_PARALLEL_UPLOAD* upload)
+{
+    BLOB_UPLOAD_WORKER* result = NULL;
+    size_t i;
+
+    for (i = 0; i < upload->worker_count; i++)
+    {
+        if (upload->workers[i].lost_lock)
+        {
+            result = &upload->workers[i];
+            break;
+        }
+    }
+
+    return result;
+}
 
-// InvokeUserCallbackAndSendBlobs invokes the application's getDataCallbackEx as many time as callback requests and, for each call,
-// sends the blob contents to the server.
-static BLOB_RESULT InvokeUserCallbackAndSendBlobs(HTTPAPIEX_HANDLE httpApiExHandle, const char* relativePath, STRING_HANDLE blockIDList, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
+// nextParallelBlockSize is nextBlockSize read under the lock the workers report the blocks they send with.
+static int nextParallelBlockSize(BLOB_PARALLEL_UPLOAD* upload, unsigned int blockID, size_t* blockSize)
 {
-    BLOB_RESULT result;
+    int result;
 
-    /*Codes_SRS_BLOB_02_021: [ For every block returned by `getDataCallbackEx` the following operations shall happen: ]*/
-    unsigned int blockID = 0; /* incremented for each new block */
-    unsigned int isError = 0; /* set to 1 if a block upload fails or if getDataCallbackEx returns incorrect blocks to upload */
-    unsigned int uploadOneMoreBlock = 1; /* set to 1 while getDataCallbackEx returns correct blocks to upload */
-    unsigned char const * source = NULL; /* data set by getDataCallbackEx */
-    size_t size = 0; /* source size set by getDataCallbackEx */
-    IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT getDataReturnValue;
+    if (Lock(upload->lock) != LOCK_OK)
+    {
+        LogError("failed locking the parallel upload");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        *blockSize = nextBlockSize(upload->sizer, upload->journal, blockID);
+        (void)Unlock(upload->lock);
+        result = 0;
+    }
 
-    do
+    return result;
+}
+
+// queueUploadBlock hands a block to the workers, waiting while every worker already has a block in flight. It returns
+// BLOB_ABORTED, without queuing the block, once a worker failed an earlier block.
+static BLOB_RESULT queueUploadBlock(BLOB_PARALLEL_UPLOAD* upload, BLOB_UPLOAD_BLOCK* block)
+{
+    BLOB_RESULT result;
+
+    if (Lock(upload->lock) != LOCK_OK)
+    {
+        LogError("failed locking the parallel upload");
+        result = BLOB_ERROR;
+    }
+    else
     {
-        getDataReturnValue = getDataCallbackEx(FILE_UPLOAD_OK, &source, &size, context);
-        if (getDataReturnValue == IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT)
+        while ((upload->blocks_in_flight >= upload->worker_count) && (upload->failed_worker == NULL) && (findWorkerThatLostLock(upload) == NULL))
         {
-            /*Codes_SRS_BLOB_99_004: [ If `getDataCallbackEx` returns `IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT_ABORT`, then `Blob_UploadMultipleBlocksFromSasUri` shall exit the loop and return `BLOB_ABORTED`. ]*/
-            LogInfo("Upload to blob has been aborted by the user");
-            uploadOneMoreBlock = 0;
+            (void)Condition_Wait(upload->block_done, upload->lock, BLOB_UPLOAD_MAX_WAIT_MS);
+        }
+
+        if (findWorkerThatLostLock(upload) != NULL)
+        {
+            LogError("a block upload worker exited without the parallel upload lock");
+            result = BLOB_ERROR;
+        }
+        else if (upload->failed_worker != NULL)
+        {
+            /*not an error of its own, the failure of the earlier block is reported once the workers are stopped*/
             result = BLOB_ABORTED;
         }
-        else if (source == NULL || size == 0)
+        else
         {
-            /*Codes_SRS_BLOB_99_002: [ If the size of the block returned by `getDataCallbackEx` is 0 or if the data is NULL, then `Blob_UploadMultipleBlocksFromSasUri` shall exit the loop. ]*/
-            uploadOneMoreBlock = 0;
+            if (upload->tail == NULL)
+            {
+                upload->head = block;
+            }
+            else
+            {
+                upload->tail->next = block;
+            }
+            upload->tail = block;
+            upload->blocks_in_flight++;
+            (void)Condition_Post(upload->block_queued);
             result = BLOB_OK;
         }
-        else
+        (void)Unlock(upload->lock);
+    }
+
+    return result;
+}
+
+// UploadBlocksInParallel is UploadBlocks with up to concurrency blocks in flight, each over its own connection. Block ids
+// are added to blockIDList in the order getBlock produced the blocks, so the list committed by SendBlockIdList keeps that
+// order whatever order the blocks complete in.
+static BLOB_RESULT UploadBlocksInParallel(const char* hostname, const char* relativePath, size_t concurrency, const char* certificates, HTTP_PROXY_OPTIONS* proxyOptions, const char* networkInterface, STRING_HANDLE blockIDList, BLOB_BLOCK_SOURCE getBlock, void* sourceContext, BLOB_BLOCK_SIZER_HANDLE sizer, TICK_COUNTER_HANDLE tickCounter, BLOB_UPLOAD_JOURNAL_HANDLE journal, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
+{
+    BLOB_RESULT result;
+    BLOB_PARALLEL_UPLOAD* upload = createParallelUpload(hostname, relativePath, concurrency, certificates, proxyOptions, networkInterface);
+
+    if (upload == NULL)
+    {
+        LogError("unable to start the parallel block upload");
+        result = BLOB_ERROR;
+    }
+    else
+    {
+        unsigned int blockID = 0;
+        unsigned int uploadOneMoreBlock = 1;
+        unsigned int isError = 0;
+
+        /*read by the workers only once they are handed a block*/
+        upload->journal = journal;
+        upload->sizer = sizer;
+        upload->tickCounter = tickCounter;
+
+        do
         {
-            if (size > BLOCK_SIZE)
+            BUFFER_HANDLE content;
+            size_t blockSize = BLOCK_SIZE;
+            BLOB_RESULT queueResult;
+
+            /*the workers report the blocks they send to the sizer*/
+            if ((sizer != NULL) && (nextParallelBlockSize(upload, blockID, &blockSize) != 0))
             {
-                /*Codes_SRS_BLOB_99_001: [ If the size of the block returned by `getDataCallbackEx` is bigger than 4MB, then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
-                LogError("tried to upload block of size %lu, max allowed size is %d", (unsigned long)size, BLOCK_SIZE);
-                result = BLOB_INVALID_ARG;
+                result = BLOB_ERROR;
                 isError = 1;
             }
-            else if (blockID >= MAX_BLOCK_COUNT)
+            else if ((result = getBlock(sourceContext, blockID, blockSize, &content)) != BLOB_OK)
             {
-                /*Codes_SRS_BLOB_99_003: [ If `getDataCallbackEx` returns more than 50000 blocks, then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
-                LogError("unable to upload more than %lu blocks in one blob", (unsigned long)MAX_BLOCK_COUNT);
-                result = BLOB_INVALID_ARG;
                 isError = 1;
             }
+            else if (content == NULL)
+            {
+                uploadOneMoreBlock = 0;
+            }
             else
             {
-                /*Codes_SRS_BLOB_02_023: [ Blob_UploadMultipleBlocksFromSasUri shall create a BUFFER_HANDLE from source and size parameters. ]*/
-                BUFFER_HANDLE requestContent = BUFFER_create(source, size);
-                if (requestContent == NULL)
+                BLOB_UPLOAD_BLOCK* block = createUploadBlock(content, blockID);
+                if (block == NULL)
                 {
-                    /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
-                    LogError("unable to BUFFER_create");
                     result = BLOB_ERROR;
                     isError = 1;
                 }
-                else
+                else if (appendBlockIdToList(blockIDList, block->blockIdString) != 0)
                 {
-                    result = Blob_UploadBlock(
-                            httpApiExHandle,
-                            relativePath,
-                            requestContent,
-                            blockID,
-                            blockIDList,
-                            httpStatus,
-                            httpResponse);
-
-                    BUFFER_delete(requestContent);
+                    freeUploadBlock(block);
+                    result = BLOB_ERROR;
+                    isError = 1;
                 }
-
-                /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadMultipleBlocksFromSasUri shall succeed and return BLOB_OK. ]*/
-                if (result != BLOB_OK)
+                else if ((block->hashed = hashBlock(journal, block->content, block->hash)) && blob_upload_journal_has_block(journal, blockID, block->hash))
                 {
-                    LogError("unable to Blob_UploadBlock. Returned value=%d", result);
-                    isError = 1;
+                    /*already in storage*/
+                    freeUploadBlock(block);
                 }
-                else if (*httpStatus >= 300)
+                else if ((queueResult = queueUploadBlock(upload, block)) != BLOB_OK)
                 {
-                    LogError("unable to Blob_UploadBlock. Returned httpStatus=%u", (unsigned int)*httpStatus);
+                    freeUploadBlock(block);
+                    /*a failed block sets the result below, anything else fails the upload, whose block list already names this block*/
+                    if (queueResult != BLOB_ABORTED)
+                    {
+                        result = queueResult;
+                    }
                     isError = 1;
                 }
+                blockID++;
+            }
+        }
+        while (uploadOneMoreBlock && !isError);
+
+        if (result != BLOB_OK)
+        {
+            /*blocks still queued are of no use to an upload that will not be committed*/
+            if (Lock(upload->lock) != LOCK_OK)
+            {
+                LogError("failed locking the parallel upload");
+            }
+            else
+            {
+                upload->cancelled = true;
+                (void)Unlock(upload->lock);
+            }
+        }
+
+        stopUploadWorkers(upload, upload->worker_count);
+
+        if (result == BLOB_OK)
+        {
+            BLOB_UPLOAD_WORKER* lostWorker = findWorkerThatLostLock(upload);
+            if (lostWorker != NULL)
+            {
+                LogError("a block upload worker exited without the parallel upload lock");
+                result = lostWorker->result;
+            }
+            else if (upload->failed_worker != NULL)
+            {
+                /*as in the serial upload, a block refused by storage is reported through httpStatus and httpResponse with BLOB_OK*/
+                result = upload->failed_worker->result;
+                *httpStatus = upload->failed_worker->httpStatus;
+                if (BUFFER_build(httpResponse, BUFFER_u_char(upload->failed_worker->httpResponse), BUFFER_length(upload->failed_worker->httpResponse)) != 0)
+                {
+                    LogError("unable to copy the response of the failed block");
+                }
+            }
+            else if (blockID > 0)
+            {
+                *httpStatus = upload->last_http_status;
             }
-            blockID++;
         }
+
+        freeParallelUpload(upload);
     }
-    while(uploadOneMoreBlock && !isError);
 
     return result;
 }
 
 // SendBlockIdList to send an XML of uploaded blockIds to the server after the application's payload block(s) have been transfered.
-static BLOB_RESULT SendBlockIdList(HTTPAPIEX_HANDLE httpApiExHandle, const char* relativePath, STRING_HANDLE blockIDList, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
+// A non NULL contentEncoding is stored as the Content-Encoding the blob is served with.
+static BLOB_RESULT SendBlockIdList(HTTPAPIEX_HANDLE httpApiExHandle, const char* relativePath, STRING_HANDLE blockIDList, const char* contentEncoding, unsigned int* httpStatus, BUFFER_HANDLE httpResponse)
 {
     BLOB_RESULT result;
-    
+    HTTP_HEADERS_HANDLE requestHeaders = NULL;
+
     /*complete the XML*/
     if (STRING_concat(blockIDList, blockListXmlEnd) != 0)
     {
@@ -270,11 +1220,18 @@ static BLOB_RESULT SendBlockIdList(HTTPAPIEX_HANDLE httpApiExHandle, const char*
                 }
                 else
                 {
-                    if (HTTPAPIEX_ExecuteRequest(
+                    if ((contentEncoding != NULL) &&
+                        (((requestHeaders = HTTPHeaders_Alloc()) == NULL) ||
+                         (HTTPHeaders_AddHeaderNameValuePair(requestHeaders, "x-ms-blob-content-encoding", contentEncoding) != HTTP_HEADERS_OK)))
+                    {
+                        LogError("unable to set the content encoding of the blob");
+                        result = BLOB_ERROR;
+                    }
+                    else if (HTTPAPIEX_ExecuteRequest(
                         httpApiExHandle,
                         HTTPAPI_REQUEST_PUT,
                         STRING_c_str(newRelativePath),
-                        NULL,
+                        requestHeaders,
                         blockIDListAsBuffer,
                         httpStatus,
                         NULL,
@@ -297,23 +1254,32 @@ static BLOB_RESULT SendBlockIdList(HTTPAPIEX_HANDLE httpApiExHandle, const char*
         }
     }
 
+    if (requestHeaders != NULL)
+    {
+        HTTPHeaders_Free(requestHeaders);
+    }
+
     return result;
 }
 
 
-BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions, const char* networkInterface)
+// UploadMultipleBlocks uploads the blocks produced by getBlock as a block blob and commits them. When sizer is not NULL
+// the sizes of the blocks are chosen by it, otherwise getBlock is asked for blocks of BLOCK_SIZE.
+static BLOB_RESULT UploadMultipleBlocks(const char* SASURI, BLOB_BLOCK_SOURCE getBlock, void* sourceContext, BLOB_BLOCK_SIZER_HANDLE sizer, const char* contentEncoding, BLOB_UPLOAD_JOURNAL_HANDLE journal, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions, const char* networkInterface, size_t concurrency)
 {
     BLOB_RESULT result;
     const char* hostnameBegin;
     STRING_HANDLE blockIDList = NULL;
     HTTPAPIEX_HANDLE httpApiExHandle = NULL;
+    TICK_COUNTER_HANDLE tickCounter = NULL;
     char* hostname = NULL;
-    
-    /*Codes_SRS_BLOB_02_001: [ If SASURI is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
-    /*Codes_SRS_BLOB_02_002: [ If getDataCallbackEx is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
-    if ((SASURI == NULL) || (getDataCallbackEx == NULL))
+
+    /*stays below 300 (so the block list is committed) when no block has to be sent*/
+    *httpStatus = 0;
+
+    if (concurrency > BLOB_MAX_UPLOAD_CONCURRENCY)
     {
-        LogError("One or more required values is NULL, SASURI=%p, getDataCallbackEx=%p", SASURI, getDataCallbackEx);
+        LogError("concurrency %lu is over the maximum of %d", (unsigned long)concurrency, BLOB_MAX_UPLOAD_CONCURRENCY);
         result = BLOB_INVALID_ARG;
     }
     /*Codes_SRS_BLOB_02_017: [ Blob_UploadMultipleBlocksFromSasUri shall copy from SASURI the hostname to a new const char* ]*/
@@ -358,19 +1324,8 @@ BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIEN
                     LogError("unable to create a HTTPAPIEX_HANDLE");
                     result = BLOB_ERROR;
                 }
-                else if ((certificates != NULL) && (HTTPAPIEX_SetOption(httpApiExHandle, "TrustedCerts", certificates) == HTTPAPIEX_ERROR))
-                {
-                    LogError("failure in setting trusted certificates");
-                    result = BLOB_ERROR;
-                }
-                else if ((proxyOptions != NULL && proxyOptions->host_address != NULL) && HTTPAPIEX_SetOption(httpApiExHandle, OPTION_HTTP_PROXY, proxyOptions) == HTTPAPIEX_ERROR)
-                {
-                    LogError("failure in setting proxy options");
-                    result = BLOB_ERROR;
-                }
-                else if ((networkInterface != NULL) && HTTPAPIEX_SetOption(httpApiExHandle, OPTION_CURL_INTERFACE, networkInterface) == HTTPAPIEX_ERROR)
+                else if (setHttpApiExOptions(httpApiExHandle, certificates, proxyOptions, networkInterface) != 0)
                 {
-                    LogError("failure in setting network interface");
                     result = BLOB_ERROR;
                 }
                 /*Codes_SRS_BLOB_02_028: [ Blob_UploadMultipleBlocksFromSasUri shall construct an XML string with the following content: ]*/
@@ -380,7 +1335,14 @@ BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIEN
                     LogError("failed to STRING_construct");
                     result = BLOB_HTTP_ERROR;
                 }
-                else if ((result = InvokeUserCallbackAndSendBlobs(httpApiExHandle, relativePath, blockIDList, getDataCallbackEx, context, httpStatus, httpResponse)) != BLOB_OK)
+                else if ((sizer != NULL) && ((tickCounter = tickcounter_create()) == NULL))
+                {
+                    LogError("unable to create the tick counter timing the blocks");
+                    result = BLOB_ERROR;
+                }
+                else if ((result = (concurrency > 1) ?
+                    UploadBlocksInParallel(hostname, relativePath, concurrency, certificates, proxyOptions, networkInterface, blockIDList, getBlock, sourceContext, sizer, tickCounter, journal, httpStatus, httpResponse) :
+                    UploadBlocks(httpApiExHandle, relativePath, blockIDList, getBlock, sourceContext, sizer, tickCounter, journal, httpStatus, httpResponse)) != BLOB_OK)
                 {
                    LogError("Failed in invoking callback/sending blob step");
                 }
@@ -388,15 +1350,178 @@ BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIEN
                 {
                     // Per SRS_BLOB_02_026, it possible for us to have a result=BLOB_OK AND a non-success HTTP status code.
                     // In order to maintain back-compat with existing code, we will return the BLOB_OK to the caller but NOT invoke this final step.
-                    result = SendBlockIdList(httpApiExHandle, relativePath, blockIDList, httpStatus, httpResponse);
+                    result = SendBlockIdList(httpApiExHandle, relativePath, blockIDList, contentEncoding, httpStatus, httpResponse);
                 }
             }
         }
     }
 
+    if (tickCounter != NULL)
+    {
+        tickcounter_destroy(tickCounter);
+    }
     HTTPAPIEX_Destroy(httpApiExHandle);
     STRING_delete(blockIDList);
     free(hostname);
 
     return result;
 }
+
+BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions, const char* networkInterface, size_t concurrency, BLOB_UPLOAD_JOURNAL_HANDLE journal)
+{
+    BLOB_RESULT result;
+
+    /*Codes_SRS_BLOB_02_001: [ If SASURI is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+    /*Codes_SRS_BLOB_02_002: [ If getDataCallbackEx is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
+    if ((SASURI == NULL) || (getDataCallbackEx == NULL))
+    {
+        LogError("One or more required values is NULL, SASURI=%p, getDataCallbackEx=%p", SASURI, getDataCallbackEx);
+        result = BLOB_INVALID_ARG;
+    }
+    else
+    {
+        CALLBACK_BLOCK_SOURCE callbackSource;
+        callbackSource.getDataCallbackEx = getDataCallbackEx;
+        callbackSource.context = context;
+
+        result = UploadMultipleBlocks(SASURI, getCallbackBlock, &callbackSource, NULL, NULL, journal, httpStatus, httpResponse, certificates, proxyOptions, networkInterface, concurrency);
+    }
+
+    return result;
+}
+
+// getRemainingFileSize finds how many bytes of the file are left to read, so that the blocks can be made large enough
+// for the file to fit in MAX_BLOCK_COUNT of them. It fails on streams that cannot seek.
+static int getRemainingFileSize(FILE* file, uint64_t* remaining)
+{
+    int result;
+    long start = ftell(file);
+    long end;
+
+    if ((start < 0) || (fseek(file, 0, SEEK_END) != 0))
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        end = ftell(file);
+        if ((fseek(file, start, SEEK_SET) != 0) || (end < start))
+        {
+            LogError("unable to seek back to where the file was");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            *remaining = (uint64_t)(end - start);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+#ifdef USE_BLOB_COMPRESSION
+static int startDeflater(FILE_BLOCK_SOURCE* fileSource)
+{
+    int result;
+
+    if ((fileSource->deflater = (z_stream*)calloc(1, sizeof(z_stream))) == NULL)
+    {
+        LogError("unable to allocate the deflater");
+        result = MU_FAILURE;
+    }
+    else if ((fileSource->input = (unsigned char*)malloc(GZIP_INPUT_SIZE)) == NULL)
+    {
+        LogError("unable to allocate the deflater input");
+        free(fileSource->deflater);
+        fileSource->deflater = NULL;
+        result = MU_FAILURE;
+    }
+    else if (deflateInit2(fileSource->deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, GZIP_WINDOW_BITS, GZIP_MEMORY_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        LogError("deflateInit2 failed");
+        free(fileSource->input);
+        free(fileSource->deflater);
+        fileSource->input = NULL;
+        fileSource->deflater = NULL;
+        result = MU_FAILURE;
+    }
+    else
+    {
+        fileSource->inputEnded = false;
+        fileSource->deflaterEnded = false;
+        result = 0;
+    }
+
+    return result;
+}
+
+static void endDeflater(FILE_BLOCK_SOURCE* fileSource)
+{
+    (void)deflateEnd(fileSource->deflater);
+    free(fileSource->input);
+    free(fileSource->deflater);
+}
+#endif
+
+BLOB_RESULT Blob_UploadMultipleBlocksFromFile(const char* SASURI, FILE* file, bool compress, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions, const char* networkInterface, size_t concurrency, BLOB_UPLOAD_JOURNAL_HANDLE journal)
+{
+    BLOB_RESULT result;
+
+    if ((SASURI == NULL) || (file == NULL))
+    {
+        LogError("One or more required values is NULL, SASURI=%p, file=%p", SASURI, file);
+        result = BLOB_INVALID_ARG;
+    }
+#ifndef USE_BLOB_COMPRESSION
+    else if (compress)
+    {
+        LogError("blob uploads are built without compression (use_blob_compression)");
+        result = BLOB_NOT_IMPLEMENTED;
+    }
+#endif
+    else
+    {
+        FILE_BLOCK_SOURCE fileSource;
+        BLOB_BLOCK_SIZER_HANDLE sizer;
+
+        (void)memset(&fileSource, 0, sizeof(fileSource));
+        fileSource.file = file;
+        /*a stream that cannot seek is uploaded in blocks of BLOCK_SIZE*/
+        fileSource.sizeKnown = (getRemainingFileSize(file, &fileSource.remaining) == 0);
+
+        if ((sizer = blob_block_sizer_create(BLOB_MIN_ADAPTIVE_BLOCK_SIZE, BLOCK_SIZE)) == NULL)
+        {
+            LogError("unable to create the block sizer");
+            result = BLOB_ERROR;
+        }
+#ifdef USE_BLOB_COMPRESSION
+        else if (compress && (startDeflater(&fileSource) != 0))
+        {
+            blob_block_sizer_destroy(sizer);
+            result = BLOB_ERROR;
+        }
+#endif
+        else
+        {
+            const char* contentEncoding = NULL;
+#ifdef USE_BLOB_COMPRESSION
+            if (compress)
+            {
+                contentEncoding = gzipContentEncoding;
+            }
+#endif
+            result = UploadMultipleBlocks(SASURI, getFileBlock, &fileSource, sizer, contentEncoding, journal, httpStatus, httpResponse, certificates, proxyOptions, networkInterface, concurrency);
+
+#ifdef USE_BLOB_COMPRESSION
+            if (compress)
+            {
+                endDeflater(&fileSource);
+            }
+#endif
+            blob_block_sizer_destroy(sizer);
+        }
+    }
+
+    return result;
+}
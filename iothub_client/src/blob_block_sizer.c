@@ -0,0 +1,108 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "internal/blob_block_sizer.h"
+
+typedef struct BLOB_BLOCK_SIZER_TAG
+{
+    size_t min_size;
+    size_t max_size;
+    size_t size;
+    /*bytes per second measured with blocks of half the current size, 0 when there is no such measure*/
+    uint64_t previous_throughput;
+    bool growing;
+} BLOB_BLOCK_SIZER;
+
+BLOB_BLOCK_SIZER_HANDLE blob_block_sizer_create(size_t min_size, size_t max_size)
+{
+    BLOB_BLOCK_SIZER* result;
+
+    if (min_size == 0 || min_size > max_size)
+    {
+        LogError("Invalid argument (min_size=%lu, max_size=%lu)", (unsigned long)min_size, (unsigned long)max_size);
+        result = NULL;
+    }
+    else if ((result = (BLOB_BLOCK_SIZER*)malloc(sizeof(BLOB_BLOCK_SIZER))) == NULL)
+    {
+        LogError("failed allocating the block sizer");
+    }
+    else
+    {
+        result->min_size = min_size;
+        result->max_size = max_size;
+        result->size = (BLOB_BLOCK_SIZER_INITIAL_SIZE < min_size) ? min_size :
+            (BLOB_BLOCK_SIZER_INITIAL_SIZE > max_size) ? max_size : BLOB_BLOCK_SIZER_INITIAL_SIZE;
+        result->previous_throughput = 0;
+        result->growing = (result->size < max_size);
+    }
+
+    return result;
+}
+
+void blob_block_sizer_destroy(BLOB_BLOCK_SIZER_HANDLE sizer)
+{
+    if (sizer == NULL)
+    {
+        LogError("Invalid argument (sizer=NULL)");
+    }
+    else
+    {
+        free(sizer);
+    }
+}
+
+size_t blob_block_sizer_get_size(BLOB_BLOCK_SIZER_HANDLE sizer)
+{
+    size_t result;
+
+    if (sizer == NULL)
+    {
+        LogError("Invalid argument (sizer=NULL)");
+        result = 0;
+    }
+    else
+    {
+        result = sizer->size;
+    }
+
+    return result;
+}
+
+void blob_block_sizer_on_block_sent(BLOB_BLOCK_SIZER_HANDLE sizer, size_t size, tickcounter_ms_t elapsed_ms, bool retried)
+{
+    if (sizer == NULL)
+    {
+        LogError("Invalid argument (sizer=NULL)");
+    }
+    else if (retried)
+    {
+        /*the link drops blocks of this size, smaller ones lose less when they fail*/
+        size_t smaller = ((size < sizer->size) ? size : sizer->size) / 2;
+        sizer->size = (smaller < sizer->min_size) ? sizer->min_size : smaller;
+        sizer->previous_throughput = 0;
+        sizer->growing = (sizer->size < sizer->max_size);
+    }
+    /*blocks of an earlier size can still complete when several are in flight, they say nothing about the current size*/
+    else if (sizer->growing && (size == sizer->size))
+    {
+        uint64_t throughput = (elapsed_ms < BLOB_BLOCK_SIZER_MIN_SAMPLE_MS) ? 0 : ((uint64_t)size * 1000) / elapsed_ms;
+
+        if ((throughput != 0) && (sizer->previous_throughput != 0) &&
+            (throughput * 100 < sizer->previous_throughput * (100 + BLOB_BLOCK_SIZER_MIN_GAIN_PERCENT)))
+        {
+            /*the round trip is no longer a large part of the time of a block, larger blocks would not be faster*/
+            sizer->growing = false;
+        }
+        else
+        {
+            sizer->previous_throughput = throughput;
+            sizer->size = (size > sizer->max_size / 2) ? sizer->max_size : size * 2;
+            sizer->growing = (sizer->size < sizer->max_size);
+        }
+    }
+}
@@ -0,0 +1,455 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/sha.h"
+#include "internal/blob_upload_journal.h"
+
+#define JOURNAL_BLOB_PREFIX         "blob "
+/*a block line is "<block id> <block size> <hash in hex>\n"*/
+#define JOURNAL_LINE_SIZE           (40 + 2 * BLOB_UPLOAD_JOURNAL_HASH_SIZE)
+#define INITIAL_BLOCK_CAPACITY      64
+/*bytes of the hash of the blob URL that name the journal file of the blob*/
+#define JOURNAL_FILE_HASH_SIZE      8
+
+typedef struct BLOB_UPLOAD_JOURNAL_BLOCK_TAG
+{
+    bool uploaded;
+    size_t size;
+    unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+} BLOB_UPLOAD_JOURNAL_BLOCK;
+
+typedef struct BLOB_UPLOAD_JOURNAL_TAG
+{
+    char* path;
+    FILE* file;
+    LOCK_HANDLE lock;
+    /*indexed by block id*/
+    BLOB_UPLOAD_JOURNAL_BLOCK* blocks;
+    size_t block_capacity;
+} BLOB_UPLOAD_JOURNAL;
+
+static const char hexDigits[] = "0123456789abcdef";
+
+static int hex_value(char c)
+{
+    int result;
+    if (c >= '0' && c <= '9')
+    {
+        result = c - '0';
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+        result = c - 'a' + 10;
+    }
+    else
+    {
+        result = -1;
+    }
+    return result;
+}
+
+/*makes room for block_id. Called with the lock held (or before the journal is shared).*/
+static int reserve_block(BLOB_UPLOAD_JOURNAL* journal, unsigned int block_id)
+{
+    int result;
+
+    if (block_id < journal->block_capacity)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t new_capacity = (journal->block_capacity == 0) ? INITIAL_BLOCK_CAPACITY : journal->block_capacity;
+        BLOB_UPLOAD_JOURNAL_BLOCK* new_blocks;
+
+        while (new_capacity <= block_id)
+        {
+            new_capacity *= 2;
+        }
+
+        if ((new_blocks = (BLOB_UPLOAD_JOURNAL_BLOCK*)realloc(journal->blocks, new_capacity * sizeof(BLOB_UPLOAD_JOURNAL_BLOCK))) == NULL)
+        {
+            LogError("failed allocating the journal of %lu blocks", (unsigned long)new_capacity);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            (void)memset(new_blocks + journal->block_capacity, 0, (new_capacity - journal->block_capacity) * sizeof(BLOB_UPLOAD_JOURNAL_BLOCK));
+            journal->blocks = new_blocks;
+            journal->block_capacity = new_capacity;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/*reads "<block id> <block size> <hash>" lines until the end of the file. A malformed line (e.g. one cut short by a crash) ends the journal.*/
+static void load_blocks(BLOB_UPLOAD_JOURNAL* journal, FILE* file)
+{
+    char line[JOURNAL_LINE_SIZE];
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char* size_text;
+        char* hex;
+        unsigned long block_id = strtoul(line, &size_text, 10);
+        unsigned long size;
+        unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+        size_t i;
+
+        if (size_text == line || *size_text != ' ')
+        {
+            break;
+        }
+
+        size = strtoul(size_text + 1, &hex, 10);
+        if (hex == size_text + 1 || *hex != ' ' || strlen(hex + 1) < 2 * BLOB_UPLOAD_JOURNAL_HASH_SIZE || hex[1 + 2 * BLOB_UPLOAD_JOURNAL_HASH_SIZE] != '\n')
+        {
+            break;
+        }
+
+        hex++;
+        for (i = 0; i < BLOB_UPLOAD_JOURNAL_HASH_SIZE; i++)
+        {
+            int high = hex_value(hex[2 * i]);
+            int low = hex_value(hex[2 * i + 1]);
+            if (high < 0 || low < 0)
+            {
+                break;
+            }
+            hash[i] = (unsigned char)((high << 4) | low);
+        }
+
+        if (i < BLOB_UPLOAD_JOURNAL_HASH_SIZE || block_id > 0xFFFFFFFFUL || reserve_block(journal, (unsigned int)block_id) != 0)
+        {
+            break;
+        }
+
+        journal->blocks[block_id].uploaded = true;
+        journal->blocks[block_id].size = (size_t)size;
+        (void)memcpy(journal->blocks[block_id].hash, hash, BLOB_UPLOAD_JOURNAL_HASH_SIZE);
+    }
+}
+
+static int write_block(FILE* file, unsigned int block_id, size_t size, const unsigned char* hash)
+{
+    char line[JOURNAL_LINE_SIZE];
+    size_t length = (size_t)sprintf(line, "%u %lu ", block_id, (unsigned long)size);
+    size_t i;
+
+    for (i = 0; i < BLOB_UPLOAD_JOURNAL_HASH_SIZE; i++)
+    {
+        line[length++] = hexDigits[hash[i] >> 4];
+        line[length++] = hexDigits[hash[i] & 0x0F];
+    }
+    line[length++] = '\n';
+
+    return (fwrite(line, 1, length, file) == length) ? 0 : MU_FAILURE;
+}
+
+/*writes the journal from scratch: the blob URL, then the blocks already recorded. Rewriting (rather than appending)
+drops a last line cut short by a crash.*/
+static int write_journal(BLOB_UPLOAD_JOURNAL* journal, const char* sas_uri, size_t url_length)
+{
+    int result;
+
+    if (fprintf(journal->file, JOURNAL_BLOB_PREFIX "%.*s\n", (int)url_length, sas_uri) < 0)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        size_t i;
+
+        result = 0;
+        for (i = 0; i < journal->block_capacity && result == 0; i++)
+        {
+            if (journal->blocks[i].uploaded)
+            {
+                result = write_block(journal->file, (unsigned int)i, journal->blocks[i].size, journal->blocks[i].hash);
+            }
+        }
+
+        if (result == 0 && fflush(journal->file) != 0)
+        {
+            result = MU_FAILURE;
+        }
+    }
+
+    return result;
+}
+
+/*returns true when the first line of file is the blob URL (url_length characters of sas_uri)*/
+static bool is_same_blob(FILE* file, const char* sas_uri, size_t url_length)
+{
+    bool result = true;
+    size_t prefix_length = sizeof(JOURNAL_BLOB_PREFIX) - 1;
+    size_t i;
+
+    for (i = 0; i < prefix_length + url_length && result; i++)
+    {
+        char expected = (i < prefix_length) ? JOURNAL_BLOB_PREFIX[i] : sas_uri[i - prefix_length];
+        result = (fgetc(file) == (unsigned char)expected);
+    }
+
+    return result && (fgetc(file) == '\n');
+}
+
+/*the journal of a blob is journal_path followed by '.' and the start of the hash of the blob URL in hex, so that uploads
+to different blobs, running at the same time or not, do not overwrite each other's journal*/
+static char* create_journal_file_path(const char* journal_path, const char* sas_uri, size_t url_length)
+{
+    char* result;
+    unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+    size_t path_length = strlen(journal_path);
+
+    if (blob_upload_journal_hash_block((const unsigned char*)sas_uri, url_length, hash) != 0)
+    {
+        LogError("failed hashing the blob URL");
+        result = NULL;
+    }
+    else if ((result = (char*)malloc(path_length + 1 + 2 * JOURNAL_FILE_HASH_SIZE + 1)) == NULL)
+    {
+        LogError("failed allocating the journal file path");
+    }
+    else
+    {
+        size_t length = path_length;
+        size_t i;
+
+        (void)memcpy(result, journal_path, path_length);
+        result[length++] = '.';
+        for (i = 0; i < JOURNAL_FILE_HASH_SIZE; i++)
+        {
+            result[length++] = hexDigits[hash[i] >> 4];
+            result[length++] = hexDigits[hash[i] & 0x0F];
+        }
+        result[length] = '\0';
+    }
+
+    return result;
+}
+
+static void free_journal(BLOB_UPLOAD_JOURNAL* journal)
+{
+    if (journal->file != NULL)
+    {
+        (void)fclose(journal->file);
+    }
+    if (journal->lock != NULL)
+    {
+        Lock_Deinit(journal->lock);
+    }
+    free(journal->blocks);
+    free(journal->path);
+    free(journal);
+}
+
+BLOB_UPLOAD_JOURNAL_HANDLE blob_upload_journal_open(const char* journal_path, const char* sas_uri)
+{
+    BLOB_UPLOAD_JOURNAL* result;
+
+    if (journal_path == NULL || sas_uri == NULL)
+    {
+        LogError("Invalid argument (journal_path=%p, sas_uri=%p)", journal_path, sas_uri);
+        result = NULL;
+    }
+    else if ((result = (BLOB_UPLOAD_JOURNAL*)malloc(sizeof(BLOB_UPLOAD_JOURNAL))) == NULL)
+    {
+        LogError("failed allocating the blob upload journal");
+    }
+    else
+    {
+        size_t url_length = strcspn(sas_uri, "?");
+        FILE* existing;
+
+        (void)memset(result, 0, sizeof(BLOB_UPLOAD_JOURNAL));
+
+        if ((result->path = create_journal_file_path(journal_path, sas_uri, url_length)) == NULL)
+        {
+            LogError("unable to name the journal file of the blob");
+            free_journal(result);
+            result = NULL;
+        }
+        else if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free_journal(result);
+            result = NULL;
+        }
+        else
+        {
+            if ((existing = fopen(result->path, "r")) != NULL)
+            {
+                /*blocks uploaded to another blob are of no use to this upload*/
+                if (is_same_blob(existing, sas_uri, url_length))
+                {
+                    load_blocks(result, existing);
+                }
+                (void)fclose(existing);
+            }
+
+            if ((result->file = fopen(result->path, "w")) == NULL || write_journal(result, sas_uri, url_length) != 0)
+            {
+                LogError("unable to write the blob upload journal %s", result->path);
+                free_journal(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+int blob_upload_journal_hash_block(const unsigned char* content, size_t size, unsigned char* hash)
+{
+    int result;
+    SHA256Context sha_ctx;
+
+    if (content == NULL || hash == NULL || size > 0xFFFFFFFFU)
+    {
+        LogError("Invalid argument (content=%p, size=%lu, hash=%p)", content, (unsigned long)size, hash);
+        result = MU_FAILURE;
+    }
+    else if (SHA256Reset(&sha_ctx) != 0)
+    {
+        LogError("Failed sha256 reset");
+        result = MU_FAILURE;
+    }
+    else if (SHA256Input(&sha_ctx, content, (unsigned int)size) != 0)
+    {
+        LogError("Failed SHA256Input");
+        result = MU_FAILURE;
+    }
+    else if (SHA256Result(&sha_ctx, hash) != 0)
+    {
+        LogError("Failed SHA256Result");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+bool blob_upload_journal_has_block(BLOB_UPLOAD_JOURNAL_HANDLE journal, unsigned int block_id, const unsigned char* hash)
+{
+    bool result;
+
+    if (journal == NULL || hash == NULL)
+    {
+        LogError("Invalid argument (journal=%p, hash=%p)", journal, hash);
+        result = false;
+    }
+    else if (Lock(journal->lock) != LOCK_OK)
+    {
+        LogError("failed locking the blob upload journal");
+        result = false;
+    }
+    else
+    {
+        result = (block_id < journal->block_capacity) &&
+            journal->blocks[block_id].uploaded &&
+            (memcmp(journal->blocks[block_id].hash, hash, BLOB_UPLOAD_JOURNAL_HASH_SIZE) == 0);
+        (void)Unlock(journal->lock);
+    }
+
+    return result;
+}
+
+bool blob_upload_journal_get_block_size(BLOB_UPLOAD_JOURNAL_HANDLE journal, unsigned int block_id, size_t* size)
+{
+    bool result;
+
+    if (journal == NULL || size == NULL)
+    {
+        LogError("Invalid argument (journal=%p, size=%p)", journal, size);
+        result = false;
+    }
+    else if (Lock(journal->lock) != LOCK_OK)
+    {
+        LogError("failed locking the blob upload journal");
+        result = false;
+    }
+    else
+    {
+        result = (block_id < journal->block_capacity) && journal->blocks[block_id].uploaded;
+        if (result)
+        {
+            *size = journal->blocks[block_id].size;
+        }
+        (void)Unlock(journal->lock);
+    }
+
+    return result;
+}
+
+int blob_upload_journal_add_block(BLOB_UPLOAD_JOURNAL_HANDLE journal, unsigned int block_id, size_t size, const unsigned char* hash)
+{
+    int result;
+
+    if (journal == NULL || hash == NULL)
+    {
+        LogError("Invalid argument (journal=%p, hash=%p)", journal, hash);
+        result = MU_FAILURE;
+    }
+    else if (Lock(journal->lock) != LOCK_OK)
+    {
+        LogError("failed locking the blob upload journal");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        if (reserve_block(journal, block_id) != 0)
+        {
+            result = MU_FAILURE;
+        }
+        /*the line is flushed right away, so a crash loses at most the blocks still in flight*/
+        else if (write_block(journal->file, block_id, size, hash) != 0 || fflush(journal->file) != 0)
+        {
+            LogError("unable to record block %u in the blob upload journal", block_id);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            journal->blocks[block_id].uploaded = true;
+            journal->blocks[block_id].size = size;
+            (void)memcpy(journal->blocks[block_id].hash, hash, BLOB_UPLOAD_JOURNAL_HASH_SIZE);
+            result = 0;
+        }
+        (void)Unlock(journal->lock);
+    }
+
+    return result;
+}
+
+void blob_upload_journal_close(BLOB_UPLOAD_JOURNAL_HANDLE journal, bool discard)
+{
+    if (journal == NULL)
+    {
+        LogError("Invalid argument (journal=NULL)");
+    }
+    else
+    {
+        (void)fclose(journal->file);
+        journal->file = NULL;
+
+        if (discard && remove(journal->path) != 0)
+        {
+            LogError("unable to delete the blob upload journal %s", journal->path);
+        }
+        free_journal(journal);
+    }
+}
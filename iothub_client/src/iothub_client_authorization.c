@@ -11,23 +11,26 @@
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/sastoken.h"
 #include "azure_c_shared_utility/shared_util_options.h"
-#include "azure_c_shared_utility/azure_base64.h"
-#include "azure_c_shared_utility/buffer_.h"
 
 #ifdef USE_PROV_MODULE
 #include "azure_prov_client/internal/iothub_auth_client.h"
 #endif
 
 #include "internal/iothub_client_authorization.h"
+#include "internal/iothub_client_sas_signer.h"
 
 #define DEFAULT_SAS_TOKEN_EXPIRY_TIME_SECS          3600
 #define INDEFINITE_TIME                             ((time_t)(-1))
 #define MIN_SAS_EXPIRY_TIME                         5  // 5 seconds
+// The expiry of the tokens signed with the device key is rounded down to a twentieth of their lifetime, so the
+// tokens asked for within that time (reconnects, uploads) are the same token and are signed once.
+#define SAS_TOKEN_EXPIRY_BUCKETS                    20
 
 typedef struct IOTHUB_AUTHORIZATION_DATA_TAG
 {
     char* device_sas_token;
     char* device_key;
+    SAS_SIGNER_HANDLE sas_signer;
     char* device_id;
     char* module_id;
     uint64_t token_expiry_time_sec;
@@ -95,31 +98,27 @@ static IOTHUB_AUTHORIZATION_DATA* initialize_auth_client(const char* device_id,
 IOTHUB_AUTHORIZATION_HANDLE IoTHubClient_Auth_Create(const char* device_key, const char* device_id, const char* device_sas_token, const char *module_id)
 {
     IOTHUB_AUTHORIZATION_DATA* result;
+    SAS_SIGNER_HANDLE sas_signer;
     bool is_key_valid;
 
     if (device_key == NULL)
     {
+        sas_signer = NULL;
         is_key_valid = true;
     }
     else
     {
         /* Codes_SRS_IoTHub_Authorization_21_021: [ If the provided key is not base64 encoded, IoTHubClient_Auth_Create shall return NULL. ] */
-        BUFFER_HANDLE key = Azure_Base64_Decode(device_key);
-        if (key != NULL)
-        {
-            is_key_valid = true;
-        }
-        else
-        {
-            is_key_valid = false;
-        }
-        BUFFER_delete(key);
+        // The key is decoded here once, into the signer of all the SAS tokens of this identity.
+        sas_signer = sas_signer_create(device_key);
+        is_key_valid = (sas_signer != NULL);
     }
     
     /* Codes_SRS_IoTHub_Authorization_07_001: [if device_id is NULL IoTHubClient_Auth_Create, shall return NULL. ] */
     if ((device_id == NULL) || (!is_key_valid))
     {
         LogError("Invalid Parameter %s", ((device_id == NULL) ? "device_id: NULL" : "key"));
+        sas_signer_destroy(sas_signer);
         result = NULL;
     }
     else
@@ -128,11 +127,13 @@ IOTHUB_AUTHORIZATION_HANDLE IoTHubClient_Auth_Create(const char* device_key, con
         if (result == NULL)
         {
             LogError("Failure initializing auth client");
+            sas_signer_destroy(sas_signer);
         }
         else if (device_key != NULL && mallocAndStrcpy_s(&result->device_key, device_key) != 0)
         {
             /* Codes_SRS_IoTHub_Authorization_07_019: [ On error IoTHubClient_Auth_Create shall return NULL. ] */
             LogError("Failed allocating device_key");
+            sas_signer_destroy(sas_signer);
             free(result->device_id);
             free(result->module_id);
             free(result);
@@ -140,6 +141,8 @@ IOTHUB_AUTHORIZATION_HANDLE IoTHubClient_Auth_Create(const char* device_key, con
         }
         else
         {
+            result->sas_signer = sas_signer;
+
             if (device_key != NULL)
             {
                 /* Codes_SRS_IoTHub_Authorization_07_003: [ IoTHubClient_Auth_Create shall set the credential type to IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY if the device_sas_token is NULL. ]*/
@@ -229,6 +232,7 @@ void IoTHubClient_Auth_Destroy(IOTHUB_AUTHORIZATION_HANDLE handle)
 #ifdef USE_PROV_MODULE
         iothub_device_auth_destroy(handle->device_auth_handle);
 #endif
+        sas_signer_destroy(handle->sas_signer);
         free(handle->device_key);
         free(handle->device_id);
         free(handle->module_id);
@@ -463,7 +467,6 @@ char* IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const c
             }
             else
             {
-                STRING_HANDLE sas_token;
                 uint64_t sec_since_epoch;
 
                 /* Codes_SRS_IoTHub_Authorization_07_010: [ IoTHubClient_Auth_Get_SasToken` shall construct the expiration time using the handle->token_expiry_time_sec added to epoch time. ] */
@@ -475,24 +478,21 @@ char* IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const c
                 }
                 else
                 {
-                    /* Codes_SRS_IoTHub_Authorization_07_011: [ IoTHubClient_Auth_Get_ConnString shall call SASToken_CreateString to construct the sas token. ] */
+                    /* Codes_SRS_IoTHub_Authorization_07_011: [ IoTHubClient_Auth_Get_ConnString shall call sas_signer_get_token to construct the sas token. ] */
                     uint64_t expiry_time = sec_since_epoch + handle->token_expiry_time_sec;
-                    if ( (sas_token = SASToken_CreateString(handle->device_key, scope, key_name, expiry_time)) == NULL)
+                    uint64_t expiry_bucket = handle->token_expiry_time_sec / SAS_TOKEN_EXPIRY_BUCKETS;
+
+                    /* Codes_SRS_IoTHub_Authorization_07_027: [ IoTHubClient_Auth_Get_SasToken shall round the expiration time down to a multiple of a twentieth of handle->token_expiry_time_sec, so tokens asked for within that time are the same token and their lifetime is up to 5% shorter than handle->token_expiry_time_sec. ] */
+                    if (expiry_bucket > 1)
                     {
-                        /* Codes_SRS_IoTHub_Authorization_07_020: [ If any error is encountered IoTHubClient_Auth_Get_ConnString shall return NULL. ] */
-                        LogError("Failed creating sas_token");
-                        result = NULL;
+                        expiry_time -= expiry_time % expiry_bucket;
                     }
-                    else
+
+                    /* Codes_SRS_IoTHub_Authorization_07_012: [ On success IoTHubClient_Auth_Get_ConnString shall allocate and return the sas token in a char*. ] */
+                    if ((result = sas_signer_get_token(handle->sas_signer, scope, key_name, expiry_time)) == NULL)
                     {
-                        /* Codes_SRS_IoTHub_Authorization_07_012: [ On success IoTHubClient_Auth_Get_ConnString shall allocate and return the sas token in a char*. ] */
-                        if (mallocAndStrcpy_s(&result, STRING_c_str(sas_token) ) != 0)
-                        {
-                            /* Codes_SRS_IoTHub_Authorization_07_020: [ If any error is encountered IoTHubClient_Auth_Get_ConnString shall return NULL. ] */
-                            LogError("Failed copying result");
-                            result = NULL;
-                        }
-                        STRING_delete(sas_token);
+                        /* Codes_SRS_IoTHub_Authorization_07_020: [ If any error is encountered IoTHubClient_Auth_Get_ConnString shall return NULL. ] */
+                        LogError("Failed creating sas_token");
                     }
                 }
             }
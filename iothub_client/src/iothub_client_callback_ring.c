@@ -0,0 +1,184 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "internal/iothub_client_callback_ring.h"
+
+typedef struct CALLBACK_RING_TAG
+{
+    LOCK_HANDLE lock;
+    unsigned char* records;
+    size_t record_size;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    size_t high_water;
+} CALLBACK_RING;
+
+CALLBACK_RING_HANDLE callback_ring_create(size_t record_size, size_t capacity)
+{
+    CALLBACK_RING* result;
+
+    if (record_size == 0 || capacity == 0 || capacity > (SIZE_MAX / record_size))
+    {
+        LogError("Invalid argument (record_size=%lu, capacity=%lu)", (unsigned long)record_size, (unsigned long)capacity);
+        result = NULL;
+    }
+    else if ((result = (CALLBACK_RING*)malloc(sizeof(CALLBACK_RING))) == NULL)
+    {
+        LogError("failed allocating the callback ring");
+    }
+    else
+    {
+        memset(result, 0, sizeof(CALLBACK_RING));
+        result->record_size = record_size;
+        result->capacity = capacity;
+
+        if ((result->records = (unsigned char*)malloc(record_size * capacity)) == NULL)
+        {
+            LogError("failed allocating %lu callback records", (unsigned long)capacity);
+            free(result);
+            result = NULL;
+        }
+        else if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free(result->records);
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void callback_ring_destroy(CALLBACK_RING_HANDLE ring)
+{
+    if (ring != NULL)
+    {
+        Lock_Deinit(ring->lock);
+        free(ring->records);
+        free(ring);
+    }
+}
+
+int callback_ring_push(CALLBACK_RING_HANDLE ring, const void* record)
+{
+    int result;
+
+    if (ring == NULL || record == NULL)
+    {
+        LogError("Invalid argument (ring=%p, record=%p)", ring, record);
+        result = MU_FAILURE;
+    }
+    else if (Lock(ring->lock) != LOCK_OK)
+    {
+        LogError("failed locking the callback ring");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        if (ring->count == ring->capacity)
+        {
+            LogError("callback ring is full (%lu records)", (unsigned long)ring->capacity);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            size_t tail = (ring->head + ring->count) % ring->capacity;
+            (void)memcpy(ring->records + (tail * ring->record_size), record, ring->record_size);
+            ring->count++;
+            if (ring->count > ring->high_water)
+            {
+                ring->high_water = ring->count;
+            }
+            result = 0;
+        }
+        (void)Unlock(ring->lock);
+    }
+
+    return result;
+}
+
+int callback_ring_pop(CALLBACK_RING_HANDLE ring, void* record)
+{
+    int result;
+
+    if (ring == NULL || record == NULL)
+    {
+        LogError("Invalid argument (ring=%p, record=%p)", ring, record);
+        result = MU_FAILURE;
+    }
+    else if (Lock(ring->lock) != LOCK_OK)
+    {
+        LogError("failed locking the callback ring");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        if (ring->count == 0)
+        {
+            result = MU_FAILURE;
+        }
+        else
+        {
+            (void)memcpy(record, ring->records + (ring->head * ring->record_size), ring->record_size);
+            ring->head = (ring->head + 1) % ring->capacity;
+            ring->count--;
+            result = 0;
+        }
+        (void)Unlock(ring->lock);
+    }
+
+    return result;
+}
+
+size_t callback_ring_get_count(CALLBACK_RING_HANDLE ring)
+{
+    size_t result;
+
+    if (ring == NULL)
+    {
+        result = 0;
+    }
+    else if (Lock(ring->lock) != LOCK_OK)
+    {
+        LogError("failed locking the callback ring");
+        result = 0;
+    }
+    else
+    {
+        result = ring->count;
+        (void)Unlock(ring->lock);
+    }
+
+    return result;
+}
+
+size_t callback_ring_get_high_water(CALLBACK_RING_HANDLE ring)
+{
+    size_t result;
+
+    if (ring == NULL)
+    {
+        result = 0;
+    }
+    else if (Lock(ring->lock) != LOCK_OK)
+    {
+        LogError("failed locking the callback ring");
+        result = 0;
+    }
+    else
+    {
+        result = ring->high_water;
+        (void)Unlock(ring->lock);
+    }
+
+    return result;
+}
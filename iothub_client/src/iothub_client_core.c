@@ -7,6 +7,7 @@
 
 #include <signal.h>
 #include <stddef.h>
+#include <limits.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iothub_client_core.h"
@@ -16,16 +17,25 @@
 #include "internal/iothubtransport.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 #include "iothub_client_options.h"
+#include "iothub_client_executor.h"
+#include "internal/iothub_client_callback_ring.h"
+#include "internal/iothub_client_dispatch_pool.h"
 #include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/agenttime.h"
 
 
 #define DO_WORK_FREQ_DEFAULT 1
 #define DO_WORK_MAXIMUM_ALLOWED_FREQUENCY 100
+/*input messages are spread over this many dispatch pool categories by input name, so each input queue stays in order*/
+#define INPUT_MESSAGE_DISPATCH_LANES 4
+#define DISPATCH_POOL_CATEGORY_COUNT (IOTHUB_CLIENT_CALLBACK_CATEGORY_INPUT_MESSAGE + INPUT_MESSAGE_DISPATCH_LANES)
+/*callbacks waiting in the dispatch pool at once; past that the worker thread waits for a pool thread to catch up*/
+#define DISPATCH_POOL_QUEUE_CAPACITY 256
 
 struct IOTHUB_QUEUE_CONTEXT_TAG;
 
@@ -50,6 +60,15 @@ typedef struct IOTHUB_CLIENT_CORE_INSTANCE_TAG
     struct IOTHUB_QUEUE_CONTEXT_TAG* method_user_context;
     tickcounter_ms_t do_work_freq_ms;
     tickcounter_ms_t currentMessageTimeout;
+    tickcounter_ms_t wake_on_work_max_idle_ms; /*0 means the worker thread polls every do_work_freq_ms*/
+    COND_HANDLE WorkSignal; /*posted by the API calls that queue work, only created in wake-on-work mode*/
+    int work_signaled;
+    TICK_COUNTER_HANDLE worker_tick_counter;
+    IOTHUB_CLIENT_WORKER_STATISTICS worker_statistics;
+    IOTHUB_CLIENT_EXECUTOR_HANDLE executor; /*when set, DoWork runs on the executor threads instead of a thread owned by this client*/
+    IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE executor_entry;
+    CALLBACK_RING_HANDLE callback_ring; /*when set, replaces saved_user_callback_list*/
+    DISPATCH_POOL_HANDLE dispatch_pool; /*when set, user callbacks run on the pool threads instead of the worker thread*/
 } IOTHUB_CLIENT_CORE_INSTANCE;
 
 typedef enum HTTPWORKER_THREAD_TYPE_TAG
@@ -164,6 +183,25 @@ typedef struct USER_CALLBACK_INFO_TAG
     } iothub_callback;
 } USER_CALLBACK_INFO;
 
+/*callbacks that dispatch_user_callback reads from the instance once per batch, as it runs without the lock held*/
+typedef struct DISPATCH_CALLBACKS_TAG
+{
+    IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK desired_state_callback;
+    IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connection_status_callback;
+    IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback;
+    IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inbound_device_method_callback;
+    IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC message_callback;
+    IOTHUB_CLIENT_CORE_HANDLE message_user_context_handle;
+    IOTHUB_CLIENT_CORE_HANDLE method_user_context_handle;
+} DISPATCH_CALLBACKS;
+
+/*record queued to dispatch_pool; carries the callbacks read when it was queued*/
+typedef struct POOLED_USER_CALLBACK_TAG
+{
+    USER_CALLBACK_INFO queued_cb;
+    DISPATCH_CALLBACKS dispatch_callbacks;
+} POOLED_USER_CALLBACK;
+
 typedef struct IOTHUB_QUEUE_CONTEXT_TAG
 {
     IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientHandle;
@@ -269,6 +307,32 @@ static void garbageCollectorImpl(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstan
     }
 }
 
+/*queues a callback to be dispatched by the worker thread. Called with LockHandle held, from within the IoTHubClientCore_LL calls.*/
+static int queue_user_callback(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, const USER_CALLBACK_INFO* queue_cb_info)
+{
+    int result;
+
+    /*once the ring overflows, the callbacks that follow go to the list too, so they are dispatched after the ring ones*/
+    if (iotHubClientInstance->callback_ring != NULL &&
+        VECTOR_size(iotHubClientInstance->saved_user_callback_list) == 0 &&
+        callback_ring_push(iotHubClientInstance->callback_ring, queue_cb_info) == 0)
+    {
+        result = 0;
+    }
+    else if ((result = VECTOR_push_back(iotHubClientInstance->saved_user_callback_list, queue_cb_info, 1)) == 0)
+    {
+        if (iotHubClientInstance->callback_ring != NULL)
+        {
+            iotHubClientInstance->worker_statistics.overflowed_callbacks++;
+        }
+    }
+    else
+    {
+        iotHubClientInstance->worker_statistics.dropped_callbacks++;
+    }
+
+    return result;
+}
 
 static bool iothub_ll_message_callback(MESSAGE_CALLBACK_INFO* messageData, void* userContextCallback)
 {
@@ -285,7 +349,7 @@ static bool iothub_ll_message_callback(MESSAGE_CALLBACK_INFO* messageData, void*
         queue_cb_info.type = CALLBACK_TYPE_MESSAGE;
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.message_cb_info = messageData;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) == 0)
+        if (queue_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) == 0)
         {
             result = true;
         }
@@ -315,7 +379,7 @@ static bool iothub_ll_inputmessage_callback(MESSAGE_CALLBACK_INFO* message_cb_in
         queue_cb_info.iothub_callback.inputmessage_cb_info.eventHandlerCallback = inputMessageCallbackContext->eventHandlerCallback;
         queue_cb_info.iothub_callback.inputmessage_cb_info.message_cb_info = message_cb_info;
 
-        if (VECTOR_push_back(inputMessageCallbackContext->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) == 0)
+        if (queue_user_callback(inputMessageCallbackContext->iotHubClientHandle, &queue_cb_info) == 0)
         {
             result = true;
         }
@@ -352,7 +416,7 @@ static int make_method_calback_queue_context(USER_CALLBACK_INFO* queue_cb_info,
         }
         else
         {
-            if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, queue_cb_info, 1) == 0)
+            if (queue_user_callback(queue_context->iotHubClientHandle, queue_cb_info) == 0)
             {
                 result = 0;
             }
@@ -431,7 +495,7 @@ static void iothub_ll_connection_status_callback(IOTHUB_CLIENT_CONNECTION_STATUS
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.connection_status_cb_info.status_reason = reason;
         queue_cb_info.iothub_callback.connection_status_cb_info.connection_status = result;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (queue_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
         {
             LogError("connection status callback vector push failed.");
         }
@@ -448,7 +512,7 @@ static void iothub_ll_event_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT r
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.event_confirm_cb_info.confirm_result = result;
         queue_cb_info.iothub_callback.event_confirm_cb_info.eventConfirmationCallback = queue_context->callbackFunction.eventConfirmationCallback;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (queue_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
         {
             LogError("event confirm callback vector push failed.");
         }
@@ -466,7 +530,7 @@ static void iothub_ll_reported_state_callback(int status_code, void* userContext
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.reported_state_cb_info.status_code = status_code;
         queue_cb_info.iothub_callback.reported_state_cb_info.reportedStateCallback = queue_context->callbackFunction.reportedStateCallback;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (queue_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
         {
             LogError("reported state callback vector push failed.");
         }
@@ -512,7 +576,7 @@ static void iothub_ll_device_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state
         }
         if (push_to_vector == 0)
         {
-            if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+            if (queue_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
             {
                 if (queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad != NULL)
                 {
@@ -562,7 +626,7 @@ static void iothub_ll_get_device_twin_async_callback(DEVICE_TWIN_UPDATE_STATE up
             }
         }
 
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (queue_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
         {
             LogError("device twin callback userContextCallback vector push failed.");
 
@@ -580,18 +644,9 @@ static void iothub_ll_get_device_twin_async_callback(DEVICE_TWIN_UPDATE_STATE up
     }
 }
 
-static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, VECTOR_HANDLE call_backs)
+static void get_dispatch_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, DISPATCH_CALLBACKS* dispatch_callbacks)
 {
-    size_t callbacks_length = VECTOR_size(call_backs);
-    size_t index;
-
-    IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK desired_state_callback = NULL;
-    IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connection_status_callback = NULL;
-    IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback = NULL;
-    IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inbound_device_method_callback = NULL;
-    IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC message_callback = NULL;
-    IOTHUB_CLIENT_CORE_HANDLE message_user_context_handle = NULL;
-    IOTHUB_CLIENT_CORE_HANDLE method_user_context_handle = NULL;
+    memset(dispatch_callbacks, 0, sizeof(DISPATCH_CALLBACKS));
 
     // Make a local copy of these callbacks, as we don't run with a lock held and iotHubClientInstance may change mid-run.
     if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
@@ -600,168 +655,320 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientIns
     }
     else
     {
-        desired_state_callback = iotHubClientInstance->desired_state_callback;
-        connection_status_callback = iotHubClientInstance->connection_status_callback;
-        device_method_callback = iotHubClientInstance->device_method_callback;
-        inbound_device_method_callback = iotHubClientInstance->inbound_device_method_callback;
-        message_callback = iotHubClientInstance->message_callback;
+        dispatch_callbacks->desired_state_callback = iotHubClientInstance->desired_state_callback;
+        dispatch_callbacks->connection_status_callback = iotHubClientInstance->connection_status_callback;
+        dispatch_callbacks->device_method_callback = iotHubClientInstance->device_method_callback;
+        dispatch_callbacks->inbound_device_method_callback = iotHubClientInstance->inbound_device_method_callback;
+        dispatch_callbacks->message_callback = iotHubClientInstance->message_callback;
         if (iotHubClientInstance->method_user_context)
         {
-            method_user_context_handle = iotHubClientInstance->method_user_context->iotHubClientHandle;
+            dispatch_callbacks->method_user_context_handle = iotHubClientInstance->method_user_context->iotHubClientHandle;
         }
         if (iotHubClientInstance->message_user_context)
         {
-            message_user_context_handle = iotHubClientInstance->message_user_context->iotHubClientHandle;
+            dispatch_callbacks->message_user_context_handle = iotHubClientInstance->message_user_context->iotHubClientHandle;
         }
 
         (void)Unlock(iotHubClientInstance->LockHandle);
     }
+}
 
-
-    for (index = 0; index < callbacks_length; index++)
+static void dispatch_user_callback(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, const DISPATCH_CALLBACKS* dispatch_callbacks, USER_CALLBACK_INFO* queued_cb)
+{
+    switch (queued_cb->type)
     {
-        USER_CALLBACK_INFO* queued_cb = (USER_CALLBACK_INFO*)VECTOR_element(call_backs, index);
-        if (queued_cb == NULL)
+    case CALLBACK_TYPE_DEVICE_TWIN:
+    {
+        // Callback if for GetTwinAsync
+        if (queued_cb->iothub_callback.dev_twin_cb_info.userCallback)
         {
-            LogError("VECTOR_element at index %zd is NULL.", index);
+            queued_cb->iothub_callback.dev_twin_cb_info.userCallback(
+                queued_cb->iothub_callback.dev_twin_cb_info.update_state,
+                queued_cb->iothub_callback.dev_twin_cb_info.payLoad,
+                queued_cb->iothub_callback.dev_twin_cb_info.size,
+                queued_cb->iothub_callback.dev_twin_cb_info.userContext
+            );
         }
-        else
+        // Callback if for Desired properties.
+        else if (dispatch_callbacks->desired_state_callback)
         {
-            switch (queued_cb->type)
-            {
-            case CALLBACK_TYPE_DEVICE_TWIN:
+            dispatch_callbacks->desired_state_callback(queued_cb->iothub_callback.dev_twin_cb_info.update_state, queued_cb->iothub_callback.dev_twin_cb_info.payLoad, queued_cb->iothub_callback.dev_twin_cb_info.size, queued_cb->userContextCallback);
+        }
+
+        if (queued_cb->iothub_callback.dev_twin_cb_info.payLoad)
+        {
+            free(queued_cb->iothub_callback.dev_twin_cb_info.payLoad);
+        }
+        break;
+    }
+    case CALLBACK_TYPE_EVENT_CONFIRM:
+        if (queued_cb->iothub_callback.event_confirm_cb_info.eventConfirmationCallback)
+        {
+            queued_cb->iothub_callback.event_confirm_cb_info.eventConfirmationCallback(queued_cb->iothub_callback.event_confirm_cb_info.confirm_result, queued_cb->userContextCallback);
+        }
+        break;
+    case CALLBACK_TYPE_REPORTED_STATE:
+        if (queued_cb->iothub_callback.reported_state_cb_info.reportedStateCallback)
+        {
+            queued_cb->iothub_callback.reported_state_cb_info.reportedStateCallback(queued_cb->iothub_callback.reported_state_cb_info.status_code, queued_cb->userContextCallback);
+        }
+        break;
+    case CALLBACK_TYPE_CONNECTION_STATUS:
+        if (dispatch_callbacks->connection_status_callback)
+        {
+            dispatch_callbacks->connection_status_callback(queued_cb->iothub_callback.connection_status_cb_info.connection_status, queued_cb->iothub_callback.connection_status_cb_info.status_reason, queued_cb->userContextCallback);
+        }
+        break;
+    case CALLBACK_TYPE_DEVICE_METHOD:
+        if (dispatch_callbacks->device_method_callback)
+        {
+            const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
+            const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
+            size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
+
+            unsigned char* payload_resp = NULL;
+            size_t response_size = 0;
+            int status = dispatch_callbacks->device_method_callback(method_name, payload, payload_len, &payload_resp, &response_size, queued_cb->userContextCallback);
+
+            if (payload_resp && (response_size > 0))
             {
-                // Callback if for GetTwinAsync
-                if (queued_cb->iothub_callback.dev_twin_cb_info.userCallback)
-                {
-                    queued_cb->iothub_callback.dev_twin_cb_info.userCallback(
-                        queued_cb->iothub_callback.dev_twin_cb_info.update_state,
-                        queued_cb->iothub_callback.dev_twin_cb_info.payLoad,
-                        queued_cb->iothub_callback.dev_twin_cb_info.size,
-                        queued_cb->iothub_callback.dev_twin_cb_info.userContext
-                    );
-                }
-                // Callback if for Desired properties.
-                else if (desired_state_callback)
+                IOTHUB_CLIENT_RESULT result = IoTHubClientCore_DeviceMethodResponse(dispatch_callbacks->method_user_context_handle, queued_cb->iothub_callback.method_cb_info.method_id, (const unsigned char*)payload_resp, response_size, status);
+                if (result != IOTHUB_CLIENT_OK)
                 {
-                    desired_state_callback(queued_cb->iothub_callback.dev_twin_cb_info.update_state, queued_cb->iothub_callback.dev_twin_cb_info.payLoad, queued_cb->iothub_callback.dev_twin_cb_info.size, queued_cb->userContextCallback);
+                    LogError("IoTHubClientCore_LL_DeviceMethodResponse failed");
                 }
+            }
 
-                if (queued_cb->iothub_callback.dev_twin_cb_info.payLoad)
-                {
-                    free(queued_cb->iothub_callback.dev_twin_cb_info.payLoad);
-                }
-                break;
+            BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
+            STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
+
+            if (payload_resp)
+            {
+                free(payload_resp);
             }
-            case CALLBACK_TYPE_EVENT_CONFIRM:
-                if (queued_cb->iothub_callback.event_confirm_cb_info.eventConfirmationCallback)
-                {
-                    queued_cb->iothub_callback.event_confirm_cb_info.eventConfirmationCallback(queued_cb->iothub_callback.event_confirm_cb_info.confirm_result, queued_cb->userContextCallback);
-                }
-                break;
-            case CALLBACK_TYPE_REPORTED_STATE:
-                if (queued_cb->iothub_callback.reported_state_cb_info.reportedStateCallback)
+        }
+        break;
+    case CALLBACK_TYPE_INBOUD_DEVICE_METHOD:
+        if (dispatch_callbacks->inbound_device_method_callback)
+        {
+            const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
+            const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
+            size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
+
+            dispatch_callbacks->inbound_device_method_callback(method_name, payload, payload_len, queued_cb->iothub_callback.method_cb_info.method_id, queued_cb->userContextCallback);
+
+            BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
+            STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
+        }
+        break;
+    case CALLBACK_TYPE_MESSAGE:
+        if (dispatch_callbacks->message_callback && dispatch_callbacks->message_user_context_handle)
+        {
+            IOTHUBMESSAGE_DISPOSITION_RESULT disposition = dispatch_callbacks->message_callback(queued_cb->iothub_callback.message_cb_info->messageHandle, queued_cb->userContextCallback);
+
+            if (Lock(dispatch_callbacks->message_user_context_handle->LockHandle) == LOCK_OK)
+            {
+                IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendMessageDisposition(dispatch_callbacks->message_user_context_handle->IoTHubClientLLHandle, queued_cb->iothub_callback.message_cb_info, disposition);
+                (void)Unlock(dispatch_callbacks->message_user_context_handle->LockHandle);
+                if (result != IOTHUB_CLIENT_OK)
                 {
-                    queued_cb->iothub_callback.reported_state_cb_info.reportedStateCallback(queued_cb->iothub_callback.reported_state_cb_info.status_code, queued_cb->userContextCallback);
+                    LogError("IoTHubClientCore_LL_SendMessageDisposition failed");
                 }
-                break;
-            case CALLBACK_TYPE_CONNECTION_STATUS:
-                if (connection_status_callback)
+            }
+            else
+            {
+                LogError("Lock failed");
+            }
+        }
+        break;
+
+        case CALLBACK_TYPE_INPUTMESSAGE:
+        {
+            const INPUTMESSAGE_CALLBACK_INFO *inputmessage_cb_info = &queued_cb->iothub_callback.inputmessage_cb_info;
+            IOTHUBMESSAGE_DISPOSITION_RESULT disposition = inputmessage_cb_info->eventHandlerCallback(inputmessage_cb_info->message_cb_info->messageHandle, queued_cb->userContextCallback);
+
+            if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
+            {
+                IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendMessageDisposition(iotHubClientInstance->IoTHubClientLLHandle, inputmessage_cb_info->message_cb_info, disposition);
+                (void)Unlock(iotHubClientInstance->LockHandle);
+                if (result != IOTHUB_CLIENT_OK)
                 {
-                    connection_status_callback(queued_cb->iothub_callback.connection_status_cb_info.connection_status, queued_cb->iothub_callback.connection_status_cb_info.status_reason, queued_cb->userContextCallback);
+                    LogError("IoTHubClient_LL_SendMessageDisposition failed");
                 }
-                break;
-            case CALLBACK_TYPE_DEVICE_METHOD:
-                if (device_method_callback)
-                {
-                    const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
-                    const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
-                    size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
+            }
+            else
+            {
+                LogError("Lock failed");
+            }
+        }
+        break;
 
-                    unsigned char* payload_resp = NULL;
-                    size_t response_size = 0;
-                    int status = device_method_callback(method_name, payload, payload_len, &payload_resp, &response_size, queued_cb->userContextCallback);
+    default:
+        LogError("Invalid callback type '%s'", MU_ENUM_TO_STRING(USER_CALLBACK_TYPE, queued_cb->type));
+        break;
+    }
+}
 
-                    if (payload_resp && (response_size > 0))
-                    {
-                        IOTHUB_CLIENT_RESULT result = IoTHubClientCore_DeviceMethodResponse(method_user_context_handle, queued_cb->iothub_callback.method_cb_info.method_id, (const unsigned char*)payload_resp, response_size, status);
-                        if (result != IOTHUB_CLIENT_OK)
-                        {
-                            LogError("IoTHubClientCore_LL_DeviceMethodResponse failed");
-                        }
-                    }
+static void dispatch_pooled_callback(void* context, void* record)
+{
+    POOLED_USER_CALLBACK* pooled_cb = (POOLED_USER_CALLBACK*)record;
+    dispatch_user_callback((IOTHUB_CLIENT_CORE_INSTANCE*)context, &pooled_cb->dispatch_callbacks, &pooled_cb->queued_cb);
+}
 
-                    BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
-                    STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
+static size_t get_input_message_lane(const USER_CALLBACK_INFO* queued_cb)
+{
+    size_t hash = 5381;
+    const char* input_name = IoTHubMessage_GetInputName(queued_cb->iothub_callback.inputmessage_cb_info.message_cb_info->messageHandle);
 
-                    if (payload_resp)
-                    {
-                        free(payload_resp);
-                    }
-                }
-                break;
-            case CALLBACK_TYPE_INBOUD_DEVICE_METHOD:
-                if (inbound_device_method_callback)
-                {
-                    const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
-                    const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
-                    size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
+    if (input_name != NULL)
+    {
+        while (*input_name != '\0')
+        {
+            hash = (hash * 33) ^ (unsigned char)*input_name;
+            input_name++;
+        }
+    }
 
-                    inbound_device_method_callback(method_name, payload, payload_len, queued_cb->iothub_callback.method_cb_info.method_id, queued_cb->userContextCallback);
+    return hash % INPUT_MESSAGE_DISPATCH_LANES;
+}
 
-                    BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
-                    STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
-                }
-                break;
-            case CALLBACK_TYPE_MESSAGE:
-                if (message_callback && message_user_context_handle)
-                {
-                    IOTHUBMESSAGE_DISPOSITION_RESULT disposition = message_callback(queued_cb->iothub_callback.message_cb_info->messageHandle, queued_cb->userContextCallback);
+static size_t get_dispatch_category(const USER_CALLBACK_INFO* queued_cb)
+{
+    size_t result;
+
+    switch (queued_cb->type)
+    {
+    case CALLBACK_TYPE_DEVICE_TWIN:
+        result = IOTHUB_CLIENT_CALLBACK_CATEGORY_DEVICE_TWIN;
+        break;
+    case CALLBACK_TYPE_EVENT_CONFIRM:
+        result = IOTHUB_CLIENT_CALLBACK_CATEGORY_EVENT_CONFIRMATION;
+        break;
+    case CALLBACK_TYPE_REPORTED_STATE:
+        result = IOTHUB_CLIENT_CALLBACK_CATEGORY_REPORTED_STATE;
+        break;
+    case CALLBACK_TYPE_CONNECTION_STATUS:
+        result = IOTHUB_CLIENT_CALLBACK_CATEGORY_CONNECTION_STATUS;
+        break;
+    case CALLBACK_TYPE_DEVICE_METHOD:
+    case CALLBACK_TYPE_INBOUD_DEVICE_METHOD:
+        result = IOTHUB_CLIENT_CALLBACK_CATEGORY_DEVICE_METHOD;
+        break;
+    case CALLBACK_TYPE_MESSAGE:
+        result = IOTHUB_CLIENT_CALLBACK_CATEGORY_MESSAGE;
+        break;
+    default:
+        result = IOTHUB_CLIENT_CALLBACK_CATEGORY_INPUT_MESSAGE + get_input_message_lane(queued_cb);
+        break;
+    }
 
-                    if (Lock(message_user_context_handle->LockHandle) == LOCK_OK)
-                    {
-                        IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendMessageDisposition(message_user_context_handle->IoTHubClientLLHandle, queued_cb->iothub_callback.message_cb_info, disposition);
-                        (void)Unlock(message_user_context_handle->LockHandle);
-                        if (result != IOTHUB_CLIENT_OK)
-                        {
-                            LogError("IoTHubClientCore_LL_SendMessageDisposition failed");
-                        }
-                    }
-                    else
-                    {
-                        LogError("Lock failed");
-                    }
-                }
-                break;
+    return result;
+}
 
-                case CALLBACK_TYPE_INPUTMESSAGE:
-                {
-                    const INPUTMESSAGE_CALLBACK_INFO *inputmessage_cb_info = &queued_cb->iothub_callback.inputmessage_cb_info;
-                    IOTHUBMESSAGE_DISPOSITION_RESULT disposition = inputmessage_cb_info->eventHandlerCallback(inputmessage_cb_info->message_cb_info->messageHandle, queued_cb->userContextCallback);
+/*hands the callback to dispatch_pool when there is one, otherwise (or if that fails) runs it on the calling thread*/
+static void route_user_callback(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, const DISPATCH_CALLBACKS* dispatch_callbacks, USER_CALLBACK_INFO* queued_cb)
+{
+    if (iotHubClientInstance->dispatch_pool == NULL)
+    {
+        dispatch_user_callback(iotHubClientInstance, dispatch_callbacks, queued_cb);
+    }
+    else
+    {
+        POOLED_USER_CALLBACK pooled_cb;
+        pooled_cb.queued_cb = *queued_cb;
+        pooled_cb.dispatch_callbacks = *dispatch_callbacks;
 
-                    if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
-                    {
-                        IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendMessageDisposition(iotHubClientInstance->IoTHubClientLLHandle, inputmessage_cb_info->message_cb_info, disposition);
-                        (void)Unlock(iotHubClientInstance->LockHandle);
-                        if (result != IOTHUB_CLIENT_OK)
-                        {
-                            LogError("IoTHubClient_LL_SendMessageDisposition failed");
-                        }
-                    }
-                    else
-                    {
-                        LogError("Lock failed");
-                    }
-                }
-                break;
+        if (dispatch_pool_submit(iotHubClientInstance->dispatch_pool, get_dispatch_category(queued_cb), &pooled_cb) != 0)
+        {
+            LogError("dispatch_pool_submit failed, running the callback on the worker thread");
+            dispatch_user_callback(iotHubClientInstance, dispatch_callbacks, queued_cb);
+        }
+    }
+}
 
-            default:
-                LogError("Invalid callback type '%s'", MU_ENUM_TO_STRING(USER_CALLBACK_TYPE, queued_cb->type));
+static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, VECTOR_HANDLE call_backs)
+{
+    size_t callbacks_length = VECTOR_size(call_backs);
+    size_t index;
+    DISPATCH_CALLBACKS dispatch_callbacks;
+
+    get_dispatch_callbacks(iotHubClientInstance, &dispatch_callbacks);
+
+    for (index = 0; index < callbacks_length; index++)
+    {
+        USER_CALLBACK_INFO* queued_cb = (USER_CALLBACK_INFO*)VECTOR_element(call_backs, index);
+        if (queued_cb == NULL)
+        {
+            LogError("VECTOR_element at index %zd is NULL.", index);
+        }
+        else
+        {
+            route_user_callback(iotHubClientInstance, &dispatch_callbacks, queued_cb);
+        }
+    }
+    VECTOR_destroy(call_backs);
+}
+
+/*dispatches the first callbacks_length callbacks of callback_ring; the ones queued since wait for the next DoWork*/
+static void dispatch_ring_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, size_t callbacks_length)
+{
+    if (callbacks_length > 0)
+    {
+        size_t index;
+        DISPATCH_CALLBACKS dispatch_callbacks;
+        USER_CALLBACK_INFO queued_cb;
+
+        get_dispatch_callbacks(iotHubClientInstance, &dispatch_callbacks);
+
+        for (index = 0; index < callbacks_length; index++)
+        {
+            if (callback_ring_pop(iotHubClientInstance->callback_ring, &queued_cb) != 0)
+            {
+                LogError("callback_ring_pop failed at index %lu", (unsigned long)index);
                 break;
             }
+            route_user_callback(iotHubClientInstance, &dispatch_callbacks, &queued_cb);
         }
     }
-    VECTOR_destroy(call_backs);
+}
+
+typedef struct QUEUED_USER_CALLBACKS_TAG
+{
+    size_t ring_count;
+    VECTOR_HANDLE list;
+} QUEUED_USER_CALLBACKS;
+
+/*takes the queued callbacks out for dispatch once LockHandle is released. The caller shall hold LockHandle.*/
+static void take_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, QUEUED_USER_CALLBACKS* queued_callbacks)
+{
+    if (iotHubClientInstance->callback_ring == NULL)
+    {
+        queued_callbacks->ring_count = 0;
+    }
+    else
+    {
+        queued_callbacks->ring_count = callback_ring_get_count(iotHubClientInstance->callback_ring);
+    }
+
+    if (iotHubClientInstance->callback_ring != NULL && VECTOR_size(iotHubClientInstance->saved_user_callback_list) == 0)
+    {
+        /*nothing overflowed the ring, no list to move*/
+        queued_callbacks->list = NULL;
+    }
+    else if ((queued_callbacks->list = VECTOR_move(iotHubClientInstance->saved_user_callback_list)) == NULL)
+    {
+        LogError("VECTOR_move failed");
+    }
+}
+
+static void dispatch_queued_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, const QUEUED_USER_CALLBACKS* queued_callbacks)
+{
+    /*the ring callbacks were queued before the ones that overflowed into the list*/
+    dispatch_ring_callbacks(iotHubClientInstance, queued_callbacks->ring_count);
+    if (queued_callbacks->list != NULL)
+    {
+        dispatch_user_callbacks(iotHubClientInstance, queued_callbacks->list);
+    }
 }
 
 static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
@@ -789,10 +996,86 @@ static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
     }
 }
 
+/*wakes up the worker thread if it is blocked waiting for work (wake-on-work mode only). The caller shall hold LockHandle.*/
+static void signal_worker_thread(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->executor_entry != NULL)
+    {
+        iotHubClientInstance->work_signaled = 1;
+        IoTHubClientExecutor_Wake(iotHubClientInstance->executor, iotHubClientInstance->executor_entry);
+    }
+    else if (iotHubClientInstance->WorkSignal != NULL)
+    {
+        iotHubClientInstance->work_signaled = 1;
+        if (Condition_Post(iotHubClientInstance->WorkSignal) != COND_OK)
+        {
+            LogError("failed signaling the worker thread");
+        }
+    }
+}
+
+/*blocks the worker thread until an API call queues work or, when nothing is pending, until the idle period expires.
+While messages are pending the wait is bounded by do_work_freq_ms so acknowledgements and timeouts are still processed on time.*/
+static void wait_for_work(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, unsigned int sleeptime_in_ms)
+{
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("failed locking for wait_for_work");
+        (void)ThreadAPI_Sleep(sleeptime_in_ms);
+    }
+    else
+    {
+        if (!iotHubClientInstance->StopThread && !iotHubClientInstance->work_signaled && iotHubClientInstance->WorkSignal != NULL)
+        {
+            IOTHUB_CLIENT_STATUS send_status;
+            tickcounter_ms_t wait_ms;
+            tickcounter_ms_t wait_start_ms = 0;
+            tickcounter_ms_t wait_end_ms = 0;
+            COND_RESULT wait_result;
+
+            if (IoTHubClientCore_LL_GetSendStatus(iotHubClientInstance->IoTHubClientLLHandle, &send_status) == IOTHUB_CLIENT_OK &&
+                send_status == IOTHUB_CLIENT_SEND_STATUS_IDLE)
+            {
+                wait_ms = iotHubClientInstance->wake_on_work_max_idle_ms;
+            }
+            else
+            {
+                wait_ms = sleeptime_in_ms;
+            }
+
+            if (wait_ms > INT_MAX)
+            {
+                wait_ms = INT_MAX;
+            }
+
+            (void)tickcounter_get_current_ms(iotHubClientInstance->worker_tick_counter, &wait_start_ms);
+            wait_result = Condition_Wait(iotHubClientInstance->WorkSignal, iotHubClientInstance->LockHandle, (int)wait_ms);
+            (void)tickcounter_get_current_ms(iotHubClientInstance->worker_tick_counter, &wait_end_ms);
+
+            iotHubClientInstance->worker_statistics.wakeups++;
+            if (wait_result == COND_TIMEOUT)
+            {
+                iotHubClientInstance->worker_statistics.timeout_wakeups++;
+            }
+            else
+            {
+                iotHubClientInstance->worker_statistics.signaled_wakeups++;
+            }
+            if (wait_end_ms > wait_start_ms)
+            {
+                iotHubClientInstance->worker_statistics.idle_time_ms += (wait_end_ms - wait_start_ms);
+            }
+        }
+        iotHubClientInstance->work_signaled = 0;
+        (void)Unlock(iotHubClientInstance->LockHandle);
+    }
+}
+
 static int ScheduleWork_Thread(void* threadArgument)
 {
     IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)threadArgument;
     unsigned int sleeptime_in_ms = DO_WORK_FREQ_DEFAULT;
+    bool wake_on_work = false;
 
     srand((unsigned int)get_time(NULL));
 
@@ -811,21 +1094,21 @@ static int ScheduleWork_Thread(void* threadArgument)
                 /* Codes_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_SendEvent or IoTHubClient_SetMessageCallback shall call IoTHubClientCore_LL_DoWork every 1 ms by default.] */
                 /* Codes_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClientCore_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
                 IoTHubClientCore_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
+                iotHubClientInstance->worker_statistics.do_work_calls++;
 
                 garbageCollectorImpl(iotHubClientInstance);
-                VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
+                QUEUED_USER_CALLBACKS queued_callbacks;
+                take_user_callbacks(iotHubClientInstance, &queued_callbacks);
                 sleeptime_in_ms = (unsigned int)iotHubClientInstance->do_work_freq_ms; // Update the sleepval within the locked thread.
-                (void)Unlock(iotHubClientInstance->LockHandle);
-                if (call_backs == NULL)
-                {
-                    LogError("VECTOR_move failed");
-                }
-                else
+                wake_on_work = (iotHubClientInstance->WorkSignal != NULL && iotHubClientInstance->wake_on_work_max_idle_ms > 0);
+                if (!wake_on_work)
                 {
-                    dispatch_user_callbacks(iotHubClientInstance, call_backs);
+                    iotHubClientInstance->worker_statistics.wakeups++;
+                    iotHubClientInstance->worker_statistics.timeout_wakeups++;
+                    iotHubClientInstance->worker_statistics.idle_time_ms += sleeptime_in_ms;
                 }
-
-
+                (void)Unlock(iotHubClientInstance->LockHandle);
+                dispatch_queued_callbacks(iotHubClientInstance, &queued_callbacks);
             }
         }
         else
@@ -833,18 +1116,107 @@ static int ScheduleWork_Thread(void* threadArgument)
             /*Codes_SRS_IOTHUBCLIENT_01_040: [If acquiring the lock fails, IoTHubClientCore_LL_DoWork shall not be called.]*/
             /*no code, shall retry*/
         }
-        /* Codes_SRS_IOTHUBCLIENT_041_02: [The thread shall sleep for a specified time in ms as provided through IoTHubClientCore_SetOption, with a default of 1 ms ] */
-        (void)ThreadAPI_Sleep(sleeptime_in_ms);
+
+        if (wake_on_work)
+        {
+            wait_for_work(iotHubClientInstance, sleeptime_in_ms);
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUBCLIENT_041_02: [The thread shall sleep for a specified time in ms as provided through IoTHubClientCore_SetOption, with a default of 1 ms ] */
+            (void)ThreadAPI_Sleep(sleeptime_in_ms);
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+/*runs on an executor thread in place of ScheduleWork_Thread, returns the delay until the next DoWork*/
+static tickcounter_ms_t ScheduleWork_Executor(void* context)
+{
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)context;
+    tickcounter_ms_t result;
+
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("failed locking for ScheduleWork_Executor");
+        result = DO_WORK_FREQ_DEFAULT;
+    }
+    else if (iotHubClientInstance->StopThread)
+    {
+        result = iotHubClientInstance->do_work_freq_ms;
+        (void)Unlock(iotHubClientInstance->LockHandle);
+    }
+    else
+    {
+        IOTHUB_CLIENT_STATUS send_status;
+        QUEUED_USER_CALLBACKS queued_callbacks;
+
+        IoTHubClientCore_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
+        iotHubClientInstance->worker_statistics.do_work_calls++;
+        iotHubClientInstance->worker_statistics.wakeups++;
+        if (iotHubClientInstance->work_signaled)
+        {
+            iotHubClientInstance->worker_statistics.signaled_wakeups++;
+            iotHubClientInstance->work_signaled = 0;
+        }
+        else
+        {
+            iotHubClientInstance->worker_statistics.timeout_wakeups++;
+        }
+
+        garbageCollectorImpl(iotHubClientInstance);
+        take_user_callbacks(iotHubClientInstance, &queued_callbacks);
+
+        if (iotHubClientInstance->wake_on_work_max_idle_ms > 0 &&
+            IoTHubClientCore_LL_GetSendStatus(iotHubClientInstance->IoTHubClientLLHandle, &send_status) == IOTHUB_CLIENT_OK &&
+            send_status == IOTHUB_CLIENT_SEND_STATUS_IDLE)
+        {
+            result = iotHubClientInstance->wake_on_work_max_idle_ms;
+        }
+        else
+        {
+            result = iotHubClientInstance->do_work_freq_ms;
+        }
+        (void)Unlock(iotHubClientInstance->LockHandle);
+
+        dispatch_queued_callbacks(iotHubClientInstance, &queued_callbacks);
     }
 
-    ThreadAPI_Exit(0);
-    return 0;
+    return result;
 }
 
 static IOTHUB_CLIENT_RESULT StartWorkerThreadIfNeeded(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
 {
     IOTHUB_CLIENT_RESULT result;
-    if (iotHubClientInstance->TransportHandle == NULL)
+    if (iotHubClientInstance->executor != NULL)
+    {
+        if (iotHubClientInstance->StopThread)
+        {
+            /*IoTHubClientCore_Destroy already took the entry off the executor*/
+            LogError("the client is being destroyed");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if (iotHubClientInstance->executor_entry == NULL)
+        {
+            iotHubClientInstance->StopThread = 0;
+            if ((iotHubClientInstance->executor_entry = IoTHubClientExecutor_Register(iotHubClientInstance->executor, ScheduleWork_Executor, iotHubClientInstance)) == NULL)
+            {
+                LogError("IoTHubClientExecutor_Register failed");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    else if (iotHubClientInstance->TransportHandle == NULL)
     {
         if (iotHubClientInstance->ThreadHandle == NULL)
         {
@@ -1158,6 +1530,37 @@ IOTHUB_CLIENT_CORE_HANDLE IoTHubClientCore_CreateFromEnvironment(IOTHUB_CLIENT_T
 #endif
 
 
+/*releases a callback that will never be dispatched, completing the pending send confirmations*/
+static void discard_user_callback(USER_CALLBACK_INFO* queue_cb_info)
+{
+    if ((queue_cb_info->type == CALLBACK_TYPE_DEVICE_METHOD) || (queue_cb_info->type == CALLBACK_TYPE_INBOUD_DEVICE_METHOD))
+    {
+        STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
+        BUFFER_delete(queue_cb_info->iothub_callback.method_cb_info.payload);
+    }
+    else if (queue_cb_info->type == CALLBACK_TYPE_DEVICE_TWIN)
+    {
+        if (queue_cb_info->iothub_callback.dev_twin_cb_info.payLoad != NULL)
+        {
+            free(queue_cb_info->iothub_callback.dev_twin_cb_info.payLoad);
+        }
+    }
+    else if (queue_cb_info->type == CALLBACK_TYPE_EVENT_CONFIRM)
+    {
+        if (queue_cb_info->iothub_callback.event_confirm_cb_info.eventConfirmationCallback)
+        {
+            queue_cb_info->iothub_callback.event_confirm_cb_info.eventConfirmationCallback(queue_cb_info->iothub_callback.event_confirm_cb_info.confirm_result, queue_cb_info->userContextCallback);
+        }
+    }
+    else if (queue_cb_info->type == CALLBACK_TYPE_REPORTED_STATE)
+    {
+        if (queue_cb_info->iothub_callback.reported_state_cb_info.reportedStateCallback)
+        {
+            queue_cb_info->iothub_callback.reported_state_cb_info.reportedStateCallback(queue_cb_info->iothub_callback.reported_state_cb_info.status_code, queue_cb_info->userContextCallback);
+        }
+    }
+}
+
 /* Codes_SRS_IOTHUBCLIENT_01_005: [IoTHubClient_Destroy shall free all resources associated with the iotHubClientHandle instance.] */
 void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
 {
@@ -1167,6 +1570,7 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
         bool joinClientThread;
         bool joinTransportThread;
         size_t vector_size;
+        IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE executor_entry = NULL;
 
         IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
 
@@ -1189,10 +1593,18 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
         if (iotHubClientInstance->ThreadHandle != NULL)
         {
             iotHubClientInstance->StopThread = 1;
+            signal_worker_thread(iotHubClientInstance);
             joinClientThread = true;
         }
         else
         {
+            if (iotHubClientInstance->executor_entry != NULL)
+            {
+                /*callbacks still running on the dispatch pool shall not wake the entry once Unregister freed it*/
+                iotHubClientInstance->StopThread = 1;
+                executor_entry = iotHubClientInstance->executor_entry;
+                iotHubClientInstance->executor_entry = NULL;
+            }
             joinClientThread = false;
         }
 
@@ -1202,6 +1614,12 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
             LogError("unable to Unlock");
         }
 
+        if (executor_entry != NULL)
+        {
+            /*waits for a DoWork in progress on an executor thread to return*/
+            IoTHubClientExecutor_Unregister(iotHubClientInstance->executor, executor_entry);
+        }
+
         if (joinClientThread == true)
         {
             int res;
@@ -1218,6 +1636,13 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
             IoTHubTransport_JoinWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientHandle);
         }
 
+        if (iotHubClientInstance->dispatch_pool != NULL)
+        {
+            /*runs the callbacks still queued, which may need LockHandle and the IoTHubClientCore_LL handle*/
+            dispatch_pool_destroy(iotHubClientInstance->dispatch_pool);
+            iotHubClientInstance->dispatch_pool = NULL;
+        }
+
         if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
         {
             LogError("unable to Lock - - will still proceed to try to end the thread without locking");
@@ -1251,36 +1676,30 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
             USER_CALLBACK_INFO* queue_cb_info = (USER_CALLBACK_INFO*)VECTOR_element(iotHubClientInstance->saved_user_callback_list, index);
             if (queue_cb_info != NULL)
             {
-                if ((queue_cb_info->type == CALLBACK_TYPE_DEVICE_METHOD) || (queue_cb_info->type == CALLBACK_TYPE_INBOUD_DEVICE_METHOD))
-                {
-                    STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
-                    BUFFER_delete(queue_cb_info->iothub_callback.method_cb_info.payload);
-                }
-                else if (queue_cb_info->type == CALLBACK_TYPE_DEVICE_TWIN)
-                {
-                    if (queue_cb_info->iothub_callback.dev_twin_cb_info.payLoad != NULL)
-                    {
-                        free(queue_cb_info->iothub_callback.dev_twin_cb_info.payLoad);
-                    }
-                }
-                else if (queue_cb_info->type == CALLBACK_TYPE_EVENT_CONFIRM)
-                {
-                    if (queue_cb_info->iothub_callback.event_confirm_cb_info.eventConfirmationCallback)
-                    {
-                        queue_cb_info->iothub_callback.event_confirm_cb_info.eventConfirmationCallback(queue_cb_info->iothub_callback.event_confirm_cb_info.confirm_result, queue_cb_info->userContextCallback);
-                    }
-                }
-                else if (queue_cb_info->type == CALLBACK_TYPE_REPORTED_STATE)
-                {
-                    if (queue_cb_info->iothub_callback.reported_state_cb_info.reportedStateCallback)
-                    {
-                        queue_cb_info->iothub_callback.reported_state_cb_info.reportedStateCallback(queue_cb_info->iothub_callback.reported_state_cb_info.status_code, queue_cb_info->userContextCallback);
-                    }
-                }
+                discard_user_callback(queue_cb_info);
             }
         }
         VECTOR_destroy(iotHubClientInstance->saved_user_callback_list);
 
+        if (iotHubClientInstance->callback_ring != NULL)
+        {
+            USER_CALLBACK_INFO queue_cb_info;
+            while (callback_ring_pop(iotHubClientInstance->callback_ring, &queue_cb_info) == 0)
+            {
+                discard_user_callback(&queue_cb_info);
+            }
+            callback_ring_destroy(iotHubClientInstance->callback_ring);
+        }
+
+        if (iotHubClientInstance->WorkSignal != NULL)
+        {
+            Condition_Deinit(iotHubClientInstance->WorkSignal);
+        }
+        if (iotHubClientInstance->worker_tick_counter != NULL)
+        {
+            tickcounter_destroy(iotHubClientInstance->worker_tick_counter);
+        }
+
         if (iotHubClientInstance->TransportHandle == NULL)
         {
             /* Codes_SRS_IOTHUBCLIENT_01_032: [If the lock was allocated in IoTHubClient_Create, it shall be also freed..] */
@@ -1306,7 +1725,14 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
     }
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+static IOTHUB_CLIENT_RESULT ll_send_event_async(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool moveMessage)
+{
+    return moveMessage ?
+        IoTHubClientCore_LL_SendEventAsyncMove(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback) :
+        IoTHubClientCore_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+}
+
+static IOTHUB_CLIENT_RESULT send_event_async(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool moveMessage)
 {
     IOTHUB_CLIENT_RESULT result;
 
@@ -1340,7 +1766,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
             {
                 if (iotHubClientInstance->created_with_transport_handle != 0 || eventConfirmationCallback == NULL)
                 {
-                    result = IoTHubClientCore_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+                    result = ll_send_event_async(iotHubClientInstance, eventMessageHandle, eventConfirmationCallback, userContextCallback, moveMessage);
                 }
                 else
                 {
@@ -1358,7 +1784,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
                         queue_context->callbackFunction.eventConfirmationCallback = eventConfirmationCallback;
                         /* Codes_SRS_IOTHUBCLIENT_01_012: [IoTHubClient_SendEventAsync shall call IoTHubClientCore_LL_SendEventAsync, while passing the IoTHubClientCore_LL handle created by IoTHubClient_Create and the parameters eventMessageHandle, eventConfirmationCallback and userContextCallback.] */
                         /* Codes_SRS_IOTHUBCLIENT_01_013: [When IoTHubClientCore_LL_SendEventAsync is called, IoTHubClient_SendEventAsync shall return the result of IoTHubClientCore_LL_SendEventAsync.] */
-                        result = IoTHubClientCore_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, iothub_ll_event_confirm_callback, queue_context);
+                        result = ll_send_event_async(iotHubClientInstance, eventMessageHandle, iothub_ll_event_confirm_callback, queue_context, moveMessage);
                         if (result != IOTHUB_CLIENT_OK)
                         {
                             LogError("IoTHubClientCore_LL_SendEventAsync failed");
@@ -1368,6 +1794,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
                 }
 
                 /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
+                signal_worker_thread(iotHubClientInstance);
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -1376,6 +1803,16 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, false);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsyncMove(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, true);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_GetSendStatus(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1486,6 +1923,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetMessageCallback(IOTHUB_CLIENT_CORE_HAND
                 }
 
                 /* Codes_SRS_IOTHUBCLIENT_01_027: [IoTHubClient_SetMessageCallback shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
+                signal_worker_thread(iotHubClientInstance);
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -1690,6 +2128,91 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_GetLastMessageReceiveTime(IOTHUB_CLIENT_CO
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_GetWorkerStatistics(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_WORKER_STATISTICS* workerStatistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || workerStatistics == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("Invalid argument (iotHubClientHandle=%p, workerStatistics=%p)", iotHubClientHandle, workerStatistics);
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            *workerStatistics = iotHubClientInstance->worker_statistics;
+            if (iotHubClientInstance->callback_ring != NULL)
+            {
+                workerStatistics->callback_queue_high_water = callback_ring_get_high_water(iotHubClientInstance->callback_ring);
+            }
+            (void)Unlock(iotHubClientInstance->LockHandle);
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_GetCallbackDispatchStatistics(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_CALLBACK_CATEGORY category, IOTHUB_CLIENT_CALLBACK_DISPATCH_STATISTICS* dispatchStatistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || dispatchStatistics == NULL || (size_t)category > IOTHUB_CLIENT_CALLBACK_CATEGORY_INPUT_MESSAGE)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("Invalid argument (iotHubClientHandle=%p, category=%d, dispatchStatistics=%p)", iotHubClientHandle, (int)category, dispatchStatistics);
+    }
+    else if (iotHubClientHandle->dispatch_pool == NULL)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("OPTION_CALLBACK_DISPATCH_THREADS is not set");
+    }
+    else
+    {
+        size_t first_category = (size_t)category;
+        size_t last_category = (category == IOTHUB_CLIENT_CALLBACK_CATEGORY_INPUT_MESSAGE) ? (DISPATCH_POOL_CATEGORY_COUNT - 1) : first_category;
+        size_t index;
+
+        memset(dispatchStatistics, 0, sizeof(IOTHUB_CLIENT_CALLBACK_DISPATCH_STATISTICS));
+        result = IOTHUB_CLIENT_OK;
+
+        /*input messages are reported as one category, summed over their lanes*/
+        for (index = first_category; index <= last_category; index++)
+        {
+            DISPATCH_POOL_CATEGORY_STATISTICS statistics;
+
+            if (dispatch_pool_get_statistics(iotHubClientHandle->dispatch_pool, index, &statistics) != 0)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("dispatch_pool_get_statistics failed");
+                break;
+            }
+
+            dispatchStatistics->queue_depth += statistics.queue_depth;
+            dispatchStatistics->dispatched_callbacks += statistics.dispatched;
+            dispatchStatistics->total_latency_ms += statistics.total_latency_ms;
+            if (statistics.max_queue_depth > dispatchStatistics->max_queue_depth)
+            {
+                dispatchStatistics->max_queue_depth = statistics.max_queue_depth;
+            }
+            if (statistics.max_latency_ms > dispatchStatistics->max_latency_ms)
+            {
+                dispatchStatistics->max_latency_ms = statistics.max_latency_ms;
+            }
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_SetOption(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, const char* optionName, const void* value)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1764,6 +2287,111 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetOption(IOTHUB_CLIENT_CORE_HANDLE iotHub
                     LogError("invalid value: OPTION_MESSAGE_TIMEOUT cannot exceed the value of OPTION_DO_WORK_FREQUENCY_IN_MS ");
                 }
             }
+            else if (strcmp(OPTION_CLIENT_EXECUTOR, optionName) == 0)
+            {
+                if (iotHubClientInstance->TransportHandle != NULL)
+                {
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                    LogError("Invalid option: OPTION_CLIENT_EXECUTOR is not supported when the transport is shared");
+                }
+                else if (iotHubClientInstance->ThreadHandle != NULL || iotHubClientInstance->executor_entry != NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("OPTION_CLIENT_EXECUTOR shall be set before the client starts working");
+                }
+                else
+                {
+                    iotHubClientInstance->executor = (IOTHUB_CLIENT_EXECUTOR_HANDLE)value;
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            else if (strcmp(OPTION_CALLBACK_DISPATCH_THREADS, optionName) == 0)
+            {
+                size_t thread_count = *(const size_t*)value;
+
+                if (iotHubClientInstance->TransportHandle != NULL)
+                {
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                    LogError("Invalid option: OPTION_CALLBACK_DISPATCH_THREADS is not supported when the transport is shared");
+                }
+                else if (iotHubClientInstance->dispatch_pool != NULL || iotHubClientInstance->ThreadHandle != NULL || iotHubClientInstance->executor_entry != NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("OPTION_CALLBACK_DISPATCH_THREADS shall be set once, before the client starts working");
+                }
+                else if ((iotHubClientInstance->dispatch_pool = dispatch_pool_create(thread_count, DISPATCH_POOL_CATEGORY_COUNT, sizeof(POOLED_USER_CALLBACK), DISPATCH_POOL_QUEUE_CAPACITY, dispatch_pooled_callback, iotHubClientInstance)) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("failed creating a callback dispatch pool of %lu threads", (unsigned long)thread_count);
+                }
+                else
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            else if (strcmp(OPTION_USER_CALLBACK_RING_CAPACITY, optionName) == 0)
+            {
+                size_t capacity = *(const size_t*)value;
+
+                if (iotHubClientInstance->TransportHandle != NULL)
+                {
+                    /*the callbacks of a shared transport are dispatched from the transport's worker thread without LockHandle*/
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                    LogError("Invalid option: OPTION_USER_CALLBACK_RING_CAPACITY is not supported when the transport is shared");
+                }
+                else if (iotHubClientInstance->callback_ring != NULL || iotHubClientInstance->ThreadHandle != NULL || iotHubClientInstance->executor_entry != NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("OPTION_USER_CALLBACK_RING_CAPACITY shall be set once, before the client starts working");
+                }
+                else if ((iotHubClientInstance->callback_ring = callback_ring_create(sizeof(USER_CALLBACK_INFO), capacity)) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("failed creating a user callback ring of %lu records", (unsigned long)capacity);
+                }
+                else
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            else if (strcmp(OPTION_WAKE_ON_WORK_MAX_IDLE_MS, optionName) == 0)
+            {
+                tickcounter_ms_t max_idle_ms = *(const tickcounter_ms_t*)value;
+
+                if (max_idle_ms == 0)
+                {
+                    iotHubClientInstance->wake_on_work_max_idle_ms = 0;
+                    result = IOTHUB_CLIENT_OK;
+                }
+                else if (iotHubClientInstance->TransportHandle != NULL)
+                {
+                    /*a shared transport is driven by the transport's own worker thread*/
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                    LogError("Invalid option: OPTION_WAKE_ON_WORK_MAX_IDLE_MS is not supported when the transport is shared");
+                }
+                else if (max_idle_ms < iotHubClientInstance->do_work_freq_ms)
+                {
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                    LogError("Invalid value: OPTION_WAKE_ON_WORK_MAX_IDLE_MS cannot be lower than OPTION_DO_WORK_FREQUENCY_IN_MS");
+                }
+                else if (iotHubClientInstance->worker_tick_counter == NULL &&
+                    (iotHubClientInstance->worker_tick_counter = tickcounter_create()) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("failed creating the worker tick counter");
+                }
+                else if (iotHubClientInstance->WorkSignal == NULL &&
+                    (iotHubClientInstance->WorkSignal = Condition_Init()) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("failed creating the worker signal");
+                }
+                else
+                {
+                    iotHubClientInstance->wake_on_work_max_idle_ms = max_idle_ms;
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
             else
             {
                 /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClientCore_LL_SetOption passing the same parameters and return what IoTHubClientCore_LL_SetOption returns.] */
@@ -1773,6 +2401,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetOption(IOTHUB_CLIENT_CORE_HANDLE iotHub
                     LogError("IoTHubClientCore_LL_SetOption failed");
                 }
             }
+            signal_worker_thread(iotHubClientInstance);
             (void)Unlock(iotHubClientInstance->LockHandle);
         }
     }
@@ -1850,6 +2479,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetDeviceTwinCallback(IOTHUB_CLIENT_CORE_H
                     }
                 }
 
+                signal_worker_thread(iotHubClientInstance);
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -1920,6 +2550,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendReportedState(IOTHUB_CLIENT_CORE_HANDL
                     }
                 }
 
+                signal_worker_thread(iotHubClientInstance);
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -1983,6 +2614,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_GetTwinAsync(IOTHUB_CLIENT_CORE_HANDLE iot
                         free(queueContext);
                     }
 
+                    signal_worker_thread(iotHubClientInstance);
                     (void)Unlock(iotHubClientInstance->LockHandle);
                 }
             }
@@ -1991,6 +2623,66 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_GetTwinAsync(IOTHUB_CLIENT_CORE_HANDLE iot
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_GetOption(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, const char* optionName, void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || optionName == NULL || value == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL pointer");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+
+        /*the worker thread runs the transport DoWork under this lock, the transport lock for a shared transport*/
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            result = IoTHubClientCore_LL_GetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value);
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_GetCachedTwin(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, unsigned char** twin, size_t* size)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+
+        /*the worker thread updates the cached twin under the lock*/
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            result = IoTHubClientCore_LL_GetCachedTwin(iotHubClientInstance->IoTHubClientLLHandle, twin, size);
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
 static void freeDeviceMethodContext(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
 {
     if (iotHubClientInstance->method_user_context)
@@ -2070,6 +2762,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetDeviceMethodCallback(IOTHUB_CLIENT_CORE
                 iotHubClientInstance->device_method_callback = deviceMethodCallback;
             }
         }
+        signal_worker_thread(iotHubClientInstance);
         (void)Unlock(iotHubClientInstance->LockHandle);
     }
     
@@ -2127,6 +2820,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetDeviceMethodCallback_Ex(IOTHUB_CLIENT_C
             }
         }
 
+        signal_worker_thread(iotHubClientInstance);
         (void)Unlock(iotHubClientInstance->LockHandle);
     }
 
@@ -2161,6 +2855,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_DeviceMethodResponse(IOTHUB_CLIENT_CORE_HA
             {
                 LogError("IoTHubClientCore_LL_DeviceMethodResponse failed");
             }
+            signal_worker_thread(iotHubClientInstance);
             (void)Unlock(iotHubClientInstance->LockHandle);
         }
     }
@@ -2523,6 +3218,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetInputMessageCallback(IOTHUB_CLIENT_CORE
                 inputMessageCallbackContext.userContextCallback = userContextCallback;
 
                 result = IoTHubClientCore_LL_SetInputMessageCallbackEx(iotHubClientInstance->IoTHubClientLLHandle, inputName, iothub_ll_inputmessage_callback, (void*)&inputMessageCallbackContext, sizeof(inputMessageCallbackContext));
+                signal_worker_thread(iotHubClientInstance);
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -25,7 +25,10 @@
 #include "internal/iothub_client_authorization.h"
 #include "internal/iothub_client_private.h"
 #include "internal/iothub_client_diagnostic.h"
+#include "internal/iothub_client_reported_state_coalescer.h"
+#include "internal/iothub_client_twin_cache.h"
 #include "internal/iothubtransport.h"
+#include "internal/timeout_heap.h"
 
 #ifndef DONT_USE_UPLOADTOBLOB
 #include "internal/iothub_client_ll_uploadtoblob.h"
@@ -113,9 +116,16 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG
     time_t lastMessageReceiveTime;
     TICK_COUNTER_HANDLE tickCounter; /*shared tickcounter used to track message timeouts in waitingToSend list*/
     tickcounter_ms_t currentMessageTimeout;
+    TIMEOUT_HEAP message_timeouts; /*the messages in waitingToSend that have a timeout, by the tick they time out at*/
+    uint64_t next_message_sequence;
     uint64_t current_device_twin_timeout;
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback;
     void* deviceTwinContextCallback;
+    REPORTED_STATE_COALESCER_HANDLE reportedStateCoalescer; /*created once OPTION_TWIN_REPORTED_COALESCE_MS is set*/
+    tickcounter_ms_t reportedStateCoalesceMs;
+    tickcounter_ms_t reportedStatePendingSince; /*when the first patch pending in reportedStateCoalescer was added*/
+    TWIN_CACHE_HANDLE twinCache; /*created once OPTION_TWIN_CACHE is set*/
+    bool twinCacheRefreshPending;
     IOTHUB_CLIENT_RETRY_POLICY retryPolicy;
     size_t retryTimeoutLimitInSeconds;
 #ifndef DONT_USE_UPLOADTOBLOB
@@ -294,6 +304,7 @@ static void setTransportProtocol(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData,
     handleData->IoTHubTransport_Unsubscribe_InputQueue = protocol->IoTHubTransport_Unsubscribe_InputQueue;
     handleData->IoTHubTransport_SetCallbackContext = protocol->IoTHubTransport_SetCallbackContext;
     handleData->IoTHubTransport_GetSupportedPlatformInfo = protocol->IoTHubTransport_GetSupportedPlatformInfo;
+    handleData->IoTHubTransport_GetOption = protocol->IoTHubTransport_GetOption;
 }
 
 static bool is_event_equal(IOTHUB_EVENT_CALLBACK *event_callback, const char *input_name)
@@ -332,6 +343,11 @@ static bool is_event_equal_for_match(LIST_ITEM_HANDLE list_item, const void* mat
 
 static void device_twin_data_destroy(IOTHUB_DEVICE_TWIN* client_item)
 {
+    /*the item of coalesced patches owns the batch calling back their callers*/
+    if (client_item->reported_state_callback == reported_state_batch_complete)
+    {
+        reported_state_batch_destroy((REPORTED_STATE_BATCH_HANDLE)client_item->context);
+    }
     CONSTBUFFER_DecRef(client_item->report_data_handle);
     free(client_item);
 }
@@ -504,10 +520,12 @@ static void IoTHubClientCore_LL_SendComplete(PDLIST_ENTRY completed, IOTHUB_CLIE
     {
         /*Codes_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_ERROR then IoTHubClientCore_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.] */
         /*Codes_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClientCore_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
         PDLIST_ENTRY oldest;
         while ((oldest = DList_RemoveHeadList(completed)) != completed)
         {
             IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)containingRecord(oldest, IOTHUB_MESSAGE_LIST, entry);
+            timeout_heap_remove(&(handleData->message_timeouts), &(messageList->timeout_node));
             /*Codes_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
             if (messageList->callback != NULL)
             {
@@ -519,6 +537,50 @@ static void IoTHubClientCore_LL_SendComplete(PDLIST_ENTRY completed, IOTHUB_CLIE
     }
 }
 
+static void on_twin_cache_refreshed(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback)
+{
+    IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)userContextCallback;
+    (void)update_state;
+
+    handleData->twinCacheRefreshPending = false;
+    if (payLoad == NULL)
+    {
+        /*the next patch finds the gap again*/
+        LogError("Failure fetching the device twin for the twin cache");
+    }
+    else if (handleData->twinCache != NULL && twin_cache_set_document(handleData->twinCache, payLoad, size) != 0)
+    {
+        LogError("Failure caching the device twin");
+    }
+}
+
+static void update_twin_cache(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size)
+{
+    if (update_state == DEVICE_TWIN_UPDATE_COMPLETE)
+    {
+        if (twin_cache_set_document(handleData->twinCache, payLoad, size) != 0)
+        {
+            LogError("Failure caching the device twin");
+        }
+    }
+    else
+    {
+        TWIN_CACHE_RESULT cacheResult = twin_cache_apply_patch(handleData->twinCache, payLoad, size);
+        /*a full GET is only issued when patches were missed, or the cached twin was lost*/
+        if ((cacheResult == TWIN_CACHE_GAP || cacheResult == TWIN_CACHE_ERROR) && !handleData->twinCacheRefreshPending)
+        {
+            if (handleData->IoTHubTransport_GetTwinAsync(handleData->deviceHandle, on_twin_cache_refreshed, handleData) != IOTHUB_CLIENT_OK)
+            {
+                LogError("Failure fetching the device twin for the twin cache");
+            }
+            else
+            {
+                handleData->twinCacheRefreshPending = true;
+            }
+        }
+    }
+}
+
 static void IoTHubClientCore_LL_RetrievePropertyComplete(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* ctx)
 {
     if (ctx == NULL)
@@ -529,6 +591,10 @@ static void IoTHubClientCore_LL_RetrievePropertyComplete(DEVICE_TWIN_UPDATE_STAT
     else
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+        if (handleData->twinCache != NULL)
+        {
+            update_twin_cache(handleData, update_state, payLoad, size);
+        }
         /* Codes_SRS_IOTHUBCLIENT_LL_07_014: [ If deviceTwinCallback is NULL then IoTHubClientCore_LL_RetrievePropertyComplete shall do nothing.] */
         if (handleData->deviceTwinCallback)
         {
@@ -1037,6 +1103,8 @@ static IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_004: [Otherwise IoTHubClientCore_LL_Create shall initialize a new DLIST (further called "waitingToSend") containing records with fields of the following types: IOTHUB_MESSAGE_HANDLE, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, void*.]*/
                     DList_InitializeListHead(&(result->waitingToSend));
+                    timeout_heap_init(&(result->message_timeouts));
+                    result->next_message_sequence = 0;
                     DList_InitializeListHead(&(result->iot_msg_queue));
                     DList_InitializeListHead(&(result->iot_ack_queue));
                     result->messageCallback.type = CALLBACK_TYPE_NONE;
@@ -1152,6 +1220,87 @@ static IOTHUB_DEVICE_TWIN* dev_twin_data_create(IOTHUB_CLIENT_CORE_LL_HANDLE_DAT
     return result;
 }
 
+/*queues the coalesced patches pending as one reported state item*/
+static int flush_reported_state(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    int result;
+    REPORTED_STATE_BATCH_HANDLE batch;
+
+    if (handleData->reportedStateCoalescer == NULL || !reported_state_coalescer_has_pending(handleData->reportedStateCoalescer))
+    {
+        result = 0;
+    }
+    else if ((batch = reported_state_coalescer_take(handleData->reportedStateCoalescer)) == NULL)
+    {
+        LogError("Failure taking the coalesced reported state");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        const char* patch = reported_state_batch_get_patch(batch);
+        IOTHUB_DEVICE_TWIN* client_data = dev_twin_data_create(handleData, get_next_item_id(handleData), (const unsigned char*)patch, strlen(patch), reported_state_batch_complete, batch);
+        if (client_data == NULL)
+        {
+            /*as on destroy, a status code of 0 tells the callers their report was not sent*/
+            LogError("Failure constructing the coalesced device twin data");
+            reported_state_batch_complete(ERROR_CODE_BECAUSE_DESTROY, batch);
+            reported_state_batch_destroy(batch);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            DList_InsertTailList(&(handleData->iot_msg_queue), &(client_data->entry));
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*merges the patch into the pending ones; fails if it has to be sent on its own*/
+static int coalesce_reported_state(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
+{
+    int result;
+    bool wasPending = reported_state_coalescer_has_pending(handleData->reportedStateCoalescer);
+
+    if (handleData->IoTHubTransport_Subscribe_DeviceTwin(handleData->transportHandle) != 0)
+    {
+        LogError("Failure subscribing to device twin");
+        result = MU_FAILURE;
+    }
+    else if (reported_state_coalescer_add(handleData->reportedStateCoalescer, reportedState, size, reportedStateCallback, userContextCallback) != 0)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        if (!wasPending && tickcounter_get_current_ms(handleData->tickCounter, &handleData->reportedStatePendingSince) != 0)
+        {
+            /*the patches are then queued on the next DoWork*/
+            LogError("unable to get the current ms, the coalesced reported state will not wait");
+            handleData->reportedStatePendingSince = 0;
+        }
+        result = 0;
+    }
+    return result;
+}
+
+static void DoReportedStateCoalescing(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    if (handleData->reportedStateCoalescer != NULL && reported_state_coalescer_has_pending(handleData->reportedStateCoalescer))
+    {
+        tickcounter_ms_t nowTick;
+        if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+        {
+            LogError("unable to get the current ms, the coalesced reported state is queued now");
+            (void)flush_reported_state(handleData);
+        }
+        else if (nowTick - handleData->reportedStatePendingSince >= handleData->reportedStateCoalesceMs)
+        {
+            (void)flush_reported_state(handleData);
+        }
+    }
+}
+
 static void on_get_device_twin_completed(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback)
 {
     if (userContextCallback == NULL)
@@ -1733,6 +1882,7 @@ void IoTHubClientCore_LL_Destroy(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle
         while ((unsend = DList_RemoveHeadList(&(handleData->waitingToSend))) != &(handleData->waitingToSend))
         {
             IOTHUB_MESSAGE_LIST* temp = containingRecord(unsend, IOTHUB_MESSAGE_LIST, entry);
+            timeout_heap_remove(&(handleData->message_timeouts), &(temp->timeout_node));
             /*Codes_SRS_IOTHUBCLIENT_LL_02_033: [Otherwise, IoTHubClientCore_LL_Destroy shall complete all the event message callbacks that are in the waitingToSend list with the result IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.] */
             if (temp->callback != NULL)
             {
@@ -1771,6 +1921,21 @@ void IoTHubClientCore_LL_Destroy(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle
 
             device_twin_data_destroy(temp);
         }
+        if (handleData->reportedStateCoalescer != NULL)
+        {
+            /*the coalesced patches not queued yet were sent after the ones above*/
+            REPORTED_STATE_BATCH_HANDLE pending = reported_state_coalescer_take(handleData->reportedStateCoalescer);
+            if (pending != NULL)
+            {
+                reported_state_batch_complete(ERROR_CODE_BECAUSE_DESTROY, pending);
+                reported_state_batch_destroy(pending);
+            }
+            reported_state_coalescer_destroy(handleData->reportedStateCoalescer);
+        }
+        if (handleData->twinCache != NULL)
+        {
+            twin_cache_destroy(handleData->twinCache);
+        }
 
         /* Codes_SRS_IOTHUBCLIENT_LL_31_141: [ IoTHubClient_LL_Destroy shall iterate registered callbacks for input queues and destroy any remaining items. ] */
         delete_event_callback_list(handleData);
@@ -1819,7 +1984,8 @@ static int attach_ms_timesOutAfter(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+/*queues eventMessageHandle itself when moveMessage is set, otherwise a clone of it*/
+static IOTHUB_CLIENT_RESULT send_event_async(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool moveMessage)
 {
     IOTHUB_CLIENT_RESULT result;
     /*Codes_SRS_IOTHUBCLIENT_LL_02_011: [IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL.]*/
@@ -1854,7 +2020,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HA
             else
             {
                 /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClientCore_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
-                if ((newEntry->messageHandle = IoTHubMessage_Clone(eventMessageHandle)) == NULL)
+                if ((newEntry->messageHandle = (moveMessage ? eventMessageHandle : IoTHubMessage_Clone(eventMessageHandle))) == NULL)
                 {
                     result = IOTHUB_CLIENT_ERROR;
                     free(newEntry);
@@ -1864,7 +2030,10 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HA
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information/diagnostic fails for any reason, IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
                     result = IOTHUB_CLIENT_ERROR;
-                    IoTHubMessage_Destroy(newEntry->messageHandle);
+                    if (!moveMessage)
+                    {
+                        IoTHubMessage_Destroy(newEntry->messageHandle);
+                    }
                     free(newEntry);
                     LOG_ERROR_RESULT;
                 }
@@ -1873,6 +2042,13 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HA
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClientCore_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
                     newEntry->callback = eventConfirmationCallback;
                     newEntry->context = userContextCallback;
+                    newEntry->sequence = handleData->next_message_sequence++;
+                    timeout_heap_node_init(&(newEntry->timeout_node));
+                    /*the message times out once more than message_timeout_value ms have passed since it was queued, see DoTimeouts*/
+                    if ((newEntry->ms_timesOutAfter != 0) && ((uint64_t)newEntry->message_timeout_value < UINT64_MAX - (uint64_t)newEntry->ms_timesOutAfter))
+                    {
+                        timeout_heap_add(&(handleData->message_timeouts), &(newEntry->timeout_node), (uint64_t)newEntry->ms_timesOutAfter + newEntry->message_timeout_value + 1);
+                    }
                     DList_InsertTailList(&(iotHubClientHandle->waitingToSend), &(newEntry->entry));
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_015: [Otherwise IoTHubClientCore_LL_SendEventAsync shall succeed and return IOTHUB_CLIENT_OK.] */
                     result = IOTHUB_CLIENT_OK;
@@ -1883,6 +2059,16 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HA
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, false);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsyncMove(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, true);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetMessageCallback(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2043,6 +2229,21 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendMessageDisposition(IOTHUB_CLIENT_CO
     return result;
 }
 
+/*transports only take messages from the front of waitingToSend, and only put back at the front what they took, so
+the list stays in the order the messages were queued in: a message is still waiting to be sent if it is found before
+the first younger one*/
+static bool is_waiting_to_send(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, const IOTHUB_MESSAGE_LIST* message)
+{
+    DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
+    while ((currentItemInWaitingToSend != &(handleData->waitingToSend)) &&
+        (currentItemInWaitingToSend != &(message->entry)) &&
+        (containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry)->sequence < message->sequence))
+    {
+        currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
+    }
+    return (currentItemInWaitingToSend == &(message->entry));
+}
+
 static void DoTimeouts(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
 {
     tickcounter_ms_t nowTick;
@@ -2052,26 +2253,22 @@ static void DoTimeouts(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
     }
     else
     {
-        DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
-        while (currentItemInWaitingToSend != &(handleData->waitingToSend)) /*while we are not at the end of the list*/
+        /*only the messages that time out are looked at, not all of waitingToSend*/
+        TIMEOUT_HEAP_NODE* expired;
+        while ((expired = timeout_heap_pop_expired(&(handleData->message_timeouts), (uint64_t)nowTick)) != NULL)
         {
-            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClientCore_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-            if ((fullEntry->ms_timesOutAfter != 0) && ((nowTick - fullEntry->ms_timesOutAfter) > fullEntry->message_timeout_value))
+            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(expired, IOTHUB_MESSAGE_LIST, timeout_node);
+            /*a message the transport has already taken does not time out here, as it is not in waitingToSend anymore*/
+            if (is_waiting_to_send(handleData, fullEntry))
             {
-                PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink; /*need to save the next item, because the below operations are destructive*/
-                DList_RemoveEntryList(currentItemInWaitingToSend);
+                /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClientCore_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+                DList_RemoveEntryList(&(fullEntry->entry));
                 if (fullEntry->callback != NULL)
                 {
                     fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, fullEntry->context);
                 }
                 IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
                 free(fullEntry);
-                currentItemInWaitingToSend = theNext;
-            }
-            else
-            {
-                currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
             }
         }
     }
@@ -2084,6 +2281,7 @@ void IoTHubClientCore_LL_DoWork(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle)
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
         DoTimeouts(handleData);
+        DoReportedStateCoalescing(handleData);
 
         /*Codes_SRS_IOTHUBCLIENT_LL_07_008: [ IoTHubClientCore_LL_DoWork shall iterate the message queue and execute the underlying transports IoTHubTransport_ProcessItem function for each item. ] */
         DLIST_ENTRY* client_item = handleData->iot_msg_queue.Flink;
@@ -2141,6 +2339,13 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetSendStatus(IOTHUB_CLIENT_CORE_LL_HAN
         /* Codes_SRS_IOTHUBCLIENT_09_008: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there is currently no items to be sent] */
         /* Codes_SRS_IOTHUBCLIENT_09_009: [IoTHubClient_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently items to be sent] */
         result = handleData->IoTHubTransport_GetSendStatus(handleData->deviceHandle, iotHubClientStatus);
+
+        /*reported state patches waiting to be coalesced are not in the transport yet*/
+        if (result == IOTHUB_CLIENT_OK && *iotHubClientStatus == IOTHUB_CLIENT_SEND_STATUS_IDLE &&
+            handleData->reportedStateCoalescer != NULL && reported_state_coalescer_has_pending(handleData->reportedStateCoalescer))
+        {
+            *iotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+        }
     }
 
     return result;
@@ -2329,7 +2534,9 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetOption(IOTHUB_CLIENT_CORE_LL_HANDLE
                 result = IOTHUB_CLIENT_OK;
             }
         }
-        else if ((strcmp(optionName, OPTION_BLOB_UPLOAD_TIMEOUT_SECS) == 0) || (strcmp(optionName, OPTION_CURL_VERBOSE) == 0) || (strcmp(optionName, OPTION_NETWORK_INTERFACE_UPLOAD_TO_BLOB) == 0))
+        else if ((strcmp(optionName, OPTION_BLOB_UPLOAD_TIMEOUT_SECS) == 0) || (strcmp(optionName, OPTION_CURL_VERBOSE) == 0) || (strcmp(optionName, OPTION_NETWORK_INTERFACE_UPLOAD_TO_BLOB) == 0) ||
+            (strcmp(optionName, OPTION_BLOB_UPLOAD_CONCURRENCY) == 0) || (strcmp(optionName, OPTION_BLOB_UPLOAD_JOURNAL) == 0) ||
+            (strcmp(optionName, OPTION_BLOB_UPLOAD_GZIP) == 0))
         {
 #ifndef DONT_USE_UPLOADTOBLOB
             // This option just gets passed down into IoTHubClientCore_LL_UploadToBlob
@@ -2359,6 +2566,41 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetOption(IOTHUB_CLIENT_CORE_LL_HANDLE
                 result = IOTHUB_CLIENT_OK;
             }
         }
+        else if (strcmp(optionName, OPTION_TWIN_REPORTED_COALESCE_MS) == 0)
+        {
+            size_t coalesceMs = *(const size_t*)value;
+            if (coalesceMs != 0 && handleData->reportedStateCoalescer == NULL &&
+                (handleData->reportedStateCoalescer = reported_state_coalescer_create()) == NULL)
+            {
+                LogError("reported_state_coalescer_create failed");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                /*turning it off queues the pending patches on the next DoWork*/
+                handleData->reportedStateCoalesceMs = (tickcounter_ms_t)coalesceMs;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_TWIN_CACHE) == 0)
+        {
+            bool enabled = *(const bool*)value;
+            if (enabled && handleData->twinCache == NULL &&
+                (handleData->twinCache = twin_cache_create()) == NULL)
+            {
+                LogError("twin_cache_create failed");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (!enabled && handleData->twinCache != NULL)
+                {
+                    twin_cache_destroy(handleData->twinCache);
+                    handleData->twinCache = NULL;
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else if (strcmp(optionName, OPTION_MODEL_ID) == 0)
         {
             if (handleData->model_id != NULL)
@@ -2400,6 +2642,33 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetOption(IOTHUB_CLIENT_CORE_LL_HANDLE
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetOption(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* optionName, void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || optionName == NULL || value == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("invalid argument (NULL)");
+    }
+    else if (iotHubClientHandle->IoTHubTransport_GetOption == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("The transport has no option to read: %s", optionName);
+    }
+    else
+    {
+        /*all the options read so far belong to the transport*/
+        result = iotHubClientHandle->IoTHubTransport_GetOption(iotHubClientHandle->transportHandle, optionName, value);
+        if (result != IOTHUB_CLIENT_OK)
+        {
+            LogError("unable to IoTHubTransport_GetOption");
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceTwinCallback(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2450,9 +2719,16 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendReportedState(IOTHUB_CLIENT_CORE_LL
         result = IOTHUB_CLIENT_INVALID_ARG;
         LogError("Invalid argument specified iothubClientHandle=%p, reportedState=%p, size=%lu", iotHubClientHandle, reportedState, (unsigned long)size);
     }
+    else if (iotHubClientHandle->reportedStateCoalesceMs != 0 &&
+        coalesce_reported_state(iotHubClientHandle, reportedState, size, reportedStateCallback, userContextCallback) == 0)
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
     else
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        /*the patches coalesced so far go before this one*/
+        (void)flush_reported_state(handleData);
         /* Codes_SRS_IOTHUBCLIENT_LL_10_014: [IoTHubClientCore_LL_SendReportedState shall construct and queue the reported a Device_Twin structure for transmition by the underlying transport.] */
         IOTHUB_DEVICE_TWIN* client_data = dev_twin_data_create(handleData, get_next_item_id(handleData), reportedState, size, reportedStateCallback, userContextCallback);
         if (client_data == NULL)
@@ -2536,6 +2812,33 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetTwinAsync(IOTHUB_CLIENT_CORE_LL_HAND
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetCachedTwin(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, unsigned char** twin, size_t* size)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL || twin == NULL || size == NULL)
+    {
+        LogError("Invalid argument iothubClientHandle=%p, twin=%p, size=%p", iotHubClientHandle, twin, size);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (iotHubClientHandle->twinCache == NULL)
+    {
+        LogError("The twin cache is not enabled, set OPTION_TWIN_CACHE");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if (twin_cache_get_document(iotHubClientHandle->twinCache, twin, size) != 0)
+    {
+        LogError("Failed getting the cached device twin");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
 
 static void ResetMethodCallbackData(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
 {
@@ -2795,6 +3098,25 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_UploadMultipleBlocksToBlobEx(IOTHUB_CLI
     }
     return result;
 }
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_UploadFileToBlob(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* destinationFileName, const char* sourceFileName)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (
+        (iotHubClientHandle == NULL) ||
+        (destinationFileName == NULL) ||
+        (sourceFileName == NULL)
+        )
+    {
+        LogError("invalid parameters IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle=%p, destinationFileName=%p, sourceFileName=%p", iotHubClientHandle, destinationFileName, sourceFileName);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        result = IoTHubClient_LL_UploadFileToBlob_Impl(iotHubClientHandle->uploadToBlobHandle, destinationFileName, sourceFileName);
+    }
+    return result;
+}
 #endif // DONT_USE_UPLOADTOBLOB
 
 IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventToOutputAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, const char* outputName, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
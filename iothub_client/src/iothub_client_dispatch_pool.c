@@ -0,0 +1,489 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include "umock_c/umock_c_prod.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "internal/iothub_client_dispatch_pool.h"
+
+/*idle workers, and submitters waiting for a free item, re-check the pool this often*/
+#define MAX_WAIT_MS                 1000
+
+typedef struct DISPATCH_POOL_ITEM_TAG
+{
+    struct DISPATCH_POOL_ITEM_TAG* next;
+    tickcounter_ms_t enqueued_ms;
+    /*the record (record_size bytes) follows*/
+} DISPATCH_POOL_ITEM;
+
+/*the items are laid out back to back, so each one is rounded up to keep the record that follows it aligned*/
+typedef union DISPATCH_POOL_ALIGNMENT_TAG
+{
+    void* pointer;
+    uint64_t integer;
+    double floating;
+} DISPATCH_POOL_ALIGNMENT;
+
+typedef struct DISPATCH_POOL_CATEGORY_TAG
+{
+    DISPATCH_POOL_ITEM* head;
+    DISPATCH_POOL_ITEM* tail;
+    bool running;
+    DISPATCH_POOL_CATEGORY_STATISTICS statistics;
+} DISPATCH_POOL_CATEGORY;
+
+typedef struct DISPATCH_POOL_TAG
+{
+    LOCK_HANDLE lock;
+    COND_HANDLE work_available;
+    COND_HANDLE item_available;
+    TICK_COUNTER_HANDLE tick_counter;
+    THREAD_HANDLE* workers;
+    size_t worker_count;
+    DISPATCH_POOL_CATEGORY* categories;
+    size_t category_count;
+    /*categories are scanned starting here, so a busy category cannot starve the ones after it*/
+    size_t next_category;
+    size_t record_size;
+    /*all the items, allocated once; the ones not queued are linked in free_items*/
+    unsigned char* items;
+    DISPATCH_POOL_ITEM* free_items;
+    size_t waiting_submitters;
+    DISPATCH_POOL_FUNCTION function;
+    void* context;
+    bool stop;
+} DISPATCH_POOL;
+
+/*used by unittests only*/
+const size_t DispatchPool_ThreadTerminationOffset = offsetof(DISPATCH_POOL, stop);
+
+static tickcounter_ms_t get_now_ms(DISPATCH_POOL* pool)
+{
+    tickcounter_ms_t now_ms;
+    if (tickcounter_get_current_ms(pool->tick_counter, &now_ms) != 0)
+    {
+        LogError("tickcounter_get_current_ms failed");
+        now_ms = 0;
+    }
+    return now_ms;
+}
+
+/*returns the index of a category that has queued records and none running, or category_count. Called with the lock held.*/
+static size_t find_ready_category(DISPATCH_POOL* pool)
+{
+    size_t i;
+    size_t result = pool->category_count;
+
+    for (i = 0; i < pool->category_count; i++)
+    {
+        size_t index = (pool->next_category + i) % pool->category_count;
+        if (pool->categories[index].head != NULL && !pool->categories[index].running)
+        {
+            result = index;
+            pool->next_category = (index + 1) % pool->category_count;
+            break;
+        }
+    }
+
+    return result;
+}
+
+/*runs the oldest record of the category with the lock released. Called with the lock held, and returns with it held
+unless re-acquiring it fails. The category is then left running and never dispatched again, and the worker exits.*/
+static int run_category(DISPATCH_POOL* pool, DISPATCH_POOL_CATEGORY* category)
+{
+    int result;
+    DISPATCH_POOL_ITEM* item = category->head;
+
+    category->head = item->next;
+    if (category->head == NULL)
+    {
+        category->tail = NULL;
+    }
+    category->running = true;
+    (void)Unlock(pool->lock);
+
+    pool->function(pool->context, (unsigned char*)item + sizeof(DISPATCH_POOL_ITEM));
+
+    if (Lock(pool->lock) != LOCK_OK)
+    {
+        LogError("failed re-acquiring the dispatch pool lock, dispatch pool category %p is abandoned", category);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        tickcounter_ms_t latency_ms = get_now_ms(pool) - item->enqueued_ms;
+        category->running = false;
+        category->statistics.queue_depth--;
+        category->statistics.dispatched++;
+        category->statistics.total_latency_ms += latency_ms;
+        if (latency_ms > category->statistics.max_latency_ms)
+        {
+            category->statistics.max_latency_ms = latency_ms;
+        }
+
+        item->next = pool->free_items;
+        pool->free_items = item;
+        if (pool->waiting_submitters > 0)
+        {
+            (void)Condition_Post(pool->item_available);
+        }
+        result = 0;
+    }
+
+    return result;
+}
+
+static int DispatchPoolWorker_Thread(void* threadArgument)
+{
+    DISPATCH_POOL* pool = (DISPATCH_POOL*)threadArgument;
+
+    if (Lock(pool->lock) != LOCK_OK)
+    {
+        LogError("failed locking the dispatch pool");
+    }
+    else
+    {
+        bool locked = true;
+
+        while (true)
+        {
+            size_t index = find_ready_category(pool);
+
+            if (index < pool->category_count)
+            {
+                if (run_category(pool, &pool->categories[index]) != 0)
+                {
+                    locked = false;
+                    break;
+                }
+            }
+            else if (pool->stop)
+            {
+                /*records of running categories are left to the workers running them*/
+                break;
+            }
+            else
+            {
+                (void)Condition_Wait(pool->work_available, pool->lock, MAX_WAIT_MS);
+            }
+        }
+
+        if (locked)
+        {
+            (void)Unlock(pool->lock);
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+static void signal_stop(DISPATCH_POOL* pool, size_t started_workers)
+{
+    if (Lock(pool->lock) != LOCK_OK)
+    {
+        LogError("failed locking the dispatch pool");
+    }
+    else
+    {
+        size_t i;
+
+        pool->stop = true;
+        for (i = 0; i < started_workers; i++)
+        {
+            (void)Condition_Post(pool->work_available);
+        }
+        (void)Unlock(pool->lock);
+    }
+}
+
+static void stop_workers(DISPATCH_POOL* pool, size_t started_workers)
+{
+    size_t i;
+
+    signal_stop(pool, started_workers);
+
+    for (i = 0; i < started_workers; i++)
+    {
+        int thread_result;
+        if (ThreadAPI_Join(pool->workers[i], &thread_result) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for dispatch pool worker %lu", (unsigned long)i);
+        }
+    }
+}
+
+static void free_pool(DISPATCH_POOL* pool)
+{
+    if (pool->work_available != NULL)
+    {
+        Condition_Deinit(pool->work_available);
+    }
+    if (pool->item_available != NULL)
+    {
+        Condition_Deinit(pool->item_available);
+    }
+    if (pool->lock != NULL)
+    {
+        Lock_Deinit(pool->lock);
+    }
+    if (pool->tick_counter != NULL)
+    {
+        tickcounter_destroy(pool->tick_counter);
+    }
+    free(pool->items);
+    free(pool->categories);
+    free(pool->workers);
+    free(pool);
+}
+
+static DISPATCH_POOL_CATEGORY* create_categories(size_t category_count)
+{
+    DISPATCH_POOL_CATEGORY* result;
+
+    if (category_count > (SIZE_MAX / sizeof(DISPATCH_POOL_CATEGORY)))
+    {
+        result = NULL;
+    }
+    else if ((result = (DISPATCH_POOL_CATEGORY*)malloc(category_count * sizeof(DISPATCH_POOL_CATEGORY))) != NULL)
+    {
+        memset(result, 0, category_count * sizeof(DISPATCH_POOL_CATEGORY));
+    }
+
+    return result;
+}
+
+/*allocates queue_capacity items and links them all in free_items*/
+static int create_items(DISPATCH_POOL* pool, size_t queue_capacity)
+{
+    int result;
+    size_t alignment = sizeof(DISPATCH_POOL_ALIGNMENT);
+    size_t item_size;
+
+    if (pool->record_size > SIZE_MAX - sizeof(DISPATCH_POOL_ITEM) - alignment)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        item_size = ((sizeof(DISPATCH_POOL_ITEM) + pool->record_size + alignment - 1) / alignment) * alignment;
+
+        if (queue_capacity > (SIZE_MAX / item_size) ||
+            (pool->items = (unsigned char*)malloc(queue_capacity * item_size)) == NULL)
+        {
+            result = MU_FAILURE;
+        }
+        else
+        {
+            size_t i;
+
+            for (i = queue_capacity; i > 0; i--)
+            {
+                DISPATCH_POOL_ITEM* item = (DISPATCH_POOL_ITEM*)(pool->items + ((i - 1) * item_size));
+                item->next = pool->free_items;
+                pool->free_items = item;
+            }
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+DISPATCH_POOL_HANDLE dispatch_pool_create(size_t thread_count, size_t category_count, size_t record_size, size_t queue_capacity, DISPATCH_POOL_FUNCTION function, void* context)
+{
+    DISPATCH_POOL* result;
+
+    if (thread_count == 0 || category_count == 0 || record_size == 0 || queue_capacity == 0 || function == NULL)
+    {
+        LogError("Invalid argument (thread_count=%lu, category_count=%lu, record_size=%lu, queue_capacity=%lu, function=%p)",
+            (unsigned long)thread_count, (unsigned long)category_count, (unsigned long)record_size, (unsigned long)queue_capacity, function);
+        result = NULL;
+    }
+    else if ((result = (DISPATCH_POOL*)malloc(sizeof(DISPATCH_POOL))) == NULL)
+    {
+        LogError("failed allocating the dispatch pool");
+    }
+    else
+    {
+        memset(result, 0, sizeof(DISPATCH_POOL));
+        result->category_count = category_count;
+        result->record_size = record_size;
+        result->function = function;
+        result->context = context;
+
+        if ((result->workers = (THREAD_HANDLE*)malloc(thread_count * sizeof(THREAD_HANDLE))) == NULL)
+        {
+            LogError("failed allocating the dispatch pool workers");
+            free_pool(result);
+            result = NULL;
+        }
+        else if ((result->categories = create_categories(category_count)) == NULL)
+        {
+            LogError("failed allocating the dispatch pool categories");
+            free_pool(result);
+            result = NULL;
+        }
+        else if (create_items(result, queue_capacity) != 0)
+        {
+            LogError("failed allocating %lu dispatch pool items", (unsigned long)queue_capacity);
+            free_pool(result);
+            result = NULL;
+        }
+        else if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free_pool(result);
+            result = NULL;
+        }
+        else if ((result->work_available = Condition_Init()) == NULL ||
+            (result->item_available = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed");
+            free_pool(result);
+            result = NULL;
+        }
+        else if ((result->tick_counter = tickcounter_create()) == NULL)
+        {
+            LogError("tickcounter_create failed");
+            free_pool(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t i;
+
+            for (i = 0; i < thread_count; i++)
+            {
+                if (ThreadAPI_Create(&result->workers[i], DispatchPoolWorker_Thread, result) != THREADAPI_OK)
+                {
+                    LogError("ThreadAPI_Create failed for dispatch pool worker %lu", (unsigned long)i);
+                    break;
+                }
+            }
+
+            if (i < thread_count)
+            {
+                stop_workers(result, i);
+                free_pool(result);
+                result = NULL;
+            }
+            else
+            {
+                result->worker_count = thread_count;
+            }
+        }
+    }
+
+    return result;
+}
+
+void dispatch_pool_destroy(DISPATCH_POOL_HANDLE pool)
+{
+    if (pool == NULL)
+    {
+        LogError("Invalid argument (pool=NULL)");
+    }
+    else
+    {
+        /*the workers run every queued record before exiting*/
+        stop_workers(pool, pool->worker_count);
+        free_pool(pool);
+    }
+}
+
+int dispatch_pool_submit(DISPATCH_POOL_HANDLE pool, size_t category, const void* record)
+{
+    int result;
+
+    if (pool == NULL || record == NULL || category >= pool->category_count)
+    {
+        LogError("Invalid argument (pool=%p, category=%lu, record=%p)", pool, (unsigned long)category, record);
+        result = MU_FAILURE;
+    }
+    else if (Lock(pool->lock) != LOCK_OK)
+    {
+        LogError("failed locking the dispatch pool");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        DISPATCH_POOL_CATEGORY* target = &pool->categories[category];
+        DISPATCH_POOL_ITEM* item;
+
+        /*a full queue holds the submitter back until a worker frees an item, records are never dropped*/
+        while (pool->free_items == NULL)
+        {
+            pool->waiting_submitters++;
+            (void)Condition_Wait(pool->item_available, pool->lock, MAX_WAIT_MS);
+            pool->waiting_submitters--;
+        }
+
+        item = pool->free_items;
+        pool->free_items = item->next;
+
+        item->next = NULL;
+        item->enqueued_ms = get_now_ms(pool);
+        (void)memcpy((unsigned char*)item + sizeof(DISPATCH_POOL_ITEM), record, pool->record_size);
+
+        if (target->tail == NULL)
+        {
+            target->head = item;
+        }
+        else
+        {
+            target->tail->next = item;
+        }
+        target->tail = item;
+
+        target->statistics.queue_depth++;
+        if (target->statistics.queue_depth > target->statistics.max_queue_depth)
+        {
+            target->statistics.max_queue_depth = target->statistics.queue_depth;
+        }
+
+        if (!target->running)
+        {
+            (void)Condition_Post(pool->work_available);
+        }
+        (void)Unlock(pool->lock);
+        result = 0;
+    }
+
+    return result;
+}
+
+int dispatch_pool_get_statistics(DISPATCH_POOL_HANDLE pool, size_t category, DISPATCH_POOL_CATEGORY_STATISTICS* statistics)
+{
+    int result;
+
+    if (pool == NULL || statistics == NULL || category >= pool->category_count)
+    {
+        LogError("Invalid argument (pool=%p, category=%lu, statistics=%p)", pool, (unsigned long)category, statistics);
+        result = MU_FAILURE;
+    }
+    else if (Lock(pool->lock) != LOCK_OK)
+    {
+        LogError("failed locking the dispatch pool");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        *statistics = pool->categories[category].statistics;
+        (void)Unlock(pool->lock);
+        result = 0;
+    }
+
+    return result;
+}
@@ -0,0 +1,520 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include "umock_c/umock_c_prod.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothub_client_executor.h"
+
+#define ENTRY_NOT_SCHEDULED         SIZE_MAX
+#define INITIAL_HEAP_CAPACITY       16
+/*a worker with nothing due sooner re-reads the heap this often, and Unregister re-checks a running entry as often*/
+#define MAX_WAIT_MS                 1000
+
+typedef struct IOTHUB_CLIENT_EXECUTOR_ENTRY_TAG
+{
+    IOTHUB_CLIENT_EXECUTOR_WORK_FUNCTION work_function;
+    void* context;
+    tickcounter_ms_t due_ms;
+    size_t heap_index;
+    bool running;
+    bool wake_requested;
+    bool removed;
+} IOTHUB_CLIENT_EXECUTOR_ENTRY;
+
+typedef struct IOTHUB_CLIENT_EXECUTOR_TAG
+{
+    LOCK_HANDLE lock;
+    COND_HANDLE work_available;
+    COND_HANDLE entry_done;
+    TICK_COUNTER_HANDLE tick_counter;
+    THREAD_HANDLE* workers;
+    size_t worker_count;
+    /*min-heap of the scheduled entries ordered by due_ms; running entries are not in the heap*/
+    IOTHUB_CLIENT_EXECUTOR_ENTRY** heap;
+    size_t heap_count;
+    size_t heap_capacity;
+    size_t entry_count;
+    bool stop;
+} IOTHUB_CLIENT_EXECUTOR;
+
+/*used by unittests only*/
+const size_t IoTHubClientExecutor_ThreadTerminationOffset = offsetof(IOTHUB_CLIENT_EXECUTOR, stop);
+
+static tickcounter_ms_t get_now_ms(IOTHUB_CLIENT_EXECUTOR* executor)
+{
+    tickcounter_ms_t now_ms;
+    if (tickcounter_get_current_ms(executor->tick_counter, &now_ms) != 0)
+    {
+        LogError("tickcounter_get_current_ms failed");
+        now_ms = 0;
+    }
+    return now_ms;
+}
+
+static void heap_swap(IOTHUB_CLIENT_EXECUTOR* executor, size_t a, size_t b)
+{
+    IOTHUB_CLIENT_EXECUTOR_ENTRY* temp = executor->heap[a];
+    executor->heap[a] = executor->heap[b];
+    executor->heap[b] = temp;
+    executor->heap[a]->heap_index = a;
+    executor->heap[b]->heap_index = b;
+}
+
+static void heap_sift_up(IOTHUB_CLIENT_EXECUTOR* executor, size_t index)
+{
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / 2;
+        if (executor->heap[parent]->due_ms <= executor->heap[index]->due_ms)
+        {
+            break;
+        }
+        heap_swap(executor, parent, index);
+        index = parent;
+    }
+}
+
+static void heap_sift_down(IOTHUB_CLIENT_EXECUTOR* executor, size_t index)
+{
+    while (1)
+    {
+        size_t smallest = index;
+        size_t left = (2 * index) + 1;
+        size_t right = left + 1;
+
+        if (left < executor->heap_count && executor->heap[left]->due_ms < executor->heap[smallest]->due_ms)
+        {
+            smallest = left;
+        }
+        if (right < executor->heap_count && executor->heap[right]->due_ms < executor->heap[smallest]->due_ms)
+        {
+            smallest = right;
+        }
+        if (smallest == index)
+        {
+            break;
+        }
+        heap_swap(executor, index, smallest);
+        index = smallest;
+    }
+}
+
+/*makes room for one more registered entry. An entry is in the heap at most once, so a heap holding entry_count
+entries never has to grow when a worker puts a finished entry back.*/
+static int heap_reserve(IOTHUB_CLIENT_EXECUTOR* executor)
+{
+    int result;
+
+    if (executor->entry_count == executor->heap_capacity)
+    {
+        size_t new_capacity = (executor->heap_capacity == 0) ? INITIAL_HEAP_CAPACITY : executor->heap_capacity * 2;
+        IOTHUB_CLIENT_EXECUTOR_ENTRY** new_heap = (IOTHUB_CLIENT_EXECUTOR_ENTRY**)realloc(executor->heap, new_capacity * sizeof(IOTHUB_CLIENT_EXECUTOR_ENTRY*));
+        if (new_heap == NULL)
+        {
+            LogError("failed growing the executor heap");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            executor->heap = new_heap;
+            executor->heap_capacity = new_capacity;
+            result = 0;
+        }
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void heap_push(IOTHUB_CLIENT_EXECUTOR* executor, IOTHUB_CLIENT_EXECUTOR_ENTRY* entry)
+{
+    entry->heap_index = executor->heap_count;
+    executor->heap[executor->heap_count] = entry;
+    executor->heap_count++;
+    heap_sift_up(executor, entry->heap_index);
+}
+
+static void heap_remove(IOTHUB_CLIENT_EXECUTOR* executor, IOTHUB_CLIENT_EXECUTOR_ENTRY* entry)
+{
+    size_t index = entry->heap_index;
+
+    executor->heap_count--;
+    if (index != executor->heap_count)
+    {
+        heap_swap(executor, index, executor->heap_count);
+        heap_sift_down(executor, index);
+        heap_sift_up(executor, index);
+    }
+    entry->heap_index = ENTRY_NOT_SCHEDULED;
+}
+
+/*runs the entry at the top of the heap with the lock released. Called with the lock held, and returns with it held
+unless re-acquiring it fails. The entry is then left running and never scheduled again, and the worker exits.*/
+static int run_entry(IOTHUB_CLIENT_EXECUTOR* executor, IOTHUB_CLIENT_EXECUTOR_ENTRY* entry)
+{
+    int result;
+    tickcounter_ms_t delay_ms;
+
+    heap_remove(executor, entry);
+    entry->running = true;
+    (void)Unlock(executor->lock);
+
+    delay_ms = entry->work_function(entry->context);
+
+    if (Lock(executor->lock) != LOCK_OK)
+    {
+        LogError("failed re-acquiring the executor lock, executor entry %p is abandoned", entry);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        entry->running = false;
+        if (entry->removed)
+        {
+            (void)Condition_Post(executor->entry_done);
+        }
+        else
+        {
+            entry->due_ms = entry->wake_requested ? get_now_ms(executor) : get_now_ms(executor) + delay_ms;
+            entry->wake_requested = false;
+            heap_push(executor, entry);
+            if (executor->heap_count > 1)
+            {
+                /*other workers may be waiting on a due time that is now later than the new top*/
+                (void)Condition_Post(executor->work_available);
+            }
+        }
+        result = 0;
+    }
+
+    return result;
+}
+
+static int ExecutorWorker_Thread(void* threadArgument)
+{
+    IOTHUB_CLIENT_EXECUTOR* executor = (IOTHUB_CLIENT_EXECUTOR*)threadArgument;
+
+    if (Lock(executor->lock) != LOCK_OK)
+    {
+        LogError("failed locking the executor");
+    }
+    else
+    {
+        bool locked = true;
+
+        while (!executor->stop)
+        {
+            tickcounter_ms_t wait_ms;
+
+            if (executor->heap_count == 0)
+            {
+                wait_ms = MAX_WAIT_MS;
+            }
+            else
+            {
+                tickcounter_ms_t now_ms = get_now_ms(executor);
+                IOTHUB_CLIENT_EXECUTOR_ENTRY* top = executor->heap[0];
+
+                if (top->due_ms <= now_ms)
+                {
+                    if (run_entry(executor, top) != 0)
+                    {
+                        locked = false;
+                        break;
+                    }
+                    continue;
+                }
+
+                wait_ms = top->due_ms - now_ms;
+                if (wait_ms > MAX_WAIT_MS)
+                {
+                    wait_ms = MAX_WAIT_MS;
+                }
+            }
+
+            (void)Condition_Wait(executor->work_available, executor->lock, (int)wait_ms);
+        }
+
+        if (locked)
+        {
+            (void)Unlock(executor->lock);
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+static void signal_stop(IOTHUB_CLIENT_EXECUTOR* executor, size_t started_workers)
+{
+    if (Lock(executor->lock) != LOCK_OK)
+    {
+        LogError("failed locking the executor");
+    }
+    else
+    {
+        size_t i;
+
+        executor->stop = true;
+        for (i = 0; i < started_workers; i++)
+        {
+            (void)Condition_Post(executor->work_available);
+        }
+        (void)Unlock(executor->lock);
+    }
+}
+
+static void stop_workers(IOTHUB_CLIENT_EXECUTOR* executor, size_t started_workers)
+{
+    size_t i;
+
+    signal_stop(executor, started_workers);
+
+    for (i = 0; i < started_workers; i++)
+    {
+        int thread_result;
+        if (ThreadAPI_Join(executor->workers[i], &thread_result) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for executor worker %lu", (unsigned long)i);
+        }
+    }
+}
+
+static void free_executor(IOTHUB_CLIENT_EXECUTOR* executor)
+{
+    if (executor->work_available != NULL)
+    {
+        Condition_Deinit(executor->work_available);
+    }
+    if (executor->entry_done != NULL)
+    {
+        Condition_Deinit(executor->entry_done);
+    }
+    if (executor->lock != NULL)
+    {
+        Lock_Deinit(executor->lock);
+    }
+    if (executor->tick_counter != NULL)
+    {
+        tickcounter_destroy(executor->tick_counter);
+    }
+    free(executor->heap);
+    free(executor->workers);
+    free(executor);
+}
+
+IOTHUB_CLIENT_EXECUTOR_HANDLE IoTHubClientExecutor_Create(size_t workerCount)
+{
+    IOTHUB_CLIENT_EXECUTOR* result;
+
+    if (workerCount == 0)
+    {
+        LogError("Invalid argument (workerCount=0)");
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_CLIENT_EXECUTOR*)malloc(sizeof(IOTHUB_CLIENT_EXECUTOR))) == NULL)
+    {
+        LogError("failed allocating the executor");
+    }
+    else
+    {
+        memset(result, 0, sizeof(IOTHUB_CLIENT_EXECUTOR));
+
+        if ((result->workers = (THREAD_HANDLE*)malloc(workerCount * sizeof(THREAD_HANDLE))) == NULL)
+        {
+            LogError("failed allocating the executor workers");
+            free_executor(result);
+            result = NULL;
+        }
+        else if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free_executor(result);
+            result = NULL;
+        }
+        else if ((result->work_available = Condition_Init()) == NULL ||
+            (result->entry_done = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed");
+            free_executor(result);
+            result = NULL;
+        }
+        else if ((result->tick_counter = tickcounter_create()) == NULL)
+        {
+            LogError("tickcounter_create failed");
+            free_executor(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t i;
+
+            for (i = 0; i < workerCount; i++)
+            {
+                if (ThreadAPI_Create(&result->workers[i], ExecutorWorker_Thread, result) != THREADAPI_OK)
+                {
+                    LogError("ThreadAPI_Create failed for executor worker %lu", (unsigned long)i);
+                    break;
+                }
+            }
+
+            if (i < workerCount)
+            {
+                stop_workers(result, i);
+                free_executor(result);
+                result = NULL;
+            }
+            else
+            {
+                result->worker_count = workerCount;
+            }
+        }
+    }
+
+    return result;
+}
+
+void IoTHubClientExecutor_Destroy(IOTHUB_CLIENT_EXECUTOR_HANDLE executorHandle)
+{
+    if (executorHandle == NULL)
+    {
+        LogError("Invalid argument (executorHandle=NULL)");
+    }
+    else
+    {
+        size_t i;
+
+        stop_workers(executorHandle, executorHandle->worker_count);
+
+        if (executorHandle->entry_count > 0)
+        {
+            LogError("executor destroyed with %lu clients still attached", (unsigned long)executorHandle->entry_count);
+        }
+        for (i = 0; i < executorHandle->heap_count; i++)
+        {
+            free(executorHandle->heap[i]);
+        }
+
+        free_executor(executorHandle);
+    }
+}
+
+IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE IoTHubClientExecutor_Register(IOTHUB_CLIENT_EXECUTOR_HANDLE executorHandle, IOTHUB_CLIENT_EXECUTOR_WORK_FUNCTION workFunction, void* context)
+{
+    IOTHUB_CLIENT_EXECUTOR_ENTRY* result;
+
+    if (executorHandle == NULL || workFunction == NULL)
+    {
+        LogError("Invalid argument (executorHandle=%p, workFunction=%p)", executorHandle, workFunction);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_CLIENT_EXECUTOR_ENTRY*)malloc(sizeof(IOTHUB_CLIENT_EXECUTOR_ENTRY))) == NULL)
+    {
+        LogError("failed allocating the executor entry");
+    }
+    else
+    {
+        memset(result, 0, sizeof(IOTHUB_CLIENT_EXECUTOR_ENTRY));
+        result->work_function = workFunction;
+        result->context = context;
+        result->heap_index = ENTRY_NOT_SCHEDULED;
+
+        if (Lock(executorHandle->lock) != LOCK_OK)
+        {
+            LogError("failed locking the executor");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            if (heap_reserve(executorHandle) != 0)
+            {
+                LogError("failed scheduling the executor entry");
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                result->due_ms = get_now_ms(executorHandle);
+                heap_push(executorHandle, result);
+                executorHandle->entry_count++;
+                (void)Condition_Post(executorHandle->work_available);
+            }
+            (void)Unlock(executorHandle->lock);
+        }
+    }
+
+    return result;
+}
+
+void IoTHubClientExecutor_Wake(IOTHUB_CLIENT_EXECUTOR_HANDLE executorHandle, IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE entryHandle)
+{
+    if (executorHandle == NULL || entryHandle == NULL)
+    {
+        LogError("Invalid argument (executorHandle=%p, entryHandle=%p)", executorHandle, entryHandle);
+    }
+    else if (Lock(executorHandle->lock) != LOCK_OK)
+    {
+        LogError("failed locking the executor");
+    }
+    else
+    {
+        if (entryHandle->running)
+        {
+            entryHandle->wake_requested = true;
+        }
+        else if (entryHandle->heap_index != ENTRY_NOT_SCHEDULED)
+        {
+            tickcounter_ms_t now_ms = get_now_ms(executorHandle);
+            if (entryHandle->due_ms > now_ms)
+            {
+                entryHandle->due_ms = now_ms;
+                heap_sift_up(executorHandle, entryHandle->heap_index);
+                (void)Condition_Post(executorHandle->work_available);
+            }
+        }
+        (void)Unlock(executorHandle->lock);
+    }
+}
+
+void IoTHubClientExecutor_Unregister(IOTHUB_CLIENT_EXECUTOR_HANDLE executorHandle, IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE entryHandle)
+{
+    if (executorHandle == NULL || entryHandle == NULL)
+    {
+        LogError("Invalid argument (executorHandle=%p, entryHandle=%p)", executorHandle, entryHandle);
+    }
+    else if (Lock(executorHandle->lock) != LOCK_OK)
+    {
+        LogError("failed locking the executor");
+    }
+    else
+    {
+        entryHandle->removed = true;
+        if (entryHandle->heap_index != ENTRY_NOT_SCHEDULED)
+        {
+            heap_remove(executorHandle, entryHandle);
+        }
+        while (entryHandle->running)
+        {
+            (void)Condition_Wait(executorHandle->entry_done, executorHandle->lock, MAX_WAIT_MS);
+        }
+        executorHandle->entry_count--;
+        (void)Unlock(executorHandle->lock);
+
+        free(entryHandle);
+    }
+}
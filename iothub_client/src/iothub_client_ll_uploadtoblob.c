@@ -4,6 +4,7 @@
 #ifndef DONT_USE_UPLOADTOBLOB
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
@@ -84,6 +85,9 @@ typedef struct IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA_TAG
     UPOADTOBLOB_CURL_VERBOSITY curl_verbosity_level;
     size_t blob_upload_timeout_secs;
     const char* networkInterface;
+    size_t blob_upload_concurrency;
+    char* blob_upload_journal_path;
+    bool blob_upload_gzip;
 }IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA;
 
 typedef struct BLOB_UPLOAD_CONTEXT_TAG
@@ -662,14 +666,25 @@ static HTTPAPIEX_RESULT set_transfer_timeout(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDL
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context)
+// isResumableBlobFailure tells whether the blocks journaled by a failed step 2 are still of use to the next attempt:
+// the failure was transient, or came after the block list had been committed. Storage refusing the blocks or the block list
+// (a 4xx other than timeout or throttling) means the journal does not match what storage holds.
+static bool isResumableBlobFailure(BLOB_RESULT blobResult, unsigned int httpStatus)
+{
+    return (blobResult == BLOB_ERROR) || (blobResult == BLOB_HTTP_ERROR) ||
+        ((blobResult == BLOB_OK) && ((httpStatus < 400) || (httpStatus == 408) || (httpStatus == 429) || (httpStatus >= 500)));
+}
+
+// UploadMultipleBlocksToBlob runs the three steps of a file upload. The blocks of step 2 are read from sourceFile when it
+// is not NULL, and are returned by getDataCallbackEx otherwise.
+static IOTHUB_CLIENT_RESULT UploadMultipleBlocksToBlob(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, FILE* sourceFile)
 {
     IOTHUB_CLIENT_RESULT result;
 
     /*Codes_SRS_IOTHUBCLIENT_LL_02_061: [ If handle is NULL then IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
     /*Codes_SRS_IOTHUBCLIENT_LL_02_062: [ If destinationFileName is NULL then IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
 
-    if (handle == NULL || destinationFileName == NULL || getDataCallbackEx == NULL)
+    if (handle == NULL || destinationFileName == NULL || (getDataCallbackEx == NULL && sourceFile == NULL))
     {
         LogError("invalid argument detected handle=%p destinationFileName=%p getDataCallbackEx=%p", handle, destinationFileName, getDataCallbackEx);
         result = IOTHUB_CLIENT_INVALID_ARG;
@@ -793,8 +808,20 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIE
                                         }
                                         else
                                         {
+                                            BLOB_UPLOAD_JOURNAL_HANDLE journal = NULL;
+                                            BLOB_RESULT uploadMultipleBlocksResult;
+
+                                            if ((upload_data->blob_upload_journal_path != NULL) &&
+                                                ((journal = blob_upload_journal_open(upload_data->blob_upload_journal_path, STRING_c_str(sasUri))) == NULL))
+                                            {
+                                                /*the upload does not need the journal, it just cannot be resumed*/
+                                                LogError("unable to open the blob upload journal, every block will be uploaded");
+                                            }
+
                                             /*Codes_SRS_IOTHUBCLIENT_LL_02_083: [ IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall call Blob_UploadFromSasUri and capture the HTTP return code and HTTP body. ]*/
-                                            BLOB_RESULT uploadMultipleBlocksResult = Blob_UploadMultipleBlocksFromSasUri(STRING_c_str(sasUri), getDataCallbackEx, context, &httpResponse, responseToIoTHub, upload_data->certificates, &(upload_data->http_proxy_options), upload_data->networkInterface);
+                                            uploadMultipleBlocksResult = (sourceFile != NULL) ?
+                                                Blob_UploadMultipleBlocksFromFile(STRING_c_str(sasUri), sourceFile, upload_data->blob_upload_gzip, &httpResponse, responseToIoTHub, upload_data->certificates, &(upload_data->http_proxy_options), upload_data->networkInterface, upload_data->blob_upload_concurrency, journal) :
+                                                Blob_UploadMultipleBlocksFromSasUri(STRING_c_str(sasUri), getDataCallbackEx, context, &httpResponse, responseToIoTHub, upload_data->certificates, &(upload_data->http_proxy_options), upload_data->networkInterface, upload_data->blob_upload_concurrency, journal);
                                             if (uploadMultipleBlocksResult == BLOB_ABORTED)
                                             {
                                                 /*Codes_SRS_IOTHUBCLIENT_LL_99_008: [ If step 2 is aborted by the client, then the HTTP message body shall look like:  ]*/
@@ -907,6 +934,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIE
                                                     STRING_delete(req_string);
                                                 }
                                             }
+
+                                            if (journal != NULL)
+                                            {
+                                                /*the journal outlives an upload that failed in a way another attempt can get past, including a failed step 3 after the block list was committed*/
+                                                blob_upload_journal_close(journal, (result == IOTHUB_CLIENT_OK) || !isResumableBlobFailure(uploadMultipleBlocksResult, httpResponse));
+                                            }
                                             BUFFER_delete(responseToIoTHub);
                                         }
                                     }
@@ -924,7 +957,42 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIE
 
         /*Codes_SRS_IOTHUBCLIENT_LL_99_003: [ If `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` return `IOTHUB_CLIENT_OK`, it shall call `getDataCallbackEx` with `result` set to `FILE_UPLOAD_OK`, and `data` and `size` set to NULL. ]*/
         /*Codes_SRS_IOTHUBCLIENT_LL_99_004: [ If `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` does not return `IOTHUB_CLIENT_OK`, it shall call `getDataCallbackEx` with `result` set to `FILE_UPLOAD_ERROR`, and `data` and `size` set to NULL. ]*/
-        (void)getDataCallbackEx(result == IOTHUB_CLIENT_OK ? FILE_UPLOAD_OK : FILE_UPLOAD_ERROR, NULL, NULL, context);
+        if (getDataCallbackEx != NULL)
+        {
+            (void)getDataCallbackEx(result == IOTHUB_CLIENT_OK ? FILE_UPLOAD_OK : FILE_UPLOAD_ERROR, NULL, NULL, context);
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context)
+{
+    return UploadMultipleBlocksToBlob(handle, destinationFileName, getDataCallbackEx, context, NULL);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadFileToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, const char* sourceFileName)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (handle == NULL || destinationFileName == NULL || sourceFileName == NULL)
+    {
+        LogError("invalid argument detected handle=%p destinationFileName=%p sourceFileName=%p", handle, destinationFileName, sourceFileName);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*the file is opened before IoT Hub is asked for a SAS URI, so a missing file does not leave an upload pending*/
+        FILE* sourceFile = fopen(sourceFileName, "rb");
+        if (sourceFile == NULL)
+        {
+            LogError("unable to open %s for reading", sourceFileName);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            result = UploadMultipleBlocksToBlob(handle, destinationFileName, NULL, NULL, sourceFile);
+            (void)fclose(sourceFile);
+        }
     }
     return result;
 }
@@ -999,6 +1067,10 @@ void IoTHubClient_LL_UploadToBlob_Destroy(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h
         {
             free((char*)upload_data->networkInterface);
         }
+        if (upload_data->blob_upload_journal_path != NULL)
+        {
+            free(upload_data->blob_upload_journal_path);
+        }
         free(upload_data);
     }
 }
@@ -1175,6 +1247,49 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_SetOption(IOTHUB_CLIENT_LL_UPL
             upload_data->blob_upload_timeout_secs = *(size_t*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(optionName, OPTION_BLOB_UPLOAD_CONCURRENCY) == 0)
+        {
+            size_t concurrency = *(size_t*)value;
+            if (concurrency == 0 || concurrency > BLOB_MAX_UPLOAD_CONCURRENCY)
+            {
+                LogError("%s must be between 1 and %d, got %lu", OPTION_BLOB_UPLOAD_CONCURRENCY, BLOB_MAX_UPLOAD_CONCURRENCY, (unsigned long)concurrency);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                upload_data->blob_upload_concurrency = concurrency;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_BLOB_UPLOAD_JOURNAL) == 0)
+        {
+            char* tempCopy = NULL;
+            /*NULL turns journaling off*/
+            if ((value != NULL) && (mallocAndStrcpy_s(&tempCopy, (const char*)value) != 0))
+            {
+                LogError("failure in mallocAndStrcpy_s");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (upload_data->blob_upload_journal_path != NULL)
+                {
+                    free(upload_data->blob_upload_journal_path);
+                }
+                upload_data->blob_upload_journal_path = tempCopy;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_BLOB_UPLOAD_GZIP) == 0)
+        {
+#ifdef USE_BLOB_COMPRESSION
+            upload_data->blob_upload_gzip = *(bool*)value;
+            result = IOTHUB_CLIENT_OK;
+#else
+            LogError("%s needs the SDK built with use_blob_compression", OPTION_BLOB_UPLOAD_GZIP);
+            result = IOTHUB_CLIENT_INVALID_ARG;
+#endif
+        }
         else if (strcmp(optionName, OPTION_NETWORK_INTERFACE_UPLOAD_TO_BLOB) == 0)
         {
             if (value == NULL)
@@ -0,0 +1,346 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+#include "internal/iothub_client_reported_state_coalescer.h"
+
+#define RESULT_OK                   0
+#define INITIAL_CALLBACK_CAPACITY   4
+
+typedef struct REPORTED_STATE_CALLBACK_ENTRY_TAG
+{
+    IOTHUB_CLIENT_REPORTED_STATE_CALLBACK callback;
+    void* context;
+} REPORTED_STATE_CALLBACK_ENTRY;
+
+typedef struct REPORTED_STATE_CALLBACKS_TAG
+{
+    REPORTED_STATE_CALLBACK_ENTRY* entries;
+    size_t count;
+    size_t capacity;
+} REPORTED_STATE_CALLBACKS;
+
+typedef struct REPORTED_STATE_COALESCER_TAG
+{
+    JSON_Value* pending_patch;                  // NULL while nothing is pending.
+    REPORTED_STATE_CALLBACKS callbacks;
+} REPORTED_STATE_COALESCER;
+
+typedef struct REPORTED_STATE_BATCH_TAG
+{
+    char* patch;                                // Serialized by parson.
+    REPORTED_STATE_CALLBACKS callbacks;
+} REPORTED_STATE_BATCH;
+
+static int add_callback(REPORTED_STATE_CALLBACKS* callbacks, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK callback, void* context)
+{
+    int result;
+
+    if (callback == NULL)
+    {
+        result = RESULT_OK;
+    }
+    else
+    {
+        if (callbacks->count == callbacks->capacity)
+        {
+            size_t capacity = (callbacks->capacity == 0) ? INITIAL_CALLBACK_CAPACITY : (callbacks->capacity * 2);
+            REPORTED_STATE_CALLBACK_ENTRY* entries = (REPORTED_STATE_CALLBACK_ENTRY*)realloc(callbacks->entries, capacity * sizeof(REPORTED_STATE_CALLBACK_ENTRY));
+
+            if (entries == NULL)
+            {
+                LogError("Failed growing the reported state callbacks");
+            }
+            else
+            {
+                callbacks->entries = entries;
+                callbacks->capacity = capacity;
+            }
+        }
+
+        if (callbacks->count == callbacks->capacity)
+        {
+            result = MU_FAILURE;
+        }
+        else
+        {
+            callbacks->entries[callbacks->count].callback = callback;
+            callbacks->entries[callbacks->count].context = context;
+            callbacks->count++;
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
+
+static JSON_Value* parse_patch(const unsigned char* reported_state, size_t size)
+{
+    JSON_Value* result;
+    char* text;
+
+    if ((text = (char*)malloc(size + 1)) == NULL)
+    {
+        LogError("Failed copying the reported state");
+        result = NULL;
+    }
+    else
+    {
+        (void)memcpy(text, reported_state, size);
+        text[size] = '\0';
+
+        if ((result = json_parse_string(text)) == NULL)
+        {
+            LogError("The reported state is not JSON");
+        }
+        else if (json_value_get_type(result) != JSONObject)
+        {
+            LogError("The reported state is not a JSON object");
+            json_value_free(result);
+            result = NULL;
+        }
+
+        free(text);
+    }
+
+    return result;
+}
+
+// Whether patch can be merged into target (the pending patch) and still leave the twin as applying both in turn would.
+// A patch setting an object where the pending one sets anything but an object cannot: applied in turn, the pending
+// value replaces what the twin holds and the object is then merged into nothing, while the merged patch would merge
+// the object into what the twin holds.
+static bool can_merge(const JSON_Object* target, const JSON_Object* patch)
+{
+    bool result = true;
+    size_t count = json_object_get_count(patch);
+    size_t i;
+
+    for (i = 0; i < count && result; i++)
+    {
+        JSON_Value* value = json_object_get_value_at(patch, i);
+        JSON_Value* target_value = json_object_get_value(target, json_object_get_name(patch, i));
+
+        if (target_value != NULL && json_value_get_type(value) == JSONObject)
+        {
+            if (json_value_get_type(target_value) != JSONObject)
+            {
+                result = false;
+            }
+            else
+            {
+                result = can_merge(json_value_get_object(target_value), json_value_get_object(value));
+            }
+        }
+    }
+
+    return result;
+}
+
+static int merge_patch(JSON_Object* target, const JSON_Object* patch)
+{
+    int result = RESULT_OK;
+    size_t count = json_object_get_count(patch);
+    size_t i;
+
+    for (i = 0; i < count && result == RESULT_OK; i++)
+    {
+        const char* name = json_object_get_name(patch, i);
+        JSON_Value* value = json_object_get_value_at(patch, i);
+        JSON_Value* target_value = json_object_get_value(target, name);
+
+        if (target_value != NULL &&
+            json_value_get_type(target_value) == JSONObject &&
+            json_value_get_type(value) == JSONObject)
+        {
+            result = merge_patch(json_value_get_object(target_value), json_value_get_object(value));
+        }
+        else
+        {
+            // The last value written for the path wins.
+            JSON_Value* copy = json_value_deep_copy(value);
+
+            if (copy == NULL)
+            {
+                LogError("Failed copying reported property %s", name);
+                result = MU_FAILURE;
+            }
+            else if (json_object_set_value(target, name, copy) != JSONSuccess)
+            {
+                LogError("Failed merging reported property %s", name);
+                json_value_free(copy);
+                result = MU_FAILURE;
+            }
+        }
+    }
+
+    return result;
+}
+
+REPORTED_STATE_COALESCER_HANDLE reported_state_coalescer_create(void)
+{
+    REPORTED_STATE_COALESCER* result;
+
+    if ((result = (REPORTED_STATE_COALESCER*)malloc(sizeof(REPORTED_STATE_COALESCER))) == NULL)
+    {
+        LogError("Failed allocating the reported state coalescer");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(REPORTED_STATE_COALESCER));
+    }
+
+    return result;
+}
+
+void reported_state_coalescer_destroy(REPORTED_STATE_COALESCER_HANDLE coalescer)
+{
+    if (coalescer != NULL)
+    {
+        json_value_free(coalescer->pending_patch);
+        free(coalescer->callbacks.entries);
+        free(coalescer);
+    }
+}
+
+int reported_state_coalescer_add(REPORTED_STATE_COALESCER_HANDLE coalescer, const unsigned char* reported_state, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reported_state_callback, void* user_context)
+{
+    int result;
+    JSON_Value* patch;
+
+    if (coalescer == NULL || reported_state == NULL || size == 0)
+    {
+        LogError("Invalid argument (coalescer=%p, reported_state=%p, size=%lu)", coalescer, reported_state, (unsigned long)size);
+        result = MU_FAILURE;
+    }
+    else if ((patch = parse_patch(reported_state, size)) == NULL)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        if (coalescer->pending_patch == NULL)
+        {
+            // The callback is added first, so that a failure leaves nothing pending.
+            if (add_callback(&coalescer->callbacks, reported_state_callback, user_context) != RESULT_OK)
+            {
+                json_value_free(patch);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                coalescer->pending_patch = patch;
+                result = RESULT_OK;
+            }
+        }
+        else
+        {
+            JSON_Object* pending_object = json_value_get_object(coalescer->pending_patch);
+            JSON_Value* merged;
+
+            // The merge works on a copy, so that a failure halfway leaves the pending patch as it was.
+            if (!can_merge(pending_object, json_value_get_object(patch)))
+            {
+                LogInfo("The reported state sets an object where a pending one sets a value that is not an object; sending it on its own");
+                result = MU_FAILURE;
+            }
+            else if ((merged = json_value_deep_copy(coalescer->pending_patch)) == NULL)
+            {
+                LogError("Failed copying the pending reported state");
+                result = MU_FAILURE;
+            }
+            else if (merge_patch(json_value_get_object(merged), json_value_get_object(patch)) != RESULT_OK ||
+                add_callback(&coalescer->callbacks, reported_state_callback, user_context) != RESULT_OK)
+            {
+                json_value_free(merged);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                json_value_free(coalescer->pending_patch);
+                coalescer->pending_patch = merged;
+                result = RESULT_OK;
+            }
+
+            json_value_free(patch);
+        }
+    }
+
+    return result;
+}
+
+bool reported_state_coalescer_has_pending(REPORTED_STATE_COALESCER_HANDLE coalescer)
+{
+    return (coalescer != NULL && coalescer->pending_patch != NULL);
+}
+
+REPORTED_STATE_BATCH_HANDLE reported_state_coalescer_take(REPORTED_STATE_COALESCER_HANDLE coalescer)
+{
+    REPORTED_STATE_BATCH* result;
+
+    if (!reported_state_coalescer_has_pending(coalescer))
+    {
+        result = NULL;
+    }
+    else if ((result = (REPORTED_STATE_BATCH*)malloc(sizeof(REPORTED_STATE_BATCH))) == NULL)
+    {
+        LogError("Failed allocating the reported state batch");
+    }
+    else if ((result->patch = json_serialize_to_string(coalescer->pending_patch)) == NULL)
+    {
+        LogError("Failed serializing the pending reported state");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->callbacks = coalescer->callbacks;
+
+        json_value_free(coalescer->pending_patch);
+        coalescer->pending_patch = NULL;
+        (void)memset(&coalescer->callbacks, 0, sizeof(REPORTED_STATE_CALLBACKS));
+    }
+
+    return result;
+}
+
+const char* reported_state_batch_get_patch(REPORTED_STATE_BATCH_HANDLE batch)
+{
+    return (batch == NULL) ? NULL : batch->patch;
+}
+
+void reported_state_batch_complete(int status_code, void* batch)
+{
+    if (batch == NULL)
+    {
+        LogError("Invalid argument (batch is NULL)");
+    }
+    else
+    {
+        REPORTED_STATE_CALLBACKS* callbacks = &((REPORTED_STATE_BATCH*)batch)->callbacks;
+        size_t i;
+
+        for (i = 0; i < callbacks->count; i++)
+        {
+            callbacks->entries[i].callback(status_code, callbacks->entries[i].context);
+        }
+
+        // A batch is completed once.
+        callbacks->count = 0;
+    }
+}
+
+void reported_state_batch_destroy(REPORTED_STATE_BATCH_HANDLE batch)
+{
+    if (batch != NULL)
+    {
+        json_free_serialized_string(batch->patch);
+        free(batch->callbacks.entries);
+        free(batch);
+    }
+}
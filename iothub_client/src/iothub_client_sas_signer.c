@@ -0,0 +1,368 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/sha.h"
+#include "azure_c_shared_utility/azure_base64.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/urlencode.h"
+#include "internal/iothub_client_sas_signer.h"
+
+// Tokens kept per key; the transports ask for one scope each, upload to blob for one more.
+#define SAS_SIGNER_CACHE_SIZE       4
+#define HMAC_INNER_PAD              0x36
+#define HMAC_OUTER_PAD              0x5c
+#define MAX_EXPIRY_TEXT_LENGTH      20
+
+typedef struct SAS_TOKEN_CACHE_ENTRY_TAG
+{
+    char* scope;
+    char* key_name;
+    uint64_t expiry;
+    char* token;
+} SAS_TOKEN_CACHE_ENTRY;
+
+typedef struct SAS_SIGNER_TAG
+{
+    // SHA-256 states after hashing the key XOR-ed with the HMAC inner and outer pads; every signature starts from a copy.
+    SHA256Context inner_context;
+    SHA256Context outer_context;
+
+    LOCK_HANDLE lock;
+    SAS_TOKEN_CACHE_ENTRY cache[SAS_SIGNER_CACHE_SIZE];
+    size_t next_cache_entry;
+} SAS_SIGNER;
+
+static int hash_pad(SHA256Context* context, const unsigned char* key, size_t key_length, unsigned char pad_byte)
+{
+    int result;
+    unsigned char pad[SHA256_Message_Block_Size];
+    size_t i;
+
+    (void)memset(pad, pad_byte, sizeof(pad));
+    for (i = 0; i < key_length; i++)
+    {
+        pad[i] ^= key[i];
+    }
+
+    if (SHA256Reset(context) != 0 ||
+        SHA256Input(context, pad, sizeof(pad)) != 0)
+    {
+        LogError("Failed hashing the HMAC pad");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    (void)memset(pad, 0, sizeof(pad));
+
+    return result;
+}
+
+static int initialize_pads(SAS_SIGNER* signer, const unsigned char* key, size_t key_length)
+{
+    int result;
+    unsigned char key_hash[SHA256HashSize];
+    SHA256Context key_context;
+
+    // As HMAC does, a key longer than a SHA-256 block is replaced by its hash.
+    if (key_length > SHA256_Message_Block_Size &&
+        (SHA256Reset(&key_context) != 0 ||
+         SHA256Input(&key_context, key, (unsigned int)key_length) != 0 ||
+         SHA256Result(&key_context, key_hash) != 0))
+    {
+        LogError("Failed hashing the device key");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        if (key_length > SHA256_Message_Block_Size)
+        {
+            key = key_hash;
+            key_length = SHA256HashSize;
+        }
+
+        if (hash_pad(&signer->inner_context, key, key_length, HMAC_INNER_PAD) != 0 ||
+            hash_pad(&signer->outer_context, key, key_length, HMAC_OUTER_PAD) != 0)
+        {
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    (void)memset(key_hash, 0, sizeof(key_hash));
+
+    return result;
+}
+
+// The HMAC-SHA256 of "<scope>\n<expiry>", resumed from the hashed pads.
+static int compute_signature(const SAS_SIGNER* signer, const char* scope, const char* expiry_text, unsigned char* signature)
+{
+    int result;
+    unsigned char inner_digest[SHA256HashSize];
+    SHA256Context context = signer->inner_context;
+
+    if (SHA256Input(&context, (const uint8_t*)scope, (unsigned int)strlen(scope)) != 0 ||
+        SHA256Input(&context, (const uint8_t*)"\n", 1) != 0 ||
+        SHA256Input(&context, (const uint8_t*)expiry_text, (unsigned int)strlen(expiry_text)) != 0 ||
+        SHA256Result(&context, inner_digest) != 0)
+    {
+        LogError("Failed hashing the string to sign");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        context = signer->outer_context;
+
+        if (SHA256Input(&context, inner_digest, SHA256HashSize) != 0 ||
+            SHA256Result(&context, signature) != 0)
+        {
+            LogError("Failed hashing the inner digest");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    (void)memset(inner_digest, 0, sizeof(inner_digest));
+
+    return result;
+}
+
+// Builds the same token SASToken_CreateString does.
+static char* sign_token(const SAS_SIGNER* signer, const char* scope, const char* key_name, uint64_t expiry)
+{
+    char* result;
+    char expiry_text[MAX_EXPIRY_TEXT_LENGTH + 1];
+    unsigned char digest[SHA256HashSize];
+    STRING_HANDLE signature;
+
+    (void)sprintf(expiry_text, "%" PRIu64, expiry);
+
+    if (compute_signature(signer, scope, expiry_text, digest) != 0)
+    {
+        result = NULL;
+    }
+    else if ((signature = Azure_Base64_Encode_Bytes(digest, SHA256HashSize)) == NULL)
+    {
+        LogError("Failed encoding the signature");
+        result = NULL;
+    }
+    else
+    {
+        STRING_HANDLE encoded_signature;
+        STRING_HANDLE token;
+
+        if ((encoded_signature = URL_Encode(signature)) == NULL)
+        {
+            LogError("Failed URL encoding the signature");
+            result = NULL;
+        }
+        else
+        {
+            if (key_name != NULL && key_name[0] != '\0')
+            {
+                token = STRING_construct_sprintf("SharedAccessSignature sr=%s&sig=%s&se=%s&skn=%s", scope, STRING_c_str(encoded_signature), expiry_text, key_name);
+            }
+            else
+            {
+                token = STRING_construct_sprintf("SharedAccessSignature sr=%s&sig=%s&se=%s", scope, STRING_c_str(encoded_signature), expiry_text);
+            }
+
+            if (token == NULL)
+            {
+                LogError("Failed constructing the SAS token");
+                result = NULL;
+            }
+            else
+            {
+                if (mallocAndStrcpy_s(&result, STRING_c_str(token)) != 0)
+                {
+                    LogError("Failed copying the SAS token");
+                    result = NULL;
+                }
+                STRING_delete(token);
+            }
+            STRING_delete(encoded_signature);
+        }
+        STRING_delete(signature);
+    }
+
+    (void)memset(digest, 0, sizeof(digest));
+
+    return result;
+}
+
+static void free_cache_entry(SAS_TOKEN_CACHE_ENTRY* entry)
+{
+    free(entry->scope);
+    free(entry->key_name);
+    free(entry->token);
+    (void)memset(entry, 0, sizeof(SAS_TOKEN_CACHE_ENTRY));
+}
+
+static char* get_cached_token(SAS_SIGNER* signer, const char* scope, const char* key_name, uint64_t expiry)
+{
+    char* result = NULL;
+
+    if (Lock(signer->lock) != LOCK_OK)
+    {
+        LogError("Failed locking the SAS token cache");
+    }
+    else
+    {
+        size_t i;
+
+        for (i = 0; i < SAS_SIGNER_CACHE_SIZE; i++)
+        {
+            SAS_TOKEN_CACHE_ENTRY* entry = &signer->cache[i];
+
+            if (entry->token != NULL &&
+                entry->expiry == expiry &&
+                strcmp(entry->scope, scope) == 0 &&
+                strcmp(entry->key_name, key_name) == 0)
+            {
+                if (mallocAndStrcpy_s(&result, entry->token) != 0)
+                {
+                    LogError("Failed copying the cached SAS token");
+                    result = NULL;
+                }
+                break;
+            }
+        }
+
+        (void)Unlock(signer->lock);
+    }
+
+    return result;
+}
+
+static void cache_token(SAS_SIGNER* signer, const char* scope, const char* key_name, uint64_t expiry, const char* token)
+{
+    SAS_TOKEN_CACHE_ENTRY entry;
+
+    (void)memset(&entry, 0, sizeof(SAS_TOKEN_CACHE_ENTRY));
+    entry.expiry = expiry;
+
+    if (mallocAndStrcpy_s(&entry.scope, scope) != 0 ||
+        mallocAndStrcpy_s(&entry.key_name, key_name) != 0 ||
+        mallocAndStrcpy_s(&entry.token, token) != 0)
+    {
+        LogError("Failed caching the SAS token");
+        free_cache_entry(&entry);
+    }
+    else if (Lock(signer->lock) != LOCK_OK)
+    {
+        LogError("Failed locking the SAS token cache");
+        free_cache_entry(&entry);
+    }
+    else
+    {
+        // The oldest token makes room. Expired ones are never asked for again, as the expiry is part of the key.
+        free_cache_entry(&signer->cache[signer->next_cache_entry]);
+        signer->cache[signer->next_cache_entry] = entry;
+        signer->next_cache_entry = (signer->next_cache_entry + 1) % SAS_SIGNER_CACHE_SIZE;
+
+        (void)Unlock(signer->lock);
+    }
+}
+
+SAS_SIGNER_HANDLE sas_signer_create(const char* device_key)
+{
+    SAS_SIGNER* result;
+    BUFFER_HANDLE decoded_key;
+
+    if (device_key == NULL)
+    {
+        LogError("Invalid argument (device_key is NULL)");
+        result = NULL;
+    }
+    else if ((decoded_key = Azure_Base64_Decode(device_key)) == NULL)
+    {
+        LogError("Failed decoding the device key");
+        result = NULL;
+    }
+    else
+    {
+        if ((result = (SAS_SIGNER*)malloc(sizeof(SAS_SIGNER))) == NULL)
+        {
+            LogError("Failed allocating the SAS signer");
+        }
+        else
+        {
+            (void)memset(result, 0, sizeof(SAS_SIGNER));
+
+            if (initialize_pads(result, BUFFER_u_char(decoded_key), BUFFER_length(decoded_key)) != 0)
+            {
+                LogError("Failed initializing the HMAC pads");
+                free(result);
+                result = NULL;
+            }
+            else if ((result->lock = Lock_Init()) == NULL)
+            {
+                LogError("Lock_Init failed");
+                free(result);
+                result = NULL;
+            }
+        }
+
+        BUFFER_delete(decoded_key);
+    }
+
+    return (SAS_SIGNER_HANDLE)result;
+}
+
+char* sas_signer_get_token(SAS_SIGNER_HANDLE signer, const char* scope, const char* key_name, uint64_t expiry)
+{
+    char* result;
+
+    if (signer == NULL || scope == NULL)
+    {
+        LogError("Invalid argument (signer=%p, scope=%p)", signer, scope);
+        result = NULL;
+    }
+    else
+    {
+        const char* cached_key_name = (key_name == NULL) ? "" : key_name;
+
+        if ((result = get_cached_token(signer, scope, cached_key_name, expiry)) == NULL &&
+            (result = sign_token(signer, scope, key_name, expiry)) != NULL)
+        {
+            cache_token(signer, scope, cached_key_name, expiry, result);
+        }
+    }
+
+    return result;
+}
+
+void sas_signer_destroy(SAS_SIGNER_HANDLE signer)
+{
+    if (signer != NULL)
+    {
+        size_t i;
+
+        for (i = 0; i < SAS_SIGNER_CACHE_SIZE; i++)
+        {
+            free_cache_entry(&signer->cache[i]);
+        }
+
+        Lock_Deinit(signer->lock);
+        (void)memset(signer, 0, sizeof(SAS_SIGNER));
+        free(signer);
+    }
+}
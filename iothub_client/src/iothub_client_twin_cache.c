@@ -0,0 +1,262 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+#include "internal/iothub_client_twin_cache.h"
+
+#define RESULT_OK               0
+#define TWIN_DESIRED_NAME       "desired"
+#define TWIN_VERSION_NAME       "$version"
+
+typedef struct TWIN_CACHE_TAG
+{
+    JSON_Value* document;                       // NULL until a full twin is set.
+} TWIN_CACHE;
+
+static JSON_Value* parse_object(const unsigned char* json, size_t size)
+{
+    JSON_Value* result;
+    char* text;
+
+    if ((text = (char*)malloc(size + 1)) == NULL)
+    {
+        LogError("Failed copying the twin JSON");
+        result = NULL;
+    }
+    else
+    {
+        (void)memcpy(text, json, size);
+        text[size] = '\0';
+
+        if ((result = json_parse_string(text)) == NULL)
+        {
+            LogError("The twin JSON could not be parsed");
+        }
+        else if (json_value_get_type(result) != JSONObject)
+        {
+            LogError("The twin JSON is not an object");
+            json_value_free(result);
+            result = NULL;
+        }
+
+        free(text);
+    }
+
+    return result;
+}
+
+// Applies patch to target as a JSON merge patch: null removes a property, an object is merged into the one it replaces.
+static int merge_patch(JSON_Object* target, const JSON_Object* patch)
+{
+    int result = RESULT_OK;
+    size_t count = json_object_get_count(patch);
+    size_t i;
+
+    for (i = 0; i < count && result == RESULT_OK; i++)
+    {
+        const char* name = json_object_get_name(patch, i);
+        JSON_Value* value = json_object_get_value_at(patch, i);
+
+        if (json_value_get_type(value) == JSONNull)
+        {
+            (void)json_object_remove(target, name);
+        }
+        else if (json_value_get_type(value) == JSONObject)
+        {
+            JSON_Value* target_value = json_object_get_value(target, name);
+
+            if (target_value == NULL || json_value_get_type(target_value) != JSONObject)
+            {
+                if ((target_value = json_value_init_object()) == NULL)
+                {
+                    LogError("Failed creating desired property %s", name);
+                    result = MU_FAILURE;
+                }
+                else if (json_object_set_value(target, name, target_value) != JSONSuccess)
+                {
+                    LogError("Failed setting desired property %s", name);
+                    json_value_free(target_value);
+                    result = MU_FAILURE;
+                }
+            }
+
+            if (result == RESULT_OK)
+            {
+                result = merge_patch(json_value_get_object(target_value), json_value_get_object(value));
+            }
+        }
+        else
+        {
+            JSON_Value* copy = json_value_deep_copy(value);
+
+            if (copy == NULL)
+            {
+                LogError("Failed copying desired property %s", name);
+                result = MU_FAILURE;
+            }
+            else if (json_object_set_value(target, name, copy) != JSONSuccess)
+            {
+                LogError("Failed setting desired property %s", name);
+                json_value_free(copy);
+                result = MU_FAILURE;
+            }
+        }
+    }
+
+    return result;
+}
+
+TWIN_CACHE_HANDLE twin_cache_create(void)
+{
+    TWIN_CACHE* result;
+
+    if ((result = (TWIN_CACHE*)malloc(sizeof(TWIN_CACHE))) == NULL)
+    {
+        LogError("Failed allocating the twin cache");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(TWIN_CACHE));
+    }
+
+    return result;
+}
+
+void twin_cache_destroy(TWIN_CACHE_HANDLE twin_cache)
+{
+    if (twin_cache != NULL)
+    {
+        json_value_free(twin_cache->document);
+        free(twin_cache);
+    }
+}
+
+int twin_cache_set_document(TWIN_CACHE_HANDLE twin_cache, const unsigned char* twin, size_t size)
+{
+    int result;
+    JSON_Value* document;
+
+    if (twin_cache == NULL || twin == NULL || size == 0)
+    {
+        LogError("Invalid argument (twin_cache=%p, twin=%p, size=%lu)", twin_cache, twin, (unsigned long)size);
+        result = MU_FAILURE;
+    }
+    else if ((document = parse_object(twin, size)) == NULL)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        json_value_free(twin_cache->document);
+        twin_cache->document = document;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+TWIN_CACHE_RESULT twin_cache_apply_patch(TWIN_CACHE_HANDLE twin_cache, const unsigned char* patch, size_t size)
+{
+    TWIN_CACHE_RESULT result;
+    JSON_Value* patch_value;
+
+    if (twin_cache == NULL || patch == NULL || size == 0)
+    {
+        LogError("Invalid argument (twin_cache=%p, patch=%p, size=%lu)", twin_cache, patch, (unsigned long)size);
+        result = TWIN_CACHE_ERROR;
+    }
+    else if ((patch_value = parse_object(patch, size)) == NULL)
+    {
+        result = TWIN_CACHE_ERROR;
+    }
+    else
+    {
+        JSON_Object* patch_object = json_value_get_object(patch_value);
+        JSON_Object* desired = (twin_cache->document == NULL) ? NULL : json_object_get_object(json_value_get_object(twin_cache->document), TWIN_DESIRED_NAME);
+
+        if (desired == NULL ||
+            json_value_get_type(json_object_get_value(desired, TWIN_VERSION_NAME)) != JSONNumber ||
+            json_value_get_type(json_object_get_value(patch_object, TWIN_VERSION_NAME)) != JSONNumber)
+        {
+            result = TWIN_CACHE_GAP;
+        }
+        else
+        {
+            double cached_version = json_object_get_number(desired, TWIN_VERSION_NAME);
+            double patch_version = json_object_get_number(patch_object, TWIN_VERSION_NAME);
+
+            if (patch_version <= cached_version)
+            {
+                // A full twin fetched after the patch was sent already has it.
+                result = TWIN_CACHE_STALE;
+            }
+            else if (patch_version != cached_version + 1)
+            {
+                LogInfo("Desired properties $version %.0f follows %.0f, patches were missed", patch_version, cached_version);
+                result = TWIN_CACHE_GAP;
+            }
+            else if (merge_patch(desired, patch_object) != RESULT_OK)
+            {
+                // The document is merged in place, so a failure halfway leaves it in no known $version.
+                json_value_free(twin_cache->document);
+                twin_cache->document = NULL;
+                result = TWIN_CACHE_ERROR;
+            }
+            else
+            {
+                result = TWIN_CACHE_OK;
+            }
+        }
+
+        json_value_free(patch_value);
+    }
+
+    return result;
+}
+
+int twin_cache_get_document(TWIN_CACHE_HANDLE twin_cache, unsigned char** twin, size_t* size)
+{
+    int result;
+
+    if (twin_cache == NULL || twin == NULL || size == NULL)
+    {
+        LogError("Invalid argument (twin_cache=%p, twin=%p, size=%p)", twin_cache, twin, size);
+        result = MU_FAILURE;
+    }
+    else if (twin_cache->document == NULL)
+    {
+        LogError("No twin document received yet");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        // The serialization size counts the terminating NUL.
+        size_t buffer_size = json_serialization_size(twin_cache->document);
+        char* buffer;
+
+        if (buffer_size == 0 || (buffer = (char*)malloc(buffer_size)) == NULL)
+        {
+            LogError("Failed allocating the twin document");
+            result = MU_FAILURE;
+        }
+        else if (json_serialize_to_buffer(twin_cache->document, buffer, buffer_size) != JSONSuccess)
+        {
+            LogError("Failed serializing the twin document");
+            free(buffer);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            *twin = (unsigned char*)buffer;
+            *size = buffer_size - 1;
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
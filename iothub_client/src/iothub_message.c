@@ -2,10 +2,13 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/lock.h"
 
 #include "iothub_message.h"
 
@@ -14,6 +17,11 @@ MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE
 
 static const char* SECURITY_CLIENT_JSON_ENCODING = "application/json";
 
+/*system property strings are bump-allocated from storage in the same block as the message, longer ones go to the heap*/
+#define MESSAGE_INLINE_STRINGS_SIZE     192
+/*byte array payloads up to this size are kept in the same block as the message instead of a BUFFER*/
+#define MESSAGE_INLINE_PAYLOAD_SIZE     256
+
 typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
 {
     IOTHUBMESSAGE_CONTENT_TYPE contentType;
@@ -35,8 +43,34 @@ typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
     bool is_security_message;
     char* creationTimeUtc;
     char* userId;
+    /*set when the payload is inline or was lent by IoTHubMessage_CreateFromBuffer, in which case value.byteArray is not used*/
+    bool is_direct_payload;
+    const unsigned char* direct_payload;
+    size_t direct_payload_size;
+    IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK application_buffer_free_callback;
+    void* application_buffer_context;
+    /*follows this structure in the same allocation, the inline payload (if any) comes after it*/
+    char* string_arena;
+    size_t string_arena_size;
+    size_t string_arena_used;
+    /*set for messages owned by an IoTHubMessagePool, IoTHubMessage_Destroy gives them back to it*/
+    struct IOTHUB_MESSAGE_POOL_TAG* pool;
+    struct IOTHUB_MESSAGE_HANDLE_DATA_TAG* next_free;
 }IOTHUB_MESSAGE_HANDLE_DATA;
 
+typedef struct IOTHUB_MESSAGE_POOL_TAG
+{
+    LOCK_HANDLE lock;
+    IOTHUB_MESSAGE_HANDLE_DATA* free_messages;
+    size_t capacity;
+    size_t max_payload_size;
+    size_t max_properties;
+    /*pooled messages in existence, free or acquired*/
+    size_t message_count;
+    bool is_destroyed;
+    IOTHUB_MESSAGE_POOL_STATISTICS statistics;
+}IOTHUB_MESSAGE_POOL;
+
 static bool ContainsValidUsAscii(const char* asciiValue)
 {
     bool result = true;
@@ -80,9 +114,129 @@ static void DestroyDiagnosticPropertyData(IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DAT
     free(diagnosticHandle);
 }
 
+static IOTHUB_MESSAGE_HANDLE_DATA* allocate_message(size_t strings_size, size_t inline_payload_size)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+
+    if (strings_size > (SIZE_MAX - sizeof(IOTHUB_MESSAGE_HANDLE_DATA) - inline_payload_size))
+    {
+        LogError("message too large (strings_size=%lu)", (unsigned long)strings_size);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA) + strings_size + inline_payload_size)) != NULL)
+    {
+        memset(result, 0, sizeof(*result));
+        result->string_arena = (char*)result + sizeof(IOTHUB_MESSAGE_HANDLE_DATA);
+        result->string_arena_size = strings_size;
+    }
+
+    return result;
+}
+
+/*copies the payload after the string arena, the block must have been allocated with room for it*/
+static void set_inline_payload(IOTHUB_MESSAGE_HANDLE_DATA* handleData, const unsigned char* payload, size_t size)
+{
+    unsigned char* destination = (unsigned char*)handleData->string_arena + handleData->string_arena_size;
+    if (size > 0)
+    {
+        (void)memcpy(destination, payload, size);
+    }
+    handleData->is_direct_payload = true;
+    handleData->direct_payload = destination;
+    handleData->direct_payload_size = size;
+}
+
+static bool is_arena_string(const IOTHUB_MESSAGE_HANDLE_DATA* handleData, const char* value)
+{
+    return ((uintptr_t)value >= (uintptr_t)handleData->string_arena) &&
+        ((uintptr_t)value < (uintptr_t)(handleData->string_arena + handleData->string_arena_size));
+}
+
+static int copy_message_string(IOTHUB_MESSAGE_HANDLE_DATA* handleData, char** destination, const char* source)
+{
+    int result;
+    size_t length = strlen(source) + 1;
+
+    if (length <= (handleData->string_arena_size - handleData->string_arena_used))
+    {
+        *destination = handleData->string_arena + handleData->string_arena_used;
+        (void)memcpy(*destination, source, length);
+        handleData->string_arena_used += length;
+        result = 0;
+    }
+    else if (mallocAndStrcpy_s(destination, source) != 0)
+    {
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static bool is_last_arena_string(const IOTHUB_MESSAGE_HANDLE_DATA* handleData, const char* value)
+{
+    return is_arena_string(handleData, value) &&
+        ((value + strlen(value) + 1) == (handleData->string_arena + handleData->string_arena_used));
+}
+
+static void release_message_string(IOTHUB_MESSAGE_HANDLE_DATA* handleData, char** value)
+{
+    if (is_arena_string(handleData, *value))
+    {
+        /*only the last string of the arena can be given back, the others stay until the message is destroyed*/
+        if (is_last_arena_string(handleData, *value))
+        {
+            handleData->string_arena_used = (size_t)(*value - handleData->string_arena);
+        }
+    }
+    else
+    {
+        free(*value);
+    }
+    *value = NULL;
+}
+
+static size_t get_strings_length(const IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    const char* strings[10];
+    size_t i;
+    size_t result = 0;
+
+    strings[0] = handleData->messageId;
+    strings[1] = handleData->correlationId;
+    strings[2] = handleData->userDefinedContentType;
+    strings[3] = handleData->contentEncoding;
+    strings[4] = handleData->outputName;
+    strings[5] = handleData->inputName;
+    strings[6] = handleData->connectionModuleId;
+    strings[7] = handleData->connectionDeviceId;
+    strings[8] = handleData->creationTimeUtc;
+    strings[9] = handleData->userId;
+
+    for (i = 0; i < sizeof(strings) / sizeof(strings[0]); i++)
+    {
+        if (strings[i] != NULL)
+        {
+            result += strlen(strings[i]) + 1;
+        }
+    }
+
+    return result;
+}
+
 static void DestroyMessageData(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
 {
-    if (handleData->contentType == IOTHUBMESSAGE_BYTEARRAY)
+    if (handleData->is_direct_payload)
+    {
+        if (handleData->application_buffer_free_callback != NULL)
+        {
+            handleData->application_buffer_free_callback(handleData->direct_payload, handleData->application_buffer_context);
+        }
+    }
+    else if (handleData->contentType == IOTHUBMESSAGE_BYTEARRAY)
     {
         BUFFER_delete(handleData->value.byteArray);
     }
@@ -92,19 +246,17 @@ static void DestroyMessageData(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
     }
 
     Map_Destroy(handleData->properties);
-    free(handleData->messageId);
-    handleData->messageId = NULL;
-    free(handleData->correlationId);
-    handleData->correlationId = NULL;
-    free(handleData->userDefinedContentType);
-    free(handleData->contentEncoding);
+    release_message_string(handleData, &handleData->messageId);
+    release_message_string(handleData, &handleData->correlationId);
+    release_message_string(handleData, &handleData->userDefinedContentType);
+    release_message_string(handleData, &handleData->contentEncoding);
     DestroyDiagnosticPropertyData(handleData->diagnosticData);
-    free(handleData->outputName);
-    free(handleData->inputName);
-    free(handleData->connectionModuleId);
-    free(handleData->connectionDeviceId);
-    free(handleData->creationTimeUtc);
-    free(handleData->userId);
+    release_message_string(handleData, &handleData->outputName);
+    release_message_string(handleData, &handleData->inputName);
+    release_message_string(handleData, &handleData->connectionModuleId);
+    release_message_string(handleData, &handleData->connectionDeviceId);
+    release_message_string(handleData, &handleData->creationTimeUtc);
+    release_message_string(handleData, &handleData->userId);
     free(handleData);
 }
 
@@ -112,8 +264,18 @@ static int set_content_encoding(IOTHUB_MESSAGE_HANDLE_DATA* handleData, const ch
 {
     int result;
     char* tmp_encoding;
+    size_t length = strlen(encoding) + 1;
 
-    if (mallocAndStrcpy_s(&tmp_encoding, encoding) != 0)
+    if (handleData->contentEncoding != NULL &&
+        is_last_arena_string(handleData, handleData->contentEncoding) &&
+        length <= (handleData->string_arena_size - (size_t)(handleData->contentEncoding - handleData->string_arena)))
+    {
+        /*the previous value ends the inline storage and the new one fits in its place, so it is overwritten without any allocation*/
+        (void)memmove(handleData->contentEncoding, encoding, length);
+        handleData->string_arena_used = (size_t)(handleData->contentEncoding - handleData->string_arena) + length;
+        result = 0;
+    }
+    else if (copy_message_string(handleData, &tmp_encoding, encoding) != 0)
     {
         LogError("Failed saving a copy of contentEncoding");
         // Codes_SRS_IOTHUBMESSAGE_09_008: [If the allocation or the copying of `contentEncoding` fails, then IoTHubMessage_SetContentEncodingSystemProperty shall return IOTHUB_MESSAGE_ERROR.]
@@ -124,7 +286,7 @@ static int set_content_encoding(IOTHUB_MESSAGE_HANDLE_DATA* handleData, const ch
         // Codes_SRS_IOTHUBMESSAGE_09_007: [If the IOTHUB_MESSAGE_HANDLE `contentEncoding` is not NULL it shall be deallocated.]
         if (handleData->contentEncoding != NULL)
         {
-            free(handleData->contentEncoding);
+            release_message_string(handleData, &handleData->contentEncoding);
         }
         handleData->contentEncoding = tmp_encoding;
         result = 0;
@@ -139,11 +301,10 @@ static int set_message_creation_time(IOTHUB_MESSAGE_HANDLE_DATA* handleData, con
 
     if (handleData->creationTimeUtc != NULL)
     {
-        free(handleData->creationTimeUtc);
-        handleData->creationTimeUtc = NULL;
+        release_message_string(handleData, &handleData->creationTimeUtc);
     }
 
-    if (mallocAndStrcpy_s(&tmp_message_creation_time, messageCreationTimeUtc) != 0)
+    if (copy_message_string(handleData, &tmp_message_creation_time, messageCreationTimeUtc) != 0)
     {
         LogError("Failed saving a copy of messageCreationTimeUtc");
         result = MU_FAILURE;
@@ -163,11 +324,10 @@ static int set_message_user_id(IOTHUB_MESSAGE_HANDLE_DATA* handleData, const cha
 
     if (handleData->userId != NULL)
     {
-        free(handleData->userId);
-        handleData->userId = NULL;
+        release_message_string(handleData, &handleData->userId);
     }
 
-    if (mallocAndStrcpy_s(&tmp_message_user_id, userId) != 0)
+    if (copy_message_string(handleData, &tmp_message_user_id, userId) != 0)
     {
         LogError("Failed saving a copy of userId");
         result = MU_FAILURE;
@@ -226,7 +386,9 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
     }
     else
     {
-        result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
+        bool inline_payload = (size <= MESSAGE_INLINE_PAYLOAD_SIZE);
+
+        result = allocate_message(MESSAGE_INLINE_STRINGS_SIZE, inline_payload ? size : 0);
         if (result == NULL)
         {
             LogError("unable to malloc");
@@ -238,7 +400,6 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
             const unsigned char* source;
             unsigned char temp = 0x00;
 
-            memset(result, 0, sizeof(*result));
             /*Codes_SRS_IOTHUBMESSAGE_02_026: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.] */
             result->contentType = IOTHUBMESSAGE_BYTEARRAY;
 
@@ -264,16 +425,21 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
             }
             if (result != NULL)
             {
+                if (inline_payload)
+                {
+                    set_inline_payload(result, source, size);
+                }
                 /*Codes_SRS_IOTHUBMESSAGE_02_022: [IoTHubMessage_CreateFromByteArray shall call BUFFER_create passing byteArray and size as parameters.] */
-                if ((result->value.byteArray = BUFFER_create(source, size)) == NULL)
+                else if ((result->value.byteArray = BUFFER_create(source, size)) == NULL)
                 {
                     LogError("BUFFER_create failed");
                     /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
                     DestroyMessageData(result);
                     result = NULL;
                 }
+
                 /*Codes_SRS_IOTHUBMESSAGE_02_023: [IoTHubMessage_CreateFromByteArray shall call Map_Create to create the message properties.] */
-                else if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+                if ((result != NULL) && ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL))
                 {
                     LogError("Map_Create for properties failed");
                     /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
@@ -287,6 +453,45 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
     return result;
 }
 
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromBuffer(const unsigned char* buffer, size_t size, IOTHUB_MESSAGE_BUFFER_FREE_CALLBACK bufferFreeCallback, void* userContext)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+    if (buffer == NULL)
+    {
+        LogError("Invalid argument - buffer is NULL");
+        result = NULL;
+    }
+    else
+    {
+        result = allocate_message(MESSAGE_INLINE_STRINGS_SIZE, 0);
+        if (result == NULL)
+        {
+            LogError("unable to malloc");
+        }
+        else
+        {
+            result->contentType = IOTHUBMESSAGE_BYTEARRAY;
+            result->is_direct_payload = true;
+            result->direct_payload = buffer;
+            result->direct_payload_size = size;
+
+            if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+            {
+                LogError("Map_Create for properties failed");
+                /*the buffer is not given back on failure, the application still owns it*/
+                DestroyMessageData(result);
+                result = NULL;
+            }
+            else
+            {
+                result->application_buffer_free_callback = bufferFreeCallback;
+                result->application_buffer_context = userContext;
+            }
+        }
+    }
+    return result;
+}
+
 IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
 {
     IOTHUB_MESSAGE_HANDLE_DATA* result;
@@ -297,7 +502,7 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
     }
     else
     {
-        result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
+        result = allocate_message(MESSAGE_INLINE_STRINGS_SIZE, 0);
         if (result == NULL)
         {
             LogError("malloc failed");
@@ -306,7 +511,6 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
         }
         else
         {
-            memset(result, 0, sizeof(*result));
             /*Codes_SRS_IOTHUBMESSAGE_02_032: [The type of the new message shall be IOTHUBMESSAGE_STRING.] */
             result->contentType = IOTHUBMESSAGE_STRING;
 
@@ -345,7 +549,26 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
     }
     else
     {
-        result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
+        /*the clone gets room for all the strings of the source, so copying them never touches the heap*/
+        size_t strings_size = get_strings_length(source);
+        size_t payload_size;
+        bool inline_payload;
+
+        if (source->contentType != IOTHUBMESSAGE_BYTEARRAY)
+        {
+            payload_size = 0;
+        }
+        else if (source->is_direct_payload)
+        {
+            payload_size = source->direct_payload_size;
+        }
+        else
+        {
+            payload_size = BUFFER_length(source->value.byteArray);
+        }
+        inline_payload = (source->contentType == IOTHUBMESSAGE_BYTEARRAY) && (payload_size <= MESSAGE_INLINE_PAYLOAD_SIZE);
+
+        result = allocate_message((strings_size > MESSAGE_INLINE_STRINGS_SIZE) ? strings_size : MESSAGE_INLINE_STRINGS_SIZE, inline_payload ? payload_size : 0);
         /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
         if (result == NULL)
         {
@@ -355,29 +578,28 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
         }
         else
         {
-            memset(result, 0, sizeof(*result));
             result->contentType = source->contentType;
             result->is_security_message = source->is_security_message;
 
-            if (source->messageId != NULL && mallocAndStrcpy_s(&result->messageId, source->messageId) != 0)
+            if (source->messageId != NULL && copy_message_string(result, &result->messageId, source->messageId) != 0)
             {
                 LogError("unable to Copy messageId");
                 DestroyMessageData(result);
                 result = NULL;
             }
-            else if (source->correlationId != NULL && mallocAndStrcpy_s(&result->correlationId, source->correlationId) != 0)
+            else if (source->correlationId != NULL && copy_message_string(result, &result->correlationId, source->correlationId) != 0)
             {
                 LogError("unable to Copy correlationId");
                 DestroyMessageData(result);
                 result = NULL;
             }
-            else if (source->userDefinedContentType != NULL && mallocAndStrcpy_s(&result->userDefinedContentType, source->userDefinedContentType) != 0)
+            else if (source->userDefinedContentType != NULL && copy_message_string(result, &result->userDefinedContentType, source->userDefinedContentType) != 0)
             {
                 LogError("unable to copy contentType");
                 DestroyMessageData(result);
                 result = NULL;
             }
-            else if (source->contentEncoding != NULL && mallocAndStrcpy_s(&result->contentEncoding, source->contentEncoding) != 0)
+            else if (source->contentEncoding != NULL && copy_message_string(result, &result->contentEncoding, source->contentEncoding) != 0)
             {
                 LogError("unable to copy contentEncoding");
                 DestroyMessageData(result);
@@ -389,37 +611,37 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
                 DestroyMessageData(result);
                 result = NULL;
             }
-            else if (source->outputName != NULL && mallocAndStrcpy_s(&result->outputName, source->outputName) != 0)
+            else if (source->outputName != NULL && copy_message_string(result, &result->outputName, source->outputName) != 0)
             {
                 LogError("unable to copy outputName");
                 DestroyMessageData(result);
                 result = NULL;
             }
-            else if (source->inputName != NULL && mallocAndStrcpy_s(&result->inputName, source->inputName) != 0)
+            else if (source->inputName != NULL && copy_message_string(result, &result->inputName, source->inputName) != 0)
             {
                 LogError("unable to copy inputName");
                 DestroyMessageData(result);
                 result = NULL;
             }
-            else if (source->creationTimeUtc != NULL && mallocAndStrcpy_s(&result->creationTimeUtc, source->creationTimeUtc) != 0)
+            else if (source->creationTimeUtc != NULL && copy_message_string(result, &result->creationTimeUtc, source->creationTimeUtc) != 0)
             {
                 LogError("unable to copy creationTimeUtc");
                 DestroyMessageData(result);
                 result = NULL;
             }
-            else if (source->userId != NULL && mallocAndStrcpy_s(&result->userId, source->userId) != 0)
+            else if (source->userId != NULL && copy_message_string(result, &result->userId, source->userId) != 0)
             {
                 LogError("unable to copy userId");
                 DestroyMessageData(result);
                 result = NULL;
             }
-            else if (source->connectionModuleId != NULL && mallocAndStrcpy_s(&result->connectionModuleId, source->connectionModuleId) != 0)
+            else if (source->connectionModuleId != NULL && copy_message_string(result, &result->connectionModuleId, source->connectionModuleId) != 0)
             {
                 LogError("unable to copy inputName");
                 DestroyMessageData(result);
                 result = NULL;
             }
-            else if (source->connectionDeviceId != NULL && mallocAndStrcpy_s(&result->connectionDeviceId, source->connectionDeviceId) != 0)
+            else if (source->connectionDeviceId != NULL && copy_message_string(result, &result->connectionDeviceId, source->connectionDeviceId) != 0)
             {
                 LogError("unable to copy inputName");
                 DestroyMessageData(result);
@@ -427,16 +649,24 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
             }
             else if (source->contentType == IOTHUBMESSAGE_BYTEARRAY)
             {
+                if (inline_payload)
+                {
+                    set_inline_payload(result, source->is_direct_payload ? source->direct_payload : BUFFER_u_char(source->value.byteArray), payload_size);
+                }
                 /*Codes_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone to content by a call to BUFFER_clone] */
-                if ((result->value.byteArray = BUFFER_clone(source->value.byteArray)) == NULL)
+                /*the application buffer of the source is not owned by the clone, so it is copied*/
+                else if ((result->value.byteArray = (source->is_direct_payload ?
+                    BUFFER_create(source->direct_payload, source->direct_payload_size) :
+                    BUFFER_clone(source->value.byteArray))) == NULL)
                 {
                     /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
                     LogError("unable to BUFFER_clone");
                     DestroyMessageData(result);
                     result = NULL;
                 }
+
                 /*Codes_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-                else if ((result->properties = Map_Clone(source->properties)) == NULL)
+                if ((result != NULL) && ((result->properties = Map_Clone(source->properties)) == NULL))
                 {
                     /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
                     LogError("unable to Map_Clone");
@@ -491,6 +721,12 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMes
             result = IOTHUB_MESSAGE_INVALID_ARG;
             LogError("invalid type of message %s", MU_ENUM_TO_STRING(IOTHUBMESSAGE_CONTENT_TYPE, handleData->contentType));
         }
+        else if (handleData->is_direct_payload)
+        {
+            *buffer = handleData->direct_payload;
+            *size = handleData->direct_payload_size;
+            result = IOTHUB_MESSAGE_OK;
+        }
         else
         {
             /*Codes_SRS_IOTHUBMESSAGE_01_011: [The pointer shall be obtained by using BUFFER_u_char and it shall be copied in the buffer argument.]*/
@@ -649,11 +885,10 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHu
         /* Codes_SRS_IOTHUBMESSAGE_07_019: [If the IOTHUB_MESSAGE_HANDLE correlationId is not NULL, then the IOTHUB_MESSAGE_HANDLE correlationId will be deallocated.] */
         if (handleData->correlationId != NULL)
         {
-            free(handleData->correlationId);
-            handleData->correlationId = NULL;
+            release_message_string(handleData, &handleData->correlationId);
         }
 
-        if (mallocAndStrcpy_s(&handleData->correlationId, correlationId) != 0)
+        if (copy_message_string(handleData, &handleData->correlationId, correlationId) != 0)
         {
             /* Codes_SRS_IOTHUBMESSAGE_07_020: [If the allocation or the copying of the correlationId fails, then IoTHubMessage_SetCorrelationId shall return IOTHUB_MESSAGE_ERROR.] */
             result = IOTHUB_MESSAGE_ERROR;
@@ -682,12 +917,11 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMes
         /* Codes_SRS_IOTHUBMESSAGE_07_013: [If the IOTHUB_MESSAGE_HANDLE messageId is not NULL, then the IOTHUB_MESSAGE_HANDLE messageId will be freed] */
         if (handleData->messageId != NULL)
         {
-            free(handleData->messageId);
-            handleData->messageId = NULL;
+            release_message_string(handleData, &handleData->messageId);
         }
 
         /* Codes_SRS_IOTHUBMESSAGE_07_014: [If the allocation or the copying of the messageId fails, then IoTHubMessage_SetMessageId shall return IOTHUB_MESSAGE_ERROR.] */
-        if (mallocAndStrcpy_s(&handleData->messageId, messageId) != 0)
+        if (copy_message_string(handleData, &handleData->messageId, messageId) != 0)
         {
             result = IOTHUB_MESSAGE_ERROR;
         }
@@ -734,11 +968,10 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_
         // Codes_SRS_IOTHUBMESSAGE_09_002: [If the IOTHUB_MESSAGE_HANDLE `contentType` is not NULL it shall be deallocated.]
         if (handleData->userDefinedContentType != NULL)
         {
-            free(handleData->userDefinedContentType);
-            handleData->userDefinedContentType = NULL;
+            release_message_string(handleData, &handleData->userDefinedContentType);
         }
 
-        if (mallocAndStrcpy_s(&handleData->userDefinedContentType, contentType) != 0)
+        if (copy_message_string(handleData, &handleData->userDefinedContentType, contentType) != 0)
         {
             LogError("Failed saving a copy of contentType");
             // Codes_SRS_IOTHUBMESSAGE_09_003: [If the allocation or the copying of `contentType` fails, then IoTHubMessage_SetContentTypeSystemProperty shall return IOTHUB_MESSAGE_ERROR.]
@@ -998,11 +1231,10 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetOutputName(IOTHUB_MESSAGE_HANDLE iotHubMe
         // Codes_SRS_IOTHUBMESSAGE_31_037: [If the IOTHUB_MESSAGE_HANDLE OutputName is not NULL, then the IOTHUB_MESSAGE_HANDLE OutputName will be deallocated.]
         if (handleData->outputName != NULL)
         {
-            free(handleData->outputName);
-            handleData->outputName = NULL;
+            release_message_string(handleData, &handleData->outputName);
         }
 
-        if (mallocAndStrcpy_s(&handleData->outputName, outputName) != 0)
+        if (copy_message_string(handleData, &handleData->outputName, outputName) != 0)
         {
             // Codes_SRS_IOTHUBMESSAGE_31_038: [If the allocation or the copying of the OutputName fails, then IoTHubMessage_SetOutputName shall return IOTHUB_MESSAGE_ERROR.]
             LogError("Failed saving a copy of outputName");
@@ -1053,11 +1285,10 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetInputName(IOTHUB_MESSAGE_HANDLE iotHubMes
         // Codes_SRS_IOTHUBMESSAGE_31_043: [If the IOTHUB_MESSAGE_HANDLE InputName is not NULL, then the IOTHUB_MESSAGE_HANDLE InputName will be deallocated.]
         if (handleData->inputName != NULL)
         {
-            free(handleData->inputName);
-            handleData->inputName = NULL;
+            release_message_string(handleData, &handleData->inputName);
         }
 
-        if (mallocAndStrcpy_s(&handleData->inputName, inputName) != 0)
+        if (copy_message_string(handleData, &handleData->inputName, inputName) != 0)
         {
             // Codes_SRS_IOTHUBMESSAGE_31_044: [If the allocation or the copying of the InputName fails, then IoTHubMessage_SetInputName shall return IOTHUB_MESSAGE_ERROR.]
             LogError("Failed saving a copy of inputName");
@@ -1109,11 +1340,10 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetConnectionModuleId(IOTHUB_MESSAGE_HANDLE
         // Codes_SRS_IOTHUBMESSAGE_31_049: [If the IOTHUB_MESSAGE_HANDLE ConnectionModuleId is not NULL, then the IOTHUB_MESSAGE_HANDLE ConnectionModuleId will be deallocated.]
         if (handleData->connectionModuleId != NULL)
         {
-            free(handleData->connectionModuleId);
-            handleData->connectionModuleId = NULL;
+            release_message_string(handleData, &handleData->connectionModuleId);
         }
 
-        if (mallocAndStrcpy_s(&handleData->connectionModuleId, connectionModuleId) != 0)
+        if (copy_message_string(handleData, &handleData->connectionModuleId, connectionModuleId) != 0)
         {
             // Codes_SRS_IOTHUBMESSAGE_31_050: [If the allocation or the copying of the ConnectionModuleId fails, then IoTHubMessage_SetConnectionModuleId shall return IOTHUB_MESSAGE_ERROR.]
             LogError("Failed saving a copy of connectionModuleId");
@@ -1165,11 +1395,10 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetConnectionDeviceId(IOTHUB_MESSAGE_HANDLE
         // Codes_SRS_IOTHUBMESSAGE_31_055: [If the IOTHUB_MESSAGE_HANDLE ConnectionDeviceId is not NULL, then the IOTHUB_MESSAGE_HANDLE ConnectionDeviceId will be deallocated.]
         if (handleData->connectionDeviceId != NULL)
         {
-            free(handleData->connectionDeviceId);
-            handleData->connectionDeviceId = NULL;
+            release_message_string(handleData, &handleData->connectionDeviceId);
         }
 
-        if (mallocAndStrcpy_s(&handleData->connectionDeviceId, connectionDeviceId) != 0)
+        if (copy_message_string(handleData, &handleData->connectionDeviceId, connectionDeviceId) != 0)
         {
             // Codes_SRS_IOTHUBMESSAGE_31_056: [If the allocation or the copying of the ConnectionDeviceId fails, then IoTHubMessage_SetConnectionDeviceId shall return IOTHUB_MESSAGE_ERROR.]
             LogError("Failed saving a copy of connectionDeviceId");
@@ -1225,12 +1454,350 @@ bool IoTHubMessage_IsSecurityMessage(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
     return result;
 }
 
+static IOTHUB_MESSAGE_HANDLE_DATA* create_pooled_message(IOTHUB_MESSAGE_POOL* pool)
+{
+    /*the payload area is sized for the largest payload the pool accepts*/
+    IOTHUB_MESSAGE_HANDLE_DATA* result = allocate_message(MESSAGE_INLINE_STRINGS_SIZE, pool->max_payload_size);
+
+    if (result == NULL)
+    {
+        LogError("failed allocating a pooled message");
+    }
+    else if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+    {
+        LogError("Map_Create for properties failed");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->contentType = IOTHUBMESSAGE_BYTEARRAY;
+        result->pool = pool;
+    }
+
+    return result;
+}
+
+/*brings a pooled message back to the state it had when created, fails if it cannot (or should not) be reused*/
+static int reset_pooled_message(IOTHUB_MESSAGE_HANDLE_DATA* handleData, size_t max_properties)
+{
+    int result;
+    const char*const* keys;
+    const char*const* values;
+    size_t count;
+    char** strings[10];
+    size_t i;
+
+    strings[0] = &handleData->messageId;
+    strings[1] = &handleData->correlationId;
+    strings[2] = &handleData->userDefinedContentType;
+    strings[3] = &handleData->contentEncoding;
+    strings[4] = &handleData->outputName;
+    strings[5] = &handleData->inputName;
+    strings[6] = &handleData->connectionModuleId;
+    strings[7] = &handleData->connectionDeviceId;
+    strings[8] = &handleData->creationTimeUtc;
+    strings[9] = &handleData->userId;
+
+    for (i = 0; i < sizeof(strings) / sizeof(strings[0]); i++)
+    {
+        if (*strings[i] != NULL)
+        {
+            release_message_string(handleData, strings[i]);
+        }
+    }
+    handleData->string_arena_used = 0;
+    if (handleData->diagnosticData != NULL)
+    {
+        DestroyDiagnosticPropertyData(handleData->diagnosticData);
+        handleData->diagnosticData = NULL;
+    }
+    handleData->is_security_message = false;
+
+    if (Map_GetInternals(handleData->properties, &keys, &values, &count) != MAP_OK)
+    {
+        LogError("Map_GetInternals failed");
+        result = MU_FAILURE;
+    }
+    else if (count > max_properties)
+    {
+        /*a map grown past what the pool was sized for is not kept around*/
+        result = MU_FAILURE;
+    }
+    else if (count > 0)
+    {
+        /*the map owns a separate allocation per key and value, so it is swapped for an empty one;
+        Map_Delete would instead shrink (realloc) the map once per property*/
+        MAP_HANDLE properties = Map_Create(ValidateAsciiCharactersFilter);
+        if (properties == NULL)
+        {
+            LogError("failed clearing the properties of a pooled message");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            Map_Destroy(handleData->properties);
+            handleData->properties = properties;
+            result = 0;
+        }
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void free_message_pool(IOTHUB_MESSAGE_POOL* pool)
+{
+    Lock_Deinit(pool->lock);
+    free(pool);
+}
+
+static void release_pooled_message(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    IOTHUB_MESSAGE_POOL* pool = handleData->pool;
+    bool reusable = (reset_pooled_message(handleData, pool->max_properties) == 0);
+
+    if (Lock(pool->lock) != LOCK_OK)
+    {
+        /*the pool keeps counting the message, it is only leaked if the pool is destroyed*/
+        LogError("failed locking the message pool");
+        DestroyMessageData(handleData);
+    }
+    else
+    {
+        bool destroy_pool = false;
+
+        pool->statistics.inUse--;
+        if (reusable && !pool->is_destroyed)
+        {
+            handleData->next_free = pool->free_messages;
+            pool->free_messages = handleData;
+            handleData = NULL;
+        }
+        else
+        {
+            if (!reusable)
+            {
+                pool->statistics.discarded++;
+            }
+            pool->message_count--;
+            destroy_pool = (pool->is_destroyed && pool->message_count == 0);
+        }
+        (void)Unlock(pool->lock);
+
+        if (handleData != NULL)
+        {
+            DestroyMessageData(handleData);
+        }
+        if (destroy_pool)
+        {
+            free_message_pool(pool);
+        }
+    }
+}
+
+IOTHUB_MESSAGE_POOL_HANDLE IoTHubMessagePool_Create(size_t capacity, size_t maxPayloadSize, size_t maxProperties)
+{
+    IOTHUB_MESSAGE_POOL* result;
+
+    if (capacity == 0 || maxPayloadSize > (SIZE_MAX / 2))
+    {
+        LogError("Invalid argument (capacity=%lu, maxPayloadSize=%lu)", (unsigned long)capacity, (unsigned long)maxPayloadSize);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_MESSAGE_POOL*)malloc(sizeof(IOTHUB_MESSAGE_POOL))) == NULL)
+    {
+        LogError("failed allocating the message pool");
+    }
+    else
+    {
+        memset(result, 0, sizeof(IOTHUB_MESSAGE_POOL));
+        result->capacity = capacity;
+        result->max_payload_size = maxPayloadSize;
+        result->max_properties = maxProperties;
+
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            while (result->message_count < capacity)
+            {
+                IOTHUB_MESSAGE_HANDLE_DATA* message = create_pooled_message(result);
+                if (message == NULL)
+                {
+                    break;
+                }
+                message->next_free = result->free_messages;
+                result->free_messages = message;
+                result->message_count++;
+            }
+
+            if (result->message_count < capacity)
+            {
+                IoTHubMessagePool_Destroy(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessagePool_Acquire(IOTHUB_MESSAGE_POOL_HANDLE poolHandle, const unsigned char* byteArray, size_t size)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+
+    if (poolHandle == NULL || (byteArray == NULL && size != 0))
+    {
+        LogError("Invalid argument (poolHandle=%p, byteArray=%p, size=%lu)", poolHandle, byteArray, (unsigned long)size);
+        result = NULL;
+    }
+    else if (Lock(poolHandle->lock) != LOCK_OK)
+    {
+        LogError("failed locking the message pool");
+        result = NULL;
+    }
+    else
+    {
+        bool fits = (size <= poolHandle->max_payload_size);
+
+        result = NULL;
+        if (fits && poolHandle->free_messages != NULL)
+        {
+            result = poolHandle->free_messages;
+            poolHandle->free_messages = result->next_free;
+            result->next_free = NULL;
+            poolHandle->statistics.hits++;
+        }
+        else
+        {
+            poolHandle->statistics.misses++;
+            /*messages discarded on release are replaced here, so the pool goes back to its capacity*/
+            if (fits && poolHandle->message_count < poolHandle->capacity &&
+                (result = create_pooled_message(poolHandle)) != NULL)
+            {
+                poolHandle->message_count++;
+            }
+        }
+        if (result != NULL)
+        {
+            poolHandle->statistics.inUse++;
+        }
+        (void)Unlock(poolHandle->lock);
+
+        if (result != NULL)
+        {
+            unsigned char temp = 0x00;
+            set_inline_payload(result, (size == 0) ? &temp : byteArray, size);
+        }
+        else
+        {
+            /*a message that does not come from the pool is a plain message, destroying it frees it*/
+            result = IoTHubMessage_CreateFromByteArray(byteArray, size);
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessagePool_Release(IOTHUB_MESSAGE_POOL_HANDLE poolHandle, IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    IOTHUB_MESSAGE_RESULT result;
+
+    if (poolHandle == NULL || iotHubMessageHandle == NULL ||
+        (iotHubMessageHandle->pool != NULL && iotHubMessageHandle->pool != poolHandle))
+    {
+        LogError("Invalid argument (poolHandle=%p, iotHubMessageHandle=%p)", poolHandle, iotHubMessageHandle);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else
+    {
+        IoTHubMessage_Destroy(iotHubMessageHandle);
+        result = IOTHUB_MESSAGE_OK;
+    }
+
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessagePool_GetStatistics(IOTHUB_MESSAGE_POOL_HANDLE poolHandle, IOTHUB_MESSAGE_POOL_STATISTICS* statistics)
+{
+    IOTHUB_MESSAGE_RESULT result;
+
+    if (poolHandle == NULL || statistics == NULL)
+    {
+        LogError("Invalid argument (poolHandle=%p, statistics=%p)", poolHandle, statistics);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else if (Lock(poolHandle->lock) != LOCK_OK)
+    {
+        LogError("failed locking the message pool");
+        result = IOTHUB_MESSAGE_ERROR;
+    }
+    else
+    {
+        *statistics = poolHandle->statistics;
+        (void)Unlock(poolHandle->lock);
+        result = IOTHUB_MESSAGE_OK;
+    }
+
+    return result;
+}
+
+void IoTHubMessagePool_Destroy(IOTHUB_MESSAGE_POOL_HANDLE poolHandle)
+{
+    if (poolHandle == NULL)
+    {
+        LogError("Invalid argument (poolHandle=NULL)");
+    }
+    else if (Lock(poolHandle->lock) != LOCK_OK)
+    {
+        LogError("failed locking the message pool");
+    }
+    else
+    {
+        IOTHUB_MESSAGE_HANDLE_DATA* free_messages = poolHandle->free_messages;
+        bool destroy_pool;
+
+        poolHandle->free_messages = NULL;
+        poolHandle->is_destroyed = true;
+        while (free_messages != NULL)
+        {
+            IOTHUB_MESSAGE_HANDLE_DATA* next = free_messages->next_free;
+            DestroyMessageData(free_messages);
+            poolHandle->message_count--;
+            free_messages = next;
+        }
+        /*acquired messages keep the pool alive, the last one released frees it*/
+        destroy_pool = (poolHandle->message_count == 0);
+        (void)Unlock(poolHandle->lock);
+
+        if (destroy_pool)
+        {
+            free_message_pool(poolHandle);
+        }
+    }
+}
+
 void IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
 {
     /*Codes_SRS_IOTHUBMESSAGE_01_004: [If iotHubMessageHandle is NULL, IoTHubMessage_Destroy shall do nothing.] */
     if (iotHubMessageHandle != NULL)
     {
-        /*Codes_SRS_IOTHUBMESSAGE_01_003: [IoTHubMessage_Destroy shall free all resources associated with iotHubMessageHandle.]  */
-        DestroyMessageData((IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle);
+        if (iotHubMessageHandle->pool != NULL)
+        {
+            release_pooled_message((IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle);
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_01_003: [IoTHubMessage_Destroy shall free all resources associated with iotHubMessageHandle.]  */
+            DestroyMessageData((IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle);
+        }
     }
 }
@@ -4,13 +4,16 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/optimize_size.h"
 #include "internal/iothubtransport.h"
 #include "iothub_client_core.h"
 #include "internal/iothub_client_private.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/vector.h"
 
@@ -19,6 +22,26 @@
 #include "iothub_transport_ll.h"
 #include "iothub_client_core.h"
 
+/*an idle client worker re-checks its stripe this often; the transport worker requests work after each DoWork anyway*/
+#define CLIENT_WORKER_MAX_WAIT_MS 1000
+
+/*a client worker thread and the share ("stripe") of the multiplexed clients it runs*/
+typedef struct CLIENT_STRIPE_TAG
+{
+    IOTHUB_CLIENT_MULTIPLEXED_DO_WORK clientDoWork;
+    THREAD_HANDLE threadHandle;
+    /*guards clients, and is held while their work runs just like clientsLockHandle in the single threaded mode*/
+    LOCK_HANDLE clientsLockHandle;
+    VECTOR_HANDLE clients;
+    /*number of clients in the stripe, only changed with the transport clientsLockHandle held*/
+    size_t clientCount;
+    /*guards workPending and stopThread, and is never held while client work runs*/
+    LOCK_HANDLE signalLockHandle;
+    COND_HANDLE workRequested;
+    bool workPending;
+    bool stopThread;
+} CLIENT_STRIPE;
+
 typedef struct TRANSPORT_HANDLE_DATA_TAG
 {
     TRANSPORT_LL_HANDLE transportLLHandle;
@@ -29,10 +52,14 @@ typedef struct TRANSPORT_HANDLE_DATA_TAG
     VECTOR_HANDLE clients;
     LOCK_HANDLE clientsLockHandle;
     IOTHUB_CLIENT_MULTIPLEXED_DO_WORK clientDoWork;
+    size_t clientWorkerCount;
+    CLIENT_STRIPE* clientStripes;
 } TRANSPORT_HANDLE_DATA;
 
 /* Used for Unit test */
 const size_t IoTHubTransport_ThreadTerminationOffset = offsetof(TRANSPORT_HANDLE_DATA, stopThread);
+const size_t IoTHubTransport_ClientWorkerTerminationOffset = offsetof(CLIENT_STRIPE, stopThread);
+const size_t IoTHubTransport_ClientWorkerPendingOffset = offsetof(CLIENT_STRIPE, workPending);
 
 TRANSPORT_HANDLE IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix)
 {
@@ -126,6 +153,8 @@ TRANSPORT_HANDLE IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoco
                         /*Codes_SRS_IOTHUBTRANSPORT_17_001: [ IoTHubTransport_Create shall return a non-NULL handle on success.]*/
                         result->stopThread = 1;
                         result->clientDoWork = NULL;
+                        result->clientWorkerCount = 0;
+                        result->clientStripes = NULL;
                         result->workerThreadHandle = NULL; /* create thread when work needs to be done */
                         result->IoTHubTransport_GetHostname = transportProtocol->IoTHubTransport_GetHostname;
                         result->IoTHubTransport_SetOption = transportProtocol->IoTHubTransport_SetOption;
@@ -147,6 +176,14 @@ TRANSPORT_HANDLE IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoco
     return result;
 }
 
+static bool find_by_handle(const void* element, const void* value)
+{
+    /* data stored at element is device handle */
+    const IOTHUB_CLIENT_CORE_HANDLE * guess = (const IOTHUB_CLIENT_CORE_HANDLE *)element;
+    const IOTHUB_CLIENT_CORE_HANDLE match = (const IOTHUB_CLIENT_CORE_HANDLE)value;
+    return (*guess == match);
+}
+
 static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
 {
     if (Lock(transportData->clientsLockHandle) != LOCK_OK)
@@ -176,6 +213,315 @@ static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
     }
 }
 
+static void run_stripe_clients(CLIENT_STRIPE* stripe)
+{
+    if (Lock(stripe->clientsLockHandle) != LOCK_OK)
+    {
+        LogError("failed to lock for run_stripe_clients");
+    }
+    else
+    {
+        size_t numberOfClients;
+        size_t iterator;
+
+        numberOfClients = VECTOR_size(stripe->clients);
+        for (iterator = 0; iterator < numberOfClients; iterator++)
+        {
+            IOTHUB_CLIENT_CORE_HANDLE* clientHandle = (IOTHUB_CLIENT_CORE_HANDLE*)VECTOR_element(stripe->clients, iterator);
+
+            if (clientHandle != NULL)
+            {
+                stripe->clientDoWork(*clientHandle);
+            }
+        }
+
+        if (Unlock(stripe->clientsLockHandle) != LOCK_OK)
+        {
+            LogError("failed to unlock on run_stripe_clients");
+        }
+    }
+}
+
+static int client_worker_thread(void* threadArgument)
+{
+    CLIENT_STRIPE* stripe = (CLIENT_STRIPE*)threadArgument;
+
+    while (1)
+    {
+        bool runClients;
+
+        if (Lock(stripe->signalLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock for client_worker_thread");
+            break;
+        }
+
+        if (!stripe->workPending && !stripe->stopThread)
+        {
+            (void)Condition_Wait(stripe->workRequested, stripe->signalLockHandle, CLIENT_WORKER_MAX_WAIT_MS);
+        }
+
+        if (stripe->stopThread)
+        {
+            (void)Unlock(stripe->signalLockHandle);
+            break;
+        }
+
+        /*requests made while the clients run collapse into one more pass*/
+        runClients = stripe->workPending;
+        stripe->workPending = false;
+        (void)Unlock(stripe->signalLockHandle);
+
+        if (runClients)
+        {
+            run_stripe_clients(stripe);
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+/*wakes up every client worker after the lower layer transport DoWork, in place of running the clients on the transport worker thread*/
+static void request_client_work(TRANSPORT_HANDLE_DATA* transportData)
+{
+    size_t index;
+
+    for (index = 0; index < transportData->clientWorkerCount; index++)
+    {
+        CLIENT_STRIPE* stripe = &transportData->clientStripes[index];
+
+        if (Lock(stripe->signalLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock for request_client_work");
+        }
+        else
+        {
+            stripe->workPending = true;
+            (void)Condition_Post(stripe->workRequested);
+            (void)Unlock(stripe->signalLockHandle);
+        }
+    }
+}
+
+static void destroy_client_stripe(CLIENT_STRIPE* stripe)
+{
+    if (stripe->threadHandle != NULL)
+    {
+        int res;
+
+        if (Lock(stripe->signalLockHandle) != LOCK_OK)
+        {
+            LogError("Unable to lock - will still attempt to end client worker without thread safety");
+            stripe->stopThread = true;
+        }
+        else
+        {
+            stripe->stopThread = true;
+            (void)Condition_Post(stripe->workRequested);
+            (void)Unlock(stripe->signalLockHandle);
+        }
+
+        if (ThreadAPI_Join(stripe->threadHandle, &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for client worker");
+        }
+    }
+    if (stripe->workRequested != NULL)
+    {
+        Condition_Deinit(stripe->workRequested);
+    }
+    if (stripe->signalLockHandle != NULL)
+    {
+        Lock_Deinit(stripe->signalLockHandle);
+    }
+    if (stripe->clients != NULL)
+    {
+        VECTOR_destroy(stripe->clients);
+    }
+    if (stripe->clientsLockHandle != NULL)
+    {
+        Lock_Deinit(stripe->clientsLockHandle);
+    }
+}
+
+static void destroy_client_stripes(TRANSPORT_HANDLE_DATA* transportData)
+{
+    if (transportData->clientStripes != NULL)
+    {
+        size_t index;
+
+        for (index = 0; index < transportData->clientWorkerCount; index++)
+        {
+            destroy_client_stripe(&transportData->clientStripes[index]);
+        }
+        free(transportData->clientStripes);
+        transportData->clientStripes = NULL;
+    }
+}
+
+static int create_client_stripe(CLIENT_STRIPE* stripe, IOTHUB_CLIENT_MULTIPLEXED_DO_WORK clientDoWork)
+{
+    int result;
+
+    memset(stripe, 0, sizeof(CLIENT_STRIPE));
+    stripe->clientDoWork = clientDoWork;
+
+    if ((stripe->clientsLockHandle = Lock_Init()) == NULL)
+    {
+        LogError("client worker clients Lock not created.");
+        result = MU_FAILURE;
+    }
+    else if ((stripe->clients = VECTOR_create(sizeof(IOTHUB_CLIENT_CORE_HANDLE))) == NULL)
+    {
+        LogError("client worker clients list not created.");
+        result = MU_FAILURE;
+    }
+    else if ((stripe->signalLockHandle = Lock_Init()) == NULL)
+    {
+        LogError("client worker signal Lock not created.");
+        result = MU_FAILURE;
+    }
+    else if ((stripe->workRequested = Condition_Init()) == NULL)
+    {
+        LogError("client worker condition not created.");
+        result = MU_FAILURE;
+    }
+    else if (ThreadAPI_Create(&stripe->threadHandle, client_worker_thread, stripe) != THREADAPI_OK)
+    {
+        LogError("client worker thread not created.");
+        stripe->threadHandle = NULL;
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    if (result != 0)
+    {
+        destroy_client_stripe(stripe);
+    }
+
+    return result;
+}
+
+static int create_client_stripes(TRANSPORT_HANDLE_DATA* transportData)
+{
+    int result;
+
+    if (transportData->clientWorkerCount > (SIZE_MAX / sizeof(CLIENT_STRIPE)))
+    {
+        LogError("Too many client workers (%lu)", (unsigned long)transportData->clientWorkerCount);
+        result = MU_FAILURE;
+    }
+    else if ((transportData->clientStripes = (CLIENT_STRIPE*)malloc(transportData->clientWorkerCount * sizeof(CLIENT_STRIPE))) == NULL)
+    {
+        LogError("client workers were not allocated.");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        size_t index;
+
+        for (index = 0; index < transportData->clientWorkerCount; index++)
+        {
+            if (create_client_stripe(&transportData->clientStripes[index], transportData->clientDoWork) != 0)
+            {
+                break;
+            }
+        }
+
+        if (index < transportData->clientWorkerCount)
+        {
+            size_t created;
+
+            for (created = 0; created < index; created++)
+            {
+                destroy_client_stripe(&transportData->clientStripes[created]);
+            }
+            free(transportData->clientStripes);
+            transportData->clientStripes = NULL;
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/*adds the client to the stripe with the fewest clients. Called with the transport clientsLockHandle held.*/
+static int add_client_to_stripe(TRANSPORT_HANDLE_DATA* transportData, IOTHUB_CLIENT_CORE_HANDLE clientHandle)
+{
+    int result;
+    CLIENT_STRIPE* stripe = &transportData->clientStripes[0];
+    size_t index;
+
+    for (index = 1; index < transportData->clientWorkerCount; index++)
+    {
+        if (transportData->clientStripes[index].clientCount < stripe->clientCount)
+        {
+            stripe = &transportData->clientStripes[index];
+        }
+    }
+
+    if (Lock(stripe->clientsLockHandle) != LOCK_OK)
+    {
+        LogError("failed to lock for add_client_to_stripe");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        if (VECTOR_push_back(stripe->clients, &clientHandle, 1) != 0)
+        {
+            LogError("Failed adding device to client worker (VECTOR_push_back failed)");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            stripe->clientCount++;
+            result = 0;
+        }
+        (void)Unlock(stripe->clientsLockHandle);
+    }
+
+    return result;
+}
+
+/*once this returns no client worker runs the client anymore. Called with the transport clientsLockHandle held.*/
+static void remove_client_from_stripe(TRANSPORT_HANDLE_DATA* transportData, IOTHUB_CLIENT_CORE_HANDLE clientHandle)
+{
+    size_t index;
+
+    for (index = 0; index < transportData->clientWorkerCount; index++)
+    {
+        CLIENT_STRIPE* stripe = &transportData->clientStripes[index];
+
+        if (Lock(stripe->clientsLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock for remove_client_from_stripe");
+        }
+        else
+        {
+            void* element = VECTOR_find_if(stripe->clients, find_by_handle, clientHandle);
+            if (element != NULL)
+            {
+                VECTOR_erase(stripe->clients, element, 1);
+                stripe->clientCount--;
+            }
+            (void)Unlock(stripe->clientsLockHandle);
+
+            if (element != NULL)
+            {
+                break;
+            }
+        }
+    }
+}
+
 static int transport_worker_thread(void* threadArgument)
 {
     TRANSPORT_HANDLE_DATA* transportData = (TRANSPORT_HANDLE_DATA*)threadArgument;
@@ -200,7 +546,14 @@ static int transport_worker_thread(void* threadArgument)
             }
         }
 
-        multiplexed_client_do_work(transportData);
+        if (transportData->clientStripes != NULL)
+        {
+            request_client_work(transportData);
+        }
+        else
+        {
+            multiplexed_client_do_work(transportData);
+        }
 
         /*Codes_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]*/
         ThreadAPI_Sleep(1);
@@ -210,14 +563,6 @@ static int transport_worker_thread(void* threadArgument)
     return 0;
 }
 
-static bool find_by_handle(const void* element, const void* value)
-{
-    /* data stored at element is device handle */
-    const IOTHUB_CLIENT_CORE_HANDLE * guess = (const IOTHUB_CLIENT_CORE_HANDLE *)element;
-    const IOTHUB_CLIENT_CORE_HANDLE match = (const IOTHUB_CLIENT_CORE_HANDLE)value;
-    return (*guess == match);
-}
-
 static IOTHUB_CLIENT_RESULT start_worker_if_needed(TRANSPORT_HANDLE_DATA * transportData, IOTHUB_CLIENT_CORE_HANDLE clientHandle)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -225,9 +570,14 @@ static IOTHUB_CLIENT_RESULT start_worker_if_needed(TRANSPORT_HANDLE_DATA * trans
     {
         /*Codes_SRS_IOTHUBTRANSPORT_17_018: [ If the worker thread does not exist, IoTHubTransport_StartWorkerThread shall start the thread using ThreadAPI_Create. ]*/
         transportData->stopThread = 0;
-        if (ThreadAPI_Create(&transportData->workerThreadHandle, transport_worker_thread, transportData) != THREADAPI_OK)
+        if (transportData->clientWorkerCount > 0 && create_client_stripes(transportData) != 0)
+        {
+            LogError("Unable to start the client workers");
+        }
+        else if (ThreadAPI_Create(&transportData->workerThreadHandle, transport_worker_thread, transportData) != THREADAPI_OK)
         {
             transportData->workerThreadHandle = NULL;
+            destroy_client_stripes(transportData);
         }
     }
     if (transportData->workerThreadHandle != NULL)
@@ -250,6 +600,11 @@ static IOTHUB_CLIENT_RESULT start_worker_if_needed(TRANSPORT_HANDLE_DATA * trans
                     /*Codes_SRS_IOTHUBTRANSPORT_17_042: [ If Adding to the client list fails, IoTHubTransport_StartWorkerThread shall return IOTHUB_CLIENT_ERROR. ]*/
                     result = IOTHUB_CLIENT_ERROR;
                 }
+                else if (transportData->clientStripes != NULL && add_client_to_stripe(transportData, clientHandle) != 0)
+                {
+                    VECTOR_erase(transportData->clients, VECTOR_back(transportData->clients), 1);
+                    result = IOTHUB_CLIENT_ERROR;
+                }
                 else
                 {
                     result = IOTHUB_CLIENT_OK;
@@ -304,6 +659,8 @@ static void wait_worker_thread(TRANSPORT_HANDLE_DATA * transportData)
         else
         {
             transportData->workerThreadHandle = NULL;
+            /*the client workers are only woken up by the transport worker thread, so they go away with it*/
+            destroy_client_stripes(transportData);
         }
     }
 }
@@ -324,6 +681,11 @@ static bool signal_end_worker_thread(TRANSPORT_HANDLE_DATA * transportData, IOTH
         {
             /*Codes_SRS_IOTHUBTRANSPORT_17_026: [ IoTHubTransport_EndWorkerThread shall remove clientHandlehandle from handle list. ]*/
             VECTOR_erase(transportData->clients, element, 1);
+
+            if (transportData->clientStripes != NULL)
+            {
+                remove_client_from_stripe(transportData, clientHandle);
+            }
         }
         /*Codes_SRS_IOTHUBTRANSPORT_17_025: [ If the worker thread does not exist, then IoTHubTransport_EndWorkerThread shall return. ]*/
         if (transportData->workerThreadHandle != NULL)
@@ -360,6 +722,7 @@ void IoTHubTransport_Destroy(TRANSPORT_HANDLE transportHandle)
         /*Codes_SRS_IOTHUBTRANSPORT_17_033: [ IoTHubTransport_Destroy shall lock the transport lock. ]*/
         stop_worker_thread(transportData);
         wait_worker_thread(transportData);
+        destroy_client_stripes(transportData);
         /*Codes_SRS_IOTHUBTRANSPORT_17_010: [ IoTHubTransport_Destroy shall free all resources. ]*/
         Lock_Deinit(transportData->lockHandle);
         (transportData->IoTHubTransport_Destroy)(transportData->transportLLHandle);
@@ -369,6 +732,47 @@ void IoTHubTransport_Destroy(TRANSPORT_HANDLE transportHandle)
     }
 }
 
+int IoTHubTransport_SetClientWorkerCount(TRANSPORT_HANDLE transportHandle, size_t workerCount)
+{
+    int result;
+
+    if (transportHandle == NULL)
+    {
+        LogError("Invalid NULL argument, transportHandle");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+
+        if (Lock(transportData->clientsLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock for IoTHubTransport_SetClientWorkerCount");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            if (transportData->workerThreadHandle != NULL)
+            {
+                LogError("The client workers cannot be changed once a client started using the transport");
+                result = MU_FAILURE;
+            }
+            else
+            {
+                transportData->clientWorkerCount = workerCount;
+                result = 0;
+            }
+
+            if (Unlock(transportData->clientsLockHandle) != LOCK_OK)
+            {
+                LogError("failed to unlock on IoTHubTransport_SetClientWorkerCount");
+            }
+        }
+    }
+
+    return result;
+}
+
 LOCK_HANDLE IoTHubTransport_GetLock(TRANSPORT_HANDLE transportHandle)
 {
     LOCK_HANDLE lock;
@@ -44,6 +44,13 @@ typedef struct AUTHENTICATION_INSTANCE_TAG
     // with either SAS Token, x509 Certs, and Device SAS Token
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;
     ASYNC_OPERATION_HANDLE cbs_put_token_async_context;
+
+    // Shared by the devices on the same CBS link; NULL if each device puts and refreshes its token on its own.
+    CBS_SCHEDULER_HANDLE cbs_scheduler;
+    bool is_put_token_scheduled;
+    tickcounter_ms_t put_token_start_time;
+    bool is_sas_token_refresh_scheduled;
+    uint64_t sas_token_refresh_delay_secs;
 } AUTHENTICATION_INSTANCE;
 
 
@@ -71,6 +78,42 @@ static void notify_error(AUTHENTICATION_INSTANCE* instance, AUTHENTICATION_ERROR
     }
 }
 
+// Takes a place among the put-tokens in flight on the CBS link; without a scheduler there is always one.
+static bool begin_put_token(AUTHENTICATION_INSTANCE* instance)
+{
+    bool result;
+
+    if (instance->cbs_scheduler == NULL)
+    {
+        result = true;
+    }
+    else if (instance->is_put_token_scheduled)
+    {
+        // The place taken for the previous attempt has not been given back yet; it is not taken twice.
+        result = true;
+    }
+    else if (!cbs_scheduler_begin_put_token(instance->cbs_scheduler, &instance->put_token_start_time))
+    {
+        result = false;
+    }
+    else
+    {
+        instance->is_put_token_scheduled = true;
+        result = true;
+    }
+
+    return result;
+}
+
+static void end_put_token(AUTHENTICATION_INSTANCE* instance, bool succeeded)
+{
+    if (instance->is_put_token_scheduled)
+    {
+        instance->is_put_token_scheduled = false;
+        cbs_scheduler_end_put_token(instance->cbs_scheduler, instance->put_token_start_time, succeeded);
+    }
+}
+
 static int verify_cbs_put_token_timeout(AUTHENTICATION_INSTANCE* instance, bool* is_timed_out)
 {
     int result;
@@ -128,14 +171,24 @@ static int verify_sas_token_refresh_timeout(AUTHENTICATION_INSTANCE* instance, b
             result = MU_FAILURE;
             LogError("Failed verifying if SAS token refresh timed out (get_time failed)");
         }
-        else if ((uint64_t)get_difftime(current_time, instance->current_sas_token_put_time) >= (sas_token_expiry*SAS_REFRESH_MULTIPLIER))
-        {
-            *is_timed_out = true;
-            result = RESULT_OK;
-        }
         else
         {
-            *is_timed_out = false;
+            uint64_t secs_since_put = (uint64_t)get_difftime(current_time, instance->current_sas_token_put_time);
+            double refresh_after_secs = sas_token_expiry*SAS_REFRESH_MULTIPLIER;
+
+            if (instance->cbs_scheduler != NULL)
+            {
+                // The scheduler spreads the refreshes of the devices on the CBS link; each token asks for its slot once.
+                if (!instance->is_sas_token_refresh_scheduled)
+                {
+                    instance->sas_token_refresh_delay_secs = cbs_scheduler_get_refresh_delay(instance->cbs_scheduler, secs_since_put, sas_token_expiry);
+                    instance->is_sas_token_refresh_scheduled = true;
+                }
+
+                refresh_after_secs = (double)instance->sas_token_refresh_delay_secs;
+            }
+
+            *is_timed_out = (secs_since_put >= refresh_after_secs);
             result = RESULT_OK;
         }
     }
@@ -173,6 +226,8 @@ static void on_cbs_put_token_complete_callback(void* context, CBS_OPERATION_RESU
 
     instance->cbs_put_token_async_context = NULL;
 
+    end_put_token(instance, operation_result == CBS_OPERATION_RESULT_OK);
+
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_095: [`instance->is_sas_token_refresh_in_progress` and `instance->is_cbs_put_token_in_progress` shall be set to FALSE]
     instance->is_cbs_put_token_in_progress = false;
 
@@ -247,6 +302,7 @@ static int put_SAS_token_to_cbs(AUTHENTICATION_INSTANCE* instance, STRING_HANDLE
             }
 
             instance->current_sas_token_put_time = current_time; // If it failed, fear not. `current_sas_token_put_time` shall be checked for INDEFINITE_TIME wherever it is used.
+            instance->is_sas_token_refresh_scheduled = false;
 
             result = RESULT_OK;
         }
@@ -472,6 +528,9 @@ int authentication_stop(AUTHENTICATION_HANDLE authentication_handle)
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_033: [`instance->cbs_handle` shall be set to NULL]
             instance->cbs_handle = NULL;
 
+            // A put-token left unanswered by the stopped CBS link no longer holds a place among those in flight.
+            end_put_token(instance, false);
+
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_034: [`instance->state` shall be set to AUTHENTICATION_STATE_STOPPED and `instance->on_state_changed_callback` invoked]
             update_state(instance, AUTHENTICATION_STATE_STOPPED);
 
@@ -509,6 +568,13 @@ void authentication_destroy(AUTHENTICATION_HANDLE authentication_handle)
             async_operation_cancel(instance->cbs_put_token_async_context);
         }
 
+        end_put_token(instance, false);
+
+        if (instance->cbs_scheduler != NULL)
+        {
+            cbs_scheduler_remove_device(instance->cbs_scheduler);
+        }
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_108: [authentication_destroy() shall destroy all resouces used by this module]
         free(instance);
     }
@@ -590,6 +656,12 @@ AUTHENTICATION_HANDLE authentication_create(const AUTHENTICATION_CONFIG* config)
 
                 instance->authorization_module = config->authorization_module;
 
+                if (config->cbs_scheduler != NULL)
+                {
+                    instance->cbs_scheduler = config->cbs_scheduler;
+                    cbs_scheduler_add_device(instance->cbs_scheduler);
+                }
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_024: [If no failure occurs, authentication_create() shall return a reference to the AUTHENTICATION_INSTANCE handle]
                 result = (AUTHENTICATION_HANDLE)instance;
             }
@@ -626,6 +698,7 @@ void authentication_do_work(AUTHENTICATION_HANDLE authentication_handle)
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_085: [`instance->is_cbs_put_token_in_progress` shall be set to FALSE]
                 instance->is_cbs_put_token_in_progress = false;
+                end_put_token(instance, false);
 
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_086: [`instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
                 update_state(instance, AUTHENTICATION_STATE_ERROR);
@@ -653,8 +726,9 @@ void authentication_do_work(AUTHENTICATION_HANDLE authentication_handle)
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_039: [If `instance->state` is AUTHENTICATION_STATE_STARTED and device keys were used, authentication_do_work() shall only verify the SAS token refresh time]
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_066: [If SAS token does not need to be refreshed, authentication_do_work() shall return]
+                // A refresh that is due waits in DoWork while the put-tokens in flight on the CBS link are at their limit.
                 bool is_timed_out;
-                if (verify_sas_token_refresh_timeout(instance, &is_timed_out) == RESULT_OK && is_timed_out)
+                if (verify_sas_token_refresh_timeout(instance, &is_timed_out) == RESULT_OK && is_timed_out && begin_put_token(instance))
                 {
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_119: [authentication_do_work() shall set `instance->is_sas_token_refresh_in_progress` to TRUE]
                     instance->is_sas_token_refresh_in_progress = true;
@@ -669,6 +743,8 @@ void authentication_do_work(AUTHENTICATION_HANDLE authentication_handle)
 
                     if (!instance->is_cbs_put_token_in_progress)
                     {
+                        end_put_token(instance, false);
+
                         // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_120: [If cbs_put_token() fails, `instance->is_sas_token_refresh_in_progress` shall be set to FALSE]
                         instance->is_sas_token_refresh_in_progress = false;
 
@@ -683,20 +759,29 @@ void authentication_do_work(AUTHENTICATION_HANDLE authentication_handle)
         }
         else if (instance->state == AUTHENTICATION_STATE_STARTING)
         {
-            if (create_and_put_SAS_token_to_cbs(instance) != RESULT_OK)
+            if (!begin_put_token(instance))
             {
-                LogError("Failed authenticating device '%s' using device keys", instance->device_id);
+                // Waits for one of the put-tokens in flight on the CBS link to complete.
             }
-
-            if (!instance->is_cbs_put_token_in_progress)
+            else
             {
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_061: [If cbs_put_token() fails, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_121: [If cbs_put_token() fails, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
-                update_state(instance, AUTHENTICATION_STATE_ERROR);
+                if (create_and_put_SAS_token_to_cbs(instance) != RESULT_OK)
+                {
+                    LogError("Failed authenticating device '%s' using device keys", instance->device_id);
+                }
+
+                if (!instance->is_cbs_put_token_in_progress)
+                {
+                    end_put_token(instance, false);
+
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_061: [If cbs_put_token() fails, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_121: [If cbs_put_token() fails, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
+                    update_state(instance, AUTHENTICATION_STATE_ERROR);
 
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_062: [If cbs_put_token() fails, `instance->on_error_callback` shall be invoked with AUTHENTICATION_ERROR_AUTH_FAILED]
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_122: [If cbs_put_token() fails, `instance->on_error_callback` shall be invoked with AUTHENTICATION_ERROR_AUTH_FAILED]
-                notify_error(instance, AUTHENTICATION_ERROR_AUTH_FAILED);
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_062: [If cbs_put_token() fails, `instance->on_error_callback` shall be invoked with AUTHENTICATION_ERROR_AUTH_FAILED]
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_122: [If cbs_put_token() fails, `instance->on_error_callback` shall be invoked with AUTHENTICATION_ERROR_AUTH_FAILED]
+                    notify_error(instance, AUTHENTICATION_ERROR_AUTH_FAILED);
+                }
             }
         }
         else
@@ -0,0 +1,314 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "internal/iothubtransport_amqp_cbs_scheduler.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#define RESULT_OK                                 0
+// Fractions of the SAS token lifetime between which its refresh is scheduled; the end is where it is refreshed without a scheduler.
+#define REFRESH_WINDOW_START                      .5
+#define REFRESH_WINDOW_END                        .8
+
+typedef struct CBS_SCHEDULER_INSTANCE_TAG
+{
+    TICK_COUNTER_HANDLE tick_counter;
+    size_t device_count;
+    size_t max_put_tokens_in_flight;
+
+    bool has_refresh_time;
+    tickcounter_ms_t last_refresh_time;                                 // The latest refresh slot handed out.
+
+    IOTHUB_AMQP_CBS_STATISTICS statistics;
+} CBS_SCHEDULER_INSTANCE;
+
+static void record_put_token_latency(CBS_SCHEDULER_INSTANCE* instance, tickcounter_ms_t start_time)
+{
+    tickcounter_ms_t current_time;
+
+    if (tickcounter_get_current_ms(instance->tick_counter, &current_time) != 0)
+    {
+        LogError("Failed recording the CBS put-token latency (tickcounter_get_current_ms failed)");
+    }
+    else
+    {
+        tickcounter_ms_t latency_ms = (current_time > start_time) ? (current_time - start_time) : 0;
+        size_t bucket = 0;
+
+        while (bucket < (IOTHUB_AMQP_CBS_LATENCY_BUCKET_COUNT - 1) &&
+            latency_ms >= ((tickcounter_ms_t)IOTHUB_AMQP_CBS_LATENCY_FIRST_BUCKET_MS << bucket))
+        {
+            bucket++;
+        }
+        instance->statistics.put_token_latency_ms[bucket]++;
+    }
+}
+
+static uint64_t get_put_token_latency_percentile(const IOTHUB_AMQP_CBS_STATISTICS* statistics, size_t latency_count, size_t percent)
+{
+    uint64_t result;
+
+    if (latency_count == 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        // The round trip at this rank (from the fastest) is the percentile.
+        size_t rank = (latency_count * percent + 99) / 100;
+        size_t counted = 0;
+        size_t bucket;
+
+        for (bucket = 0; bucket < (IOTHUB_AMQP_CBS_LATENCY_BUCKET_COUNT - 1); bucket++)
+        {
+            counted += statistics->put_token_latency_ms[bucket];
+
+            if (counted >= rank)
+            {
+                break;
+            }
+        }
+
+        result = (bucket < (IOTHUB_AMQP_CBS_LATENCY_BUCKET_COUNT - 1)) ?
+            ((uint64_t)IOTHUB_AMQP_CBS_LATENCY_FIRST_BUCKET_MS << bucket) :
+            ((uint64_t)IOTHUB_AMQP_CBS_LATENCY_FIRST_BUCKET_MS << (IOTHUB_AMQP_CBS_LATENCY_BUCKET_COUNT - 2));
+    }
+
+    return result;
+}
+
+CBS_SCHEDULER_HANDLE cbs_scheduler_create(void)
+{
+    CBS_SCHEDULER_INSTANCE* result;
+
+    if ((result = (CBS_SCHEDULER_INSTANCE*)malloc(sizeof(CBS_SCHEDULER_INSTANCE))) == NULL)
+    {
+        LogError("Failed creating the CBS scheduler (malloc failed)");
+    }
+    else
+    {
+        memset(result, 0, sizeof(CBS_SCHEDULER_INSTANCE));
+
+        if ((result->tick_counter = tickcounter_create()) == NULL)
+        {
+            LogError("Failed creating the CBS scheduler (tickcounter_create failed)");
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return (CBS_SCHEDULER_HANDLE)result;
+}
+
+void cbs_scheduler_destroy(CBS_SCHEDULER_HANDLE scheduler)
+{
+    if (scheduler == NULL)
+    {
+        LogError("cbs_scheduler_destroy failed (scheduler is NULL)");
+    }
+    else
+    {
+        CBS_SCHEDULER_INSTANCE* instance = (CBS_SCHEDULER_INSTANCE*)scheduler;
+
+        tickcounter_destroy(instance->tick_counter);
+        free(instance);
+    }
+}
+
+int cbs_scheduler_set_max_put_tokens_in_flight(CBS_SCHEDULER_HANDLE scheduler, size_t max_put_tokens_in_flight)
+{
+    int result;
+
+    if (scheduler == NULL)
+    {
+        LogError("cbs_scheduler_set_max_put_tokens_in_flight failed (scheduler is NULL)");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        ((CBS_SCHEDULER_INSTANCE*)scheduler)->max_put_tokens_in_flight = max_put_tokens_in_flight;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+void cbs_scheduler_add_device(CBS_SCHEDULER_HANDLE scheduler)
+{
+    if (scheduler == NULL)
+    {
+        LogError("cbs_scheduler_add_device failed (scheduler is NULL)");
+    }
+    else
+    {
+        ((CBS_SCHEDULER_INSTANCE*)scheduler)->device_count++;
+    }
+}
+
+void cbs_scheduler_remove_device(CBS_SCHEDULER_HANDLE scheduler)
+{
+    if (scheduler == NULL)
+    {
+        LogError("cbs_scheduler_remove_device failed (scheduler is NULL)");
+    }
+    else
+    {
+        CBS_SCHEDULER_INSTANCE* instance = (CBS_SCHEDULER_INSTANCE*)scheduler;
+
+        if (instance->device_count > 0)
+        {
+            instance->device_count--;
+        }
+    }
+}
+
+uint64_t cbs_scheduler_get_refresh_delay(CBS_SCHEDULER_HANDLE scheduler, uint64_t secs_since_put, uint64_t token_lifetime_secs)
+{
+    uint64_t result;
+    tickcounter_ms_t current_time;
+
+    if (scheduler == NULL)
+    {
+        LogError("cbs_scheduler_get_refresh_delay failed (scheduler is NULL)");
+        result = (uint64_t)(token_lifetime_secs * REFRESH_WINDOW_END);
+    }
+    else if (tickcounter_get_current_ms(((CBS_SCHEDULER_INSTANCE*)scheduler)->tick_counter, &current_time) != 0)
+    {
+        LogError("Failed scheduling the SAS token refresh (tickcounter_get_current_ms failed)");
+        result = (uint64_t)(token_lifetime_secs * REFRESH_WINDOW_END);
+    }
+    else
+    {
+        CBS_SCHEDULER_INSTANCE* instance = (CBS_SCHEDULER_INSTANCE*)scheduler;
+        tickcounter_ms_t since_put_ms = (tickcounter_ms_t)secs_since_put * 1000;
+        tickcounter_ms_t put_time = (current_time > since_put_ms) ? (current_time - since_put_ms) : 0;
+        tickcounter_ms_t window_start = put_time + (tickcounter_ms_t)(token_lifetime_secs * REFRESH_WINDOW_START * 1000);
+        tickcounter_ms_t window_end = put_time + (tickcounter_ms_t)(token_lifetime_secs * REFRESH_WINDOW_END * 1000);
+        // Devices put at the same time get slots this far apart, so their refreshes are spread over the whole window.
+        tickcounter_ms_t spacing = (window_end - window_start) / ((instance->device_count == 0) ? 1 : instance->device_count);
+        tickcounter_ms_t refresh_time;
+
+        if (!instance->has_refresh_time || instance->last_refresh_time + spacing < window_start)
+        {
+            refresh_time = window_start;
+        }
+        else if (instance->last_refresh_time + spacing > window_end)
+        {
+            refresh_time = window_end;
+        }
+        else
+        {
+            refresh_time = instance->last_refresh_time + spacing;
+        }
+
+        if (!instance->has_refresh_time || refresh_time > instance->last_refresh_time)
+        {
+            instance->last_refresh_time = refresh_time;
+            instance->has_refresh_time = true;
+        }
+
+        result = (refresh_time - put_time) / 1000;
+    }
+
+    return result;
+}
+
+bool cbs_scheduler_begin_put_token(CBS_SCHEDULER_HANDLE scheduler, tickcounter_ms_t* start_time)
+{
+    bool result;
+
+    if (scheduler == NULL || start_time == NULL)
+    {
+        LogError("cbs_scheduler_begin_put_token failed (scheduler=%p, start_time=%p)", scheduler, start_time);
+        result = false;
+    }
+    else
+    {
+        CBS_SCHEDULER_INSTANCE* instance = (CBS_SCHEDULER_INSTANCE*)scheduler;
+
+        if (instance->max_put_tokens_in_flight != 0 &&
+            instance->statistics.put_tokens_in_flight >= instance->max_put_tokens_in_flight)
+        {
+            result = false;
+        }
+        else
+        {
+            if (tickcounter_get_current_ms(instance->tick_counter, start_time) != 0)
+            {
+                LogError("Failed getting the CBS put-token start time (tickcounter_get_current_ms failed)");
+                *start_time = 0;
+            }
+
+            instance->statistics.put_tokens_in_flight++;
+
+            if (instance->statistics.put_tokens_in_flight > instance->statistics.max_put_tokens_in_flight)
+            {
+                instance->statistics.max_put_tokens_in_flight = instance->statistics.put_tokens_in_flight;
+            }
+
+            result = true;
+        }
+    }
+
+    return result;
+}
+
+void cbs_scheduler_end_put_token(CBS_SCHEDULER_HANDLE scheduler, tickcounter_ms_t start_time, bool succeeded)
+{
+    if (scheduler == NULL)
+    {
+        LogError("cbs_scheduler_end_put_token failed (scheduler is NULL)");
+    }
+    else
+    {
+        CBS_SCHEDULER_INSTANCE* instance = (CBS_SCHEDULER_INSTANCE*)scheduler;
+
+        if (instance->statistics.put_tokens_in_flight > 0)
+        {
+            instance->statistics.put_tokens_in_flight--;
+        }
+
+        if (succeeded)
+        {
+            record_put_token_latency(instance, start_time);
+            instance->statistics.put_tokens++;
+        }
+        else
+        {
+            instance->statistics.failed_put_tokens++;
+        }
+    }
+}
+
+int cbs_scheduler_get_statistics(CBS_SCHEDULER_HANDLE scheduler, IOTHUB_AMQP_CBS_STATISTICS* statistics)
+{
+    int result;
+
+    if (scheduler == NULL || statistics == NULL)
+    {
+        LogError("cbs_scheduler_get_statistics failed (scheduler=%p, statistics=%p)", scheduler, statistics);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        CBS_SCHEDULER_INSTANCE* instance = (CBS_SCHEDULER_INSTANCE*)scheduler;
+        size_t latency_count = 0;
+        size_t bucket;
+
+        for (bucket = 0; bucket < IOTHUB_AMQP_CBS_LATENCY_BUCKET_COUNT; bucket++)
+        {
+            latency_count += instance->statistics.put_token_latency_ms[bucket];
+        }
+
+        *statistics = instance->statistics;
+        statistics->put_token_latency_p50_ms = get_put_token_latency_percentile(&instance->statistics, latency_count, 50);
+        statistics->put_token_latency_p90_ms = get_put_token_latency_percentile(&instance->statistics, latency_count, 90);
+        statistics->put_token_latency_p99_ms = get_put_token_latency_percentile(&instance->statistics, latency_count, 99);
+        result = RESULT_OK;
+    }
+
+    return result;
+}
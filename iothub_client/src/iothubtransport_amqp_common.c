@@ -34,6 +34,7 @@
 #include "internal/iothubtransport_amqp_common.h"
 #include "internal/iothubtransport_amqp_connection.h"
 #include "internal/iothubtransport_amqp_device.h"
+#include "internal/iothubtransport_amqp_cbs_scheduler.h"
 #include "internal/iothubtransport.h"
 #include "iothub_client_version.h"
 #include "internal/iothub_transport_ll_private.h"
@@ -44,6 +45,7 @@
 #define DEFAULT_CBS_REQUEST_TIMEOUT_SECS          30
 #define DEFAULT_DEVICE_STATE_CHANGE_TIMEOUT_SECS  60
 #define DEFAULT_EVENT_SEND_TIMEOUT_SECS           300
+#define DEFAULT_TELEMETRY_BATCH_BYTES             (16 * 1024)
 #define MAX_NUMBER_OF_DEVICE_FAILURES             5
 #define DEFAULT_SERVICE_KEEP_ALIVE_FREQ_SECS      240
 #define DEFAULT_REMOTE_IDLE_PING_RATIO            0.50
@@ -52,6 +54,8 @@
 #define DEFAULT_MAX_RETRY_TIME_IN_SECS            0
 #define MAX_SERVICE_KEEP_ALIVE_RATIO              0.9
 #define DEFAULT_DEVICE_STOP_DELAY                 10
+// Number of buckets of the registered devices index; a power of 2, so a hash is mapped to its bucket by masking.
+#define REGISTERED_DEVICES_INDEX_SIZE             256
 
 // ---------- Data Definitions ---------- //
 
@@ -104,10 +108,12 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
     AMQP_CONNECTION_STATE amqp_connection_state;                        // Current state of the amqp_connection.
     AMQP_TRANSPORT_AUTHENTICATION_MODE preferred_authentication_mode;   // Used to avoid registered devices using different authentication modes.
     SINGLYLINKEDLIST_HANDLE registered_devices;                         // List of devices currently registered in this transport.
+    struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG* registered_devices_index[REGISTERED_DEVICES_INDEX_SIZE]; // Same devices, chained by hash of the device id.
     bool is_trace_on;                                                   // Turns logging on and off.
     OPTIONHANDLER_HANDLE saved_tls_options;                             // Here are the options from the xio layer if any is saved.
     AMQP_TRANSPORT_STATE state;                                         // Current state of the transport.
     RETRY_CONTROL_HANDLE connection_retry_control;                      // Controls when the re-connection attempt should occur.
+    CBS_SCHEDULER_HANDLE cbs_scheduler;                                 // Paces the CBS put-tokens of the registered devices.
     size_t svc2cl_keep_alive_timeout_secs;                       // Service to device keep alive frequency
     double cl2svc_keep_alive_send_ratio;                                    // Client to service keep alive frequency
 
@@ -118,6 +124,8 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
 
     size_t option_cbs_request_timeout_secs;                             // Device-specific option.
     size_t option_send_event_timeout_secs;                              // Device-specific option.
+    size_t option_telemetry_linger_ms;                                  // Device-specific option.
+    size_t option_telemetry_batch_bytes;                                // Device-specific option.
 
                                                                         // Auth module used to generating handle authorization
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;                   // with either SAS Token, x509 Certs, and Device SAS Token
@@ -146,6 +154,11 @@ typedef struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG
 
     TRANSPORT_CALLBACKS_INFO transport_callbacks;
     void* transport_ctx;
+
+    LIST_ITEM_HANDLE list_item;                                         // Item of this device in `transport_instance->registered_devices`.
+    struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG* next_in_index;           // Next device in the same bucket of `transport_instance->registered_devices_index`.
+    uint32_t index_hash;                                                // Hash of `index_key`.
+    char index_key[1];                                                  // Copy of the device id, allocated along with this structure.
 } AMQP_TRANSPORT_DEVICE_INSTANCE;
 
 typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG
@@ -315,58 +328,77 @@ static void on_device_state_changed_callback(void* context, DEVICE_STATE previou
     }
 }
 
-// @brief    Auxiliary function to be used to find a device in the registered_devices list.
-// @returns  true if the device ids match, false otherwise.
-static bool find_device_by_id_callback(LIST_ITEM_HANDLE list_item, const void* match_context)
+static uint32_t get_device_id_hash(const char* device_id)
 {
-    bool result;
+    uint32_t hash = 2166136261u;
 
-    if (match_context == NULL)
+    // FNV-1a
+    while (*device_id != '\0')
     {
-        result = false;
+        hash = (hash ^ (unsigned char)*device_id) * 16777619u;
+        device_id++;
     }
-    else
-    {
-        AMQP_TRANSPORT_DEVICE_INSTANCE* device_instance = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item);
 
-        if (device_instance == NULL ||
-            device_instance->device_id == NULL ||
-            STRING_c_str(device_instance->device_id) != match_context)
-        {
-            result = false;
-        }
-        else
-        {
-            result = true;
-        }
+    return hash;
+}
+
+// @brief       Looks up a device in the index of the devices registered within the transport.
+// @returns     The registered device with that id, or NULL if there is none.
+static AMQP_TRANSPORT_DEVICE_INSTANCE* find_registered_device(AMQP_TRANSPORT_INSTANCE* transport_instance, const char* device_id)
+{
+    uint32_t hash = get_device_id_hash(device_id);
+    AMQP_TRANSPORT_DEVICE_INSTANCE* device_instance = transport_instance->registered_devices_index[hash & (REGISTERED_DEVICES_INDEX_SIZE - 1)];
+
+    while (device_instance != NULL &&
+        (device_instance->index_hash != hash || strcmp(device_instance->index_key, device_id) != 0))
+    {
+        device_instance = device_instance->next_in_index;
     }
 
-    return result;
+    return device_instance;
 }
 
-// @brief       Verifies if a device is already registered within the transport that owns the list of registered devices.
-// @remarks     Returns the correspoding LIST_ITEM_HANDLE in registered_devices, if found.
-// @returns     true if the device is already in the list, false otherwise.
-static bool is_device_registered_ex(SINGLYLINKEDLIST_HANDLE registered_devices, const char* device_id, LIST_ITEM_HANDLE *list_item)
+static void add_to_registered_devices_index(AMQP_TRANSPORT_DEVICE_INSTANCE* device_instance)
 {
-    return ((*list_item = singlylinkedlist_find(registered_devices, find_device_by_id_callback, device_id)) != NULL ? 1 : 0);
+    AMQP_TRANSPORT_DEVICE_INSTANCE** bucket = &device_instance->transport_instance->registered_devices_index[device_instance->index_hash & (REGISTERED_DEVICES_INDEX_SIZE - 1)];
+
+    device_instance->next_in_index = *bucket;
+    *bucket = device_instance;
 }
 
-// @brief       Verifies if a device is already registered within the transport that owns the list of registered devices.
-// @returns     true if the device is already in the list, false otherwise.
+static void remove_from_registered_devices_index(AMQP_TRANSPORT_DEVICE_INSTANCE* device_instance)
+{
+    AMQP_TRANSPORT_DEVICE_INSTANCE** link = &device_instance->transport_instance->registered_devices_index[device_instance->index_hash & (REGISTERED_DEVICES_INDEX_SIZE - 1)];
+
+    while (*link != NULL && *link != device_instance)
+    {
+        link = &(*link)->next_in_index;
+    }
+
+    if (*link != NULL)
+    {
+        *link = device_instance->next_in_index;
+        device_instance->next_in_index = NULL;
+    }
+}
+
+// @brief       Verifies if a device is registered within the transport it refers to.
+// @returns     true if the device is in the index of registered devices, false otherwise.
 static bool is_device_registered(AMQP_TRANSPORT_DEVICE_INSTANCE* amqp_device_instance)
 {
+    bool result;
+
     if (amqp_device_instance == NULL)
     {
         LogError("AMQP_TRANSPORT_DEVICE_INSTANCE is NULL");
-        return false;
+        result = false;
     }
     else
     {
-        LIST_ITEM_HANDLE list_item;
-        const char* device_id = STRING_c_str(amqp_device_instance->device_id);
-        return is_device_registered_ex(amqp_device_instance->transport_instance->registered_devices, device_id, &list_item);
+        result = (find_registered_device(amqp_device_instance->transport_instance, amqp_device_instance->index_key) == amqp_device_instance);
     }
+
+    return result;
 }
 
 static size_t get_number_of_registered_devices(AMQP_TRANSPORT_INSTANCE* transport)
@@ -1036,24 +1068,20 @@ static void on_event_send_complete(IOTHUB_MESSAGE_LIST* message, D2C_EVENT_SEND_
         registered_device->number_of_send_event_complete_failures = 0;
     }
 
-    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_056: [If `message->callback` is not NULL, it shall invoked with the `iothub_send_result`]
-    if (message->callback != NULL)
-    {
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_050: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_OK, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_OK]
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_051: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_052: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_053: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_TIMEOUT, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT]
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_054: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_DEVICE_DESTROYED, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY]
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_055: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_UNKNOWN, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
-        IOTHUB_CLIENT_CONFIRMATION_RESULT iothub_send_result = get_iothub_client_confirmation_result_from(result);
-
-        message->callback(iothub_send_result, message->context);
-    }
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_050: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_OK, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_OK]
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_051: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_052: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_053: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_TIMEOUT, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT]
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_054: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_DEVICE_DESTROYED, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY]
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_055: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_UNKNOWN, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
+    IOTHUB_CLIENT_CONFIRMATION_RESULT iothub_send_result = get_iothub_client_confirmation_result_from(result);
 
-    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_057: [`message->messageHandle` shall be destroyed using IoTHubMessage_Destroy]
-    IoTHubMessage_Destroy(message->messageHandle);
-    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_058: [`message` shall be destroyed using free]
-    free(message);
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_056: [`message` shall be completed with `iothub_send_result` through `send_complete_cb`, which invokes its callback and destroys it]
+    // The client also forgets the message timeout it may still track for it.
+    DLIST_ENTRY messageCompleted;
+    DList_InitializeListHead(&messageCompleted);
+    DList_InsertTailList(&messageCompleted, &(message->entry));
+    registered_device->transport_callbacks.send_complete_cb(&messageCompleted, iothub_send_result, registered_device->transport_ctx);
 }
 
 // @brief
@@ -1225,6 +1253,14 @@ static int replicate_device_options_to(AMQP_TRANSPORT_DEVICE_INSTANCE* dev_insta
         LogError("Failed to apply option DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS to device '%s' (amqp_device_set_option failed)", STRING_c_str(dev_instance->device_id));
         result = MU_FAILURE;
     }
+    // Lingering is off unless OPTION_TELEMETRY_LINGER_MS was set, in which case the devices registered later linger too.
+    else if (dev_instance->transport_instance->option_telemetry_linger_ms != 0 &&
+        (amqp_device_set_option(dev_instance->device_handle, DEVICE_OPTION_TELEMETRY_BATCH_BYTES, &dev_instance->transport_instance->option_telemetry_batch_bytes) != RESULT_OK ||
+         amqp_device_set_option(dev_instance->device_handle, DEVICE_OPTION_TELEMETRY_LINGER_MS, &dev_instance->transport_instance->option_telemetry_linger_ms) != RESULT_OK))
+    {
+        LogError("Failed to apply the telemetry linger options to device '%s' (amqp_device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = MU_FAILURE;
+    }
     else if (auth_mode == DEVICE_AUTH_MODE_CBS)
     {
         if (amqp_device_set_option(
@@ -1262,6 +1298,14 @@ static const char* get_device_option_name_from(const char* iothubclient_option_n
     {
         device_option_name = DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS;
     }
+    else if (strcmp(OPTION_TELEMETRY_LINGER_MS, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_TELEMETRY_LINGER_MS;
+    }
+    else if (strcmp(OPTION_TELEMETRY_BATCH_BYTES, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_TELEMETRY_BATCH_BYTES;
+    }
     else
     {
         device_option_name = NULL;
@@ -1336,6 +1380,11 @@ static void internal_destroy_instance(AMQP_TRANSPORT_INSTANCE* instance)
             singlylinkedlist_destroy(instance->registered_devices);
         }
 
+        if (instance->cbs_scheduler != NULL)
+        {
+            cbs_scheduler_destroy(instance->cbs_scheduler);
+        }
+
         if (instance->amqp_connection != NULL)
         {
             amqp_connection_destroy(instance->amqp_connection);
@@ -1449,6 +1498,11 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
                 LogError("Failed to initialize the internal list of registered devices (singlylinkedlist_create failed)");
                 result = NULL;
             }
+            else if ((instance->cbs_scheduler = cbs_scheduler_create()) == NULL)
+            {
+                LogError("Failed to create the CBS scheduler (cbs_scheduler_create failed)");
+                result = NULL;
+            }
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_010: [`get_io_transport` shall be saved on `instance->underlying_io_transport_provider`]
@@ -1456,6 +1510,7 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
                 instance->is_trace_on = false;
                 instance->option_cbs_request_timeout_secs = DEFAULT_CBS_REQUEST_TIMEOUT_SECS;
                 instance->option_send_event_timeout_secs = DEFAULT_EVENT_SEND_TIMEOUT_SECS;
+                instance->option_telemetry_batch_bytes = DEFAULT_TELEMETRY_BATCH_BYTES;
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_12_002: [The connection idle timeout parameter default value shall be set to 240000 milliseconds using connection_set_idle_timeout()]
                 instance->svc2cl_keep_alive_timeout_secs = DEFAULT_SERVICE_KEEP_ALIVE_FREQ_SECS;
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_99_001: [The remote idle timeout ratio shall be set to 0.5 using connection_set_remote_idle_timeout_empty_frame_send_ratio()]
@@ -2014,6 +2069,16 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
             is_device_specific_option = true;
             transport_instance->option_send_event_timeout_secs = *(size_t*)value;
         }
+        else if (strcmp(OPTION_TELEMETRY_LINGER_MS, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_telemetry_linger_ms = *(size_t*)value;
+        }
+        else if (strcmp(OPTION_TELEMETRY_BATCH_BYTES, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_telemetry_batch_bytes = *(size_t*)value;
+        }
         else
         {
             is_device_specific_option = false;
@@ -2032,6 +2097,18 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
                 result = IOTHUB_CLIENT_OK;
             }
         }
+        else if (strcmp(OPTION_AMQP_CBS_MAX_PUT_TOKENS_IN_FLIGHT, option) == 0)
+        {
+            if (cbs_scheduler_set_max_put_tokens_in_flight(transport_instance->cbs_scheduler, *(size_t*)value) != RESULT_OK)
+            {
+                LogError("Failure setting the maximum number of CBS put-tokens in flight");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else if (strcmp(OPTION_RETRY_INTERVAL_SEC, option) == 0)
         {
             if (retry_control_set_option(transport_instance->connection_retry_control, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, value) != 0)
@@ -2241,11 +2318,10 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
     }
     else
     {
-        LIST_ITEM_HANDLE list_item;
         AMQP_TRANSPORT_INSTANCE* transport_instance = (AMQP_TRANSPORT_INSTANCE*)handle;
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_064: [If the device is already registered, IoTHubTransport_AMQP_Common_Register shall fail and return NULL.]
-        if (is_device_registered_ex(transport_instance->registered_devices, device->deviceId, &list_item))
+        if (find_registered_device(transport_instance, device->deviceId) != NULL)
         {
             LogError("IoTHubTransport_AMQP_Common_Register failed (device '%s' already registered on this transport instance)", device->deviceId);
             result = NULL;
@@ -2259,9 +2335,10 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
         else
         {
             AMQP_TRANSPORT_DEVICE_INSTANCE* amqp_device_instance;
+            size_t device_id_length = strlen(device->deviceId);
 
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_066: [IoTHubTransport_AMQP_Common_Register shall allocate an instance of AMQP_TRANSPORT_DEVICE_INSTANCE to store the state of the new registered device.]
-            if ((amqp_device_instance = (AMQP_TRANSPORT_DEVICE_INSTANCE*)malloc(sizeof(AMQP_TRANSPORT_DEVICE_INSTANCE))) == NULL)
+            if ((amqp_device_instance = (AMQP_TRANSPORT_DEVICE_INSTANCE*)malloc(sizeof(AMQP_TRANSPORT_DEVICE_INSTANCE) + device_id_length)) == NULL)
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_067: [If malloc fails, IoTHubTransport_AMQP_Common_Register shall fail and return NULL.]
                 LogError("Transport failed to register device '%s' (failed to create the device state instance; malloc failed)", device->deviceId);
@@ -2280,6 +2357,8 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                 amqp_device_instance->subscribed_for_methods = false;
                 amqp_device_instance->transport_ctx = transport_instance->transport_ctx;
                 amqp_device_instance->transport_callbacks = transport_instance->transport_callbacks;
+                (void)memcpy(amqp_device_instance->index_key, device->deviceId, device_id_length + 1);
+                amqp_device_instance->index_hash = get_device_id_hash(amqp_device_instance->index_key);
 
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_069: [A copy of `config->deviceId` shall be saved into `device_state->device_id`]
                 if ((amqp_device_instance->device_id = STRING_construct(device->deviceId)) == NULL)
@@ -2294,6 +2373,7 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                     (void)memset(&device_config, 0, sizeof(AMQP_DEVICE_CONFIG));
                     device_config.iothub_host_fqdn = (char*)STRING_c_str(transport_instance->iothub_host_fqdn);
                     device_config.authorization_module = device->authorization_module;
+                    device_config.cbs_scheduler = transport_instance->cbs_scheduler;
 
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_072: [The configuration for amqp_device_create shall be set according to the authentication preferred by IOTHUB_DEVICE_CONFIG]
                     device_config.authentication_mode = get_authentication_mode(device);
@@ -2329,7 +2409,7 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                                 result = NULL;
                             }
                             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_074: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to `instance->registered_devices`]
-                            else if (singlylinkedlist_add(transport_instance->registered_devices, amqp_device_instance) == NULL)
+                            else if ((amqp_device_instance->list_item = singlylinkedlist_add(transport_instance->registered_devices, amqp_device_instance)) == NULL)
                             {
                                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_075: [If it fails to add `amqp_device_instance`, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
                                 LogError("Transport failed to register device '%s' (singlylinkedlist_add failed)", device->deviceId);
@@ -2337,6 +2417,8 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                             }
                             else
                             {
+                                add_to_registered_devices_index(amqp_device_instance);
+
                                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_076: [If the device is the first being registered on the transport, IoTHubTransport_AMQP_Common_Register shall save its authentication mode as the transport preferred authentication mode]
                                 if (transport_instance->preferred_authentication_mode == AMQP_TRANSPORT_AUTHENTICATION_MODE_NOT_SET &&
                                     is_first_device_being_registered)
@@ -2381,7 +2463,6 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
     {
         AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)deviceHandle;
         const char* device_id;
-        LIST_ITEM_HANDLE list_item;
 
         if ((device_id = STRING_c_str(registered_device->device_id)) == NULL)
         {
@@ -2393,19 +2474,21 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
             LogError("Failed to unregister device '%s' (deviceHandle does not have a transport state associated to).", device_id);
         }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_081: [If the device is not registered with this transport, IoTHubTransport_AMQP_Common_Unregister shall return]
-        else if (!is_device_registered_ex(registered_device->transport_instance->registered_devices, device_id, &list_item))
+        else if (!is_device_registered(registered_device))
         {
             LogError("Failed to unregister device '%s' (device is not registered within this transport).", device_id);
         }
         else
         {
             // Removing it first so the race hazzard is reduced between this function and DoWork. Best would be to use locks.
-            if (singlylinkedlist_remove(registered_device->transport_instance->registered_devices, list_item) != RESULT_OK)
+            if (singlylinkedlist_remove(registered_device->transport_instance->registered_devices, registered_device->list_item) != RESULT_OK)
             {
                 LogError("Failed to unregister device '%s' (singlylinkedlist_remove failed).", device_id);
             }
             else
             {
+                remove_from_registered_devices_index(registered_device);
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_012: [IoTHubTransport_AMQP_Common_Unregister shall destroy the C2D methods handler by calling iothubtransportamqp_methods_destroy]
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_083: [IoTHubTransport_AMQP_Common_Unregister shall free all the memory allocated for the `device_instance`]
                 internal_destroy_amqp_device_instance(registered_device);
@@ -2492,6 +2575,36 @@ STRING_HANDLE IoTHubTransport_AMQP_Common_GetHostname(TRANSPORT_LL_HANDLE handle
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_GetOption(TRANSPORT_LL_HANDLE handle, const char* option, void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (handle == NULL || option == NULL || value == NULL)
+    {
+        LogError("Invalid argument (handle=%p, option=%p, value=%p)", handle, option, value);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (strcmp(OPTION_AMQP_CBS_STATISTICS, option) == 0)
+    {
+        if (cbs_scheduler_get_statistics(((AMQP_TRANSPORT_INSTANCE*)handle)->cbs_scheduler, (IOTHUB_AMQP_CBS_STATISTICS*)value) != RESULT_OK)
+        {
+            LogError("Failure getting the CBS statistics");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    else
+    {
+        LogError("Unknown option (%s)", option);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SendMessageDisposition(MESSAGE_CALLBACK_INFO* message_data, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -522,6 +522,7 @@ static AMQP_DEVICE_CONFIG* clone_device_config(AMQP_DEVICE_CONFIG *config)
             new_config->module_id = IoTHubClient_Auth_Get_ModuleId(config->authorization_module);
             new_config->prod_info_cb = config->prod_info_cb;
             new_config->prod_info_ctx = config->prod_info_ctx;
+            new_config->cbs_scheduler = config->cbs_scheduler;
             result = RESULT_OK;
         }
 
@@ -547,6 +548,7 @@ static void set_authentication_config(AMQP_DEVICE_INSTANCE* device_instance, AUT
     auth_config->on_state_changed_callback = on_authentication_state_changed_callback;
     auth_config->on_state_changed_callback_context = device_instance;
     auth_config->authorization_module = device_config->authorization_module;
+    auth_config->cbs_scheduler = device_config->cbs_scheduler;
 }
 
 // Create and Destroy Helpers
@@ -1527,6 +1529,20 @@ int amqp_device_set_option(AMQP_DEVICE_HANDLE handle, const char* name, void* va
                 result = RESULT_OK;
             }
         }
+        else if (strcmp(DEVICE_OPTION_TELEMETRY_LINGER_MS, name) == 0 || strcmp(DEVICE_OPTION_TELEMETRY_BATCH_BYTES, name) == 0)
+        {
+            const char* messenger_option_name = (strcmp(DEVICE_OPTION_TELEMETRY_LINGER_MS, name) == 0 ? TELEMETRY_MESSENGER_OPTION_LINGER_MS : TELEMETRY_MESSENGER_OPTION_LINGER_BATCH_BYTES);
+
+            if (telemetry_messenger_set_option(instance->messenger_handle, messenger_option_name, value) != RESULT_OK)
+            {
+                LogError("failed setting option for device '%s' (failed setting messenger option '%s')", instance->config->device_id, name);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                result = RESULT_OK;
+            }
+        }
         else if (strcmp(DEVICE_OPTION_SAVED_AUTH_OPTIONS, name) == 0)
         {
             // Codes_SRS_DEVICE_09_088: [If `name` is DEVICE_OPTION_SAVED_AUTH_OPTIONS but CBS authentication is not being used, amqp_device_set_option shall return a non-zero result]
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <inttypes.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
@@ -11,12 +12,14 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_uamqp_c/link.h"
 #include "azure_uamqp_c/messaging.h"
 #include "azure_uamqp_c/message_sender.h"
 #include "azure_uamqp_c/message_receiver.h"
 #include "internal/uamqp_messaging.h"
 #include "internal/iothub_client_private.h"
+#include "internal/timeout_heap.h"
 #include "iothub_client_version.h"
 #include "internal/iothubtransport_amqp_telemetry_messenger.h"
 
@@ -33,6 +36,7 @@
 #define MESSAGE_RECEIVER_MAX_LINK_SIZE                  65536
 #define DEFAULT_EVENT_SEND_RETRY_LIMIT                  10
 #define DEFAULT_EVENT_SEND_TIMEOUT_SECS                 600
+#define DEFAULT_LINGER_BATCH_BYTES                      (16 * 1024)
 #define MAX_MESSAGE_SENDER_STATE_CHANGE_TIMEOUT_SECS    300
 #define MAX_MESSAGE_RECEIVER_STATE_CHANGE_TIMEOUT_SECS  300
 #define UNIQUE_ID_BUFFER_SIZE                           37
@@ -50,6 +54,7 @@ typedef struct TELEMETRY_MESSENGER_INSTANCE_TAG
     STRING_HANDLE iothub_host_fqdn;
     SINGLYLINKEDLIST_HANDLE waiting_to_send;   // List of MESSENGER_SEND_EVENT_CALLER_INFORMATION's
     SINGLYLINKEDLIST_HANDLE in_progress_list;  // List of MESSENGER_SEND_EVENT_TASK's
+    TIMEOUT_HEAP send_timeouts;                // The sent MESSENGER_SEND_EVENT_TASK's that have not timed out, oldest first
     TELEMETRY_MESSENGER_STATE state;
 
     ON_TELEMETRY_MESSENGER_STATE_CHANGED_CALLBACK on_state_changed_callback;
@@ -74,6 +79,21 @@ typedef struct TELEMETRY_MESSENGER_INSTANCE_TAG
     size_t event_send_timeout_secs;
     time_t last_message_sender_state_change_time;
     time_t last_message_receiver_state_change_time;
+
+    // Events are encoded here one at a time before message_add_body_amqp_data copies them into the batch, so the
+    // buffer is kept from one send to the next and only grows when an event does not fit.
+    unsigned char* encoding_buffer;
+    size_t encoding_buffer_size;
+
+    // With linger_ms set, events wait up to linger_ms (from the first do_work that sees them) for more events to share
+    // their batch, unless linger_batch_bytes of payload are already waiting.
+    size_t linger_ms;
+    size_t linger_batch_bytes;
+    TICK_COUNTER_HANDLE linger_tick_counter;
+    bool is_lingering;
+    // Set once the waiting events were let go, so the ones left queued are not held back again until the queue empties
+    bool linger_released;
+    tickcounter_ms_t linger_start_ms;
 } TELEMETRY_MESSENGER_INSTANCE;
 
 // MESSENGER_SEND_EVENT_CALLER_INFORMATION corresponds to a message sent from the API, including
@@ -93,6 +113,7 @@ typedef struct MESSENGER_SEND_EVENT_TASK_TAG
     time_t send_time;
     TELEMETRY_MESSENGER_INSTANCE *messenger;
     bool is_timed_out;
+    TIMEOUT_HEAP_NODE timeout_node;
 } MESSENGER_SEND_EVENT_TASK;
 
 
@@ -840,6 +861,11 @@ static void free_task(MESSENGER_SEND_EVENT_TASK* task)
 {
     LIST_ITEM_HANDLE list_node;
 
+    if (NULL != task)
+    {
+        timeout_heap_remove(&task->messenger->send_timeouts, &task->timeout_node);
+    }
+
     if (NULL != task && NULL != task->callback_list)
     {
         while ((list_node = singlylinkedlist_get_head_item(task->callback_list)) != NULL)
@@ -996,6 +1022,7 @@ static MESSENGER_SEND_EVENT_TASK* create_task(TELEMETRY_MESSENGER_INSTANCE *mess
         memset(task, 0, sizeof(*task ));
         task->messenger = messenger;
         task->send_time = INDEFINITE_TIME;
+        timeout_heap_node_init(&task->timeout_node);
         if (NULL == (task->callback_list = singlylinkedlist_create()))
         {
             LogError("singlylinkedlist_create failed to create callback_list");
@@ -1150,7 +1177,12 @@ static int send_batched_message_and_reset_state(TELEMETRY_MESSENGER_INSTANCE* in
     }
     else
     {
-        send_pending_events_state->task->send_time = get_time(NULL);
+        // All events share event_send_timeout_secs, so they time out in the order they are sent, which is the order
+        // the heap keeps for equal deadlines. Without a send_time the timeout could not be evaluated anyway.
+        if ((send_pending_events_state->task->send_time = get_time(NULL)) != INDEFINITE_TIME)
+        {
+            timeout_heap_add(&instance->send_timeouts, &send_pending_events_state->task->timeout_node, 0);
+        }
         result = RESULT_OK;
     }
 
@@ -1203,11 +1235,6 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_199: [Errors specific to a message (e.g. failure to encode) are NOT fatal but we'll keep processing.  More general errors (e.g. out of memory) will stop processing.]
     while ((caller_info = get_next_caller_message_to_send(instance)) != NULL)
     {
-        if (body_binary_data.bytes != NULL)
-        {
-            // Free here as this may have been set during previous run through loop.
-            free((unsigned char*)body_binary_data.bytes);
-        }
         memset(&body_binary_data, 0, sizeof(body_binary_data));
 
         if ((0 == max_messagesize) && (get_max_message_size_for_batching(instance, &max_messagesize)) != 0)
@@ -1227,10 +1254,10 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
             break;
         }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_200: [Retrieve an AMQP encoded representation of this message for later appending to main batched message.  On error, invoke callback but continue send loop; this is NOT a fatal error.]
-        else if (message_create_uamqp_encoding_from_iothub_message(send_pending_events_state.message_batch_container, caller_info->message->messageHandle, &body_binary_data) != RESULT_OK)
+        else if (message_encode_uamqp_encoding_from_iothub_message(send_pending_events_state.message_batch_container, caller_info->message->messageHandle, &instance->encoding_buffer, &instance->encoding_buffer_size, &body_binary_data) != RESULT_OK)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_201: [If message_create_uamqp_encoding_from_iothub_message fails, invoke callback with TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE]
-            LogError("message_create_uamqp_encoding_from_iothub_message() failed.  Will continue to try to process messages, result");
+            LogError("message_encode_uamqp_encoding_from_iothub_message() failed.  Will continue to try to process messages, result");
             invoke_callback_on_error(caller_info, TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE);
             free(caller_info);
             continue;
@@ -1296,11 +1323,6 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
         }
     }
 
-    if (body_binary_data.bytes != NULL)
-    {
-        free((unsigned char*)body_binary_data.bytes);
-    }
-
     // A non-NULL task indicates error, since otherwise send_batched_message_and_reset_state would've sent off messages and reset send_pending_events_state
     if (send_pending_events_state.task != NULL)
     {
@@ -1317,8 +1339,104 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
     return result;
 }
 
+static size_t get_event_payload_size(IOTHUB_MESSAGE_HANDLE message)
+{
+    size_t result;
+    const unsigned char* bytes;
+    const char* string;
+    IOTHUBMESSAGE_CONTENT_TYPE content_type = IoTHubMessage_GetContentType(message);
+
+    if (content_type == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        if (IoTHubMessage_GetByteArray(message, &bytes, &result) != IOTHUB_MESSAGE_OK)
+        {
+            result = 0;
+        }
+    }
+    else if (content_type == IOTHUBMESSAGE_STRING && (string = IoTHubMessage_GetString(message)) != NULL)
+    {
+        result = strlen(string);
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+// @brief
+//     Tells whether the events waiting to be sent shall be held back for more events to join their batch.
+// @returns
+//     true while the linger time has not elapsed and fewer than linger_batch_bytes of payload are waiting. Once false,
+//     it stays false until the queue has been emptied, so events left queued by a send are not held back again.
+static bool is_lingering(TELEMETRY_MESSENGER_INSTANCE* instance)
+{
+    bool result;
+    LIST_ITEM_HANDLE list_item;
+    tickcounter_ms_t current_ms;
+
+    if (instance->linger_ms == 0)
+    {
+        result = false;
+    }
+    else if ((list_item = singlylinkedlist_get_head_item(instance->waiting_to_send)) == NULL)
+    {
+        instance->is_lingering = false;
+        instance->linger_released = false;
+        result = false;
+    }
+    else if (instance->linger_released)
+    {
+        result = false;
+    }
+    else if (tickcounter_get_current_ms(instance->linger_tick_counter, &current_ms) != 0)
+    {
+        LogError("tickcounter_get_current_ms failed; events are sent without lingering");
+        result = false;
+    }
+    else
+    {
+        if (!instance->is_lingering)
+        {
+            instance->is_lingering = true;
+            instance->linger_start_ms = current_ms;
+        }
+
+        if ((current_ms - instance->linger_start_ms) >= instance->linger_ms)
+        {
+            result = false;
+        }
+        else
+        {
+            size_t waiting_bytes = 0;
+
+            while (list_item != NULL && waiting_bytes < instance->linger_batch_bytes)
+            {
+                MESSENGER_SEND_EVENT_CALLER_INFORMATION* caller_info = (MESSENGER_SEND_EVENT_CALLER_INFORMATION*)singlylinkedlist_item_get_value(list_item);
+
+                if (caller_info != NULL)
+                {
+                    waiting_bytes += get_event_payload_size(caller_info->message->messageHandle);
+                }
+
+                list_item = singlylinkedlist_get_next_item(list_item);
+            }
+
+            result = (waiting_bytes < instance->linger_batch_bytes);
+        }
+
+        if (!result)
+        {
+            instance->linger_released = true;
+        }
+    }
+
+    return result;
+}
+
 // @brief
-//     Goes through each task in in_progress_list and checks if the events timed out to be sent.
+//     Checks if the events sent the longest ago timed out, up to the first one that did not.
 // @remarks
 //     If an event is timed out, it is marked as such but not removed, and the upper layer callback is invoked.
 // @returns
@@ -1329,32 +1447,29 @@ static int process_event_send_timeouts(TELEMETRY_MESSENGER_INSTANCE* instance)
 
     if (instance->event_send_timeout_secs > 0)
     {
-        LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(instance->in_progress_list);
+        TIMEOUT_HEAP_NODE* oldest;
 
-        while (list_item != NULL)
+        while ((oldest = timeout_heap_peek(&instance->send_timeouts)) != NULL)
         {
-            MESSENGER_SEND_EVENT_TASK* task = (MESSENGER_SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_item);
+            MESSENGER_SEND_EVENT_TASK* task = containingRecord(oldest, MESSENGER_SEND_EVENT_TASK, timeout_node);
+            int is_timed_out;
 
-            if (task != NULL && task->is_timed_out == false)
+            if (is_timeout_reached(task->send_time, instance->event_send_timeout_secs, &is_timed_out) != RESULT_OK)
             {
-                int is_timed_out;
-
-                if (is_timeout_reached(task->send_time, instance->event_send_timeout_secs, &is_timed_out) == RESULT_OK)
-                {
-                    if (is_timed_out)
-                    {
-                        task->is_timed_out = true;
-                        singlylinkedlist_foreach(task->callback_list, invoke_callback, (void*)TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_TIMEOUT);
-                    }
-                }
-                else
-                {
-                    LogError("messenger failed to evaluate event send timeout of event %p", task);
-                    result = MU_FAILURE;
-                }
+                LogError("messenger failed to evaluate event send timeout of event %p", task);
+                result = MU_FAILURE;
+                break;
+            }
+            else if (!is_timed_out)
+            {
+                break;
+            }
+            else
+            {
+                timeout_heap_remove(&instance->send_timeouts, oldest);
+                task->is_timed_out = true;
+                singlylinkedlist_foreach(task->callback_list, invoke_callback, (void*)TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_TIMEOUT);
             }
-
-            list_item = singlylinkedlist_get_next_item(list_item);
         }
     }
 
@@ -1402,6 +1517,8 @@ static void* telemetry_messenger_clone_option(const char* name, const void* valu
     else
     {
         if (strcmp(TELEMETRY_MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0 ||
+            strcmp(TELEMETRY_MESSENGER_OPTION_LINGER_MS, name) == 0 ||
+            strcmp(TELEMETRY_MESSENGER_OPTION_LINGER_BATCH_BYTES, name) == 0 ||
             strcmp(TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
         {
             result = (void*)value;
@@ -1890,6 +2007,10 @@ void telemetry_messenger_do_work(TELEMETRY_MESSENGER_HANDLE messenger_handle)
             {
                 update_messenger_state(instance, TELEMETRY_MESSENGER_STATE_ERROR);
             }
+            else if (is_lingering(instance))
+            {
+                // Waiting for more events to batch with the ones already queued.
+            }
             else if (send_pending_events(instance) != RESULT_OK && instance->event_send_retry_limit > 0)
             {
                 instance->event_send_error_count++;
@@ -1905,6 +2026,13 @@ void telemetry_messenger_do_work(TELEMETRY_MESSENGER_HANDLE messenger_handle)
             {
                 instance->event_send_error_count = 0;
             }
+
+            // The next event queued after the waiting ones have gone out starts a new linger window
+            if (instance->linger_released && singlylinkedlist_get_head_item(instance->waiting_to_send) == NULL)
+            {
+                instance->is_lingering = false;
+                instance->linger_released = false;
+            }
         }
     }
 }
@@ -1969,6 +2097,16 @@ void telemetry_messenger_destroy(TELEMETRY_MESSENGER_HANDLE messenger_handle)
 
         STRING_delete(instance->module_id);
 
+        if (instance->encoding_buffer != NULL)
+        {
+            free(instance->encoding_buffer);
+        }
+
+        if (instance->linger_tick_counter != NULL)
+        {
+            tickcounter_destroy(instance->linger_tick_counter);
+        }
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_114: [telemetry_messenger_destroy() shall destroy `instance` with free()]
         (void)free(instance);
     }
@@ -2010,6 +2148,7 @@ TELEMETRY_MESSENGER_HANDLE telemetry_messenger_create(const TELEMETRY_MESSENGER_
         else
         {
             memset(instance, 0, sizeof(TELEMETRY_MESSENGER_INSTANCE));
+            timeout_heap_init(&instance->send_timeouts);
             instance->state = TELEMETRY_MESSENGER_STATE_STOPPED;
             instance->message_sender_current_state = MESSAGE_SENDER_STATE_IDLE;
             instance->message_sender_previous_state = MESSAGE_SENDER_STATE_IDLE;
@@ -2017,6 +2156,7 @@ TELEMETRY_MESSENGER_HANDLE telemetry_messenger_create(const TELEMETRY_MESSENGER_
             instance->message_receiver_previous_state = MESSAGE_RECEIVER_STATE_IDLE;
             instance->event_send_retry_limit = DEFAULT_EVENT_SEND_RETRY_LIMIT;
             instance->event_send_timeout_secs = DEFAULT_EVENT_SEND_TIMEOUT_SECS;
+            instance->linger_batch_bytes = DEFAULT_LINGER_BATCH_BYTES;
             instance->last_message_sender_state_change_time = INDEFINITE_TIME;
             instance->last_message_receiver_state_change_time = INDEFINITE_TIME;
 
@@ -2099,6 +2239,28 @@ int telemetry_messenger_set_option(TELEMETRY_MESSENGER_HANDLE messenger_handle,
             instance->event_send_timeout_secs = *((size_t*)value);
             result = RESULT_OK;
         }
+        else if (strcmp(TELEMETRY_MESSENGER_OPTION_LINGER_MS, name) == 0)
+        {
+            // The tick counter is only needed once lingering is turned on.
+            if (*((size_t*)value) != 0 && instance->linger_tick_counter == NULL &&
+                (instance->linger_tick_counter = tickcounter_create()) == NULL)
+            {
+                LogError("telemetry_messenger_set_option failed (tickcounter_create failed)");
+                result = MU_FAILURE;
+            }
+            else
+            {
+                instance->linger_ms = *((size_t*)value);
+                instance->is_lingering = false;
+                instance->linger_released = false;
+                result = RESULT_OK;
+            }
+        }
+        else if (strcmp(TELEMETRY_MESSENGER_OPTION_LINGER_BATCH_BYTES, name) == 0)
+        {
+            instance->linger_batch_bytes = *((size_t*)value);
+            result = RESULT_OK;
+        }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
         else if (strcmp(TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
         {
@@ -2157,6 +2319,13 @@ OPTIONHANDLER_HANDLE telemetry_messenger_retrieve_options(TELEMETRY_MESSENGER_HA
                 LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", TELEMETRY_MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS);
                 result = NULL;
             }
+            else if (instance->linger_ms != 0 &&
+                (OptionHandler_AddOption(options, TELEMETRY_MESSENGER_OPTION_LINGER_MS, (void*)&instance->linger_ms) != OPTIONHANDLER_OK ||
+                 OptionHandler_AddOption(options, TELEMETRY_MESSENGER_OPTION_LINGER_BATCH_BYTES, (void*)&instance->linger_batch_bytes) != OPTIONHANDLER_OK))
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_AddOption failed for the linger options)");
+                result = NULL;
+            }
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_179: [If no failures occur, telemetry_messenger_retrieve_options shall return the OPTIONHANDLER_HANDLE instance]
@@ -46,6 +46,9 @@
 #define SAS_TOKEN_DEFAULT_LEN               10
 #define RESEND_TIMEOUT_VALUE_MIN            1*60
 #define MAX_SEND_RECOUNT_LIMIT              2
+#define MAX_INFLIGHT_MESSAGES               256
+#define DEFAULT_TELEMETRY_BATCH_BYTES       (16 * 1024)
+#define ACK_INDEX_SIZE                      64
 #define DEFAULT_CONNECTION_INTERVAL         30
 #define FAILED_CONN_BACKOFF_VALUE           5
 #define STATUS_CODE_FAILURE_VALUE           500
@@ -92,6 +95,8 @@ static const char* CONNECTION_DEVICE_ID = "cdid";
 static const char* CONNECTION_MODULE_ID_PROPERTY = "cmid";
 
 static const char* DIAGNOSTIC_CONTEXT_CREATION_TIME_UTC_PROPERTY = "creationtimeutc";
+static const char* OUTPUT_NAME_PROPERTY = "on";
+static const char* SYSTEM_PROPERTY_PREFIX = "%24.";
 
 static const char DT_MODEL_ID_TOKEN[] = "model-id";
 
@@ -107,6 +112,16 @@ static const char DEFAULT_IOTHUB_PRODUCT_IDENTIFIER[] = CLIENT_DEVICE_TYPE_PREFI
 #define SUBSCRIBE_INPUT_QUEUE_TOPIC             0x0010
 #define SUBSCRIBE_TOPIC_COUNT                   5
 
+// Telemetry topics up to this size are built in the transport itself, longer ones in a buffer grown as needed
+#define MQTT_TOPIC_INLINE_BUFFER_SIZE           256
+#define MQTT_TOPIC_CACHE_MAX_SIZE               64
+
+// Same unreserved characters and escaping as URL_EncodeString
+#define IS_URL_PRINTABLE(c) ( \
+    ((c) == '!') || ((c) == '(') || ((c) == ')') || ((c) == '*') || ((c) == '-') || ((c) == '.') || ((c) == '_') || \
+    (((c) >= '0') && ((c) <= '9')) || (((c) >= 'A') && ((c) <= 'Z')) || (((c) >= 'a') && ((c) <= 'z')))
+#define NIBBLE_TO_HEX(n) (char)(((n) < 10) ? ((n) + '0') : ((n) - 10 + 'a'))
+
 MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(MQTT_CLIENT_EVENT_ERROR, MQTT_CLIENT_EVENT_ERROR_VALUES)
 
 typedef struct SYSTEM_PROPERTY_INFO_TAG
@@ -156,6 +171,37 @@ typedef enum MQTT_CLIENT_STATUS_TAG
     MQTT_CLIENT_STATUS_EXECUTE_DISCONNECT
 } MQTT_CLIENT_STATUS;
 
+typedef struct MQTT_TOPIC_PROPERTIES_TAG
+{
+    const char* const* user_keys;
+    const char* const* user_values;
+    size_t user_count;
+    bool is_security_message;
+    const char* correlation_id;
+    const char* message_id;
+    const char* content_type;
+    const char* content_encoding;
+    const char* creation_time_utc;
+    const char* diagnostic_id;
+    const char* diagnostic_creation_time_utc;
+    const char* output_name;
+} MQTT_TOPIC_PROPERTIES;
+
+// The properties part of a topic is cached around the message and correlation ids, which most senders set per message: the
+// properties written before them and, without a leading separator, those written after them.
+typedef struct MQTT_TOPIC_CACHE_ENTRY_TAG
+{
+    uint32_t hash;
+    size_t last_used;
+    // key, head and tail share one allocation
+    char* key;
+    size_t key_length;
+    char* head;
+    size_t head_length;
+    char* tail;
+    size_t tail_length;
+} MQTT_TOPIC_CACHE_ENTRY;
+
 typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
 {
     // Topic control
@@ -226,7 +272,30 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
 
     // Telemetry specific
     DLIST_ENTRY telemetry_waitingForAck;
+    // The same messages, chained by packet id for PUBACKs and in a min-heap by publish time for resends
+    struct MQTT_MESSAGE_DETAILS_LIST_TAG* telemetry_ack_index[ACK_INDEX_SIZE];
+    struct MQTT_MESSAGE_DETAILS_LIST_TAG* telemetry_timeouts[MAX_INFLIGHT_MESSAGES];
+    size_t telemetry_inflight_count;
+    size_t max_inflight_messages;
+    size_t publish_timeout_secs;
+    // With telemetry_linger_ms set, queued messages wait for more to be PUBLISHed along with them
+    size_t telemetry_linger_ms;
+    size_t telemetry_batch_bytes;
+    bool telemetry_lingering;
+    // Set once a burst was let go, so what it leaves queued is not held back again until waitingToSend empties
+    bool telemetry_linger_released;
+    tickcounter_ms_t telemetry_linger_start;
+    IOTHUB_MQTT_PUBLISH_STATISTICS publish_statistics;
     bool auto_url_encode_decode;
+    char topic_inline_buffer[MQTT_TOPIC_INLINE_BUFFER_SIZE];
+    char* topic_buffer;
+    size_t topic_buffer_size;
+    // LRU cache of the encoded topic properties but for the message ids, by property set, enabled by OPTION_MQTT_TOPIC_CACHE_SIZE
+    MQTT_TOPIC_CACHE_ENTRY* topic_cache;
+    size_t topic_cache_size;
+    size_t topic_cache_clock;
+    char* topic_key_buffer;
+    size_t topic_key_buffer_size;
 
     // Controls frequency of reconnection logic.
     RETRY_CONTROL_HANDLE retry_control_handle;
@@ -268,6 +337,8 @@ typedef struct MQTT_MESSAGE_DETAILS_LIST_TAG
     void* context;
     uint16_t packet_id;
     DLIST_ENTRY entry;
+    struct MQTT_MESSAGE_DETAILS_LIST_TAG* next_in_ack_index;
+    size_t timeout_index;
 } MQTT_MESSAGE_DETAILS_LIST, *PMQTT_MESSAGE_DETAILS_LIST;
 
 typedef struct DEVICE_METHOD_INFO_TAG
@@ -357,6 +428,32 @@ static void setSavedTlsOptions(PMQTTTRANSPORT_HANDLE_DATA transport, OPTIONHANDL
     transport->saved_tls_options = new_options;
 }
 
+//
+// freeTopicCache frees the entries of the topic cache and turns it off.
+//
+static void freeTopicCache(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    if (transport_data->topic_cache != NULL)
+    {
+        size_t i;
+        for (i = 0; i < transport_data->topic_cache_size; i++)
+        {
+            // the head and tail share the allocation of the key
+            free(transport_data->topic_cache[i].key);
+        }
+        free(transport_data->topic_cache);
+        transport_data->topic_cache = NULL;
+    }
+    transport_data->topic_cache_size = 0;
+
+    if (transport_data->topic_key_buffer != NULL)
+    {
+        free(transport_data->topic_key_buffer);
+        transport_data->topic_key_buffer = NULL;
+        transport_data->topic_key_buffer_size = 0;
+    }
+}
+
 //
 // freeTransportHandleData free()'s 'the transport_data and all members that were allocated by it.
 //
@@ -391,6 +488,12 @@ static void freeTransportHandleData(MQTTTRANSPORT_HANDLE_DATA* transport_data)
     STRING_delete(transport_data->topic_DeviceMethods);
     STRING_delete(transport_data->topic_InputQueue);
 
+    freeTopicCache(transport_data);
+    if (transport_data->topic_buffer != NULL)
+    {
+        free(transport_data->topic_buffer);
+    }
+
     DestroyXioTransport(transport_data);
 
     free(transport_data);
@@ -612,297 +715,615 @@ static void notifyApplicationOfSendMessageComplete(IOTHUB_MESSAGE_LIST* iothubMs
 }
 
 //
-// addUserPropertiesTouMqttMessage translates application properties in iothub_message_handle (set by the application with IoTHubMessage_SetProperty e.g.)
-// into a representation in the MQTT TOPIC topic_string.
+// getTopicProperties reads from iothub_message_handle everything that goes on its telemetry topic: the application properties (set with
+// IoTHubMessage_SetProperty e.g.), the "system" properties (set with APIs such as IoTHubMessage_SetMessageId), the diagnostic data and the
+// output name. Note that "system" properties is a construct of the SDK and IoT Hub.  The MQTT protocol itself does not assign any significance
+// to system and user properties (as opposed to AMQP).
 //
-static int addUserPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, STRING_HANDLE topic_string, size_t* index_ptr, bool urlencode)
+static int getTopicProperties(IOTHUB_MESSAGE_HANDLE iothub_message_handle, MQTT_TOPIC_PROPERTIES* properties)
 {
     int result = 0;
-    const char* const* propertyKeys;
-    const char* const* propertyValues;
-    size_t propertyCount;
-    size_t index = *index_ptr;
     MAP_HANDLE properties_map = IoTHubMessage_Properties(iothub_message_handle);
-    if (properties_map != NULL)
+
+    memset(properties, 0, sizeof(MQTT_TOPIC_PROPERTIES));
+
+    if (properties_map != NULL && Map_GetInternals(properties_map, &properties->user_keys, &properties->user_values, &properties->user_count) != MAP_OK)
+    {
+        LogError("Failed to get the internals of the property map.");
+        result = MU_FAILURE;
+    }
+    else
     {
-        if (Map_GetInternals(properties_map, &propertyKeys, &propertyValues, &propertyCount) != MAP_OK)
+        const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* diagnosticData;
+
+        properties->is_security_message = IoTHubMessage_IsSecurityMessage(iothub_message_handle);
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_052: [ IoTHubTransport_MQTT_Common_DoWork shall check for the CorrelationId property and if found add the value as a system property in the format of $.cid=<id> ] */
+        properties->correlation_id = IoTHubMessage_GetCorrelationId(iothub_message_handle);
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_053: [ IoTHubTransport_MQTT_Common_DoWork shall check for the MessageId property and if found add the value as a system property in the format of $.mid=<id> ] */
+        properties->message_id = IoTHubMessage_GetMessageId(iothub_message_handle);
+        // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_010: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the ContentType property and if found add the `value` as a system property in the format of `$.ct=<value>` ]
+        properties->content_type = IoTHubMessage_GetContentTypeSystemProperty(iothub_message_handle);
+        // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_011: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the ContentEncoding property and if found add the `value` as a system property in the format of `$.ce=<value>` ]
+        properties->content_encoding = IoTHubMessage_GetContentEncodingSystemProperty(iothub_message_handle);
+        properties->creation_time_utc = IoTHubMessage_GetMessageCreationTimeUtcSystemProperty(iothub_message_handle);
+
+        // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_014: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the diagnostic properties including diagid and diagCreationTimeUtc and if found both add them as system property in the format of `$.diagid` and `$.diagctx` respectively]
+        diagnosticData = IoTHubMessage_GetDiagnosticPropertyData(iothub_message_handle);
+        if (diagnosticData != NULL)
         {
-            LogError("Failed to get the internals of the property map.");
+            properties->diagnostic_id = diagnosticData->diagnosticId;
+            properties->diagnostic_creation_time_utc = diagnosticData->diagnosticCreationTimeUtc;
+        }
+
+        //diagid and creationtimeutc must be present/unpresent simultaneously
+        if ((properties->diagnostic_id == NULL) != (properties->diagnostic_creation_time_utc == NULL))
+        {
+            // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_015: [ `IoTHubTransport_MQTT_Common_DoWork` shall check whether diagid and diagCreationTimeUtc be present simultaneously, treat as error if not]
+            LogError("diagid and diagcreationtimeutc must be present simultaneously.");
             result = MU_FAILURE;
         }
         else
         {
-            if (propertyCount != 0)
-            {
-                for (index = 0; index < propertyCount && result == 0; index++)
-                {
-                    if (urlencode)
-                    {
-                        STRING_HANDLE property_key = URL_EncodeString(propertyKeys[index]);
-                        STRING_HANDLE property_value = URL_EncodeString(propertyValues[index]);
-                        if ((property_key == NULL) || (property_value == NULL))
-                        {
-                            LogError("Failed URL Encoding properties");
-                            result = MU_FAILURE;
-                        }
-                        else if (STRING_sprintf(topic_string, "%s=%s%s", STRING_c_str(property_key), STRING_c_str(property_value), propertyCount - 1 == index ? "" : PROPERTY_SEPARATOR) != 0)
-                        {
-                            LogError("Failed constructing property string.");
-                            result = MU_FAILURE;
-                        }
-                        STRING_delete(property_key);
-                        STRING_delete(property_value);
-                    }
-                    else
-                    {
-                        if (STRING_sprintf(topic_string, "%s=%s%s", propertyKeys[index], propertyValues[index], propertyCount - 1 == index ? "" : PROPERTY_SEPARATOR) != 0)
-                        {
-                            LogError("Failed constructing property string.");
-                            result = MU_FAILURE;
-                        }
-                    }
-                }
-            }
+            // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_060: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the OutputName property and if found add the value as a system property in the format of $.on=<value> ]
+            properties->output_name = IoTHubMessage_GetOutputName(iothub_message_handle);
         }
     }
-    *index_ptr = index;
+
     return result;
 }
 
 //
-// addSystemPropertyToTopicString appends a given "system" property from iothub_message_handle (set by the application with APIs such as IoTHubMessage_SetMessageId,
-// IoTHubMessage_SetContentTypeSystemProperty, etc.) onto the MQTT TOPIC topic_string.
+// appendTopicText writes text at position of destination, URL encoded the same way URL_EncodeString does when urlencode is set, and returns the
+// position after it. When destination is NULL only the position is computed, which is how topic sizes are found before writing them.
 //
-static int addSystemPropertyToTopicString(STRING_HANDLE topic_string, size_t index, const char* property_key, const char* property_value, bool urlencode)
+static size_t appendTopicText(char* destination, size_t position, const char* text, bool urlencode)
 {
-    int result = 0;
+    const unsigned char* iterator;
 
-    if (urlencode)
+    for (iterator = (const unsigned char*)text; *iterator != '\0'; iterator++)
     {
-        STRING_HANDLE encoded_property_value = URL_EncodeString(property_value);
-        if (encoded_property_value == NULL)
+        unsigned char c = *iterator;
+        if (!urlencode || IS_URL_PRINTABLE(c))
         {
-            LogError("Failed URL encoding %s.", property_key);
-            result = MU_FAILURE;
+            if (destination != NULL)
+            {
+                destination[position] = (char)c;
+            }
+            position++;
         }
-        else if (STRING_sprintf(topic_string, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, property_key, STRING_c_str(encoded_property_value)) != 0)
+        else if (c < 0x80)
         {
-            LogError("Failed setting %s.", property_key);
-            result = MU_FAILURE;
+            if (destination != NULL)
+            {
+                destination[position] = '%';
+                destination[position + 1] = NIBBLE_TO_HEX(c >> 4);
+                destination[position + 2] = NIBBLE_TO_HEX(c & 0x0F);
+            }
+            position += 3;
         }
-        STRING_delete(encoded_property_value);
-    }
-    else
-    {
-        if (STRING_sprintf(topic_string, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, property_key, property_value) != 0)
+        else
         {
-            LogError("Failed setting %s.", property_key);
-            result = MU_FAILURE;
+            // Characters past 0x7F are taken as Latin-1 and written as their 2 byte UTF-8 sequence
+            if (destination != NULL)
+            {
+                unsigned char high_nibble = (unsigned char)(c >> 4);
+                destination[position] = '%';
+                destination[position + 1] = 'c';
+                destination[position + 2] = (c < 0xC0) ? '2' : '3';
+                destination[position + 3] = '%';
+                destination[position + 4] = NIBBLE_TO_HEX((high_nibble >= 0x0C) ? high_nibble - 0x04 : high_nibble);
+                destination[position + 5] = NIBBLE_TO_HEX(c & 0x0F);
+            }
+            position += 6;
         }
     }
-    return result;
+
+    return position;
 }
 
 //
-// addSystemPropertyToTopicString appends all "system" property from iothub_message_handle (set by the application with APIs such as IoTHubMessage_SetMessageId,
-// IoTHubMessage_SetContentTypeSystemProperty, etc.) onto the MQTT TOPIC topic_string.
+// appendTopicSystemProperty appends $.property_key=property_value when property_value is set, index counts the properties already written.
 //
-static int addSystemPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, STRING_HANDLE topic_string, size_t* index_ptr, bool urlencode)
+static size_t appendTopicSystemProperty(char* destination, size_t position, size_t* index, const char* property_key, const char* property_value, bool urlencode)
 {
-    int result = 0;
-    size_t index = *index_ptr;
+    if (property_value != NULL)
+    {
+        position = appendTopicText(destination, position, (*index)++ == 0 ? "" : PROPERTY_SEPARATOR, false);
+        position = appendTopicText(destination, position, SYSTEM_PROPERTY_PREFIX, false);
+        position = appendTopicText(destination, position, property_key, false);
+        position = appendTopicText(destination, position, "=", false);
+        position = appendTopicText(destination, position, property_value, urlencode);
+    }
+    return position;
+}
 
-    bool is_security_msg = IoTHubMessage_IsSecurityMessage(iothub_message_handle);
-    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_052: [ IoTHubTransport_MQTT_Common_DoWork shall check for the CorrelationId property and if found add the value as a system property in the format of $.cid=<id> ] */
-    const char* correlation_id = IoTHubMessage_GetCorrelationId(iothub_message_handle);
-    if (correlation_id != NULL)
+//
+// writeTopicUserProperties writes the application properties, the start of the properties part of a telemetry topic, and returns
+// their length. Called with a NULL destination it only returns the length.
+//
+static size_t writeTopicUserProperties(const MQTT_TOPIC_PROPERTIES* properties, bool urlencode, char* destination)
+{
+    size_t position = 0;
+    size_t index;
+
+    for (index = 0; index < properties->user_count; index++)
     {
-        result = addSystemPropertyToTopicString(topic_string, index, CORRELATION_ID_PROPERTY, correlation_id, urlencode);
-        index++;
+        position = appendTopicText(destination, position, index == 0 ? "" : PROPERTY_SEPARATOR, false);
+        position = appendTopicText(destination, position, properties->user_keys[index], urlencode);
+        position = appendTopicText(destination, position, "=", false);
+        position = appendTopicText(destination, position, properties->user_values[index], urlencode);
     }
-    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_053: [ IoTHubTransport_MQTT_Common_DoWork shall check for the MessageId property and if found add the value as a system property in the format of $.mid=<id> ] */
-    if (result == 0)
+
+    return position;
+}
+
+//
+// writeTopicMessageIds appends the correlation and message ids, which follow the application properties.
+//
+static size_t writeTopicMessageIds(const MQTT_TOPIC_PROPERTIES* properties, bool urlencode, char* destination, size_t position, size_t* index)
+{
+    position = appendTopicSystemProperty(destination, position, index, CORRELATION_ID_PROPERTY, properties->correlation_id, urlencode);
+    position = appendTopicSystemProperty(destination, position, index, MESSAGE_ID_PROPERTY, properties->message_id, urlencode);
+    return position;
+}
+
+//
+// writeTopicSystemProperties appends the properties that follow the message ids, up to the end of the topic.
+//
+static size_t writeTopicSystemProperties(const MQTT_TOPIC_PROPERTIES* properties, bool urlencode, char* destination, size_t position, size_t* index)
+{
+    position = appendTopicSystemProperty(destination, position, index, CONTENT_TYPE_PROPERTY, properties->content_type, urlencode);
+    // Security message require content encoding
+    position = appendTopicSystemProperty(destination, position, index, CONTENT_ENCODING_PROPERTY, properties->content_encoding, properties->is_security_message ? true : urlencode);
+    position = appendTopicSystemProperty(destination, position, index, MESSAGE_CREATION_TIME_UTC, properties->creation_time_utc, urlencode);
+    if (properties->is_security_message)
     {
-        const char* msg_id = IoTHubMessage_GetMessageId(iothub_message_handle);
-        if (msg_id != NULL)
-        {
-            result = addSystemPropertyToTopicString(topic_string, index, MESSAGE_ID_PROPERTY, msg_id, urlencode);
-            index++;
-        }
+        // The Security interface Id value must be encoded
+        position = appendTopicSystemProperty(destination, position, index, SECURITY_INTERFACE_ID_MQTT, SECURITY_INTERFACE_ID_VALUE, true);
     }
-    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_010: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the ContentType property and if found add the `value` as a system property in the format of `$.ct=<value>` ]
-    if (result == 0)
+
+    if (properties->diagnostic_id != NULL)
+    {
+        position = appendTopicSystemProperty(destination, position, index, DIAGNOSTIC_ID_PROPERTY, properties->diagnostic_id, false);
+        //diagnostic context is urlencode(key1=value1,key2=value2)
+        position = appendTopicSystemProperty(destination, position, index, DIAGNOSTIC_CONTEXT_PROPERTY, DIAGNOSTIC_CONTEXT_CREATION_TIME_UTC_PROPERTY, true);
+        position = appendTopicText(destination, position, "=", true);
+        position = appendTopicText(destination, position, properties->diagnostic_creation_time_utc, true);
+    }
+
+    if (properties->output_name != NULL)
+    {
+        position = appendTopicSystemProperty(destination, position, index, OUTPUT_NAME_PROPERTY, properties->output_name, false);
+        position = appendTopicText(destination, position, "/", false);
+    }
+
+    return position;
+}
+
+//
+// writeTopicProperties writes the properties part of a telemetry topic in a single pass and returns its length. Called with a NULL
+// destination it only returns the length.
+//
+static size_t writeTopicProperties(const MQTT_TOPIC_PROPERTIES* properties, bool urlencode, char* destination)
+{
+    size_t index = properties->user_count;
+    size_t position = writeTopicUserProperties(properties, urlencode, destination);
+    position = writeTopicMessageIds(properties, urlencode, destination, position, &index);
+    return writeTopicSystemProperties(properties, urlencode, destination, position, &index);
+}
+
+static size_t appendTopicKeyValue(char* destination, size_t position, const char* value)
+{
+    // A presence marker and the terminator of every value keep different property sets from having the same key
+    if (destination != NULL)
+    {
+        destination[position] = (value == NULL) ? '0' : '1';
+    }
+    position++;
+    if (value != NULL)
     {
-        const char* content_type = IoTHubMessage_GetContentTypeSystemProperty(iothub_message_handle);
-        if (content_type != NULL)
+        position = appendTopicText(destination, position, value, false);
+        if (destination != NULL)
         {
-            result = addSystemPropertyToTopicString(topic_string, index, CONTENT_TYPE_PROPERTY, content_type, urlencode);
-            index++;
+            destination[position] = '\0';
         }
+        position++;
     }
-    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_011: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the ContentEncoding property and if found add the `value` as a system property in the format of `$.ce=<value>` ]
-    if (result == 0)
+    return position;
+}
+
+//
+// writeTopicKey writes the raw values of the topic properties cached together, all but the message and correlation ids, and returns
+// their length. Called with a NULL destination it only returns the length.
+//
+static size_t writeTopicKey(const MQTT_TOPIC_PROPERTIES* properties, bool urlencode, char* destination)
+{
+    size_t position = 0;
+    size_t index;
+
+    if (destination != NULL)
+    {
+        destination[position] = (char)('0' + (urlencode ? 1 : 0) + (properties->is_security_message ? 2 : 0));
+    }
+    position++;
+
+    for (index = 0; index < properties->user_count; index++)
     {
-        const char* content_encoding = IoTHubMessage_GetContentEncodingSystemProperty(iothub_message_handle);
-        if (content_encoding != NULL)
+        if (destination != NULL)
         {
-            // Security message require content encoding
-            result = addSystemPropertyToTopicString(topic_string, index, CONTENT_ENCODING_PROPERTY, content_encoding, is_security_msg ? true : urlencode);
-            index++;
+            destination[position] = 'p';
         }
+        position++;
+        position = appendTopicKeyValue(destination, position, properties->user_keys[index]);
+        position = appendTopicKeyValue(destination, position, properties->user_values[index]);
     }
 
-    if (result == 0)
+    position = appendTopicKeyValue(destination, position, properties->content_type);
+    position = appendTopicKeyValue(destination, position, properties->content_encoding);
+    position = appendTopicKeyValue(destination, position, properties->creation_time_utc);
+    position = appendTopicKeyValue(destination, position, properties->diagnostic_id);
+    position = appendTopicKeyValue(destination, position, properties->diagnostic_creation_time_utc);
+    position = appendTopicKeyValue(destination, position, properties->output_name);
+
+    return position;
+}
+
+//
+// reserveTopicBuffer grows *buffer to hold at least size bytes. Buffers are only grown, so steady traffic stops allocating.
+//
+static char* reserveTopicBuffer(char** buffer, size_t* buffer_size, size_t size)
+{
+    char* result;
+
+    if (size <= *buffer_size)
+    {
+        result = *buffer;
+    }
+    else if ((result = (char*)realloc(*buffer, size)) == NULL)
     {
-        const char* message_creation_time_utc = IoTHubMessage_GetMessageCreationTimeUtcSystemProperty(iothub_message_handle);
-        if (message_creation_time_utc != NULL)
+        LogError("Failed growing the topic buffer to %lu bytes", (unsigned long)size);
+    }
+    else
+    {
+        *buffer = result;
+        *buffer_size = size;
+    }
+
+    return result;
+}
+
+//
+// setTopicCacheSize replaces the topic cache with an empty one of cache_size entries, 0 turning it off.
+//
+static int setTopicCacheSize(PMQTTTRANSPORT_HANDLE_DATA transport_data, size_t cache_size)
+{
+    int result;
+
+    if (cache_size > MQTT_TOPIC_CACHE_MAX_SIZE)
+    {
+        LogError("Topic cache size %lu is larger than %lu", (unsigned long)cache_size, (unsigned long)MQTT_TOPIC_CACHE_MAX_SIZE);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        freeTopicCache(transport_data);
+
+        if (cache_size == 0)
         {
-            result = addSystemPropertyToTopicString(topic_string, index, MESSAGE_CREATION_TIME_UTC, message_creation_time_utc, urlencode);
-            index++;
+            result = 0;
+        }
+        else if ((transport_data->topic_cache = (MQTT_TOPIC_CACHE_ENTRY*)malloc(cache_size * sizeof(MQTT_TOPIC_CACHE_ENTRY))) == NULL)
+        {
+            LogError("Failed allocating the topic cache");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            memset(transport_data->topic_cache, 0, cache_size * sizeof(MQTT_TOPIC_CACHE_ENTRY));
+            transport_data->topic_cache_size = cache_size;
+            result = 0;
         }
     }
 
-    if (result == 0)
+    return result;
+}
+
+//
+// getCachedTopicProperties returns the entry of the topic cache holding the properties part of the topic for properties, but for
+// the message ids, encoding it in place of the least recently used entry if it is not cached. Returns NULL if the cache cannot be used.
+//
+static const MQTT_TOPIC_CACHE_ENTRY* getCachedTopicProperties(PMQTTTRANSPORT_HANDLE_DATA transport_data, const MQTT_TOPIC_PROPERTIES* properties)
+{
+    MQTT_TOPIC_CACHE_ENTRY* result = NULL;
+    size_t key_length = writeTopicKey(properties, transport_data->auto_url_encode_decode, NULL);
+    char* key = reserveTopicBuffer(&transport_data->topic_key_buffer, &transport_data->topic_key_buffer_size, key_length);
+
+    if (key != NULL)
     {
-        if (is_security_msg)
+        MQTT_TOPIC_CACHE_ENTRY* victim = &transport_data->topic_cache[0];
+        uint32_t hash = 2166136261u;
+        size_t i;
+
+        (void)writeTopicKey(properties, transport_data->auto_url_encode_decode, key);
+        // FNV-1a
+        for (i = 0; i < key_length; i++)
+        {
+            hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+        }
+
+        for (i = 0; i < transport_data->topic_cache_size; i++)
         {
-            // The Security interface Id value must be encoded
-            if (addSystemPropertyToTopicString(topic_string, index++, SECURITY_INTERFACE_ID_MQTT, SECURITY_INTERFACE_ID_VALUE, true) != 0)
+            MQTT_TOPIC_CACHE_ENTRY* entry = &transport_data->topic_cache[i];
+            if (entry->key != NULL && entry->hash == hash && entry->key_length == key_length && memcmp(entry->key, key, key_length) == 0)
             {
-                LogError("Failed setting Security interface id");
-                result = MU_FAILURE;
+                result = entry;
+                break;
+            }
+            if (entry->key == NULL || (victim->key != NULL && entry->last_used < victim->last_used))
+            {
+                victim = entry;
+            }
+        }
+
+        if (result == NULL)
+        {
+            bool urlencode = transport_data->auto_url_encode_decode;
+            size_t index = 0;
+            size_t head_length = writeTopicUserProperties(properties, urlencode, NULL);
+            size_t tail_length = writeTopicSystemProperties(properties, urlencode, NULL, 0, &index);
+            char* entry_data = (char*)malloc(key_length + head_length + tail_length);
+
+            if (entry_data == NULL)
+            {
+                LogError("Failed allocating a topic cache entry");
             }
             else
             {
-                result = 0;
+                free(victim->key);
+                victim->key = entry_data;
+                victim->key_length = key_length;
+                victim->head = entry_data + key_length;
+                victim->head_length = head_length;
+                victim->tail = victim->head + head_length;
+                victim->tail_length = tail_length;
+                victim->hash = hash;
+                (void)memcpy(victim->key, key, key_length);
+                (void)writeTopicUserProperties(properties, urlencode, victim->head);
+                index = 0;
+                (void)writeTopicSystemProperties(properties, urlencode, victim->tail, 0, &index);
+                result = victim;
             }
         }
+
+        if (result != NULL)
+        {
+            result->last_used = ++transport_data->topic_cache_clock;
+        }
     }
-    *index_ptr = index;
+
     return result;
 }
 
 //
-// addDiagnosticPropertiesTouMqttMessage appends diagnostic data (as specified by IoTHubMessage_SetDiagnosticPropertyData) onto
-// the MQTT topic topic_string.
+// buildTelemetryTopic writes the topic of iothub_message_handle, the event topic followed by the properties of the message, in the
+// topic buffer of the transport and returns it. The topic is valid until the next call.
 //
-static int addDiagnosticPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, STRING_HANDLE topic_string, size_t* index_ptr)
+static const char* buildTelemetryTopic(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE iothub_message_handle)
 {
-    int result = 0;
-    size_t index = *index_ptr;
+    char* result;
+    MQTT_TOPIC_PROPERTIES properties;
+    const char* event_topic = STRING_c_str(transport_data->topic_MqttEvent);
 
-    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_014: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the diagnostic properties including diagid and diagCreationTimeUtc and if found both add them as system property in the format of `$.diagid` and `$.diagctx` respectively]
-    const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* diagnosticData = IoTHubMessage_GetDiagnosticPropertyData(iothub_message_handle);
-    if (diagnosticData != NULL)
+    if (getTopicProperties(iothub_message_handle, &properties) != 0)
     {
-        const char* diag_id = diagnosticData->diagnosticId;
-        const char* creation_time_utc = diagnosticData->diagnosticCreationTimeUtc;
-        //diagid and creationtimeutc must be present/unpresent simultaneously
-        if (diag_id != NULL && creation_time_utc != NULL)
+        LogError("Failed adding Properties to uMQTT Message");
+        result = NULL;
+    }
+    else
+    {
+        bool urlencode = transport_data->auto_url_encode_decode;
+        const MQTT_TOPIC_CACHE_ENTRY* cached = (transport_data->topic_cache != NULL) ? getCachedTopicProperties(transport_data, &properties) : NULL;
+        size_t event_topic_length = strlen(event_topic);
+        size_t suffix_length;
+        size_t topic_size;
+
+        if (cached != NULL)
         {
-            if (STRING_sprintf(topic_string, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, DIAGNOSTIC_ID_PROPERTY, diag_id) != 0)
+            size_t index = properties.user_count;
+            suffix_length = writeTopicMessageIds(&properties, urlencode, NULL, cached->head_length, &index);
+            if (cached->tail_length > 0)
             {
-                LogError("Failed setting diagnostic id");
-                result = MU_FAILURE;
+                suffix_length += ((index == 0) ? 0 : strlen(PROPERTY_SEPARATOR)) + cached->tail_length;
             }
-            index++;
+        }
+        else
+        {
+            suffix_length = writeTopicProperties(&properties, urlencode, NULL);
+        }
+        topic_size = event_topic_length + suffix_length + 1;
+
+        if (topic_size <= sizeof(transport_data->topic_inline_buffer))
+        {
+            result = transport_data->topic_inline_buffer;
+        }
+        else
+        {
+            result = reserveTopicBuffer(&transport_data->topic_buffer, &transport_data->topic_buffer_size, topic_size);
+        }
 
-            if (result == 0)
+        if (result != NULL)
+        {
+            (void)memcpy(result, event_topic, event_topic_length);
+            if (cached != NULL)
             {
-                //construct diagnostic context, it should be urlencode(key1=value1,key2=value2)
-                STRING_HANDLE diagContextHandle = STRING_construct_sprintf("%s=%s", DIAGNOSTIC_CONTEXT_CREATION_TIME_UTC_PROPERTY, creation_time_utc);
-                if (diagContextHandle == NULL)
+                // The ids are written between the cached parts, the separator before the tail going where the first system property would
+                // have written it
+                char* suffix = result + event_topic_length;
+                size_t index = properties.user_count;
+                size_t position;
+
+                (void)memcpy(suffix, cached->head, cached->head_length);
+                position = writeTopicMessageIds(&properties, urlencode, suffix, cached->head_length, &index);
+                if (cached->tail_length > 0)
                 {
-                    LogError("Failed constructing diagnostic context");
-                    result = MU_FAILURE;
-                }
-                else
-                {
-                    //Add other diagnostic context properties here if have more
-                    STRING_HANDLE encodedContextValueHandle = URL_Encode(diagContextHandle);
-                    const char* encodedContextValueString = NULL;
-                    if (encodedContextValueHandle != NULL &&
-                        (encodedContextValueString = STRING_c_str(encodedContextValueHandle)) != NULL)
-                    {
-                        if (STRING_sprintf(topic_string, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, DIAGNOSTIC_CONTEXT_PROPERTY, encodedContextValueString) != 0)
-                        {
-                            LogError("Failed setting diagnostic context");
-                            result = MU_FAILURE;
-                        }
-                        STRING_delete(encodedContextValueHandle);
-                        encodedContextValueHandle = NULL;
-                    }
-                    else
-                    {
-                        LogError("Failed encoding diagnostic context value");
-                        result = MU_FAILURE;
-                    }
-                    STRING_delete(diagContextHandle);
-                    diagContextHandle = NULL;
-                    index++;
+                    position = appendTopicText(suffix, position, (index == 0) ? "" : PROPERTY_SEPARATOR, false);
+                    (void)memcpy(suffix + position, cached->tail, cached->tail_length);
                 }
             }
+            else
+            {
+                (void)writeTopicProperties(&properties, urlencode, result + event_topic_length);
+            }
+            result[event_topic_length + suffix_length] = '\0';
         }
-        else if (diag_id != NULL || creation_time_utc != NULL)
+    }
+
+    return result;
+}
+
+//
+// swapTelemetryTimeouts exchanges two entries of the telemetry timeout heap.
+//
+static void swapTelemetryTimeouts(PMQTTTRANSPORT_HANDLE_DATA transport_data, size_t first, size_t second)
+{
+    MQTT_MESSAGE_DETAILS_LIST* msg_entry = transport_data->telemetry_timeouts[first];
+    transport_data->telemetry_timeouts[first] = transport_data->telemetry_timeouts[second];
+    transport_data->telemetry_timeouts[second] = msg_entry;
+    transport_data->telemetry_timeouts[first]->timeout_index = first;
+    transport_data->telemetry_timeouts[second]->timeout_index = second;
+}
+
+//
+// siftTelemetryTimeout moves the entry at index of the telemetry timeout heap up or down until no parent was published later
+// and no child earlier than it.
+//
+static void siftTelemetryTimeout(PMQTTTRANSPORT_HANDLE_DATA transport_data, size_t index)
+{
+    MQTT_MESSAGE_DETAILS_LIST** heap = transport_data->telemetry_timeouts;
+    size_t count = transport_data->telemetry_inflight_count;
+
+    while (index > 0 && heap[index]->msgPublishTime < heap[(index - 1) / 2]->msgPublishTime)
+    {
+        swapTelemetryTimeouts(transport_data, index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+
+    while (true)
+    {
+        size_t earliest = index;
+        size_t child = (2 * index) + 1;
+
+        if (child < count && heap[child]->msgPublishTime < heap[earliest]->msgPublishTime)
         {
-            // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_015: [ `IoTHubTransport_MQTT_Common_DoWork` shall check whether diagid and diagCreationTimeUtc be present simultaneously, treat as error if not]
-            LogError("diagid and diagcreationtimeutc must be present simultaneously.");
-            result = MU_FAILURE;
+            earliest = child;
+        }
+        child++;
+        if (child < count && heap[child]->msgPublishTime < heap[earliest]->msgPublishTime)
+        {
+            earliest = child;
         }
+
+        if (earliest == index)
+        {
+            break;
+        }
+        swapTelemetryTimeouts(transport_data, index, earliest);
+        index = earliest;
     }
-    return result;
 }
 
 //
-// addPropertiesTouMqttMessage adds user, "system", and diagnostic messages onto MQTT topic string.  Note that "system" properties is a
-// construct of the SDK and IoT Hub.  The MQTT protocol itself does not assign any significance to system and user properties (as opposed to AMQP).
-// The IOTHUB_MESSAGE_HANDLE structure however does have well-known properties (e.g. IoTHubMessage_SetMessageId) that the SDK treats as system
-// properties where we can automatically fill in the key value for in the key=value list.
+// addInflightTelemetry starts tracking a PUBLISHed telemetry message until its PUBACK arrives.  The caller makes sure
+// there is room for it (telemetry_inflight_count < MAX_INFLIGHT_MESSAGES).
 //
-static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, const char* eventTopic, bool urlencode)
+static void addInflightTelemetry(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* msg_entry)
 {
-    size_t index = 0;
-    STRING_HANDLE result = STRING_construct(eventTopic);
-    if (result == NULL)
+    size_t bucket = msg_entry->packet_id % ACK_INDEX_SIZE;
+
+    DList_InsertTailList(&(transport_data->telemetry_waitingForAck), &(msg_entry->entry));
+
+    msg_entry->next_in_ack_index = transport_data->telemetry_ack_index[bucket];
+    transport_data->telemetry_ack_index[bucket] = msg_entry;
+
+    msg_entry->timeout_index = transport_data->telemetry_inflight_count;
+    transport_data->telemetry_timeouts[transport_data->telemetry_inflight_count] = msg_entry;
+    transport_data->telemetry_inflight_count++;
+    siftTelemetryTimeout(transport_data, msg_entry->timeout_index);
+
+    if (transport_data->telemetry_inflight_count > transport_data->publish_statistics.max_in_flight)
     {
-        LogError("Failed to create event topic string handle");
+        transport_data->publish_statistics.max_in_flight = transport_data->telemetry_inflight_count;
     }
-    else if (addUserPropertiesTouMqttMessage(iothub_message_handle, result, &index, urlencode) != 0)
+}
+
+//
+// removeInflightTelemetry stops tracking a telemetry message added by addInflightTelemetry.
+//
+static void removeInflightTelemetry(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* msg_entry)
+{
+    MQTT_MESSAGE_DETAILS_LIST** link = &transport_data->telemetry_ack_index[msg_entry->packet_id % ACK_INDEX_SIZE];
+    size_t last;
+
+    (void)DList_RemoveEntryList(&(msg_entry->entry));
+
+    while (*link != NULL && *link != msg_entry)
     {
-        LogError("Failed adding Properties to uMQTT Message");
-        STRING_delete(result);
-        result = NULL;
+        link = &(*link)->next_in_ack_index;
     }
-    else if (addSystemPropertiesTouMqttMessage(iothub_message_handle, result, &index, urlencode) != 0)
+    if (*link != NULL)
     {
-        LogError("Failed adding System Properties to uMQTT Message");
-        STRING_delete(result);
-        result = NULL;
+        *link = msg_entry->next_in_ack_index;
     }
-    else if (addDiagnosticPropertiesTouMqttMessage(iothub_message_handle, result, &index) != 0)
+
+    transport_data->telemetry_inflight_count--;
+    last = transport_data->telemetry_inflight_count;
+    if (msg_entry->timeout_index != last)
     {
-        LogError("Failed adding Diagnostic Properties to uMQTT Message");
-        STRING_delete(result);
-        result = NULL;
+        transport_data->telemetry_timeouts[msg_entry->timeout_index] = transport_data->telemetry_timeouts[last];
+        transport_data->telemetry_timeouts[msg_entry->timeout_index]->timeout_index = msg_entry->timeout_index;
+        siftTelemetryTimeout(transport_data, msg_entry->timeout_index);
     }
+}
+
+//
+// findInflightTelemetry returns the telemetry message PUBLISHed with packet_id, or NULL if none is waiting for its PUBACK.
+//
+static MQTT_MESSAGE_DETAILS_LIST* findInflightTelemetry(PMQTTTRANSPORT_HANDLE_DATA transport_data, uint16_t packet_id)
+{
+    MQTT_MESSAGE_DETAILS_LIST* msg_entry = transport_data->telemetry_ack_index[packet_id % ACK_INDEX_SIZE];
+
+    while (msg_entry != NULL && msg_entry->packet_id != packet_id)
+    {
+        msg_entry = msg_entry->next_in_ack_index;
+    }
+
+    return msg_entry;
+}
+
+//
+// recordPubAckLatency adds the time since the last PUBLISH of msg_entry to the PUBACK latency histogram.
+//
+static void recordPubAckLatency(PMQTTTRANSPORT_HANDLE_DATA transport_data, const MQTT_MESSAGE_DETAILS_LIST* msg_entry)
+{
+    tickcounter_ms_t current_ms;
 
-    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_060: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the OutputName property and if found add the value as a system property in the format of $.on=<value> ]
-    if (result != NULL)
+    if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) != 0)
     {
-        const char* output_name = IoTHubMessage_GetOutputName(iothub_message_handle);
-        if (output_name != NULL)
+        LogError("Failed retrieving tickcounter info");
+    }
+    else
+    {
+        tickcounter_ms_t latency_ms = (current_ms > msg_entry->msgPublishTime) ? (current_ms - msg_entry->msgPublishTime) : 0;
+        size_t bucket = 0;
+
+        while (bucket < (IOTHUB_MQTT_PUBACK_LATENCY_BUCKET_COUNT - 1) &&
+            latency_ms >= ((tickcounter_ms_t)IOTHUB_MQTT_PUBACK_LATENCY_FIRST_BUCKET_MS << bucket))
         {
-            if (STRING_sprintf(result, "%s%%24.on=%s/", index == 0 ? "" : PROPERTY_SEPARATOR, output_name) != 0)
-            {
-                LogError("Failed setting output name.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            index++;
+            bucket++;
         }
+        transport_data->publish_statistics.puback_latency_ms[bucket]++;
     }
-
-    return result;
+    transport_data->publish_statistics.pubacks++;
 }
 
 //
@@ -911,7 +1332,7 @@ static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_me
 static int publishTelemetryMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
 {
     int result;
-    STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(mqttMsgEntry->iotHubMessageEntry->messageHandle, STRING_c_str(transport_data->topic_MqttEvent), transport_data->auto_url_encode_decode);
+    const char* msgTopic = buildTelemetryTopic(transport_data, mqttMsgEntry->iotHubMessageEntry->messageHandle);
     if (msgTopic == NULL)
     {
         LogError("Failed adding properties to mqtt message");
@@ -919,7 +1340,7 @@ static int publishTelemetryMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_M
     }
     else
     {
-        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create_in_place(mqttMsgEntry->packet_id, STRING_c_str(msgTopic), DELIVER_AT_LEAST_ONCE, payload, len);
+        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create_in_place(mqttMsgEntry->packet_id, msgTopic, DELIVER_AT_LEAST_ONCE, payload, len);
         if (mqttMsg == NULL)
         {
             LogError("Failed creating mqtt message");
@@ -947,7 +1368,6 @@ static int publishTelemetryMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_M
             }
             mqttmessage_destroy(mqttMsg);
         }
-        STRING_delete(msgTopic);
     }
     return result;
 }
@@ -1848,20 +2268,13 @@ static void mqttOperationCompleteCallback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT
                 const PUBLISH_ACK* puback = (const PUBLISH_ACK*)msgInfo;
                 if (puback != NULL)
                 {
-                    PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
-                    while (currentListEntry != &transport_data->telemetry_waitingForAck)
+                    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = findInflightTelemetry(transport_data, puback->packetId);
+                    if (mqttMsgEntry != NULL)
                     {
-                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                        DLIST_ENTRY saveListEntry;
-                        saveListEntry.Flink = currentListEntry->Flink;
-
-                        if (puback->packetId == mqttMsgEntry->packet_id)
-                        {
-                            (void)DList_RemoveEntryList(currentListEntry); //First remove the item from Waiting for Ack List.
-                            notifyApplicationOfSendMessageComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
-                            free(mqttMsgEntry);
-                        }
-                        currentListEntry = saveListEntry.Flink;
+                        recordPubAckLatency(transport_data, mqttMsgEntry);
+                        removeInflightTelemetry(transport_data, mqttMsgEntry); //First remove the item from Waiting for Ack List.
+                        notifyApplicationOfSendMessageComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
+                        free(mqttMsgEntry);
                     }
                 }
                 else
@@ -2221,70 +2634,70 @@ static bool RetrieveMessagePayload(IOTHUB_MESSAGE_HANDLE messageHandle, const un
 }
 
 //
-// ProcessPendingTelemetryMessages examines each telemetry message the device/module has sent that hasn't yet been PUBACK'd.
-// For each message, it might:
-// * Ignore it, if its timeout has not yet been reached.
+// ProcessPendingTelemetryMessages examines the telemetry messages the device/module has sent that haven't yet been PUBACK'd,
+// earliest PUBLISH first, until it reaches one whose timeout has not been reached.  For each timed out message, it might:
 // * Attempt to retry PUBLISH the message, if has remaining retries left.
 // * Stop attempting to send the message.  This will result in tearing down the underlying MQTT/TCP connection because it indicates
 //   something is wrong.
 //
 static void ProcessPendingTelemetryMessages(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 {
-    PDLIST_ENTRY current_entry = transport_data->telemetry_waitingForAck.Flink;
     tickcounter_ms_t current_ms;
     (void)tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms);
-    while (current_entry != &transport_data->telemetry_waitingForAck)
+    while (transport_data->telemetry_inflight_count > 0)
     {
-        MQTT_MESSAGE_DETAILS_LIST* msg_detail_entry = containingRecord(current_entry, MQTT_MESSAGE_DETAILS_LIST, entry);
-        DLIST_ENTRY nextListEntry;
-        nextListEntry.Flink = current_entry->Flink;
+        MQTT_MESSAGE_DETAILS_LIST* msg_detail_entry = transport_data->telemetry_timeouts[0];
 
-        if (((current_ms - msg_detail_entry->msgPublishTime) / 1000) > RESEND_TIMEOUT_VALUE_MIN)
+        // Messages PUBLISHed again below are stamped after current_ms, so each one is visited at most once
+        if (msg_detail_entry->msgPublishTime > current_ms ||
+            ((current_ms - msg_detail_entry->msgPublishTime) / 1000) <= transport_data->publish_timeout_secs)
         {
-            if (msg_detail_entry->retryCount >= MAX_SEND_RECOUNT_LIMIT)
+            break;
+        }
+        else if (msg_detail_entry->retryCount >= MAX_SEND_RECOUNT_LIMIT)
+        {
+            notifyApplicationOfSendMessageComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
+            removeInflightTelemetry(transport_data, msg_detail_entry);
+            free(msg_detail_entry);
+            transport_data->publish_statistics.timeouts++;
+
+            DisconnectFromClient(transport_data);
+            if (!transport_data->isRetryExpiredCallbackCalled) // Only call once
+            {
+                transport_data->transport_callbacks.connection_status_cb(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED, transport_data->transport_ctx);
+                transport_data->isRetryExpiredCallbackCalled = true;
+            }
+        }
+        else if (transport_data->currPacketState == PUBLISH_TYPE)
+        {
+            // Ensure that the packet state is PUBLISH_TYPE and then attempt to send the message
+            // again
+            size_t messageLength;
+            const unsigned char* messagePayload = NULL;
+            if (!RetrieveMessagePayload(msg_detail_entry->iotHubMessageEntry->messageHandle, &messagePayload, &messageLength))
             {
-                notifyApplicationOfSendMessageComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
-                (void)DList_RemoveEntryList(current_entry);
+                removeInflightTelemetry(transport_data, msg_detail_entry);
+                notifyApplicationOfSendMessageComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+                free(msg_detail_entry);
+            }
+            else if (publishTelemetryMsg(transport_data, msg_detail_entry, messagePayload, messageLength) != 0)
+            {
+                removeInflightTelemetry(transport_data, msg_detail_entry);
+                notifyApplicationOfSendMessageComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
                 free(msg_detail_entry);
-
-                DisconnectFromClient(transport_data);
-                if (!transport_data->isRetryExpiredCallbackCalled) // Only call once
-                {
-                    transport_data->transport_callbacks.connection_status_cb(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED, transport_data->transport_ctx);
-                    transport_data->isRetryExpiredCallbackCalled = true;
-                }
             }
             else
             {
-                // Ensure that the packet state is PUBLISH_TYPE and then attempt to send the message
-                // again
-                if (transport_data->currPacketState == PUBLISH_TYPE)
-                {
-                    size_t messageLength;
-                    const unsigned char* messagePayload = NULL;
-                    if (!RetrieveMessagePayload(msg_detail_entry->iotHubMessageEntry->messageHandle, &messagePayload, &messageLength))
-                    {
-                        (void)DList_RemoveEntryList(current_entry);
-                        notifyApplicationOfSendMessageComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
-                    }
-                    else
-                    {
-                        if (publishTelemetryMsg(transport_data, msg_detail_entry, messagePayload, messageLength) != 0)
-                        {
-                            (void)DList_RemoveEntryList(current_entry);
-                            notifyApplicationOfSendMessageComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
-                            free(msg_detail_entry);
-                        }
-                    }
-                }
-                else
-                {
-                    msg_detail_entry->retryCount++;
-                    msg_detail_entry->msgPublishTime = current_ms;
-                }
+                transport_data->publish_statistics.resends++;
+                siftTelemetryTimeout(transport_data, msg_detail_entry->timeout_index);
             }
         }
-        current_entry = nextListEntry.Flink;
+        else
+        {
+            msg_detail_entry->retryCount++;
+            msg_detail_entry->msgPublishTime = current_ms;
+            siftTelemetryTimeout(transport_data, msg_detail_entry->timeout_index);
+        }
     }
 }
 
@@ -2866,6 +3279,9 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
                         state->currPacketState = CONNECT_TYPE;
                         state->keepAliveValue = DEFAULT_MQTT_KEEPALIVE;
                         state->connect_timeout_in_sec = DEFAULT_CONNACK_TIMEOUT;
+                        state->max_inflight_messages = MAX_INFLIGHT_MESSAGES;
+                        state->publish_timeout_secs = RESEND_TIMEOUT_VALUE_MIN;
+                        state->telemetry_batch_bytes = DEFAULT_TELEMETRY_BATCH_BYTES;
                         state->topics_ToSubscribe = UNSUBSCRIBE_FROM_TOPIC;
                         srand((unsigned int)get_time(NULL));
                         state->authorization_module = auth_module;
@@ -2930,11 +3346,86 @@ static void ProcessSubackDoWork(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 //
 // ProcessPublishStateDoWork traverses all messages waiting to be sent and attempts to PUBLISH them.
 //
+// MQTT has no batch frame, so lingering only holds the PUBLISHes back until they can go out in one burst, once
+// telemetry_linger_ms have passed since the first of them was seen or telemetry_batch_bytes of payload that fit in
+// the in-flight window are waiting. The messages the burst leaves queued go out as soon as PUBACKs make room for them.
+static bool IsTelemetryLingering(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    bool result;
+    tickcounter_ms_t current_ms;
+
+    if (transport_data->telemetry_linger_ms == 0)
+    {
+        result = false;
+    }
+    else if (DList_IsListEmpty(transport_data->waitingToSend))
+    {
+        transport_data->telemetry_lingering = false;
+        transport_data->telemetry_linger_released = false;
+        result = false;
+    }
+    else if (transport_data->telemetry_linger_released)
+    {
+        result = false;
+    }
+    else if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) != 0)
+    {
+        LogError("Failure getting the current time; telemetry is sent without lingering");
+        result = false;
+    }
+    else
+    {
+        if (!transport_data->telemetry_lingering)
+        {
+            transport_data->telemetry_lingering = true;
+            transport_data->telemetry_linger_start = current_ms;
+        }
+
+        if ((current_ms - transport_data->telemetry_linger_start) >= transport_data->telemetry_linger_ms)
+        {
+            result = false;
+        }
+        else
+        {
+            PDLIST_ENTRY currentListEntry = transport_data->waitingToSend->Flink;
+            size_t waitingBytes = 0;
+            size_t publishable = (transport_data->telemetry_inflight_count < transport_data->max_inflight_messages) ?
+                transport_data->max_inflight_messages - transport_data->telemetry_inflight_count : 0;
+
+            while (currentListEntry != transport_data->waitingToSend && waitingBytes < transport_data->telemetry_batch_bytes && publishable > 0)
+            {
+                IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(currentListEntry, IOTHUB_MESSAGE_LIST, entry);
+                const unsigned char* messagePayload;
+                size_t messageLength;
+
+                if (RetrieveMessagePayload(iothubMsgList->messageHandle, &messagePayload, &messageLength))
+                {
+                    waitingBytes += messageLength;
+                }
+                publishable--;
+                currentListEntry = currentListEntry->Flink;
+            }
+
+            result = (waitingBytes < transport_data->telemetry_batch_bytes);
+        }
+
+        if (!result)
+        {
+            transport_data->telemetry_linger_released = true;
+        }
+    }
+
+    return result;
+}
+
 static void ProcessPublishStateDoWork(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 {
     PDLIST_ENTRY currentListEntry = transport_data->waitingToSend->Flink;
+    bool lingering = IsTelemetryLingering(transport_data);
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_027: [IoTHubTransport_MQTT_Common_DoWork shall inspect the "waitingToSend" DLIST passed in config structure.] */
-    while (currentListEntry != transport_data->waitingToSend)
+    // Messages beyond the in-flight window stay in waitingToSend (keeping the send status BUSY) until PUBACKs make room
+    while (!lingering && currentListEntry != transport_data->waitingToSend &&
+        transport_data->telemetry_inflight_count < transport_data->max_inflight_messages)
     {
         IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(currentListEntry, IOTHUB_MESSAGE_LIST, entry);
         DLIST_ENTRY savedFromCurrentListEntry;
@@ -2973,13 +3464,20 @@ static void ProcessPublishStateDoWork(PMQTTTRANSPORT_HANDLE_DATA transport_data)
                     // Remove the message from the waiting queue ...
                     (void)(DList_RemoveEntryList(currentListEntry));
                     // and add it to the ack queue
-                    DList_InsertTailList(&(transport_data->telemetry_waitingForAck), &(mqttMsgEntry->entry));
+                    addInflightTelemetry(transport_data, mqttMsgEntry);
                 }
             }
         }
         currentListEntry = savedFromCurrentListEntry.Flink;
     }
 
+    // The next message queued after the burst has gone out starts a new linger window
+    if (transport_data->telemetry_linger_released && DList_IsListEmpty(transport_data->waitingToSend))
+    {
+        transport_data->telemetry_lingering = false;
+        transport_data->telemetry_linger_released = false;
+    }
+
     if (transport_data->twin_resp_sub_recv)
     {
         sendPendingGetTwinRequests(transport_data);
@@ -3600,6 +4098,58 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
             transport_data->auto_url_encode_decode = *((bool*)value);
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(OPTION_MQTT_TOPIC_CACHE_SIZE, option) == 0)
+        {
+            if (setTopicCacheSize(transport_data, *((size_t*)value)) != 0)
+            {
+                LogError("Failed setting the topic cache size");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_MQTT_MAX_INFLIGHT_MESSAGES, option) == 0)
+        {
+            size_t max_inflight_messages = *((size_t*)value);
+            if (max_inflight_messages == 0 || max_inflight_messages > MAX_INFLIGHT_MESSAGES)
+            {
+                LogError("Invalid in-flight message count %lu, must be between 1 and %d", (unsigned long)max_inflight_messages, MAX_INFLIGHT_MESSAGES);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_data->max_inflight_messages = max_inflight_messages;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_MQTT_PUBLISH_TIMEOUT_SECS, option) == 0)
+        {
+            size_t publish_timeout_secs = *((size_t*)value);
+            if (publish_timeout_secs == 0)
+            {
+                LogError("Invalid publish timeout, must be greater than 0");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_data->publish_timeout_secs = publish_timeout_secs;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(OPTION_TELEMETRY_LINGER_MS, option) == 0)
+        {
+            transport_data->telemetry_linger_ms = *((size_t*)value);
+            transport_data->telemetry_lingering = false;
+            transport_data->telemetry_linger_released = false;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_TELEMETRY_BATCH_BYTES, option) == 0)
+        {
+            transport_data->telemetry_batch_bytes = *((size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
         else if (strcmp(OPTION_CONNECTION_TIMEOUT, option) == 0)
         {
             int* connection_time = (int*)value;
@@ -3841,6 +4391,30 @@ void IoTHubTransport_MQTT_Common_Unregister(TRANSPORT_LL_HANDLE deviceHandle)
     }
 }
 
+IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_GetOption(TRANSPORT_LL_HANDLE handle, const char* option, void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (handle == NULL || option == NULL || value == NULL)
+    {
+        LogError("Invalid parameter specified handle: %p, option: %p, value: %p", handle, option, value);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (strcmp(OPTION_MQTT_PUBLISH_STATISTICS, option) == 0)
+    {
+        PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
+        IOTHUB_MQTT_PUBLISH_STATISTICS* publish_statistics = (IOTHUB_MQTT_PUBLISH_STATISTICS*)value;
+        *publish_statistics = transport_data->publish_statistics;
+        publish_statistics->in_flight = transport_data->telemetry_inflight_count;
+        result = IOTHUB_CLIENT_OK;
+    }
+    else
+    {
+        LogError("Unknown option: %s", option);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    return result;
+}
+
 STRING_HANDLE IoTHubTransport_MQTT_Common_GetHostname(TRANSPORT_LL_HANDLE handle)
 {
     STRING_HANDLE result;
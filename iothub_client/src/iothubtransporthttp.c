@@ -2,6 +2,9 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <time.h>
@@ -21,11 +24,14 @@
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/strings.h"
-#include "azure_c_shared_utility/azure_base64.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/shared_util_options.h"
 
 #define IOTHUB_APP_PREFIX "iothub-app-"
 static const char* IOTHUB_MESSAGE_ID = "iothub-messageid";
@@ -53,15 +59,61 @@ static const char* IOTHUB_AUTH_HEADER_VALUE = "Authorization";
 #define MAXIMUM_PAYLOAD_OVERHEAD 384
 #define MAXIMUM_PROPERTY_OVERHEAD 16
 
-/*forward declaration*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count);
+/*connections to the IoT Hub a transport can keep open at the same time (OPTION_HTTP_CONNECTIONS)*/
+#define MAXIMUM_HTTP_CONNECTIONS 8
+
+/*with adaptive polling (OPTION_MAX_POLLING_TIME), every polling interval is stretched by a random amount of up to this percent*/
+#define POLLING_JITTER_PERCENT 10
+
+/*an idle HTTP worker waits this long for the exchanges of the next DoWork before checking whether its connection is being closed*/
+#define HTTP_EXCHANGE_WORKER_MAX_WAIT_MS 1000
+/*DoWork checks this often whether the pooled connections are done with the exchanges it handed them*/
+#define HTTP_EXCHANGES_MAX_WAIT_MS 100
+
+/*an option passed down to HTTPAPIEX, kept to be set again on connections opened later*/
+typedef struct HTTP_SAVED_OPTION_TAG
+{
+    const void* value;
+    struct HTTP_SAVED_OPTION_TAG* next;
+    char name[1];
+} HTTP_SAVED_OPTION;
+
+/*the exchanges of the DoWork in progress, shared by the DoWork thread and the workers of the pooled connections*/
+typedef struct HTTP_EXCHANGE_QUEUE_TAG
+{
+    struct HTTP_EXCHANGE_TAG* exchanges;
+    size_t count;
+    size_t next;
+    bool stop;
+    LOCK_HANDLE lock;
+    COND_HANDLE exchangesQueued;
+    COND_HANDLE exchangesExecuted;
+} HTTP_EXCHANGE_QUEUE;
+
+/*a thread executing exchanges over one pooled connection, started with the connection and stopped when it is closed*/
+typedef struct HTTP_EXCHANGE_WORKER_TAG
+{
+    HTTP_EXCHANGE_QUEUE* queue;
+    HTTPAPIEX_HANDLE connection;
+    THREAD_HANDLE thread;
+} HTTP_EXCHANGE_WORKER;
 
 typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
 {
     STRING_HANDLE hostName;
     HTTPAPIEX_HANDLE httpApiExHandle;
+    /*connections opened besides httpApiExHandle when OPTION_HTTP_CONNECTIONS is above 1, kept open from one DoWork to the next*/
+    HTTPAPIEX_HANDLE pooledConnections[MAXIMUM_HTTP_CONNECTIONS - 1];
+    size_t connectionCount;
+    /*exchangeWorkers[i] executes exchanges over pooledConnections[i]*/
+    HTTP_EXCHANGE_WORKER exchangeWorkers[MAXIMUM_HTTP_CONNECTIONS - 1];
+    size_t exchangeWorkerCount;
+    HTTP_EXCHANGE_QUEUE exchangeQueue;
+    HTTP_SAVED_OPTION* savedOptions;
     bool doBatchedTransfers;
     unsigned int getMinimumPollingTime;
+    unsigned int getMaximumPollingTime;
+    IOTHUB_HTTP_POLLING_STATISTICS pollingStatistics;
     VECTOR_HANDLE perDeviceList;
 
     TRANSPORT_CALLBACKS_INFO transport_callbacks;
@@ -85,6 +137,9 @@ typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
     bool DoWork_PullMessage;
     time_t lastPollTime;
     bool isFirstPoll;
+    /*adaptive polling: seconds between the GETs of the device, and the same plus jitter, which is what the next GET waits for*/
+    unsigned int pollingInterval;
+    unsigned int pollingDelay;
 
     void* device_transport_ctx;
     PDLIST_ENTRY waitingToSend;
@@ -98,6 +153,27 @@ typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG
     char* etagValue;
 } MESSAGE_DISPOSITION_CONTEXT;
 
+/*an event POST or a C2D GET of a device. It is prepared and completed on the thread calling DoWork, but with more than
+one connection it is executed by whichever connection is free first*/
+typedef struct HTTP_EXCHANGE_TAG
+{
+    HTTPTRANSPORT_PERDEVICE_DATA* deviceData;
+    HTTPAPI_REQUEST_TYPE requestType;
+    const char* relativePath;
+    HTTP_HEADERS_HANDLE requestHeaders;
+    BUFFER_HANDLE requestContent;
+    HTTP_HEADERS_HANDLE responseHeaders;
+    BUFFER_HANDLE responseContent;
+    bool useSasObject;
+    bool isBatch;
+    time_t pollTime;
+    unsigned int statusCode;
+    HTTPAPIEX_RESULT result;
+    /*set, without the queue lock, by the thread that executed the exchange, so that it counts even when that thread cannot
+    take the lock back*/
+    sig_atomic_t executed;
+} HTTP_EXCHANGE;
+
 MU_DEFINE_ENUM_STRINGS_WITHOUT_INVALID(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_DISPOSITION_RESULT_VALUES);
 
 static void destroy_eventHTTPrelativePath(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
@@ -837,6 +913,8 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_128: [ IoTHubTransportHttp_Register shall mark this device as unsubscribed. ]*/
                 result->DoWork_PullMessage = false;
                 result->isFirstPoll = true;
+                result->pollingInterval = 0;
+                result->pollingDelay = 0;
                 result->waitingToSend = waitingToSend;
                 DList_InitializeListHead(&(result->eventConfirmations));
                 result->transportHandle = (HTTPTRANSPORT_HANDLE_DATA *)handle;
@@ -1023,6 +1101,422 @@ static bool create_perDeviceList(HTTPTRANSPORT_HANDLE_DATA* handleData)
     return result;
 }
 
+static void freeSavedOptionValue(const char* optionName, const void* value)
+{
+    /*HTTPAPI_CloneOption copies the strings of the proxy options too*/
+    if (strcmp(optionName, OPTION_HTTP_PROXY) == 0)
+    {
+        HTTP_PROXY_OPTIONS* proxyOptions = (HTTP_PROXY_OPTIONS*)value;
+        free((void*)proxyOptions->host_address);
+        free((void*)proxyOptions->username);
+        free((void*)proxyOptions->password);
+    }
+    free((void*)value);
+}
+
+static void destroy_savedOptions(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    while (handleData->savedOptions != NULL)
+    {
+        HTTP_SAVED_OPTION* savedOption = handleData->savedOptions;
+        handleData->savedOptions = savedOption->next;
+        freeSavedOptionValue(savedOption->name, savedOption->value);
+        free(savedOption);
+    }
+}
+
+/*saveOption keeps a copy of an option set on httpApiExHandle, replacing the one saved earlier under the same name*/
+static int saveOption(HTTPTRANSPORT_HANDLE_DATA* handleData, const char* optionName, const void* value)
+{
+    int result;
+    const void* savedValue;
+
+    if (HTTPAPI_CloneOption(optionName, value, &savedValue) != HTTPAPI_OK)
+    {
+        LogError("unable to HTTPAPI_CloneOption %s", optionName);
+        result = MU_FAILURE;
+    }
+    else
+    {
+        HTTP_SAVED_OPTION** last = &handleData->savedOptions;
+        while ((*last != NULL) && (strcmp((*last)->name, optionName) != 0))
+        {
+            last = &(*last)->next;
+        }
+
+        if (*last != NULL)
+        {
+            freeSavedOptionValue(optionName, (*last)->value);
+            (*last)->value = savedValue;
+            result = 0;
+        }
+        else
+        {
+            size_t nameLength = strlen(optionName);
+            HTTP_SAVED_OPTION* savedOption = (HTTP_SAVED_OPTION*)malloc(sizeof(HTTP_SAVED_OPTION) + nameLength);
+            if (savedOption == NULL)
+            {
+                LogError("unable to malloc the saved option %s", optionName);
+                freeSavedOptionValue(optionName, savedValue);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                (void)memcpy(savedOption->name, optionName, nameLength + 1);
+                savedOption->value = savedValue;
+                savedOption->next = NULL;
+                *last = savedOption;
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*setPassthroughOption sets an option of the lower layer on every connection of the transport, and keeps it for the connections opened later*/
+static HTTPAPIEX_RESULT setPassthroughOption(HTTPTRANSPORT_HANDLE_DATA* handleData, const char* optionName, const void* value)
+{
+    HTTPAPIEX_RESULT result = HTTPAPIEX_SetOption(handleData->httpApiExHandle, optionName, value);
+    size_t i;
+
+    for (i = 0; (result == HTTPAPIEX_OK) && (i + 1 < handleData->connectionCount); i++)
+    {
+        result = HTTPAPIEX_SetOption(handleData->pooledConnections[i], optionName, value);
+    }
+
+    if ((result == HTTPAPIEX_OK) && (saveOption(handleData, optionName, value) != 0))
+    {
+        result = HTTPAPIEX_ERROR;
+    }
+
+    return result;
+}
+
+/*createPooledConnection opens a connection set up with the options set so far on httpApiExHandle*/
+static HTTPAPIEX_HANDLE createPooledConnection(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    HTTPAPIEX_HANDLE result = HTTPAPIEX_Create(STRING_c_str(handleData->hostName));
+    if (result == NULL)
+    {
+        LogError("unable to HTTPAPIEX_Create");
+    }
+    else
+    {
+        HTTP_SAVED_OPTION* savedOption;
+        for (savedOption = handleData->savedOptions; savedOption != NULL; savedOption = savedOption->next)
+        {
+            if (HTTPAPIEX_SetOption(result, savedOption->name, savedOption->value) != HTTPAPIEX_OK)
+            {
+                LogError("unable to HTTPAPIEX_SetOption %s", savedOption->name);
+                HTTPAPIEX_Destroy(result);
+                result = NULL;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+/*executeExchange sends the request of exchange over connection and keeps the outcome for completeEvent or completeMessages. It
+only reads the device data, so that the requests of several devices (or the POST and the GET of a device) can be executed at the same time*/
+static void executeExchange(HTTPAPIEX_HANDLE connection, HTTP_EXCHANGE* exchange)
+{
+    if (exchange->useSasObject)
+    {
+        if ((exchange->result = HTTPAPIEX_SAS_ExecuteRequest(
+            exchange->deviceData->sasObject,
+            connection,
+            exchange->requestType,
+            exchange->relativePath,
+            exchange->requestHeaders,
+            exchange->requestContent,
+            &exchange->statusCode,
+            exchange->responseHeaders,
+            exchange->responseContent
+        )) != HTTPAPIEX_OK)
+        {
+            LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
+        }
+    }
+    else
+    {
+        if ((exchange->result = HTTPAPIEX_ExecuteRequest(
+            connection,
+            exchange->requestType,
+            exchange->relativePath,
+            exchange->requestHeaders,
+            exchange->requestContent,
+            &exchange->statusCode,
+            exchange->responseHeaders,
+            exchange->responseContent
+        )) != HTTPAPIEX_OK)
+        {
+            LogError("Unable to HTTPAPIEX_ExecuteRequest.");
+        }
+    }
+}
+
+/*read by the DoWork thread only, as the exchanges are released as soon as it sees them all executed*/
+static bool allExchangesExecuted(const HTTP_EXCHANGE_QUEUE* queue)
+{
+    size_t i;
+
+    for (i = 0; i < queue->count; i++)
+    {
+        if (!queue->exchanges[i].executed)
+        {
+            break;
+        }
+    }
+
+    return (i == queue->count);
+}
+
+/*runQueuedExchanges executes the exchanges of the queue nobody has claimed yet over connection. Called with the queue locked,
+and returns with it locked unless re-acquiring the lock fails, in which case it returns at once and the caller shall not
+unlock it*/
+static int runQueuedExchanges(HTTP_EXCHANGE_QUEUE* queue, HTTPAPIEX_HANDLE connection)
+{
+    int result = 0;
+
+    while (queue->next < queue->count)
+    {
+        HTTP_EXCHANGE* exchange = &queue->exchanges[queue->next++];
+
+        (void)Unlock(queue->lock);
+        executeExchange(connection, exchange);
+        exchange->executed = 1;
+        if (Lock(queue->lock) != LOCK_OK)
+        {
+            LogError("failed re-acquiring the HTTP exchanges lock");
+            result = MU_FAILURE;
+            break;
+        }
+
+        /*the DoWork thread checks whether this was the last one*/
+        (void)Condition_Post(queue->exchangesExecuted);
+    }
+
+    return result;
+}
+
+/*HttpExchangeWorker_Thread executes, over the pooled connection of the worker, the exchanges of every DoWork that the other
+connections have not claimed first, until the connection is closed*/
+static int HttpExchangeWorker_Thread(void* threadArgument)
+{
+    HTTP_EXCHANGE_WORKER* worker = (HTTP_EXCHANGE_WORKER*)threadArgument;
+    HTTP_EXCHANGE_QUEUE* queue = worker->queue;
+
+    if (Lock(queue->lock) != LOCK_OK)
+    {
+        LogError("failed locking the HTTP exchanges, the connection is left to itself");
+    }
+    else
+    {
+        bool locked = true;
+
+        while (!queue->stop)
+        {
+            if (queue->next < queue->count)
+            {
+                if (runQueuedExchanges(queue, worker->connection) != 0)
+                {
+                    /*the exchanges are executed by the other connections*/
+                    LogError("the worker of the HTTP connection stops");
+                    locked = false;
+                    break;
+                }
+            }
+            else if (Condition_Wait(queue->exchangesQueued, queue->lock, HTTP_EXCHANGE_WORKER_MAX_WAIT_MS) == COND_ERROR)
+            {
+                /*the exchanges are executed by the other connections*/
+                LogError("Condition_Wait failed, the worker of the HTTP connection stops");
+                break;
+            }
+        }
+
+        if (locked)
+        {
+            (void)Unlock(queue->lock);
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+/*startExchangeWorkers starts a worker for each pooled connection that has none yet. Fails if one cannot be started, in which
+case the connections past the last worker started are left without one*/
+static int startExchangeWorkers(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    int result = 0;
+
+    while (handleData->exchangeWorkerCount + 1 < handleData->connectionCount)
+    {
+        HTTP_EXCHANGE_WORKER* worker = &handleData->exchangeWorkers[handleData->exchangeWorkerCount];
+
+        worker->queue = &handleData->exchangeQueue;
+        worker->connection = handleData->pooledConnections[handleData->exchangeWorkerCount];
+        if (ThreadAPI_Create(&worker->thread, HttpExchangeWorker_Thread, worker) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Create failed for HTTP connection %lu", (unsigned long)(handleData->exchangeWorkerCount + 1));
+            result = MU_FAILURE;
+            break;
+        }
+        handleData->exchangeWorkerCount++;
+    }
+
+    return result;
+}
+
+/*stopExchangeWorkers stops and joins the workers of the pooled connections. They are idle, as DoWork waits for them to be done*/
+static void stopExchangeWorkers(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    if (handleData->exchangeWorkerCount > 0)
+    {
+        HTTP_EXCHANGE_QUEUE* queue = &handleData->exchangeQueue;
+        size_t i;
+
+        if (Lock(queue->lock) != LOCK_OK)
+        {
+            LogError("failed locking the HTTP exchanges");
+        }
+        else
+        {
+            queue->stop = true;
+            for (i = 0; i < handleData->exchangeWorkerCount; i++)
+            {
+                (void)Condition_Post(queue->exchangesQueued);
+            }
+            (void)Unlock(queue->lock);
+        }
+
+        for (i = 0; i < handleData->exchangeWorkerCount; i++)
+        {
+            int threadResult;
+            if (ThreadAPI_Join(handleData->exchangeWorkers[i].thread, &threadResult) != THREADAPI_OK)
+            {
+                LogError("ThreadAPI_Join failed for HTTP connection %lu", (unsigned long)(i + 1));
+            }
+        }
+
+        handleData->exchangeWorkerCount = 0;
+        queue->stop = false;
+    }
+}
+
+/*createExchangeQueue creates, the first time there is more than one connection, what the workers of the pooled connections share*/
+static int createExchangeQueue(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    int result;
+    HTTP_EXCHANGE_QUEUE* queue = &handleData->exchangeQueue;
+
+    if (queue->lock != NULL)
+    {
+        result = 0;
+    }
+    else if ((queue->lock = Lock_Init()) == NULL)
+    {
+        LogError("Lock_Init failed");
+        result = MU_FAILURE;
+    }
+    else if ((queue->exchangesQueued = Condition_Init()) == NULL)
+    {
+        LogError("Condition_Init failed");
+        Lock_Deinit(queue->lock);
+        queue->lock = NULL;
+        result = MU_FAILURE;
+    }
+    else if ((queue->exchangesExecuted = Condition_Init()) == NULL)
+    {
+        LogError("Condition_Init failed");
+        Condition_Deinit(queue->exchangesQueued);
+        Lock_Deinit(queue->lock);
+        queue->lock = NULL;
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void destroyExchangeQueue(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    HTTP_EXCHANGE_QUEUE* queue = &handleData->exchangeQueue;
+
+    if (queue->lock != NULL)
+    {
+        Condition_Deinit(queue->exchangesExecuted);
+        Condition_Deinit(queue->exchangesQueued);
+        Lock_Deinit(queue->lock);
+        queue->lock = NULL;
+    }
+}
+
+static void destroy_pooledConnections(HTTPTRANSPORT_HANDLE_DATA* handleData, size_t connectionCount)
+{
+    if (handleData->exchangeWorkerCount + 1 > connectionCount)
+    {
+        /*rather than picking out the workers of the connections closed, all of them are stopped and setConnectionCount starts those
+        of the connections kept again*/
+        stopExchangeWorkers(handleData);
+    }
+    while (handleData->connectionCount > connectionCount)
+    {
+        handleData->connectionCount--;
+        HTTPAPIEX_Destroy(handleData->pooledConnections[handleData->connectionCount - 1]);
+    }
+}
+
+/*setConnectionCount opens or closes pooled connections, each with the worker executing exchanges over it, so that the transport
+has connectionCount of them*/
+static IOTHUB_CLIENT_RESULT setConnectionCount(HTTPTRANSPORT_HANDLE_DATA* handleData, size_t connectionCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((connectionCount == 0) || (connectionCount > MAXIMUM_HTTP_CONNECTIONS))
+    {
+        LogError("invalid number of HTTP connections %lu (1 to %d)", (unsigned long)connectionCount, MAXIMUM_HTTP_CONNECTIONS);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if ((connectionCount > handleData->connectionCount) && (createExchangeQueue(handleData) != 0))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        size_t previousCount = handleData->connectionCount;
+
+        result = IOTHUB_CLIENT_OK;
+        destroy_pooledConnections(handleData, connectionCount);
+        while (handleData->connectionCount < connectionCount)
+        {
+            HTTPAPIEX_HANDLE connection = createPooledConnection(handleData);
+            if (connection == NULL)
+            {
+                destroy_pooledConnections(handleData, previousCount);
+                result = IOTHUB_CLIENT_ERROR;
+                break;
+            }
+            handleData->pooledConnections[handleData->connectionCount - 1] = connection;
+            handleData->connectionCount++;
+        }
+
+        if (startExchangeWorkers(handleData) != 0)
+        {
+            /*a connection no worker executes exchanges over is of no use*/
+            destroy_pooledConnections(handleData, handleData->exchangeWorkerCount + 1);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+    }
+
+    return result;
+}
+
 static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONFIG* config, TRANSPORT_CALLBACKS_INFO* cb_info, void* ctx)
 {
     HTTPTRANSPORT_HANDLE_DATA* result;
@@ -1088,6 +1582,12 @@ static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONF
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_011: [ Otherwise, IoTHubTransportHttp_Create shall succeed and return a non-NULL value. ]*/
                 result->doBatchedTransfers = false;
                 result->getMinimumPollingTime = DEFAULT_GETMINIMUMPOLLINGTIME;
+                result->getMaximumPollingTime = 0;
+                memset(&result->pollingStatistics, 0, sizeof(result->pollingStatistics));
+                result->connectionCount = 1;
+                result->exchangeWorkerCount = 0;
+                memset(&result->exchangeQueue, 0, sizeof(result->exchangeQueue));
+                result->savedOptions = NULL;
 
                 result->transport_ctx = ctx;
                 memcpy(&result->transport_callbacks, cb_info, sizeof(TRANSPORT_CALLBACKS_INFO));
@@ -1125,6 +1625,9 @@ static void IoTHubTransportHttp_Destroy(TRANSPORT_LL_HANDLE handle)
             free(perDeviceItem);
         }
 
+        destroy_pooledConnections(handleData, 1);
+        destroyExchangeQueue(handleData);
+        destroy_savedOptions(handleData);
         destroy_hostName((HTTPTRANSPORT_HANDLE_DATA *)handle);
         destroy_httpApiExHandle((HTTPTRANSPORT_HANDLE_DATA *)handle);
         destroy_perDeviceList((HTTPTRANSPORT_HANDLE_DATA *)handle);
@@ -1242,232 +1745,264 @@ static int IoTHubTransportHttp_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle
     return MU_FAILURE;
 }
 
-/*produces a representation of the properties, if they exist*/
-/*if they do not exist, produces ""*/
-static int concat_Properties(STRING_HANDLE existing, MAP_HANDLE map, size_t* propertiesMessageSizeContribution)
-{
-    int result;
-    const char*const* keys;
-    const char*const* values;
+/*a batch is a JSON array with an item per message: {"body":"base64 encoding of the message content"[,"properties":{"iothub-app-a":"valueOfA"}]}*/
+/*or, for string messages, {"body":"JSON encoding of the string","base64Encoded":false[,"properties":{...}]}*/
+#define BATCH_BYTEARRAY_BODY_BEGIN "{\"body\":\""
+#define BATCH_BYTEARRAY_BODY_END "\""
+#define BATCH_STRING_BODY_BEGIN "{\"body\":"
+#define BATCH_STRING_BODY_END ",\"base64Encoded\":false"
+#define BATCH_PROPERTIES_BEGIN ",\"properties\":{"
+#define BATCH_PROPERTY_NAME_BEGIN "\"" IOTHUB_APP_PREFIX
+#define BATCH_PROPERTY_NAME_END "\":\""
+#define BATCH_PROPERTY_VALUE_END "\""
+#define BATCH_PROPERTIES_END "}"
+#define BATCH_ITEM_END "}"
+#define LITERAL_LENGTH(literal) (sizeof(literal) - 1)
+
+typedef struct EVENT_JSON_ITEM_TAG
+{
+    IOTHUBMESSAGE_CONTENT_TYPE contentType;
+    const unsigned char* source;
+    size_t size;
+    const char* const* keys;
+    const char* const* values;
     size_t count;
-    if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
+    size_t encodedLength; /*length of the item in the payload*/
+    size_t messageSize; /*what the item counts for against MAXIMUM_MESSAGE_SIZE*/
+} EVENT_JSON_ITEM;
+
+static const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char hexDigits[] = "0123456789ABCDEF";
+
+static unsigned char* writeLiteral(unsigned char* destination, const char* source, size_t length)
+{
+    (void)memcpy(destination, source, length);
+    return destination + length;
+}
+
+/*the same encoding as Azure_Base64_Encode_Bytes, written in place instead of into a new STRING_HANDLE*/
+static unsigned char* writeBase64(unsigned char* destination, const unsigned char* source, size_t size)
+{
+    size_t i;
+    for (i = 0; i + 3 <= size; i += 3)
     {
-        result = MU_FAILURE;
-        LogError("error while Map_GetInternals");
+        uint32_t group = ((uint32_t)source[i] << 16) | ((uint32_t)source[i + 1] << 8) | (uint32_t)source[i + 2];
+        destination[0] = (unsigned char)base64Alphabet[(group >> 18) & 0x3F];
+        destination[1] = (unsigned char)base64Alphabet[(group >> 12) & 0x3F];
+        destination[2] = (unsigned char)base64Alphabet[(group >> 6) & 0x3F];
+        destination[3] = (unsigned char)base64Alphabet[group & 0x3F];
+        destination += 4;
     }
-    else
+
+    if (i < size)
     {
+        uint32_t group = (uint32_t)source[i] << 16;
+        if (i + 1 < size)
+        {
+            group |= (uint32_t)source[i + 1] << 8;
+        }
+        destination[0] = (unsigned char)base64Alphabet[(group >> 18) & 0x3F];
+        destination[1] = (unsigned char)base64Alphabet[(group >> 12) & 0x3F];
+        destination[2] = (i + 1 < size) ? (unsigned char)base64Alphabet[(group >> 6) & 0x3F] : '=';
+        destination[3] = '=';
+        destination += 4;
+    }
+    return destination;
+}
+
+/*measures the string the way STRING_new_JSON encodes it: quoted, with control characters as \u00XX and '"', '\' and '/' escaped. Only ASCII is accepted*/
+static int getJSONStringLength(const char* source, size_t* sourceLength, size_t* encodedLength)
+{
+    int result;
+    size_t escaped = 0;
+    size_t i;
 
-        if (count == 0)
+    for (i = 0; source[i] != '\0'; i++)
+    {
+        unsigned char c = (unsigned char)source[i];
+        if (c >= 128)
         {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_064: [If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload*/
-            /*no properties - do nothing with existing*/
-            result = 0;
-            *propertiesMessageSizeContribution = 0;
+            break;
         }
-        else
+        else if (c <= 0x1F)
         {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_058: [If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2*/
-            if (STRING_concat(existing, ",\"properties\":") != 0)
-            {
-                /*go ahead and return it*/
-                result = MU_FAILURE;
-                LogError("failed STRING_concat");
-            }
-            else if (appendMapToJSON(existing, keys, values, count) != 0)
-            {
-                result = MU_FAILURE;
-                LogError("unable to append the properties");
-            }
-            else
-            {
-                /*all is fine*/
-                size_t i;
-                *propertiesMessageSizeContribution = 0;
-                for (i = 0; i < count; i++)
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_063: [Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes.] */
-                    *propertiesMessageSizeContribution += (strlen(keys[i]) + strlen(values[i]) + MAXIMUM_PROPERTY_OVERHEAD);
-                }
-                result = 0;
-            }
+            escaped += 5;
+        }
+        else if (c == '"' || c == '\\' || c == '/')
+        {
+            escaped += 1;
         }
     }
-    return result;
-}
 
-/*produces a JSON representation of the map : {"a": "value_of_a","b":"value_of_b"}*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count) /*under consideration: move to MAP module when it has more than 1 user*/
-{
-    int result;
-    if (STRING_concat(existing, "{") != 0)
+    if (source[i] != '\0')
     {
-        /*go on and return it*/
-        LogError("STRING_construct failed");
+        LogError("invalid character in input string");
         result = MU_FAILURE;
     }
     else
     {
-        size_t i;
-        for (i = 0; i < count; i++)
-        {
-            if (!(
-                (STRING_concat(existing, (i == 0) ? "\"" IOTHUB_APP_PREFIX : ",\"" IOTHUB_APP_PREFIX) == 0) &&
-                (STRING_concat(existing, keys[i]) == 0) &&
-                (STRING_concat(existing, "\":\"") == 0) &&
-                (STRING_concat(existing, values[i]) == 0) &&
-                (STRING_concat(existing, "\"") == 0)
-                ))
-            {
-                LogError("unable to STRING_concat");
-                break;
-            }
-        }
+        *sourceLength = i;
+        *encodedLength = i + escaped + 2;
+        result = 0;
+    }
+    return result;
+}
 
-        if (i < count)
-        {
-            result = MU_FAILURE;
-            /*error, let it go through*/
-        }
-        else if (STRING_concat(existing, "}") != 0)
+static unsigned char* writeJSONString(unsigned char* destination, const unsigned char* source, size_t size)
+{
+    size_t i;
+    *destination++ = '"';
+    for (i = 0; i < size; i++)
+    {
+        unsigned char c = source[i];
+        if (c <= 0x1F)
         {
-            LogError("unable to STRING_concat");
-            result = MU_FAILURE;
+            destination[0] = '\\';
+            destination[1] = 'u';
+            destination[2] = '0';
+            destination[3] = '0';
+            destination[4] = (unsigned char)hexDigits[(c & 0xF0) >> 4];
+            destination[5] = (unsigned char)hexDigits[c & 0x0F];
+            destination += 6;
         }
         else
         {
-            /*all is fine*/
-            result = 0;
+            if (c == '"' || c == '\\' || c == '/')
+            {
+                *destination++ = '\\';
+            }
+            *destination++ = c;
         }
     }
-    return result;
+    *destination++ = '"';
+    return destination;
 }
 
-/*makes the following string:{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-/*return NULL if there was a failure, or a non-NULL STRING_HANDLE that contains the intended data*/
-static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeContribution)
+/*gets the content and properties of a message and measures the item it makes in the batch, without producing it*/
+static int getEventJSONItem(IOTHUB_MESSAGE_HANDLE messageHandle, EVENT_JSON_ITEM* item)
 {
-    STRING_HANDLE result; /*temp wants to contain :{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-    IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
-    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message->messageHandle);
+    int result;
 
-    switch (contentType)
+    item->contentType = IoTHubMessage_GetContentType(messageHandle);
+    switch (item->contentType)
     {
     case IOTHUBMESSAGE_BYTEARRAY:
     {
-        result = STRING_construct("{\"body\":\"");
-        if (result == NULL)
+        if (IoTHubMessage_GetByteArray(messageHandle, &item->source, &item->size) != IOTHUB_MESSAGE_OK)
         {
-            LogError("unable to STRING_construct");
+            LogError("unable to get the data for the message.");
+            result = MU_FAILURE;
         }
         else
         {
-            const unsigned char* source;
-            size_t size;
-
-            if (IoTHubMessage_GetByteArray(message->messageHandle, &source, &size) != IOTHUB_MESSAGE_OK)
-            {
-                LogError("unable to get the data for the message.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            else
-            {
-                STRING_HANDLE encoded = Azure_Base64_Encode_Bytes(source, size);
-                if (encoded == NULL)
-                {
-                    LogError("unable to Azure_Base64_Encode_Bytes.");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
-                {
-                    size_t propertiesSize = 0;
-                    if (!(
-                        (STRING_concat_with_STRING(result, encoded) == 0) &&
-                        (STRING_concat(result, "\"") == 0) && /*\" because closing value*/
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        STRING_delete(result);
-                        result = NULL;
-                        LogError("unable to STRING_concat_with_STRING.");
-                    }
-                    else
-                    {
-                        /*all is fine... */
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = size + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(encoded);
-                }
-            }
+            item->encodedLength = LITERAL_LENGTH(BATCH_BYTEARRAY_BODY_BEGIN) + 4 * ((item->size + 2) / 3) + LITERAL_LENGTH(BATCH_BYTEARRAY_BODY_END);
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
+            item->messageSize = item->size + MAXIMUM_PAYLOAD_OVERHEAD;
+            result = 0;
         }
         break;
     }
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_057: [If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false}] */
     case IOTHUBMESSAGE_STRING:
     {
-        result = STRING_construct("{\"body\":");
-        if (result == NULL)
+        const char* source = IoTHubMessage_GetString(messageHandle);
+        size_t jsonLength;
+        if (source == NULL)
         {
-            LogError("unable to STRING_construct");
+            LogError("unable to IoTHubMessage_GetString");
+            result = MU_FAILURE;
+        }
+        else if (getJSONStringLength(source, &item->size, &jsonLength) != 0)
+        {
+            LogError("unable to encode the message as a JSON string");
+            result = MU_FAILURE;
         }
         else
         {
-            const char* source = IoTHubMessage_GetString(message->messageHandle);
-            if (source == NULL)
-            {
-                LogError("unable to IoTHubMessage_GetString");
-                STRING_delete(result);
-                result = NULL;
-            }
-            else
-            {
-                STRING_HANDLE asJson = STRING_new_JSON(source);
-                if (asJson == NULL)
-                {
-                    LogError("unable to STRING_new_JSON");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
-                {
-                    size_t propertiesSize = 0;
-                    if (!(
-                        (STRING_concat_with_STRING(result, asJson) == 0) &&
-                        (STRING_concat(result, ",\"base64Encoded\":false") == 0) &&
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        LogError("unable to STRING_concat_with_STRING");
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        /*result has the intended content*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = strlen(source) + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(asJson);
-                }
-            }
+            item->source = (const unsigned char*)source;
+            item->encodedLength = LITERAL_LENGTH(BATCH_STRING_BODY_BEGIN) + jsonLength + LITERAL_LENGTH(BATCH_STRING_BODY_END);
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
+            item->messageSize = item->size + MAXIMUM_PAYLOAD_OVERHEAD;
+            result = 0;
         }
         break;
     }
     default:
     {
-        LogError("an unknown message type was encountered (%d)", contentType);
-        result = NULL; /*unknown message type*/
+        LogError("an unknown message type was encountered (%d)", item->contentType);
+        result = MU_FAILURE;
         break;
     }
     }
+
+    if (result == 0)
+    {
+        if (Map_GetInternals(IoTHubMessage_Properties(messageHandle), &item->keys, &item->values, &item->count) != MAP_OK)
+        {
+            LogError("error while Map_GetInternals");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_064: [If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload*/
+            if (item->count > 0)
+            {
+                size_t i;
+                item->encodedLength += LITERAL_LENGTH(BATCH_PROPERTIES_BEGIN) + (item->count - 1) + LITERAL_LENGTH(BATCH_PROPERTIES_END);
+                for (i = 0; i < item->count; i++)
+                {
+                    size_t keyLength = strlen(item->keys[i]);
+                    size_t valueLength = strlen(item->values[i]);
+                    item->encodedLength += LITERAL_LENGTH(BATCH_PROPERTY_NAME_BEGIN) + keyLength + LITERAL_LENGTH(BATCH_PROPERTY_NAME_END) + valueLength + LITERAL_LENGTH(BATCH_PROPERTY_VALUE_END);
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_063: [Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes.] */
+                    item->messageSize += keyLength + valueLength + MAXIMUM_PROPERTY_OVERHEAD;
+                }
+            }
+            item->encodedLength += LITERAL_LENGTH(BATCH_ITEM_END);
+        }
+    }
     return result;
 }
 
+/*writes the item measured by getEventJSONItem, exactly item->encodedLength bytes*/
+static unsigned char* writeEventJSONItem(unsigned char* destination, const EVENT_JSON_ITEM* item)
+{
+    if (item->contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        destination = writeLiteral(destination, BATCH_BYTEARRAY_BODY_BEGIN, LITERAL_LENGTH(BATCH_BYTEARRAY_BODY_BEGIN));
+        destination = writeBase64(destination, item->source, item->size);
+        destination = writeLiteral(destination, BATCH_BYTEARRAY_BODY_END, LITERAL_LENGTH(BATCH_BYTEARRAY_BODY_END));
+    }
+    else
+    {
+        destination = writeLiteral(destination, BATCH_STRING_BODY_BEGIN, LITERAL_LENGTH(BATCH_STRING_BODY_BEGIN));
+        destination = writeJSONString(destination, item->source, item->size);
+        destination = writeLiteral(destination, BATCH_STRING_BODY_END, LITERAL_LENGTH(BATCH_STRING_BODY_END));
+    }
+
+    if (item->count > 0)
+    {
+        size_t i;
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_058: [If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2*/
+        destination = writeLiteral(destination, BATCH_PROPERTIES_BEGIN, LITERAL_LENGTH(BATCH_PROPERTIES_BEGIN));
+        for (i = 0; i < item->count; i++)
+        {
+            if (i > 0)
+            {
+                *destination++ = ',';
+            }
+            destination = writeLiteral(destination, BATCH_PROPERTY_NAME_BEGIN, LITERAL_LENGTH(BATCH_PROPERTY_NAME_BEGIN));
+            destination = writeLiteral(destination, item->keys[i], strlen(item->keys[i]));
+            destination = writeLiteral(destination, BATCH_PROPERTY_NAME_END, LITERAL_LENGTH(BATCH_PROPERTY_NAME_END));
+            destination = writeLiteral(destination, item->values[i], strlen(item->values[i]));
+            destination = writeLiteral(destination, BATCH_PROPERTY_VALUE_END, LITERAL_LENGTH(BATCH_PROPERTY_VALUE_END));
+        }
+        destination = writeLiteral(destination, BATCH_PROPERTIES_END, LITERAL_LENGTH(BATCH_PROPERTIES_END));
+    }
+
+    return writeLiteral(destination, BATCH_ITEM_END, LITERAL_LENGTH(BATCH_ITEM_END));
+}
+
 #define MAKE_PAYLOAD_RESULT_VALUES \
     MAKE_PAYLOAD_OK, /*returned when there is a payload to be later send by HTTP*/ \
     MAKE_PAYLOAD_NO_ITEMS, /*returned when there are no items to be send*/ \
@@ -1476,135 +2011,127 @@ static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeCo
 
 MU_DEFINE_ENUM(MAKE_PAYLOAD_RESULT, MAKE_PAYLOAD_RESULT_VALUES);
 
+static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
+{
+    /*this function takes a list, and inserts it in another list. When done in the context of this file, it reverses the effects of a not-able-to-send situation*/
+    DList_AppendTailList(destination->Flink, source);
+    DList_RemoveEntryList(source);
+    DList_InitializeListHead(source);
+}
+
 /*this function assembles several {"body":"base64 encoding of the message content"," base64Encoded": true} into 1 payload*/
+/*the items are measured first, so the payload is allocated once at its final size and every item is encoded straight into it*/
 /*Codes_SRS_TRANSPORTMULTITHTTP_17_056: [IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...]]*/
-static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, STRING_HANDLE* payload)
+static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, BUFFER_HANDLE* payload)
 {
     MAKE_PAYLOAD_RESULT result;
+    EVENT_JSON_ITEM item;
+    PDLIST_ENTRY actual = deviceData->waitingToSend->Flink;
     size_t allMessagesSize = 0;
-    *payload = STRING_construct("[");
-    if (*payload == NULL)
+    size_t payloadLength = 1; /*the opening '['*/
+    size_t itemCount = 0;
+    bool firstItemDoesNotFit = false;
+    bool keepGoing = true; /*keepGoing gets sometimes to false from within the loop*/
+
+    *payload = NULL;
+
+    /*either all the items enter the batch or only the oldest ones, for as long as they can be encoded and fit*/
+    while (keepGoing && (actual != deviceData->waitingToSend))
+    {
+        IOTHUB_MESSAGE_LIST* message = containingRecord(actual, IOTHUB_MESSAGE_LIST, entry);
+        if (getEventJSONItem(message->messageHandle, &item) != 0)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
+            keepGoing = false;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
+        else if (allMessagesSize + item.messageSize > MAXIMUM_MESSAGE_SIZE)
+        {
+            firstItemDoesNotFit = (itemCount == 0);
+            keepGoing = false;
+        }
+        else
+        {
+            allMessagesSize += item.messageSize;
+            payloadLength += item.encodedLength + 1; /*the ',' after the item, or the closing ']'*/
+            itemCount++;
+            actual = actual->Flink;
+        }
+    }
+
+    if (itemCount == 0)
     {
-        LogError("unable to STRING_construct");
+        if (firstItemDoesNotFit)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClientCore_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
+            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend);
+            DList_InsertTailList(&(deviceData->eventConfirmations), head);
+            result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+            result = MAKE_PAYLOAD_ERROR;
+        }
+    }
+    else if ((*payload = BUFFER_new()) == NULL)
+    {
+        LogError("unable to BUFFER_new");
+        result = MAKE_PAYLOAD_ERROR;
+    }
+    else if (BUFFER_pre_build(*payload, payloadLength) != 0)
+    {
+        LogError("unable to BUFFER_pre_build a payload of %lu bytes", (unsigned long)payloadLength);
+        BUFFER_delete(*payload);
+        *payload = NULL;
         result = MAKE_PAYLOAD_ERROR;
     }
     else
     {
-        bool isFirst = true;
-        PDLIST_ENTRY actual;
-        bool keepGoing = true; /*keepGoing gets sometimes to false from within the loop*/
-                               /*either all the items enter the list or only some*/
-        result = MAKE_PAYLOAD_OK; /*optimistically initializing it*/
-        while (keepGoing && ((actual = deviceData->waitingToSend->Flink) != deviceData->waitingToSend))
+        unsigned char* start = BUFFER_u_char(*payload);
+        unsigned char* destination = start;
+        size_t i;
+
+        *destination++ = '[';
+        for (i = 0; i < itemCount; i++)
         {
-            size_t messageSize;
-            STRING_HANDLE temp = make1EventJSONitem(actual, &messageSize);
-            if (isFirst)
-            {
-                isFirst = false;
-                /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                if (temp == NULL) /*first item failed to create, nothing to send*/
-                {
-                    result = MAKE_PAYLOAD_ERROR;
-                    STRING_delete(*payload);
-                    *payload = NULL;
-                    keepGoing = false;
-                }
-                else
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClientCore_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
-                    if (messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
-                        STRING_delete(*payload);
-                        *payload = NULL;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        if (STRING_concat_with_STRING(*payload, temp) != 0)
-                        {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            result = MAKE_PAYLOAD_ERROR;
-                            STRING_delete(*payload);
-                            *payload = NULL;
-                            keepGoing = false;
-                        }
-                        else
-                        {
-                            /*first item was put nicely in the payload*/
-                            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                            DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                            allMessagesSize += messageSize;
-                        }
-                    }
-                    STRING_delete(temp);
-                }
-            }
-            else
+            IOTHUB_MESSAGE_LIST* message = containingRecord(deviceData->waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry);
+            PDLIST_ENTRY head;
+            /*the message was measured above, the sizes can only come out different if its content changed meanwhile*/
+            if ((getEventJSONItem(message->messageHandle, &item) != 0) || (item.encodedLength + 1 > payloadLength - (size_t)(destination - start)))
             {
-                /*there is at least 1 item already in the payload*/
-                if (temp == NULL)
-                {
-                    /*there are multiple payloads encoded, the last one had an internal error, just go with those - closing the payload happens "after the loop"*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                    result = MAKE_PAYLOAD_OK;
-                    keepGoing = false;
-                }
-                else
-                {
-                    if (allMessagesSize + messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        /*this item doesn't make it to the payload, but the payload is valid so far*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else if (STRING_concat_with_STRING(*payload, temp) != 0)
-                    {
-                        /*should still send what there is so far...*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        /*cool, the payload made it there, let's continue... */
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        allMessagesSize += messageSize;
-                    }
-                    STRING_delete(temp);
-                }
+                LogError("message changed while being batched");
+                break;
             }
+            destination = writeEventJSONItem(destination, &item);
+            *destination++ = ','; /*the last comma is replaced by a ']'*/
+
+            head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as message->entry, but now it is removed*/
+            DList_InsertTailList(&(deviceData->eventConfirmations), head);
         }
 
-        /*closing the payload*/
-        if (result == MAKE_PAYLOAD_OK)
+        if (i < itemCount)
         {
-            ((char*)STRING_c_str(*payload))[STRING_length(*payload) - 1] = ']'; /*TODO - do this in STRING_HANDLE*/
+            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+            BUFFER_delete(*payload);
+            *payload = NULL;
+            result = MAKE_PAYLOAD_ERROR;
         }
         else
         {
-            /*no need to close anything*/
+            /*closing the payload*/
+            destination[-1] = ']';
+            result = MAKE_PAYLOAD_OK;
         }
     }
     return result;
 }
 
-static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
-{
-    /*this function takes a list, and inserts it in another list. When done in the context of this file, it reverses the effects of a not-able-to-send situation*/
-    DList_AppendTailList(destination->Flink, source);
-    DList_RemoveEntryList(source);
-    DList_InitializeListHead(source);
-}
-
-static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+/*prepareEvent builds the POST of the oldest event (or of a batch of events) waiting to be sent by the device. Returns false when there is
+nothing to send, or when the events could not be made into a request (in which case they are completed or left for the next DoWork)*/
+static bool prepareEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, HTTP_EXCHANGE* exchange)
 {
+    bool result = false;
 
     if (DList_IsListEmpty(deviceData->waitingToSend))
     {
@@ -1624,67 +2151,24 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
             else
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_059: [It shall inspect the "waitingToSend" DLIST passed in config structure.] */
-                STRING_HANDLE payload;
+                BUFFER_HANDLE payload;
                 switch (makePayload(deviceData, &payload))
                 {
                 case MAKE_PAYLOAD_OK:
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_068: [Once a final payload has been obtained, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters:] */
-                    BUFFER_HANDLE temp = BUFFER_new();
-                    if (temp == NULL)
-                    {
-                        LogError("unable to BUFFER_new");
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                        reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                    }
-                    else
-                    {
-                        if (BUFFER_build(temp, (const unsigned char*)STRING_c_str(payload), STRING_length(payload)) != 0)
-                        {
-                            LogError("unable to BUFFER_build");
-                            //items go back to waitingToSend
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                        }
-                        else
-                        {
-                            unsigned int statusCode;
-                            if (HTTPAPIEX_SAS_ExecuteRequest(
-                                deviceData->sasObject,
-                                handleData->httpApiExHandle,
-                                HTTPAPI_REQUEST_POST,
-                                STRING_c_str(deviceData->eventHTTPrelativePath),
-                                deviceData->eventHTTPrequestHeaders,
-                                temp,
-                                &statusCode,
-                                NULL,
-                                NULL
-                            ) != HTTPAPIEX_OK)
-                            {
-                                LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                //items go back to waitingToSend
-                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                            }
-                            else
-                            {
-                                if (statusCode < 300)
-                                {
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClientCore_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
-                                    handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK, deviceData->device_transport_ctx);
-                                }
-                                else
-                                {
-                                    //items go back to waitingToSend
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                    LogError("unexpected HTTP status code (%u)", statusCode);
-                                    reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                                }
-                            }
-                        }
-                        BUFFER_delete(temp);
-                    }
-                    STRING_delete(payload);
+                    exchange->deviceData = deviceData;
+                    exchange->requestType = HTTPAPI_REQUEST_POST;
+                    exchange->relativePath = STRING_c_str(deviceData->eventHTTPrelativePath);
+                    exchange->requestHeaders = deviceData->eventHTTPrequestHeaders;
+                    exchange->requestContent = payload;
+                    exchange->responseHeaders = NULL;
+                    exchange->responseContent = NULL;
+                    exchange->useSasObject = true;
+                    exchange->isBatch = true;
+                    exchange->statusCode = 0;
+                    exchange->result = HTTPAPIEX_ERROR;
+                    result = true;
                     break;
                 }
                 case MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT:
@@ -1786,68 +2270,111 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                     {
                                         LogError("unable to BUFFER_new");
                                     }
+                                    /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
+                                    else if ((deviceData->deviceSasToken != NULL) &&
+                                        (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, IOTHUB_AUTH_HEADER_VALUE, STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK))
+                                    {
+                                        /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
+                                        LogError("Unable to replace the old SAS Token.");
+                                        BUFFER_delete(toBeSend);
+                                    }
                                     else
                                     {
-                                        unsigned int statusCode = 0;
-                                        HTTPAPIEX_RESULT r;
-                                        if (deviceData->deviceSasToken != NULL)
-                                        {
-                                            /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
-                                            if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, IOTHUB_AUTH_HEADER_VALUE, STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
-                                            {
-                                                r = HTTPAPIEX_ERROR;
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
-                                                LogError("Unable to replace the old SAS Token.");
-                                            }
-                                            /*Codes_SRS_TRANSPORTMULTITHTTP_03_003: [If a deviceSasToken exists, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_ExecuteRequest passing the following parameters] */
-                                            else if ((r = HTTPAPIEX_ExecuteRequest(
-                                                handleData->httpApiExHandle, HTTPAPI_REQUEST_POST, STRING_c_str(deviceData->eventHTTPrelativePath),
-                                                clonedEventHTTPrequestHeaders, toBeSend, &statusCode, NULL, NULL)) != HTTPAPIEX_OK)
-                                            {
-                                                LogError("Unable to HTTPAPIEX_ExecuteRequest.");
-                                            }
-                                        }
-                                        else
-                                        {
-                                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_080: [If a deviceSasToken does not exist, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters] */
-                                            if ((r = HTTPAPIEX_SAS_ExecuteRequest(deviceData->sasObject, handleData->httpApiExHandle, HTTPAPI_REQUEST_POST, STRING_c_str(deviceData->eventHTTPrelativePath),
-                                                clonedEventHTTPrequestHeaders, toBeSend, &statusCode, NULL, NULL )) != HTTPAPIEX_OK)
-                                            {
-                                                LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
-                                            }
-                                        }
-                                        if (r == HTTPAPIEX_OK)
-                                        {
-                                            if (statusCode < 300)
-                                            {
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_082: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClientCore_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend.] */
-                                                PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                                                DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
-                                                handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK, deviceData->device_transport_ctx); // takes care of emptying the list too
-                                            }
-                                            else
-                                            {
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_081: [If HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                                LogError("unexpected HTTP status code (%u)", statusCode);
-                                            }
-                                        }
-                                        else if (r == HTTPAPIEX_RECOVERYFAILED)
-                                        {
-                                            PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                                            DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
-                                            handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR, deviceData->device_transport_ctx); // takes care of emptying the list too
-                                        }
+                                        /*Codes_SRS_TRANSPORTMULTITHTTP_03_003: [If a deviceSasToken exists, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_ExecuteRequest passing the following parameters] */
+                                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_080: [If a deviceSasToken does not exist, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters] */
+                                        exchange->deviceData = deviceData;
+                                        exchange->requestType = HTTPAPI_REQUEST_POST;
+                                        exchange->relativePath = STRING_c_str(deviceData->eventHTTPrelativePath);
+                                        exchange->requestHeaders = clonedEventHTTPrequestHeaders;
+                                        exchange->requestContent = toBeSend;
+                                        exchange->responseHeaders = NULL;
+                                        exchange->responseContent = NULL;
+                                        exchange->useSasObject = (deviceData->deviceSasToken == NULL);
+                                        exchange->isBatch = false;
+                                        exchange->statusCode = 0;
+                                        exchange->result = HTTPAPIEX_ERROR;
+                                        result = true;
                                     }
-                                    BUFFER_delete(toBeSend);
                                 }
                             }
                         }
-                        HTTPHeaders_Free(clonedEventHTTPrequestHeaders);
+                        if (!result)
+                        {
+                            HTTPHeaders_Free(clonedEventHTTPrequestHeaders);
+                        }
                     }
                 }
             }
         }
     }
+
+    return result;
+}
+
+/*completeEvent reports the events of an executed POST as sent, or leaves them to be sent again at the next DoWork*/
+static void completeEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTP_EXCHANGE* exchange)
+{
+    HTTPTRANSPORT_PERDEVICE_DATA* deviceData = exchange->deviceData;
+
+    if (exchange->isBatch)
+    {
+        if (exchange->result != HTTPAPIEX_OK)
+        {
+            LogError("unable to HTTPAPIEX_ExecuteRequest");
+            //items go back to waitingToSend
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
+            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+        }
+        else if (exchange->statusCode < 300)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClientCore_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
+            handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK, deviceData->device_transport_ctx);
+        }
+        else
+        {
+            //items go back to waitingToSend
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
+            LogError("unexpected HTTP status code (%u)", exchange->statusCode);
+            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+        }
+        BUFFER_delete(exchange->requestContent);
+    }
+    else
+    {
+        if (exchange->result == HTTPAPIEX_OK)
+        {
+            if (exchange->statusCode < 300)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_082: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClientCore_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend.] */
+                PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
+                handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK, deviceData->device_transport_ctx); // takes care of emptying the list too
+            }
+            else
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_081: [If HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
+                LogError("unexpected HTTP status code (%u)", exchange->statusCode);
+            }
+        }
+        else if (exchange->result == HTTPAPIEX_RECOVERYFAILED)
+        {
+            PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+            DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
+            handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR, deviceData->device_transport_ctx); // takes care of emptying the list too
+        }
+        BUFFER_delete(exchange->requestContent);
+        HTTPHeaders_Free(exchange->requestHeaders);
+    }
+}
+
+static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    HTTP_EXCHANGE exchange;
+    if (prepareEvent(handleData, deviceData, &exchange))
+    {
+        executeExchange(handleData->httpApiExHandle, &exchange);
+        completeEvent(handleData, &exchange);
+    }
 }
 
 static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, const char* ETag, IOTHUBMESSAGE_DISPOSITION_RESULT action)
@@ -2134,8 +2661,44 @@ static MESSAGE_CALLBACK_INFO* MESSAGE_CALLBACK_INFO_Create(IOTHUB_MESSAGE_HANDLE
     return result;
 }
 
-static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+/*adaptive polling is on when OPTION_MAX_POLLING_TIME is above OPTION_MIN_POLLING_TIME. The GETs of each device are then spaced by an
+interval that doubles, up to the maximum, every time the device finds no message waiting and drops back to the minimum when a message
+arrives. The jitter keeps the devices of a multiplexed transport from drifting into polling in the same DoWork*/
+static bool isAdaptivePolling(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    return handleData->getMaximumPollingTime > handleData->getMinimumPollingTime;
+}
+
+static void scheduleNextPoll(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, bool messageReceived)
 {
+    unsigned int interval;
+    if (messageReceived || (deviceData->pollingInterval < handleData->getMinimumPollingTime))
+    {
+        interval = handleData->getMinimumPollingTime;
+    }
+    else if (deviceData->pollingInterval == 0)
+    {
+        interval = 1;
+    }
+    else if (deviceData->pollingInterval > handleData->getMaximumPollingTime / 2)
+    {
+        interval = handleData->getMaximumPollingTime;
+    }
+    else
+    {
+        interval = deviceData->pollingInterval * 2;
+    }
+
+    deviceData->pollingInterval = interval;
+    deviceData->pollingDelay = interval + (unsigned int)(interval * (POLLING_JITTER_PERCENT / 100.0) * (rand() / (double)RAND_MAX));
+}
+
+/*prepareMessages builds the GET of the next C2D message of the device. Returns false when the device is not subscribed, when it has
+polled too recently or when the request could not be built*/
+static bool prepareMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, HTTP_EXCHANGE* exchange)
+{
+    bool result = false;
+
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_083: [ If device is not subscribed then _DoWork shall advance to the next action. ] */
     if (deviceData->DoWork_PullMessage)
     {
@@ -2143,7 +2706,8 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_124: [If time is not available then all calls shall be treated as if they are the first one.] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_122: [A GET request that happens earlier than GetMinimumPollingTime shall be ignored.] */
         time_t timeNow = get_time(NULL);
-        bool isPollingAllowed = deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > handleData->getMinimumPollingTime);
+        unsigned int pollingTime = isAdaptivePolling(handleData) ? deviceData->pollingDelay : handleData->getMinimumPollingTime;
+        bool isPollingAllowed = deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > pollingTime);
         if (isPollingAllowed)
         {
             HTTP_HEADERS_HANDLE responseHTTPHeaders = HTTPHeaders_Alloc();
@@ -2160,35 +2724,16 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
                     LogError("unable to BUFFER_new");
                 }
+                /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
+                else if ((deviceData->deviceSasToken != NULL) &&
+                    (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->messageHTTPrequestHeaders, IOTHUB_AUTH_HEADER_VALUE, STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK))
+                {
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
+                    LogError("Unable to replace the old SAS Token.");
+                    BUFFER_delete(responseContent);
+                }
                 else
                 {
-                    unsigned int statusCode = 0;
-                    HTTPAPIEX_RESULT r;
-                    if (deviceData->deviceSasToken != NULL)
-                    {
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
-                        if (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->messageHTTPrequestHeaders, IOTHUB_AUTH_HEADER_VALUE, STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
-                        {
-                            r = HTTPAPIEX_ERROR;
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
-                            LogError("Unable to replace the old SAS Token.");
-                        }
-                        else if ((r = HTTPAPIEX_ExecuteRequest(
-                            handleData->httpApiExHandle,
-                            HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
-                            STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
-                            deviceData->messageHTTPrequestHeaders,                     /*requestHttpHeadersHandle: message HTTP request headers created by _Create*/
-                            NULL,                                                           /*requestContent: NULL*/
-                            &statusCode,                                                    /*statusCode: a pointer to unsigned int which shall be later examined*/
-                            responseHTTPHeaders,                                            /*responseHeadearsHandle: a new instance of HTTP headers*/
-                            responseContent                                                 /*responseContent: a new instance of buffer*/
-                        )) != HTTPAPIEX_OK)
-                        {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
-                            LogError("Unable to HTTPAPIEX_ExecuteRequest.");
-                        }
-                    }
-
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_084: [Otherwise, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters
                     requestType: GET
                     relativePath: the message HTTP relative path
@@ -2198,142 +2743,309 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                     responseHeadearsHandle: a new instance of HTTP headers
                     responseContent: a new instance of buffer]
                     */
-                    else if ((r = HTTPAPIEX_SAS_ExecuteRequest(
-                        deviceData->sasObject,
-                        handleData->httpApiExHandle,
-                        HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
-                        STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
-                        deviceData->messageHTTPrequestHeaders,                     /*requestHttpHeadersHandle: message HTTP request headers created by _Create*/
-                        NULL,                                                           /*requestContent: NULL*/
-                        &statusCode,                                                    /*statusCode: a pointer to unsigned int which shall be later examined*/
-                        responseHTTPHeaders,                                            /*responseHeadearsHandle: a new instance of HTTP headers*/
-                        responseContent                                                 /*responseContent: a new instance of buffer*/
-                    )) != HTTPAPIEX_OK)
-                    {
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
-                        LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
-                    }
-                    if (r == HTTPAPIEX_OK)
+                    exchange->deviceData = deviceData;
+                    exchange->requestType = HTTPAPI_REQUEST_GET;
+                    exchange->relativePath = STRING_c_str(deviceData->messageHTTPrelativePath);
+                    exchange->requestHeaders = deviceData->messageHTTPrequestHeaders;
+                    exchange->requestContent = NULL;
+                    exchange->responseHeaders = responseHTTPHeaders;
+                    exchange->responseContent = responseContent;
+                    exchange->useSasObject = (deviceData->deviceSasToken == NULL);
+                    exchange->isBatch = false;
+                    exchange->pollTime = timeNow;
+                    exchange->statusCode = 0;
+                    exchange->result = HTTPAPIEX_ERROR;
+                    result = true;
+                }
+
+                if (!result)
+                {
+                    HTTPHeaders_Free(responseHTTPHeaders);
+                }
+            }
+        }
+        else
+        {
+            /*isPollingAllowed is false... */
+            /*do nothing "shall be ignored*/
+        }
+    }
+
+    return result;
+}
+
+/*completeMessages hands the C2D message received by an executed GET to the device, abandoning it when that cannot be done*/
+static void completeMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTP_EXCHANGE* exchange)
+{
+    HTTPTRANSPORT_PERDEVICE_DATA* deviceData = exchange->deviceData;
+    HTTP_HEADERS_HANDLE responseHTTPHeaders = exchange->responseHeaders;
+    BUFFER_HANDLE responseContent = exchange->responseContent;
+    unsigned int statusCode = exchange->statusCode;
+
+    /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
+    if (exchange->result == HTTPAPIEX_OK)
+    {
+        /*HTTP dialogue was succesfull*/
+        if (exchange->pollTime == (time_t)(-1))
+        {
+            deviceData->isFirstPoll = true;
+        }
+        else
+        {
+            deviceData->isFirstPoll = false;
+            deviceData->lastPollTime = exchange->pollTime;
+        }
+
+        if (statusCode == 200)
+        {
+            handleData->pollingStatistics.message_polls++;
+        }
+        else if (statusCode == 204)
+        {
+            handleData->pollingStatistics.empty_polls++;
+        }
+        else
+        {
+            handleData->pollingStatistics.failed_polls++;
+        }
+
+        if (isAdaptivePolling(handleData))
+        {
+            /*throttled or failed GETs back off the same as empty ones*/
+            scheduleNextPoll(handleData, deviceData, (statusCode == 200));
+        }
+
+        if (statusCode == 204)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
+            /*this is an expected status code, means "no commands", but logging that creates panic*/
+
+            /*do nothing, advance to next action*/
+        }
+        else if (statusCode != 200)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
+            LogError("expected status code was 200, but actually was received %u... moving on", statusCode);
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_087: [If status code is 200, then _DoWork shall make a copy of the value of the "ETag" http header.]*/
+            const char* etagValue = HTTPHeaders_FindHeaderValue(responseHTTPHeaders, "ETag");
+            if (etagValue == NULL)
+            {
+                LogError("unable to find a received header called \"E-Tag\"");
+            }
+            else
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_088: [If no such header is found or is invalid, then _DoWork shall advance to the next action.]*/
+                size_t etagsize = strlen(etagValue);
+                if (
+                    (etagsize < 2) ||
+                    (etagValue[0] != '"') ||
+                    (etagValue[etagsize - 1] != '"')
+                    )
+                {
+                    LogError("ETag is not a valid quoted string");
+                }
+                else
+                {
+                    const unsigned char* resp_content;
+                    size_t resp_len;
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_089: [_DoWork shall assemble an IOTHUBMESSAGE_HANDLE from the received HTTP content (using the responseContent buffer).] */
+                    resp_content = BUFFER_u_char(responseContent);
+                    resp_len = BUFFER_length(responseContent);
+                    IOTHUB_MESSAGE_HANDLE receivedMessage = IoTHubMessage_CreateFromByteArray(resp_content, resp_len);
+                    if (receivedMessage == NULL)
                     {
-                        /*HTTP dialogue was succesfull*/
-                        if (timeNow == (time_t)(-1))
+                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_092: [If assembling the message fails in any way, then _DoWork shall "abandon" the message.]*/
+                        LogError("unable to IoTHubMessage_CreateFromByteArray, trying to abandon the message... ");
+                        if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
                         {
-                            deviceData->isFirstPoll = true;
+                            LogError("HTTP Transport layer failed to report ABANDON disposition");
                         }
-                        else
-                        {
-                            deviceData->isFirstPoll = false;
-                            deviceData->lastPollTime = timeNow;
-                        }
-                        if (statusCode == 204)
-                        {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
-                            /*this is an expected status code, means "no commands", but logging that creates panic*/
-
-                            /*do nothing, advance to next action*/
-                        }
-                        else if (statusCode != 200)
+                    }
+                    else
+                    {
+                        if (retrieve_message_properties(responseHTTPHeaders, receivedMessage) != 0)
                         {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
-                            LogError("expected status code was 200, but actually was received %u... moving on", statusCode);
+                            if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                            {
+                                LogError("HTTP Transport layer failed to report ABANDON disposition");
+                            }
                         }
                         else
                         {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_087: [If status code is 200, then _DoWork shall make a copy of the value of the "ETag" http header.]*/
-                            const char* etagValue = HTTPHeaders_FindHeaderValue(responseHTTPHeaders, "ETag");
-                            if (etagValue == NULL)
+                            MESSAGE_CALLBACK_INFO* messageData = MESSAGE_CALLBACK_INFO_Create(receivedMessage, handleData, deviceData, etagValue);
+                            if (messageData == NULL)
                             {
-                                LogError("unable to find a received header called \"E-Tag\"");
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_10_006: [If assembling the transport context fails, _DoWork shall "abandon" the message.] */
+                                LogError("failed to assemble callback info");
+                                if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                                {
+                                    LogError("HTTP Transport layer failed to report ABANDON disposition");
+                                }
                             }
                             else
                             {
-                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_088: [If no such header is found or is invalid, then _DoWork shall advance to the next action.]*/
-                                size_t etagsize = strlen(etagValue);
-                                if (
-                                    (etagsize < 2) ||
-                                    (etagValue[0] != '"') ||
-                                    (etagValue[etagsize - 1] != '"')
-                                    )
+                                bool abandon;
+                                if (handleData->transport_callbacks.msg_cb(messageData, deviceData->device_transport_ctx))
                                 {
-                                    LogError("ETag is not a valid quoted string");
+                                    abandon = false;
                                 }
                                 else
                                 {
-                                    const unsigned char* resp_content;
-                                    size_t resp_len;
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_089: [_DoWork shall assemble an IOTHUBMESSAGE_HANDLE from the received HTTP content (using the responseContent buffer).] */
-                                    resp_content = BUFFER_u_char(responseContent);
-                                    resp_len = BUFFER_length(responseContent);
-                                    IOTHUB_MESSAGE_HANDLE receivedMessage = IoTHubMessage_CreateFromByteArray(resp_content, resp_len);
-                                    if (receivedMessage == NULL)
-                                    {
-                                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_092: [If assembling the message fails in any way, then _DoWork shall "abandon" the message.]*/
-                                        LogError("unable to IoTHubMessage_CreateFromByteArray, trying to abandon the message... ");
-                                        if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
-                                        {
-                                            LogError("HTTP Transport layer failed to report ABANDON disposition");
-                                        }
-                                    }
-                                    else
-                                    {
-                                        if (retrieve_message_properties(responseHTTPHeaders, receivedMessage) != 0)
-                                        {
-                                            if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
-                                            {
-                                                LogError("HTTP Transport layer failed to report ABANDON disposition");
-                                            }
-                                        }
-                                        else
-                                        {
-                                            MESSAGE_CALLBACK_INFO* messageData = MESSAGE_CALLBACK_INFO_Create(receivedMessage, handleData, deviceData, etagValue);
-                                            if (messageData == NULL)
-                                            {
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_10_006: [If assembling the transport context fails, _DoWork shall "abandon" the message.] */
-                                                LogError("failed to assemble callback info");
-                                                if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
-                                                {
-                                                    LogError("HTTP Transport layer failed to report ABANDON disposition");
-                                                }
-                                            }
-                                            else
-                                            {
-                                                bool abandon;
-                                                if (handleData->transport_callbacks.msg_cb(messageData, deviceData->device_transport_ctx))
-                                                {
-                                                    abandon = false;
-                                                }
-                                                else
-                                                {
-                                                    LogError("IoTHubClientCore_LL_MessageCallback failed");
-                                                    abandon = true;
-                                                }
-
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_096: [If IoTHubClientCore_LL_MessageCallback returns false then _DoWork shall "abandon" the message.] */
-                                                if (abandon)
-                                                {
-                                                    (void)IoTHubTransportHttp_SendMessageDisposition(messageData, IOTHUBMESSAGE_ABANDONED);
-                                                }
-                                            }
-                                        }
-                                        IoTHubMessage_Destroy(receivedMessage);
-                                    }
+                                    LogError("IoTHubClientCore_LL_MessageCallback failed");
+                                    abandon = true;
+                                }
+
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_096: [If IoTHubClientCore_LL_MessageCallback returns false then _DoWork shall "abandon" the message.] */
+                                if (abandon)
+                                {
+                                    (void)IoTHubTransportHttp_SendMessageDisposition(messageData, IOTHUBMESSAGE_ABANDONED);
                                 }
                             }
                         }
+                        IoTHubMessage_Destroy(receivedMessage);
                     }
-                    BUFFER_delete(responseContent);
                 }
-                HTTPHeaders_Free(responseHTTPHeaders);
+            }
+        }
+    }
+    else
+    {
+        handleData->pollingStatistics.failed_polls++;
+
+        if (isAdaptivePolling(handleData))
+        {
+            /*an unreachable hub backs off the same as an empty queue, which needs the failed GET to count as the last poll*/
+            if (exchange->pollTime != (time_t)(-1))
+            {
+                deviceData->isFirstPoll = false;
+                deviceData->lastPollTime = exchange->pollTime;
+            }
+            scheduleNextPoll(handleData, deviceData, false);
+        }
+    }
+    BUFFER_delete(responseContent);
+    HTTPHeaders_Free(responseHTTPHeaders);
+}
+
+static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    HTTP_EXCHANGE exchange;
+    if (prepareMessages(handleData, deviceData, &exchange))
+    {
+        executeExchange(handleData->httpApiExHandle, &exchange);
+        completeMessages(handleData, &exchange);
+    }
+}
+
+/*executeExchanges executes the exchanges over the connection pool, the calling thread taking its part over httpApiExHandle and
+the workers of the pooled connections the rest. Returns once all of them have been executed*/
+static void executeExchanges(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTP_EXCHANGE* exchanges, size_t count)
+{
+    HTTP_EXCHANGE_QUEUE* queue = &handleData->exchangeQueue;
+
+    if (Lock(queue->lock) != LOCK_OK)
+    {
+        size_t i;
+        LogError("failed locking the HTTP exchanges, they are executed over a single connection");
+        for (i = 0; i < count; i++)
+        {
+            executeExchange(handleData->httpApiExHandle, &exchanges[i]);
+        }
+    }
+    else
+    {
+        size_t i;
+
+        for (i = 0; i < count; i++)
+        {
+            exchanges[i].executed = 0;
+        }
+        queue->exchanges = exchanges;
+        queue->count = count;
+        queue->next = 0;
+        /*the calling thread takes an exchange too, so one worker fewer than exchanges is woken*/
+        for (i = 0; (i < handleData->exchangeWorkerCount) && (i + 1 < count); i++)
+        {
+            (void)Condition_Post(queue->exchangesQueued);
+        }
+
+        if (runQueuedExchanges(queue, handleData->httpApiExHandle) != 0)
+        {
+            /*the exchanges claimed by the workers are still theirs, only their executed flags can be read without the lock*/
+            LogError("waiting for the HTTP exchanges without the lock");
+            while (!allExchangesExecuted(queue))
+            {
+                ThreadAPI_Sleep(HTTP_EXCHANGES_MAX_WAIT_MS);
             }
         }
         else
         {
-            /*isPollingAllowed is false... */
-            /*do nothing "shall be ignored*/
+            while (!allExchangesExecuted(queue))
+            {
+                (void)Condition_Wait(queue->exchangesExecuted, queue->lock, HTTP_EXCHANGES_MAX_WAIT_MS);
+            }
+            queue->exchanges = NULL;
+            queue->count = 0;
+            queue->next = 0;
+            (void)Unlock(queue->lock);
         }
     }
 }
 
+/*DoExchanges sends the events and polls the C2D messages of all the devices at the same time over the connection pool.
+Requests are built, and their responses handled, in the order DoEvent and DoMessages would have done it*/
+static void DoExchanges(HTTPTRANSPORT_HANDLE_DATA* handleData, size_t deviceListSize)
+{
+    /*an event POST and a C2D GET per device*/
+    HTTP_EXCHANGE* exchanges = (HTTP_EXCHANGE*)malloc(2 * deviceListSize * sizeof(HTTP_EXCHANGE));
+    if (exchanges == NULL)
+    {
+        LogError("unable to malloc the HTTP exchanges, the devices are served one after the other");
+        for (size_t i = 0; i < deviceListSize; i++)
+        {
+            HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, i);
+            DoEvent(handleData, perDeviceItem);
+            DoMessages(handleData, perDeviceItem);
+        }
+    }
+    else
+    {
+        size_t count = 0;
+        size_t i;
+
+        for (i = 0; i < deviceListSize; i++)
+        {
+            HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, i);
+            if (prepareEvent(handleData, perDeviceItem, &exchanges[count]))
+            {
+                count++;
+            }
+            if (prepareMessages(handleData, perDeviceItem, &exchanges[count]))
+            {
+                count++;
+            }
+        }
+
+        executeExchanges(handleData, exchanges, count);
+
+        for (i = 0; i < count; i++)
+        {
+            if (exchanges[i].requestType == HTTPAPI_REQUEST_POST)
+            {
+                completeEvent(handleData, &exchanges[i]);
+            }
+            else
+            {
+                completeMessages(handleData, &exchanges[i]);
+            }
+        }
+        free(exchanges);
+    }
+}
+
 static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportHttp_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
 {
     (void)handle;
@@ -2354,12 +3066,19 @@ static void IoTHubTransportHttp_DoWork(TRANSPORT_LL_HANDLE handle)
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_052: [ IoTHubTransportHttp_DoWork shall perform a round-robin loop through every deviceHandle in the transport device list. ]*/
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_050: [ IoTHubTransportHttp_DoWork shall call loop through the device list. ] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_051: [ IF the list is empty, then IoTHubTransportHttp_DoWork shall do nothing. ]*/
-        for (size_t i = 0; i < deviceListSize; i++)
+        if ((handleData->connectionCount > 1) && (deviceListSize > 0))
         {
-            listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_element(handleData->perDeviceList, i);
-            HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
-            DoEvent(handleData, perDeviceItem);
-            DoMessages(handleData, perDeviceItem);
+            DoExchanges(handleData, deviceListSize);
+        }
+        else
+        {
+            for (size_t i = 0; i < deviceListSize; i++)
+            {
+                listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_element(handleData->perDeviceList, i);
+                HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
+                DoEvent(handleData, perDeviceItem);
+                DoMessages(handleData, perDeviceItem);
+            }
         }
     }
     else
@@ -2444,13 +3163,22 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
             handleData->getMinimumPollingTime = *(unsigned int*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(OPTION_MAX_POLLING_TIME, option) == 0)
+        {
+            handleData->getMaximumPollingTime = *(unsigned int*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_HTTP_CONNECTIONS, option) == 0)
+        {
+            result = setConnectionCount(handleData, *(size_t*)value);
+        }
         else
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_126: [ "TrustedCerts"] */
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_127: [ NULL shall be allowed. ]*/
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_129: [ This option shall passed down to the lower layer by calling HTTPAPIEX_SetOption. ]*/
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_118: [Otherwise, IoTHubTransport_Http shall call HTTPAPIEX_SetOption with the same parameters and return the translated code.] */
-            HTTPAPIEX_RESULT HTTPAPIEX_result = HTTPAPIEX_SetOption(handleData->httpApiExHandle, option, value);
+            HTTPAPIEX_RESULT HTTPAPIEX_result = setPassthroughOption(handleData, option, value);
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_119: [The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes:] */
             if (HTTPAPIEX_result == HTTPAPIEX_OK)
             {
@@ -2471,6 +3199,27 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
     return result;
 }
 
+static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetOption(TRANSPORT_LL_HANDLE handle, const char* option, void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if ((handle == NULL) || (option == NULL) || (value == NULL))
+    {
+        LogError("invalid parameter handle=%p, option=%p, value=%p", handle, option, value);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (strcmp(OPTION_HTTP_POLLING_STATISTICS, option) == 0)
+    {
+        *(IOTHUB_HTTP_POLLING_STATISTICS*)value = ((HTTPTRANSPORT_HANDLE_DATA*)handle)->pollingStatistics;
+        result = IOTHUB_CLIENT_OK;
+    }
+    else
+    {
+        LogError("unknown option %s", option);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    return result;
+}
+
 static STRING_HANDLE IoTHubTransportHttp_GetHostname(TRANSPORT_LL_HANDLE handle)
 {
     STRING_HANDLE result;
@@ -2573,7 +3322,8 @@ static TRANSPORT_PROVIDER thisTransportProvider =
     IotHubTransportHttp_Unsubscribe_InputQueue,     /*pfIoTHubTransport_Unsubscribe_InputQueue IoTHubTransport_Unsubscribe_InputQueue; */
     IoTHubTransportHttp_SetCallbackContext,         /*pfIoTHubTransport_SetTransportCallbacks IoTHubTransport_SetTransportCallbacks; */
     IoTHubTransportHttp_GetTwinAsync,               /*pfIoTHubTransport_GetTwinAsync IoTHubTransport_GetTwinAsync;*/
-    IoTHubTransportHttp_GetSupportedPlatformInfo      /*pfIoTHubTransport_GetSupportedPlatformInfo IoTHubTransport_GetSupportedPlatformInfo;*/
+    IoTHubTransportHttp_GetSupportedPlatformInfo,     /*pfIoTHubTransport_GetSupportedPlatformInfo IoTHubTransport_GetSupportedPlatformInfo;*/
+    IoTHubTransportHttp_GetOption                   /*pfIoTHubTransport_GetOption IoTHubTransport_GetOption;*/
 };
 
 const TRANSPORT_PROVIDER* HTTP_Protocol(void)
@@ -0,0 +1,170 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "internal/timeout_heap.h"
+
+static bool is_before(const TIMEOUT_HEAP_NODE* a, const TIMEOUT_HEAP_NODE* b)
+{
+    return (a->deadline < b->deadline) || ((a->deadline == b->deadline) && (a->sequence < b->sequence));
+}
+
+/*a and b are roots (no siblings); the later of them becomes the first child of the other*/
+static TIMEOUT_HEAP_NODE* meld(TIMEOUT_HEAP_NODE* a, TIMEOUT_HEAP_NODE* b)
+{
+    TIMEOUT_HEAP_NODE* result;
+
+    if (a == NULL)
+    {
+        result = b;
+    }
+    else if (b == NULL)
+    {
+        result = a;
+    }
+    else
+    {
+        if (is_before(b, a))
+        {
+            TIMEOUT_HEAP_NODE* temp = a;
+            a = b;
+            b = temp;
+        }
+
+        b->prev = a;
+        b->next = a->child;
+        if (a->child != NULL)
+        {
+            a->child->prev = b;
+        }
+        a->child = b;
+        result = a;
+    }
+
+    return result;
+}
+
+/*melds a list of siblings into one root: pairs from left to right, then the pairs from right to left*/
+static TIMEOUT_HEAP_NODE* meld_siblings(TIMEOUT_HEAP_NODE* first)
+{
+    TIMEOUT_HEAP_NODE* pairs = NULL;
+    TIMEOUT_HEAP_NODE* result = NULL;
+
+    while (first != NULL)
+    {
+        TIMEOUT_HEAP_NODE* a = first;
+        TIMEOUT_HEAP_NODE* b = a->next;
+
+        first = (b == NULL) ? NULL : b->next;
+
+        a->prev = NULL;
+        a->next = NULL;
+        if (b != NULL)
+        {
+            b->prev = NULL;
+            b->next = NULL;
+        }
+
+        a = meld(a, b);
+        /*the pairs are chained through next in reverse order, which is the order of the second pass*/
+        a->next = pairs;
+        pairs = a;
+    }
+
+    while (pairs != NULL)
+    {
+        TIMEOUT_HEAP_NODE* pair = pairs;
+        pairs = pair->next;
+        pair->next = NULL;
+        result = meld(pair, result);
+    }
+
+    return result;
+}
+
+void timeout_heap_init(TIMEOUT_HEAP* heap)
+{
+    heap->root = NULL;
+    heap->next_sequence = 0;
+}
+
+void timeout_heap_node_init(TIMEOUT_HEAP_NODE* node)
+{
+    node->deadline = 0;
+    node->sequence = 0;
+    node->child = NULL;
+    node->next = NULL;
+    node->prev = NULL;
+}
+
+bool timeout_heap_node_is_queued(const TIMEOUT_HEAP* heap, const TIMEOUT_HEAP_NODE* node)
+{
+    return (node->prev != NULL) || (heap->root == node);
+}
+
+void timeout_heap_add(TIMEOUT_HEAP* heap, TIMEOUT_HEAP_NODE* node, uint64_t deadline)
+{
+    timeout_heap_remove(heap, node);
+
+    node->deadline = deadline;
+    node->sequence = heap->next_sequence++;
+    heap->root = meld(heap->root, node);
+}
+
+void timeout_heap_remove(TIMEOUT_HEAP* heap, TIMEOUT_HEAP_NODE* node)
+{
+    if (timeout_heap_node_is_queued(heap, node))
+    {
+        TIMEOUT_HEAP_NODE* children = meld_siblings(node->child);
+
+        if (node == heap->root)
+        {
+            heap->root = children;
+        }
+        else
+        {
+            if (node->prev->child == node)
+            {
+                node->prev->child = node->next;
+            }
+            else
+            {
+                node->prev->next = node->next;
+            }
+
+            if (node->next != NULL)
+            {
+                node->next->prev = node->prev;
+            }
+
+            heap->root = meld(heap->root, children);
+        }
+
+        timeout_heap_node_init(node);
+    }
+}
+
+TIMEOUT_HEAP_NODE* timeout_heap_peek(const TIMEOUT_HEAP* heap)
+{
+    return heap->root;
+}
+
+TIMEOUT_HEAP_NODE* timeout_heap_pop_expired(TIMEOUT_HEAP* heap, uint64_t now)
+{
+    TIMEOUT_HEAP_NODE* result = heap->root;
+
+    if (result != NULL && result->deadline <= now)
+    {
+        timeout_heap_remove(heap, result);
+    }
+    else
+    {
+        result = NULL;
+    }
+
+    return result;
+}
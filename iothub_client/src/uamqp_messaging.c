@@ -663,9 +663,53 @@ static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE
     return result;
 }
 
+// Points body_binary_data at room for size bytes of encoding: a new allocation when there is no scratch buffer, otherwise the
+// scratch buffer itself, grown to at least twice its size when it is too small so that it soon stops growing.
+static int reserve_encoding_buffer(unsigned char** scratch_buffer, size_t* scratch_buffer_size, size_t size, BINARY_DATA* body_binary_data)
+{
+    int result;
+
+    if (scratch_buffer == NULL)
+    {
+        if ((body_binary_data->bytes = malloc(size)) == NULL)
+        {
+            LogError("malloc of %lu bytes failed", (unsigned long)size);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            result = RESULT_OK;
+        }
+    }
+    else if (size <= *scratch_buffer_size)
+    {
+        body_binary_data->bytes = *scratch_buffer;
+        result = RESULT_OK;
+    }
+    else
+    {
+        size_t new_size = (size > 2 * (*scratch_buffer_size)) ? size : 2 * (*scratch_buffer_size);
+        unsigned char* new_buffer = (unsigned char*)realloc(*scratch_buffer, new_size);
+        if (new_buffer == NULL)
+        {
+            LogError("realloc of %lu bytes failed", (unsigned long)new_size);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            *scratch_buffer = new_buffer;
+            *scratch_buffer_size = new_size;
+            body_binary_data->bytes = new_buffer;
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
+
 // Codes_SRS_UAMQP_MESSAGING_31_120: [Create a blob that contains AMQP encoding of IOTHUB_MESSAGE_HANDLE.]
 // Codes_SRS_UAMQP_MESSAGING_31_121: [Any errors during `message_create_uamqp_encoding_from_iothub_message` stop processing on this message.]
-int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+static int encode_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, unsigned char** scratch_buffer, size_t* scratch_buffer_size, BINARY_DATA* body_binary_data)
 {
     int result;
 
@@ -701,9 +745,9 @@ int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_bat
         LogError("create_data_to_encode() failed");
         result = MU_FAILURE;
     }
-    else if ((body_binary_data->bytes = malloc(message_properties_length + application_properties_length + data_length + message_annotations_length)) == NULL)
+    else if (reserve_encoding_buffer(scratch_buffer, scratch_buffer_size, message_properties_length + application_properties_length + data_length + message_annotations_length, body_binary_data) != RESULT_OK)
     {
-        LogError("malloc of %lu bytes failed", (unsigned long)(message_properties_length + application_properties_length + data_length + message_annotations_length));
+        LogError("reserve_encoding_buffer() failed");
         result = MU_FAILURE;
     }
     // Codes_SRS_UAMQP_MESSAGING_31_119: [Invoke underlying AMQP encode routines on data waiting to be encoded.]
@@ -756,6 +800,30 @@ int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_bat
     return result;
 }
 
+int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+{
+    return encode_iothub_message(message_batch_container, message_handle, NULL, NULL, body_binary_data);
+}
+
+int message_encode_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, unsigned char** scratch_buffer, size_t* scratch_buffer_size, BINARY_DATA* body_binary_data)
+{
+    int result;
+
+    if ((scratch_buffer == NULL) || (scratch_buffer_size == NULL) || (body_binary_data == NULL))
+    {
+        LogError("Invalid argument (scratch_buffer=%p, scratch_buffer_size=%p, body_binary_data=%p)", scratch_buffer, scratch_buffer_size, body_binary_data);
+        result = MU_FAILURE;
+    }
+    else if ((result = encode_iothub_message(message_batch_container, message_handle, scratch_buffer, scratch_buffer_size, body_binary_data)) != RESULT_OK)
+    {
+        // The scratch buffer is the caller's to free, not body_binary_data->bytes.
+        body_binary_data->bytes = NULL;
+        body_binary_data->length = 0;
+    }
+
+    return result;
+}
+
 static int readMessageIdFromuAQMPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, PROPERTIES_HANDLE uamqp_message_properties)
 {
     int result;
@@ -0,0 +1,285 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "internal/blob_block_sizer.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_MIN_SIZE       (64 * 1024)
+#define TEST_MAX_SIZE       (4 * 1024 * 1024)
+/*a link where every block waits TEST_RTT_MS on top of TEST_BYTES_PER_MS per millisecond*/
+#define TEST_RTT_MS         50
+#define TEST_BYTES_PER_MS   4096
+
+static tickcounter_ms_t block_time(size_t size)
+{
+    return TEST_RTT_MS + (tickcounter_ms_t)(size / TEST_BYTES_PER_MS);
+}
+
+BEGIN_TEST_SUITE(blob_block_sizer_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(blob_block_sizer_create_with_min_size_over_max_size_fails)
+{
+    // act
+    BLOB_BLOCK_SIZER_HANDLE sizer = blob_block_sizer_create(TEST_MAX_SIZE, TEST_MIN_SIZE);
+
+    // assert
+    ASSERT_IS_NULL(sizer);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(blob_block_sizer_create_fails_when_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    BLOB_BLOCK_SIZER_HANDLE sizer = blob_block_sizer_create(TEST_MIN_SIZE, TEST_MAX_SIZE);
+
+    // assert
+    ASSERT_IS_NULL(sizer);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(blob_block_sizer_starts_with_the_initial_size)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    BLOB_BLOCK_SIZER_HANDLE sizer = blob_block_sizer_create(TEST_MIN_SIZE, TEST_MAX_SIZE);
+
+    // assert
+    ASSERT_IS_NOT_NULL(sizer);
+    ASSERT_ARE_EQUAL(size_t, BLOB_BLOCK_SIZER_INITIAL_SIZE, blob_block_sizer_get_size(sizer));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    blob_block_sizer_destroy(sizer);
+}
+
+TEST_FUNCTION(blob_block_sizer_initial_size_is_kept_within_bounds)
+{
+    // act
+    BLOB_BLOCK_SIZER_HANDLE small = blob_block_sizer_create(TEST_MIN_SIZE, TEST_MIN_SIZE);
+    BLOB_BLOCK_SIZER_HANDLE large = blob_block_sizer_create(TEST_MAX_SIZE, TEST_MAX_SIZE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, TEST_MIN_SIZE, blob_block_sizer_get_size(small));
+    ASSERT_ARE_EQUAL(size_t, TEST_MAX_SIZE, blob_block_sizer_get_size(large));
+
+    // cleanup
+    blob_block_sizer_destroy(small);
+    blob_block_sizer_destroy(large);
+}
+
+TEST_FUNCTION(blob_block_sizer_doubles_blocks_while_the_round_trip_dominates)
+{
+    // arrange
+    BLOB_BLOCK_SIZER_HANDLE sizer = blob_block_sizer_create(TEST_MIN_SIZE, TEST_MAX_SIZE);
+    size_t size = blob_block_sizer_get_size(sizer);
+
+    // act
+    blob_block_sizer_on_block_sent(sizer, size, block_time(size), false);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2 * size, blob_block_sizer_get_size(sizer));
+
+    // cleanup
+    blob_block_sizer_destroy(sizer);
+}
+
+TEST_FUNCTION(blob_block_sizer_stops_growing_once_doubling_gains_little)
+{
+    // arrange
+    BLOB_BLOCK_SIZER_HANDLE sizer = blob_block_sizer_create(TEST_MIN_SIZE, TEST_MAX_SIZE);
+    size_t size;
+    size_t i;
+
+    // act
+    for (i = 0; i < 10; i++)
+    {
+        size = blob_block_sizer_get_size(sizer);
+        blob_block_sizer_on_block_sent(sizer, size, block_time(size), false);
+    }
+
+    // assert
+    /*256K take 114ms, 512K 178ms (+28%), 1M 306ms (+16%), 2M 562ms (+9%): the sizer settles on 2M*/
+    ASSERT_ARE_EQUAL(size_t, 2 * 1024 * 1024, blob_block_sizer_get_size(sizer));
+
+    // cleanup
+    blob_block_sizer_destroy(sizer);
+}
+
+TEST_FUNCTION(blob_block_sizer_grows_up_to_max_size_on_a_fast_link)
+{
+    // arrange
+    BLOB_BLOCK_SIZER_HANDLE sizer = blob_block_sizer_create(TEST_MIN_SIZE, TEST_MAX_SIZE);
+    size_t i;
+
+    // act
+    for (i = 0; i < 10; i++)
+    {
+        /*too fast to be measured*/
+        blob_block_sizer_on_block_sent(sizer, blob_block_sizer_get_size(sizer), 1, false);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, TEST_MAX_SIZE, blob_block_sizer_get_size(sizer));
+
+    // cleanup
+    blob_block_sizer_destroy(sizer);
+}
+
+TEST_FUNCTION(blob_block_sizer_ignores_blocks_of_an_earlier_size)
+{
+    // arrange
+    BLOB_BLOCK_SIZER_HANDLE sizer = blob_block_sizer_create(TEST_MIN_SIZE, TEST_MAX_SIZE);
+    size_t size = blob_block_sizer_get_size(sizer);
+    blob_block_sizer_on_block_sent(sizer, size, block_time(size), false);
+
+    // act
+    blob_block_sizer_on_block_sent(sizer, size, block_time(size), false);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2 * size, blob_block_sizer_get_size(sizer));
+
+    // cleanup
+    blob_block_sizer_destroy(sizer);
+}
+
+TEST_FUNCTION(blob_block_sizer_halves_blocks_that_had_to_be_retried)
+{
+    // arrange
+    BLOB_BLOCK_SIZER_HANDLE sizer = blob_block_sizer_create(TEST_MIN_SIZE, TEST_MAX_SIZE);
+    size_t size = blob_block_sizer_get_size(sizer);
+
+    // act
+    blob_block_sizer_on_block_sent(sizer, size, block_time(size), true);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, size / 2, blob_block_sizer_get_size(sizer));
+
+    // cleanup
+    blob_block_sizer_destroy(sizer);
+}
+
+TEST_FUNCTION(blob_block_sizer_does_not_go_below_min_size)
+{
+    // arrange
+    BLOB_BLOCK_SIZER_HANDLE sizer = blob_block_sizer_create(TEST_MIN_SIZE, TEST_MAX_SIZE);
+    size_t i;
+
+    // act
+    for (i = 0; i < 10; i++)
+    {
+        blob_block_sizer_on_block_sent(sizer, blob_block_sizer_get_size(sizer), TEST_RTT_MS, true);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, TEST_MIN_SIZE, blob_block_sizer_get_size(sizer));
+
+    // cleanup
+    blob_block_sizer_destroy(sizer);
+}
+
+TEST_FUNCTION(blob_block_sizer_probes_again_after_a_retry)
+{
+    // arrange
+    BLOB_BLOCK_SIZER_HANDLE sizer = blob_block_sizer_create(TEST_MIN_SIZE, TEST_MAX_SIZE);
+    size_t size;
+    size_t i;
+    for (i = 0; i < 10; i++)
+    {
+        size = blob_block_sizer_get_size(sizer);
+        blob_block_sizer_on_block_sent(sizer, size, block_time(size), false);
+    }
+    size = blob_block_sizer_get_size(sizer);
+    blob_block_sizer_on_block_sent(sizer, size, block_time(size), true);
+    size = blob_block_sizer_get_size(sizer);
+
+    // act
+    blob_block_sizer_on_block_sent(sizer, size, block_time(size), false);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2 * size, blob_block_sizer_get_size(sizer));
+
+    // cleanup
+    blob_block_sizer_destroy(sizer);
+}
+
+END_TEST_SUITE(blob_block_sizer_ut)
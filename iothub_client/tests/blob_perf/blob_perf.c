@@ -0,0 +1,214 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures the throughput of Blob_UploadMultipleBlocksFromSasUri at several upload concurrencies. Azure Storage is
+// replaced by a local stand-in of HTTPAPIEX that answers every request after a fixed round trip plus the time the
+// block takes at a fixed per connection bandwidth. Parallel uploads also get a 503 for every TRANSIENT_FAILURE_PERIOD-th
+// Put Block, so their per block retry is part of the measurement (the serial upload does not retry).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "internal/blob.h"
+
+#define UPLOAD_BLOCK_SIZE           (1024 * 1024)
+#define UPLOAD_BLOCK_COUNT          64
+#define ROUND_TRIP_MS               40
+/*bytes per millisecond a single connection carries, about 100 Mbit/s*/
+#define CONNECTION_BYTES_PER_MS     12500
+#define TRANSIENT_FAILURE_PERIOD    50
+
+static const size_t CONCURRENCIES[] = { 1, 2, 4, 8, 16 };
+
+static LOCK_HANDLE g_lock;
+static size_t g_put_block_count;
+static size_t g_put_block_list_count;
+static size_t g_transient_failure_count;
+static bool g_inject_transient_failures;
+
+typedef struct UPLOAD_SOURCE_TAG
+{
+    unsigned char* block;
+    size_t blocks_left;
+} UPLOAD_SOURCE;
+
+/*the stand-in connection only needs to be distinct per HTTPAPIEX_Create*/
+HTTPAPIEX_HANDLE HTTPAPIEX_Create(const char* hostName)
+{
+    (void)hostName;
+    return (HTTPAPIEX_HANDLE)malloc(1);
+}
+
+void HTTPAPIEX_Destroy(HTTPAPIEX_HANDLE handle)
+{
+    free(handle);
+}
+
+HTTPAPIEX_RESULT HTTPAPIEX_SetOption(HTTPAPIEX_HANDLE handle, const char* optionName, const void* value)
+{
+    (void)handle;
+    (void)optionName;
+    (void)value;
+    return HTTPAPIEX_OK;
+}
+
+HTTPAPIEX_RESULT HTTPAPIEX_ExecuteRequest(HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath,
+    HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode,
+    HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    size_t size = (requestContent == NULL) ? 0 : BUFFER_length(requestContent);
+    bool transient_failure = false;
+
+    (void)handle;
+    (void)requestType;
+    (void)requestHttpHeadersHandle;
+    (void)responseHttpHeadersHandle;
+    (void)responseContent;
+
+    ThreadAPI_Sleep((unsigned int)(ROUND_TRIP_MS + (size / CONNECTION_BYTES_PER_MS)));
+
+    if (Lock(g_lock) == LOCK_OK)
+    {
+        if (strstr(relativePath, "&comp=blocklist") != NULL)
+        {
+            g_put_block_list_count++;
+        }
+        else if (((++g_put_block_count % TRANSIENT_FAILURE_PERIOD) == 0) && g_inject_transient_failures)
+        {
+            g_transient_failure_count++;
+            transient_failure = true;
+        }
+        (void)Unlock(g_lock);
+    }
+
+    *statusCode = transient_failure ? 503 : 201;
+    return HTTPAPIEX_OK;
+}
+
+/*hands out the same buffer for every block, as an application reading a file into one buffer would*/
+static IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT get_data_callback(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, unsigned char const** data, size_t* size, void* context)
+{
+    UPLOAD_SOURCE* source = (UPLOAD_SOURCE*)context;
+
+    if (data != NULL && size != NULL)
+    {
+        if (result != FILE_UPLOAD_OK || source->blocks_left == 0)
+        {
+            *data = NULL;
+            *size = 0;
+        }
+        else
+        {
+            source->blocks_left--;
+            *data = source->block;
+            *size = UPLOAD_BLOCK_SIZE;
+        }
+    }
+
+    return IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_OK;
+}
+
+static int measure_upload(TICK_COUNTER_HANDLE tick_counter, unsigned char* block, size_t concurrency)
+{
+    int result;
+    UPLOAD_SOURCE source;
+    BUFFER_HANDLE response;
+    unsigned int http_status = 0;
+    tickcounter_ms_t start_ms;
+    tickcounter_ms_t end_ms;
+
+    source.block = block;
+    source.blocks_left = UPLOAD_BLOCK_COUNT;
+    g_put_block_count = 0;
+    g_put_block_list_count = 0;
+    g_transient_failure_count = 0;
+    g_inject_transient_failures = (concurrency > 1);
+
+    if ((response = BUFFER_new()) == NULL)
+    {
+        (void)printf("BUFFER_new failed\r\n");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        BLOB_RESULT upload_result;
+
+        (void)tickcounter_get_current_ms(tick_counter, &start_ms);
+        upload_result = Blob_UploadMultipleBlocksFromSasUri("https://storage.local/container/blob?sig=perf", get_data_callback, &source, &http_status, response, NULL, NULL, NULL, concurrency, NULL);
+        (void)tickcounter_get_current_ms(tick_counter, &end_ms);
+
+        if (upload_result != BLOB_OK || http_status >= 300 || g_put_block_list_count != 1)
+        {
+            (void)printf("upload with concurrency %lu failed (result=%d, httpStatus=%u)\r\n", (unsigned long)concurrency, (int)upload_result, http_status);
+            result = MU_FAILURE;
+        }
+        else
+        {
+            tickcounter_ms_t elapsed_ms = (end_ms > start_ms) ? (end_ms - start_ms) : 1;
+            double megabytes = ((double)UPLOAD_BLOCK_SIZE * UPLOAD_BLOCK_COUNT) / (1024.0 * 1024.0);
+
+            (void)printf("concurrency %2lu: %6lu ms, %7.2f MB/s, %lu Put Block (%lu retried)\r\n",
+                (unsigned long)concurrency, (unsigned long)elapsed_ms, megabytes * 1000.0 / (double)elapsed_ms,
+                (unsigned long)g_put_block_count, (unsigned long)g_transient_failure_count);
+            result = 0;
+        }
+        BUFFER_delete(response);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result;
+    TICK_COUNTER_HANDLE tick_counter;
+    unsigned char* block;
+
+    if ((g_lock = Lock_Init()) == NULL)
+    {
+        (void)printf("Lock_Init failed\r\n");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        if ((tick_counter = tickcounter_create()) == NULL)
+        {
+            (void)printf("tickcounter_create failed\r\n");
+            result = MU_FAILURE;
+        }
+        else
+        {
+            if ((block = (unsigned char*)malloc(UPLOAD_BLOCK_SIZE)) == NULL)
+            {
+                (void)printf("failed allocating the upload block\r\n");
+                result = MU_FAILURE;
+            }
+            else
+            {
+                size_t i;
+
+                (void)memset(block, 'b', UPLOAD_BLOCK_SIZE);
+                (void)printf("%lu blocks of %lu bytes, %d ms round trip, %d bytes/ms per connection\r\n",
+                    (unsigned long)UPLOAD_BLOCK_COUNT, (unsigned long)UPLOAD_BLOCK_SIZE, ROUND_TRIP_MS, CONNECTION_BYTES_PER_MS);
+
+                result = 0;
+                for (i = 0; i < sizeof(CONCURRENCIES) / sizeof(CONCURRENCIES[0]) && result == 0; i++)
+                {
+                    result = measure_upload(tick_counter, block, CONCURRENCIES[i]);
+                }
+                free(block);
+            }
+            tickcounter_destroy(tick_counter);
+        }
+        Lock_Deinit(g_lock);
+    }
+
+    return result;
+}
@@ -0,0 +1,515 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#undef ENABLE_MOCKS
+
+#include "azure_c_shared_utility/sha.h"
+#include "internal/blob_upload_journal.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_LOCK_HANDLE            (LOCK_HANDLE)0x4461
+#define TEST_JOURNAL_PATH           "blob_upload_journal_ut.journal"
+#define TEST_BLOB_URL               "https://h.h/container/blob"
+#define TEST_SAS_URI                TEST_BLOB_URL "?sig=first"
+#define TEST_RENEWED_SAS_URI        TEST_BLOB_URL "?sig=second"
+#define TEST_OTHER_SAS_URI          "https://h.h/container/other?sig=first"
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    size_t l = strlen(source);
+    *destination = (char*)malloc(l + 1);
+    (void)memcpy(*destination, source, l + 1);
+    return 0;
+}
+
+/*the journal only stores the digest, so the stand-in of SHA-256 folds the content into 32 bytes*/
+static uint8_t g_digest[SHA256HashSize];
+
+int SHA256Reset(SHA256Context* context)
+{
+    (void)context;
+    (void)memset(g_digest, 0, sizeof(g_digest));
+    return shaSuccess;
+}
+
+int SHA256Input(SHA256Context* context, const uint8_t* bytes, unsigned int bytecount)
+{
+    unsigned int i;
+    (void)context;
+    for (i = 0; i < bytecount; i++)
+    {
+        g_digest[i % SHA256HashSize] = (uint8_t)(g_digest[i % SHA256HashSize] * 31 + bytes[i] + 1);
+    }
+    return shaSuccess;
+}
+
+int SHA256Result(SHA256Context* context, uint8_t Message_Digest[SHA256HashSize])
+{
+    (void)context;
+    (void)memcpy(Message_Digest, g_digest, SHA256HashSize);
+    return shaSuccess;
+}
+
+static void hash_text(const char* text, unsigned char* hash)
+{
+    ASSERT_ARE_EQUAL(int, 0, blob_upload_journal_hash_block((const unsigned char*)text, strlen(text), hash));
+}
+
+/*the file blob_upload_journal_open uses for the blob of sas_uri*/
+static void get_journal_file_path(const char* sas_uri, char* path, size_t size)
+{
+    unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+    size_t i;
+    int length;
+
+    ASSERT_ARE_EQUAL(int, 0, blob_upload_journal_hash_block((const unsigned char*)sas_uri, strcspn(sas_uri, "?"), hash));
+    length = snprintf(path, size, "%s.", TEST_JOURNAL_PATH);
+    for (i = 0; i < 8; i++)
+    {
+        length += snprintf(path + length, size - (size_t)length, "%02x", hash[i]);
+    }
+}
+
+static void remove_journal_file(const char* sas_uri)
+{
+    char path[256];
+    get_journal_file_path(sas_uri, path, sizeof(path));
+    (void)remove(path);
+}
+
+static void write_journal_file(const char* sas_uri, const char* content)
+{
+    char path[256];
+    get_journal_file_path(sas_uri, path, sizeof(path));
+    FILE* file = fopen(path, "w");
+    ASSERT_IS_NOT_NULL(file);
+    ASSERT_IS_TRUE(fputs(content, file) >= 0);
+    (void)fclose(file);
+}
+
+static bool read_journal_file(const char* sas_uri, char* content, size_t size)
+{
+    bool result;
+    char path[256];
+    get_journal_file_path(sas_uri, path, sizeof(path));
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        result = false;
+    }
+    else
+    {
+        size_t length = fread(content, 1, size - 1, file);
+        content[length] = '\0';
+        (void)fclose(file);
+        result = true;
+    }
+    return result;
+}
+
+/*records block_id (hashed from text) in a journal for sas_uri and closes it*/
+static void journal_block(const char* sas_uri, unsigned int block_id, const char* text)
+{
+    unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, sas_uri);
+    ASSERT_IS_NOT_NULL(journal);
+    hash_text(text, hash);
+    ASSERT_ARE_EQUAL(int, 0, blob_upload_journal_add_block(journal, block_id, strlen(text), hash));
+    blob_upload_journal_close(journal, false);
+}
+
+static bool journal_has_block(BLOB_UPLOAD_JOURNAL_HANDLE journal, unsigned int block_id, const char* text)
+{
+    unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+    hash_text(text, hash);
+    return blob_upload_journal_has_block(journal, block_id, hash);
+}
+
+BEGIN_TEST_SUITE(blob_upload_journal_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    remove_journal_file(TEST_SAS_URI);
+    remove_journal_file(TEST_OTHER_SAS_URI);
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    remove_journal_file(TEST_SAS_URI);
+    remove_journal_file(TEST_OTHER_SAS_URI);
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(blob_upload_journal_open_with_NULL_journal_path_fails)
+{
+    //act
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(NULL, TEST_SAS_URI);
+
+    //assert
+    ASSERT_IS_NULL(journal);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(blob_upload_journal_open_with_NULL_sas_uri_fails)
+{
+    //act
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, NULL);
+
+    //assert
+    ASSERT_IS_NULL(journal);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(blob_upload_journal_open_fails_when_Lock_Init_fails)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_JOURNAL_PATH) + 1 + 16)); /*the journal file path*/
+    STRICT_EXPECTED_CALL(Lock_Init()).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_SAS_URI);
+
+    //assert
+    ASSERT_IS_NULL(journal);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(blob_upload_journal_open_writes_the_blob_url_without_the_sas_token)
+{
+    //arrange
+    char content[256];
+
+    //act
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_SAS_URI);
+
+    //assert
+    ASSERT_IS_NOT_NULL(journal);
+    ASSERT_IS_TRUE(read_journal_file(TEST_SAS_URI, content, sizeof(content)));
+    ASSERT_ARE_EQUAL(char_ptr, "blob " TEST_BLOB_URL "\n", content);
+
+    //cleanup
+    blob_upload_journal_close(journal, false);
+}
+
+TEST_FUNCTION(blob_upload_journal_reopened_with_a_renewed_sas_keeps_the_blocks)
+{
+    //arrange
+    journal_block(TEST_SAS_URI, 3, "block three");
+
+    //act
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_RENEWED_SAS_URI);
+
+    //assert
+    ASSERT_IS_NOT_NULL(journal);
+    ASSERT_IS_TRUE(journal_has_block(journal, 3, "block three"));
+    ASSERT_IS_FALSE(journal_has_block(journal, 3, "block changed"));
+    ASSERT_IS_FALSE(journal_has_block(journal, 2, "block three"));
+    ASSERT_IS_FALSE(journal_has_block(journal, 4000, "block three"));
+
+    //cleanup
+    blob_upload_journal_close(journal, false);
+}
+
+TEST_FUNCTION(blob_upload_journal_get_block_size_returns_the_size_the_block_was_uploaded_with)
+{
+    //arrange
+    size_t size = 0;
+    journal_block(TEST_SAS_URI, 7, "block seven");
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_RENEWED_SAS_URI);
+    ASSERT_IS_NOT_NULL(journal);
+
+    //act
+    bool found = blob_upload_journal_get_block_size(journal, 7, &size);
+    bool missing = blob_upload_journal_get_block_size(journal, 6, &size);
+
+    //assert
+    ASSERT_IS_TRUE(found);
+    ASSERT_IS_FALSE(missing);
+    ASSERT_ARE_EQUAL(size_t, strlen("block seven"), size);
+
+    //cleanup
+    blob_upload_journal_close(journal, false);
+}
+
+TEST_FUNCTION(blob_upload_journal_reopened_for_another_blob_drops_the_blocks)
+{
+    //arrange
+    char content[256];
+    journal_block(TEST_SAS_URI, 0, "block zero");
+
+    //act
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_OTHER_SAS_URI);
+
+    //assert
+    ASSERT_IS_NOT_NULL(journal);
+    ASSERT_IS_FALSE(journal_has_block(journal, 0, "block zero"));
+    ASSERT_IS_TRUE(read_journal_file(TEST_OTHER_SAS_URI, content, sizeof(content)));
+    ASSERT_ARE_EQUAL(char_ptr, "blob https://h.h/container/other\n", content);
+
+    //cleanup
+    blob_upload_journal_close(journal, false);
+}
+
+TEST_FUNCTION(blob_upload_journals_of_different_blobs_open_at_the_same_time_keep_their_blocks)
+{
+    //arrange
+    unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_SAS_URI);
+    BLOB_UPLOAD_JOURNAL_HANDLE other_journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_OTHER_SAS_URI);
+    ASSERT_IS_NOT_NULL(journal);
+    ASSERT_IS_NOT_NULL(other_journal);
+
+    //act
+    hash_text("block zero", hash);
+    ASSERT_ARE_EQUAL(int, 0, blob_upload_journal_add_block(journal, 0, strlen("block zero"), hash));
+    hash_text("other block zero", hash);
+    ASSERT_ARE_EQUAL(int, 0, blob_upload_journal_add_block(other_journal, 0, strlen("other block zero"), hash));
+    blob_upload_journal_close(journal, false);
+    blob_upload_journal_close(other_journal, false);
+
+    //assert
+    journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_RENEWED_SAS_URI);
+    other_journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_OTHER_SAS_URI);
+    ASSERT_IS_NOT_NULL(journal);
+    ASSERT_IS_NOT_NULL(other_journal);
+    ASSERT_IS_TRUE(journal_has_block(journal, 0, "block zero"));
+    ASSERT_IS_TRUE(journal_has_block(other_journal, 0, "other block zero"));
+
+    //cleanup
+    blob_upload_journal_close(journal, false);
+    blob_upload_journal_close(other_journal, false);
+}
+
+TEST_FUNCTION(blob_upload_journal_open_drops_a_line_cut_short)
+{
+    //arrange
+    char content[256];
+    char path[256];
+    journal_block(TEST_SAS_URI, 1, "block one");
+    get_journal_file_path(TEST_SAS_URI, path, sizeof(path));
+    FILE* file = fopen(path, "a");
+    ASSERT_IS_NOT_NULL(file);
+    (void)fputs("2 0123", file);
+    (void)fclose(file);
+
+    //act
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_SAS_URI);
+
+    //assert
+    ASSERT_IS_NOT_NULL(journal);
+    ASSERT_IS_TRUE(journal_has_block(journal, 1, "block one"));
+    ASSERT_IS_TRUE(read_journal_file(TEST_SAS_URI, content, sizeof(content)));
+    ASSERT_IS_NULL(strstr(content, "\n2 "));
+
+    //cleanup
+    blob_upload_journal_close(journal, false);
+}
+
+TEST_FUNCTION(blob_upload_journal_open_ignores_a_journal_that_is_not_one)
+{
+    //arrange
+    write_journal_file(TEST_SAS_URI, "something else\n1 2\n");
+
+    //act
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_SAS_URI);
+
+    //assert
+    ASSERT_IS_NOT_NULL(journal);
+    ASSERT_IS_FALSE(journal_has_block(journal, 1, "block one"));
+
+    //cleanup
+    blob_upload_journal_close(journal, false);
+}
+
+TEST_FUNCTION(blob_upload_journal_add_block_grows_past_the_initial_capacity)
+{
+    //arrange
+    unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_SAS_URI);
+    ASSERT_IS_NOT_NULL(journal);
+    hash_text("block 49999", hash);
+
+    //act
+    int result = blob_upload_journal_add_block(journal, 49999, 11, hash);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(blob_upload_journal_has_block(journal, 49999, hash));
+    ASSERT_IS_FALSE(journal_has_block(journal, 0, "block 49999"));
+
+    //cleanup
+    blob_upload_journal_close(journal, false);
+}
+
+TEST_FUNCTION(blob_upload_journal_add_block_fails_when_realloc_fails)
+{
+    //arrange
+    unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_SAS_URI);
+    ASSERT_IS_NOT_NULL(journal);
+    hash_text("block zero", hash);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    //act
+    int result = blob_upload_journal_add_block(journal, 0, 10, hash);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(blob_upload_journal_has_block(journal, 0, hash));
+
+    //cleanup
+    blob_upload_journal_close(journal, false);
+}
+
+TEST_FUNCTION(blob_upload_journal_add_block_with_NULL_journal_fails)
+{
+    //arrange
+    unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE] = { 0 };
+
+    //act
+    int result = blob_upload_journal_add_block(NULL, 0, 1, hash);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(blob_upload_journal_hash_block_with_NULL_content_fails)
+{
+    //arrange
+    unsigned char hash[BLOB_UPLOAD_JOURNAL_HASH_SIZE];
+
+    //act
+    int result = blob_upload_journal_hash_block(NULL, 1, hash);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(blob_upload_journal_close_with_discard_deletes_the_journal)
+{
+    //arrange
+    char content[256];
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_SAS_URI);
+    ASSERT_IS_NOT_NULL(journal);
+
+    //act
+    blob_upload_journal_close(journal, true);
+
+    //assert
+    ASSERT_IS_FALSE(read_journal_file(TEST_SAS_URI, content, sizeof(content)));
+}
+
+TEST_FUNCTION(blob_upload_journal_close_without_discard_keeps_the_journal)
+{
+    //arrange
+    char content[256];
+    BLOB_UPLOAD_JOURNAL_HANDLE journal = blob_upload_journal_open(TEST_JOURNAL_PATH, TEST_SAS_URI);
+    ASSERT_IS_NOT_NULL(journal);
+
+    //act
+    blob_upload_journal_close(journal, false);
+
+    //assert
+    ASSERT_IS_TRUE(read_journal_file(TEST_SAS_URI, content, sizeof(content)));
+}
+
+END_TEST_SUITE(blob_upload_journal_ut)
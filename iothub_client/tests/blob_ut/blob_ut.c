@@ -4,10 +4,14 @@
 #ifdef __cplusplus
 #include <cstdlib>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #else
 #include <stdlib.h>
+#include <stdio.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #endif
 
@@ -30,6 +34,12 @@ static void my_gballoc_free(void* s)
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/shared_util_options.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "internal/blob_upload_journal.h"
+#include "internal/blob_block_sizer.h"
 #undef ENABLE_MOCKS
 
 #include "internal/blob.h"
@@ -109,6 +119,70 @@ static STRING_HANDLE my_Azure_Base64_Encode_Bytes(const unsigned char* source, s
     return (STRING_HANDLE)my_gballoc_malloc(1);
 }
 
+static BUFFER_HANDLE my_BUFFER_new(void)
+{
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
+#define TEST_LOCK_HANDLE            (LOCK_HANDLE)0x4461
+#define TEST_COND_HANDLE            (COND_HANDLE)0x4462
+#define TEST_MAX_THREADS            4
+#define TEST_JOURNAL_HANDLE         (BLOB_UPLOAD_JOURNAL_HANDLE)0x4463
+
+/*the workers of a parallel upload are run when they are joined, at which point every block has been queued*/
+static THREAD_START_FUNC g_thread_funcs[TEST_MAX_THREADS];
+static void* g_thread_args[TEST_MAX_THREADS];
+static size_t g_thread_count;
+static bool g_fail_thread_create;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    THREADAPI_RESULT result;
+    if (g_fail_thread_create || g_thread_count == TEST_MAX_THREADS)
+    {
+        result = THREADAPI_ERROR;
+    }
+    else
+    {
+        g_thread_funcs[g_thread_count] = func;
+        g_thread_args[g_thread_count] = arg;
+        g_thread_count++;
+        *threadHandle = (THREAD_HANDLE)(uintptr_t)g_thread_count;
+        result = THREADAPI_OK;
+    }
+    return result;
+}
+
+/*the Lock call, counted from 1, that fails; 0 lets every Lock succeed*/
+static size_t g_fail_lock_call;
+static size_t g_lock_calls;
+
+static LOCK_RESULT my_Lock(LOCK_HANDLE handle)
+{
+    (void)handle;
+    g_lock_calls++;
+    return (g_lock_calls == g_fail_lock_call) ? LOCK_ERROR : LOCK_OK;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
+{
+    size_t index = (size_t)(uintptr_t)threadHandle - 1;
+    *res = g_thread_funcs[index](g_thread_args[index]);
+    return THREADAPI_OK;
+}
+
+static size_t count_actual_calls(const char* functionName)
+{
+    size_t result = 0;
+    const char* calls = umock_c_get_actual_calls();
+    while ((calls = strstr(calls, functionName)) != NULL)
+    {
+        result++;
+        calls += strlen(functionName);
+    }
+    return result;
+}
+
 TEST_DEFINE_ENUM_TYPE(BLOB_RESULT, BLOB_RESULT_VALUES);
 
 #define TEST_HTTPCOLONBACKSLASHBACKSLACH "http://"
@@ -254,6 +328,15 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_create, my_BUFFER_create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_create, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_new, my_BUFFER_new);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock, my_Lock);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
 
     REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Alloc, my_HTTPHeaders_Alloc);
     REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Free, my_HTTPHeaders_Free);
@@ -275,9 +358,20 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
 
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(BLOB_UPLOAD_JOURNAL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(BLOB_BLOCK_SIZER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t, unsigned long long);
 
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
 
     REGISTER_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE);
     REGISTER_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT);
@@ -299,6 +393,11 @@ TEST_SUITE_CLEANUP(TestClassCleanup)
 static void reset_test_data()
 {
     memset(&context, 0, sizeof(context));
+    g_thread_count = 0;
+    g_fail_thread_create = false;
+    g_fail_lock_call = 0;
+    g_lock_calls = 0;
+    REGISTER_GLOBAL_MOCK_RETURN(blob_upload_journal_has_block, false);
 }
 
 static void set_expected_calls_for_Blob_UploadMultipleBlocksFromSasUri_cleanup()
@@ -328,7 +427,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_NULL_SasUri_fails)
     ///arrange
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(NULL, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(NULL, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -343,7 +442,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_NULL_getDataCallBack_and_
     ///arrange
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, NULL, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, NULL, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -352,6 +451,58 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_NULL_getDataCallBack_and_
 
 }
 
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromFile_with_NULL_SasUri_fails)
+{
+    ///arrange
+    FILE* file = tmpfile();
+    ASSERT_IS_NOT_NULL(file);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromFile(NULL, file, false, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    (void)fclose(file);
+}
+
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromFile_with_NULL_file_fails)
+{
+    ///arrange
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromFile(TEST_VALID_SASURI_1, NULL, false, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+}
+
+#ifndef USE_BLOB_COMPRESSION
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromFile_with_compress_fails_when_built_without_compression)
+{
+    ///arrange
+    FILE* file = tmpfile();
+    ASSERT_IS_NOT_NULL(file);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromFile(TEST_VALID_SASURI_1, file, true, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_NOT_IMPLEMENTED, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    (void)fclose(file);
+}
+#endif
+
 /*Tests_SRS_BLOB_02_032: [ Otherwise, `Blob_UploadMultipleBlocksFromSasUri` shall succeed and return `BLOB_OK`. ]*/
 TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_succeeds_when_HTTP_status_code_is_404)
 {
@@ -415,7 +566,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_succeeds_when_HTTP_status_code
     set_expected_calls_for_Blob_UploadMultipleBlocksFromSasUri_cleanup();
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
@@ -488,7 +639,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_HTTPAPIEX_ExecuteRe
     set_expected_calls_for_Blob_UploadMultipleBlocksFromSasUri_cleanup();
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_HTTP_ERROR, result);
@@ -521,7 +672,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_BUFFER_create_fails
     }
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -549,7 +700,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_HTTPAPIEX_Create_fa
     set_expected_calls_for_Blob_UploadMultipleBlocksFromSasUri_cleanup();
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ERROR, result);
@@ -574,7 +725,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_fails_when_malloc_fails)
     set_expected_calls_for_Blob_UploadMultipleBlocksFromSasUri_cleanup();
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ERROR, result);
@@ -595,7 +746,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_SasUri_is_wrong_fails_1)
     set_expected_calls_for_Blob_UploadMultipleBlocksFromSasUri_cleanup();
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https:/h.h/doms", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL); /*wrong format for protocol, notice it is actually http:\h.h\doms (missing a \ from http)*/
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https:/h.h/doms", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL); /*wrong format for protocol, notice it is actually http:\h.h\doms (missing a \ from http)*/
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -616,7 +767,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_SasUri_is_wrong_fails_2)
     set_expected_calls_for_Blob_UploadMultipleBlocksFromSasUri_cleanup();
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL); /*there's no relative path here*/
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL); /*there's no relative path here*/
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -758,7 +909,7 @@ static void Blob_UploadMultipleBlocksFromSasUri_various_sizes_happy_path_Impl(HT
         set_expected_calls_for_Blob_UploadMultipleBlocksFromSasUri_cleanup();
 
         ///act
-        BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, proxyOptions, networkInterface);
+        BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, proxyOptions, networkInterface, 1, NULL);
 
         ///assert
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -941,7 +1092,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_various_sizes_with_certificate
         set_expected_calls_for_Blob_UploadMultipleBlocksFromSasUri_cleanup();
 
         ///act
-        BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, "a", NULL, NULL);
+        BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, "a", NULL, NULL, 1, NULL);
 
         ///assert
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -1079,7 +1230,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_unhappy_paths)
 
             ///act
             context.toUpload = context.size; /* Reinit context */
-            BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+            BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
             ///assert
             ASSERT_ARE_NOT_EQUAL(BLOB_RESULT, BLOB_OK, result, temp_str);
@@ -1225,7 +1376,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_64MB_with_certificate_and_netw
 
             ///act
             context.toUpload = context.size; /* Reinit context */
-            BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, "a", NULL, interfaceName);
+            BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, "a", NULL, interfaceName, 1, NULL);
 
             ///assert
             ASSERT_ARE_NOT_EQUAL(BLOB_RESULT, BLOB_OK, result, temp_str);
@@ -1312,7 +1463,7 @@ TEST_FUNCTION(Blob_UploadFromSasUri_when_http_code_is_404_it_immediately_succeed
     set_expected_calls_for_Blob_UploadMultipleBlocksFromSasUri_cleanup();
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -1335,7 +1486,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_blockSize_too_big_fails)
     fakeContext.abortOnBlockNumber = -1;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -1356,7 +1507,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_blockSize_is_4MB_succeeds
     fakeContext.abortOnBlockNumber = -1;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
@@ -1377,7 +1528,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_blockCount_is_maximum_suc
     fakeContext.abortOnBlockNumber = -1;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
@@ -1398,7 +1549,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_when_blockCount_is_one_over_ma
     fakeContext.abortOnBlockNumber = -1;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
@@ -1419,7 +1570,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_returns_BLOB_ABORTED_when_call
     fakeContext.abortOnBlockNumber = 0;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ABORTED, result);
@@ -1440,7 +1591,7 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_returns_BLOB_ABORTED_when_call
     fakeContext.abortOnBlockNumber = 5;
 
     ///act
-    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL);
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetFakeData_Callback, &fakeContext, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, NULL);
 
     ///assert
     ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ABORTED, result);
@@ -1449,4 +1600,192 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_returns_BLOB_ABORTED_when_call
     gballoc_free(fakeContext.fakeData);
 }
 
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_concurrency_over_maximum_fails)
+{
+    ///arrange
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri(TEST_VALID_SASURI_1, FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, BLOB_MAX_UPLOAD_CONCURRENCY + 1, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+}
+
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_concurrency_uploads_blocks_over_one_connection_per_worker)
+{
+    ///arrange
+    size_t size = 2 * BLOCK_SIZE;
+    unsigned char* content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    context.size = size;
+    context.source = content;
+    context.toUpload = context.size;
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 2, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, g_thread_count);
+    ASSERT_ARE_EQUAL(size_t, 0, context.toUpload);
+    ASSERT_ARE_EQUAL(size_t, 3, count_actual_calls("HTTPAPIEX_Create(")); /*one per worker and the one committing the block list*/
+    ASSERT_ARE_EQUAL(size_t, 3, count_actual_calls("HTTPAPIEX_Destroy("));
+    ASSERT_ARE_EQUAL(size_t, 3, count_actual_calls("HTTPAPIEX_ExecuteRequest(")); /*two Put Block and one Put Block List*/
+    ASSERT_ARE_EQUAL(size_t, 2, count_actual_calls("<Latest>"));
+
+    ///cleanup
+    gballoc_free(content);
+}
+
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_concurrency_fails_when_ThreadAPI_Create_fails)
+{
+    ///arrange
+    size_t size = BLOCK_SIZE;
+    unsigned char* content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    context.size = size;
+    context.source = content;
+    context.toUpload = context.size;
+    g_fail_thread_create = true;
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 2, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, size, context.toUpload); /*no block was asked for*/
+    ASSERT_ARE_EQUAL(size_t, 0, count_actual_calls("HTTPAPIEX_ExecuteRequest("));
+    ASSERT_ARE_EQUAL(size_t, count_actual_calls("HTTPAPIEX_Create("), count_actual_calls("HTTPAPIEX_Destroy("));
+
+    ///cleanup
+    gballoc_free(content);
+}
+
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_concurrency_fails_when_a_block_cannot_be_queued)
+{
+    ///arrange
+    size_t size = BLOCK_SIZE;
+    unsigned char* content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    context.size = size;
+    context.source = content;
+    context.toUpload = context.size;
+    g_fail_lock_call = 1; /*the lock taken to queue the first block*/
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 2, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, count_actual_calls("HTTPAPIEX_ExecuteRequest(")); /*the block list naming the block is not committed*/
+    ASSERT_ARE_EQUAL(size_t, count_actual_calls("HTTPAPIEX_Create("), count_actual_calls("HTTPAPIEX_Destroy("));
+
+    ///cleanup
+    gballoc_free(content);
+}
+
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_concurrency_fails_when_a_worker_cannot_take_the_lock_back)
+{
+    ///arrange
+    size_t size = BLOCK_SIZE;
+    unsigned char* content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    context.size = size;
+    context.source = content;
+    context.toUpload = context.size;
+    g_fail_lock_call = 4; /*queuing the block, stopping the workers, the first worker starting, then re-locking after the block*/
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 2, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 1, count_actual_calls("HTTPAPIEX_ExecuteRequest(")); /*the Put Block, the block list is not committed*/
+    ASSERT_ARE_EQUAL(size_t, count_actual_calls("HTTPAPIEX_Create("), count_actual_calls("HTTPAPIEX_Destroy("));
+    ASSERT_ARE_EQUAL(size_t, count_actual_calls("Lock("), count_actual_calls("Unlock(") + 1); /*the lock the worker never got back is not released*/
+
+    ///cleanup
+    gballoc_free(content);
+}
+
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_journal_records_uploaded_blocks)
+{
+    ///arrange
+    size_t size = 2 * BLOCK_SIZE;
+    unsigned char* content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    context.size = size;
+    context.source = content;
+    context.toUpload = context.size;
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, TEST_JOURNAL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, count_actual_calls("blob_upload_journal_has_block("));
+    ASSERT_ARE_EQUAL(size_t, 2, count_actual_calls("blob_upload_journal_add_block("));
+    ASSERT_ARE_EQUAL(size_t, 3, count_actual_calls("HTTPAPIEX_ExecuteRequest(")); /*two Put Block and one Put Block List*/
+
+    ///cleanup
+    gballoc_free(content);
+}
+
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_journal_skips_blocks_already_uploaded)
+{
+    ///arrange
+    size_t size = 2 * BLOCK_SIZE;
+    unsigned char* content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    context.size = size;
+    context.source = content;
+    context.toUpload = context.size;
+    REGISTER_GLOBAL_MOCK_RETURN(blob_upload_journal_has_block, true);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 1, TEST_JOURNAL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 0, context.toUpload); /*every block was still read, to be hashed*/
+    ASSERT_ARE_EQUAL(size_t, 0, count_actual_calls("blob_upload_journal_add_block("));
+    ASSERT_ARE_EQUAL(size_t, 1, count_actual_calls("HTTPAPIEX_ExecuteRequest(")); /*only Put Block List*/
+    ASSERT_ARE_EQUAL(size_t, 2, count_actual_calls("<Latest>"));
+
+    ///cleanup
+    gballoc_free(content);
+}
+
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_with_concurrency_and_journal_skips_blocks_already_uploaded)
+{
+    ///arrange
+    size_t size = 2 * BLOCK_SIZE;
+    unsigned char* content = (unsigned char*)gballoc_malloc(size);
+    ASSERT_IS_NOT_NULL(content);
+    context.size = size;
+    context.source = content;
+    context.toUpload = context.size;
+    REGISTER_GLOBAL_MOCK_RETURN(blob_upload_journal_has_block, true);
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, NULL, 2, TEST_JOURNAL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 0, count_actual_calls("blob_upload_journal_add_block("));
+    ASSERT_ARE_EQUAL(size_t, 1, count_actual_calls("HTTPAPIEX_ExecuteRequest(")); /*only Put Block List*/
+    ASSERT_ARE_EQUAL(size_t, 2, count_actual_calls("<Latest>"));
+
+    ///cleanup
+    gballoc_free(content);
+}
+
 END_TEST_SUITE(blob_ut);
@@ -33,8 +33,7 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/sastoken.h"
 #include "azure_c_shared_utility/xio.h"
-#include "azure_c_shared_utility/buffer_.h"
-#include "azure_c_shared_utility/azure_base64.h"
+#include "internal/iothub_client_sas_signer.h"
 
 #ifdef USE_PROV_MODULE
 #include "azure_prov_client/internal/iothub_auth_client.h"
@@ -55,6 +54,7 @@ static const char* TEST_KEYNAME_VALUE = "Test_keyname_value";
 static const char* TEST_REG_CERT = "Test_certificate";
 static const char* TEST_REG_PK = "Test_private_key";
 static uint64_t TEST_EXPIRY_TIME = 1;
+static SAS_SIGNER_HANDLE TEST_SAS_SIGNER_HANDLE = (SAS_SIGNER_HANDLE)0x4242;
 
 #define TEST_TIME_VALUE                     (time_t)123456
 
@@ -75,13 +75,15 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
     return 0;
 }
 
-static STRING_HANDLE my_SASToken_CreateString(const char* key, const char* scope, const char* keyName, uint64_t expiry)
+static char* my_sas_signer_get_token(SAS_SIGNER_HANDLE signer, const char* scope, const char* key_name, uint64_t expiry)
 {
-    (void)key;
+    (void)signer;
     (void)scope;
-    (void)keyName;
+    (void)key_name;
     (void)expiry;
-    return (STRING_HANDLE)my_gballoc_malloc(1);
+    char* result = (char*)my_gballoc_malloc(strlen(TEST_STRING_VALUE) + 1);
+    strcpy(result, TEST_STRING_VALUE);
+    return result;
 }
 
 
@@ -147,7 +149,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_AUTHORIZATION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(time_t, long long);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(SAS_SIGNER_HANDLE, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -156,14 +158,13 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
 
-    REGISTER_GLOBAL_MOCK_HOOK(SASToken_CreateString, my_SASToken_CreateString);
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(SASToken_CreateString, NULL);
+    REGISTER_GLOBAL_MOCK_RETURNS(sas_signer_create, TEST_SAS_SIGNER_HANDLE, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(sas_signer_get_token, my_sas_signer_get_token);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(sas_signer_get_token, NULL);
 
     REGISTER_GLOBAL_MOCK_RETURN(get_time, TEST_TIME_VALUE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, ((time_t)(-1)));
 
-    REGISTER_GLOBAL_MOCK_RETURNS(Azure_Base64_Decode, (BUFFER_HANDLE)0x1, NULL);
-
     REGISTER_GLOBAL_MOCK_RETURN(STRING_c_str, TEST_STRING_VALUE);
     REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
     REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, my_STRING_construct);
@@ -222,8 +223,7 @@ static void setup_IoTHubClient_Auth_Create_mocks(bool device_key, bool module_id
 {
     if (device_key)
     {
-        STRICT_EXPECTED_CALL(Azure_Base64_Decode(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(sas_signer_create(DEVICE_KEY));
     }
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
@@ -242,10 +242,7 @@ static void setup_IoTHubClient_Auth_Get_ConnString_mocks()
 {
     STRICT_EXPECTED_CALL(get_time(NULL));
     STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).CallCannotFail();
-    STRICT_EXPECTED_CALL(SASToken_CreateString(IGNORED_PTR_ARG, SCOPE_NAME, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(sas_signer_get_token(TEST_SAS_SIGNER_HANDLE, SCOPE_NAME, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
 }
 
 /* Tests_SRS_IoTHub_Authorization_07_001: [if device_key or device_id is NULL IoTHubClient_Auth_Create, shall return NULL. ] */
@@ -253,8 +250,8 @@ TEST_FUNCTION(IoTHubClient_Auth_Create_id_NULL_succeed)
 {
     //arrange
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(Azure_Base64_Decode(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(sas_signer_create(DEVICE_KEY));
+    STRICT_EXPECTED_CALL(sas_signer_destroy(TEST_SAS_SIGNER_HANDLE));
 
     //act
     IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, NULL, NULL, NULL);
@@ -392,11 +389,6 @@ TEST_FUNCTION(IoTHubClient_Auth_Create_fail)
     size_t count = umock_c_negative_tests_call_count();
     for (size_t index = 0; index < count; index++)
     {
-        if (index == 1)
-        {
-            continue;
-        }
-
         umock_c_negative_tests_reset();
         umock_c_negative_tests_fail_call(index);
 
@@ -503,6 +495,7 @@ TEST_FUNCTION(IoTHubClient_Auth_Destroy_succeed)
 #ifdef USE_PROV_MODULE
     STRICT_EXPECTED_CALL(iothub_device_auth_destroy(IGNORED_PTR_ARG));
 #endif
+    STRICT_EXPECTED_CALL(sas_signer_destroy(TEST_SAS_SIGNER_HANDLE));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -786,7 +779,7 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_scope_NULL_fail)
 
 #ifdef USE_PROV_MODULE
 /* Tests_SRS_IoTHub_Authorization_07_010: [ IoTHubClient_Auth_Get_ConnString shall construct the expiration time using the expire_time. ] */
-/* Tests_SRS_IoTHub_Authorization_07_011: [ IoTHubClient_Auth_Get_ConnString shall call SASToken_CreateString to construct the sas token. ] */
+/* Tests_SRS_IoTHub_Authorization_07_011: [ IoTHubClient_Auth_Get_ConnString shall call sas_signer_get_token to construct the sas token. ] */
 /* Tests_SRS_IoTHub_Authorization_07_012: [ On success IoTHubClient_Auth_Get_ConnString shall allocate and return the sas token in a char*. ] */
 TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_device_auth_succeed)
 {
@@ -834,6 +827,31 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_succeed)
     IoTHubClient_Auth_Destroy(handle);
 }
 
+/* Tests_SRS_IoTHub_Authorization_07_027: [ IoTHubClient_Auth_Get_SasToken shall round the expiration time down to a multiple of a twentieth of handle->token_expiry_time_sec, so tokens asked for within that time are the same token and their lifetime is up to 5% shorter than handle->token_expiry_time_sec. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_rounds_expiry_down_succeed)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL, NULL);
+    (void)IoTHubClient_Auth_Set_SasToken_Expiry(handle, 3600);
+    umock_c_reset_all_calls();
+
+    // 3600 seconds of lifetime round the expiry down to 180 seconds: 1000 + 3600 = 4600 becomes 4500.
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(1000);
+    STRICT_EXPECTED_CALL(sas_signer_get_token(TEST_SAS_SIGNER_HANDLE, SCOPE_NAME, IGNORED_PTR_ARG, 4500));
+
+    //act
+    char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(conn_string);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(conn_string);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
 TEST_FUNCTION(IoTHubClient_Auth_Get_ModuleId_succeed)
 {
     //arrange
@@ -0,0 +1,289 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umock_c_negative_tests.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_callback_ring.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_LOCK_HANDLE    (LOCK_HANDLE)0x4451
+#define TEST_RECORD_SIZE    sizeof(int)
+
+static CALLBACK_RING_HANDLE create_ring(size_t capacity)
+{
+    CALLBACK_RING_HANDLE result = callback_ring_create(TEST_RECORD_SIZE, capacity);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(iothub_client_callback_ring_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(callback_ring_create_zero_capacity_fails)
+{
+    // act
+    CALLBACK_RING_HANDLE result = callback_ring_create(TEST_RECORD_SIZE, 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(callback_ring_create_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(4 * TEST_RECORD_SIZE));
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    // act
+    CALLBACK_RING_HANDLE result = callback_ring_create(TEST_RECORD_SIZE, 4);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, (int)callback_ring_get_count(result));
+
+    // cleanup
+    callback_ring_destroy(result);
+}
+
+TEST_FUNCTION(callback_ring_create_negative_tests)
+{
+    // arrange
+    size_t i;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(4 * TEST_RECORD_SIZE));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        CALLBACK_RING_HANDLE result = callback_ring_create(TEST_RECORD_SIZE, 4);
+
+        // assert
+        ASSERT_IS_NULL(result, "failure in test %lu", (unsigned long)i);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+TEST_FUNCTION(callback_ring_push_and_pop_do_not_allocate)
+{
+    // arrange
+    CALLBACK_RING_HANDLE ring = create_ring(2);
+    int record = 42;
+    int popped = 0;
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    int push_result = callback_ring_push(ring, &record);
+    int pop_result = callback_ring_pop(ring, &popped);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, push_result);
+    ASSERT_ARE_EQUAL(int, 0, pop_result);
+    ASSERT_ARE_EQUAL(int, 42, popped);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    callback_ring_destroy(ring);
+}
+
+TEST_FUNCTION(callback_ring_pops_in_fifo_order_across_the_wrap)
+{
+    // arrange
+    CALLBACK_RING_HANDLE ring = create_ring(3);
+    int record;
+    int popped;
+
+    for (record = 0; record < 3; record++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, callback_ring_push(ring, &record));
+    }
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_pop(ring, &popped));
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_pop(ring, &popped));
+    record = 3;
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_push(ring, &record));
+    record = 4;
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_push(ring, &record));
+
+    // act & assert
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_pop(ring, &popped));
+    ASSERT_ARE_EQUAL(int, 2, popped);
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_pop(ring, &popped));
+    ASSERT_ARE_EQUAL(int, 3, popped);
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_pop(ring, &popped));
+    ASSERT_ARE_EQUAL(int, 4, popped);
+    ASSERT_ARE_NOT_EQUAL(int, 0, callback_ring_pop(ring, &popped));
+
+    // cleanup
+    callback_ring_destroy(ring);
+}
+
+TEST_FUNCTION(callback_ring_push_when_full_fails)
+{
+    // arrange
+    CALLBACK_RING_HANDLE ring = create_ring(1);
+    int record = 1;
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_push(ring, &record));
+
+    // act
+    int result = callback_ring_push(ring, &record);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 1, (int)callback_ring_get_count(ring));
+
+    // cleanup
+    callback_ring_destroy(ring);
+}
+
+TEST_FUNCTION(callback_ring_push_when_lock_fails_fails)
+{
+    // arrange
+    CALLBACK_RING_HANDLE ring = create_ring(1);
+    int record = 1;
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE)).SetReturn(LOCK_ERROR);
+
+    // act
+    int result = callback_ring_push(ring, &record);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    callback_ring_destroy(ring);
+}
+
+TEST_FUNCTION(callback_ring_get_high_water_keeps_the_peak_count)
+{
+    // arrange
+    CALLBACK_RING_HANDLE ring = create_ring(4);
+    int record = 1;
+    int popped;
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_push(ring, &record));
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_push(ring, &record));
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_push(ring, &record));
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_pop(ring, &popped));
+    ASSERT_ARE_EQUAL(int, 0, callback_ring_pop(ring, &popped));
+
+    // act
+    size_t result = callback_ring_get_high_water(ring);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 3, (int)result);
+    ASSERT_ARE_EQUAL(int, 1, (int)callback_ring_get_count(ring));
+
+    // cleanup
+    callback_ring_destroy(ring);
+}
+
+TEST_FUNCTION(callback_ring_destroy_with_NULL_does_nothing)
+{
+    // act
+    callback_ring_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_callback_ring_ut)
@@ -0,0 +1,526 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umock_c_negative_tests.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umocktypes_stdint.h"
+#include "umock_c/umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+MOCKABLE_FUNCTION(, void, test_dispatch_function, void*, context, void*, record);
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_dispatch_pool.h"
+
+#ifdef __cplusplus
+extern "C" const size_t DispatchPool_ThreadTerminationOffset;
+#else
+extern const size_t DispatchPool_ThreadTerminationOffset;
+#endif
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_LOCK_HANDLE            (LOCK_HANDLE)0x4461
+#define TEST_COND_HANDLE            (COND_HANDLE)0x4462
+#define TEST_TICK_COUNTER_HANDLE    (TICK_COUNTER_HANDLE)0x4463
+#define TEST_THREAD_HANDLE          (THREAD_HANDLE)0x4464
+#define TEST_CONTEXT                (void*)0x4465
+#define TEST_CATEGORY_COUNT         3
+#define TEST_QUEUE_CAPACITY         4
+#define TEST_MAX_DISPATCHED         8
+
+static tickcounter_ms_t g_now_ms;
+static THREAD_START_FUNC g_thread_func;
+static void* g_thread_func_arg;
+static int g_dispatched_records[TEST_MAX_DISPATCHED];
+static size_t g_dispatched_count;
+static bool g_run_worker_on_wait;
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_now_ms;
+    return 0;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = TEST_THREAD_HANDLE;
+    g_thread_func = func;
+    g_thread_func_arg = arg;
+    return THREADAPI_OK;
+}
+
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+    if (g_run_worker_on_wait)
+    {
+        /*the worker runs while a submitter waits for a free item*/
+        g_run_worker_on_wait = false;
+        (void)g_thread_func(g_thread_func_arg);
+    }
+    else
+    {
+        *(bool*)(((char*)g_thread_func_arg) + DispatchPool_ThreadTerminationOffset) = true; /*tell the worker to exit once the queue is empty*/
+    }
+    return COND_TIMEOUT;
+}
+
+/*every dispatch takes 10 ms*/
+static void my_test_dispatch_function(void* context, void* record)
+{
+    (void)context;
+    g_now_ms += 10;
+    if (g_dispatched_count < TEST_MAX_DISPATCHED)
+    {
+        g_dispatched_records[g_dispatched_count++] = *(int*)record;
+    }
+}
+
+static void reset_test_data()
+{
+    g_now_ms = 0;
+    g_thread_func = NULL;
+    g_thread_func_arg = NULL;
+    g_dispatched_count = 0;
+    g_run_worker_on_wait = false;
+}
+
+static void register_umock_alias_types()
+{
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t, uint64_t);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+}
+
+static void register_global_mock_hooks()
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+    REGISTER_GLOBAL_MOCK_HOOK(test_dispatch_function, my_test_dispatch_function);
+}
+
+static void register_global_mock_returns()
+{
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+}
+
+static void set_expected_calls_for_create(size_t thread_count)
+{
+    size_t i;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(thread_count * sizeof(THREAD_HANDLE)));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    for (i = 0; i < thread_count; i++)
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+}
+
+static DISPATCH_POOL_HANDLE create_pool_with_capacity(size_t queue_capacity)
+{
+    DISPATCH_POOL_HANDLE result = dispatch_pool_create(1, TEST_CATEGORY_COUNT, sizeof(int), queue_capacity, test_dispatch_function, TEST_CONTEXT);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static DISPATCH_POOL_HANDLE create_pool(void)
+{
+    return create_pool_with_capacity(TEST_QUEUE_CAPACITY);
+}
+
+static void submit(DISPATCH_POOL_HANDLE pool, size_t category, int record)
+{
+    ASSERT_ARE_EQUAL(int, 0, dispatch_pool_submit(pool, category, &record));
+}
+
+BEGIN_TEST_SUITE(iothub_client_dispatch_pool_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_umock_alias_types();
+    register_global_mock_returns();
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    reset_test_data();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    reset_test_data();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(dispatch_pool_create_zero_threads_fails)
+{
+    // act
+    DISPATCH_POOL_HANDLE result = dispatch_pool_create(0, TEST_CATEGORY_COUNT, sizeof(int), TEST_QUEUE_CAPACITY, test_dispatch_function, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(dispatch_pool_create_NULL_function_fails)
+{
+    // act
+    DISPATCH_POOL_HANDLE result = dispatch_pool_create(1, TEST_CATEGORY_COUNT, sizeof(int), NULL, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(dispatch_pool_create_zero_queue_capacity_fails)
+{
+    // act
+    DISPATCH_POOL_HANDLE result = dispatch_pool_create(1, TEST_CATEGORY_COUNT, sizeof(int), 0, test_dispatch_function, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(dispatch_pool_create_succeeds)
+{
+    // arrange
+    set_expected_calls_for_create(2);
+
+    // act
+    DISPATCH_POOL_HANDLE result = dispatch_pool_create(2, TEST_CATEGORY_COUNT, sizeof(int), TEST_QUEUE_CAPACITY, test_dispatch_function, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    dispatch_pool_destroy(result);
+}
+
+TEST_FUNCTION(dispatch_pool_create_negative_tests)
+{
+    // arrange
+    size_t i;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_expected_calls_for_create(1);
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        DISPATCH_POOL_HANDLE result = dispatch_pool_create(1, TEST_CATEGORY_COUNT, sizeof(int), TEST_QUEUE_CAPACITY, test_dispatch_function, TEST_CONTEXT);
+
+        // assert
+        ASSERT_IS_NULL(result, "On failed call %lu", (unsigned long)i);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+TEST_FUNCTION(dispatch_pool_submit_invalid_category_fails)
+{
+    // arrange
+    DISPATCH_POOL_HANDLE pool = create_pool();
+    int record = 1;
+
+    // act
+    int result = dispatch_pool_submit(pool, TEST_CATEGORY_COUNT, &record);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    dispatch_pool_destroy(pool);
+}
+
+TEST_FUNCTION(dispatch_pool_submit_queues_a_copy_and_wakes_a_worker)
+{
+    // arrange
+    DISPATCH_POOL_HANDLE pool = create_pool();
+    int record = 1;
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    int result = dispatch_pool_submit(pool, 0, &record);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    dispatch_pool_destroy(pool);
+}
+
+TEST_FUNCTION(dispatch_pool_submit_waits_for_a_free_item_when_the_queue_is_full)
+{
+    // arrange
+    DISPATCH_POOL_CATEGORY_STATISTICS statistics;
+    DISPATCH_POOL_HANDLE pool = create_pool_with_capacity(1);
+    submit(pool, 0, 1);
+    g_run_worker_on_wait = true;
+    umock_c_reset_all_calls();
+
+    // act
+    submit(pool, 1, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 1, (int)g_dispatched_count);
+    ASSERT_ARE_EQUAL(int, 1, g_dispatched_records[0]);
+    ASSERT_ARE_EQUAL(int, 0, dispatch_pool_get_statistics(pool, 1, &statistics));
+    ASSERT_ARE_EQUAL(int, 1, (int)statistics.queue_depth);
+
+    // cleanup
+    dispatch_pool_destroy(pool);
+}
+
+TEST_FUNCTION(dispatch_pool_reuses_the_items_of_dispatched_records)
+{
+    // arrange
+    DISPATCH_POOL_HANDLE pool = create_pool_with_capacity(2);
+    submit(pool, 0, 1);
+    submit(pool, 0, 2);
+    (void)g_thread_func(g_thread_func_arg);
+    umock_c_reset_all_calls();
+
+    // act
+    submit(pool, 0, 3);
+    submit(pool, 1, 4);
+
+    // assert
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "gballoc_malloc"));
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "Condition_Wait"));
+
+    // cleanup
+    dispatch_pool_destroy(pool);
+}
+
+TEST_FUNCTION(dispatch_pool_worker_keeps_the_order_within_a_category_and_alternates_categories)
+{
+    // arrange
+    DISPATCH_POOL_HANDLE pool = create_pool();
+    submit(pool, 0, 1);
+    submit(pool, 0, 2);
+    submit(pool, 1, 3);
+    umock_c_reset_all_calls();
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 3, (int)g_dispatched_count);
+    ASSERT_ARE_EQUAL(int, 1, g_dispatched_records[0]);
+    ASSERT_ARE_EQUAL(int, 3, g_dispatched_records[1]);
+    ASSERT_ARE_EQUAL(int, 2, g_dispatched_records[2]);
+
+    // cleanup
+    dispatch_pool_destroy(pool);
+}
+
+TEST_FUNCTION(dispatch_pool_get_statistics_reports_queue_depth_and_latency)
+{
+    // arrange
+    DISPATCH_POOL_CATEGORY_STATISTICS statistics;
+    DISPATCH_POOL_HANDLE pool = create_pool();
+    submit(pool, 0, 1);
+    submit(pool, 0, 2);
+    submit(pool, 1, 3);
+    (void)g_thread_func(g_thread_func_arg);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = dispatch_pool_get_statistics(pool, 0, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, (int)statistics.queue_depth);
+    ASSERT_ARE_EQUAL(int, 2, (int)statistics.max_queue_depth);
+    ASSERT_ARE_EQUAL(int, 2, (int)statistics.dispatched);
+    ASSERT_ARE_EQUAL(int, 40, (int)statistics.total_latency_ms); /*done at 10 ms and 30 ms*/
+    ASSERT_ARE_EQUAL(int, 30, (int)statistics.max_latency_ms);
+
+    // cleanup
+    dispatch_pool_destroy(pool);
+}
+
+TEST_FUNCTION(dispatch_pool_worker_told_to_exit_runs_the_queued_records_first)
+{
+    // arrange
+    DISPATCH_POOL_HANDLE pool = create_pool();
+    submit(pool, 0, 1);
+    submit(pool, 1, 2);
+    *(bool*)(((char*)g_thread_func_arg) + DispatchPool_ThreadTerminationOffset) = true;
+    umock_c_reset_all_calls();
+
+    // act
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 2, (int)g_dispatched_count);
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "Condition_Wait"));
+
+    // cleanup
+    dispatch_pool_destroy(pool);
+}
+
+TEST_FUNCTION(dispatch_pool_worker_exits_without_touching_the_pool_when_the_lock_cannot_be_taken_back)
+{
+    // arrange
+    DISPATCH_POOL_CATEGORY_STATISTICS statistics;
+    DISPATCH_POOL_HANDLE pool = create_pool();
+    submit(pool, 0, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(test_dispatch_function(TEST_CONTEXT, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE)).SetReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, dispatch_pool_get_statistics(pool, 0, &statistics));
+    ASSERT_ARE_EQUAL(int, 1, (int)statistics.queue_depth);
+    ASSERT_ARE_EQUAL(int, 0, (int)statistics.dispatched);
+
+    // cleanup
+    dispatch_pool_destroy(pool);
+}
+
+TEST_FUNCTION(dispatch_pool_destroy_stops_and_joins_the_workers)
+{
+    // arrange
+    DISPATCH_POOL_HANDLE pool = create_pool();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(pool));
+
+    // act
+    dispatch_pool_destroy(pool);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_dispatch_pool_ut)
@@ -0,0 +1,539 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umock_c_negative_tests.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umocktypes_stdint.h"
+#include "umock_c/umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+MOCKABLE_FUNCTION(, tickcounter_ms_t, test_work_function, void*, context);
+#undef ENABLE_MOCKS
+
+#include "iothub_client_executor.h"
+
+#ifdef __cplusplus
+extern "C" const size_t IoTHubClientExecutor_ThreadTerminationOffset;
+#else
+extern const size_t IoTHubClientExecutor_ThreadTerminationOffset;
+#endif
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_LOCK_HANDLE            (LOCK_HANDLE)0x4441
+#define TEST_COND_HANDLE            (COND_HANDLE)0x4442
+#define TEST_TICK_COUNTER_HANDLE    (TICK_COUNTER_HANDLE)0x4443
+#define TEST_THREAD_HANDLE          (THREAD_HANDLE)0x4444
+#define TEST_CONTEXT_1              (void*)0x4445
+#define TEST_CONTEXT_2              (void*)0x4446
+
+static tickcounter_ms_t g_now_ms;
+static THREAD_START_FUNC g_thread_func;
+static void* g_thread_func_arg;
+static IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE g_entry_to_wake;
+static tickcounter_ms_t g_wake_at_ms;
+static bool g_run_worker_on_join;
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_now_ms;
+    return 0;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = TEST_THREAD_HANDLE;
+    g_thread_func = func;
+    g_thread_func_arg = arg;
+    return THREADAPI_OK;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
+{
+    (void)threadHandle;
+    if (g_run_worker_on_join)
+    {
+        /*the worker gets the lock back after Destroy told it to stop*/
+        g_run_worker_on_join = false;
+        *res = g_thread_func(g_thread_func_arg);
+    }
+    return THREADAPI_OK;
+}
+
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+    if (g_entry_to_wake != NULL)
+    {
+        /*another thread wakes the entry while the worker waits*/
+        IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE entry = g_entry_to_wake;
+        g_entry_to_wake = NULL;
+        g_now_ms = g_wake_at_ms;
+        IoTHubClientExecutor_Wake((IOTHUB_CLIENT_EXECUTOR_HANDLE)g_thread_func_arg, entry);
+    }
+    else
+    {
+        *(bool*)(((char*)g_thread_func_arg) + IoTHubClientExecutor_ThreadTerminationOffset) = true; /*tell the worker to stop*/
+    }
+    return COND_TIMEOUT;
+}
+
+static void reset_test_data()
+{
+    g_now_ms = 0;
+    g_thread_func = NULL;
+    g_thread_func_arg = NULL;
+    g_entry_to_wake = NULL;
+    g_wake_at_ms = 0;
+    g_run_worker_on_join = false;
+}
+
+static void register_umock_alias_types()
+{
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t, uint64_t);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+}
+
+static void register_global_mock_hooks()
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
+}
+
+static void register_global_mock_returns()
+{
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+}
+
+static void set_expected_calls_for_create(size_t worker_count)
+{
+    size_t i;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(worker_count * sizeof(THREAD_HANDLE)));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    for (i = 0; i < worker_count; i++)
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+}
+
+static void set_expected_calls_for_stop(void)
+{
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+}
+
+static IOTHUB_CLIENT_EXECUTOR_HANDLE create_executor(void)
+{
+    IOTHUB_CLIENT_EXECUTOR_HANDLE result = IoTHubClientExecutor_Create(1);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+BEGIN_TEST_SUITE(iothub_client_executor_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_umock_alias_types();
+    register_global_mock_returns();
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    reset_test_data();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    reset_test_data();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_Create_zero_workers_fails)
+{
+    // act
+    IOTHUB_CLIENT_EXECUTOR_HANDLE result = IoTHubClientExecutor_Create(0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_Create_succeeds)
+{
+    // arrange
+    set_expected_calls_for_create(2);
+
+    // act
+    IOTHUB_CLIENT_EXECUTOR_HANDLE result = IoTHubClientExecutor_Create(2);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientExecutor_Destroy(result);
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_Create_negative_tests)
+{
+    // arrange
+    size_t i;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_expected_calls_for_create(1);
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        IOTHUB_CLIENT_EXECUTOR_HANDLE result = IoTHubClientExecutor_Create(1);
+
+        // assert
+        ASSERT_IS_NULL(result, "On failed call %lu", (unsigned long)i);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_Destroy_stops_and_joins_the_workers)
+{
+    // arrange
+    IOTHUB_CLIENT_EXECUTOR_HANDLE executor = create_executor();
+
+    set_expected_calls_for_stop();
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(executor));
+
+    // act
+    IoTHubClientExecutor_Destroy(executor);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_Register_NULL_work_function_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_EXECUTOR_HANDLE executor = create_executor();
+
+    // act
+    IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE entry = IoTHubClientExecutor_Register(executor, NULL, TEST_CONTEXT_1);
+
+    // assert
+    ASSERT_IS_NULL(entry);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientExecutor_Destroy(executor);
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_Register_schedules_the_entry_immediately)
+{
+    // arrange
+    IOTHUB_CLIENT_EXECUTOR_HANDLE executor = create_executor();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE entry = IoTHubClientExecutor_Register(executor, test_work_function, TEST_CONTEXT_1);
+
+    // assert
+    ASSERT_IS_NOT_NULL(entry);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientExecutor_Unregister(executor, entry);
+    IoTHubClientExecutor_Destroy(executor);
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_worker_runs_due_entries_in_order_and_waits_for_the_next_one)
+{
+    // arrange
+    IOTHUB_CLIENT_EXECUTOR_HANDLE executor = create_executor();
+    IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE entry_1 = IoTHubClientExecutor_Register(executor, test_work_function, TEST_CONTEXT_1);
+    g_now_ms = 5;
+    IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE entry_2 = IoTHubClientExecutor_Register(executor, test_work_function, TEST_CONTEXT_2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(test_work_function(TEST_CONTEXT_1)).SetReturn(300);
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(test_work_function(TEST_CONTEXT_2)).SetReturn(100);
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 100));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientExecutor_Unregister(executor, entry_1);
+    IoTHubClientExecutor_Unregister(executor, entry_2);
+    IoTHubClientExecutor_Destroy(executor);
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_Wake_makes_the_entry_due_now)
+{
+    // arrange
+    IOTHUB_CLIENT_EXECUTOR_HANDLE executor = create_executor();
+    IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE entry = IoTHubClientExecutor_Register(executor, test_work_function, TEST_CONTEXT_1);
+    g_entry_to_wake = entry;
+    g_wake_at_ms = 10;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(test_work_function(TEST_CONTEXT_1)).SetReturn(1000);
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 1000));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(test_work_function(TEST_CONTEXT_1)).SetReturn(1000);
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 1000));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientExecutor_Unregister(executor, entry);
+    IoTHubClientExecutor_Destroy(executor);
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_Destroy_ends_the_worker_loop)
+{
+    // arrange
+    IOTHUB_CLIENT_EXECUTOR_HANDLE executor = create_executor();
+    g_run_worker_on_join = true;
+
+    // act
+    IoTHubClientExecutor_Destroy(executor);
+
+    // assert
+    ASSERT_IS_FALSE(g_run_worker_on_join);
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "ThreadAPI_Exit(0)"));
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "Condition_Wait"));
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_Register_fails_when_the_heap_cannot_grow)
+{
+    // arrange
+    IOTHUB_CLIENT_EXECUTOR_HANDLE executor = create_executor();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE entry = IoTHubClientExecutor_Register(executor, test_work_function, TEST_CONTEXT_1);
+
+    // assert
+    ASSERT_IS_NULL(entry);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientExecutor_Destroy(executor);
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_worker_abandons_the_entry_when_the_lock_cannot_be_taken_back)
+{
+    // arrange
+    IOTHUB_CLIENT_EXECUTOR_HANDLE executor = create_executor();
+    IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE entry = IoTHubClientExecutor_Register(executor, test_work_function, TEST_CONTEXT_1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(test_work_function(TEST_CONTEXT_1)).SetReturn(100);
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE)).SetReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    /*the abandoned entry is still running, so it is freed here instead of through Unregister*/
+    IoTHubClientExecutor_Destroy(executor);
+    my_gballoc_free(entry);
+}
+
+TEST_FUNCTION(IoTHubClientExecutor_Unregister_removes_the_entry)
+{
+    // arrange
+    IOTHUB_CLIENT_EXECUTOR_HANDLE executor = create_executor();
+    IOTHUB_CLIENT_EXECUTOR_ENTRY_HANDLE entry = IoTHubClientExecutor_Register(executor, test_work_function, TEST_CONTEXT_1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(entry));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    IoTHubClientExecutor_Unregister(executor, entry);
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientExecutor_Destroy(executor);
+}
+
+END_TEST_SUITE(iothub_client_executor_ut)
@@ -0,0 +1,383 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "umock_c/umock_c_prod.h"
+
+MOCKABLE_FUNCTION(, void, test_reported_state_callback, int, status_code, void*, context);
+#undef ENABLE_MOCKS
+
+#include "parson.h"
+#include "internal/iothub_client_reported_state_coalescer.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_CONTEXT_1      (void*)0x4471
+#define TEST_CONTEXT_2      (void*)0x4472
+
+static int add_patch(REPORTED_STATE_COALESCER_HANDLE coalescer, const char* patch, void* context)
+{
+    return reported_state_coalescer_add(coalescer, (const unsigned char*)patch, strlen(patch), test_reported_state_callback, context);
+}
+
+static void assert_batch_patch(REPORTED_STATE_BATCH_HANDLE batch, const char* expected)
+{
+    JSON_Value* actual_value = json_parse_string(reported_state_batch_get_patch(batch));
+    JSON_Value* expected_value = json_parse_string(expected);
+
+    ASSERT_IS_NOT_NULL(actual_value);
+    ASSERT_IS_NOT_NULL(expected_value);
+    ASSERT_IS_TRUE(json_value_equals(expected_value, actual_value));
+
+    json_value_free(actual_value);
+    json_value_free(expected_value);
+}
+
+BEGIN_TEST_SUITE(iothub_client_reported_state_coalescer_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(reported_state_coalescer_create_succeeds)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+
+    //assert
+    ASSERT_IS_NOT_NULL(coalescer);
+    ASSERT_IS_FALSE(reported_state_coalescer_has_pending(coalescer));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    reported_state_coalescer_destroy(coalescer);
+}
+
+TEST_FUNCTION(reported_state_coalescer_create_malloc_fails)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+
+    //assert
+    ASSERT_IS_NULL(coalescer);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(reported_state_coalescer_add_invalid_arguments_fail)
+{
+    //arrange
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+    umock_c_reset_all_calls();
+
+    //act
+    int result_1 = add_patch(NULL, "{\"a\":1}", NULL);
+    int result_2 = reported_state_coalescer_add(coalescer, NULL, 1, test_reported_state_callback, NULL);
+    int result_3 = reported_state_coalescer_add(coalescer, (const unsigned char*)"{}", 0, test_reported_state_callback, NULL);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_2);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_3);
+    ASSERT_IS_FALSE(reported_state_coalescer_has_pending(coalescer));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    reported_state_coalescer_destroy(coalescer);
+}
+
+TEST_FUNCTION(reported_state_coalescer_add_not_a_json_object_fails)
+{
+    //arrange
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+
+    //act
+    int result_1 = add_patch(coalescer, "{\"a\":", NULL);
+    int result_2 = add_patch(coalescer, "[1,2]", NULL);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_2);
+    ASSERT_IS_FALSE(reported_state_coalescer_has_pending(coalescer));
+
+    //cleanup
+    reported_state_coalescer_destroy(coalescer);
+}
+
+TEST_FUNCTION(reported_state_coalescer_add_first_patch_callback_cannot_be_kept_fails)
+{
+    //arrange
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    int result = add_patch(coalescer, "{\"a\":1}", TEST_CONTEXT_1);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(reported_state_coalescer_has_pending(coalescer));
+
+    //cleanup
+    reported_state_coalescer_destroy(coalescer);
+}
+
+TEST_FUNCTION(reported_state_coalescer_take_nothing_pending_returns_NULL)
+{
+    //arrange
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+
+    //act
+    REPORTED_STATE_BATCH_HANDLE batch = reported_state_coalescer_take(coalescer);
+
+    //assert
+    ASSERT_IS_NULL(batch);
+
+    //cleanup
+    reported_state_coalescer_destroy(coalescer);
+}
+
+TEST_FUNCTION(reported_state_coalescer_take_merges_patches_last_writer_wins)
+{
+    //arrange
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+    ASSERT_ARE_EQUAL(int, 0, add_patch(coalescer, "{\"a\":1,\"b\":{\"c\":1,\"d\":2},\"f\":{\"g\":1}}", NULL));
+    ASSERT_ARE_EQUAL(int, 0, add_patch(coalescer, "{\"a\":2,\"b\":{\"c\":3},\"e\":null}", NULL));
+    ASSERT_ARE_EQUAL(int, 0, add_patch(coalescer, "{\"b\":{\"h\":[1,2]},\"f\":null}", NULL));
+
+    //act
+    REPORTED_STATE_BATCH_HANDLE batch = reported_state_coalescer_take(coalescer);
+
+    //assert
+    ASSERT_IS_NOT_NULL(batch);
+    assert_batch_patch(batch, "{\"a\":2,\"b\":{\"c\":3,\"d\":2,\"h\":[1,2]},\"e\":null,\"f\":null}");
+    ASSERT_IS_FALSE(reported_state_coalescer_has_pending(coalescer));
+
+    //cleanup
+    reported_state_batch_destroy(batch);
+    reported_state_coalescer_destroy(coalescer);
+}
+
+TEST_FUNCTION(reported_state_coalescer_add_object_over_scalar_fails)
+{
+    //arrange
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+    ASSERT_ARE_EQUAL(int, 0, add_patch(coalescer, "{\"a\":1}", NULL));
+
+    //act
+    int result = add_patch(coalescer, "{\"a\":{\"b\":1}}", NULL);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    REPORTED_STATE_BATCH_HANDLE batch = reported_state_coalescer_take(coalescer);
+    assert_batch_patch(batch, "{\"a\":1}");
+
+    //cleanup
+    reported_state_batch_destroy(batch);
+    reported_state_coalescer_destroy(coalescer);
+}
+
+TEST_FUNCTION(reported_state_coalescer_add_nested_object_over_array_fails)
+{
+    //arrange
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+    ASSERT_ARE_EQUAL(int, 0, add_patch(coalescer, "{\"a\":{\"b\":[1,2],\"c\":\"x\"}}", NULL));
+
+    //act
+    int result = add_patch(coalescer, "{\"a\":{\"b\":{\"d\":1}}}", NULL);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    REPORTED_STATE_BATCH_HANDLE batch = reported_state_coalescer_take(coalescer);
+    assert_batch_patch(batch, "{\"a\":{\"b\":[1,2],\"c\":\"x\"}}");
+
+    //cleanup
+    reported_state_batch_destroy(batch);
+    reported_state_coalescer_destroy(coalescer);
+}
+
+TEST_FUNCTION(reported_state_coalescer_add_object_over_pending_null_fails)
+{
+    //arrange
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+    ASSERT_ARE_EQUAL(int, 0, add_patch(coalescer, "{\"a\":{\"b\":null},\"c\":1}", TEST_CONTEXT_1));
+    umock_c_reset_all_calls();
+
+    //act
+    int result = add_patch(coalescer, "{\"a\":{\"b\":{\"d\":1}},\"c\":2}", TEST_CONTEXT_2);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    REPORTED_STATE_BATCH_HANDLE batch = reported_state_coalescer_take(coalescer);
+    assert_batch_patch(batch, "{\"a\":{\"b\":null},\"c\":1}");
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(test_reported_state_callback(204, TEST_CONTEXT_1));
+    reported_state_batch_complete(204, batch);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    reported_state_batch_destroy(batch);
+    reported_state_coalescer_destroy(coalescer);
+}
+
+TEST_FUNCTION(reported_state_batch_complete_calls_every_callback)
+{
+    //arrange
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+    ASSERT_ARE_EQUAL(int, 0, add_patch(coalescer, "{\"a\":1}", TEST_CONTEXT_1));
+    ASSERT_ARE_EQUAL(int, 0, reported_state_coalescer_add(coalescer, (const unsigned char*)"{\"b\":1}", 7, NULL, NULL));
+    ASSERT_ARE_EQUAL(int, 0, add_patch(coalescer, "{\"a\":2}", TEST_CONTEXT_2));
+    REPORTED_STATE_BATCH_HANDLE batch = reported_state_coalescer_take(coalescer);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(test_reported_state_callback(204, TEST_CONTEXT_1));
+    STRICT_EXPECTED_CALL(test_reported_state_callback(204, TEST_CONTEXT_2));
+
+    //act
+    reported_state_batch_complete(204, batch);
+    reported_state_batch_complete(204, batch);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    reported_state_batch_destroy(batch);
+    reported_state_coalescer_destroy(coalescer);
+}
+
+TEST_FUNCTION(reported_state_coalescer_take_starts_a_new_batch)
+{
+    //arrange
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+    ASSERT_ARE_EQUAL(int, 0, add_patch(coalescer, "{\"a\":1}", TEST_CONTEXT_1));
+    REPORTED_STATE_BATCH_HANDLE batch_1 = reported_state_coalescer_take(coalescer);
+    ASSERT_ARE_EQUAL(int, 0, add_patch(coalescer, "{\"b\":1}", TEST_CONTEXT_2));
+
+    //act
+    REPORTED_STATE_BATCH_HANDLE batch_2 = reported_state_coalescer_take(coalescer);
+
+    //assert
+    assert_batch_patch(batch_1, "{\"a\":1}");
+    assert_batch_patch(batch_2, "{\"b\":1}");
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(test_reported_state_callback(400, TEST_CONTEXT_2));
+    reported_state_batch_complete(400, batch_2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    reported_state_batch_destroy(batch_1);
+    reported_state_batch_destroy(batch_2);
+    reported_state_coalescer_destroy(coalescer);
+}
+
+TEST_FUNCTION(reported_state_coalescer_destroy_does_not_call_back)
+{
+    //arrange
+    REPORTED_STATE_COALESCER_HANDLE coalescer = reported_state_coalescer_create();
+    ASSERT_ARE_EQUAL(int, 0, add_patch(coalescer, "{\"a\":1}", TEST_CONTEXT_1));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    reported_state_coalescer_destroy(coalescer);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_reported_state_coalescer_ut)
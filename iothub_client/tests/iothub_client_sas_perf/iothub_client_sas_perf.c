@@ -0,0 +1,142 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures the SAS tokens signed per second from a device key: by SASToken_CreateString, which decodes the key and
+// hashes the HMAC pads for every token, by the SAS signer for a new expiry every time, and by the SAS signer for the
+// expiry it signed last (the cached token). The tokens of the signer are first checked against SASToken_CreateString.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/sastoken.h"
+#include "internal/iothub_client_sas_signer.h"
+
+#define TOKEN_COUNT         100000
+#define FIRST_EXPIRY        1700000000
+
+static const char* DEVICE_KEY = "aGVsbG8gd29ybGQgZnJvbSB0aGUgc2FzIHRva2VuIGJlbmNobWFyaw==";
+static const char* SCOPE = "perf-hub.azure-devices.net/devices/perf-device";
+static const char* KEY_NAME = "perf-key";
+
+static void print_rate(const char* name, clock_t start)
+{
+    double elapsed_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    (void)printf("%-28s %.0f ns per token, %.0f tokens/s\r\n", name,
+        (elapsed_s * 1e9) / TOKEN_COUNT, (elapsed_s > 0) ? (TOKEN_COUNT / elapsed_s) : 0);
+}
+
+static int check_tokens(SAS_SIGNER_HANDLE signer)
+{
+    int result = 0;
+    const char* key_names[] = { NULL, KEY_NAME };
+    size_t i;
+
+    for (i = 0; i < sizeof(key_names) / sizeof(key_names[0]) && result == 0; i++)
+    {
+        STRING_HANDLE expected = SASToken_CreateString(DEVICE_KEY, SCOPE, key_names[i], FIRST_EXPIRY);
+        char* actual = sas_signer_get_token(signer, SCOPE, key_names[i], FIRST_EXPIRY);
+
+        if (expected == NULL || actual == NULL)
+        {
+            (void)printf("failed creating the SAS tokens to compare\r\n");
+            result = MU_FAILURE;
+        }
+        else if (strcmp(STRING_c_str(expected), actual) != 0)
+        {
+            (void)printf("the SAS signer token differs:\r\n  %s\r\n  %s\r\n", STRING_c_str(expected), actual);
+            result = MU_FAILURE;
+        }
+
+        free(actual);
+        STRING_delete(expected);
+    }
+
+    return result;
+}
+
+static int measure_sastoken(void)
+{
+    int result = 0;
+    size_t i;
+    clock_t start = clock();
+
+    for (i = 0; i < TOKEN_COUNT && result == 0; i++)
+    {
+        STRING_HANDLE token = SASToken_CreateString(DEVICE_KEY, SCOPE, KEY_NAME, FIRST_EXPIRY + i);
+
+        if (token == NULL)
+        {
+            (void)printf("SASToken_CreateString failed\r\n");
+            result = MU_FAILURE;
+        }
+        STRING_delete(token);
+    }
+
+    if (result == 0)
+    {
+        print_rate("SASToken_CreateString:", start);
+    }
+
+    return result;
+}
+
+static int measure_signer(SAS_SIGNER_HANDLE signer, const char* name, size_t expiry_step)
+{
+    int result = 0;
+    size_t i;
+    clock_t start = clock();
+
+    for (i = 0; i < TOKEN_COUNT && result == 0; i++)
+    {
+        char* token = sas_signer_get_token(signer, SCOPE, KEY_NAME, FIRST_EXPIRY + (i * expiry_step));
+
+        if (token == NULL)
+        {
+            (void)printf("sas_signer_get_token failed\r\n");
+            result = MU_FAILURE;
+        }
+        free(token);
+    }
+
+    if (result == 0)
+    {
+        print_rate(name, start);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result;
+    SAS_SIGNER_HANDLE signer = sas_signer_create(DEVICE_KEY);
+
+    if (signer == NULL)
+    {
+        (void)printf("sas_signer_create failed\r\n");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = check_tokens(signer);
+        if (result == 0)
+        {
+            result = measure_sastoken();
+        }
+        if (result == 0)
+        {
+            result = measure_signer(signer, "sas signer, new expiry:", 1);
+        }
+        if (result == 0)
+        {
+            result = measure_signer(signer, "sas signer, cached token:", 0);
+        }
+        sas_signer_destroy(signer);
+    }
+
+    return result;
+}
@@ -0,0 +1,428 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cstdarg>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umocktypes_stdint.h"
+#include "umock_c/umock_c_negative_tests.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/azure_base64.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/urlencode.h"
+#undef ENABLE_MOCKS
+
+#include "azure_c_shared_utility/sha.h"
+#include "internal/iothub_client_sas_signer.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_LOCK_HANDLE            (LOCK_HANDLE)0x4461
+#define TEST_BUFFER_HANDLE          (BUFFER_HANDLE)0x4462
+#define TEST_DEVICE_KEY             "ZGV2aWNlLWtleQ=="
+#define TEST_SCOPE                  "h.h/devices/d"
+#define TEST_KEY_NAME               "key-name"
+#define TEST_SIGNATURE              "c2ln"
+
+static unsigned char TEST_DECODED_KEY[] = { 'd', 'e', 'v', 'i', 'c', 'e', '-', 'k', 'e', 'y' };
+
+/*the signer only formats the digest, so the stand-in of SHA-256 just counts the digests it is asked for*/
+static size_t g_sha_results;
+
+int SHA256Reset(SHA256Context* context)
+{
+    (void)memset(context, 0, sizeof(SHA256Context));
+    return shaSuccess;
+}
+
+int SHA256Input(SHA256Context* context, const uint8_t* bytes, unsigned int bytecount)
+{
+    (void)context;
+    (void)bytes;
+    (void)bytecount;
+    return shaSuccess;
+}
+
+int SHA256Result(SHA256Context* context, uint8_t Message_Digest[SHA256HashSize])
+{
+    (void)context;
+    (void)memset(Message_Digest, 0, SHA256HashSize);
+    g_sha_results++;
+    return shaSuccess;
+}
+
+/*the STRING_HANDLEs of the test are plain heap strings*/
+static STRING_HANDLE copy_to_string(const char* text)
+{
+    char* result = (char*)my_gballoc_malloc(strlen(text) + 1);
+    (void)strcpy(result, text);
+    return (STRING_HANDLE)result;
+}
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    STRING_HANDLE STRING_construct_sprintf(const char* format, ...);
+
+    STRING_HANDLE STRING_construct_sprintf(const char* format, ...)
+    {
+        char text[256];
+        va_list args;
+
+        va_start(args, format);
+        (void)vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+
+        return copy_to_string(text);
+    }
+#ifdef __cplusplus
+}
+#endif
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    size_t l = strlen(source);
+    *destination = (char*)my_gballoc_malloc(l + 1);
+    (void)memcpy(*destination, source, l + 1);
+    return 0;
+}
+
+static STRING_HANDLE my_Azure_Base64_Encode_Bytes(const unsigned char* source, size_t size)
+{
+    (void)source;
+    (void)size;
+    return copy_to_string(TEST_SIGNATURE);
+}
+
+static STRING_HANDLE my_URL_Encode(STRING_HANDLE input)
+{
+    return copy_to_string((const char*)input);
+}
+
+static const char* my_STRING_c_str(STRING_HANDLE handle)
+{
+    return (const char*)handle;
+}
+
+static void my_STRING_delete(STRING_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static SAS_SIGNER_HANDLE create_signer(void)
+{
+    SAS_SIGNER_HANDLE result = sas_signer_create(TEST_DEVICE_KEY);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    g_sha_results = 0;
+    return result;
+}
+
+static void setup_sas_signer_create_mocks(void)
+{
+    STRICT_EXPECTED_CALL(Azure_Base64_Decode(TEST_DEVICE_KEY));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_BUFFER_HANDLE)).CallCannotFail();
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_BUFFER_HANDLE)).CallCannotFail();
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(BUFFER_delete(TEST_BUFFER_HANDLE));
+}
+
+BEGIN_TEST_SUITE(iothub_client_sas_signer_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURNS(Azure_Base64_Decode, TEST_BUFFER_HANDLE, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(BUFFER_u_char, TEST_DECODED_KEY);
+    REGISTER_GLOBAL_MOCK_RETURN(BUFFER_length, sizeof(TEST_DECODED_KEY));
+    REGISTER_GLOBAL_MOCK_HOOK(Azure_Base64_Encode_Bytes, my_Azure_Base64_Encode_Bytes);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Azure_Base64_Encode_Bytes, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(URL_Encode, my_URL_Encode);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(URL_Encode, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, my_STRING_c_str);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    g_sha_results = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(sas_signer_create_NULL_key_fails)
+{
+    //act
+    SAS_SIGNER_HANDLE signer = sas_signer_create(NULL);
+
+    //assert
+    ASSERT_IS_NULL(signer);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(sas_signer_create_decodes_the_key_once_succeed)
+{
+    //arrange
+    setup_sas_signer_create_mocks();
+
+    //act
+    SAS_SIGNER_HANDLE signer = sas_signer_create(TEST_DEVICE_KEY);
+
+    //assert
+    ASSERT_IS_NOT_NULL(signer);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    sas_signer_destroy(signer);
+}
+
+TEST_FUNCTION(sas_signer_create_fail)
+{
+    //arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    setup_sas_signer_create_mocks();
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (umock_c_negative_tests_can_call_fail(index))
+        {
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
+
+            SAS_SIGNER_HANDLE signer = sas_signer_create(TEST_DEVICE_KEY);
+
+            //assert
+            ASSERT_IS_NULL(signer, "sas_signer_create failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+        }
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+}
+
+TEST_FUNCTION(sas_signer_get_token_NULL_signer_fails)
+{
+    //act
+    char* token = sas_signer_get_token(NULL, TEST_SCOPE, TEST_KEY_NAME, 1234);
+
+    //assert
+    ASSERT_IS_NULL(token);
+}
+
+TEST_FUNCTION(sas_signer_get_token_with_key_name_succeed)
+{
+    //arrange
+    SAS_SIGNER_HANDLE signer = create_signer();
+
+    //act
+    char* token = sas_signer_get_token(signer, TEST_SCOPE, TEST_KEY_NAME, 1234);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, "SharedAccessSignature sr=" TEST_SCOPE "&sig=" TEST_SIGNATURE "&se=1234&skn=" TEST_KEY_NAME, token);
+    ASSERT_ARE_EQUAL(size_t, 2, g_sha_results);
+
+    //cleanup
+    free(token);
+    sas_signer_destroy(signer);
+}
+
+TEST_FUNCTION(sas_signer_get_token_without_key_name_succeed)
+{
+    //arrange
+    SAS_SIGNER_HANDLE signer = create_signer();
+
+    //act
+    char* token = sas_signer_get_token(signer, TEST_SCOPE, NULL, 1234);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, "SharedAccessSignature sr=" TEST_SCOPE "&sig=" TEST_SIGNATURE "&se=1234", token);
+
+    //cleanup
+    free(token);
+    sas_signer_destroy(signer);
+}
+
+TEST_FUNCTION(sas_signer_get_token_same_expiry_is_not_signed_again)
+{
+    //arrange
+    SAS_SIGNER_HANDLE signer = create_signer();
+    char* first_token = sas_signer_get_token(signer, TEST_SCOPE, TEST_KEY_NAME, 1234);
+    g_sha_results = 0;
+
+    //act
+    char* second_token = sas_signer_get_token(signer, TEST_SCOPE, TEST_KEY_NAME, 1234);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, first_token, second_token);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, first_token, second_token);
+    ASSERT_ARE_EQUAL(size_t, 0, g_sha_results);
+
+    //cleanup
+    free(second_token);
+    free(first_token);
+    sas_signer_destroy(signer);
+}
+
+TEST_FUNCTION(sas_signer_get_token_other_expiry_or_key_name_is_signed_again)
+{
+    //arrange
+    SAS_SIGNER_HANDLE signer = create_signer();
+    char* first_token = sas_signer_get_token(signer, TEST_SCOPE, TEST_KEY_NAME, 1234);
+    g_sha_results = 0;
+
+    //act
+    char* later_token = sas_signer_get_token(signer, TEST_SCOPE, TEST_KEY_NAME, 1235);
+    char* other_key_token = sas_signer_get_token(signer, TEST_SCOPE, NULL, 1234);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, "SharedAccessSignature sr=" TEST_SCOPE "&sig=" TEST_SIGNATURE "&se=1235&skn=" TEST_KEY_NAME, later_token);
+    ASSERT_ARE_EQUAL(char_ptr, "SharedAccessSignature sr=" TEST_SCOPE "&sig=" TEST_SIGNATURE "&se=1234", other_key_token);
+    ASSERT_ARE_EQUAL(size_t, 4, g_sha_results);
+
+    //cleanup
+    free(other_key_token);
+    free(later_token);
+    free(first_token);
+    sas_signer_destroy(signer);
+}
+
+TEST_FUNCTION(sas_signer_get_token_fail)
+{
+    //arrange
+    SAS_SIGNER_HANDLE signer = create_signer();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE)).CallCannotFail();
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE)).CallCannotFail();
+    STRICT_EXPECTED_CALL(Azure_Base64_Encode_Bytes(IGNORED_PTR_ARG, SHA256HashSize));
+    STRICT_EXPECTED_CALL(URL_Encode(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (umock_c_negative_tests_can_call_fail(index))
+        {
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
+
+            char* token = sas_signer_get_token(signer, TEST_SCOPE, TEST_KEY_NAME, 1234);
+
+            //assert
+            ASSERT_IS_NULL(token, "sas_signer_get_token failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+        }
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+    sas_signer_destroy(signer);
+}
+
+TEST_FUNCTION(sas_signer_destroy_NULL_does_nothing)
+{
+    //act
+    sas_signer_destroy(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_sas_signer_ut)
@@ -0,0 +1,420 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "parson.h"
+#include "internal/iothub_client_twin_cache.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+MU_DEFINE_ENUM_STRINGS(TWIN_CACHE_RESULT, TWIN_CACHE_RESULT_VALUES)
+TEST_DEFINE_ENUM_TYPE(TWIN_CACHE_RESULT, TWIN_CACHE_RESULT_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_TWIN   "{\"desired\":{\"a\":1,\"b\":{\"c\":1,\"d\":2},\"$version\":4},\"reported\":{\"r\":1,\"$version\":2}}"
+
+static int set_document(TWIN_CACHE_HANDLE twin_cache, const char* twin)
+{
+    return twin_cache_set_document(twin_cache, (const unsigned char*)twin, strlen(twin));
+}
+
+static TWIN_CACHE_RESULT apply_patch(TWIN_CACHE_HANDLE twin_cache, const char* patch)
+{
+    return twin_cache_apply_patch(twin_cache, (const unsigned char*)patch, strlen(patch));
+}
+
+static TWIN_CACHE_HANDLE create_twin_cache(const char* twin)
+{
+    TWIN_CACHE_HANDLE result = twin_cache_create();
+    ASSERT_IS_NOT_NULL(result);
+    if (twin != NULL)
+    {
+        ASSERT_ARE_EQUAL(int, 0, set_document(result, twin));
+    }
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void assert_document(TWIN_CACHE_HANDLE twin_cache, const char* expected)
+{
+    unsigned char* twin;
+    size_t size;
+    char* text;
+    JSON_Value* actual_value;
+    JSON_Value* expected_value = json_parse_string(expected);
+
+    ASSERT_ARE_EQUAL(int, 0, twin_cache_get_document(twin_cache, &twin, &size));
+    text = (char*)malloc(size + 1);
+    ASSERT_IS_NOT_NULL(text);
+    (void)memcpy(text, twin, size);
+    text[size] = '\0';
+    actual_value = json_parse_string(text);
+
+    ASSERT_IS_NOT_NULL(actual_value);
+    ASSERT_IS_NOT_NULL(expected_value);
+    ASSERT_IS_TRUE(json_value_equals(expected_value, actual_value));
+
+    json_value_free(actual_value);
+    json_value_free(expected_value);
+    free(text);
+    free(twin);
+}
+
+BEGIN_TEST_SUITE(iothub_client_twin_cache_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(twin_cache_create_succeeds)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    TWIN_CACHE_HANDLE twin_cache = twin_cache_create();
+
+    //assert
+    ASSERT_IS_NOT_NULL(twin_cache);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_create_malloc_fails)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    TWIN_CACHE_HANDLE twin_cache = twin_cache_create();
+
+    //assert
+    ASSERT_IS_NULL(twin_cache);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(twin_cache_set_document_invalid_arguments_fail)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(NULL);
+
+    //act
+    int result_1 = set_document(NULL, TEST_TWIN);
+    int result_2 = twin_cache_set_document(twin_cache, NULL, 1);
+    int result_3 = twin_cache_set_document(twin_cache, (const unsigned char*)TEST_TWIN, 0);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_2);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_set_document_not_a_json_object_keeps_document)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(TEST_TWIN);
+
+    //act
+    int result_1 = set_document(twin_cache, "{\"desired\":");
+    int result_2 = set_document(twin_cache, "[1]");
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_2);
+    assert_document(twin_cache, TEST_TWIN);
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_get_document_without_document_fails)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(NULL);
+    unsigned char* twin = NULL;
+    size_t size = 0;
+
+    //act
+    int result = twin_cache_get_document(twin_cache, &twin, &size);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(twin);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_get_document_malloc_fails)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(TEST_TWIN);
+    unsigned char* twin = NULL;
+    size_t size = 0;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    int result = twin_cache_get_document(twin_cache, &twin, &size);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(twin);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_apply_patch_merges_next_version)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(TEST_TWIN);
+
+    //act
+    TWIN_CACHE_RESULT result = apply_patch(twin_cache, "{\"a\":null,\"b\":{\"c\":3,\"e\":{\"f\":null,\"g\":1}},\"h\":[1],\"$version\":5}");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_OK, result);
+    assert_document(twin_cache, "{\"desired\":{\"b\":{\"c\":3,\"d\":2,\"e\":{\"g\":1}},\"h\":[1],\"$version\":5},\"reported\":{\"r\":1,\"$version\":2}}");
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_apply_patch_object_over_value_replaces_it)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(TEST_TWIN);
+
+    //act
+    TWIN_CACHE_RESULT result = apply_patch(twin_cache, "{\"a\":{\"x\":1},\"$version\":5}");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_OK, result);
+    assert_document(twin_cache, "{\"desired\":{\"a\":{\"x\":1},\"b\":{\"c\":1,\"d\":2},\"$version\":5},\"reported\":{\"r\":1,\"$version\":2}}");
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_apply_patch_consecutive_versions_succeed)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(TEST_TWIN);
+
+    //act
+    TWIN_CACHE_RESULT result_1 = apply_patch(twin_cache, "{\"a\":2,\"$version\":5}");
+    TWIN_CACHE_RESULT result_2 = apply_patch(twin_cache, "{\"a\":3,\"$version\":6}");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_OK, result_1);
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_OK, result_2);
+    assert_document(twin_cache, "{\"desired\":{\"a\":3,\"b\":{\"c\":1,\"d\":2},\"$version\":6},\"reported\":{\"r\":1,\"$version\":2}}");
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_apply_patch_version_gap_leaves_document)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(TEST_TWIN);
+
+    //act
+    TWIN_CACHE_RESULT result = apply_patch(twin_cache, "{\"a\":2,\"$version\":6}");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_GAP, result);
+    assert_document(twin_cache, TEST_TWIN);
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_apply_patch_already_applied_version_is_stale)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(TEST_TWIN);
+
+    //act
+    TWIN_CACHE_RESULT result = apply_patch(twin_cache, "{\"a\":2,\"$version\":4}");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_STALE, result);
+    assert_document(twin_cache, TEST_TWIN);
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_apply_patch_without_version_is_a_gap)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(TEST_TWIN);
+
+    //act
+    TWIN_CACHE_RESULT result = apply_patch(twin_cache, "{\"a\":2}");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_GAP, result);
+    assert_document(twin_cache, TEST_TWIN);
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_apply_patch_without_document_is_a_gap)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(NULL);
+
+    //act
+    TWIN_CACHE_RESULT result = apply_patch(twin_cache, "{\"a\":2,\"$version\":5}");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_GAP, result);
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_apply_patch_after_full_twin_succeeds)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(TEST_TWIN);
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_GAP, apply_patch(twin_cache, "{\"a\":3,\"$version\":7}"));
+    ASSERT_ARE_EQUAL(int, 0, set_document(twin_cache, "{\"desired\":{\"a\":3,\"$version\":7},\"reported\":{\"$version\":3}}"));
+
+    //act
+    TWIN_CACHE_RESULT result = apply_patch(twin_cache, "{\"a\":4,\"$version\":8}");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_OK, result);
+    assert_document(twin_cache, "{\"desired\":{\"a\":4,\"$version\":8},\"reported\":{\"$version\":3}}");
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_apply_patch_not_a_json_object_fails)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(TEST_TWIN);
+
+    //act
+    TWIN_CACHE_RESULT result_1 = apply_patch(twin_cache, "{\"a\":");
+    TWIN_CACHE_RESULT result_2 = apply_patch(twin_cache, "5");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_ERROR, result_1);
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_ERROR, result_2);
+    assert_document(twin_cache, TEST_TWIN);
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+TEST_FUNCTION(twin_cache_apply_patch_malloc_fails)
+{
+    //arrange
+    TWIN_CACHE_HANDLE twin_cache = create_twin_cache(TEST_TWIN);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    TWIN_CACHE_RESULT result = apply_patch(twin_cache, "{\"a\":2,\"$version\":5}");
+
+    //assert
+    ASSERT_ARE_EQUAL(TWIN_CACHE_RESULT, TWIN_CACHE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_document(twin_cache, TEST_TWIN);
+
+    //cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+END_TEST_SUITE(iothub_client_twin_cache_ut)
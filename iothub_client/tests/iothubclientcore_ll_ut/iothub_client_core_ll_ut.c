@@ -51,6 +51,8 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 #include "iothub_message.h"
 #include "internal/iothub_client_authorization.h"
 #include "internal/iothub_client_diagnostic.h"
+#include "internal/iothub_client_reported_state_coalescer.h"
+#include "internal/iothub_client_twin_cache.h"
 
 #ifdef USE_EDGE_MODULES
 #include "internal/iothub_client_edge.h"
@@ -83,6 +85,7 @@ MOCKABLE_FUNCTION(, int, iothub_client_inbound_device_method_callback, const cha
 MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, FAKE_IoTHubTransport_SendMessageDisposition, MESSAGE_CALLBACK_INFO*, messageData, IOTHUBMESSAGE_DISPOSITION_RESULT, disposition);
 MOCKABLE_FUNCTION(, STRING_HANDLE, FAKE_IoTHubTransport_GetHostname, TRANSPORT_LL_HANDLE, handle);
 MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, FAKE_IoTHubTransport_SetOption, TRANSPORT_LL_HANDLE, handle, const char*, optionName, const void*, value);
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, FAKE_IoTHubTransport_GetOption, TRANSPORT_LL_HANDLE, handle, const char*, optionName, void*, value);
 MOCKABLE_FUNCTION(, TRANSPORT_LL_HANDLE, FAKE_IoTHubTransport_Create, const IOTHUBTRANSPORT_CONFIG*, config, TRANSPORT_CALLBACKS_INFO*, cb_info, void*, ctx);
 MOCKABLE_FUNCTION(, void, FAKE_IoTHubTransport_Destroy, TRANSPORT_LL_HANDLE, handle);
 MOCKABLE_FUNCTION(, IOTHUB_DEVICE_HANDLE, FAKE_IoTHubTransport_Register, TRANSPORT_LL_HANDLE, handle, const IOTHUB_DEVICE_CONFIG*, device, PDLIST_ENTRY, waitingToSend);
@@ -258,9 +261,14 @@ static LIST_ITEM_HANDLE add_item_handle = (LIST_ITEM_HANDLE)0x4245;
 
 static TRANSPORT_CALLBACKS_INFO g_transport_cb_info;
 static void* g_transport_cb_ctx = (void*)0x499922;
+static PDLIST_ENTRY g_waitingToSend;
 
 static const unsigned char TEST_REPORTED_STATE[] = { 0x01, 0x02, 0x03 };
 static const size_t TEST_REPORTED_SIZE = sizeof(TEST_REPORTED_STATE) / sizeof(TEST_REPORTED_STATE[0]);
+static REPORTED_STATE_COALESCER_HANDLE TEST_REPORTED_STATE_COALESCER = (REPORTED_STATE_COALESCER_HANDLE)0x4246;
+static REPORTED_STATE_BATCH_HANDLE TEST_REPORTED_STATE_BATCH = (REPORTED_STATE_BATCH_HANDLE)0x4247;
+static const char* TEST_COALESCED_REPORTED_STATE = "{\"a\":1}";
+static TWIN_CACHE_HANDLE TEST_TWIN_CACHE = (TWIN_CACHE_HANDLE)0x4248;
 
 static const TRANSPORT_PROVIDER* provideFAKE(void);
 
@@ -520,7 +528,7 @@ static IOTHUB_DEVICE_HANDLE my_FAKE_IoTHubTransport_Register(TRANSPORT_LL_HANDLE
 {
     (void)handle;
     (void)device;
-    (void)waitingToSend;
+    g_waitingToSend = waitingToSend;
     return (IOTHUB_DEVICE_HANDLE)my_gballoc_malloc(1);
 }
 
@@ -623,7 +631,8 @@ static TRANSPORT_PROVIDER FAKE_transport_provider =
     FAKE_IotHubTransport_Unsubscribe_InputQueue, /*pfIoTHubTransport_Unsubscribe_InputQueue IoTHubTransport_Unsubscribe_InputQueue; */
     FAKE_IoTHubTransport_SetCallbackContext,
     FAKE_IoTHubTransport_GetTwinAsync,   /*pfIoTHubTransport_GetTwinAsync IoTHubTransport_GetTwinAsync;*/
-    FAKE_IoTHubTransport_GetSupportedPlatformInfo
+    FAKE_IoTHubTransport_GetSupportedPlatformInfo,
+    FAKE_IoTHubTransport_GetOption      /*pfIoTHubTransport_GetOption IoTHubTransport_GetOption;        */
 };
 
 static const TRANSPORT_PROVIDER* provideFAKE(void)
@@ -787,6 +796,11 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(LIST_CONDITION_FUNCTION, void*);
 
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_REPORTED_STATE_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(REPORTED_STATE_COALESCER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(REPORTED_STATE_BATCH_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TWIN_CACHE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TWIN_CACHE_RESULT, int);
 
 #ifndef DONT_USE_UPLOADTOBLOB
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE, void*);
@@ -813,6 +827,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(FAKE_IoTHubTransport_GetHostname, NULL);
     REGISTER_GLOBAL_MOCK_RETURN(FAKE_IoTHubTransport_SetOption, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(FAKE_IoTHubTransport_SetOption, IOTHUB_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(FAKE_IoTHubTransport_GetOption, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(FAKE_IoTHubTransport_GetOption, IOTHUB_CLIENT_ERROR);
     REGISTER_GLOBAL_MOCK_HOOK(FAKE_IoTHubTransport_Create, my_FAKE_IoTHubTransport_Create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(FAKE_IoTHubTransport_Create, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(FAKE_IoTHubTransport_Register, my_FAKE_IoTHubTransport_Register);
@@ -919,6 +935,16 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_get_current_ms, MU_FAILURE);
 
+    REGISTER_GLOBAL_MOCK_RETURNS(reported_state_coalescer_create, TEST_REPORTED_STATE_COALESCER, NULL);
+    REGISTER_GLOBAL_MOCK_RETURNS(reported_state_coalescer_add, 0, MU_FAILURE);
+    REGISTER_GLOBAL_MOCK_RETURN(reported_state_coalescer_has_pending, false);
+    REGISTER_GLOBAL_MOCK_RETURN(reported_state_batch_get_patch, TEST_COALESCED_REPORTED_STATE);
+
+    REGISTER_GLOBAL_MOCK_RETURNS(twin_cache_create, TEST_TWIN_CACHE, NULL);
+    REGISTER_GLOBAL_MOCK_RETURNS(twin_cache_set_document, 0, MU_FAILURE);
+    REGISTER_GLOBAL_MOCK_RETURNS(twin_cache_apply_patch, TWIN_CACHE_OK, TWIN_CACHE_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURNS(twin_cache_get_document, 0, MU_FAILURE);
+
     REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
     REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
     REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
@@ -1040,6 +1066,36 @@ static void setup_IoTHubClientCore_LL_sendreportedstate_mocks()
     STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 }
 
+static IOTHUB_CLIENT_CORE_LL_HANDLE create_reported_state_coalescing_client(size_t coalesce_ms)
+{
+    IOTHUB_CLIENT_CORE_LL_HANDLE result = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClientCore_LL_SetOption(result, OPTION_TWIN_REPORTED_COALESCE_MS, &coalesce_ms));
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static IOTHUB_CLIENT_CORE_LL_HANDLE create_twin_caching_client(void)
+{
+    bool enabled = true;
+    IOTHUB_CLIENT_CORE_LL_HANDLE result = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClientCore_LL_SetOption(result, OPTION_TWIN_CACHE, &enabled));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClientCore_LL_SetDeviceTwinCallback(result, iothub_device_twin_callback, NULL));
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void setup_flush_reported_state_mocks()
+{
+    STRICT_EXPECTED_CALL(reported_state_coalescer_has_pending(TEST_REPORTED_STATE_COALESCER))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(reported_state_coalescer_take(TEST_REPORTED_STATE_COALESCER))
+        .SetReturn(TEST_REPORTED_STATE_BATCH);
+    STRICT_EXPECTED_CALL(reported_state_batch_get_patch(TEST_REPORTED_STATE_BATCH));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, strlen(TEST_COALESCED_REPORTED_STATE)));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
 static void setup_IoTHubClientCore_LL_sendeventasync_mocks(bool invoke_tickcounter)
 {
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
@@ -2234,6 +2290,44 @@ TEST_FUNCTION(IoTHubClientCore_LL_SendEventAsync_succeeds)
     IoTHubClientCore_LL_Destroy(handle);
 }
 
+TEST_FUNCTION(IoTHubClientCore_LL_SendEventAsyncMove_does_not_clone_the_message)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE handle = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendEventAsyncMove(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_SendEventAsyncMove_with_NULL_messageHandle_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE handle = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendEventAsyncMove(handle, NULL, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(handle);
+}
+
 /*Tests_SRS_IoTHubClientCore_LL_02_010: [IoTHubClientCore_LL_Destroy shall call the underlaying layer's _Destroy function and shall free the resources allocated by IoTHubClient (if any).] */
 /*Tests_SRS_IoTHubClientCore_LL_02_033: [Otherwise, IoTHubClientCore_LL_Destroy shall complete all the event message callbacks that are in the waitingToSend list with the result IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.] */
 TEST_FUNCTION(IoTHubClientCore_LL_Destroy_after_sendEvent_succeeds)
@@ -2621,6 +2715,7 @@ TEST_FUNCTION(IoTHubClientCore_LL_SendComplete_with_1_items_with_callback_succee
     one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
     one->callback = eventConfirmationCallback;
     one->context = (void*)1;
+    timeout_heap_node_init(&(one->timeout_node));
     DList_InsertTailList(&temp, &(one->entry));
     umock_c_reset_all_calls();
 
@@ -2656,18 +2751,21 @@ TEST_FUNCTION(IoTHubClientCore_LL_SendComplete_with_3_items_with_callback_succee
     one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
     one->callback = eventConfirmationCallback;
     one->context = (void*)1;
+    timeout_heap_node_init(&(one->timeout_node));
     DList_InsertTailList(&temp, &(one->entry));
 
     IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
     two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
     two->callback = eventConfirmationCallback;
     two->context = (void*)2;
+    timeout_heap_node_init(&(two->timeout_node));
     DList_InsertTailList(&temp, &(two->entry));
 
     IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
     three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
     three->callback = eventConfirmationCallback;
     three->context = (void*)3;
+    timeout_heap_node_init(&(three->timeout_node));
     DList_InsertTailList(&temp, &(three->entry));
 
     umock_c_reset_all_calls();
@@ -2716,18 +2814,21 @@ TEST_FUNCTION(IoTHubClientCore_LL_SendComplete_with_3_items_with_callback_but_ba
     one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
     one->callback = eventConfirmationCallback;
     one->context = (void*)1;
+    timeout_heap_node_init(&(one->timeout_node));
     DList_InsertTailList(&temp, &(one->entry));
 
     IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
     two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
     two->callback = eventConfirmationCallback;
     two->context = (void*)2;
+    timeout_heap_node_init(&(two->timeout_node));
     DList_InsertTailList(&temp, &(two->entry));
 
     IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
     three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
     three->callback = eventConfirmationCallback;
     three->context = (void*)3;
+    timeout_heap_node_init(&(three->timeout_node));
     DList_InsertTailList(&temp, &(three->entry));
 
 
@@ -3045,18 +3146,21 @@ TEST_FUNCTION(IoTHubClientCore_LL_SendComplete_with_3_items_one_without_callback
     one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
     one->callback = test_event_confirmation_callback;
     one->context = (void*)1;
+    timeout_heap_node_init(&(one->timeout_node));
     DList_InsertTailList(&temp, &(one->entry));
 
     IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
     two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
     two->callback = NULL;
     two->context = NULL;
+    timeout_heap_node_init(&(two->timeout_node));
     DList_InsertTailList(&temp, &(two->entry));
 
     IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
     three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
     three->callback = test_event_confirmation_callback;
     three->context = (void*)3;
+    timeout_heap_node_init(&(three->timeout_node));
     DList_InsertTailList(&temp, &(three->entry));
 
     umock_c_reset_all_calls();
@@ -3103,18 +3207,21 @@ TEST_FUNCTION(IoTHubClientCore_LL_SendComplete_with_3_items_one_with_callback_bu
     one->messageHandle = (IOTHUB_MESSAGE_HANDLE)1;
     one->callback = NULL;
     one->context = NULL;
+    timeout_heap_node_init(&(one->timeout_node));
     DList_InsertTailList(&temp, &(one->entry));
 
     IOTHUB_MESSAGE_LIST* two = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
     two->messageHandle = (IOTHUB_MESSAGE_HANDLE)2;
     two->callback = NULL;
     two->context = NULL;
+    timeout_heap_node_init(&(two->timeout_node));
     DList_InsertTailList(&temp, &(two->entry));
 
     IOTHUB_MESSAGE_LIST* three = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST)); /*this is SendEvent wannabe*/
     three->messageHandle = (IOTHUB_MESSAGE_HANDLE)3;
     three->callback = test_event_confirmation_callback;
     three->context = (void*)3;
+    timeout_heap_node_init(&(three->timeout_node));
     DList_InsertTailList(&temp, &(three->entry));
 
     umock_c_reset_all_calls();
@@ -3544,6 +3651,109 @@ TEST_FUNCTION(IoTHubClientCore_LL_GetSendStatus_HasEventToSend_Succeeds)
     IoTHubClientCore_LL_Destroy(handle);
 }
 
+TEST_FUNCTION(IoTHubClientCore_LL_GetSendStatus_with_coalesced_reported_state_pending_is_busy)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE handle = create_reported_state_coalescing_client(100);
+
+    IOTHUB_CLIENT_STATUS status;
+    IOTHUB_CLIENT_STATUS desire_status = IOTHUB_CLIENT_SEND_STATUS_IDLE;
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetSendStatus(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_handle()
+        .CopyOutArgumentBuffer_iotHubClientStatus(&desire_status, sizeof(status))
+        .SetReturn(IOTHUB_CLIENT_OK);
+    STRICT_EXPECTED_CALL(reported_state_coalescer_has_pending(TEST_REPORTED_STATE_COALESCER))
+        .SetReturn(true);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_GetSendStatus(handle, &status);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_BUSY, status);
+
+    // cleanup
+    IoTHubClientCore_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_SetOption_twin_reported_coalesce_ms_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE handle = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    size_t coalesce_ms = 100;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(reported_state_coalescer_create());
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SetOption(handle, OPTION_TWIN_REPORTED_COALESCE_MS, &coalesce_ms);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_SetOption_twin_reported_coalesce_ms_twice_creates_one_coalescer)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE handle = create_reported_state_coalescing_client(100);
+    size_t coalesce_ms = 200;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SetOption(handle, OPTION_TWIN_REPORTED_COALESCE_MS, &coalesce_ms);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_SetOption_twin_reported_coalesce_ms_0_does_not_create_coalescer)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE handle = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    size_t coalesce_ms = 0;
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SetOption(handle, OPTION_TWIN_REPORTED_COALESCE_MS, &coalesce_ms);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_SetOption_twin_reported_coalesce_ms_coalescer_create_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE handle = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    size_t coalesce_ms = 100;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(reported_state_coalescer_create())
+        .SetReturn(NULL);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SetOption(handle, OPTION_TWIN_REPORTED_COALESCE_MS, &coalesce_ms);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_LL_Destroy(handle);
+}
+
 TEST_FUNCTION(IoTHubClientCore_LL_SetOption_sas_token_lifetime_succeeds)
 {
     //arrange
@@ -3749,6 +3959,69 @@ TEST_FUNCTION(IoTHubClientCore_LL_SetOption_fails_when_underlying_transport_fail
 }
 #endif
 
+TEST_FUNCTION(IoTHubClientCore_LL_GetOption_with_NULL_arguments_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE handle = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    int value;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result_1 = IoTHubClientCore_LL_GetOption(NULL, "a", &value);
+    IOTHUB_CLIENT_RESULT result_2 = IoTHubClientCore_LL_GetOption(handle, NULL, &value);
+    IOTHUB_CLIENT_RESULT result_3 = IoTHubClientCore_LL_GetOption(handle, "a", NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result_1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result_2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result_3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_GetOption_reads_the_transport_option)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE handle = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    int value;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetOption(IGNORED_PTR_ARG, "a", &value));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_GetOption(handle, "a", &value);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_GetOption_fails_when_underlying_transport_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE handle = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    int value;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetOption(IGNORED_PTR_ARG, "a", &value))
+        .SetReturn(IOTHUB_CLIENT_INVALID_ARG);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_GetOption(handle, "a", &value);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(handle);
+}
+
 /*Tests_SRS_IoTHubClientCore_LL_02_039: [ "messageTimeout" - once IoTHubClientCore_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
 TEST_FUNCTION(IoTHubClientCore_LL_SetOption_messageTimeout_to_zero_after_Create_succeeds)
 {
@@ -4160,6 +4433,52 @@ TEST_FUNCTION(IoTHubClientCore_LL_SetOption_2_messages_one_with_timeout_one_with
     IoTHubClientCore_LL_Destroy(handle);
 }
 
+/*Tests_SRS_IoTHubClientCore_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClientCore_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+TEST_FUNCTION(IoTHubClientCore_LL_SetOption_messageTimeout_does_not_time_out_messages_taken_by_the_transport)
+{
+    //arrange
+
+    IOTHUB_CLIENT_CORE_LL_HANDLE handle = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClientCore_LL_SetOption(handle, "messageTimeout", &one);
+
+    /*send 2 messages at time=10, both expire at 12*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClientCore_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClientCore_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+
+    /*the transport takes the first message, as transports do, from the front of waitingToSend*/
+    DLIST_ENTRY taken;
+    DList_InitializeListHead(&taken);
+    DList_InsertTailList(&taken, DList_RemoveHeadList(g_waitingToSend));
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t twelve = 12; /*12 > 10 (receive time) + 1 (timeout) => timeout!!!*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+
+    /*only the message still in waitingToSend times out*/
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG)); /*this is removing the item from waitingToSend*/
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)(TEST_DEVICEMESSAGE_HANDLE_2))); /*calling the callback*/
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG)); /*destroying the message clone*/
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*destroying the IOTHUB_MESSAGE_LIST*/
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClientCore_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    g_transport_cb_info.send_complete_cb(&taken, IOTHUB_CLIENT_CONFIRMATION_OK, g_transport_cb_ctx);
+    IoTHubClientCore_LL_Destroy(handle);
+}
+
 /*Tests_SRS_IoTHubClientCore_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClientCore_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
 TEST_FUNCTION(IoTHubClientCore_LL_SetOption_messageTimeout_when_tickcounter_fails_in_do_work_no_timeout_callbacks_are_called) /*test wants to see that message that did not timeout yet do not have their callbacks called*/
 {
@@ -4577,6 +4896,164 @@ TEST_FUNCTION(IoTHubClientCore_LL_DoWork_SendReportedState_continue_processing_s
     IoTHubClientCore_LL_Destroy(h);
 }
 
+TEST_FUNCTION(IoTHubClientCore_LL_SendReportedState_coalesced_queues_nothing)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_reported_state_coalescing_client(100);
+
+    STRICT_EXPECTED_CALL(reported_state_coalescer_has_pending(TEST_REPORTED_STATE_COALESCER));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceTwin(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(reported_state_coalescer_add(TEST_REPORTED_STATE_COALESCER, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, (void*)0x42));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*the interval starts with the first patch*/
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendReportedState(h, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, (void*)0x42);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_SendReportedState_coalesced_into_pending_keeps_interval)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_reported_state_coalescing_client(100);
+
+    STRICT_EXPECTED_CALL(reported_state_coalescer_has_pending(TEST_REPORTED_STATE_COALESCER))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceTwin(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(reported_state_coalescer_add(TEST_REPORTED_STATE_COALESCER, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendReportedState(h, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_SendReportedState_not_coalesced_queues_pending_patches_first)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_reported_state_coalescing_client(100);
+
+    STRICT_EXPECTED_CALL(reported_state_coalescer_has_pending(TEST_REPORTED_STATE_COALESCER))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe_DeviceTwin(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(reported_state_coalescer_add(TEST_REPORTED_STATE_COALESCER, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL))
+        .SetReturn(MU_FAILURE);
+    setup_flush_reported_state_mocks();
+    setup_IoTHubClientCore_LL_sendreportedstate_mocks();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendReportedState(h, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_DoWork_queues_coalesced_reported_state_after_interval)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_reported_state_coalescing_client(100);
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendReportedState(h, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*_DoWork will ask "what's the time"*/
+    STRICT_EXPECTED_CALL(reported_state_coalescer_has_pending(TEST_REPORTED_STATE_COALESCER))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_flush_reported_state_mocks();
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_ProcessItem(IGNORED_PTR_ARG, IOTHUB_TYPE_DEVICE_TWIN, IGNORED_PTR_ARG))
+        .IgnoreArgument_item_type();
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClientCore_LL_DoWork(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_DoWork_holds_coalesced_reported_state_within_interval)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_reported_state_coalescing_client(60000);
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SendReportedState(h, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, iothub_reported_state_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)); /*_DoWork will ask "what's the time"*/
+    STRICT_EXPECTED_CALL(reported_state_coalescer_has_pending(TEST_REPORTED_STATE_COALESCER))
+        .SetReturn(true);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClientCore_LL_DoWork(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_Destroy_with_coalesced_reported_state_pending_calls_back)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_reported_state_coalescing_client(100);
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(reported_state_coalescer_take(TEST_REPORTED_STATE_COALESCER))
+        .SetReturn(TEST_REPORTED_STATE_BATCH);
+    STRICT_EXPECTED_CALL(reported_state_batch_complete(0, TEST_REPORTED_STATE_BATCH));
+    STRICT_EXPECTED_CALL(reported_state_batch_destroy(TEST_REPORTED_STATE_BATCH));
+    STRICT_EXPECTED_CALL(reported_state_coalescer_destroy(TEST_REPORTED_STATE_COALESCER));
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG));
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Destroy(IGNORED_PTR_ARG));
+#endif
+#ifdef USE_EDGE_MODULES
+    STRICT_EXPECTED_CALL(IoTHubClient_EdgeHandle_Destroy(IGNORED_PTR_ARG));
+#endif
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClientCore_LL_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 /*Tests_SRS_IoTHubClientCore_LL_12_017: [ `IoTHubClientCore_LL_SetDeviceMethodCallback` shall fail and return `IOTHUB_CLIENT_INVALID_ARG` if parameter `iotHubClientHandle` is `NULL`. ]*/
 TEST_FUNCTION(IoTHubClientCore_LL_SetDeviceMethodCallback_with_NULL_iotHubClientHandle_fails)
 {
@@ -5005,6 +5482,238 @@ TEST_FUNCTION(IoTHubClientCore_LL_RetrievePropertyComplete_update_partial_before
     IoTHubClientCore_LL_Destroy(h);
 }
 
+TEST_FUNCTION(IoTHubClientCore_LL_SetOption_twin_cache_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    bool enabled = true;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(twin_cache_create());
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SetOption(h, OPTION_TWIN_CACHE, &enabled);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_SetOption_twin_cache_create_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    bool enabled = true;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(twin_cache_create())
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SetOption(h, OPTION_TWIN_CACHE, &enabled);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_SetOption_twin_cache_false_destroys_cache)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_twin_caching_client();
+    bool enabled = false;
+
+    STRICT_EXPECTED_CALL(twin_cache_destroy(TEST_TWIN_CACHE));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_SetOption(h, OPTION_TWIN_CACHE, &enabled);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_RetrievePropertyComplete_complete_sets_cached_twin)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_twin_caching_client();
+
+    STRICT_EXPECTED_CALL(twin_cache_set_document(TEST_TWIN_CACHE, TEST_REPORTED_STATE, TEST_REPORTED_SIZE));
+    STRICT_EXPECTED_CALL(iothub_device_twin_callback(DEVICE_TWIN_UPDATE_COMPLETE, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, NULL));
+
+    //act
+    g_transport_cb_info.twin_retrieve_prop_complete_cb(DEVICE_TWIN_UPDATE_COMPLETE, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_RetrievePropertyComplete_partial_applies_patch_to_cached_twin)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_twin_caching_client();
+    g_transport_cb_info.twin_retrieve_prop_complete_cb(DEVICE_TWIN_UPDATE_COMPLETE, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(twin_cache_apply_patch(TEST_TWIN_CACHE, TEST_REPORTED_STATE, TEST_REPORTED_SIZE));
+    STRICT_EXPECTED_CALL(iothub_device_twin_callback(DEVICE_TWIN_UPDATE_PARTIAL, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, NULL));
+
+    //act
+    g_transport_cb_info.twin_retrieve_prop_complete_cb(DEVICE_TWIN_UPDATE_PARTIAL, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_RetrievePropertyComplete_partial_gap_fetches_twin_once)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_twin_caching_client();
+    g_transport_cb_info.twin_retrieve_prop_complete_cb(DEVICE_TWIN_UPDATE_COMPLETE, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(twin_cache_apply_patch(TEST_TWIN_CACHE, TEST_REPORTED_STATE, TEST_REPORTED_SIZE))
+        .SetReturn(TWIN_CACHE_GAP);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetTwinAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, h));
+    STRICT_EXPECTED_CALL(iothub_device_twin_callback(DEVICE_TWIN_UPDATE_PARTIAL, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, NULL));
+    STRICT_EXPECTED_CALL(twin_cache_apply_patch(TEST_TWIN_CACHE, TEST_REPORTED_STATE, TEST_REPORTED_SIZE))
+        .SetReturn(TWIN_CACHE_GAP);
+    STRICT_EXPECTED_CALL(iothub_device_twin_callback(DEVICE_TWIN_UPDATE_PARTIAL, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, NULL));
+
+    //act
+    g_transport_cb_info.twin_retrieve_prop_complete_cb(DEVICE_TWIN_UPDATE_PARTIAL, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, h);
+    g_transport_cb_info.twin_retrieve_prop_complete_cb(DEVICE_TWIN_UPDATE_PARTIAL, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_RetrievePropertyComplete_fetched_twin_sets_cached_twin)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_twin_caching_client();
+    STRICT_EXPECTED_CALL(twin_cache_apply_patch(TEST_TWIN_CACHE, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(TWIN_CACHE_GAP);
+    g_transport_cb_info.twin_retrieve_prop_complete_cb(DEVICE_TWIN_UPDATE_PARTIAL, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, h);
+    ASSERT_IS_NOT_NULL(my_FAKE_IoTHubTransport_GetTwinAsync_completionCallback);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(twin_cache_set_document(TEST_TWIN_CACHE, TEST_REPORTED_STATE, TEST_REPORTED_SIZE));
+    STRICT_EXPECTED_CALL(twin_cache_apply_patch(TEST_TWIN_CACHE, TEST_REPORTED_STATE, TEST_REPORTED_SIZE))
+        .SetReturn(TWIN_CACHE_GAP);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetTwinAsync(IGNORED_PTR_ARG, IGNORED_PTR_ARG, h)); /*a new gap fetches the twin again*/
+
+    //act
+    my_FAKE_IoTHubTransport_GetTwinAsync_completionCallback(DEVICE_TWIN_UPDATE_COMPLETE, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, my_FAKE_IoTHubTransport_GetTwinAsync_callbackContext);
+    g_transport_cb_info.twin_retrieve_prop_complete_cb(DEVICE_TWIN_UPDATE_PARTIAL, TEST_REPORTED_STATE, TEST_REPORTED_SIZE, h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_GetCachedTwin_NULL_arguments_fail)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_twin_caching_client();
+    unsigned char* twin;
+    size_t size;
+
+    //act
+    IOTHUB_CLIENT_RESULT result_1 = IoTHubClientCore_LL_GetCachedTwin(NULL, &twin, &size);
+    IOTHUB_CLIENT_RESULT result_2 = IoTHubClientCore_LL_GetCachedTwin(h, NULL, &size);
+    IOTHUB_CLIENT_RESULT result_3 = IoTHubClientCore_LL_GetCachedTwin(h, &twin, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result_1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result_2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result_3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_GetCachedTwin_without_twin_cache_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = IoTHubClientCore_LL_Create(&TEST_CONFIG);
+    unsigned char* twin;
+    size_t size;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_GetCachedTwin(h, &twin, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_GetCachedTwin_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_twin_caching_client();
+    unsigned char* twin;
+    size_t size;
+
+    STRICT_EXPECTED_CALL(twin_cache_get_document(TEST_TWIN_CACHE, &twin, &size));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_GetCachedTwin(h, &twin, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubClientCore_LL_GetCachedTwin_without_twin_received_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_CORE_LL_HANDLE h = create_twin_caching_client();
+    unsigned char* twin;
+    size_t size;
+
+    STRICT_EXPECTED_CALL(twin_cache_get_document(TEST_TWIN_CACHE, &twin, &size))
+        .SetReturn(MU_FAILURE);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_LL_GetCachedTwin(h, &twin, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClientCore_LL_Destroy(h);
+}
+
 /*Tests_SRS_IoTHubClientCore_LL_10_006: [ If deviceTwinCallback is NULL, then IoTHubClientCore_LL_SetDeviceTwinCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
 TEST_FUNCTION(IoTHubClientCore_LL_SetDeviceTwinCallback_unsubscribe_succeed)
 {
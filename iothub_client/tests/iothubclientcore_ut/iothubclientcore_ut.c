@@ -12,6 +12,7 @@
 
 #include <time.h>
 #include <signal.h>
+#include <string.h>
 
 #if defined _MSC_VER
 #pragma warning(disable: 4054) /* MSC incorrectly fires this */
@@ -61,6 +62,10 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "iothub_client_executor.h"
+#include "internal/iothub_client_callback_ring.h"
+#include "internal/iothub_client_dispatch_pool.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/agenttime.h"
@@ -214,6 +219,10 @@ static IOTHUB_CLIENT_DEVICE_CONFIG* TEST_CLIENT_DEVICE_CONFIG = (IOTHUB_CLIENT_D
 static METHOD_HANDLE TEST_METHOD_ID = (METHOD_HANDLE)0x111B;
 static STRING_HANDLE TEST_STRING_HANDLE = (STRING_HANDLE)0x111C;
 static BUFFER_HANDLE TEST_BUFFER_HANDLE = (BUFFER_HANDLE)0x111D;
+static TICK_COUNTER_HANDLE TEST_WORKER_TICK_COUNTER_HANDLE = (TICK_COUNTER_HANDLE)0x1120;
+static COND_HANDLE TEST_WORK_SIGNAL_HANDLE = (COND_HANDLE)0x1121;
+static CALLBACK_RING_HANDLE TEST_CALLBACK_RING_HANDLE = (CALLBACK_RING_HANDLE)0x1122;
+static DISPATCH_POOL_HANDLE TEST_DISPATCH_POOL_HANDLE = (DISPATCH_POOL_HANDLE)0x1123;
 
 static const char* TEST_CONNECTION_STRING = "Test_connection_string";
 static const char* TEST_DEVICE_ID = "theidofTheDevice";
@@ -446,6 +455,41 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
     ASSERT_FAIL(temp_str);
 }
 
+static DISPATCH_POOL_FUNCTION g_dispatch_pool_function;
+static void* g_dispatch_pool_context;
+static unsigned char g_dispatch_pool_record[256];
+static size_t g_dispatch_pool_record_size;
+
+static DISPATCH_POOL_HANDLE my_dispatch_pool_create(size_t thread_count, size_t category_count, size_t record_size, size_t queue_capacity, DISPATCH_POOL_FUNCTION function, void* context)
+{
+    (void)thread_count;
+    (void)category_count;
+    (void)queue_capacity;
+    g_dispatch_pool_record_size = (record_size < sizeof(g_dispatch_pool_record)) ? record_size : sizeof(g_dispatch_pool_record);
+    g_dispatch_pool_function = function;
+    g_dispatch_pool_context = context;
+    return TEST_DISPATCH_POOL_HANDLE;
+}
+
+static int my_dispatch_pool_submit(DISPATCH_POOL_HANDLE pool, size_t category, const void* record)
+{
+    (void)pool;
+    (void)category;
+    (void)memcpy(g_dispatch_pool_record, record, g_dispatch_pool_record_size);
+    return 0;
+}
+
+static int my_dispatch_pool_get_statistics(DISPATCH_POOL_HANDLE pool, size_t category, DISPATCH_POOL_CATEGORY_STATISTICS* statistics)
+{
+    (void)pool;
+    statistics->queue_depth = 1;
+    statistics->max_queue_depth = category + 1;
+    statistics->dispatched = 2;
+    statistics->total_latency_ms = 10;
+    statistics->max_latency_ms = 5;
+    return 0;
+}
+
 BEGIN_TEST_SUITE(iothubclientcore_ut)
 
 TEST_SUITE_INITIALIZE(suite_init)
@@ -503,6 +547,11 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX, void*);
     REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(CALLBACK_RING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DISPATCH_POOL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DISPATCH_POOL_FUNCTION, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -520,6 +569,8 @@ TEST_SUITE_INITIALIZE(suite_init)
 #endif
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClientCore_LL_SendEventAsync, my_IoTHubClientCore_LL_SendEventAsync);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClientCore_LL_SendEventAsync, IOTHUB_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClientCore_LL_SendEventAsyncMove, my_IoTHubClientCore_LL_SendEventAsync);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClientCore_LL_SendEventAsyncMove, IOTHUB_CLIENT_ERROR);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClientCore_LL_GetSendStatus, my_IoTHubClientCore_LL_GetSendStatus);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClientCore_LL_GetSendStatus, IOTHUB_CLIENT_ERROR);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClientCore_LL_GetLastMessageReceiveTime, my_IoTHubClientCore_LL_GetLastMessageReceiveTime);
@@ -553,6 +604,19 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     REGISTER_GLOBAL_MOCK_RETURN(get_time, (time_t)TEST_TIME_VALUE);
 
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_WORKER_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_WORK_SIGNAL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(callback_ring_create, TEST_CALLBACK_RING_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(callback_ring_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(callback_ring_pop, MU_FAILURE); /*empty*/
+    REGISTER_GLOBAL_MOCK_HOOK(dispatch_pool_create, my_dispatch_pool_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(dispatch_pool_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(dispatch_pool_submit, my_dispatch_pool_submit);
+    REGISTER_GLOBAL_MOCK_HOOK(dispatch_pool_get_statistics, my_dispatch_pool_get_statistics);
+
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_LL_GetRetryPolicy, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClientCore_LL_Destroy, my_IoTHubClient_LL_Destroy);
     REGISTER_GLOBAL_MOCK_HOOK(test_event_confirmation_callback, my_test_event_confirmation_callback);
@@ -1431,6 +1495,29 @@ TEST_FUNCTION(IoTHubClient_SendEventAsync_succeed)
     IoTHubClientCore_Destroy(iothub_handle);
 }
 
+TEST_FUNCTION(IoTHubClient_SendEventAsyncMove_hands_the_message_to_the_LL_layer)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_SendEventAsyncMove(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SendEventAsyncMove(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
 /* Tests_SRS_IOTHUBCLIENT_01_010: [If starting the thread fails, IoTHubClientCore_SendEventAsync shall return IOTHUB_CLIENT_ERROR.] */
 /* Tests_SRS_IOTHUBCLIENT_01_011: [If iotHubClientHandle is NULL, IoTHubClientCore_SendEventAsync shall return IOTHUB_CLIENT_INVALID_ARG.] */
 /* Tests_SRS_IOTHUBCLIENT_01_013: [When IoTHubClientCore_LL_SendEventAsync is called, IoTHubClientCore_SendEventAsync shall return the result of IoTHubClientCore_LL_SendEventAsync.] */
@@ -2216,6 +2303,424 @@ TEST_FUNCTION(IoTHubClientCore_SetOption_DO_WORK_FREQUENCY_IN_MS_and_MESSAGE_TIM
     IoTHubClientCore_Destroy(iothub_handle);
 }
 
+TEST_FUNCTION(IoTHubClientCore_SetOption_WAKE_ON_WORK_MAX_IDLE_MS_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t max_idle_ms = 1000;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_WORK_SIGNAL_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SetOption(iothub_handle, OPTION_WAKE_ON_WORK_MAX_IDLE_MS, &max_idle_ms);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_SetOption_WAKE_ON_WORK_MAX_IDLE_MS_below_do_work_freq_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    tickcounter_ms_t frequency = 50;
+    tickcounter_ms_t max_idle_ms = 10;
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_DO_WORK_FREQUENCY_IN_MS, &frequency);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SetOption(iothub_handle, OPTION_WAKE_ON_WORK_MAX_IDLE_MS, &max_idle_ms);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_SetOption_WAKE_ON_WORK_MAX_IDLE_MS_Condition_Init_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t max_idle_ms = 1000;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    STRICT_EXPECTED_CALL(Condition_Init()).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SetOption(iothub_handle, OPTION_WAKE_ON_WORK_MAX_IDLE_MS, &max_idle_ms);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_SetOption_USER_CALLBACK_RING_CAPACITY_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    size_t capacity = 64;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(callback_ring_create(IGNORED_NUM_ARG, capacity));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SetOption(iothub_handle, OPTION_USER_CALLBACK_RING_CAPACITY, &capacity);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_SetOption_USER_CALLBACK_RING_CAPACITY_twice_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t capacity = 64;
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_USER_CALLBACK_RING_CAPACITY, &capacity);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SetOption(iothub_handle, OPTION_USER_CALLBACK_RING_CAPACITY, &capacity);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_Destroy_with_callback_ring_destroys_the_ring)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t capacity = 64;
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_USER_CALLBACK_RING_CAPACITY, &capacity);
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubClientCore_Destroy(iothub_handle);
+
+    // assert
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "callback_ring_pop("));
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "callback_ring_destroy("));
+}
+
+TEST_FUNCTION(IoTHubClientCore_GetWorkerStatistics_reports_callback_ring_high_water_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_WORKER_STATISTICS worker_statistics;
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t capacity = 64;
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_USER_CALLBACK_RING_CAPACITY, &capacity);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(callback_ring_get_high_water(TEST_CALLBACK_RING_HANDLE)).SetReturn(7);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GetWorkerStatistics(iothub_handle, &worker_statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 7, (int)worker_statistics.callback_queue_high_water);
+    ASSERT_ARE_EQUAL(int, 0, (int)worker_statistics.dropped_callbacks);
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_callback_ring_full_queues_callbacks_in_the_list_succeed)
+{
+    // arrange
+    void* userContextCallback1;
+    void* userContextCallback2;
+    IOTHUB_CLIENT_WORKER_STATISTICS worker_statistics;
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t capacity = 1;
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_USER_CALLBACK_RING_CAPACITY, &capacity);
+
+    (void)IoTHubClientCore_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, CALLBACK_CONTEXT);
+    userContextCallback1 = g_userContextCallback;
+    (void)IoTHubClientCore_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback2, CALLBACK_CONTEXT2);
+    userContextCallback2 = g_userContextCallback;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(callback_ring_push(TEST_CALLBACK_RING_HANDLE, IGNORED_PTR_ARG)).SetReturn(MU_FAILURE);
+    STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)); /*the list is not empty, the ring is not tried*/
+    STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    g_eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, userContextCallback1);
+    g_eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, userContextCallback2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClientCore_GetWorkerStatistics(iothub_handle, &worker_statistics));
+    ASSERT_ARE_EQUAL(int, 2, (int)worker_statistics.overflowed_callbacks);
+    ASSERT_ARE_EQUAL(int, 0, (int)worker_statistics.dropped_callbacks);
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_callback_ring_overflowed_callbacks_are_dispatched_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t capacity = 1;
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_USER_CALLBACK_RING_CAPACITY, &capacity);
+    (void)IoTHubClientCore_SendEventAsync(iothub_handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, CALLBACK_CONTEXT);
+    STRICT_EXPECTED_CALL(callback_ring_push(TEST_CALLBACK_RING_HANDLE, IGNORED_PTR_ARG)).SetReturn(MU_FAILURE);
+    g_eventConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_OK, g_userContextCallback);
+    umock_c_reset_all_calls();
+
+    g_how_thread_loops = 1;
+
+    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_DoWork(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(callback_ring_get_count(TEST_CALLBACK_RING_HANDLE));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_move(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, CALLBACK_CONTEXT));
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    set_expected_calls_final_ScheduleWork_Thread_loop();
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_SetOption_CALLBACK_DISPATCH_THREADS_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    size_t thread_count = 2;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(dispatch_pool_create(thread_count, IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, iothub_handle));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SetOption(iothub_handle, OPTION_CALLBACK_DISPATCH_THREADS, &thread_count);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_SetOption_CALLBACK_DISPATCH_THREADS_after_start_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClientCore_SetDeviceMethodCallback(iothub_handle, test_method_callback, CALLBACK_CONTEXT);
+    umock_c_reset_all_calls();
+
+    size_t thread_count = 2;
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_SetOption(iothub_handle, OPTION_CALLBACK_DISPATCH_THREADS, &thread_count);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_Destroy_with_dispatch_pool_destroys_the_pool)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t thread_count = 2;
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_CALLBACK_DISPATCH_THREADS, &thread_count);
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubClientCore_Destroy(iothub_handle);
+
+    // assert
+    ASSERT_IS_NOT_NULL(strstr(umock_c_get_actual_calls(), "dispatch_pool_destroy("));
+}
+
+TEST_FUNCTION(IoTHubClientCore_GetCallbackDispatchStatistics_without_dispatch_pool_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_DISPATCH_STATISTICS dispatch_statistics;
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GetCallbackDispatchStatistics(iothub_handle, IOTHUB_CLIENT_CALLBACK_CATEGORY_MESSAGE, &dispatch_statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_GetCallbackDispatchStatistics_MESSAGE_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_DISPATCH_STATISTICS dispatch_statistics;
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t thread_count = 2;
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_CALLBACK_DISPATCH_THREADS, &thread_count);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(dispatch_pool_get_statistics(TEST_DISPATCH_POOL_HANDLE, IOTHUB_CLIENT_CALLBACK_CATEGORY_MESSAGE, IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GetCallbackDispatchStatistics(iothub_handle, IOTHUB_CLIENT_CALLBACK_CATEGORY_MESSAGE, &dispatch_statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 1, (int)dispatch_statistics.queue_depth);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CALLBACK_CATEGORY_MESSAGE + 1, (int)dispatch_statistics.max_queue_depth);
+    ASSERT_ARE_EQUAL(int, 2, (int)dispatch_statistics.dispatched_callbacks);
+    ASSERT_ARE_EQUAL(int, 10, (int)dispatch_statistics.total_latency_ms);
+    ASSERT_ARE_EQUAL(int, 5, (int)dispatch_statistics.max_latency_ms);
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_GetCallbackDispatchStatistics_INPUT_MESSAGE_sums_the_input_lanes_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_DISPATCH_STATISTICS dispatch_statistics;
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t thread_count = 2;
+    size_t lane;
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_CALLBACK_DISPATCH_THREADS, &thread_count);
+    umock_c_reset_all_calls();
+
+    for (lane = 0; lane < 4; lane++)
+    {
+        STRICT_EXPECTED_CALL(dispatch_pool_get_statistics(TEST_DISPATCH_POOL_HANDLE, IOTHUB_CLIENT_CALLBACK_CATEGORY_INPUT_MESSAGE + lane, IGNORED_PTR_ARG));
+    }
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GetCallbackDispatchStatistics(iothub_handle, IOTHUB_CLIENT_CALLBACK_CATEGORY_INPUT_MESSAGE, &dispatch_statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 4, (int)dispatch_statistics.queue_depth);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_CALLBACK_CATEGORY_INPUT_MESSAGE + 4, (int)dispatch_statistics.max_queue_depth);
+    ASSERT_ARE_EQUAL(int, 8, (int)dispatch_statistics.dispatched_callbacks);
+    ASSERT_ARE_EQUAL(int, 5, (int)dispatch_statistics.max_latency_ms);
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_GetWorkerStatistics_client_handle_NULL_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_WORKER_STATISTICS worker_statistics;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GetWorkerStatistics(NULL, &worker_statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubClientCore_GetWorkerStatistics_counts_polling_wakeups_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_WORKER_STATISTICS worker_statistics;
+    tickcounter_ms_t frequency = 20;
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_DO_WORK_FREQUENCY_IN_MS, &frequency);
+    (void)IoTHubClientCore_SetDeviceMethodCallback(iothub_handle, test_method_callback, CALLBACK_CONTEXT);
+    g_how_thread_loops = 1;
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    g_thread_func(g_thread_func_arg);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GetWorkerStatistics(iothub_handle, &worker_statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 1, (int)worker_statistics.do_work_calls);
+    ASSERT_ARE_EQUAL(int, 1, (int)worker_statistics.wakeups);
+    ASSERT_ARE_EQUAL(int, 1, (int)worker_statistics.timeout_wakeups);
+    ASSERT_ARE_EQUAL(int, 0, (int)worker_statistics.signaled_wakeups);
+    ASSERT_ARE_EQUAL(int, 20, (int)worker_statistics.idle_time_ms);
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
 TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_DO_WORK_FREQ_IN_MS_success)
 {
     
@@ -2647,6 +3152,128 @@ TEST_FUNCTION(IoTHubClientCore_GetTwinAsync_startWorkerThread_fail)
     umock_c_negative_tests_deinit();
 }
 
+TEST_FUNCTION(IoTHubClientCore_GetOption_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_MQTT_PUBLISH_STATISTICS statistics;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_GetOption(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, OPTION_MQTT_PUBLISH_STATISTICS, &statistics));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GetOption(iothub_handle, OPTION_MQTT_PUBLISH_STATISTICS, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_GetOption_NULL_arguments_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_MQTT_PUBLISH_STATISTICS statistics;
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result_1 = IoTHubClientCore_GetOption(NULL, OPTION_MQTT_PUBLISH_STATISTICS, &statistics);
+    IOTHUB_CLIENT_RESULT result_2 = IoTHubClientCore_GetOption(iothub_handle, NULL, &statistics);
+    IOTHUB_CLIENT_RESULT result_3 = IoTHubClientCore_GetOption(iothub_handle, OPTION_MQTT_PUBLISH_STATISTICS, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result_1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result_2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result_3);
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_GetOption_lock_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    IOTHUB_MQTT_PUBLISH_STATISTICS statistics;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GetOption(iothub_handle, OPTION_MQTT_PUBLISH_STATISTICS, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_GetCachedTwin_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    unsigned char* twin;
+    size_t size;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_GetCachedTwin(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, &twin, &size));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GetCachedTwin(iothub_handle, &twin, &size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
+TEST_FUNCTION(IoTHubClientCore_GetCachedTwin_NULL_handle_fail)
+{
+    // arrange
+    unsigned char* twin;
+    size_t size;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GetCachedTwin(NULL, &twin, &size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+}
+
+TEST_FUNCTION(IoTHubClientCore_GetCachedTwin_lock_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    unsigned char* twin;
+    size_t size;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClientCore_GetCachedTwin(iothub_handle, &twin, &size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+
+    // cleanup
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
 /* Tests_SRS_IOTHUBCLIENT_12_012: [ If iotHubClientHandle is NULL, IoTHubClientCore_SetDeviceMethodCallback shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
 TEST_FUNCTION(IoTHubClientCore_SetDeviceMethodCallback_iothub_fail)
 {
@@ -3533,6 +4160,47 @@ TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_succeed)
     IoTHubClientCore_Destroy(iothub_handle);
 }
 
+TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_method_callback_with_dispatch_pool_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CORE_HANDLE iothub_handle = IoTHubClientCore_Create(TEST_CLIENT_CONFIG);
+    size_t thread_count = 2;
+    (void)IoTHubClientCore_SetOption(iothub_handle, OPTION_CALLBACK_DISPATCH_THREADS, &thread_count);
+    (void)IoTHubClientCore_SetDeviceMethodCallback(iothub_handle, my_DeviceMethodCallback, CALLBACK_CONTEXT);
+    (void)g_inboundDeviceCallback(TEST_METHOD_NAME, TEST_DEVICE_METHOD_RESPONSE, TEST_DEVICE_RESP_LENGTH, TEST_METHOD_ID, g_userContextCallback);
+    umock_c_reset_all_calls();
+
+    g_how_thread_loops = 1;
+
+    set_expected_calls_first_ScheduleWork_Thread_loop(1);
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(dispatch_pool_submit(TEST_DISPATCH_POOL_HANDLE, IOTHUB_CLIENT_CALLBACK_CATEGORY_DEVICE_METHOD, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    set_expected_calls_final_ScheduleWork_Thread_loop();
+
+    // act
+    g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(my_DeviceMethodCallback(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG, IGNORED_NUM_ARG, CALLBACK_CONTEXT));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClientCore_LL_DeviceMethodResponse(TEST_IOTHUB_CLIENT_CORE_LL_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    g_dispatch_pool_function(g_dispatch_pool_context, g_dispatch_pool_record); /*what a pool thread does*/
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    IoTHubClientCore_Destroy(iothub_handle);
+}
+
 TEST_FUNCTION(IoTHubClient_ScheduleWork_Thread_repeated_method_callback_succeed)
 {
     // arrange
@@ -0,0 +1,227 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures the heap blocks held by a typical telemetry message and its clone, and the time taken to
+// create, clone and destroy one, then the same cycle for messages taken from an IoTHubMessagePool. Heap blocks are only counted when the shared utility is built with
+// memory tracing (memory_trace=ON, the default), otherwise they are reported as 0.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "iothub_message.h"
+
+#define MESSAGE_COUNT       1000
+#define ITERATION_COUNT     100
+#define POOL_CAPACITY       16
+
+static const unsigned char TELEMETRY_PAYLOAD[] = "{\"temperature\":21.5,\"humidity\":40.2,\"pressure\":1013}";
+
+static IOTHUB_MESSAGE_HANDLE create_telemetry_message(size_t index)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    char message_id[40];
+
+    (void)sprintf(message_id, "perf-message-%lu", (unsigned long)index);
+
+    if ((result = IoTHubMessage_CreateFromByteArray(TELEMETRY_PAYLOAD, sizeof(TELEMETRY_PAYLOAD) - 1)) == NULL)
+    {
+        (void)printf("IoTHubMessage_CreateFromByteArray failed\r\n");
+    }
+    else if (IoTHubMessage_SetMessageId(result, message_id) != IOTHUB_MESSAGE_OK ||
+        IoTHubMessage_SetCorrelationId(result, "perf-correlation") != IOTHUB_MESSAGE_OK ||
+        IoTHubMessage_SetContentTypeSystemProperty(result, "application%2fjson") != IOTHUB_MESSAGE_OK ||
+        IoTHubMessage_SetContentEncodingSystemProperty(result, "utf-8") != IOTHUB_MESSAGE_OK)
+    {
+        (void)printf("failed setting the system properties\r\n");
+        IoTHubMessage_Destroy(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static int measure_heap_blocks(IOTHUB_MESSAGE_HANDLE* messages, IOTHUB_MESSAGE_HANDLE* clones)
+{
+    int result = 0;
+    size_t i;
+    size_t blocks_before;
+    size_t blocks_after_create;
+    size_t blocks_after_clone;
+
+    blocks_before = gballoc_getAllocationCount();
+    for (i = 0; i < MESSAGE_COUNT && result == 0; i++)
+    {
+        if ((messages[i] = create_telemetry_message(i)) == NULL)
+        {
+            result = MU_FAILURE;
+        }
+    }
+    blocks_after_create = gballoc_getAllocationCount();
+
+    for (i = 0; i < MESSAGE_COUNT && result == 0; i++)
+    {
+        if ((clones[i] = IoTHubMessage_Clone(messages[i])) == NULL)
+        {
+            (void)printf("IoTHubMessage_Clone failed\r\n");
+            result = MU_FAILURE;
+        }
+    }
+    blocks_after_clone = gballoc_getAllocationCount();
+
+    if (result == 0)
+    {
+        (void)printf("heap blocks per message: %.2f\r\n", (double)(blocks_after_create - blocks_before) / MESSAGE_COUNT);
+        (void)printf("heap blocks per clone:   %.2f\r\n", (double)(blocks_after_clone - blocks_after_create) / MESSAGE_COUNT);
+    }
+
+    for (i = 0; i < MESSAGE_COUNT; i++)
+    {
+        IoTHubMessage_Destroy(clones[i]);
+        IoTHubMessage_Destroy(messages[i]);
+        clones[i] = NULL;
+        messages[i] = NULL;
+    }
+
+    return result;
+}
+
+static int measure_time(void)
+{
+    int result = 0;
+    size_t iteration;
+    clock_t start = clock();
+
+    for (iteration = 0; iteration < ITERATION_COUNT && result == 0; iteration++)
+    {
+        size_t i;
+        for (i = 0; i < MESSAGE_COUNT && result == 0; i++)
+        {
+            IOTHUB_MESSAGE_HANDLE message = create_telemetry_message(i);
+            IOTHUB_MESSAGE_HANDLE clone;
+
+            if (message == NULL)
+            {
+                result = MU_FAILURE;
+            }
+            else
+            {
+                if ((clone = IoTHubMessage_Clone(message)) == NULL)
+                {
+                    (void)printf("IoTHubMessage_Clone failed\r\n");
+                    result = MU_FAILURE;
+                }
+                IoTHubMessage_Destroy(clone);
+                IoTHubMessage_Destroy(message);
+            }
+        }
+    }
+
+    if (result == 0)
+    {
+        double elapsed_ns = ((double)(clock() - start) / CLOCKS_PER_SEC) * 1e9;
+        (void)printf("create+clone+destroy:    %.0f ns per message\r\n", elapsed_ns / ((double)ITERATION_COUNT * MESSAGE_COUNT));
+    }
+
+    return result;
+}
+
+static int measure_pool(void)
+{
+    int result = 0;
+    size_t iteration;
+    size_t blocks_before;
+    clock_t start;
+    IOTHUB_MESSAGE_POOL_STATISTICS statistics;
+    IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(POOL_CAPACITY, sizeof(TELEMETRY_PAYLOAD), 4);
+
+    if (pool == NULL)
+    {
+        (void)printf("IoTHubMessagePool_Create failed\r\n");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        blocks_before = gballoc_getAllocationCount();
+        start = clock();
+
+        for (iteration = 0; iteration < ITERATION_COUNT && result == 0; iteration++)
+        {
+            size_t i;
+            for (i = 0; i < MESSAGE_COUNT && result == 0; i++)
+            {
+                IOTHUB_MESSAGE_HANDLE message;
+                char message_id[40];
+
+                (void)sprintf(message_id, "perf-message-%lu", (unsigned long)i);
+
+                if ((message = IoTHubMessagePool_Acquire(pool, TELEMETRY_PAYLOAD, sizeof(TELEMETRY_PAYLOAD) - 1)) == NULL)
+                {
+                    (void)printf("IoTHubMessagePool_Acquire failed\r\n");
+                    result = MU_FAILURE;
+                }
+                else
+                {
+                    if (IoTHubMessage_SetMessageId(message, message_id) != IOTHUB_MESSAGE_OK ||
+                        IoTHubMessage_SetCorrelationId(message, "perf-correlation") != IOTHUB_MESSAGE_OK ||
+                        IoTHubMessage_SetContentTypeSystemProperty(message, "application%2fjson") != IOTHUB_MESSAGE_OK ||
+                        IoTHubMessage_SetContentEncodingSystemProperty(message, "utf-8") != IOTHUB_MESSAGE_OK)
+                    {
+                        (void)printf("failed setting the system properties\r\n");
+                        result = MU_FAILURE;
+                    }
+                    IoTHubMessage_Destroy(message);
+                }
+            }
+        }
+
+        if (result == 0 && IoTHubMessagePool_GetStatistics(pool, &statistics) == IOTHUB_MESSAGE_OK)
+        {
+            double elapsed_ns = ((double)(clock() - start) / CLOCKS_PER_SEC) * 1e9;
+            (void)printf("pooled acquire+destroy:  %.0f ns per message\r\n", elapsed_ns / ((double)ITERATION_COUNT * MESSAGE_COUNT));
+            (void)printf("pooled heap blocks left: %lu\r\n", (unsigned long)(gballoc_getAllocationCount() - blocks_before));
+            (void)printf("pool hits/misses:        %lu/%lu\r\n", (unsigned long)statistics.hits, (unsigned long)statistics.misses);
+        }
+
+        IoTHubMessagePool_Destroy(pool);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result;
+    IOTHUB_MESSAGE_HANDLE* messages = (IOTHUB_MESSAGE_HANDLE*)calloc(MESSAGE_COUNT, sizeof(IOTHUB_MESSAGE_HANDLE));
+    IOTHUB_MESSAGE_HANDLE* clones = (IOTHUB_MESSAGE_HANDLE*)calloc(MESSAGE_COUNT, sizeof(IOTHUB_MESSAGE_HANDLE));
+
+    if (messages == NULL || clones == NULL)
+    {
+        (void)printf("failed allocating the message tables\r\n");
+        result = MU_FAILURE;
+    }
+    else if (gballoc_init() != 0)
+    {
+        (void)printf("gballoc_init failed\r\n");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        result = measure_heap_blocks(messages, clones);
+        if (result == 0)
+        {
+            result = measure_time();
+        }
+        if (result == 0)
+        {
+            result = measure_pool();
+        }
+        gballoc_deinit();
+    }
+
+    free(clones);
+    free(messages);
+
+    return result;
+}
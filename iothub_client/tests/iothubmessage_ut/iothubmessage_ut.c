@@ -62,6 +62,10 @@ extern "C" {
 static MAP_FILTER_CALLBACK g_mapFilterFunc;
 
 static const unsigned char c[1] = { '3' };
+/*larger than what the message keeps inline, so it goes to a BUFFER*/
+static unsigned char c_large[1024];
+/*longer than what the message keeps inline, so it is copied to the heap*/
+static char TEST_LONG_STRING_VALUE[512];
 static const char* TEST_MESSAGE_ID = "3820ADAE-E3CA-4065-843A-A6BDE950D8DC";
 static const char* TEST_MESSAGE_ID2 = "052BA01A-ECBF-48CF-BC7B-64B315D898B7";
 static const char* TEST_STRING_VALUE = "aaaa";
@@ -104,6 +108,17 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
     ASSERT_FAIL("umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
 }
 
+static size_t g_buffer_free_call_count;
+static const unsigned char* g_buffer_free_buffer;
+static void* g_buffer_free_context;
+
+static void test_buffer_free_callback(const unsigned char* buffer, void* userContext)
+{
+    g_buffer_free_call_count++;
+    g_buffer_free_buffer = buffer;
+    g_buffer_free_context = userContext;
+}
+
 static MAP_HANDLE my_Map_Create(MAP_FILTER_CALLBACK mapFilterFunc)
 {
     g_mapFilterFunc = mapFilterFunc;
@@ -121,6 +136,30 @@ static void my_Map_Destroy(MAP_HANDLE handle)
     my_gballoc_free(handle);
 }
 
+static const char* g_map_keys[] = { "k1", "k2", "k3" };
+static const char* g_map_values[] = { "v1", "v2", "v3" };
+static size_t g_map_count;
+
+static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys, const char*const** values, size_t* count)
+{
+    (void)handle;
+    *keys = g_map_keys;
+    *values = g_map_values;
+    *count = g_map_count;
+    return MAP_OK;
+}
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    my_gballoc_free(handle);
+    return LOCK_OK;
+}
+
 static int my_mallocAndStrcpy_s(char** destination, const char* source)
 {
     *destination = (char*)my_gballoc_malloc(strlen(source)+1);
@@ -184,8 +223,6 @@ static void set_string_succeeds_impl(PFN_MESSAGE_SET_STRING pfnSetMessageString,
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, test_value));
-
     //act
     IOTHUB_MESSAGE_RESULT result = pfnSetMessageString(h, test_value);
 
@@ -204,9 +241,6 @@ static void set_string_string_already_allocated_succeeds_impl(PFN_MESSAGE_SET_ST
     IOTHUB_MESSAGE_RESULT result = pfnSetMessageString(h, test_value);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, test_value));
-
     //act
     result = pfnSetMessageString(h, test_value);
 
@@ -256,6 +290,16 @@ static void get_string_succeeds_impl(PFN_MESSAGE_SET_STRING pfnSetMessageString,
     IoTHubMessage_Destroy(h);
 }
 
+static void expect_free_of_unset_message_strings(void)
+{
+    size_t i;
+    /*the 10 system property strings and the diagnostic data*/
+    for (i = 0; i < 11; i++)
+    {
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    }
+}
+
 static TEST_MUTEX_HANDLE g_testByTest;
 
 BEGIN_TEST_SUITE(iothubmessage_ut)
@@ -267,6 +311,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     g_testByTest = TEST_MUTEX_CREATE();
     ASSERT_IS_NOT_NULL(g_testByTest);
 
+    (void)memset(TEST_LONG_STRING_VALUE, 'a', sizeof(TEST_LONG_STRING_VALUE) - 1);
+
     (void)umock_c_init(on_umock_c_error);
 
     result = umocktypes_charptr_register_types();
@@ -279,6 +325,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -306,6 +354,11 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(Map_AddOrUpdate, MAP_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_AddOrUpdate, MAP_ERROR);
     REGISTER_GLOBAL_MOCK_RETURN(Map_ContainsKey, MAP_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_GetInternals, my_Map_GetInternals);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
 
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, MU_FAILURE);
@@ -321,6 +374,10 @@ TEST_SUITE_CLEANUP(suite_cleanup)
 static void reset_test_data()
 {
     g_mapFilterFunc = NULL;
+    g_buffer_free_call_count = 0;
+    g_buffer_free_buffer = NULL;
+    g_buffer_free_context = NULL;
+    g_map_count = 0;
 }
 
 TEST_FUNCTION_INITIALIZE(method_init)
@@ -348,11 +405,11 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_happy_path)
 {
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
+    STRICT_EXPECTED_CALL(BUFFER_create(c_large, sizeof(c_large)));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c_large, sizeof(c_large));
 
     //assert
     ASSERT_IS_NOT_NULL(h);
@@ -383,7 +440,6 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_succeeds_when_size_0_and_buffer_
 {
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
@@ -402,7 +458,6 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_succeeds_when_size_0_and_buffer_
 {
     //arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
@@ -424,7 +479,7 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_fails)
 
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
+    STRICT_EXPECTED_CALL(BUFFER_create(c_large, sizeof(c_large)));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
@@ -439,7 +494,7 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_fails)
         char tmp_msg[64];
         sprintf(tmp_msg, "IoTHubMessage_CreateFromByteArray failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
 
-        IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+        IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c_large, sizeof(c_large));
 
         //assert
         ASSERT_IS_NULL(h, tmp_msg);
@@ -449,6 +504,230 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_fails)
     umock_c_negative_tests_deinit();
 }
 
+TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_keeps_a_small_payload_inline)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_GetByteArray_returns_an_inline_payload)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    const unsigned char* byteArray;
+    size_t size;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
+    ASSERT_ARE_EQUAL(uint8_t, c[0], byteArray[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_Destroy_frees_a_message_with_inline_payload_and_strings_at_once)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
+    (void)IoTHubMessage_SetCorrelationId(h, TEST_MESSAGE_ID2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); /*contentType*/
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); /*contentEncoding*/
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); /*diagnosticData*/
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); /*outputName*/
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); /*inputName*/
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); /*connectionModuleId*/
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); /*connectionDeviceId*/
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); /*creationTimeUtc*/
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); /*userId*/
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubMessage_Clone_copies_a_small_message_in_one_allocation)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
+    (void)IoTHubMessage_SetCorrelationId(h, TEST_MESSAGE_ID2);
+    (void)IoTHubMessage_SetContentTypeSystemProperty(h, TEST_CONTENT_TYPE);
+    (void)IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_CONTENT_ENCODING);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetMessageId(r));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID2, IoTHubMessage_GetCorrelationId(r));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CONTENT_TYPE, IoTHubMessage_GetContentTypeSystemProperty(r));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CONTENT_ENCODING, IoTHubMessage_GetContentEncodingSystemProperty(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_Clone_gives_long_strings_room_in_the_clone)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_LONG_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_LONG_STRING_VALUE, IoTHubMessage_GetMessageId(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_CreateFromBuffer_with_NULL_buffer_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBuffer(NULL, 1, test_buffer_free_callback, NULL);
+
+    //assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubMessage_CreateFromBuffer_does_not_copy_the_buffer)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBuffer(c, 1, test_buffer_free_callback, (void*)0x4242);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_buffer_free_call_count);
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_CreateFromBuffer_fails_when_Map_Create_fails_and_keeps_the_buffer)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBuffer(c, 1, test_buffer_free_callback, NULL);
+
+    //assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(size_t, 0, g_buffer_free_call_count);
+}
+
+TEST_FUNCTION(IoTHubMessage_GetByteArray_returns_the_application_buffer)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBuffer(c, 1, test_buffer_free_callback, NULL);
+    const unsigned char* byteArray;
+    size_t size;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)byteArray);
+    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_Destroy_gives_the_application_buffer_back)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBuffer(c, 1, test_buffer_free_callback, (void*)0x4242);
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_buffer_free_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)g_buffer_free_buffer);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x4242, g_buffer_free_context);
+}
+
+TEST_FUNCTION(IoTHubMessage_Clone_of_an_application_buffer_copies_the_buffer)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromBuffer(c_large, sizeof(c_large), test_buffer_free_callback, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_create(c_large, sizeof(c_large)));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    ASSERT_ARE_EQUAL(size_t, 0, g_buffer_free_call_count);
+    IoTHubMessage_Destroy(h);
+    ASSERT_ARE_EQUAL(size_t, 1, g_buffer_free_call_count);
+}
+
 /*Tests_SRS_IOTHUBMESSAGE_02_027: [IoTHubMessage_CreateFromString shall call STRING_construct passing source as parameter.] */
 /*Tests_SRS_IOTHUBMESSAGE_02_028: [IoTHubMessage_CreateFromString shall call Map_Create to create the message properties.] */
 /*Tests_SRS_IOTHUBMESSAGE_02_031: [Otherwise, IoTHubMessage_CreateFromString shall return a non-NULL handle.] */
@@ -590,7 +869,7 @@ TEST_FUNCTION(IoTHubMessage_Destroy_With_NULL_handle_does_nothing)
 TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_BYTEARRAY_IoTHubMEssage)
 {
     // arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c_large, sizeof(c_large));
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
@@ -654,7 +933,7 @@ TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_STRING_IoTHubMessage)
 TEST_FUNCTION(IoTHubMessage_GetByteArray_happy_path)
 {
     //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c_large, sizeof(c_large));
     const unsigned char* byteArray;
     size_t size;
     umock_c_reset_all_calls();
@@ -667,8 +946,8 @@ TEST_FUNCTION(IoTHubMessage_GetByteArray_happy_path)
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
-    ASSERT_ARE_EQUAL(uint8_t, c[0], byteArray[0]);
-    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_ARE_EQUAL(uint8_t, c_large[0], byteArray[0]);
+    ASSERT_ARE_EQUAL(size_t, sizeof(c_large), size);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     ///cleanup
@@ -738,9 +1017,10 @@ TEST_FUNCTION(IoTHubMessage_GetByteArray_with_STRING_fails)
 TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_happy_path)
 {
     //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c_large, sizeof(c_large));
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
@@ -776,12 +1056,14 @@ TEST_FUNCTION(IoTHubMessage_Clone_handle_NULL_fail)
 TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_fails)
 {
     //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c_large, sizeof(c_large));
     umock_c_reset_all_calls();
 
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG))
+        .CallCannotFail();
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
@@ -792,16 +1074,19 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_fails)
     size_t count = umock_c_negative_tests_call_count();
     for (size_t index = 0; index < count; index++)
     {
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(index);
+        if (umock_c_negative_tests_can_call_fail(index))
+        {
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
 
-        char tmp_msg[64];
-        sprintf(tmp_msg, "IoTHubMessage_Clone failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+            char tmp_msg[64];
+            sprintf(tmp_msg, "IoTHubMessage_Clone failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
 
-        IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+            IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
 
-        //assert
-        ASSERT_IS_NULL(r, tmp_msg);
+            //assert
+            ASSERT_IS_NULL(r, tmp_msg);
+        }
     }
 
     //cleanup
@@ -1014,8 +1299,6 @@ TEST_FUNCTION(IoTHubMessage_SetMessageId_SUCCEED)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
 
@@ -1035,15 +1318,96 @@ TEST_FUNCTION(IoTHubMessage_SetMessageId_MessageId_Not_NULL_SUCCEED)
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
     umock_c_reset_all_calls();
 
+    //act
+    result = IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID2, IoTHubMessage_GetMessageId(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_SetMessageId_long_value_is_copied_to_the_heap)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_LONG_STRING_VALUE));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(h, TEST_LONG_STRING_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_LONG_STRING_VALUE, IoTHubMessage_GetMessageId(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_SetMessageId_frees_a_previous_long_value)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_LONG_STRING_VALUE);
+    umock_c_reset_all_calls();
+
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID2));
 
     //act
-    result = IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID2);
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetMessageId(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/* Tests_SRS_IOTHUBMESSAGE_07_014: [If the allocation or the copying of the messageId fails, then IoTHubMessage_SetMessageId shall return IOTHUB_MESSAGE_ERROR.] */
+TEST_FUNCTION(IoTHubMessage_SetMessageId_fails_when_a_long_value_cannot_be_copied)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_LONG_STRING_VALUE))
+        .SetReturn(MU_FAILURE);
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(h, TEST_LONG_STRING_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_SetMessageId_reuses_the_inline_storage)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    size_t i;
+    umock_c_reset_all_calls();
+
+    //act
+    for (i = 0; i < 100; i++)
+    {
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_SetMessageId(h, ((i % 2) == 0) ? TEST_MESSAGE_ID : TEST_MESSAGE_ID2));
+    }
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID2, IoTHubMessage_GetMessageId(h));
 
     //cleanup
     IoTHubMessage_Destroy(h);
@@ -1179,8 +1543,6 @@ TEST_FUNCTION(IoTHubMessage_SetCorrelationId_SUCCEED)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetCorrelationId(h, TEST_MESSAGE_ID);
 
@@ -1200,9 +1562,6 @@ TEST_FUNCTION(IoTHubMessage_SetCorrelationId_CorrelationId_Not_NULL_SUCCEED)
     (void)IoTHubMessage_SetCorrelationId(h, TEST_MESSAGE_ID);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID2));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetCorrelationId(h, TEST_MESSAGE_ID2);
 
@@ -1221,8 +1580,6 @@ TEST_FUNCTION(IoTHubMessage_SetContentTypeSystemProperty_SUCCEED)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_TYPE));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentTypeSystemProperty(h, TEST_CONTENT_TYPE);
 
@@ -1242,9 +1599,6 @@ TEST_FUNCTION(IoTHubMessage_SetContentTypeSystemProperty_Not_NULL_SUCCEED)
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentTypeSystemProperty(h, TEST_CONTENT_TYPE);
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_TYPE));
-
     //act
     result = IoTHubMessage_SetContentTypeSystemProperty(h, TEST_CONTENT_TYPE);
 
@@ -1300,7 +1654,7 @@ TEST_FUNCTION(IoTHubMessage_SetContentTypeSystemProperty_Fails)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_TYPE));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_LONG_STRING_VALUE));
     umock_c_negative_tests_snapshot();
 
     //act
@@ -1314,7 +1668,7 @@ TEST_FUNCTION(IoTHubMessage_SetContentTypeSystemProperty_Fails)
         sprintf(tmp_msg, "Failed in test %lu/%lu", (unsigned long)index, (unsigned long)count);
 
         //act
-        IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentTypeSystemProperty(h, TEST_CONTENT_TYPE);
+        IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentTypeSystemProperty(h, TEST_LONG_STRING_VALUE);
 
         //assert
         ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result, tmp_msg);
@@ -1332,8 +1686,6 @@ TEST_FUNCTION(IoTHubMessage_SetContentEncodingSystemProperty_SUCCEED)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_ENCODING));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_CONTENT_ENCODING);
 
@@ -1353,8 +1705,6 @@ TEST_FUNCTION(IoTHubMessage_SetContentEncodingSystemProperty_Not_NULL_SUCCEED)
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_CONTENT_ENCODING);
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_ENCODING));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     //act
     result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_CONTENT_ENCODING);
@@ -1411,7 +1761,7 @@ TEST_FUNCTION(IoTHubMessage_SetContentEncodingSystemProperty_Fails)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CONTENT_ENCODING));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_LONG_STRING_VALUE));
     umock_c_negative_tests_snapshot();
 
     //act
@@ -1425,7 +1775,7 @@ TEST_FUNCTION(IoTHubMessage_SetContentEncodingSystemProperty_Fails)
         sprintf(tmp_msg, "Failed in test %lu/%lu", (unsigned long)index, (unsigned long)count);
 
         //act
-        IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_CONTENT_ENCODING);
+        IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_LONG_STRING_VALUE);
 
         //assert
         ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result, tmp_msg);
@@ -1436,6 +1786,29 @@ TEST_FUNCTION(IoTHubMessage_SetContentEncodingSystemProperty_Fails)
     IoTHubMessage_Destroy(h);
 }
 
+// Tests_SRS_IOTHUBMESSAGE_09_008: [If the allocation or the copying of `contentEncoding` fails, then IoTHubMessage_SetContentEncodingSystemProperty shall return IOTHUB_MESSAGE_ERROR.]
+TEST_FUNCTION(IoTHubMessage_SetContentEncodingSystemProperty_copy_fails_keeps_previous_value)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_CONTENT_ENCODING);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_LONG_STRING_VALUE))
+        .SetReturn(MU_FAILURE);
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetContentEncodingSystemProperty(h, TEST_LONG_STRING_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CONTENT_ENCODING, IoTHubMessage_GetContentEncodingSystemProperty(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
 // Tests_SRS_IOTHUBMESSAGE_09_006: [IoTHubMessage_GetContentTypeSystemProperty shall return the `contentType` as a const char* ]
 TEST_FUNCTION(IoTHubMessage_GetContentTypeSystemProperty_SUCCEED)
 {
@@ -2113,8 +2486,6 @@ TEST_FUNCTION(IoTHubMessage_SetAsSecurityMessage_Succeed)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetAsSecurityMessage(h);
 
@@ -2255,4 +2626,313 @@ TEST_FUNCTION(IoTHubMessage_GetUserIdSystemProperty_SUCCEED)
     get_string_succeeds_impl(IoTHubMessage_SetMessageUserIdSystemProperty, IoTHubMessage_GetMessageUserIdSystemProperty, TEST_MESSAGE_USER_ID);
 }
 
+TEST_FUNCTION(IoTHubMessagePool_Create_with_0_capacity_fails)
+{
+    //act
+    IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(0, 16, 2);
+
+    //assert
+    ASSERT_IS_NULL(pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubMessagePool_Create_allocates_the_messages_up_front)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(2, 16, 2);
+
+    //assert
+    ASSERT_IS_NOT_NULL(pool);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessagePool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubMessagePool_Create_fails)
+{
+    //arrange
+    size_t i;
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessagePool_Create failure in test %lu", (unsigned long)i);
+
+        //act
+        IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(1, 16, 2);
+
+        //assert
+        ASSERT_IS_NULL(pool, tmp_msg);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+}
+
+TEST_FUNCTION(IoTHubMessagePool_Acquire_with_NULL_pool_fails)
+{
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessagePool_Acquire(NULL, c, 1);
+
+    //assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubMessagePool_Acquire_takes_a_free_message_without_allocating)
+{
+    //arrange
+    IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(1, 16, 2);
+    const unsigned char* payload;
+    size_t size;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessagePool_Acquire(pool, c, 1);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(h, &payload, &size));
+    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(payload, c, 1));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+    IoTHubMessagePool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubMessage_Destroy_gives_a_pooled_message_back_to_its_pool)
+{
+    //arrange
+    IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(1, 16, 2);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessagePool_Acquire(pool, c, 1);
+    IOTHUB_MESSAGE_HANDLE h2;
+    IOTHUB_MESSAGE_POOL_STATISTICS statistics;
+    (void)IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
+    (void)IoTHubMessage_SetCorrelationId(h, TEST_MESSAGE_ID2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    h2 = IoTHubMessagePool_Acquire(pool, c, 1);
+    ASSERT_ARE_EQUAL(void_ptr, h, h2);
+    ASSERT_IS_NULL(IoTHubMessage_GetMessageId(h2));
+    ASSERT_IS_NULL(IoTHubMessage_GetCorrelationId(h2));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessagePool_GetStatistics(pool, &statistics));
+    ASSERT_ARE_EQUAL(size_t, 2, statistics.hits);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.misses);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.inUse);
+
+    //cleanup
+    IoTHubMessage_Destroy(h2);
+    IoTHubMessagePool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubMessagePool_Release_clears_the_properties_of_the_message)
+{
+    //arrange
+    IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(1, 16, 2);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessagePool_Acquire(pool, c, 1);
+    g_map_count = 2;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessagePool_Release(pool, h);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessagePool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubMessagePool_Release_discards_the_message_when_clearing_the_properties_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(1, 16, 2);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessagePool_Acquire(pool, c, 1);
+    IOTHUB_MESSAGE_POOL_STATISTICS statistics;
+    g_map_count = 2;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    expect_free_of_unset_message_strings();
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessagePool_Release(pool, h);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessagePool_GetStatistics(pool, &statistics));
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.discarded);
+
+    //cleanup
+    IoTHubMessagePool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubMessagePool_Release_discards_a_message_with_too_many_properties)
+{
+    //arrange
+    IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(1, 16, 2);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessagePool_Acquire(pool, c, 1);
+    IOTHUB_MESSAGE_HANDLE h2;
+    IOTHUB_MESSAGE_POOL_STATISTICS statistics;
+    g_map_count = 3;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    expect_free_of_unset_message_strings();
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessagePool_Release(pool, h);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    /*the pool replaces the discarded message on the next acquire*/
+    g_map_count = 0;
+    h2 = IoTHubMessagePool_Acquire(pool, c, 1);
+    ASSERT_IS_NOT_NULL(h2);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessagePool_GetStatistics(pool, &statistics));
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.hits);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.misses);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.discarded);
+
+    //cleanup
+    IoTHubMessage_Destroy(h2);
+    IoTHubMessagePool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubMessagePool_Acquire_a_payload_larger_than_maxPayloadSize_gives_a_regular_message)
+{
+    //arrange
+    IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(1, 16, 2);
+    IOTHUB_MESSAGE_POOL_STATISTICS statistics;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_create(c_large, sizeof(c_large)));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessagePool_Acquire(pool, c_large, sizeof(c_large));
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessagePool_GetStatistics(pool, &statistics));
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.hits);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.misses);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.inUse);
+
+    //cleanup
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessagePool_Release(pool, h));
+    IoTHubMessagePool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubMessagePool_Release_a_message_of_another_pool_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(1, 16, 2);
+    IOTHUB_MESSAGE_POOL_HANDLE pool2 = IoTHubMessagePool_Create(1, 16, 2);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessagePool_Acquire(pool, c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessagePool_Release(pool2, h);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+    IoTHubMessagePool_Destroy(pool2);
+    IoTHubMessagePool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubMessagePool_Destroy_keeps_the_pool_until_the_last_message_is_released)
+{
+    //arrange
+    IOTHUB_MESSAGE_POOL_HANDLE pool = IoTHubMessagePool_Create(1, 16, 2);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessagePool_Acquire(pool, c, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubMessagePool_Destroy(pool);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    expect_free_of_unset_message_strings();
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(pool));
+
+    IoTHubMessage_Destroy(h);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 END_TEST_SUITE(iothubmessage_ut)
@@ -88,6 +88,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RETRY_POLICY, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CALLBACK_CATEGORY, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_REPORTED_STATE_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC, void*);
@@ -99,12 +100,16 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_CreateFromConnectionString, TEST_IOTHUB_CLIENT_CORE_HANDLE);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_SendEventAsync, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_SendEventAsyncMove, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_GetSendStatus, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_SetConnectionStatusCallback, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_SetRetryPolicy, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_GetRetryPolicy, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_GetLastMessageReceiveTime, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_GetWorkerStatistics, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_GetCallbackDispatchStatistics, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_SetOption, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_GetOption, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_SetDeviceTwinCallback, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_SendReportedState, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_SetDeviceMethodCallback, IOTHUB_CLIENT_OK);
@@ -113,6 +118,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_SendEventToOutputAsync, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_SetInputMessageCallback, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_GetTwinAsync, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClientCore_GetCachedTwin, IOTHUB_CLIENT_OK);
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -159,6 +165,19 @@ TEST_FUNCTION(IoTHubModuleClient_SendEventAsync_Test)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+TEST_FUNCTION(IoTHubModuleClient_SendEventAsyncMove_Test)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(IoTHubClientCore_SendEventAsyncMove(TEST_IOTHUB_CLIENT_CORE_HANDLE, TEST_MESSAGE_HANDLE, TEST_EVENT_CONFIRMATION_CALLBACK, NULL));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubModuleClient_SendEventAsyncMove(TEST_IOTHUB_MODULE_CLIENT_HANDLE, TEST_MESSAGE_HANDLE, TEST_EVENT_CONFIRMATION_CALLBACK, NULL);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 TEST_FUNCTION(IoTHubModuleClient_GetSendStatus_Test)
 {
     //arrange
@@ -241,6 +260,34 @@ TEST_FUNCTION(IoTHubModuleClient_GetLastMessageReceiveTime_Test)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+TEST_FUNCTION(IoTHubModuleClient_GetWorkerStatistics_Test)
+{
+    //arrange
+    IOTHUB_CLIENT_WORKER_STATISTICS worker_statistics;
+    STRICT_EXPECTED_CALL(IoTHubClientCore_GetWorkerStatistics(TEST_IOTHUB_CLIENT_CORE_HANDLE, &worker_statistics));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubModuleClient_GetWorkerStatistics(TEST_IOTHUB_MODULE_CLIENT_HANDLE, &worker_statistics);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubModuleClient_GetCallbackDispatchStatistics_Test)
+{
+    //arrange
+    IOTHUB_CLIENT_CALLBACK_DISPATCH_STATISTICS dispatch_statistics;
+    STRICT_EXPECTED_CALL(IoTHubClientCore_GetCallbackDispatchStatistics(TEST_IOTHUB_CLIENT_CORE_HANDLE, IOTHUB_CLIENT_CALLBACK_CATEGORY_DEVICE_METHOD, &dispatch_statistics));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubModuleClient_GetCallbackDispatchStatistics(TEST_IOTHUB_MODULE_CLIENT_HANDLE, IOTHUB_CLIENT_CALLBACK_CATEGORY_DEVICE_METHOD, &dispatch_statistics);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 TEST_FUNCTION(IoTHubModuleClient_SetOption_Test)
 {
     //arrange
@@ -254,6 +301,20 @@ TEST_FUNCTION(IoTHubModuleClient_SetOption_Test)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+TEST_FUNCTION(IoTHubModuleClient_GetOption_Test)
+{
+    //arrange
+    size_t value;
+    STRICT_EXPECTED_CALL(IoTHubClientCore_GetOption(TEST_IOTHUB_CLIENT_CORE_HANDLE, TEST_OPTION, &value));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubModuleClient_GetOption(TEST_IOTHUB_MODULE_CLIENT_HANDLE, TEST_OPTION, &value);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 TEST_FUNCTION(IoTHubModuleClient_SetModuleTwinCallback_Test)
 {
     //arrange
@@ -293,6 +354,21 @@ TEST_FUNCTION(IoTHubModuleClient_GetTwinAsync_Test)
     ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
 }
 
+TEST_FUNCTION(IoTHubModuleClient_GetCachedTwin_Test)
+{
+    //arrange
+    unsigned char* twin;
+    size_t size;
+    STRICT_EXPECTED_CALL(IoTHubClientCore_GetCachedTwin(TEST_IOTHUB_CLIENT_CORE_HANDLE, &twin, &size));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubModuleClient_GetCachedTwin(TEST_IOTHUB_MODULE_CLIENT_HANDLE, &twin, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
+}
+
 TEST_FUNCTION(IoTHubModuleClient_SetModuleMethodCallback_Test)
 {
     //arrange
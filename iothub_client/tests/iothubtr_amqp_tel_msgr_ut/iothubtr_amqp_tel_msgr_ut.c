@@ -151,6 +151,7 @@ static SINGLYLINKEDLIST_HANDLE TEST_IN_PROGRESS_LIST;
 #define TEST_CALLBACK_LIST1                               (SINGLYLINKEDLIST_HANDLE)0x4486
 #define INDEFINITE_TIME                                   ((time_t)-1)
 #define TEST_DISPOSITION_AMQP_VALUE                       (AMQP_VALUE)0x4487
+#define TEST_TICK_COUNTER_HANDLE                          (TICK_COUNTER_HANDLE)0x4488
 
 static delivery_number TEST_DELIVERY_NUMBER;
 
@@ -460,10 +461,12 @@ static MESSENGER_DO_WORK_EXP_CALL_PROFILE* get_msgr_do_work_exp_call_profile(TEL
     return &g_do_work_profile;
 }
 
-static int TEST_message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+static int TEST_message_encode_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, unsigned char** scratch_buffer, size_t* scratch_buffer_size, BINARY_DATA* body_binary_data)
 {
     (void)message_batch_container;
     (void)message_handle;
+    (void)scratch_buffer;
+    (void)scratch_buffer_size;
     (void)body_binary_data;
     return 0;
 }
@@ -1329,7 +1332,7 @@ static SEND_PENDING_EVENTS_TEST_CONFIG test_send_middle_message_too_big_and_roll
 
 
 //
-//  We fail call to message_create_uamqp_encoding_from_iothub_message
+//  We fail call to message_encode_uamqp_encoding_from_iothub_message
 //
 static SEND_PENDING_TEST_EVENTS test_create_message_failure_events[] = {
     { 10,  SEND_PENDING_EXPECT_CREATE_MESSAGE_FAILURE  },
@@ -1365,7 +1368,7 @@ static void set_expected_calls_for_message_do_work_send_pending_events(SEND_PEND
     for (i = 0; i < test_config->number_test_events; i++)
     {
         const SEND_PENDING_EXPECTED_ACTION expected_action = test_config->test_events[i].expected_action;
-        const int message_create_uamqp_encoding_from_iothub_message_return = (expected_action == SEND_PENDING_EXPECT_CREATE_MESSAGE_FAILURE) ? 1 : 0;
+        const int message_encode_uamqp_encoding_from_iothub_message_return = (expected_action == SEND_PENDING_EXPECT_CREATE_MESSAGE_FAILURE) ? 1 : 0;
 
         STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
         STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
@@ -1383,8 +1386,8 @@ static void set_expected_calls_for_message_do_work_send_pending_events(SEND_PEND
 
         TEST_amqp_data.length = test_config->test_events[i].number_bytes_encoded;
 
-        STRICT_EXPECTED_CALL(message_create_uamqp_encoding_from_iothub_message(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer(3, &TEST_amqp_data, sizeof(TEST_amqp_data)).SetReturn(message_create_uamqp_encoding_from_iothub_message_return);
+        STRICT_EXPECTED_CALL(message_encode_uamqp_encoding_from_iothub_message(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(5, &TEST_amqp_data, sizeof(TEST_amqp_data)).SetReturn(message_encode_uamqp_encoding_from_iothub_message_return);
 
         if ((SEND_PENDING_EXPECT_ERROR_TOO_LARGE == expected_action) || (SEND_PENDING_EXPECT_CREATE_MESSAGE_FAILURE == expected_action))
         {
@@ -1449,25 +1452,14 @@ static time_t add_seconds(time_t base_time, int seconds)
 
 static void set_expected_calls_for_process_event_send_timeouts(size_t in_progress_list_length, size_t send_event_timeout_secs, time_t current_time)
 {
-    if (in_progress_list_length <= 0)
-    {
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST)).SetReturn(NULL);
-    }
-    else
-    {
-        time_t send_time = add_seconds(current_time, -1 * (int)send_event_timeout_secs);
-
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_IN_PROGRESS_LIST));
-
-        for (; in_progress_list_length > 0; in_progress_list_length--)
-        {
-            EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-            STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
-            EXPECTED_CALL(get_difftime(current_time, send_time)).SetReturn(difftime(current_time, send_time));
-            EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
-        }
+    // Only the events sent (and not timed out) are looked at, oldest first; here all of them time out.
+    time_t send_time = add_seconds(current_time, -1 * (int)send_event_timeout_secs);
 
-        EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG)).SetReturn(NULL);
+    for (; in_progress_list_length > 0; in_progress_list_length--)
+    {
+        STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+        EXPECTED_CALL(get_difftime(current_time, send_time)).SetReturn(difftime(current_time, send_time));
+        EXPECTED_CALL(singlylinkedlist_foreach(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     }
 }
 
@@ -1808,6 +1800,9 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(delivery_number, int);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ACTION_FUNCTION, void*);
     REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t, unsigned long long);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
 
     REGISTER_UMOCK_VALUE_TYPE(BINARY_DATA);
     REGISTER_UMOCK_VALUE_TYPE(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO);
@@ -1818,7 +1813,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_HOOK(messagesender_send_async, TEST_messagesender_send_async);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_create, TEST_messagereceiver_create);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_open, TEST_messagereceiver_open);
-    REGISTER_GLOBAL_MOCK_HOOK(message_create_uamqp_encoding_from_iothub_message, TEST_message_create_uamqp_encoding_from_iothub_message);
+    REGISTER_GLOBAL_MOCK_HOOK(message_encode_uamqp_encoding_from_iothub_message, TEST_message_encode_uamqp_encoding_from_iothub_message);
     REGISTER_GLOBAL_MOCK_HOOK(message_create_IoTHubMessage_from_uamqp_message, TEST_message_create_IoTHubMessage_from_uamqp_message);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, TEST_singlylinkedlist_add);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, TEST_singlylinkedlist_get_head_item);
@@ -1923,6 +1918,11 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(message_add_body_amqp_data, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_add_body_amqp_data, 1);
 
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetContentType, IOTHUBMESSAGE_BYTEARRAY);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_OK);
+
     TEST_IOTHUB_MESSAGE_LIST_HANDLE = (IOTHUB_MESSAGE_LIST*)real_malloc(sizeof(IOTHUB_MESSAGE_LIST));
     ASSERT_IS_NOT_NULL(TEST_IOTHUB_MESSAGE_LIST_HANDLE);
     TEST_IOTHUB_MESSAGE_LIST_HANDLE->messageHandle = TEST_IOTHUB_MESSAGE_HANDLE;
@@ -2594,6 +2594,221 @@ TEST_FUNCTION(telemetry_messenger_do_work_send_middle_message_too_big_and_rollov
     test_send_events(&test_send_middle_message_too_big_and_rollover_config, true);
 }
 
+static TELEMETRY_MESSENGER_HANDLE create_lingering_messenger(size_t linger_ms, size_t linger_batch_bytes)
+{
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    ASSERT_ARE_EQUAL(int, 0, telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_LINGER_MS, &linger_ms));
+    ASSERT_ARE_EQUAL(int, 0, telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_LINGER_BATCH_BYTES, &linger_batch_bytes));
+
+    return handle;
+}
+
+// payload_size is only looked at when the linger time has not elapsed at current_ms
+static void set_expected_calls_for_linger_check(tickcounter_ms_t current_ms, bool linger_elapsed, size_t payload_size)
+{
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &current_ms, sizeof(current_ms));
+
+    if (!linger_elapsed)
+    {
+        STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &payload_size, sizeof(payload_size));
+        STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    }
+}
+
+TEST_FUNCTION(telemetry_messenger_set_option_LINGER_MS_tickcounter_create_fails)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+    size_t linger_ms = 100;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(NULL);
+
+    // act
+    int result = telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_LINGER_MS, &linger_ms);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+TEST_FUNCTION(telemetry_messenger_do_work_holds_events_back_while_lingering)
+{
+    // arrange
+    TELEMETRY_MESSENGER_HANDLE handle = create_lingering_messenger(100, 1024);
+    ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+
+    time_t current_time = time(NULL);
+    umock_c_reset_all_calls();
+    set_expected_calls_for_process_event_send_timeouts(0, DEFAULT_EVENT_SEND_TIMEOUT_SECS, current_time);
+    set_expected_calls_for_linger_check(1000, false, 10);
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+TEST_FUNCTION(telemetry_messenger_do_work_sends_events_once_linger_ms_elapse)
+{
+    // arrange
+    TELEMETRY_MESSENGER_HANDLE handle = create_lingering_messenger(100, 1024);
+    ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+
+    time_t current_time = time(NULL);
+    umock_c_reset_all_calls();
+    set_expected_calls_for_process_event_send_timeouts(0, DEFAULT_EVENT_SEND_TIMEOUT_SECS, current_time);
+    set_expected_calls_for_linger_check(1000, false, 10);
+    telemetry_messenger_do_work(handle);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_process_event_send_timeouts(0, DEFAULT_EVENT_SEND_TIMEOUT_SECS, current_time);
+    set_expected_calls_for_linger_check(1100, true, 0);
+    set_expected_calls_for_message_do_work_send_pending_events(&test_send_one_message_config, current_time);
+    // The queue emptied, so the next event starts a new linger window
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+TEST_FUNCTION(telemetry_messenger_do_work_sends_events_once_linger_batch_bytes_are_waiting)
+{
+    // arrange
+    TELEMETRY_MESSENGER_HANDLE handle = create_lingering_messenger(100, 1024);
+    ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+
+    time_t current_time = time(NULL);
+    umock_c_reset_all_calls();
+    set_expected_calls_for_process_event_send_timeouts(0, DEFAULT_EVENT_SEND_TIMEOUT_SECS, current_time);
+    set_expected_calls_for_linger_check(1000, false, 1024);
+    set_expected_calls_for_message_do_work_send_pending_events(&test_send_one_message_config, current_time);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+TEST_FUNCTION(telemetry_messenger_do_work_sends_events_left_queued_without_lingering_again)
+{
+    // arrange
+    TELEMETRY_MESSENGER_HANDLE handle = create_lingering_messenger(100, 1024);
+    ASSERT_ARE_EQUAL(int, 2, send_events(handle, 2));
+
+    time_t current_time = time(NULL);
+    umock_c_reset_all_calls();
+    set_expected_calls_for_process_event_send_timeouts(0, DEFAULT_EVENT_SEND_TIMEOUT_SECS, current_time);
+    set_expected_calls_for_linger_check(1000, false, 10);
+    telemetry_messenger_do_work(handle);
+
+    // The linger time elapses, but sending stops after the first event and leaves the second one queued
+    umock_c_reset_all_calls();
+    set_expected_calls_for_linger_check(1100, true, 0);
+    STRICT_EXPECTED_CALL(link_get_peer_max_message_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(1);
+    telemetry_messenger_do_work(handle);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_process_event_send_timeouts(0, DEFAULT_EVENT_SEND_TIMEOUT_SECS, current_time);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+    set_expected_calls_for_message_do_work_send_pending_events(&test_send_one_message_config, current_time);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+static TELEMETRY_MESSENGER_HANDLE create_messenger_with_one_event_sent(time_t send_time)
+{
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+    ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+
+    MESSENGER_DO_WORK_EXP_CALL_PROFILE *mdwp = get_msgr_do_work_exp_call_profile(TELEMETRY_MESSENGER_STATE_STARTED, false, false, 1, 0, send_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+    mdwp->send_pending_events_test_config = &test_send_one_message_config;
+    crank_telemetry_messenger_do_work(handle, mdwp);
+
+    return handle;
+}
+
+TEST_FUNCTION(telemetry_messenger_do_work_times_out_events_sent_event_send_timeout_secs_ago)
+{
+    // arrange
+    time_t send_time = time(NULL);
+    TELEMETRY_MESSENGER_HANDLE handle = create_messenger_with_one_event_sent(send_time);
+    time_t current_time = add_seconds(send_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_process_event_send_timeouts(1, DEFAULT_EVENT_SEND_TIMEOUT_SECS, current_time);
+    set_expected_calls_for_message_do_work_send_pending_events(&test_send_zero_message_config, current_time);
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    verify_expected_callbacks_received(test_send_one_message_config.expected_on_send_complete_data, test_send_one_message_config.number_expected_on_send_complete_data, TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_TIMEOUT);
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+TEST_FUNCTION(telemetry_messenger_do_work_stops_checking_timeouts_at_the_first_event_not_timed_out)
+{
+    // arrange
+    time_t send_time = time(NULL);
+    TELEMETRY_MESSENGER_HANDLE handle = create_messenger_with_one_event_sent(send_time);
+    time_t current_time = add_seconds(send_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS - 1);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+    EXPECTED_CALL(get_difftime(current_time, send_time)).SetReturn(difftime(current_time, send_time));
+    set_expected_calls_for_message_do_work_send_pending_events(&test_send_zero_message_config, current_time);
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, TEST_number_test_on_send_complete_data);
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_067: [If `instance->receive_messages` is true and `instance->message_receiver` is NULL, a message_receiver shall be created]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_068: [A variable, named `devices_and_modules_path`, shall be created concatenating `instance->iothub_host_fqdn`, "/devices/" and `instance->device_id`]
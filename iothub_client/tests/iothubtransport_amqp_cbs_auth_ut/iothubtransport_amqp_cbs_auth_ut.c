@@ -62,6 +62,7 @@ static int real_strcmp(const char* str1, const char* str2)
 #include "azure_c_shared_utility/agenttime.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "internal/iothub_client_authorization.h"
+#include "internal/iothubtransport_amqp_cbs_scheduler.h"
 #undef ENABLE_MOCKS
 
 #include "internal/iothubtransport_amqp_cbs_auth.h"
@@ -110,6 +111,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_OPTIONHANDLER_HANDLE                         (OPTIONHANDLER_HANDLE)0x4455
 #define TEST_AUTHORIZATION_MODULE_HANDLE                  (IOTHUB_AUTHORIZATION_HANDLE)0x4456
 #define TEST_PUT_TOKEN_RESULT                             (ASYNC_OPERATION_HANDLE)0x4457
+#define TEST_CBS_SCHEDULER_HANDLE                         (CBS_SCHEDULER_HANDLE)0x4458
 
 
 static AUTHENTICATION_CONFIG global_auth_config;
@@ -238,6 +240,9 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(SAS_TOKEN_STATUS, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CREDENTIAL_TYPE, int);
     REGISTER_UMOCK_ALIAS_TYPE(ASYNC_OPERATION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(CBS_SCHEDULER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t, uint64_t);
 }
 
 static void register_global_mock_hooks()
@@ -273,6 +278,8 @@ static void register_global_mock_returns()
     
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_ERROR);
     REGISTER_GLOBAL_MOCK_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(cbs_scheduler_begin_put_token, true);
 }
 
 // Auxiliary Functions
@@ -1422,6 +1429,209 @@ TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_refresh)
     authentication_destroy(handle);
 }
 
+TEST_FUNCTION(authentication_create_with_cbs_scheduler_adds_the_device)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    config->cbs_scheduler = TEST_CBS_SCHEDULER_HANDLE;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_authentication_create(config, false);
+    STRICT_EXPECTED_CALL(cbs_scheduler_add_device(TEST_CBS_SCHEDULER_HANDLE));
+
+    // act
+    AUTHENTICATION_HANDLE handle = authentication_create(config);
+
+    // assert
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+TEST_FUNCTION(authentication_destroy_with_cbs_scheduler_removes_the_device)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    config->cbs_scheduler = TEST_CBS_SCHEDULER_HANDLE;
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config, false);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(cbs_scheduler_remove_device(TEST_CBS_SCHEDULER_HANDLE));
+    STRICT_EXPECTED_CALL(free(handle));
+
+    // act
+    authentication_destroy(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+TEST_FUNCTION(authentication_do_work_AUTHENTICATION_STATE_STARTING_waits_for_cbs_scheduler)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    config->cbs_scheduler = TEST_CBS_SCHEDULER_HANDLE;
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config, false);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(cbs_scheduler_begin_put_token(TEST_CBS_SCHEDULER_HANDLE, IGNORED_PTR_ARG)).SetReturn(false);
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(saved_cbs_put_token_on_operation_complete);
+    ASSERT_ARE_EQUAL(int, AUTHENTICATION_STATE_STARTING, saved_on_state_changed_callback_new_state);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+TEST_FUNCTION(authentication_do_work_AUTHENTICATION_STATE_STARTING_with_cbs_scheduler_ends_put_token_on_callback)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    config->cbs_scheduler = TEST_CBS_SCHEDULER_HANDLE;
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config, false);
+
+    time_t current_time = time(NULL);
+
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(cbs_scheduler_begin_put_token(TEST_CBS_SCHEDULER_HANDLE, IGNORED_PTR_ARG));
+    set_expected_calls_for_authentication_do_work(config, handle, current_time, exp_state, IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    authentication_do_work(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(cbs_scheduler_end_put_token(TEST_CBS_SCHEDULER_HANDLE, IGNORED_NUM_ARG, true));
+
+    // act
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, AUTHENTICATION_STATE_STARTED, saved_on_state_changed_callback_new_state);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+TEST_FUNCTION(authentication_stop_with_put_token_in_flight_ends_it_on_cbs_scheduler)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    config->cbs_scheduler = TEST_CBS_SCHEDULER_HANDLE;
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config, false);
+
+    time_t current_time = time(NULL);
+
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(cbs_scheduler_begin_put_token(TEST_CBS_SCHEDULER_HANDLE, IGNORED_PTR_ARG));
+    set_expected_calls_for_authentication_do_work(config, handle, current_time, exp_state, IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    authentication_do_work(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(cbs_scheduler_end_put_token(TEST_CBS_SCHEDULER_HANDLE, IGNORED_NUM_ARG, false));
+
+    // act
+    int result = authentication_stop(handle);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OPERATION_FAILED, 0, "link closed");
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+TEST_FUNCTION(authentication_do_work_sas_token_refresh_check_asks_cbs_scheduler_once)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    config->cbs_scheduler = TEST_CBS_SCHEDULER_HANDLE;
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config, false);
+
+    time_t current_time = time(NULL);
+
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(cbs_scheduler_begin_put_token(TEST_CBS_SCHEDULER_HANDLE, IGNORED_PTR_ARG));
+    set_expected_calls_for_authentication_do_work(config, handle, current_time, exp_state, IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    authentication_do_work(handle);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    exp_state->current_state = AUTHENTICATION_STATE_STARTED;
+    exp_state->current_sas_token_put_time = current_time;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_authentication_do_work(config, handle, current_time, exp_state, IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(cbs_scheduler_get_refresh_delay(TEST_CBS_SCHEDULER_HANDLE, 0, 3600)).SetReturn(2000);
+    set_expected_calls_for_authentication_do_work(config, handle, current_time, exp_state, IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+
+    // act
+    authentication_do_work(handle);
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+TEST_FUNCTION(authentication_do_work_sas_token_refresh_waits_for_cbs_scheduler)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    config->cbs_scheduler = TEST_CBS_SCHEDULER_HANDLE;
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config, false);
+
+    time_t current_time = time(NULL);
+
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(cbs_scheduler_begin_put_token(TEST_CBS_SCHEDULER_HANDLE, IGNORED_PTR_ARG));
+    set_expected_calls_for_authentication_do_work(config, handle, current_time, exp_state, IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    authentication_do_work(handle);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    exp_state->current_state = AUTHENTICATION_STATE_STARTED;
+    exp_state->current_sas_token_put_time = current_time;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_authentication_do_work(config, handle, current_time, exp_state, IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(cbs_scheduler_get_refresh_delay(TEST_CBS_SCHEDULER_HANDLE, 0, 3600)).SetReturn(0);
+    STRICT_EXPECTED_CALL(cbs_scheduler_begin_put_token(TEST_CBS_SCHEDULER_HANDLE, IGNORED_PTR_ARG)).SetReturn(false);
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, AUTHENTICATION_STATE_STARTED, saved_on_state_changed_callback_new_state);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_021: [authentication_create() shall set `instance->cbs_request_timeout_secs` with the default value of UINT32_MAX]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_038: [If `instance->is_cbs_put_token_in_progress` is TRUE, authentication_do_work() shall only verify the authentication timeout]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_043: [authentication_do_work() shall set `instance->is_cbs_put_token_in_progress` to TRUE]
@@ -0,0 +1,417 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c/umock_c.h"
+#include "umock_c/umocktypes_charptr.h"
+#include "umock_c/umocktypes_stdint.h"
+#include "umock_c/umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothubtransport_amqp_cbs_scheduler.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+MU_DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", MU_ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+#define TEST_TICK_COUNTER_HANDLE    (TICK_COUNTER_HANDLE)0x4471
+#define TEST_TOKEN_LIFETIME_SECS    3600
+
+static tickcounter_ms_t g_now_ms;
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_now_ms;
+    return 0;
+}
+
+static void reset_test_data()
+{
+    g_now_ms = 0;
+}
+
+static void register_umock_alias_types()
+{
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t, uint64_t);
+}
+
+static void register_global_mock_hooks()
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+}
+
+static void register_global_mock_returns()
+{
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+}
+
+static CBS_SCHEDULER_HANDLE create_scheduler(size_t device_count)
+{
+    size_t i;
+    CBS_SCHEDULER_HANDLE result = cbs_scheduler_create();
+    ASSERT_IS_NOT_NULL(result);
+
+    for (i = 0; i < device_count; i++)
+    {
+        cbs_scheduler_add_device(result);
+    }
+
+    umock_c_reset_all_calls();
+    return result;
+}
+
+/*a put-token answered by CBS latency_ms after it was started*/
+static void complete_put_token(CBS_SCHEDULER_HANDLE scheduler, tickcounter_ms_t latency_ms)
+{
+    tickcounter_ms_t start_time;
+
+    ASSERT_IS_TRUE(cbs_scheduler_begin_put_token(scheduler, &start_time));
+    g_now_ms += latency_ms;
+    cbs_scheduler_end_put_token(scheduler, start_time, true);
+}
+
+BEGIN_TEST_SUITE(iothubtransport_amqp_cbs_scheduler_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_umock_alias_types();
+    register_global_mock_returns();
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    reset_test_data();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    reset_test_data();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(cbs_scheduler_create_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_create());
+
+    // act
+    CBS_SCHEDULER_HANDLE result = cbs_scheduler_create();
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    cbs_scheduler_destroy(result);
+}
+
+TEST_FUNCTION(cbs_scheduler_create_tickcounter_create_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    CBS_SCHEDULER_HANDLE result = cbs_scheduler_create();
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(cbs_scheduler_destroy_frees_the_tick_counter)
+{
+    // arrange
+    CBS_SCHEDULER_HANDLE scheduler = create_scheduler(0);
+
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    cbs_scheduler_destroy(scheduler);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(cbs_scheduler_get_refresh_delay_of_a_single_device_is_half_the_token_lifetime)
+{
+    // arrange
+    CBS_SCHEDULER_HANDLE scheduler = create_scheduler(1);
+
+    // act
+    uint64_t first_delay = cbs_scheduler_get_refresh_delay(scheduler, 0, TEST_TOKEN_LIFETIME_SECS);
+    g_now_ms = TEST_TOKEN_LIFETIME_SECS * 1000;
+    uint64_t second_delay = cbs_scheduler_get_refresh_delay(scheduler, 0, TEST_TOKEN_LIFETIME_SECS);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, TEST_TOKEN_LIFETIME_SECS / 2, first_delay);
+    ASSERT_ARE_EQUAL(uint64_t, TEST_TOKEN_LIFETIME_SECS / 2, second_delay);
+
+    // cleanup
+    cbs_scheduler_destroy(scheduler);
+}
+
+TEST_FUNCTION(cbs_scheduler_get_refresh_delay_spreads_the_devices_put_together)
+{
+    // arrange
+    /*4 devices share the window between 1800 and 2880 seconds, 270 seconds apart*/
+    CBS_SCHEDULER_HANDLE scheduler = create_scheduler(4);
+
+    // act & assert
+    ASSERT_ARE_EQUAL(uint64_t, 1800, cbs_scheduler_get_refresh_delay(scheduler, 0, TEST_TOKEN_LIFETIME_SECS));
+    ASSERT_ARE_EQUAL(uint64_t, 2070, cbs_scheduler_get_refresh_delay(scheduler, 0, TEST_TOKEN_LIFETIME_SECS));
+    ASSERT_ARE_EQUAL(uint64_t, 2340, cbs_scheduler_get_refresh_delay(scheduler, 0, TEST_TOKEN_LIFETIME_SECS));
+    ASSERT_ARE_EQUAL(uint64_t, 2610, cbs_scheduler_get_refresh_delay(scheduler, 0, TEST_TOKEN_LIFETIME_SECS));
+
+    // cleanup
+    cbs_scheduler_destroy(scheduler);
+}
+
+TEST_FUNCTION(cbs_scheduler_get_refresh_delay_does_not_go_past_the_window_end)
+{
+    // arrange
+    CBS_SCHEDULER_HANDLE scheduler = create_scheduler(2);
+    (void)cbs_scheduler_get_refresh_delay(scheduler, 0, TEST_TOKEN_LIFETIME_SECS);
+    (void)cbs_scheduler_get_refresh_delay(scheduler, 0, TEST_TOKEN_LIFETIME_SECS);
+
+    // act
+    uint64_t delay = cbs_scheduler_get_refresh_delay(scheduler, 0, TEST_TOKEN_LIFETIME_SECS);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 2880, delay);
+
+    // cleanup
+    cbs_scheduler_destroy(scheduler);
+}
+
+TEST_FUNCTION(cbs_scheduler_get_refresh_delay_counts_from_the_put_time)
+{
+    // arrange
+    CBS_SCHEDULER_HANDLE scheduler = create_scheduler(1);
+    g_now_ms = 100 * 1000;
+
+    // act
+    uint64_t delay = cbs_scheduler_get_refresh_delay(scheduler, 100, TEST_TOKEN_LIFETIME_SECS);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 1800, delay);
+
+    // cleanup
+    cbs_scheduler_destroy(scheduler);
+}
+
+TEST_FUNCTION(cbs_scheduler_get_refresh_delay_NULL_scheduler_refreshes_at_the_window_end)
+{
+    // act
+    uint64_t delay = cbs_scheduler_get_refresh_delay(NULL, 0, TEST_TOKEN_LIFETIME_SECS);
+
+    // assert
+    ASSERT_ARE_EQUAL(uint64_t, 2880, delay);
+}
+
+TEST_FUNCTION(cbs_scheduler_begin_put_token_is_not_limited_by_default)
+{
+    // arrange
+    size_t i;
+    tickcounter_ms_t start_time;
+    CBS_SCHEDULER_HANDLE scheduler = create_scheduler(1);
+
+    // act & assert
+    for (i = 0; i < 100; i++)
+    {
+        ASSERT_IS_TRUE(cbs_scheduler_begin_put_token(scheduler, &start_time));
+    }
+
+    // cleanup
+    cbs_scheduler_destroy(scheduler);
+}
+
+TEST_FUNCTION(cbs_scheduler_begin_put_token_waits_at_max_put_tokens_in_flight)
+{
+    // arrange
+    tickcounter_ms_t start_time;
+    CBS_SCHEDULER_HANDLE scheduler = create_scheduler(3);
+    ASSERT_ARE_EQUAL(int, 0, cbs_scheduler_set_max_put_tokens_in_flight(scheduler, 2));
+
+    // act & assert
+    ASSERT_IS_TRUE(cbs_scheduler_begin_put_token(scheduler, &start_time));
+    ASSERT_IS_TRUE(cbs_scheduler_begin_put_token(scheduler, &start_time));
+    ASSERT_IS_FALSE(cbs_scheduler_begin_put_token(scheduler, &start_time));
+
+    cbs_scheduler_end_put_token(scheduler, start_time, false);
+    ASSERT_IS_TRUE(cbs_scheduler_begin_put_token(scheduler, &start_time));
+
+    // cleanup
+    cbs_scheduler_destroy(scheduler);
+}
+
+TEST_FUNCTION(cbs_scheduler_set_max_put_tokens_in_flight_NULL_scheduler_fails)
+{
+    // act
+    int result = cbs_scheduler_set_max_put_tokens_in_flight(NULL, 2);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+TEST_FUNCTION(cbs_scheduler_get_statistics_counts_the_put_tokens)
+{
+    // arrange
+    tickcounter_ms_t start_time;
+    IOTHUB_AMQP_CBS_STATISTICS statistics;
+    CBS_SCHEDULER_HANDLE scheduler = create_scheduler(2);
+    ASSERT_IS_TRUE(cbs_scheduler_begin_put_token(scheduler, &start_time));
+    ASSERT_IS_TRUE(cbs_scheduler_begin_put_token(scheduler, &start_time));
+    cbs_scheduler_end_put_token(scheduler, start_time, false);
+    g_now_ms += 20;
+    cbs_scheduler_end_put_token(scheduler, start_time, true);
+
+    // act
+    int result = cbs_scheduler_get_statistics(scheduler, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.put_tokens_in_flight);
+    ASSERT_ARE_EQUAL(size_t, 2, statistics.max_put_tokens_in_flight);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.put_tokens);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.failed_put_tokens);
+    /*20 ms falls in [16, 32)*/
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.put_token_latency_ms[2]);
+    ASSERT_ARE_EQUAL(uint64_t, 32, statistics.put_token_latency_p50_ms);
+
+    // cleanup
+    cbs_scheduler_destroy(scheduler);
+}
+
+TEST_FUNCTION(cbs_scheduler_get_statistics_reports_the_latency_percentiles)
+{
+    // arrange
+    size_t i;
+    IOTHUB_AMQP_CBS_STATISTICS statistics;
+    CBS_SCHEDULER_HANDLE scheduler = create_scheduler(1);
+    for (i = 0; i < 90; i++)
+    {
+        complete_put_token(scheduler, 5);
+    }
+    for (i = 0; i < 9; i++)
+    {
+        complete_put_token(scheduler, 100);
+    }
+    complete_put_token(scheduler, 5000);
+
+    // act
+    int result = cbs_scheduler_get_statistics(scheduler, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 100, statistics.put_tokens);
+    ASSERT_ARE_EQUAL(uint64_t, 8, statistics.put_token_latency_p50_ms);
+    ASSERT_ARE_EQUAL(uint64_t, 8, statistics.put_token_latency_p90_ms);
+    ASSERT_ARE_EQUAL(uint64_t, 128, statistics.put_token_latency_p99_ms);
+
+    // cleanup
+    cbs_scheduler_destroy(scheduler);
+}
+
+TEST_FUNCTION(cbs_scheduler_get_statistics_without_put_tokens_reports_zero_latency)
+{
+    // arrange
+    IOTHUB_AMQP_CBS_STATISTICS statistics;
+    CBS_SCHEDULER_HANDLE scheduler = create_scheduler(1);
+
+    // act
+    int result = cbs_scheduler_get_statistics(scheduler, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.put_tokens);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.put_token_latency_p50_ms);
+    ASSERT_ARE_EQUAL(uint64_t, 0, statistics.put_token_latency_p99_ms);
+
+    // cleanup
+    cbs_scheduler_destroy(scheduler);
+}
+
+TEST_FUNCTION(cbs_scheduler_get_statistics_NULL_statistics_fails)
+{
+    // arrange
+    CBS_SCHEDULER_HANDLE scheduler = create_scheduler(1);
+
+    // act
+    int result = cbs_scheduler_get_statistics(scheduler, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    cbs_scheduler_destroy(scheduler);
+}
+
+END_TEST_SUITE(iothubtransport_amqp_cbs_scheduler_ut)
@@ -215,13 +215,6 @@ extern "C"
         return item_found == 1 ? 0 : 1;
     }
 
-    static LIST_ITEM_HANDLE TEST_singlylinkedlist_find(SINGLYLINKEDLIST_HANDLE list, LIST_MATCH_FUNCTION match_function, const void* match_context)
-    {
-        (void)list;
-        (void)match_function;
-        return (LIST_ITEM_HANDLE)match_context;
-    }
-
     static SINGLYLINKEDLIST_HANDLE TEST_singlylinkedlist_foreach_list;
     static LIST_ACTION_FUNCTION TEST_singlylinkedlist_foreach_action_function;
     static const void* TEST_singlylinkedlist_foreach_context;
@@ -412,7 +405,6 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_REGISTERED_DEVICES_LIST               (SINGLYLINKEDLIST_HANDLE)0x4267
 #define TEST_DEVICE_ID_STRING_HANDLE               (STRING_HANDLE)0x4268
 #define TEST_DEVICE_HANDLE                         (AMQP_DEVICE_HANDLE)0x4269
-#define TEST_LIST_ITEM_HANDLE                      (LIST_ITEM_HANDLE)0x4270
 #define TEST_AMQP_CONNECTION_HANDLE                (AMQP_CONNECTION_HANDLE)0x4271
 #define TEST_IOTHUB_MESSAGE_LIST_HANDLE            (IOTHUB_MESSAGE_LIST*)0x4272
 #define TEST_IOTHUB_DEVICE_HANDLE                  (IOTHUB_DEVICE_HANDLE)0x4273
@@ -422,6 +414,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_X509_PRIVATE_KEY                      "Raphael Rabello"
 #define TEST_MESSAGE_SOURCE_CHAR_PTR               "messagereceiver_link_name"
 #define TEST_RETRY_CONTROL_HANDLE                  (RETRY_CONTROL_HANDLE)0x4276
+#define TEST_CBS_SCHEDULER_HANDLE                  (CBS_SCHEDULER_HANDLE)0x4277
 
 static TRANSPORT_CALLBACKS_INFO transport_cb_info;
 static void* transport_cb_ctx = (void*)0x499922;
@@ -460,6 +453,7 @@ static void set_expected_calls_for_Create(IOTHUBTRANSPORT_CONFIG* transport_conf
 
     STRICT_EXPECTED_CALL(singlylinkedlist_create())
         .SetReturn(TEST_REGISTERED_DEVICES_LIST);
+    STRICT_EXPECTED_CALL(cbs_scheduler_create());
 }
 
 static void set_expected_calls_for_GetSendStatus(bool is_waiting_to_send_list_empty, DEVICE_SEND_STATUS send_status)
@@ -487,14 +481,6 @@ static void set_expected_calls_for_GetHostname()
     STRICT_EXPECTED_CALL(STRING_clone(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN_CLONE_STRING_HANDLE);
 }
 
-static void set_expected_calls_for_is_device_registered_ex(IOTHUB_DEVICE_CONFIG* device_config, IOTHUB_DEVICE_HANDLE registered_device)
-{
-    (void)device_config;
-
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .SetReturn((LIST_ITEM_HANDLE)registered_device).CallCannotFail();
-}
-
 static MESSAGE_DISPOSITION_CONTEXT* TRANSPORT_CONTEXT_DATA_create2(IOTHUB_DEVICE_HANDLE device_handle)
 {
     MESSAGE_DISPOSITION_CONTEXT* result = (MESSAGE_DISPOSITION_CONTEXT*)malloc(sizeof(MESSAGE_DISPOSITION_CONTEXT));
@@ -554,21 +540,9 @@ static void set_expected_calls_for_SendMessageDisposition(IOTHUBMESSAGE_DISPOSIT
     set_expected_calls_for_destroy_device_message_disposition_info();
 }
 
-// @param registered_device
-//     provide the handle to the registered device if the expected call is supposed to return an item,
-//     or NULL if the intent is to return "not registered".
-static void set_expected_calls_for_is_device_registered(IOTHUB_DEVICE_CONFIG* device_config, IOTHUB_DEVICE_HANDLE registered_device)
-{
-    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
-        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-
-    set_expected_calls_for_is_device_registered_ex(device_config, registered_device);
-}
-
 static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config, bool is_using_cbs)
 {
-    set_expected_calls_for_is_device_registered_ex(device_config, NULL);
-
+    // find_registered_device
     // is_device_credential_acceptable
     // Nothing to expect.
 
@@ -597,14 +571,11 @@ static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config,
 
 static void set_expected_calls_for_Unregister(IOTHUB_DEVICE_HANDLE iothub_device_handle)
 {
+    (void)iothub_device_handle;
+
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetReturn((LIST_ITEM_HANDLE)iothub_device_handle);
-
     STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
 
@@ -768,6 +739,7 @@ static void set_expected_calls_for_Destroy(int number_of_registered_devices, IOT
     }
 
     STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_REGISTERED_DEVICES_LIST));
+    STRICT_EXPECTED_CALL(cbs_scheduler_destroy(TEST_CBS_SCHEDULER_HANDLE));
     STRICT_EXPECTED_CALL(amqp_connection_destroy(TEST_AMQP_CONNECTION_HANDLE));
     STRICT_EXPECTED_CALL(xio_destroy(TEST_UNDERLYING_IO_TRANSPORT));
     STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
@@ -777,7 +749,8 @@ static void set_expected_calls_for_Destroy(int number_of_registered_devices, IOT
 
 static void set_expected_calls_for_Subscribe(IOTHUB_DEVICE_CONFIG* device_config, IOTHUB_DEVICE_HANDLE registered_device)
 {
-    set_expected_calls_for_is_device_registered(device_config, registered_device);
+    (void)device_config;
+    (void)registered_device;
 
     STRICT_EXPECTED_CALL(amqp_device_subscribe_message(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
@@ -786,7 +759,8 @@ static void set_expected_calls_for_Subscribe(IOTHUB_DEVICE_CONFIG* device_config
 
 static void set_expected_calls_for_Unsubscribe(IOTHUB_DEVICE_CONFIG* device_config, IOTHUB_DEVICE_HANDLE registered_device)
 {
-    set_expected_calls_for_is_device_registered(device_config, registered_device);
+    (void)device_config;
+    (void)registered_device;
 
     STRICT_EXPECTED_CALL(amqp_device_unsubscribe_message(TEST_DEVICE_HANDLE));
 }
@@ -900,13 +874,35 @@ static double TEST_get_difftime(time_t t1, time_t t0)
 static ON_DEVICE_STATE_CHANGED TEST_device_create_saved_on_state_changed_callback;
 static void* TEST_device_create_saved_on_state_changed_context;
 static AMQP_DEVICE_HANDLE TEST_device_create_return;
+static CBS_SCHEDULER_HANDLE TEST_device_create_saved_cbs_scheduler;
 static AMQP_DEVICE_HANDLE TEST_device_create(AMQP_DEVICE_CONFIG* config)
 {
+    TEST_device_create_saved_cbs_scheduler = config->cbs_scheduler;
     TEST_device_create_saved_on_state_changed_callback = config->on_state_changed_callback;
     TEST_device_create_saved_on_state_changed_context = config->on_state_changed_context;
     return TEST_device_create_return;
 }
 
+static ON_DEVICE_D2C_EVENT_SEND_COMPLETE TEST_device_send_event_async_saved_callback;
+static void* TEST_device_send_event_async_saved_context;
+static IOTHUB_MESSAGE_LIST* TEST_device_send_event_async_saved_message;
+static int TEST_device_send_event_async(AMQP_DEVICE_HANDLE handle, IOTHUB_MESSAGE_LIST* message, ON_DEVICE_D2C_EVENT_SEND_COMPLETE on_device_d2c_event_send_complete_callback, void* context)
+{
+    (void)handle;
+    TEST_device_send_event_async_saved_message = message;
+    TEST_device_send_event_async_saved_callback = on_device_d2c_event_send_complete_callback;
+    TEST_device_send_event_async_saved_context = context;
+    return 0;
+}
+
+static PDLIST_ENTRY TEST_Transport_SendComplete_Callback_saved_entry;
+static void TEST_Transport_SendComplete_Callback(PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* ctx)
+{
+    (void)result;
+    (void)ctx;
+    TEST_Transport_SendComplete_Callback_saved_entry = completed->Flink;
+}
+
 static bool g_MessageCallback_return;
 static bool TEST_Transport_MessageCallback(MESSAGE_CALLBACK_INFO* messageData, void* ctx)
 {
@@ -1051,6 +1047,25 @@ static IOTHUB_DEVICE_HANDLE register_device(TRANSPORT_LL_HANDLE handle, IOTHUB_D
     return IoTHubTransport_AMQP_Common_Register(handle, device_config, wts);
 }
 
+// Unregisters the device from its transport without freeing the memory of `device_handle`, so it can still be passed to the API.
+// The caller frees it with real_free.
+static void unregister_device_keeping_handle(IOTHUB_DEVICE_HANDLE device_handle)
+{
+    int i;
+    for (i = 0; i < saved_malloc_returns_count; i++)
+    {
+        if (saved_malloc_returns[i] == (void*)device_handle)
+        {
+            saved_malloc_returns[i] = saved_malloc_returns[--saved_malloc_returns_count];
+            break;
+        }
+    }
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_Unregister(device_handle);
+    IoTHubTransport_AMQP_Common_Unregister(device_handle);
+}
+
 static void destroy_transport(TRANSPORT_LL_HANDLE handle, IOTHUB_DEVICE_HANDLE registered_device0, IOTHUB_DEVICE_HANDLE registered_device1)
 {
     int number_of_registered_devices = (registered_device1 != NULL ? 2 : (registered_device0 != NULL ? 1 : 0));
@@ -1117,6 +1132,9 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
     REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
     REGISTER_UMOCK_ALIAS_TYPE(RETRY_CONTROL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(CBS_SCHEDULER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(tickcounter_ms_t, uint64_t);
     REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
@@ -1144,7 +1162,6 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, TEST_singlylinkedlist_remove);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, TEST_singlylinkedlist_get_head_item);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_next_item, TEST_singlylinkedlist_get_next_item);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_find, TEST_singlylinkedlist_find);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_foreach, TEST_singlylinkedlist_foreach);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, TEST_singlylinkedlist_item_get_value);
 
@@ -1161,6 +1178,8 @@ static void register_global_mock_hooks()
 
     REGISTER_GLOBAL_MOCK_HOOK(amqp_device_create, TEST_device_create);
     REGISTER_GLOBAL_MOCK_HOOK(amqp_device_subscribe_message, TEST_device_subscribe_message);
+    REGISTER_GLOBAL_MOCK_HOOK(amqp_device_send_event_async, TEST_device_send_event_async);
+    REGISTER_GLOBAL_MOCK_HOOK(Transport_SendComplete_Callback, TEST_Transport_SendComplete_Callback);
 
     REGISTER_GLOBAL_MOCK_HOOK(Transport_MessageCallback, TEST_Transport_MessageCallback);
     REGISTER_GLOBAL_MOCK_RETURN(Transport_GetOption_Product_Info_Callback, TEST_PRODUCT_INFO_CHAR_PTR);
@@ -1219,6 +1238,15 @@ static void register_global_mock_returns()
 
     REGISTER_GLOBAL_MOCK_RETURN(retry_control_set_option, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(retry_control_set_option, 1);
+
+    REGISTER_GLOBAL_MOCK_RETURN(cbs_scheduler_create, TEST_CBS_SCHEDULER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(cbs_scheduler_create, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(cbs_scheduler_set_max_put_tokens_in_flight, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(cbs_scheduler_set_max_put_tokens_in_flight, 1);
+
+    REGISTER_GLOBAL_MOCK_RETURN(cbs_scheduler_get_statistics, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(cbs_scheduler_get_statistics, 1);
 }
 
 static void reset_test_data()
@@ -1242,6 +1270,7 @@ static void reset_test_data()
     TEST_amqp_connection_get_cbs_handle_return = 0;
 
     TEST_device_create_saved_on_state_changed_callback = NULL;
+    TEST_device_create_saved_cbs_scheduler = NULL;
     TEST_device_create_saved_on_state_changed_context = NULL;
     TEST_device_create_return = TEST_DEVICE_HANDLE;
 
@@ -1251,6 +1280,11 @@ static void reset_test_data()
     TEST_device_subscribe_message_saved_context = NULL;
     TEST_device_subscribe_message_return = 0;
 
+    TEST_device_send_event_async_saved_callback = NULL;
+    TEST_device_send_event_async_saved_context = NULL;
+    TEST_device_send_event_async_saved_message = NULL;
+    TEST_Transport_SendComplete_Callback_saved_entry = NULL;
+
     TEST_MESSAGE_ID = 1234;
     TEST_mallocAndStrcpy_s_return = 0;
 
@@ -2217,16 +2251,75 @@ TEST_FUNCTION(Register_device_already_registered)
     TRANSPORT_LL_HANDLE handle = create_transport();
 
     IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle1 = register_device(handle, device_config, &TEST_waitingToSend, true);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(TEST_LIST_ITEM_HANDLE);
+    // same id, but not the same pointer
+    char same_device_id[] = TEST_DEVICE_ID_CHAR_PTR;
+    device_config->deviceId = same_device_id;
+
+    umock_c_reset_all_calls();
 
     // act
-    IOTHUB_DEVICE_HANDLE device_handle = IoTHubTransport_AMQP_Common_Register(handle, device_config, &TEST_waitingToSend);
+    IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config, &TEST_waitingToSend);
 
     // assert
-    ASSERT_IS_NULL(device_handle);
+    ASSERT_IS_NOT_NULL(device_handle1);
+    ASSERT_IS_NULL(device_handle2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle1, NULL);
+}
+
+TEST_FUNCTION(Register_device_with_another_id_succeeds)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle1 = register_device(handle, device_config, &TEST_waitingToSend, true);
+
+    device_config = create_device_config(TEST_DEVICE_ID_2_CHAR_PTR, true);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_Register(device_config, true);
+
+    // act
+    IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config, &TEST_waitingToSend);
+
+    // assert
+    ASSERT_IS_NOT_NULL(device_handle1);
+    ASSERT_IS_NOT_NULL(device_handle2);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, device_handle1, device_handle2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle1, device_handle2);
+}
+
+TEST_FUNCTION(Register_id_of_unregistered_device_succeeds)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_Unregister(device_handle);
+    IoTHubTransport_AMQP_Common_Unregister(device_handle);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_Register(device_config, true);
+
+    // act
+    device_handle = IoTHubTransport_AMQP_Common_Register(handle, device_config, &TEST_waitingToSend);
+
+    // assert
+    ASSERT_IS_NOT_NULL(device_handle);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
@@ -2249,10 +2342,6 @@ TEST_FUNCTION(Register_CBS_transport_X509_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(NULL);
-
     // act
     IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config2, &TEST_waitingToSend);
 
@@ -2281,10 +2370,6 @@ TEST_FUNCTION(Register_X509_transport_CBS_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(NULL);
-
     // act
     IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config2, &TEST_waitingToSend);
 
@@ -2320,7 +2405,7 @@ TEST_FUNCTION(Register_failure_checks)
     size_t i, n = umock_c_negative_tests_call_count();
     for (i = 0; i < n; i++)
     {
-        if (i == 0 || i == 2 || i == 3 || i == 4 || i >= 5)
+        if (i >= 1)
         {
             // These expected calls do not cause the API to fail.
             continue;
@@ -2400,17 +2485,19 @@ TEST_FUNCTION(Subscribe_device_not_registered)
     // arrange
     initialize_test_variables();
     TRANSPORT_LL_HANDLE handle = create_transport();
+    TRANSPORT_LL_HANDLE other_handle = create_transport();
 
     IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
     IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    IOTHUB_DEVICE_HANDLE other_device_handle = register_device(other_handle, device_config, &TEST_waitingToSend, true);
+    unregister_device_keeping_handle(other_device_handle);
 
     umock_c_reset_all_calls();
-    set_expected_calls_for_is_device_registered(device_config, NULL);
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
 
     // act
-    int result = IoTHubTransport_AMQP_Common_Subscribe(device_handle);
+    int result = IoTHubTransport_AMQP_Common_Subscribe(other_device_handle);
 
     // assert
     ASSERT_ARE_NOT_EQUAL(int, 0, result);
@@ -2418,6 +2505,8 @@ TEST_FUNCTION(Subscribe_device_not_registered)
 
     // cleanup
     destroy_transport(handle, device_handle, NULL);
+    destroy_transport(other_handle, NULL, NULL);
+    real_free(other_device_handle);
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_086: [amqp_device_subscribe_message() shall be invoked passing `on_message_received_callback`]
@@ -2469,11 +2558,6 @@ TEST_FUNCTION(Subscribe_messages_failure_checks)
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 0 || i == 1)
-        {
-            continue;
-        }
-
         // arrange
         char error_msg[64];
         umock_c_negative_tests_reset();
@@ -2514,23 +2598,27 @@ TEST_FUNCTION(Unsubscribe_messages_device_not_registered)
     // arrange
     initialize_test_variables();
     TRANSPORT_LL_HANDLE handle = create_transport();
+    TRANSPORT_LL_HANDLE other_handle = create_transport();
 
     IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
     IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    IOTHUB_DEVICE_HANDLE other_device_handle = register_device(other_handle, device_config, &TEST_waitingToSend, true);
+    unregister_device_keeping_handle(other_device_handle);
 
     umock_c_reset_all_calls();
-    set_expected_calls_for_is_device_registered(device_config, NULL);
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
 
     // act
-    IoTHubTransport_AMQP_Common_Unsubscribe(device_handle);
+    IoTHubTransport_AMQP_Common_Unsubscribe(other_device_handle);
 
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
     destroy_transport(handle, device_handle, NULL);
+    destroy_transport(other_handle, NULL, NULL);
+    real_free(other_device_handle);
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_095: [amqp_device_unsubscribe_message() shall be invoked passing `amqp_device_instance->device_handle`]
@@ -3897,6 +3985,152 @@ TEST_FUNCTION(SetOption_retry_interval_fail)
     destroy_transport(handle, device_handle, NULL);
 }
 
+TEST_FUNCTION(SetOption_amqp_cbs_max_put_tokens_in_flight_succeeds)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(cbs_scheduler_set_max_put_tokens_in_flight(TEST_CBS_SCHEDULER_HANDLE, 8));
+
+    // act
+    size_t max_put_tokens_in_flight = 8;
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_CBS_MAX_PUT_TOKENS_IN_FLIGHT, &max_put_tokens_in_flight);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+TEST_FUNCTION(SetOption_amqp_cbs_max_put_tokens_in_flight_fails)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(cbs_scheduler_set_max_put_tokens_in_flight(TEST_CBS_SCHEDULER_HANDLE, 8)).SetReturn(__LINE__);
+
+    // act
+    size_t max_put_tokens_in_flight = 8;
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_CBS_MAX_PUT_TOKENS_IN_FLIGHT, &max_put_tokens_in_flight);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+TEST_FUNCTION(GetOption_cbs_statistics_succeeds)
+{
+    // arrange
+    IOTHUB_AMQP_CBS_STATISTICS statistics;
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(cbs_scheduler_get_statistics(TEST_CBS_SCHEDULER_HANDLE, &statistics));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_GetOption(handle, OPTION_AMQP_CBS_STATISTICS, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+TEST_FUNCTION(GetOption_NULL_arguments_fails)
+{
+    // arrange
+    IOTHUB_AMQP_CBS_STATISTICS statistics;
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT no_handle_result = IoTHubTransport_AMQP_Common_GetOption(NULL, OPTION_AMQP_CBS_STATISTICS, &statistics);
+    IOTHUB_CLIENT_RESULT no_option_result = IoTHubTransport_AMQP_Common_GetOption(handle, NULL, &statistics);
+    IOTHUB_CLIENT_RESULT no_value_result = IoTHubTransport_AMQP_Common_GetOption(handle, OPTION_AMQP_CBS_STATISTICS, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, no_handle_result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, no_option_result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, no_value_result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+TEST_FUNCTION(GetOption_unknown_option_fails)
+{
+    // arrange
+    size_t value;
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_GetOption(handle, OPTION_CBS_REQUEST_TIMEOUT, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+TEST_FUNCTION(GetOption_cbs_statistics_fails_when_the_cbs_scheduler_fails)
+{
+    // arrange
+    IOTHUB_AMQP_CBS_STATISTICS statistics;
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(cbs_scheduler_get_statistics(TEST_CBS_SCHEDULER_HANDLE, &statistics)).SetReturn(__LINE__);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_GetOption(handle, OPTION_AMQP_CBS_STATISTICS, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
+TEST_FUNCTION(Register_shares_the_cbs_scheduler_with_the_device)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+
+    // act
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+
+    // assert
+    ASSERT_IS_NOT_NULL(device_handle);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CBS_SCHEDULER_HANDLE, TEST_device_create_saved_cbs_scheduler);
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_043: [ `IoTHubTransport_AMQP_Common_Destroy` shall free the stored proxy options. ]*/
 TEST_FUNCTION(IoTHubTransport_AMQP_Common_Destroy_frees_proxy_options)
 {
@@ -3932,6 +4166,7 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_Destroy_frees_proxy_options)
     set_expected_calls_for_Unregister(device_handle);
 
     STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_REGISTERED_DEVICES_LIST));
+    STRICT_EXPECTED_CALL(cbs_scheduler_destroy(TEST_CBS_SCHEDULER_HANDLE));
     STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
@@ -3968,23 +4203,27 @@ TEST_FUNCTION(Unregister_device_not_registered)
     // arrange
     initialize_test_variables();
     TRANSPORT_LL_HANDLE handle = create_transport();
+    TRANSPORT_LL_HANDLE other_handle = create_transport();
 
     IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
     IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    IOTHUB_DEVICE_HANDLE other_device_handle = register_device(other_handle, device_config, &TEST_waitingToSend, true);
+    unregister_device_keeping_handle(other_device_handle);
 
     umock_c_reset_all_calls();
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-    set_expected_calls_for_is_device_registered_ex(device_config, NULL);
 
     // act
-    IoTHubTransport_AMQP_Common_Unregister(device_handle);
+    IoTHubTransport_AMQP_Common_Unregister(other_device_handle);
 
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
     destroy_transport(handle, device_handle, NULL);
+    destroy_transport(other_handle, NULL, NULL);
+    real_free(other_device_handle);
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_080: [if `deviceHandle` has a NULL reference to its transport instance, IoTHubTransport_AMQP_Common_Unregister shall return.] (NT)
@@ -4165,6 +4404,63 @@ TEST_FUNCTION(DoWork_success)
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_056: [`message` shall be completed with `iothub_send_result` through `send_complete_cb`, which invokes its callback and destroys it]
+TEST_FUNCTION(DoWork_completes_a_sent_event_through_send_complete_cb)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, true, true, true, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+    TEST_device_create_saved_on_state_changed_callback(TEST_device_create_saved_on_state_changed_context,
+        DEVICE_STATE_STOPPED, DEVICE_STATE_STARTED);
+
+    /*sent with a timeout, so the client tracks it until it completes*/
+    IOTHUB_MESSAGE_LIST message;
+    memset(&message, 0, sizeof(message));
+    message.messageHandle = TEST_IOTHUB_MESSAGE_HANDLE;
+    message.message_timeout_value = 1000;
+    real_DList_InsertTailList(&TEST_waitingToSend, &message.entry);
+
+    umock_c_reset_all_calls();
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+    ASSERT_ARE_EQUAL(void_ptr, &message, TEST_device_send_event_async_saved_message);
+    ASSERT_IS_NOT_NULL(TEST_device_send_event_async_saved_callback);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &message.entry));
+    STRICT_EXPECTED_CALL(Transport_SendComplete_Callback(IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK, IGNORED_PTR_ARG));
+
+    // act
+    TEST_device_send_event_async_saved_callback(&message, D2C_EVENT_SEND_COMPLETE_RESULT_OK, TEST_device_send_event_async_saved_context);
+
+    // assert
+    /*the transport does not destroy the message itself, so the client can forget its timeout first*/
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, &message.entry, TEST_Transport_SendComplete_Callback_saved_entry);
+
+    /*and the next DoWork has nothing left to do with it*/
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTED, true, true, true, true, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_115: [If the AMQP connection is closed by the service side, the connection retry logic shall be triggered]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_126: [The connection retry shall be attempted only if retry_control_should_retry() returns RETRY_ACTION_NOW, or if it fails]
 TEST_FUNCTION(on_amqp_connection_state_changed_CLOSED_unexpectedly)
@@ -41,6 +41,7 @@ static void real_free(void* ptr)
 #undef ENABLE_MOCKS
 
 #include "iothubtransportamqp.h"
+#include "iothub_client_options.h"
 
 
 static TEST_MUTEX_HANDLE g_testByTest;
@@ -290,6 +291,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_Subscribe_DeviceMethod, 0);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_ProcessItem, IOTHUB_PROCESS_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_GetSendStatus, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_GetOption, IOTHUB_CLIENT_OK);
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -718,6 +720,25 @@ TEST_FUNCTION(AMQP_GetHostname)
     // cleanup
 }
 
+TEST_FUNCTION(AMQP_GetOption)
+{
+    // arrange
+    TRANSPORT_PROVIDER* provider = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+    IOTHUB_AMQP_CBS_STATISTICS statistics;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubTransport_AMQP_Common_GetOption(TEST_TRANSPORT_LL_HANDLE, OPTION_AMQP_CBS_STATISTICS, &statistics));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = provider->IoTHubTransport_GetOption(TEST_TRANSPORT_LL_HANDLE, OPTION_AMQP_CBS_STATISTICS, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, result, IOTHUB_CLIENT_OK);
+
+    // cleanup
+}
+
 // Tests_SRS_IOTHUBTRANSPORTAMQP_09_005: [IoTHubTransportAMQP_Destroy shall destroy the TRANSPORT_LL_HANDLE by calling into the IoTHubTransport_AMQP_Common_Destroy().]
 TEST_FUNCTION(AMQP_Destroy)
 {
@@ -54,6 +54,7 @@ MOCKABLE_FUNCTION(, int, Transport_DeviceMethod_Complete_Callback, const char*,
 #undef ENABLE_MOCKS
 
 #include "iothubtransportamqp_websockets.h"
+#include "iothub_client_options.h"
 
 static TEST_MUTEX_HANDLE g_testByTest;
 
@@ -607,6 +608,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_ProcessItem, IOTHUB_PROCESS_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_GetSendStatus, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_GetTwinAsync, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_GetOption, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubTransport_AMQP_Common_GetTwinAsync, IOTHUB_CLIENT_ERROR);
     REGISTER_GLOBAL_MOCK_RETURN(wsio_get_interface_description, TEST_WSIO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_RETURN(platform_get_default_tlsio, TEST_TLSIO_INTERFACE_DESCRIPTION);
@@ -1108,6 +1110,25 @@ TEST_FUNCTION(AMQP_SetOption)
     // cleanup
 }
 
+TEST_FUNCTION(AMQP_GetOption)
+{
+    // arrange
+    TRANSPORT_PROVIDER* provider = (TRANSPORT_PROVIDER*)AMQP_Protocol_over_WebSocketsTls();
+    IOTHUB_AMQP_CBS_STATISTICS statistics;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubTransport_AMQP_Common_GetOption(TEST_TRANSPORT_LL_HANDLE, OPTION_AMQP_CBS_STATISTICS, &statistics));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = provider->IoTHubTransport_GetOption(TEST_TRANSPORT_LL_HANDLE, OPTION_AMQP_CBS_STATISTICS, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, result, IOTHUB_CLIENT_OK);
+
+    // cleanup
+}
+
 // Tests_SRS_IOTHUBTRANSPORTAMQP_WS_09_016: [IoTHubTransportAMQP_WS_GetSendStatus shall get the send status by calling into the IoTHubTransport_AMQP_Common_GetSendStatus()]
 TEST_FUNCTION(AMQP_GetSendStatus)
 {
@@ -0,0 +1,219 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures the messages per second IoTHubDeviceClient_LL_DoWork gets through over HTTP, and the request body bytes
+// every message costs, with and without batching. IoT Hub is replaced by a local stand-in of HTTPAPIEX that accepts
+// every request at once, so the time measured is the time the client takes to build the requests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/httpapiexsas.h"
+#include "iothub_device_client_ll.h"
+#include "iothub_client_options.h"
+#include "iothub_message.h"
+#include "iothubtransporthttp.h"
+
+#define MESSAGE_COUNT       10000
+#define MAXIMUM_DOWORK      (MESSAGE_COUNT + 10)
+
+static const char CONNECTION_STRING[] = "HostName=perf.azure-devices.net;DeviceId=perf-device;SharedAccessKey=cGVyZi1kZXZpY2Uta2V5LWZvci10aGUtYmVuY2htYXJr";
+static const char TELEMETRY_PAYLOAD[] = "{\"temperature\":21.5,\"humidity\":40.2,\"pressure\":1013,\"deviceTime\":\"2019-01-01T00:00:00Z\"}";
+
+static size_t g_post_count;
+static size_t g_post_bytes;
+static size_t g_confirmed_count;
+
+HTTPAPIEX_RESULT HTTPAPIEX_Init(void)
+{
+    return HTTPAPIEX_OK;
+}
+
+void HTTPAPIEX_Deinit(void)
+{
+}
+
+HTTPAPIEX_HANDLE HTTPAPIEX_Create(const char* hostName)
+{
+    (void)hostName;
+    return (HTTPAPIEX_HANDLE)malloc(1);
+}
+
+void HTTPAPIEX_Destroy(HTTPAPIEX_HANDLE handle)
+{
+    free(handle);
+}
+
+HTTPAPIEX_RESULT HTTPAPIEX_SetOption(HTTPAPIEX_HANDLE handle, const char* optionName, const void* value)
+{
+    (void)handle;
+    (void)optionName;
+    (void)value;
+    return HTTPAPIEX_OK;
+}
+
+HTTPAPIEX_RESULT HTTPAPIEX_ExecuteRequest(HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath,
+    HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode,
+    HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    (void)handle;
+    (void)requestType;
+    (void)relativePath;
+    (void)requestHttpHeadersHandle;
+    (void)requestContent;
+    (void)responseHttpHeadersHandle;
+    (void)responseContent;
+    *statusCode = 204;
+    return HTTPAPIEX_OK;
+}
+
+HTTPAPIEX_SAS_HANDLE HTTPAPIEX_SAS_Create(STRING_HANDLE key, STRING_HANDLE uriResource, STRING_HANDLE keyName)
+{
+    (void)key;
+    (void)uriResource;
+    (void)keyName;
+    return (HTTPAPIEX_SAS_HANDLE)malloc(1);
+}
+
+void HTTPAPIEX_SAS_Destroy(HTTPAPIEX_SAS_HANDLE handle)
+{
+    free(handle);
+}
+
+/*only the events are counted, a device that has not subscribed to messages does not poll for them*/
+HTTPAPIEX_RESULT HTTPAPIEX_SAS_ExecuteRequest(HTTPAPIEX_SAS_HANDLE sasHandle, HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath,
+    HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode,
+    HTTP_HEADERS_HANDLE responseHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    (void)sasHandle;
+    (void)handle;
+    (void)relativePath;
+    (void)requestHttpHeadersHandle;
+    (void)responseHeadersHandle;
+    (void)responseContent;
+
+    if (requestType == HTTPAPI_REQUEST_POST && requestContent != NULL)
+    {
+        g_post_count++;
+        g_post_bytes += BUFFER_length(requestContent);
+    }
+    *statusCode = 204;
+    return HTTPAPIEX_OK;
+}
+
+static void send_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* context)
+{
+    (void)context;
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
+    {
+        g_confirmed_count++;
+    }
+}
+
+static IOTHUB_MESSAGE_HANDLE create_telemetry_message(bool as_string)
+{
+    IOTHUB_MESSAGE_HANDLE result = as_string ?
+        IoTHubMessage_CreateFromString(TELEMETRY_PAYLOAD) :
+        IoTHubMessage_CreateFromByteArray((const unsigned char*)TELEMETRY_PAYLOAD, sizeof(TELEMETRY_PAYLOAD) - 1);
+
+    if (result == NULL)
+    {
+        (void)printf("failed creating a message\r\n");
+    }
+    else if (Map_AddOrUpdate(IoTHubMessage_Properties(result), "sensor", "thermostat-1") != MAP_OK)
+    {
+        (void)printf("Map_AddOrUpdate failed\r\n");
+        IoTHubMessage_Destroy(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static int measure_send(const char* name, bool batching, bool as_string)
+{
+    int result;
+    IOTHUB_DEVICE_CLIENT_LL_HANDLE client;
+
+    g_post_count = 0;
+    g_post_bytes = 0;
+    g_confirmed_count = 0;
+
+    if ((client = IoTHubDeviceClient_LL_CreateFromConnectionString(CONNECTION_STRING, HTTP_Protocol)) == NULL)
+    {
+        (void)printf("IoTHubDeviceClient_LL_CreateFromConnectionString failed\r\n");
+        result = MU_FAILURE;
+    }
+    else
+    {
+        size_t i;
+
+        result = (IoTHubDeviceClient_LL_SetOption(client, OPTION_BATCHING, &batching) == IOTHUB_CLIENT_OK) ? 0 : MU_FAILURE;
+        for (i = 0; i < MESSAGE_COUNT && result == 0; i++)
+        {
+            IOTHUB_MESSAGE_HANDLE message = create_telemetry_message(as_string);
+            if (message == NULL)
+            {
+                result = MU_FAILURE;
+            }
+            else
+            {
+                if (IoTHubDeviceClient_LL_SendEventAsync(client, message, send_confirmation_callback, NULL) != IOTHUB_CLIENT_OK)
+                {
+                    (void)printf("IoTHubDeviceClient_LL_SendEventAsync failed\r\n");
+                    result = MU_FAILURE;
+                }
+                IoTHubMessage_Destroy(message);
+            }
+        }
+
+        if (result == 0)
+        {
+            clock_t start = clock();
+            for (i = 0; i < MAXIMUM_DOWORK && g_confirmed_count < MESSAGE_COUNT; i++)
+            {
+                IoTHubDeviceClient_LL_DoWork(client);
+            }
+
+            if (g_confirmed_count != MESSAGE_COUNT)
+            {
+                (void)printf("%s: only %lu of %lu messages were confirmed\r\n", name, (unsigned long)g_confirmed_count, (unsigned long)MESSAGE_COUNT);
+                result = MU_FAILURE;
+            }
+            else
+            {
+                double elapsed_s = (double)(clock() - start) / CLOCKS_PER_SEC;
+                (void)printf("%-22s %10.0f messages/s, %7.1f bytes/message, %5lu requests\r\n", name,
+                    (elapsed_s > 0) ? (double)MESSAGE_COUNT / elapsed_s : 0.0,
+                    (double)g_post_bytes / MESSAGE_COUNT, (unsigned long)g_post_count);
+            }
+        }
+        IoTHubDeviceClient_LL_Destroy(client);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result;
+
+    (void)printf("%lu messages of %lu bytes with 1 property\r\n", (unsigned long)MESSAGE_COUNT, (unsigned long)(sizeof(TELEMETRY_PAYLOAD) - 1));
+
+    result = measure_send("unbatched byte array", false, false);
+    if (result == 0)
+    {
+        result = measure_send("batched byte array", true, false);
+    }
+    if (result == 0)
+    {
+        result = measure_send("batched string", true, true);
+    }
+
+    return result;
+}
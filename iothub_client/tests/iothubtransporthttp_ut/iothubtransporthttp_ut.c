@@ -45,6 +45,8 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/vector_types_internal.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/agenttime.h"
 
 #include "iothub_client_options.h"
@@ -79,6 +81,7 @@ extern "C" {
     extern unsigned char* real_BUFFER_u_char(BUFFER_HANDLE handle);
     extern size_t real_BUFFER_length(BUFFER_HANDLE handle);
     extern int real_BUFFER_build(BUFFER_HANDLE handle, const unsigned char* source, size_t size);
+    extern int real_BUFFER_pre_build(BUFFER_HANDLE handle, size_t size);
     extern int real_BUFFER_append_build(BUFFER_HANDLE handle, const unsigned char* source, size_t size);
     extern BUFFER_HANDLE real_BUFFER_clone(BUFFER_HANDLE handle);
     extern BUFFER_HANDLE real_BUFFER_create(const unsigned char* source, size_t size);
@@ -157,6 +160,8 @@ IMPLEMENT_UMOCK_C_ENUM_TYPE(PLATFORM_INFO_OPTION, PLATFORM_INFO_OPTION_VALUES);
 #define TEST_PROPERTY_A_VALUE "value_of_a"
 
 #define TEST_HTTPAPIEX_HANDLE (HTTPAPIEX_HANDLE)0x343
+#define TEST_LOCK_HANDLE (LOCK_HANDLE)0x344
+#define TEST_COND_HANDLE (COND_HANDLE)0x345
 
 //static const bool thisIsTrue = true;
 //static const bool thisIsFalse = false;
@@ -522,6 +527,7 @@ static pfIoTHubTransport_DoWork                         IoTHubTransportHttp_DoWo
 static pfIoTHubTransport_GetSendStatus                  IoTHubTransportHttp_GetSendStatus;
 static pfIoTHubTransport_SetCallbackContext             IoTHubTransportHttp_SetCallbackContext;
 static pfIoTHubTransport_GetSupportedPlatformInfo       IoTHubTransportHttp_GetSupportedPlatformInfo;
+static pfIoTHubTransport_GetOption                      IoTHubTransportHttp_GetOption;
 
 static TEST_MUTEX_HANDLE g_testByTest;
 
@@ -551,6 +557,75 @@ static void my_HTTPAPIEX_Destroy(HTTPAPIEX_HANDLE handle)
     my_gballoc_free(handle);
 }
 
+static HTTPAPI_RESULT my_HTTPAPI_CloneOption(const char* optionName, const void* value, const void** savedValue)
+{
+    (void)optionName;
+    (void)value;
+    *savedValue = my_gballoc_malloc(1);
+    return HTTPAPI_OK;
+}
+
+/*the workers of the pooled connections are run when they are joined, or, with g_run_worker_on_post, by the first Condition_Post
+waking them up, which lets the first worker execute every exchange before the DoWork thread gets to one*/
+#define TEST_MAX_WORKERS 8
+static THREAD_START_FUNC g_worker_funcs[TEST_MAX_WORKERS];
+static void* g_worker_args[TEST_MAX_WORKERS];
+static bool g_worker_ran[TEST_MAX_WORKERS];
+static size_t g_worker_count;
+static bool g_run_worker_on_post;
+static bool g_worker_running;
+
+static void run_worker(size_t index)
+{
+    if (!g_worker_ran[index])
+    {
+        g_worker_ran[index] = true;
+        g_worker_running = true;
+        (void)g_worker_funcs[index](g_worker_args[index]);
+        g_worker_running = false;
+    }
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    if (g_worker_count == TEST_MAX_WORKERS)
+    {
+        ASSERT_FAIL("too many workers started");
+    }
+    g_worker_funcs[g_worker_count] = func;
+    g_worker_args[g_worker_count] = arg;
+    g_worker_ran[g_worker_count] = false;
+    g_worker_count++;
+    *threadHandle = (THREAD_HANDLE)(uintptr_t)g_worker_count;
+    return THREADAPI_OK;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
+{
+    *res = 0;
+    run_worker((size_t)(uintptr_t)threadHandle - 1);
+    return THREADAPI_OK;
+}
+
+static COND_RESULT my_Condition_Post(COND_HANDLE handle)
+{
+    (void)handle;
+    if (g_run_worker_on_post && !g_worker_running && (g_worker_count > 0))
+    {
+        run_worker(0);
+    }
+    return COND_OK;
+}
+
+/*nothing else would ever wake a worker run by the tests, so its first wait fails, which ends it*/
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    (void)timeout_milliseconds;
+    return g_worker_running ? COND_ERROR : COND_TIMEOUT;
+}
+
 static IOTHUB_CLIENT_RESULT my_IoTHubClientCore_LL_GetOption(IOTHUB_CLIENT_CORE_LL_HANDLE handle, const char* option, void** value)
 {
     (void)handle;
@@ -1132,6 +1207,48 @@ static void setupDoWorkLoopForNextDevice(size_t next)
     STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, next));
 }
 
+/*a batched byte array message is read once to measure its item and once more to write it*/
+static void setupBatchedByteArrayItem(IOTHUB_MESSAGE_HANDLE messageHandle, MAP_HANDLE properties)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(messageHandle));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(messageHandle));
+    STRICT_EXPECTED_CALL(Map_GetInternals(properties, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
+static void setupBatchedPayload(size_t payloadLength)
+{
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(IGNORED_PTR_ARG, payloadLength));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+}
+
+static void setupBatchedItemConfirmation(IOTHUB_MESSAGE_LIST* message)
+{
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message->entry)));
+}
+
+static void setupBatchedSend(void)
+{
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
+        IGNORED_PTR_ARG,
+        IGNORED_PTR_ARG,
+        HTTPAPI_REQUEST_POST,
+        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,
+        IGNORED_PTR_ARG,
+        IGNORED_PTR_ARG,
+        IGNORED_PTR_ARG,
+        NULL,
+        NULL
+    ))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+    STRICT_EXPECTED_CALL(Transport_SendComplete_Callback(IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+}
+
 BEGIN_TEST_SUITE(iothubtransporthttp_ut)
 
 TEST_SUITE_INITIALIZE(suite_init)
@@ -1178,6 +1295,14 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONFIRMATION_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -1193,6 +1318,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, real_BUFFER_delete);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_build, real_BUFFER_build);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_build, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_pre_build, real_BUFFER_pre_build);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_pre_build, __LINE__);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, real_BUFFER_u_char);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, real_BUFFER_length);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_clone, real_BUFFER_clone);
@@ -1217,6 +1344,20 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_Init, HTTPAPIEX_ERROR);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_Create, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Destroy, my_HTTPAPIEX_Destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPI_CloneOption, my_HTTPAPI_CloneOption);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPI_CloneOption, HTTPAPI_ERROR);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Post, my_Condition_Post);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
 
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_create, real_VECTOR_create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(VECTOR_create, NULL);
@@ -1331,6 +1472,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     IoTHubTransportHttp_GetSendStatus = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_GetSendStatus;
     IoTHubTransportHttp_SetCallbackContext = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_SetCallbackContext;
     IoTHubTransportHttp_GetSupportedPlatformInfo = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_GetSupportedPlatformInfo;
+    IoTHubTransportHttp_GetOption = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_GetOption;
 
     TEST_STRING_HANDLE = real_STRING_construct(TEST_STRING_DATA);
 }
@@ -1352,6 +1494,9 @@ static void reset_test_data()
 {
     last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest = NULL;
     my_IoTHubClientCore_LL_MessageCallback_messageData = NULL;
+    g_worker_count = 0;
+    g_run_worker_on_post = false;
+    g_worker_running = false;
 }
 
 typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG
@@ -5080,6 +5225,227 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and
     IoTHubTransportHttp_Destroy(handle);
 }
 
+/*the C2D GET finds no message, as my_HTTPAPIEX_SAS_ExecuteRequest answers 204*/
+static void DoWorkSecondsAfterLastPoll(TRANSPORT_LL_HANDLE handle, double seconds)
+{
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG))
+        .SetReturn(seconds);
+    IoTHubTransportHttp_DoWork(handle);
+}
+
+static size_t getEmptyPolls(TRANSPORT_LL_HANDLE handle)
+{
+    IOTHUB_HTTP_POLLING_STATISTICS statistics;
+    (void)IoTHubTransportHttp_GetOption(handle, OPTION_HTTP_POLLING_STATISTICS, &statistics);
+    return statistics.empty_polls;
+}
+
+static size_t getFailedPolls(TRANSPORT_LL_HANDLE handle)
+{
+    IOTHUB_HTTP_POLLING_STATISTICS statistics;
+    (void)IoTHubTransportHttp_GetOption(handle, OPTION_HTTP_POLLING_STATISTICS, &statistics);
+    return statistics.failed_polls;
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_GetOption_with_NULL_arguments_fails)
+{
+    //arrange
+    IOTHUB_HTTP_POLLING_STATISTICS statistics;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT noHandleResult = IoTHubTransportHttp_GetOption(NULL, OPTION_HTTP_POLLING_STATISTICS, &statistics);
+    IOTHUB_CLIENT_RESULT noOptionResult = IoTHubTransportHttp_GetOption(handle, NULL, &statistics);
+    IOTHUB_CLIENT_RESULT noValueResult = IoTHubTransportHttp_GetOption(handle, OPTION_HTTP_POLLING_STATISTICS, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, noHandleResult);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, noOptionResult);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, noValueResult);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_GetOption_with_unknown_option_fails)
+{
+    //arrange
+    unsigned int value;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetOption(handle, OPTION_MIN_POLLING_TIME, &value);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_GetOption_polling_statistics_counts_the_GETs_by_outcome)
+{
+    //arrange
+    unsigned int statusCode200 = 200;
+    IOTHUB_HTTP_POLLING_STATISTICS statistics;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+    DoWorkSecondsAfterLastPoll(handle, TEST_DEFAULT_GETMINIMUMPOLLINGTIME + 1);
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .SetReturn(HTTPAPIEX_ERROR);
+    DoWorkSecondsAfterLastPoll(handle, TEST_DEFAULT_GETMINIMUMPOLLINGTIME + 1);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetOption(handle, OPTION_HTTP_POLLING_STATISTICS, &statistics);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.empty_polls);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.message_polls);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.failed_polls);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_without_MaximumPollingTime_polls_every_MinimumPollingTime)
+{
+    //arrange
+    unsigned int minimumPollingTime = 10;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle);
+    umock_c_reset_all_calls();
+
+    //act
+    DoWorkSecondsAfterLastPoll(handle, 11);
+    DoWorkSecondsAfterLastPoll(handle, 11);
+    DoWorkSecondsAfterLastPoll(handle, 11);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 4, getEmptyPolls(handle));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_MaximumPollingTime_doubles_the_wait_after_each_empty_GET)
+{
+    //arrange
+    unsigned int minimumPollingTime = 10;
+    unsigned int maximumPollingTime = 40;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MAX_POLLING_TIME, &maximumPollingTime);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle);
+    umock_c_reset_all_calls();
+
+    //act
+    //assert
+    /*waits 10 seconds plus up to 10% jitter*/
+    DoWorkSecondsAfterLastPoll(handle, 10);
+    ASSERT_ARE_EQUAL(size_t, 1, getEmptyPolls(handle));
+    DoWorkSecondsAfterLastPoll(handle, 12);
+    ASSERT_ARE_EQUAL(size_t, 2, getEmptyPolls(handle));
+
+    /*then 20*/
+    DoWorkSecondsAfterLastPoll(handle, 20);
+    ASSERT_ARE_EQUAL(size_t, 2, getEmptyPolls(handle));
+    DoWorkSecondsAfterLastPoll(handle, 23);
+    ASSERT_ARE_EQUAL(size_t, 3, getEmptyPolls(handle));
+
+    /*then no more than the maximum*/
+    DoWorkSecondsAfterLastPoll(handle, 40);
+    ASSERT_ARE_EQUAL(size_t, 3, getEmptyPolls(handle));
+    DoWorkSecondsAfterLastPoll(handle, 45);
+    ASSERT_ARE_EQUAL(size_t, 4, getEmptyPolls(handle));
+    DoWorkSecondsAfterLastPoll(handle, 45);
+    ASSERT_ARE_EQUAL(size_t, 5, getEmptyPolls(handle));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_MaximumPollingTime_doubles_the_wait_after_a_failed_GET)
+{
+    //arrange
+    unsigned int minimumPollingTime = 10;
+    unsigned int maximumPollingTime = 40;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MAX_POLLING_TIME, &maximumPollingTime);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .SetReturn(HTTPAPIEX_ERROR);
+    DoWorkSecondsAfterLastPoll(handle, 12);
+
+    //act
+    /*the failed GET is followed by a wait of 20 seconds, not 10*/
+    DoWorkSecondsAfterLastPoll(handle, 20);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, getFailedPolls(handle));
+    ASSERT_ARE_EQUAL(size_t, 1, getEmptyPolls(handle));
+    DoWorkSecondsAfterLastPoll(handle, 23);
+    ASSERT_ARE_EQUAL(size_t, 2, getEmptyPolls(handle));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_MaximumPollingTime_goes_back_to_MinimumPollingTime_after_a_message)
+{
+    //arrange
+    unsigned int statusCode200 = 200;
+    unsigned int minimumPollingTime = 10;
+    unsigned int maximumPollingTime = 40;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MAX_POLLING_TIME, &maximumPollingTime);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    IoTHubTransportHttp_DoWork(handle);
+    DoWorkSecondsAfterLastPoll(handle, 12);
+    DoWorkSecondsAfterLastPoll(handle, 23);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+    DoWorkSecondsAfterLastPoll(handle, 45);
+
+    //act
+    DoWorkSecondsAfterLastPoll(handle, 12);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 4, getEmptyPolls(handle));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
 /*undefined behavior*/
 /*purpose of this test is to see that gremlins don't emerge when the http return code is 404 from the service*/
 TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_empty_waitingToSend_and_1_service_message_with_accept_code_404_succeeds)
@@ -14326,6 +14692,593 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetContentEncoding_succeeds)
     IoTHubTransportHttp_Destroy(handle);
 }
 
+//Tests_SRS_TRANSPORTMULTITHTTP_17_056: [ IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...] ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_058: [ If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2*]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_070: [ If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClientCore_LL_SendComplete. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_with_2_event_items_sends_them_in_1_payload_succeeds)
+{
+    //arrange
+    static const char expectedPayload[] = "[{\"body\":\"MQ==\"},{\"body\":\"MTIzNDU2\",\"properties\":{\"iothub-app-" TEST_RED_KEY "\":\"" TEST_RED_VALUE "\"}}]";
+    bool batching = true;
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"));
+
+    /*measuring the items*/
+    setupBatchedByteArrayItem(TEST_IOTHUB_MESSAGE_HANDLE_1, TEST_MAP_EMPTY);
+    setupBatchedByteArrayItem(TEST_IOTHUB_MESSAGE_HANDLE_6, TEST_MAP_1_PROPERTY);
+    setupBatchedPayload(sizeof(expectedPayload) - 1);
+
+    /*writing them*/
+    setupBatchedByteArrayItem(TEST_IOTHUB_MESSAGE_HANDLE_1, TEST_MAP_EMPTY);
+    setupBatchedItemConfirmation(&message1);
+    setupBatchedByteArrayItem(TEST_IOTHUB_MESSAGE_HANDLE_6, TEST_MAP_1_PROPERTY);
+    setupBatchedItemConfirmation(&message6);
+
+    setupBatchedSend();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, sizeof(expectedPayload) - 1, real_BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), expectedPayload, sizeof(expectedPayload) - 1));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_057: [ If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false} ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_with_1_string_event_item_sends_it_JSON_encoded_succeeds)
+{
+    //arrange
+    static const char expectedPayload[] = "[{\"body\":\"thisgoestoJ\\\\s\\/\\/on\\\"ToBeEn\\u000D\\u000A\\u0008coded\",\"base64Encoded\":false}]";
+    bool batching = true;
+    size_t i;
+    DList_InsertTailList(&(waitingToSend), &(message10.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"));
+
+    for (i = 0; i < 2; i++)
+    {
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_10))
+            .SetReturn(IOTHUBMESSAGE_STRING);
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_IOTHUB_MESSAGE_HANDLE_10))
+            .SetReturn(string10);
+        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_10));
+        STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        if (i == 0)
+        {
+            setupBatchedPayload(sizeof(expectedPayload) - 1);
+        }
+    }
+    setupBatchedItemConfirmation(&message10);
+
+    setupBatchedSend();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, sizeof(expectedPayload) - 1, real_BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), expectedPayload, sizeof(expectedPayload) - 1));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_061: [ The message size shall be limited to 255KB - 1 byte. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_leaves_the_items_that_do_not_fit_for_the_next_payload)
+{
+    //arrange
+    /*[{"body":"<base64>","properties":{"iothub-app-a":"b"}}]*/
+    size_t payloadLength = 1 + 9 + 4 * ((buffer11_size + 2) / 3) + 1 + 15 + 18 + 1 + 1 + 1;
+    bool batching = true;
+    DList_InsertTailList(&(waitingToSend), &(message11.entry));
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"));
+
+    /*message11 is at the limit on its own, message1 does not make it*/
+    setupBatchedByteArrayItem(TEST_IOTHUB_MESSAGE_HANDLE_11, TEST_MAP_1_PROPERTY_A_B);
+    setupBatchedByteArrayItem(TEST_IOTHUB_MESSAGE_HANDLE_1, TEST_MAP_EMPTY);
+    setupBatchedPayload(payloadLength);
+
+    setupBatchedByteArrayItem(TEST_IOTHUB_MESSAGE_HANDLE_11, TEST_MAP_1_PROPERTY_A_B);
+    setupBatchedItemConfirmation(&message11);
+
+    setupBatchedSend();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, payloadLength, real_BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, ']', real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest)[payloadLength - 1]);
+    ASSERT_ARE_EQUAL(void_ptr, &(message1.entry), waitingToSend.Flink);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_065: [ If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClientCore_LL_SendComplete shall be called. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_with_a_first_item_over_the_limit_completes_it_with_error)
+{
+    //arrange
+    bool batching = true;
+    DList_InsertTailList(&(waitingToSend), &(message12.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"));
+    setupBatchedByteArrayItem(TEST_IOTHUB_MESSAGE_HANDLE_12, TEST_MAP_1_PROPERTY_AA_B);
+    setupBatchedItemConfirmation(&message12);
+    STRICT_EXPECTED_CALL(Transport_SendComplete_Callback(IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_ERROR, IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_066: [ If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_when_the_second_item_fails_sends_the_first_one)
+{
+    //arrange
+    static const char expectedPayload[] = "[{\"body\":\"MQ==\"}]";
+    bool batching = true;
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message2.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"));
+
+    setupBatchedByteArrayItem(TEST_IOTHUB_MESSAGE_HANDLE_1, TEST_MAP_EMPTY);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_2));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_2, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(IOTHUB_MESSAGE_ERROR);
+    setupBatchedPayload(sizeof(expectedPayload) - 1);
+
+    setupBatchedByteArrayItem(TEST_IOTHUB_MESSAGE_HANDLE_1, TEST_MAP_EMPTY);
+    setupBatchedItemConfirmation(&message1);
+
+    setupBatchedSend();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, sizeof(expectedPayload) - 1, real_BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), expectedPayload, sizeof(expectedPayload) - 1));
+    ASSERT_ARE_EQUAL(void_ptr, &(message2.entry), waitingToSend.Flink);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_when_BUFFER_pre_build_fails_keeps_the_items)
+{
+    //arrange
+    bool batching = true;
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"));
+    setupBatchedByteArrayItem(TEST_IOTHUB_MESSAGE_HANDLE_1, TEST_MAP_EMPTY);
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(__LINE__);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, &(message1.entry), waitingToSend.Flink);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+/*a worker joined once its connection is closed, with nothing left to do*/
+static void setupWorkerStopped(void)
+{
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_http_connections_out_of_range_fails)
+{
+    //arrange
+    size_t none = 0;
+    size_t tooMany = 9;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT noneResult = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTIONS, &none);
+    IOTHUB_CLIENT_RESULT tooManyResult = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTIONS, &tooMany);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, noneResult);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, tooManyResult);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_http_connections_opens_connections_with_the_options_set_before)
+{
+    //arrange
+    size_t connections = 3;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    (void)IoTHubTransportHttp_SetOption(handle, "TrustedCerts", "certificates");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption(IGNORED_PTR_ARG, "TrustedCerts", IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption(IGNORED_PTR_ARG, "TrustedCerts", IGNORED_PTR_ARG));
+    /*a worker per pooled connection, kept until the connection is closed*/
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTIONS, &connections);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_sets_the_options_of_the_http_client_on_every_connection)
+{
+    //arrange
+    size_t connections = 2;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTIONS, &connections);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption(IGNORED_PTR_ARG, "TrustedCerts", IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption(IGNORED_PTR_ARG, "TrustedCerts", IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPI_CloneOption("TrustedCerts", IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, "TrustedCerts", "certificates");
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_http_connections_closes_the_new_connections_when_one_cannot_be_opened)
+{
+    //arrange
+    size_t connections = 3;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTIONS, &connections);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_http_connections_closes_the_connection_whose_worker_cannot_start)
+{
+    //arrange
+    size_t connections = 2;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(THREADAPI_ERROR);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTIONS, &connections);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_http_connections_1_closes_the_pooled_connections)
+{
+    //arrange
+    size_t connections = 3;
+    size_t oneConnection = 1;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTIONS, &connections);
+    umock_c_reset_all_calls();
+
+    /*the workers are stopped first*/
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    setupWorkerStopped();
+    setupWorkerStopped();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTIONS, &oneConnection);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+static void setupPollPrepared(void)
+{
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+}
+
+/*the exchange is claimed with the queue locked, and executed with it unlocked*/
+static void setupPollExecuted(HTTPAPIEX_HANDLE connection, const char* relativePath)
+{
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, connection, HTTPAPI_REQUEST_GET, relativePath, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+}
+
+/*the GET returns 204, no message*/
+static void setupPollCompleted(void)
+{
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_connections_polls_the_devices_over_the_pooled_connection)
+{
+    //arrange
+    size_t connections = 2;
+    HTTPAPIEX_HANDLE pooledConnection = my_HTTPAPIEX_Create(TEST_IOTHUB_NAME);
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    IOTHUB_DEVICE_HANDLE devHandle1 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    IOTHUB_DEVICE_HANDLE devHandle2 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_CONFIG2.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle1);
+    (void)IoTHubTransportHttp_Subscribe(devHandle2);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG))
+        .SetReturn(pooledConnection);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTIONS, &connections);
+    g_run_worker_on_post = true;
+    umock_c_reset_all_calls();
+
+    /*both requests are built first*/
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    setupPollPrepared();
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend2));
+    setupPollPrepared();
+
+    /*then queued for the worker of the pooled connection, which is already running*/
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    setupPollExecuted(pooledConnection, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION);
+    setupPollExecuted(pooledConnection, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION); /*URL_EncodeString gives the same id to both devices*/
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+    /*nothing is left for the DoWork thread*/
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    /*and completed in device order*/
+    setupPollCompleted();
+    setupPollCompleted();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_connections_executes_the_requests_the_worker_does_not_claim)
+{
+    //arrange
+    size_t connections = 2;
+    HTTPAPIEX_HANDLE mainConnection = my_HTTPAPIEX_Create(TEST_IOTHUB_NAME);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG))
+        .SetReturn(mainConnection);
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    IOTHUB_DEVICE_HANDLE devHandle1 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    IOTHUB_DEVICE_HANDLE devHandle2 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_CONFIG2.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle1);
+    (void)IoTHubTransportHttp_Subscribe(devHandle2);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTIONS, &connections);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    setupPollPrepared();
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend2));
+    setupPollPrepared();
+
+    /*the worker is not woken up before the DoWork thread is done with both*/
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    setupPollExecuted(mainConnection, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION);
+    setupPollExecuted(mainConnection, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION); /*URL_EncodeString gives the same id to both devices*/
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    setupPollCompleted();
+    setupPollCompleted();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_connections_counts_the_request_of_a_worker_that_cannot_take_the_lock_back)
+{
+    //arrange
+    size_t connections = 2;
+    HTTPAPIEX_HANDLE mainConnection = my_HTTPAPIEX_Create(TEST_IOTHUB_NAME);
+    HTTPAPIEX_HANDLE pooledConnection = my_HTTPAPIEX_Create(TEST_IOTHUB_NAME);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG))
+        .SetReturn(mainConnection);
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG, &transport_cb_info, transport_cb_ctx);
+    IOTHUB_DEVICE_HANDLE devHandle1 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_CONFIG.waitingToSend);
+    IOTHUB_DEVICE_HANDLE devHandle2 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_CONFIG2.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle1);
+    (void)IoTHubTransportHttp_Subscribe(devHandle2);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG))
+        .SetReturn(pooledConnection);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_CONNECTIONS, &connections);
+    g_run_worker_on_post = true;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    setupPollPrepared();
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend2));
+    setupPollPrepared();
+
+    /*the worker executes the first request, then exits without the lock*/
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, pooledConnection, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE))
+        .SetReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+    /*the DoWork thread executes the second one, and does not wait for the first one*/
+    setupPollExecuted(mainConnection, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION);
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    setupPollCompleted();
+    setupPollCompleted();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
 /*Tests_SRS_TRANSPORTMULTITHTTP_02_001: [ If handle is NULL then IoTHubTransportHttp_GetHostname shall fail and return NULL. ]*/
 TEST_FUNCTION(IoTHubTransportHttp_GetHostname_with_NULL_handle_fails)
 {
@@ -113,6 +113,7 @@ static pfIoTHubTransport_Subscribe_InputQueue       IoTHubTransportMqtt_Subscrib
 static pfIoTHubTransport_Unsubscribe_InputQueue     IoTHubTransportMqtt_Unsubscribe_InputQueue;
 static pfIoTHubTransport_SetCallbackContext         IoTHubTransportMqtt_SetCallbackContext;
 static pfIoTHubTransport_GetSupportedPlatformInfo   IotHubTransportMqtt_GetSupportedPlatformInfo;
+static pfIoTHubTransport_GetOption                  IoTHubTransportMqtt_GetOption;
 
 static TRANSPORT_LL_HANDLE my_IoTHubTransport_MQTT_Common_Create(const IOTHUBTRANSPORT_CONFIG* config, MQTT_GET_IO_TRANSPORT get_io_transport, TRANSPORT_CALLBACKS_INFO* cb_info, void* ctx)
 {
@@ -358,6 +359,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     IoTHubTransportMqtt_Unsubscribe_InputQueue = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_Unsubscribe_InputQueue;
     IoTHubTransportMqtt_SetCallbackContext = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_SetCallbackContext;
     IotHubTransportMqtt_GetSupportedPlatformInfo = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_GetSupportedPlatformInfo;
+    IoTHubTransportMqtt_GetOption = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_GetOption;
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -767,6 +769,23 @@ TEST_FUNCTION(IoTHubTransportMqtt_SetOption_success)
     //cleanup
 }
 
+TEST_FUNCTION(IoTHubTransportMqtt_GetOption_success)
+{
+    // arrange
+    IOTHUB_MQTT_PUBLISH_STATISTICS statistics;
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_GetOption(TEST_TRANSPORT_HANDLE, OPTION_MQTT_PUBLISH_STATISTICS, &statistics));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportMqtt_GetOption(TEST_TRANSPORT_HANDLE, OPTION_MQTT_PUBLISH_STATISTICS, &statistics);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
 /* Tests_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ IoTHubTransportMqtt_Register shall register the TRANSPORT_LL_HANDLE by calling into the IoTHubMqttAbstract_Register function. ] */
 TEST_FUNCTION(IoTHubTransportMqtt_Register_success)
 {
@@ -0,0 +1,220 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+
+#include "testrunnerswitcher.h"
+
+#include "internal/timeout_heap.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+#define TEST_NODE_COUNT 100
+
+static TIMEOUT_HEAP heap;
+static TIMEOUT_HEAP_NODE nodes[TEST_NODE_COUNT];
+
+static size_t index_of(TIMEOUT_HEAP_NODE* node)
+{
+    return (size_t)(node - nodes);
+}
+
+BEGIN_TEST_SUITE(timeout_heap_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    size_t i;
+
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    timeout_heap_init(&heap);
+    for (i = 0; i < TEST_NODE_COUNT; i++)
+    {
+        timeout_heap_node_init(&nodes[i]);
+    }
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+TEST_FUNCTION(timeout_heap_empty_heap_has_nothing_expired)
+{
+    // act
+    TIMEOUT_HEAP_NODE* expired = timeout_heap_pop_expired(&heap, UINT64_MAX);
+
+    // assert
+    ASSERT_IS_NULL(expired);
+    ASSERT_IS_NULL(timeout_heap_peek(&heap));
+}
+
+TEST_FUNCTION(timeout_heap_pops_nodes_in_deadline_order)
+{
+    // arrange
+    timeout_heap_add(&heap, &nodes[0], 30);
+    timeout_heap_add(&heap, &nodes[1], 10);
+    timeout_heap_add(&heap, &nodes[2], 20);
+
+    // act
+    TIMEOUT_HEAP_NODE* first = timeout_heap_pop_expired(&heap, 100);
+    TIMEOUT_HEAP_NODE* second = timeout_heap_pop_expired(&heap, 100);
+    TIMEOUT_HEAP_NODE* third = timeout_heap_pop_expired(&heap, 100);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, index_of(first));
+    ASSERT_ARE_EQUAL(size_t, 2, index_of(second));
+    ASSERT_ARE_EQUAL(size_t, 0, index_of(third));
+    ASSERT_IS_NULL(timeout_heap_pop_expired(&heap, 100));
+}
+
+TEST_FUNCTION(timeout_heap_pops_equal_deadlines_in_the_order_they_were_added)
+{
+    // arrange
+    size_t i;
+    for (i = 0; i < TEST_NODE_COUNT; i++)
+    {
+        timeout_heap_add(&heap, &nodes[i], 0);
+    }
+
+    // act & assert
+    for (i = 0; i < TEST_NODE_COUNT; i++)
+    {
+        ASSERT_ARE_EQUAL(size_t, i, index_of(timeout_heap_pop_expired(&heap, 0)));
+    }
+}
+
+TEST_FUNCTION(timeout_heap_does_not_pop_a_deadline_after_now)
+{
+    // arrange
+    timeout_heap_add(&heap, &nodes[0], 11);
+
+    // act
+    TIMEOUT_HEAP_NODE* expired = timeout_heap_pop_expired(&heap, 10);
+
+    // assert
+    ASSERT_IS_NULL(expired);
+    ASSERT_ARE_EQUAL(void_ptr, &nodes[0], timeout_heap_peek(&heap));
+    ASSERT_IS_TRUE(timeout_heap_node_is_queued(&heap, &nodes[0]));
+}
+
+TEST_FUNCTION(timeout_heap_pop_takes_the_node_out)
+{
+    // arrange
+    timeout_heap_add(&heap, &nodes[0], 10);
+
+    // act
+    TIMEOUT_HEAP_NODE* expired = timeout_heap_pop_expired(&heap, 10);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, &nodes[0], expired);
+    ASSERT_IS_FALSE(timeout_heap_node_is_queued(&heap, &nodes[0]));
+    ASSERT_IS_NULL(timeout_heap_peek(&heap));
+}
+
+TEST_FUNCTION(timeout_heap_remove_takes_out_a_node_that_is_not_the_earliest)
+{
+    // arrange
+    size_t i;
+    for (i = 0; i < 10; i++)
+    {
+        timeout_heap_add(&heap, &nodes[i], i);
+    }
+
+    // act
+    timeout_heap_remove(&heap, &nodes[5]);
+
+    // assert
+    ASSERT_IS_FALSE(timeout_heap_node_is_queued(&heap, &nodes[5]));
+    for (i = 0; i < 10; i++)
+    {
+        if (i != 5)
+        {
+            ASSERT_ARE_EQUAL(size_t, i, index_of(timeout_heap_pop_expired(&heap, 100)));
+        }
+    }
+    ASSERT_IS_NULL(timeout_heap_peek(&heap));
+}
+
+TEST_FUNCTION(timeout_heap_remove_of_a_node_not_in_the_heap_does_nothing)
+{
+    // arrange
+    timeout_heap_add(&heap, &nodes[0], 10);
+
+    // act
+    timeout_heap_remove(&heap, &nodes[1]);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, &nodes[0], timeout_heap_peek(&heap));
+    ASSERT_IS_TRUE(timeout_heap_node_is_queued(&heap, &nodes[0]));
+    ASSERT_IS_FALSE(timeout_heap_node_is_queued(&heap, &nodes[1]));
+}
+
+TEST_FUNCTION(timeout_heap_add_of_a_queued_node_moves_its_deadline)
+{
+    // arrange
+    timeout_heap_add(&heap, &nodes[0], 10);
+    timeout_heap_add(&heap, &nodes[1], 20);
+
+    // act
+    timeout_heap_add(&heap, &nodes[0], 30);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, index_of(timeout_heap_pop_expired(&heap, 100)));
+    ASSERT_ARE_EQUAL(size_t, 0, index_of(timeout_heap_pop_expired(&heap, 100)));
+    ASSERT_IS_NULL(timeout_heap_peek(&heap));
+}
+
+TEST_FUNCTION(timeout_heap_keeps_deadline_order_through_adds_and_removes)
+{
+    // arrange
+    /*deadlines in a scrambled order (37 and TEST_NODE_COUNT are coprime), with every third node removed again*/
+    size_t i;
+    uint64_t previous = 0;
+    size_t popped = 0;
+    TIMEOUT_HEAP_NODE* expired;
+    for (i = 0; i < TEST_NODE_COUNT; i++)
+    {
+        timeout_heap_add(&heap, &nodes[i], (i * 37) % TEST_NODE_COUNT);
+    }
+    for (i = 0; i < TEST_NODE_COUNT; i += 3)
+    {
+        timeout_heap_remove(&heap, &nodes[i]);
+    }
+
+    // act & assert
+    while ((expired = timeout_heap_pop_expired(&heap, UINT64_MAX)) != NULL)
+    {
+        uint64_t deadline = (index_of(expired) * 37) % TEST_NODE_COUNT;
+        ASSERT_IS_TRUE(deadline >= previous);
+        ASSERT_ARE_NOT_EQUAL(size_t, 0, index_of(expired) % 3);
+        previous = deadline;
+        popped++;
+    }
+    ASSERT_ARE_EQUAL(size_t, TEST_NODE_COUNT - (TEST_NODE_COUNT + 2) / 3, popped);
+}
+
+END_TEST_SUITE(timeout_heap_ut)
@@ -325,16 +325,17 @@ static void set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_CONTENT_TYPE msg
         .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
 }
 
-static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(size_t number_of_app_properties, IOTHUBMESSAGE_CONTENT_TYPE msg_content_type, bool has_message_id, bool has_correlation_id, bool has_diag_properties, bool has_security_props, const char* content_type, const char* content_encoding)
+static void set_exp_calls_for_sizing_uamqp_encoding(size_t number_of_app_properties, IOTHUBMESSAGE_CONTENT_TYPE msg_content_type, bool has_message_id, bool has_correlation_id, bool has_diag_properties, bool has_security_props, const char* content_type, const char* content_encoding)
 {
     set_exp_calls_for_create_encoded_message_properties(has_message_id, has_correlation_id, content_type, content_encoding);
     set_exp_calls_for_create_encoded_application_properties(number_of_app_properties);
     set_exp_calls_for_create_encoded_annotations_properties(has_diag_properties, has_security_props);
 
     set_exp_calls_for_create_encoded_data(msg_content_type);
+}
 
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-        .SetReturn(g_encoding_buffer);
+static void set_exp_calls_for_writing_uamqp_encoding(size_t number_of_app_properties, bool has_diag_properties)
+{
     STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     if (number_of_app_properties > 0)
@@ -361,6 +362,14 @@ static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(
     STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
 }
 
+static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(size_t number_of_app_properties, IOTHUBMESSAGE_CONTENT_TYPE msg_content_type, bool has_message_id, bool has_correlation_id, bool has_diag_properties, bool has_security_props, const char* content_type, const char* content_encoding)
+{
+    set_exp_calls_for_sizing_uamqp_encoding(number_of_app_properties, msg_content_type, has_message_id, has_correlation_id, has_diag_properties, has_security_props, content_type, content_encoding);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(g_encoding_buffer);
+    set_exp_calls_for_writing_uamqp_encoding(number_of_app_properties, has_diag_properties);
+}
+
 static void set_exp_calls_for_message_create_IoTHubMessage_from_uamqp_message(
     size_t number_of_properties,
     bool has_message_id,
@@ -845,6 +854,77 @@ TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_bytearray_succes
     // cleanup
 }
 
+TEST_FUNCTION(message_encode_uamqp_encoding_from_iothub_message_writes_into_a_large_enough_scratch_buffer)
+{
+    // arrange
+    unsigned char* scratch_buffer = (unsigned char*)g_encoding_buffer;
+    size_t scratch_buffer_size = sizeof(g_encoding_buffer);
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_sizing_uamqp_encoding(0, IOTHUBMESSAGE_BYTEARRAY, true, true, false, false, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+    set_exp_calls_for_writing_uamqp_encoding(0, false);
+
+    // act
+    int result = message_encode_uamqp_encoding_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, &scratch_buffer, &scratch_buffer_size, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, g_encoding_buffer, scratch_buffer);
+    ASSERT_ARE_EQUAL(size_t, sizeof(g_encoding_buffer), scratch_buffer_size);
+    ASSERT_ARE_EQUAL(void_ptr, g_encoding_buffer, binary_data.bytes);
+}
+
+TEST_FUNCTION(message_encode_uamqp_encoding_from_iothub_message_grows_the_scratch_buffer)
+{
+    // arrange
+    unsigned char* scratch_buffer = NULL;
+    size_t scratch_buffer_size = 0;
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_sizing_uamqp_encoding(0, IOTHUBMESSAGE_BYTEARRAY, true, true, false, false, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+        .SetReturn(g_encoding_buffer);
+    set_exp_calls_for_writing_uamqp_encoding(0, false);
+
+    // act
+    int result = message_encode_uamqp_encoding_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, &scratch_buffer, &scratch_buffer_size, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, g_encoding_buffer, scratch_buffer);
+    ASSERT_ARE_EQUAL(size_t, binary_data.length, scratch_buffer_size);
+    ASSERT_ARE_EQUAL(void_ptr, g_encoding_buffer, binary_data.bytes);
+}
+
+TEST_FUNCTION(message_encode_uamqp_encoding_from_iothub_message_keeps_the_scratch_buffer_when_it_cannot_grow)
+{
+    // arrange
+    unsigned char* scratch_buffer = NULL;
+    size_t scratch_buffer_size = 0;
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_sizing_uamqp_encoding(0, IOTHUBMESSAGE_BYTEARRAY, true, true, false, false, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    int result = message_encode_uamqp_encoding_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, &scratch_buffer, &scratch_buffer_size, &binary_data);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(scratch_buffer);
+    ASSERT_ARE_EQUAL(size_t, 0, scratch_buffer_size);
+    ASSERT_IS_NULL(binary_data.bytes);
+}
+
 // Tests_SRS_UAMQP_MESSAGING_31_117: [Get application message properties associated with the IOTHUB_MESSAGE_HANDLE to encode, returning the properties and their encoded length.  Errors stop processing on this message.]
 TEST_FUNCTION(message_create_from_iothub_message_zero_app_properties_success)
 {